@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "TextureStreaming.h"
+
+// BC1, BC3 and BC7 block encoders, and the decoders used to measure them.
+// A block is 4x4 RGBA8 pixels, row-major, 64 bytes.
+//
+// Endpoints come from the principal axis of the block's colors and are
+// refined with a least-squares fit to the chosen indices. BC7 only uses
+// mode 6 (one subset, 7-bit RGBA endpoints with a p-bit, 4-bit indices),
+// which handles smooth gradients and alpha well at a fraction of the cost of
+// a full mode and partition search.
+
+// 8 bytes. Alpha is ignored; the block always uses four-color mode.
+void CompressBC1Block(const uint8_t* pixels, uint8_t* block);
+// 16 bytes: BC4 alpha followed by a BC1 color block.
+void CompressBC3Block(const uint8_t* pixels, uint8_t* block);
+// 16 bytes, mode 6.
+void CompressBC7Block(const uint8_t* pixels, uint8_t* block);
+
+void DecompressBC1Block(const uint8_t* block, uint8_t* pixels);
+void DecompressBC3Block(const uint8_t* block, uint8_t* pixels);
+// False for blocks that are not mode 6.
+bool DecompressBC7Block(const uint8_t* block, uint8_t* pixels);
+
+// Encode every mip of an RGBA8 image. Block rows of all mips are spread
+// across threadCount threads (0 for all cores).
+bool CompressImage(const TextureImage& source, TextureFormat format, TextureImage& compressed, unsigned int threadCount = 0);
+// Decode a block compressed image back to RGBA8.
+bool DecompressImage(const TextureImage& compressed, TextureImage& decompressed);
+
+// Peak signal to noise ratio of mip 0 of two RGBA8 images of the same size,
+// in dB. Infinite if they are identical.
+double ComputePSNR(const TextureImage& a, const TextureImage& b, bool includeAlpha);
@@ -0,0 +1,143 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "FrustumCulling.h"
+
+// Dynamic bounding volume hierarchy for scene queries: frustum culling, ray
+// picking and proximity.
+//
+// Objects are leaves of a binary tree of axis-aligned boxes. A new leaf is
+// placed next to the sibling that adds the least surface area along the way
+// down (SAH), and every node on the path back up is rotated: one of its
+// children is swapped with a grandchild when that shrinks the box of the
+// grandchild's new parent. The rotations balance the tree by box area rather
+// than by height, which is what query cost follows; even sorted insertions
+// stay within a small multiple of log2 of the proxy count in height. Leaves
+// are stored fattened by a margin so objects moving a little do not touch
+// the tree.
+//
+// Queries do not walk the binary tree. Flatten copies it into nodes of four
+// children stored as structure-of-arrays boxes in depth-first order, and each
+// query tests the four children of a node at once. Queries see the tree as of
+// the last Flatten and may run on several threads at the same time.
+
+struct Aabb
+{
+    XMFLOAT3 Min;
+    XMFLOAT3 Max;
+};
+
+Aabb MakeAabb(const XMFLOAT3& center, const XMFLOAT3& extents);
+
+struct RayHit
+{
+    uint32_t UserData;
+    float Distance;     // Along the ray, in units of the direction's length.
+};
+
+const uint32_t NullProxy = 0xFFFFFFFF;
+
+class AabbTree
+{
+public:
+    // margin fattens the stored box of every proxy on each side.
+    explicit AabbTree(float margin = 0.1f);
+
+    // Add an object. userData is what queries report for it and must be
+    // below 2^31 - 1. Returns the proxy, stable until DestroyProxy.
+    uint32_t CreateProxy(const Aabb& bounds, uint32_t userData);
+    void DestroyProxy(uint32_t proxy);
+    void Clear();
+
+    // The object moved. Nothing changes while bounds stays inside the
+    // proxy's fattened box and that box is not too loose; otherwise the leaf
+    // is taken out and inserted again. Returns true if it was.
+    bool MoveProxy(uint32_t proxy, const Aabb& bounds);
+
+    // Set a proxy's box to exactly bounds without moving it in the tree and
+    // mark its ancestors. Refit then only revisits the marked nodes. Cheaper
+    // than MoveProxy when most objects change every frame but stay close to
+    // their neighbours, at the cost of the tree getting looser over time.
+    void SetProxyBounds(uint32_t proxy, const Aabb& bounds);
+    void Refit();
+
+    // Copy the tree into the four-wide layout queries read.
+    void Flatten();
+
+    // Append the user data of every proxy whose box may be inside the
+    // frustum. Whole subtrees inside every plane are appended untested.
+    void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const;
+    // Append the user data of every proxy whose box overlaps the box or the
+    // sphere.
+    void QueryAabb(const Aabb& bounds, std::vector<uint32_t>& results) const;
+    void QuerySphere(const XMFLOAT3& center, float radius, std::vector<uint32_t>& results) const;
+    // The proxy box the ray enters first within maxDistance, nearer children
+    // first. A ray starting inside a box hits it at distance 0. Returns false
+    // if it hits none.
+    bool RayCast(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, RayHit& hit) const;
+
+    const Aabb& GetFatBounds(uint32_t proxy) const { return m_Nodes[proxy].Bounds; }
+    uint32_t GetUserData(uint32_t proxy) const { return m_Nodes[proxy].UserData; }
+
+    uint32_t GetProxyCount() const { return m_ProxyCount; }
+    // Box around every proxy's fattened box, pending Refit aside. Returns
+    // false if the tree is empty.
+    bool GetBounds(Aabb& bounds) const;
+    uint32_t GetHeight() const;
+    // Surface area of all internal nodes over the root's; lower is better.
+    float GetAreaRatio() const;
+    uint32_t GetFlatNodeCount() const { return static_cast<uint32_t>(m_FlatNodes.size()); }
+    // Rotations done since the tree was created.
+    uint32_t GetRotationCount() const { return m_RotationCount; }
+
+    // Check parent links, heights and that every node's box is the union of
+    // its children's.
+    bool Validate() const;
+
+private:
+    struct Node
+    {
+        Aabb Bounds;
+        uint32_t Parent;            // Next free node while on the free list.
+        uint32_t Child1, Child2;    // NullProxy for leaves.
+        uint32_t UserData;
+        int32_t Height;             // 0 for leaves, -1 for free nodes.
+        bool Dirty;                 // A descendant's box changed since the last Refit.
+
+        bool IsLeaf() const { return Child1 == NullProxy; }
+    };
+
+    // Four children: their boxes one coordinate per vector, then either the
+    // index of a FlatNode or FlatLeaf with the user data.
+    struct FlatNode
+    {
+        XMFLOAT4 MinX, MinY, MinZ;
+        XMFLOAT4 MaxX, MaxY, MaxZ;
+        uint32_t Children[4];
+    };
+
+    uint32_t AllocateNode();
+    void FreeNode(uint32_t index);
+    void InsertLeaf(uint32_t leaf);
+    void RemoveLeaf(uint32_t leaf);
+    // Walk from index to the root, rotating and refitting every node.
+    void FixUpwards(uint32_t index);
+    void Rotate(uint32_t index);
+    void UpdateNode(uint32_t index);
+    void RefitNode(uint32_t index);
+
+    uint32_t FlattenNode(uint32_t index);
+    void AppendSubtree(uint32_t flatIndex, std::vector<uint32_t>& results) const;
+    bool ValidateNode(uint32_t index, uint32_t& leafCount) const;
+
+    float m_Margin;
+    std::vector<Node> m_Nodes;
+    uint32_t m_Root;
+    uint32_t m_FreeList;
+    uint32_t m_ProxyCount;
+    uint32_t m_RotationCount;
+    bool m_RefitPending;
+
+    std::vector<FlatNode> m_FlatNodes;
+};
@@ -1,27 +1,113 @@
 #pragma once
+#include <cstdint>
 #include <DirectXMath.h>
+#include "FrustumCulling.h"
 using namespace DirectX;
 typedef XMVECTOR XMQUATERNION;
 
+XMFLOAT4 VectorToFloat4(const XMVECTOR& V);
+
+// How depth is mapped by the projection.
+enum DepthMode
+{
+    DM_Standard,            // 0 at the near plane, 1 at the far plane.
+    DM_ReversedInfinite,    // 1 at the near plane, 0 at infinity. Spreads float
+                            // precision evenly over distance; clear to 0 and
+                            // test with GREATER.
+};
+
+// Left-handed perspective projection. FarZ bounds the frustum planes and
+// corners in both depth modes, so culling stays finite when depth does not.
+struct CameraProjection
+{
+    float FieldOfViewY;     // Degrees.
+    float AspectRatio;
+    float NearZ;
+    float FarZ;
+    DepthMode Depth;
+
+    CameraProjection()
+        : FieldOfViewY(45.0f)
+        , AspectRatio(16.0f / 9.0f)
+        , NearZ(0.1f)
+        , FarZ(100.0f)
+        , Depth(DM_Standard)
+    {}
+};
+
+// Sub-pixel offset for frame frameIndex, in pixels within [-0.5, 0.5), from
+// the Halton (2, 3) sequence. Repeats every 16 frames.
+XMFLOAT2 GetJitterOffset(uint64_t frameIndex);
+
+// A camera whose matrices, frustum planes and corners are derived on the
+// first request after the position, orientation, projection or jitter
+// changes, and cached until the next change. Any query brings every derived
+// value up to date, so a camera that has answered one can be read from
+// several threads; the first query after a change must not race others.
 class Camera
 {
-private:
-    XMQUATERNION orientation;
-    XMVECTOR upVector;
-    XMVECTOR position;
-    XMVECTOR lookAt; //position-vector
 public:
+    Camera();
+    ~Camera();
 
     // Mutators
-    void Translate(XMVECTOR& translation);
-    void TranslateLocal(XMVECTOR& translation);
-    void Rotate(XMVECTOR axis, float angleDegrees);
+    void Translate(FXMVECTOR translation);
+    void TranslateLocal(FXMVECTOR translation);
+    void Rotate(FXMVECTOR axis, float angleDegrees);
+    void SetPosition(FXMVECTOR position);
+    void SetOrientation(FXMVECTOR orientation);
+    void SetProjection(const CameraProjection& projection);
+    // Shift the projection by offset pixels of a viewport of the given size,
+    // e.g. by GetJitterOffset(frame). (0, 0) turns jitter off.
+    void SetJitter(const XMFLOAT2& offset, float viewportWidth, float viewportHeight);
 
     // Accessors
-    XMMATRIX GetViewMatrix();
-    const XMVECTOR& GetPositionVector() { return position; }
-    XMFLOAT4 GetPositionFloat();
-    XMFLOAT4 GetForwardDirectionFloat();
-    Camera();
-    ~Camera();
-};
\ No newline at end of file
+    const XMVECTOR& GetPositionVector() const { return m_Position; }
+    const XMQUATERNION& GetOrientation() const { return m_Orientation; }
+    XMFLOAT4 GetPositionFloat() const;
+    const XMVECTOR& GetForwardVector() const;
+    XMFLOAT4 GetForwardDirectionFloat() const;
+    const CameraProjection& GetProjection() const { return m_ProjectionSettings; }
+
+    const XMMATRIX& GetViewMatrix() const;
+    // Includes the jitter.
+    const XMMATRIX& GetProjectionMatrix() const;
+    const XMMATRIX& GetViewProjectionMatrix() const;
+    // Takes clip space positions, depth included, back to world space.
+    const XMMATRIX& GetInverseViewProjectionMatrix() const;
+    // World-space planes, normals pointing in, in Frustum order. The far
+    // plane is at FarZ in both depth modes.
+    const Frustum& GetFrustum() const;
+    // World-space corners: the near plane then the FarZ plane, each as bottom
+    // left, bottom right, top left, top right.
+    const XMFLOAT3* GetFrustumCorners() const;
+
+    // Camera between two others: position lerped, orientation slerped. The
+    // projection and jitter are those of to.
+    static Camera Interpolate(const Camera& from, const Camera& to, float alpha);
+
+private:
+    // Rebuild whatever the changes since the last call invalidated.
+    void Update() const;
+
+    XMQUATERNION m_Orientation;
+    XMVECTOR m_UpVector;
+    XMVECTOR m_Position;
+
+    CameraProjection m_ProjectionSettings;
+    XMFLOAT2 m_JitterClip;  // Jitter in clip space units.
+
+    // Derived values. m_ViewDirty covers the forward vector and the view
+    // matrix, m_ProjectionDirty the projection matrices; the products, the
+    // planes and the corners are rebuilt when either is set.
+    mutable bool m_ViewDirty;
+    mutable bool m_ProjectionDirty;
+    mutable XMVECTOR m_Forward;
+    mutable XMMATRIX m_View;
+    mutable XMMATRIX m_Projection;
+    mutable XMMATRIX m_CullingProjection;
+    mutable XMMATRIX m_ViewProjection;
+    mutable XMMATRIX m_InverseViewProjection;
+    mutable Frustum m_Frustum;
+    mutable XMFLOAT3 m_Corners[8];
+};
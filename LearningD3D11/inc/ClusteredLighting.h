@@ -0,0 +1,124 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "ShaderTypes.h"
+using namespace DirectX;
+
+// Clustered forward light culling.
+//
+// The view frustum is split into a 3D grid: X and Y into screen tiles, Z into
+// slices spaced exponentially in view depth. Every enabled light is bounded
+// by a view-space sphere of its range, and each cluster gets the list of
+// lights whose sphere touches its view-space AABB within the cluster's screen
+// tile, so a light that only reaches a corner of the AABB outside the tile is
+// left out. The pixel shader finds its cluster from SV_Position and view
+// depth and only evaluates those lights.
+
+const uint32_t ClusterCountX = 16;
+const uint32_t ClusterCountY = 9;
+const uint32_t ClusterCountZ = 24;
+const uint32_t ClusterCount = ClusterCountX * ClusterCountY * ClusterCountZ;
+
+// Attenuated intensity below which a light is treated as having no effect.
+const float DefaultLightCutoff = 1.0f / 256.0f;
+
+// Distance at which the light's intensity (its brightest color channel times
+// the attenuation) falls to cutoff. Directional lights, and point or spot
+// lights whose attenuation never gets that low, return FLT_MAX.
+float ComputeLightRange(const Light& light, float cutoff);
+
+// A cluster's slice of the light index list. Matches uint2 in the shader.
+struct ClusterLightRange
+{
+    uint32_t Offset;
+    uint32_t Count;
+};
+
+// Everything the pixel shader needs to find its cluster. Must match the
+// ClusterParameters cbuffer in Lighting.hlsli.
+struct alignas(16) ClusterConstants
+{
+    XMMATRIX ViewMatrix;
+    //----------------------------------- (16 byte boundary)
+    uint32_t ClusterCountX;
+    uint32_t ClusterCountY;
+    uint32_t ClusterCountZ;
+    uint32_t Padding;
+    //----------------------------------- (16 byte boundary)
+    float TileSizeX;        // In pixels.
+    float TileSizeY;
+    float SliceScale;       // slice = log(viewDepth) * SliceScale + SliceBias
+    float SliceBias;
+    //----------------------------------- (16 byte boundary)
+    // Total:                             96 bytes (6 * 16)
+};
+
+class LightClusterGrid
+{
+public:
+    LightClusterGrid();
+
+    // Rebuild the cluster bounds for a left-handed perspective projection.
+    // Call whenever the projection or the viewport changes.
+    void SetProjection(FXMMATRIX projection, float viewportWidth, float viewportHeight);
+    // As above, with the depth range of the grid given rather than read from
+    // the projection, as for a reversed-Z infinite projection. Only the field
+    // of view is taken from projection.
+    void SetProjection(FXMMATRIX projection, float viewportWidth, float viewportHeight, float nearZ, float farZ);
+
+    // Assign lights to clusters for this view. Lights are bounded in
+    // parallel, then every depth slice fills its clusters in parallel. Within
+    // a cluster, light indices are in increasing order.
+    void AssignLights(FXMMATRIX view, const Light* lights, size_t lightCount,
+        float cutoff = DefaultLightCutoff, unsigned int threadCount = 0);
+
+    // Indexed by x + ClusterCountX * (y + ClusterCountY * z), with y = 0 at
+    // the top of the screen.
+    const std::vector<ClusterLightRange>& GetClusterRanges() const { return m_ClusterRanges; }
+    const std::vector<uint32_t>& GetLightIndices() const { return m_LightIndices; }
+    const ClusterConstants& GetConstants() const { return m_Constants; }
+
+    uint32_t GetSlice(float viewDepth) const;
+
+private:
+    struct ClusterBounds
+    {
+        XMFLOAT3 Min;
+        XMFLOAT3 Max;
+    };
+
+    // View-space bounding sphere and cluster index ranges of one light.
+    struct LightBounds
+    {
+        XMFLOAT4 Sphere;    // w is the radius, FLT_MAX for unbounded lights.
+        uint8_t MinX, MaxX, MinY, MaxY, MinZ, MaxZ;
+        bool Visible;
+    };
+
+    // Light indices of one slice, grouped by cluster.
+    struct SliceLights
+    {
+        std::vector<uint32_t> Counts;
+        std::vector<uint32_t> Indices;
+        std::vector<uint32_t> Pairs;    // cluster << 24 | light, before grouping.
+    };
+
+    void BoundLight(FXMMATRIX view, const Light& light, float cutoff, LightBounds& bounds) const;
+    // Tiles overlapped by a view-space box, written to bounds' X and Y ranges.
+    // False if the box is outside the view.
+    bool GetTileRange(float x, float y, float radius, float minDepth, float maxDepth, LightBounds& bounds) const;
+    void FillSlice(uint32_t slice, size_t lightCount, SliceLights& sliceLights) const;
+
+    float m_Near, m_Far;
+    float m_TanHalfFovX, m_TanHalfFovY;
+
+    ClusterConstants m_Constants;
+    std::vector<ClusterBounds> m_ClusterBounds;
+    std::vector<LightBounds> m_LightBounds;
+    std::vector<SliceLights> m_SliceLights;
+
+    std::vector<ClusterLightRange> m_ClusterRanges;
+    std::vector<uint32_t> m_LightIndices;
+};
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "RenderQueue.h"
+
+// RenderContext that records its calls into a compact byte stream, to be
+// replayed on another RenderContext later. Lists are independent, so worker
+// threads can record one each in parallel; replaying them in order on the
+// D3D11 backend (on deferred contexts, see D3D11DeferredContexts), on a
+// RecordingRenderContext or on any other backend issues the same calls.
+//
+// Each command is a one byte CommandListOp followed by its arguments, in
+// host byte order (a list never leaves the process) and unaligned:
+//   SetInputLayout, SetVertexShader,
+//   SetPixelShader, SetIndexBuffer     u8 id
+//   SetVertexBuffers                   u8 vertex buffer, u8 instance buffer
+//   SetObjectConstants                 u32 index
+//   SetMaterial                        u16 index
+//   DrawIndexedInstanced               u32 index count, u32 instance count,
+//                                      u32 start index, i32 base vertex,
+//                                      u32 start instance
+// so a draw with a new object constant slice takes 26 bytes.
+
+enum CommandListOp : uint8_t
+{
+    CLO_SetInputLayout,
+    CLO_SetVertexShader,
+    CLO_SetPixelShader,
+    CLO_SetVertexBuffers,
+    CLO_SetIndexBuffer,
+    CLO_SetObjectConstants,
+    CLO_SetMaterial,
+    CLO_DrawIndexedInstanced,
+    NumCommandListOps
+};
+
+class CommandList : public RenderContext
+{
+public:
+    CommandList() : m_CommandCount(0), m_DrawCount(0) {}
+
+    void Clear();
+    void Reserve(size_t byteCount) { m_Bytes.reserve(byteCount); }
+
+    void SetInputLayout(uint8_t inputLayout) override;
+    void SetVertexShader(uint8_t vertexShader) override;
+    void SetPixelShader(uint8_t pixelShader) override;
+    void SetVertexBuffers(uint8_t vertexBuffer, uint8_t instanceBuffer) override;
+    void SetIndexBuffer(uint8_t indexBuffer) override;
+    void SetObjectConstants(uint32_t objectConstants) override;
+    void SetMaterial(uint16_t material) override;
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex,
+        uint32_t startInstance) override;
+
+    // Issue the recorded calls on context, in recording order.
+    void Replay(RenderContext& context) const;
+
+    const uint8_t* GetData() const { return m_Bytes.data(); }
+    size_t GetSize() const { return m_Bytes.size(); }
+    uint32_t GetCommandCount() const { return m_CommandCount; }
+    uint32_t GetDrawCount() const { return m_DrawCount; }
+
+private:
+    uint8_t* Append(CommandListOp op, size_t argumentSize);
+
+    std::vector<uint8_t> m_Bytes;
+    uint32_t m_CommandCount;
+    uint32_t m_DrawCount;
+};
+
+// Replay a stream written by CommandList (e.g. one saved to a file). Returns
+// false, after issuing the commands before it, at the first command that is
+// unknown or cut short.
+bool ReplayCommandStream(const uint8_t* data, size_t size, RenderContext& context);
+
+// Record the packets of one pass of a queue into listCount lists, each
+// getting a contiguous slice of the pass, on up to threadCount threads (0
+// for the default). Every list starts with an invalidated RenderStateCache,
+// so it binds all the state its first draw needs; replaying the lists in
+// order draws exactly what RenderQueue::Execute does for the pass. Lists
+// beyond the pass's packet count are left empty.
+void RecordCommandLists(const RenderQueue& queue, RenderPass pass, CommandList* lists, size_t listCount,
+    unsigned int threadCount = 0);
@@ -0,0 +1,59 @@
+#pragma once
+#include <d3d11_1.h>
+#include <vector>
+#include "UploadRing.h"
+
+// Range of a constant buffer, in 16 byte constants, as taken by
+// *SetConstantBuffers1.
+struct ConstantBufferSlice
+{
+    UINT FirstConstant;
+    UINT NumConstants;
+};
+
+// One large dynamic constant buffer that every cbuffer of a frame is
+// sub-allocated from, bound with D3D11.1 constant buffer offsets. Up to
+// framesInFlight frames share the ring; an event query issued at the end of
+// each frame tells when its slices can be overwritten, so writes use
+// D3D11_MAP_WRITE_NO_OVERWRITE and never stall on or rename the buffer.
+class D3D11ConstantBufferRing
+{
+public:
+    D3D11ConstantBufferRing();
+    ~D3D11ConstantBufferRing();
+
+    // Fails if the device lacks constant buffer offsetting or no-overwrite
+    // maps of dynamic constant buffers.
+    bool Create(ID3D11Device* device, ID3D11DeviceContext* deviceContext, UINT size, unsigned int framesInFlight);
+    void Destroy();
+
+    // Wait until the frame that last used this frame's query slot has
+    // finished on the GPU and release its space.
+    void BeginFrame();
+    // Mark the end of the frame's GPU work.
+    void EndFrame();
+
+    // Allocate between Map and Unmap. Allocate copies size bytes into a new
+    // 256 byte aligned slice; if the ring is full it waits for the oldest
+    // frame in flight. Returns false if size can never fit.
+    bool Map();
+    bool Allocate(const void* data, UINT size, ConstantBufferSlice& slice);
+    void Unmap();
+
+    ID3D11Buffer* GetBuffer() const { return m_Buffer; }
+
+private:
+    void WaitForFrame(uint64_t frameNumber);
+
+    ID3D11DeviceContext* m_DeviceContext;
+    ID3D11Buffer* m_Buffer;
+    UploadRing m_Ring;
+
+    // One event query per frame in flight, indexed by frame number.
+    std::vector<ID3D11Query*> m_FrameQueries;
+    uint64_t m_FrameNumber;
+    uint64_t m_CompletedFrameNumber;
+
+    unsigned char* m_MappedData;
+    bool m_FirstMap;
+};
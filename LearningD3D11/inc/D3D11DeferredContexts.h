@@ -0,0 +1,57 @@
+#pragma once
+#include <d3d11_1.h>
+#include <functional>
+#include <vector>
+#include "CommandList.h"
+#include "D3D11RenderContext.h"
+
+// Deferred contexts that turn CommandLists into ID3D11CommandLists on worker
+// threads, for the immediate context to execute in order. Recording the
+// D3D11 calls is where the CPU cost of a draw goes, so with one list per
+// worker the submission cost of a pass is spread over the workers; the
+// immediate context only pays for ExecuteCommandList.
+//
+// Deferred contexts start every recording from the default pipeline state,
+// so state the lists rely on without recording it (render targets, viewport,
+// rasterizer and depth states, samplers, shader resources, shared constant
+// buffers) is bound on each one by a callback first. When the driver does
+// not support command lists natively the runtime emulates them, which still
+// works but does not save any CPU time.
+class D3D11DeferredContexts
+{
+public:
+    typedef std::function<void(ID3D11DeviceContext1* deviceContext)> BindStateFunction;
+
+    D3D11DeferredContexts();
+    ~D3D11DeferredContexts();
+
+    bool Create(ID3D11Device* device, unsigned int contextCount);
+    void Destroy();
+
+    unsigned int GetContextCount() const { return static_cast<unsigned int>(m_Contexts.size()); }
+    // True if the driver records command lists itself rather than leaving
+    // it to the runtime.
+    bool HasDriverCommandLists() const { return m_DriverCommandLists; }
+
+    // Replay lists[i] on deferred context i (count <= GetContextCount()) on up
+    // to threadCount threads (0 for the default), after bindState. The id
+    // registrations and this frame's constant slices come from renderContext.
+    // Returns false if a command list could not be finished; the lists that
+    // were are still executed.
+    bool Record(const CommandList* lists, size_t count, const D3D11RenderContext& renderContext,
+        const BindStateFunction& bindState, unsigned int threadCount = 0);
+
+    // Execute the command lists of the last Record in order and release them.
+    // The immediate context's state is left at the defaults afterwards.
+    void Execute(ID3D11DeviceContext* immediateContext);
+
+private:
+    D3D11DeferredContexts(const D3D11DeferredContexts&) = delete;
+    D3D11DeferredContexts& operator=(const D3D11DeferredContexts&) = delete;
+
+    void ReleaseCommandLists();
+
+    std::vector<ID3D11DeviceContext1*> m_Contexts;
+    std::vector<ID3D11CommandList*> m_CommandLists;    // nullptr for empty lists.
+    bool m_DriverCommandLists;
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <d3d11.h>
+#include <cstdint>
+#include <vector>
+#include "Profiler.h"
+
+// GPU zones from timestamp queries, recorded on a "GPU" track of the
+// Profiler.
+//
+// Each frame gets a disjoint query, a start timestamp and a begin/end pair of
+// timestamps per zone. The results are read back framesInFlight frames later,
+// when the frame's query set comes round again, so the profiler never stalls
+// the pipeline; a frame whose results are not ready by then, or whose clock
+// was disjoint, is skipped. GPU time is placed on the CPU timeline by lining
+// up the frame's start timestamp with the CPU time of its BeginFrame, so GPU
+// zones show their durations and their order within a frame, not how far the
+// GPU trails the CPU.
+class D3D11GpuProfiler
+{
+public:
+    D3D11GpuProfiler();
+    ~D3D11GpuProfiler();
+
+    // Up to maxZones zones per frame; later ones are not timed.
+    bool Create(ID3D11Device* device, ID3D11DeviceContext* deviceContext, unsigned int framesInFlight, unsigned int maxZones);
+    void Destroy();
+
+    // Bracket a frame's GPU work. BeginFrame records the zones of the frame
+    // that last used this frame's queries. Nothing is timed while the
+    // Profiler is disabled.
+    void BeginFrame();
+    void EndFrame();
+
+    // Zones nest and must close in the frame that opened them.
+    void BeginZone(const char* name);
+    void EndZone();
+
+    uint64_t GetSkippedFrameCount() const { return m_SkippedFrameCount; }
+
+private:
+    D3D11GpuProfiler(const D3D11GpuProfiler&) = delete;
+    D3D11GpuProfiler& operator=(const D3D11GpuProfiler&) = delete;
+
+    struct Zone
+    {
+        const char* Name;
+        ID3D11Query* Begin;
+        ID3D11Query* End;
+        uint32_t Depth;
+    };
+
+    struct Frame
+    {
+        ID3D11Query* Disjoint;
+        ID3D11Query* Start;
+        std::vector<Zone> Zones;    // maxZones query pairs.
+        uint32_t ZoneCount;
+        int64_t CpuStart;
+        bool Pending;               // Issued and not yet read back.
+    };
+
+    void ReadBack(Frame& frame);
+
+    ID3D11DeviceContext* m_DeviceContext;
+    std::vector<Frame> m_Frames;
+    uint64_t m_FrameNumber;
+    Frame* m_CurrentFrame;          // nullptr outside an active frame.
+    std::vector<uint32_t> m_OpenZones;
+    uint32_t m_Track;
+    uint64_t m_SkippedFrameCount;
+};
+
+// Times its lifetime on the GPU. The profiler may be nullptr.
+class GpuProfileScope
+{
+public:
+    GpuProfileScope(D3D11GpuProfiler* profiler, const char* name)
+        : m_Profiler(profiler)
+    {
+        if (m_Profiler)
+        {
+            m_Profiler->BeginZone(name);
+        }
+    }
+
+    ~GpuProfileScope()
+    {
+        if (m_Profiler)
+        {
+            m_Profiler->EndZone();
+        }
+    }
+
+private:
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+    D3D11GpuProfiler* m_Profiler;
+};
+
+#if PROFILER_ENABLED
+#define GPU_PROFILE_SCOPE(profiler, name) GpuProfileScope PROFILE_CONCATENATE(gpuProfileScope, __LINE__)(profiler, name)
+#else
+#define GPU_PROFILE_SCOPE(profiler, name) ((void)0)
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+#include <d3d11.h>
+#include "MaterialTable.h"
+
+// GPU copy of a MaterialTable: a structured buffer of MaterialProperties and
+// its shader resource view, read by InstancedPixelShader at t1.
+class D3D11MaterialTable
+{
+public:
+    D3D11MaterialTable();
+    ~D3D11MaterialTable();
+
+    bool Create(ID3D11Device* device, uint32_t capacity);
+    void Destroy();
+
+    // Copy the table's dirty ranges into the buffer and clear them. The
+    // buffer is recreated (and fully uploaded) if the table has outgrown it.
+    bool Update(ID3D11DeviceContext* deviceContext, MaterialTable& table);
+
+    ID3D11ShaderResourceView* GetShaderResourceView() const { return m_ShaderResourceView; }
+    uint32_t GetCapacity() const { return m_Capacity; }
+
+private:
+    ID3D11Device* m_Device;
+    ID3D11Buffer* m_Buffer;
+    ID3D11ShaderResourceView* m_ShaderResourceView;
+    uint32_t m_Capacity;
+};
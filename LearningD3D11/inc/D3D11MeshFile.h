@@ -0,0 +1,16 @@
+#pragma once
+#include <d3d11.h>
+#include "MeshFile.h"
+
+// Create immutable vertex and index buffers from a mapped mesh file. The
+// mapped sections are passed to CreateBuffer as the initial data, so the only
+// copy is the one the driver makes into GPU memory. Fails if a section is
+// empty or larger than the resource size every device must support.
+bool CreateMeshFileBuffers(ID3D11Device* device, const MappedMeshFile& file,
+    ID3D11Buffer** vertexBuffer, ID3D11Buffer** indexBuffer);
+
+DXGI_FORMAT GetMeshFileIndexFormat(const MeshFileHeader& header);
+
+// Input elements for the file's attribute table in input slot 0. Writes
+// header.AttributeCount elements.
+void GetMeshFileInputElements(const MeshFileHeader& header, D3D11_INPUT_ELEMENT_DESC* elements);
@@ -0,0 +1,88 @@
+#pragma once
+#include <d3d11_1.h>
+#include <vector>
+#include "D3D11ConstantBufferRing.h"
+#include "D3D11ShaderCache.h"
+#include "RenderQueue.h"
+#include "ShaderTypes.h"
+
+// RenderContext backed by an ID3D11DeviceContext1. Objects are registered
+// under the ids that draw packets use; the context does not take ownership.
+// Shaders are registered as shader archive entries and created by the shader
+// cache the first time a packet binds them.
+//
+// Constants live in slices of a single ring buffer (D3D11ConstantBufferRing)
+// and are bound with offsets. Vertex shader slot 0 holds either the draw's
+// per-object slice or, for instanced packets, the per-frame slice, matching
+// SimpleVertexShader and InstancedVertexShader. A packet whose pixel shader
+// is NoResource draws depth only.
+class D3D11RenderContext : public RenderContext
+{
+public:
+    D3D11RenderContext(ID3D11DeviceContext1* deviceContext, D3D11ShaderCache* shaderCache);
+
+    // Issue calls on another context, e.g. a deferred context working from a
+    // copy of this one's registrations and slices.
+    void SetDeviceContext(ID3D11DeviceContext1* deviceContext) { m_DeviceContext = deviceContext; }
+
+    void RegisterInputLayout(uint8_t id, ID3D11InputLayout* inputLayout);
+    void RegisterVertexShader(uint8_t id, uint32_t shaderEntry);
+    void RegisterPixelShader(uint8_t id, uint32_t shaderEntry);
+    void RegisterVertexBuffer(uint8_t id, ID3D11Buffer* buffer, UINT stride);
+    void RegisterIndexBuffer(uint8_t id, ID3D11Buffer* buffer, DXGI_FORMAT format);
+
+    // The ring buffer and this frame's slices. ObjectConstants and Material
+    // index into the slice arrays, which must stay valid while packets are
+    // executed.
+    void SetConstantBuffer(ID3D11Buffer* constantBuffer);
+    void SetFrameConstants(const ConstantBufferSlice& perFrame);
+    void SetObjectConstantSlices(const ConstantBufferSlice* objectConstants);
+    void SetMaterialSlices(const ConstantBufferSlice* materials);
+
+    void SetInputLayout(uint8_t inputLayout) override;
+    void SetVertexShader(uint8_t vertexShader) override;
+    void SetPixelShader(uint8_t pixelShader) override;
+    void SetVertexBuffers(uint8_t vertexBuffer, uint8_t instanceBuffer) override;
+    void SetIndexBuffer(uint8_t indexBuffer) override;
+    void SetObjectConstants(uint32_t objectConstants) override;
+    void SetMaterial(uint16_t material) override;
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex,
+        uint32_t startInstance) override;
+
+private:
+    template<typename T>
+    static void Register(std::vector<T>& table, uint8_t id, const T& value)
+    {
+        if (table.size() <= id)
+        {
+            table.resize(id + 1);
+        }
+        table[id] = value;
+    }
+
+    struct VertexBuffer
+    {
+        ID3D11Buffer* Buffer;
+        UINT Stride;
+    };
+
+    struct IndexBuffer
+    {
+        ID3D11Buffer* Buffer;
+        DXGI_FORMAT Format;
+    };
+
+    ID3D11DeviceContext1* m_DeviceContext;
+    D3D11ShaderCache* m_ShaderCache;
+
+    std::vector<ID3D11InputLayout*> m_InputLayouts;
+    std::vector<uint32_t> m_VertexShaders;     // Shader archive entries.
+    std::vector<uint32_t> m_PixelShaders;
+    std::vector<VertexBuffer> m_VertexBuffers;
+    std::vector<IndexBuffer> m_IndexBuffers;
+
+    ID3D11Buffer* m_ConstantBuffer;
+    ConstantBufferSlice m_FrameConstants;
+    const ConstantBufferSlice* m_ObjectConstants;
+    const ConstantBufferSlice* m_Materials;
+};
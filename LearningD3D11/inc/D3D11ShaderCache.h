@@ -0,0 +1,44 @@
+#pragma once
+#include <d3d11.h>
+#include <mutex>
+#include <vector>
+#include "ShaderArchive.h"
+
+// Shader objects for the entries of a ShaderArchive, created from the mapped
+// bytecode the first time each one is asked for and kept until Destroy.
+// Shaders that are never drawn with cost nothing beyond their table entry.
+// The getters may be called from several threads at once, as worker threads
+// recording command lists do.
+class D3D11ShaderCache
+{
+public:
+    D3D11ShaderCache();
+    ~D3D11ShaderCache();
+
+    // The archive must stay open until Destroy.
+    void Create(ID3D11Device* device, const ShaderArchive& archive);
+    void Destroy();
+
+    // The shader of an archive entry, or nullptr if the entry is invalid or
+    // the device rejects the bytecode. A failed entry is not retried.
+    ID3D11VertexShader* GetVertexShader(uint32_t entry);
+    ID3D11PixelShader* GetPixelShader(uint32_t entry);
+
+    uint32_t GetCreatedCount() const { return m_CreatedCount; }
+
+private:
+    D3D11ShaderCache(const D3D11ShaderCache&) = delete;
+    D3D11ShaderCache& operator=(const D3D11ShaderCache&) = delete;
+
+    struct CachedShader
+    {
+        ID3D11DeviceChild* Shader;
+        bool Failed;
+    };
+
+    ID3D11Device* m_Device;
+    const ShaderArchive* m_Archive;
+    std::vector<CachedShader> m_Shaders;   // Indexed by entry.
+    std::mutex m_Mutex;                     // Guards m_Shaders and m_CreatedCount.
+    uint32_t m_CreatedCount;
+};
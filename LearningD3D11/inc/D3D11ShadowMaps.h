@@ -0,0 +1,38 @@
+#pragma once
+#include <d3d11.h>
+#include <vector>
+
+// Shadow maps as the slices of one depth texture array: a depth-stencil
+// view per slice to draw casters into, and one shader resource view over all
+// of them with the comparison sampler the pixel shaders filter it with.
+// Casters are drawn with a slope-scaled depth bias so lit surfaces do not
+// shadow themselves, and without depth clipping so casters nearer the light
+// than the map still land on its near plane.
+class D3D11ShadowMaps
+{
+public:
+    D3D11ShadowMaps();
+    ~D3D11ShadowMaps();
+
+    bool Create(ID3D11Device* device, UINT resolution, UINT sliceCount);
+    void Destroy();
+
+    // Clear a slice and bind it as the only output, with the viewport and
+    // states for drawing casters. The shader resource view must not be bound
+    // while a slice is.
+    void BeginSlice(ID3D11DeviceContext* deviceContext, UINT slice);
+
+    ID3D11ShaderResourceView* GetShaderResourceView() const { return m_ShaderResourceView; }
+    ID3D11SamplerState* GetSampler() const { return m_Sampler; }
+    UINT GetResolution() const { return m_Resolution; }
+    UINT GetSliceCount() const { return static_cast<UINT>(m_DepthStencilViews.size()); }
+
+private:
+    ID3D11Texture2D* m_Texture;
+    std::vector<ID3D11DepthStencilView*> m_DepthStencilViews;
+    ID3D11ShaderResourceView* m_ShaderResourceView;
+    ID3D11SamplerState* m_Sampler;
+    ID3D11RasterizerState* m_RasterizerState;
+    ID3D11DepthStencilState* m_DepthStencilState;
+    UINT m_Resolution;
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <d3d11.h>
+
+// Dynamic structured buffer rewritten by the CPU every frame, with a shader
+// resource view over its contents. Grows when more elements are written than
+// it can hold.
+class D3D11StructuredBuffer
+{
+public:
+    D3D11StructuredBuffer();
+    ~D3D11StructuredBuffer();
+
+    bool Create(ID3D11Device* device, UINT stride, UINT capacity);
+    void Destroy();
+
+    // Replace the contents with count elements (WRITE_DISCARD).
+    bool Update(ID3D11DeviceContext* deviceContext, const void* data, UINT count);
+
+    ID3D11ShaderResourceView* GetShaderResourceView() const { return m_ShaderResourceView; }
+    UINT GetCapacity() const { return m_Capacity; }
+
+private:
+    ID3D11Device* m_Device;
+    ID3D11Buffer* m_Buffer;
+    ID3D11ShaderResourceView* m_ShaderResourceView;
+    UINT m_Stride;
+    UINT m_Capacity;
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <d3d11.h>
+#include <vector>
+#include "TextureStreaming.h"
+
+// Streamed textures as Texture2Ds of the image's format (RGBA8 or BC1/3/7,
+// optionally sRGB) holding only their resident mips. Every Upload creates a new immutable texture from the image's mips;
+// Trim copies the remaining levels into a smaller texture on the GPU.
+class D3D11TextureUploadSink : public TextureUploadSink
+{
+public:
+    D3D11TextureUploadSink();
+    ~D3D11TextureUploadSink();
+
+    // Creates the placeholder, a 1x1 mid grey texture.
+    bool Create(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+    void Destroy();
+
+    bool Upload(TextureHandle texture, const TextureImage& image, uint32_t firstMip) override;
+    bool Trim(TextureHandle texture, uint32_t firstMip) override;
+
+    // The texture's view, or the placeholder's until its first mips are
+    // resident.
+    ID3D11ShaderResourceView* GetShaderResourceView(TextureHandle texture) const;
+
+private:
+    struct ResidentTexture
+    {
+        ID3D11Texture2D* Texture;
+        ID3D11ShaderResourceView* View;
+        uint32_t FirstMip;      // Of the full image.
+        uint32_t MipLevels;
+    };
+
+    bool CreateView(ID3D11Texture2D* texture, ID3D11ShaderResourceView** view);
+    void Replace(TextureHandle texture, ID3D11Texture2D* newTexture, ID3D11ShaderResourceView* newView, uint32_t firstMip, uint32_t mipLevels);
+
+    ID3D11Device* m_Device;
+    ID3D11DeviceContext* m_DeviceContext;
+    ID3D11Texture2D* m_Placeholder;
+    ID3D11ShaderResourceView* m_PlaceholderView;
+    std::vector<ResidentTexture> m_Textures;
+};
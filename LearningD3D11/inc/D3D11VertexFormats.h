@@ -0,0 +1,9 @@
+#pragma once
+#include <d3d11.h>
+#include "VertexFormats.h"
+
+// Input elements describing VertexPacked in input slot 0, for
+// PackedVertexShader and PackedInstancedVertexShader. Writes
+// PackedVertexElementCount elements.
+const UINT PackedVertexElementCount = 4;
+void GetPackedVertexElements(PositionEncoding encoding, D3D11_INPUT_ELEMENT_DESC* elements);
@@ -0,0 +1,14 @@
+#pragma once
+#include "TextureStreaming.h"
+
+// DDS container for cooked textures.
+//
+// WriteDDSFile writes a DX10 extended header with the DXGI format of the
+// image (R8G8B8A8, BC1, BC3 or BC7, UNORM or _SRGB) followed by every mip,
+// so the file opens in the usual tools and the runtime hands the mips to the
+// device as they are. ReadDDSFile accepts those files and legacy DXT1/DXT5
+// files from other tools.
+
+// File names are UTF-8.
+bool WriteDDSFile(const char* fileName, const TextureImage& image);
+bool ReadDDSFile(const char* fileName, TextureImage& image);
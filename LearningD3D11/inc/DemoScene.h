@@ -0,0 +1,137 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "BoundingVolumeHierarchy.h"
+#include "Camera.h"
+#include "LevelOfDetail.h"
+#include "MaterialTable.h"
+#include "Mesh.h"
+#include "OcclusionCulling.h"
+#include "Scene.h"
+#include "ShaderTypes.h"
+#include "ShadowMapping.h"
+
+// The demo's scene: a room of six walls, a spinning cube, the light gizmo,
+// a field of small spinning cubes and the lights. Device independent, so the
+// window app and the headless tests build and cull the same scene; the app
+// uploads what is built here.
+
+// Vertices and indices of a unit plane.
+extern VertexPosNormColTex g_PlaneVerts[4];
+const uint32_t g_NumPlaneIndices = 6;
+extern uint16_t g_PlaneIndex[g_NumPlaneIndices];
+
+// Number of instanced planes making up the room.
+const int g_NumPlaneInstances = 6;
+
+// Shared by the spinning cube, the light gizmo and the cube field in the
+// software renderer and the headless modes. The D3D path draws a cooked copy
+// instead.
+extern Mesh g_CubeMesh;
+
+// The light gizmo is an icosphere with one level of detail per subdivision
+// count, all in g_LightMesh. A cube has nothing coarser to fall back to, so
+// the cubes keep their single level. g_LightLodLevel is the level picked for
+// the current frame, and the starting point of the next frame's hysteresis.
+extern Mesh g_LightMesh;
+extern LodChain g_LightLodChain;
+extern LodSettings g_LodSettings;
+extern uint32_t g_LightLodLevel;
+
+// Materials are uploaded once to a structured buffer; instanced draws index
+// it per instance, so one draw can mix materials.
+extern MaterialTable g_MaterialTable;
+
+// Every light in the scene. The lit pixel shaders only loop over the lights
+// the cluster grid assigned to their cluster; g_LightProperties.Lights still
+// holds the main lights for the software renderer.
+const int g_NumSceneLights = 256;
+extern std::vector<Light> g_Lights;
+extern LightProperties g_LightProperties;
+
+// All objects other than the room walls are entities in the scene.
+extern Scene g_Scene;
+extern Entity g_SpinningCube;
+extern Entity g_LightCube;
+
+// Small spinning cubes drawn with the instanced vertex shader. The GPU draws
+// the whole field at once; entities are still sorted by material so the
+// software renderer can draw each material as one instanced draw.
+const int g_NumCubeFieldInstances = 100000;
+extern std::vector<Entity> g_CubeField;
+
+struct CubeFieldDraw
+{
+    uint32_t MaterialIndex;
+    uint32_t StartInstance;
+    uint32_t InstanceCount;
+};
+extern std::vector<CubeFieldDraw> g_CubeFieldDraws;
+
+// Every entity is a proxy in a dynamic AABB tree kept up to date every
+// frame. The cube field is frustum culled with it before the occlusion test,
+// and the app picks the entity under the cursor with it.
+extern AabbTree g_SceneTree;
+extern std::vector<uint32_t> g_SceneProxies;       // Proxy of each entity handle.
+extern std::vector<uint32_t> g_CubeFieldSlots;     // Position in g_CubeField of each entity handle, or NullProxy.
+
+// The spot light over the room and a directional light cast shadows, the
+// directional light's cascades first in the shadow map array. The walls
+// receive shadows but cast none, or the ceiling would shade the whole room
+// from the directional light. Every map's casters are culled with the scene
+// tree and written to their own range of the caster buffer, so a shadow pass
+// only draws what can land in its map.
+extern ShadowSettings g_ShadowSettings;
+// Casters in one map's range of the buffer: the cube field and the spinning cube.
+const uint32_t g_ShadowCasterCapacity = g_NumCubeFieldInstances + 1;
+extern uint32_t g_ShadowCascadeCount;
+extern uint32_t g_ShadowViewCount;
+extern ShadowView g_ShadowViews[MaxShadowViews];
+extern ShadowConstants g_ShadowConstants;
+// Scene tree candidates of each map, kept for inspection.
+extern std::vector<uint32_t> g_ShadowQueryResults[MaxShadowViews];
+
+void CreateCube(float size);
+void CreateLightMesh(float radius);
+// Pick the light gizmo's level of detail as seen from camera.
+void SelectLightLod(const Camera& camera, float viewportHeight);
+
+// Build the six walls of the room (floor, ceiling and four walls).
+void CreatePlaneInstances(PlaneInstanceData* planeInstanceData);
+void CreateMaterials();
+void CreateLights();
+// Give the first directional light the cascades and the first spot lights a
+// shadow map each, in g_Lights' ShadowIndex.
+void AssignShadowMaps();
+// Populate g_Scene with the spinning cube, the light gizmo and the cube field.
+void CreateSceneEntities();
+
+// Advance the scene by deltaTime: the spinning cube turns to spinAngle
+// degrees, the light gizmo follows the main light and the cube field moves.
+void StepScene(float deltaTime, float spinAngle);
+
+// World box of an entity. Every entity's mesh fits the cube from -1 to 1.
+void GetEntityBox(const XMFLOAT4X4A& worldMatrix, XMFLOAT3& center, XMFLOAT3& extents);
+// Add every entity of the scene to the scene tree.
+void BuildSceneTree();
+// Move the scene tree's proxies to the entities' current boxes.
+void UpdateSceneTree();
+
+// Copy the cube field transforms into an instance stream, in draw order.
+void WriteCubeFieldInstances(PlaneInstanceData* instances);
+// As WriteCubeFieldInstances, but only for the cubes the scene tree finds in
+// the frustum and occlusion cannot rule out, in the same order. Returns the
+// number written.
+uint32_t WriteVisibleCubeFieldInstances(PlaneInstanceData* instances, const Frustum& frustum, const OcclusionBuffer& occlusion);
+
+// Fit every shadow map to camera and its light, and update the constants the
+// lit pixel shaders sample the maps with.
+void FitShadowMaps(const Camera& camera);
+// Write the casters of shadow map view to instances, in entity order: the
+// entities the scene tree finds in its volume that are large enough to land
+// in it, other than the light gizmo. Returns the number written.
+uint32_t WriteShadowCasters(uint32_t view, ShadowInstanceData* instances);
+
+// Constant buffer contents for drawing a single entity.
+PerObjectTransformData GetPerObjectTransformData(Entity entity, FXMMATRIX viewProjection);
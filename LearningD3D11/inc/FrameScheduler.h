@@ -0,0 +1,134 @@
+#pragma once
+#include <cstdint>
+#include "Histogram.h"
+
+// Frame pacing: fixed-step simulation, render interpolation and an optional
+// frame-rate cap.
+//
+// Every BeginFrame adds the wall time since the previous frame to an
+// accumulator and returns how many fixed simulation steps it now covers. The
+// caller runs that many steps, then renders with GetInterpolation(), the
+// fraction of a step left over, to blend between the last two simulation
+// states. Long frames are made up for with more steps rather than a longer
+// step, up to MaxStepsPerFrame; time beyond that (a breakpoint, a hitch) is
+// dropped so the simulation never spirals. With a cap, EndFrame sleeps until
+// shortly before the frame's deadline and spins for the rest, because sleeps
+// overshoot by up to a scheduler tick.
+//
+// Time comes from a FrameClock so the scheduler can run against a simulated
+// clock headless.
+
+// Monotonic clock in nanoseconds.
+class FrameClock
+{
+public:
+    virtual ~FrameClock() {}
+
+    virtual int64_t Now() = 0;
+    // May wake up late, never early.
+    virtual void Sleep(int64_t duration) = 0;
+    // Called in the busy wait before a deadline.
+    virtual void Spin() = 0;
+};
+
+// std::chrono::steady_clock, which is QueryPerformanceCounter on Windows.
+// Sleep granularity is the system timer resolution, so the application
+// raises it to 1 ms (timeBeginPeriod) while the scheduler runs.
+class SteadyFrameClock : public FrameClock
+{
+public:
+    int64_t Now() override;
+    void Sleep(int64_t duration) override;
+    void Spin() override;
+};
+
+// Clock that only moves when told to. Sleep advances by the requested time
+// plus a fixed oversleep, Spin by a small quantum; Advance stands in for
+// frame work.
+class SimulatedFrameClock : public FrameClock
+{
+public:
+    SimulatedFrameClock(int64_t oversleep = 0, int64_t spinQuantum = 1000)
+        : m_Time(0), m_Oversleep(oversleep), m_SpinQuantum(spinQuantum), m_SleepTime(0), m_SpinTime(0) {}
+
+    int64_t Now() override { return m_Time; }
+    void Sleep(int64_t duration) override;
+    void Spin() override;
+
+    void Advance(int64_t duration) { m_Time += duration; }
+
+    int64_t GetSleepTime() const { return m_SleepTime; }
+    int64_t GetSpinTime() const { return m_SpinTime; }
+
+private:
+    int64_t m_Time;
+    int64_t m_Oversleep;
+    int64_t m_SpinQuantum;
+    int64_t m_SleepTime;
+    int64_t m_SpinTime;
+};
+
+struct FrameSchedulerSettings
+{
+    FrameSchedulerSettings()
+        : FixedStep(1.0 / 60.0)
+        , MaxStepsPerFrame(8)
+        , FrameCap(0.0)
+        , SpinTime(0.002)
+    {}
+
+    double FixedStep;               // Seconds per simulation step.
+    uint32_t MaxStepsPerFrame;      // Catch-up limit.
+    double FrameCap;                // Minimum seconds per frame, 0 for uncapped.
+    double SpinTime;                // Busy wait this long before a capped deadline instead of sleeping.
+};
+
+struct FrameSchedulerStats
+{
+    uint64_t FrameCount;
+    uint64_t StepCount;
+    double SimulatedTime;           // Seconds, StepCount fixed steps.
+    double DroppedTime;             // Seconds not simulated because of the catch-up limit.
+    double WaitTime;                // Seconds spent in EndFrame waiting for the cap.
+};
+
+class FrameScheduler
+{
+public:
+    FrameScheduler(FrameClock& clock, const FrameSchedulerSettings& settings = FrameSchedulerSettings());
+
+    // Start a frame. Returns the number of fixed steps to simulate before
+    // rendering it. The first frame only starts the clock and returns 0.
+    uint32_t BeginFrame();
+    // Wait for the frame cap, if there is one.
+    void EndFrame();
+
+    float GetFixedStep() const { return static_cast<float>(m_Settings.FixedStep); }
+    // Fraction of a step simulated ahead of render time, in [0, 1). Blend
+    // the previous state with weight 1 - interpolation and the current one
+    // with weight interpolation.
+    float GetInterpolation() const;
+
+    // Time between successive BeginFrame calls, in milliseconds.
+    const Histogram& GetFrameTimes() const { return m_FrameTimes; }
+    FrameSchedulerStats GetStats() const;
+    void ResetStats();
+
+private:
+    FrameClock& m_Clock;
+    FrameSchedulerSettings m_Settings;
+    int64_t m_FixedStep;
+    int64_t m_FrameCap;
+    int64_t m_SpinTime;
+
+    bool m_Started;
+    int64_t m_FrameStart;
+    int64_t m_Deadline;
+    int64_t m_Accumulator;
+
+    Histogram m_FrameTimes;
+    uint64_t m_FrameCount;
+    uint64_t m_StepCount;
+    int64_t m_DroppedTime;
+    int64_t m_WaitTime;
+};
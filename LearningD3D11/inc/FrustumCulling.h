@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "ShaderTypes.h"
+
+// View frustum as six normalized planes (ax + by + cz + d = 0) whose normals
+// point into the frustum: left, right, bottom, top, near, far.
+struct Frustum
+{
+    XMFLOAT4 Planes[6];
+};
+
+// Extract the frustum planes from a (row-vector) view-projection matrix such
+// as g_PerFrameTransformData.ViewProjectionMatrix. Planes 4 and 5 are the
+// 0 <= z and z <= w planes, so with reversed depth they are the far and near
+// planes. An infinite far plane is stored as (0, 0, 0, 1), which culls
+// nothing; Camera::GetFrustum keeps a finite one at FarZ.
+void ExtractFrustumPlanes(FXMMATRIX viewProjection, Frustum& frustum);
+
+// World-space bounds of a set of instances in structure-of-arrays form.
+// Arrays are padded to a multiple of four so the culling loop can always
+// load full lanes.
+struct InstanceBoundsSoA
+{
+    std::vector<float> CenterX, CenterY, CenterZ;
+    std::vector<float> ExtentX, ExtentY, ExtentZ;
+    std::vector<float> Radius;
+    size_t Count;
+
+    InstanceBoundsSoA() : Count(0) {}
+    void Resize(size_t count);
+};
+
+// Transform a local-space box (center/extents) by each instance's world matrix
+// and store the enclosing world-space box and sphere.
+void ComputeInstanceBounds(const PlaneInstanceData* instances, size_t count,
+    const XMFLOAT3& localCenter, const XMFLOAT3& localExtents, InstanceBoundsSoA& bounds);
+
+enum CullVolume
+{
+    CV_Sphere,  // Cheaper, looser.
+    CV_Box,     // Tighter, one extra dot product per plane.
+};
+
+// Test four instances per iteration against the frustum and copy the ones that
+// survive into visibleInstances, preserving their order. Returns the number of
+// visible instances, to be used as the instance count of the draw.
+size_t CullInstances(const Frustum& frustum, const InstanceBoundsSoA& bounds, CullVolume volume,
+    const PlaneInstanceData* instances, PlaneInstanceData* visibleInstances);
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fixed-width bucket histogram of non-negative samples (frame times in
+// milliseconds, say). Adding a sample is O(1) and allocation free, so it can
+// run every frame; percentiles are read from the buckets and are accurate to
+// one bucket width. Samples past the last bucket are counted in an overflow
+// bucket and report the maximum.
+class Histogram
+{
+public:
+    Histogram(double bucketWidth, size_t bucketCount);
+
+    void Add(double value);
+    void Reset();
+
+    uint64_t GetCount() const { return m_Count; }
+    double GetMin() const { return m_Count ? m_Min : 0.0; }
+    double GetMax() const { return m_Count ? m_Max : 0.0; }
+    double GetMean() const { return m_Count ? m_Sum / m_Count : 0.0; }
+    // Upper edge of the bucket holding the given fraction (0 to 1) of the
+    // samples, clamped to the observed range.
+    double GetPercentile(double fraction) const;
+
+private:
+    double m_BucketWidth;
+    std::vector<uint64_t> m_Buckets;    // Last one is the overflow bucket.
+    uint64_t m_Count;
+    double m_Sum;
+    double m_Min;
+    double m_Max;
+};
@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of worker threads to use when the caller does not specify one.
+inline unsigned int GetDefaultThreadCount()
+{
+    unsigned int threadCount = std::thread::hardware_concurrency();
+    return threadCount > 0 ? threadCount : 1;
+}
+
+// Counts unfinished jobs. Run increments it when a job is queued and the job
+// decrements it when it returns, so a counter can gather any number of jobs
+// and JobSystem::Wait returns once all of them are done. A counter must
+// outlive its jobs.
+class JobCounter
+{
+public:
+    JobCounter() : m_Count(0) {}
+
+    bool IsDone() const { return m_Count.load(std::memory_order_acquire) == 0; }
+
+private:
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    friend class JobSystem;
+    std::atomic<uint32_t> m_Count;
+};
+
+// Work-stealing job scheduler. threadCount - 1 worker threads are started;
+// the thread that creates the system is thread 0 and works whenever it
+// waits. Each of these threads has its own deque: jobs a thread queues go to
+// the bottom of its deque and it takes them back from there (newest first,
+// while their data is still in cache), and idle threads steal from the top
+// of other threads' deques (oldest first, which tend to be the largest
+// pieces of work). Jobs queued by any other thread go through a shared
+// queue. Idle workers spin for a while and then sleep until a job is queued.
+class JobSystem
+{
+public:
+    typedef std::function<void()> JobFunction;
+
+    // 0 threads means GetDefaultThreadCount().
+    explicit JobSystem(unsigned int threadCount = 0);
+    ~JobSystem();
+
+    // Workers plus the creating thread.
+    unsigned int GetThreadCount() const { return static_cast<unsigned int>(m_Deques.size()); }
+
+    // Queue a job. counter may be nullptr. Jobs may queue and wait for other
+    // jobs.
+    void Run(JobFunction function, JobCounter* counter = nullptr);
+
+    // Run queued jobs until counter's jobs are done. Waiting inside a job is
+    // allowed: the thread keeps working on other jobs meanwhile.
+    void Wait(JobCounter& counter);
+
+    // Jobs taken from another thread's deque since the system was created.
+    uint64_t GetStealCount() const { return m_StealCount.load(std::memory_order_relaxed); }
+
+    // The system ParallelFor and the frame's task graph run on, created with
+    // the default thread count on first use.
+    static JobSystem& GetDefault();
+
+private:
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    struct Job
+    {
+        JobFunction Function;
+        JobCounter* Counter;
+    };
+
+    // Chase-Lev deque of a fixed capacity. The owning thread pushes and pops
+    // at the bottom, any thread steals from the top.
+    class JobDeque
+    {
+    public:
+        JobDeque();
+
+        bool Push(Job* job);    // Owner only. False if full.
+        Job* Pop();             // Owner only.
+        Job* Steal();
+
+    private:
+        static const int64_t Capacity = 4096;
+
+        // Thieves write m_Top and the owner m_Bottom; keep them on separate
+        // cache lines.
+        std::atomic<int64_t> m_Top;
+        char m_Padding[64 - sizeof(std::atomic<int64_t>)];
+        std::atomic<int64_t> m_Bottom;
+        std::unique_ptr<std::atomic<Job*>[]> m_Jobs;
+    };
+
+    // Deque index of the calling thread, or -1 for threads outside the system.
+    int GetThreadIndex() const;
+    Job* FindJob(int threadIndex, uint32_t& random);
+    void Execute(Job* job);
+    void WorkerMain(int threadIndex);
+
+    std::vector<std::unique_ptr<JobDeque>> m_Deques;
+    std::vector<std::thread> m_Workers;
+    std::thread::id m_CreatingThread;
+
+    std::mutex m_SharedMutex;
+    std::deque<Job*> m_SharedJobs;          // From outside threads and full deques.
+    std::atomic<uint32_t> m_SharedCount;
+
+    // Queued jobs no thread has taken yet; sleeping workers wait for it to
+    // become non-zero.
+    std::atomic<uint32_t> m_QueuedCount;
+    std::atomic<uint32_t> m_SleepingCount;
+    std::mutex m_SleepMutex;
+    std::condition_variable m_Wake;
+    std::atomic<bool> m_Quit;
+
+    std::atomic<uint64_t> m_StealCount;
+};
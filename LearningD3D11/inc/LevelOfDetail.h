@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "FrustumCulling.h"
+#include "Mesh.h"
+
+// Level of detail selection from projected geometric error.
+//
+// A mesh's levels live in one vertex and index buffer as separate ranges,
+// finest first. Each level carries the geometric error of drawing it instead
+// of the real surface, in mesh units. Seen from distance d, an error e covers
+// about e * lodScale / d pixels, where lodScale comes from the projection and
+// viewport (ComputeLodScale). The cheapest level whose error stays under the
+// pixel threshold is drawn.
+//
+// Distances are measured to the instance's bounding sphere, and errors are
+// scaled by the instance's radius over the chain's BoundingRadius, so scaled
+// instances switch at proportionally larger distances.
+//
+// A level switch only happens once the distance is Hysteresis (a fraction)
+// past the exact switch distance, in either direction, so an instance sitting
+// near a boundary does not flip every frame.
+
+const uint32_t MaxLodCount = 4;
+
+struct LodLevel
+{
+    uint32_t StartIndex;
+    uint32_t IndexCount;
+    int32_t BaseVertex;
+    float GeometricError;   // Level 0's is never tested; it is drawn when nothing coarser fits.
+};
+
+struct LodChain
+{
+    LodLevel Levels[MaxLodCount];
+    uint32_t LevelCount;
+    // Length of the half extents of the finest level's local bounding box,
+    // the same measure InstanceBoundsSoA::Radius uses in world space.
+    float BoundingRadius;
+
+    LodChain() : LevelCount(0), BoundingRadius(0.0f) {}
+};
+
+struct LodSettings
+{
+    float PixelErrorThreshold;
+    float Hysteresis;
+
+    LodSettings()
+        : PixelErrorThreshold(1.0f)
+        , Hysteresis(0.1f)
+    {}
+};
+
+// Append levels[0..levelCount) (finest first, errors increasing) to mesh as
+// one range each and return the chain describing them. Returns an empty chain
+// if levelCount is 0 or above MaxLodCount. Pack the mesh's indices afterwards.
+LodChain AppendLodLevels(Mesh& mesh, const Mesh* levels, const float* geometricErrors, uint32_t levelCount);
+
+// Pixels per unit of error at unit distance: half the viewport height times
+// the projection's y scale (row-vector matrices, as Camera returns).
+float ComputeLodScale(FXMMATRIX projection, float viewportHeight);
+
+// Level for one object with the given world-space bounding sphere, given the
+// level it was drawn with last. Matches LodSelector bit for bit.
+uint32_t SelectLod(const LodChain& chain, const LodSettings& settings, float lodScale,
+    const XMFLOAT3& eye, const XMFLOAT3& center, float radius, uint32_t currentLevel);
+
+// Batched selection for many instances of one chain. Keeps every instance's
+// level between calls for the hysteresis, and sorts the instances into one
+// list per level, ready to be gathered into an instance buffer and drawn with
+// one DrawIndexedInstanced per level.
+class LodSelector
+{
+public:
+    LodSelector();
+
+    // Select levels for bounds.Count instances seen from eye, four at a time.
+    // Instances are split into chunks run with ParallelFor on up to
+    // threadCount threads (0 for the default). The result does not depend on
+    // the thread count. Instances added since the last call start at level 0.
+    void Select(const LodChain& chain, const LodSettings& settings, float lodScale,
+        FXMVECTOR eye, const InstanceBoundsSoA& bounds, unsigned int threadCount = 0);
+
+    // Forget the levels kept for the hysteresis.
+    void Reset();
+
+    size_t GetInstanceCount() const { return m_InstanceCount; }
+    uint32_t GetLevel(size_t instance) const { return m_Levels[instance]; }
+
+    // Instance indices grouped by level, finest first, ascending within a
+    // level. Level l's instances start at GetLevelStart(l), which is also the
+    // StartInstance of its draw once the instance data is gathered in this
+    // order.
+    const uint32_t* GetInstances() const { return m_Instances.data(); }
+    uint32_t GetLevelStart(uint32_t level) const { return m_LevelStarts[level]; }
+    uint32_t GetLevelInstanceCount(uint32_t level) const { return m_LevelStarts[level + 1] - m_LevelStarts[level]; }
+
+private:
+    size_t m_InstanceCount;
+    std::vector<uint8_t> m_Levels;
+    std::vector<uint32_t> m_Instances;
+    uint32_t m_LevelStarts[MaxLodCount + 1];
+
+    // Instances per level in each chunk, then where the chunk's instances of
+    // each level go.
+    std::vector<uint32_t> m_ChunkCounts;
+};
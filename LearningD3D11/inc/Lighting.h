@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "ShaderTypes.h"
+
+// CPU lighting for per-vertex lighting and light-probe baking.
+//
+// Evaluates every enabled light in LightProperties (directional, point and
+// spot) with the same DoDiffuse/DoSpecular/DoAttenuation/DoSpotCone terms as
+// Lighting.hlsli, so a change to one belongs in the other. Like the shader,
+// it uses EyePosition as the eye vector itself (the app stores the camera's
+// forward direction there) and leaves shadowing to the caller.
+// PhongShadingMode selects Phong or Blinn-Phong specular.
+
+struct LightingResult
+{
+    XMFLOAT4 Diffuse;
+    XMFLOAT4 Specular;
+};
+
+// Cosine of the angle inside which a spot light is at full intensity, from
+// the cosine of its SpotAngle. The cone fades over its outer quarter, as
+// DoSpotCone in Lighting.hlsli does; change both together.
+inline float GetSpotMaxCos(float minCos)
+{
+    return minCos + (1.0f - minCos) * 0.25f;
+}
+
+// The enabled lights of a LightProperties transposed into structure-of-arrays
+// form, so a kernel can broadcast one light at a time across a batch of points.
+struct alignas(16) LightListSoA
+{
+    float PositionX[MAX_LIGHTS], PositionY[MAX_LIGHTS], PositionZ[MAX_LIGHTS];
+    float DirectionX[MAX_LIGHTS], DirectionY[MAX_LIGHTS], DirectionZ[MAX_LIGHTS];
+    float ColorR[MAX_LIGHTS], ColorG[MAX_LIGHTS], ColorB[MAX_LIGHTS], ColorA[MAX_LIGHTS];
+    float SpotMinCos[MAX_LIGHTS], SpotMaxCos[MAX_LIGHTS];
+    float ConstantAttenuation[MAX_LIGHTS], LinearAttenuation[MAX_LIGHTS], QuadraticAttenuation[MAX_LIGHTS];
+    int LightType[MAX_LIGHTS];
+    uint32_t LightCount;
+
+    float EyeVectorX, EyeVectorY, EyeVectorZ;
+    int PhongShadingMode;
+};
+
+// Compact the enabled lights into SoA form.
+void TransposeLights(const LightProperties& lightProperties, LightListSoA& lights);
+
+// Reference implementation, one point at a time.
+LightingResult ComputeLightingScalar(const LightProperties& lightProperties, float specularPower,
+    const XMFLOAT3& position, const XMFLOAT3& normal);
+
+// SIMD implementation. Points are processed 16 at a time per light broadcast:
+// four 4-wide lanes, or two 8-wide AVX lanes when _XM_AVX2_INTRINSICS_ is
+// defined, then 8 and 4 at a time for the remainder. Normals are expected to
+// be normalized. Matches ComputeLightingScalar to within float rounding.
+void ComputeLighting(const LightListSoA& lights, float specularPower,
+    const XMFLOAT3* positions, const XMFLOAT3* normals, size_t count, LightingResult* results);
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// File access shared by the cooked formats (mesh files, shader archives, DDS
+// textures and profile captures). Paths are UTF-8 everywhere; on Windows they
+// are widened at the API boundary so paths outside the ANSI code page work.
+
+// fopen with a UTF-8 path. nullptr on failure.
+FILE* OpenFile(const char* fileName, const char* mode);
+bool RemoveFile(const char* fileName);
+// fseek from the start of the file with a 64-bit offset.
+bool SeekFile(FILE* file, uint64_t offset);
+
+#ifdef _WIN32
+std::wstring WidenPath(const char* fileName);
+#endif
+
+// alignment must be a power of two.
+inline uint64_t AlignOffset(uint64_t offset, uint64_t alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// True if [offset, offset + size) lies within a file of fileSize bytes.
+inline bool IsRangeInFile(uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+enum FileAccessPattern
+{
+    FAP_Sequential,     // Read front to back once.
+    FAP_Random,         // Only the parts that are used get touched.
+};
+
+// Read-only memory mapping of a whole file. Empty files cannot be mapped.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // The access pattern is a hint for the OS read-ahead.
+    bool Open(const char* fileName, FileAccessPattern access);
+    void Close();
+    bool IsOpen() const { return m_Data != nullptr; }
+
+    // Valid until Close.
+    const uint8_t* GetData() const { return m_Data; }
+    uint64_t GetSize() const { return m_Size; }
+
+private:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+#ifdef _WIN32
+    void* m_FileHandle;
+    void* m_MappingHandle;
+#endif
+    const uint8_t* m_Data;
+    uint64_t m_Size;
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ShaderTypes.h"
+
+// Half-open range [Begin, End) of material indices.
+struct MaterialRange
+{
+    uint32_t Begin;
+    uint32_t End;
+};
+
+// CPU copy of every material, laid out exactly like the GPU structured buffer
+// (one MaterialProperties per element) so instances can refer to materials by
+// index. Writes are tracked as a sorted list of disjoint dirty ranges, merged
+// when they touch, so the upload only copies the entries that changed.
+class MaterialTable
+{
+public:
+    // Append a material and return its index.
+    uint32_t Add(const MaterialProperties& material);
+    void Set(uint32_t index, const MaterialProperties& material);
+    void Clear();
+
+    const MaterialProperties& Get(uint32_t index) const { return m_Materials[index]; }
+    const MaterialProperties* GetData() const { return m_Materials.data(); }
+    uint32_t GetCount() const { return static_cast<uint32_t>(m_Materials.size()); }
+
+    // Ranges written since the last ClearDirty, sorted by Begin.
+    const std::vector<MaterialRange>& GetDirtyRanges() const { return m_DirtyRanges; }
+    bool IsDirty() const { return !m_DirtyRanges.empty(); }
+    // Mark everything dirty, e.g. after the GPU copy was recreated.
+    void MarkAllDirty();
+    void ClearDirty() { m_DirtyRanges.clear(); }
+
+private:
+    void MarkDirty(uint32_t index);
+
+    std::vector<MaterialProperties> m_Materials;
+    std::vector<MaterialRange> m_DirtyRanges;
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ShaderTypes.h"
+
+// Indexed triangle list in the VertexPosNormColTex layout. Indices are built
+// and optimized as 32-bit values; PackIndices decides what gets uploaded.
+
+enum IndexFormat
+{
+    IF_Auto,    // 16-bit when every vertex is reachable with 16 bits.
+    IF_16Bit,
+    IF_32Bit,
+};
+
+struct Mesh
+{
+    Mesh() : Format(IF_32Bit) {}
+
+    std::vector<VertexPosNormColTex> Vertices;
+    std::vector<uint32_t> Indices;
+
+    // Filled by PackIndices. Indices16 is only used with IF_16Bit.
+    IndexFormat Format;
+    std::vector<uint16_t> Indices16;
+
+    size_t GetTriangleCount() const { return Indices.size() / 3; }
+    size_t GetIndexCount() const { return Indices.size(); }
+
+    // Index data to upload, and the size of one index in bytes.
+    const void* GetIndexData() const;
+    size_t GetIndexSize() const;
+};
+
+// Choose the index format and fill Indices16 if it is 16-bit. Returns false if
+// IF_16Bit was requested for a mesh with more than 65536 vertices.
+bool PackIndices(Mesh& mesh, IndexFormat format);
+
+// Reverse the winding of every triangle and mirror the u texture coordinate,
+// converting a mesh built for a right-handed (counter-clockwise) convention to
+// the left-handed, clockwise-front convention the rasterizer state uses.
+void ReverseWinding(Mesh& mesh);
+
+// Post-transform vertex cache behaviour of an index buffer, simulated with a
+// FIFO cache of cacheSize entries.
+struct VertexCacheStatistics
+{
+    uint32_t VerticesTransformed;
+    float ACMR;     // Average cache miss ratio: transforms per triangle (0.5 is ideal on large grids, 3 is worst).
+    float ATVR;     // Average transform to vertex ratio: transforms per referenced vertex (1 is ideal).
+};
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16);
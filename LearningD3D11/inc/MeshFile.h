@@ -0,0 +1,181 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "VertexFormats.h"
+
+// Cooked binary mesh container (.ldmesh).
+//
+// Layout, every section starting on a MeshFileAlignment boundary:
+//   MeshFileHeader
+//   vertex data        VertexCount * VertexStride bytes
+//   index data         IndexCount * IndexSize bytes
+//   submesh table      SubmeshCount * MeshFileSubmesh
+//
+// All fields are little-endian and fixed size, so a loader can map the file
+// and hand the vertex and index sections straight to the GPU as initial data
+// without parsing or copying them (see MappedMeshFile and
+// D3D11MeshFile.h).
+
+const uint32_t MeshFileMagic = 0x534D444C;     // "LDMS"
+const uint32_t MeshFileVersion = 1;
+// Sections are page aligned so each starts on its own page of the mapping.
+const uint32_t MeshFileAlignment = 4096;
+const uint32_t MaxMeshFileAttributes = 8;
+
+// Vertex layouts the cooker can write. The attribute table in the header
+// describes the layout too, so tools can read the file without this enum.
+enum MeshVertexFormat
+{
+    MVF_PosNormColTex,      // VertexPosNormColTex, 44 bytes.
+    MVF_PackedUnorm16,      // VertexPacked with PE_Unorm16 positions, 20 bytes.
+    MVF_PackedHalf,         // VertexPacked with PE_Half positions, 20 bytes.
+};
+
+enum MeshAttributeSemantic
+{
+    MAS_Position,
+    MAS_Normal,
+    MAS_Color,
+    MAS_Texcoord,
+};
+
+enum MeshAttributeFormat
+{
+    MAF_Float2,
+    MAF_Float3,
+    MAF_Half2,
+    MAF_Half4,
+    MAF_Unorm16x4,
+    MAF_Snorm16x2,      // Octahedral normal.
+    MAF_Unorm8x4,
+};
+
+struct MeshFileAttribute
+{
+    uint32_t Semantic;      // MeshAttributeSemantic
+    uint32_t Format;        // MeshAttributeFormat
+    uint32_t Offset;        // Byte offset within the vertex.
+    uint32_t Padding;
+};
+
+struct MeshFileSubmesh
+{
+    uint32_t IndexStart;
+    uint32_t IndexCount;
+    uint32_t BaseVertex;    // Added to every index of the submesh.
+    uint32_t MaterialIndex;
+    float BoundsMin[3];
+    float BoundsMax[3];
+};
+static_assert(sizeof(MeshFileSubmesh) == 40, "MeshFileSubmesh is part of the file format");
+
+struct MeshFileHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t HeaderSize;        // sizeof(MeshFileHeader)
+    uint32_t VertexFormat;      // MeshVertexFormat
+    uint64_t FileSize;
+
+    uint32_t VertexStride;
+    uint32_t AttributeCount;
+    MeshFileAttribute Attributes[MaxMeshFileAttributes];
+
+    // Position decode for the packed formats, identity for MVF_PosNormColTex.
+    // Same layout as VertexQuantization.
+    float PositionScale[4];
+    float PositionBias[4];
+
+    float BoundsMin[3];
+    float BoundsMax[3];
+
+    uint32_t IndexSize;         // 2 or 4.
+    uint32_t SubmeshCount;
+
+    uint64_t VertexCount;
+    uint64_t VertexDataOffset;
+    uint64_t IndexCount;
+    uint64_t IndexDataOffset;
+    uint64_t SubmeshTableOffset;
+};
+static_assert(sizeof(MeshFileHeader) == 264, "MeshFileHeader is part of the file format");
+
+// Fills the stride and attribute table of header for a vertex format.
+void GetMeshFileVertexLayout(MeshVertexFormat format, MeshFileHeader& header);
+
+// Streams a mesh file to disk. Vertices must all be written before the first
+// index; the header and submesh table are written by Close, so the counts do
+// not need to be known up front and meshes larger than memory can be cooked
+// in chunks.
+class MeshFileWriter
+{
+public:
+    MeshFileWriter();
+    ~MeshFileWriter();
+
+    bool Open(const char* fileName, MeshVertexFormat format, uint32_t indexSize);
+    // Discards a partially written file.
+    void Abort();
+
+    void SetQuantization(const VertexQuantization& quantization);
+    void SetBounds(const float boundsMin[3], const float boundsMax[3]);
+
+    // count vertices in the file's vertex format.
+    bool WriteVertices(const void* vertices, size_t count);
+    // count indices of the file's index size.
+    bool WriteIndices(const void* indices, size_t count);
+    void AddSubmesh(const MeshFileSubmesh& submesh);
+
+    // Writes the submesh table and the header. False if any write failed.
+    bool Close();
+
+private:
+    bool WritePadding();
+
+    FILE* m_File;
+    std::string m_FileName;
+    MeshFileHeader m_Header;
+    std::vector<MeshFileSubmesh> m_Submeshes;
+    uint64_t m_Offset;
+    bool m_Failed;
+};
+
+// Cook a whole mesh as a single submesh. The packed formats compute the
+// quantization from the mesh bounds. Indices keep the mesh's packed format.
+bool WriteMeshFile(const char* fileName, const Mesh& mesh, MeshVertexFormat format);
+
+// Read-only memory mapping of a mesh file. The section pointers point into
+// the mapping and stay valid until Close.
+class MappedMeshFile
+{
+public:
+    MappedMeshFile();
+    ~MappedMeshFile();
+
+    // Maps the file and validates the header and section ranges. False if the
+    // file is missing, of another version, or truncated.
+    bool Open(const char* fileName);
+    void Close();
+
+    const MeshFileHeader& GetHeader() const { return *m_Header; }
+    const void* GetVertexData() const;
+    const void* GetIndexData() const;
+    const MeshFileSubmesh* GetSubmeshes() const;
+
+    uint64_t GetVertexDataSize() const;
+    uint64_t GetIndexDataSize() const;
+    VertexQuantization GetQuantization() const;
+
+private:
+    MappedMeshFile(const MappedMeshFile&) = delete;
+    MappedMeshFile& operator=(const MappedMeshFile&) = delete;
+
+    MappedFile m_File;
+    const uint8_t* m_Data;
+    const MeshFileHeader* m_Header;
+};
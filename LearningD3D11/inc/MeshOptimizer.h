@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "Mesh.h"
+
+// Index and vertex reordering for faster rendering of static meshes. None of
+// these change what is drawn, only the order it is drawn in.
+
+// Reorder triangles for post-transform vertex cache locality using Forsyth's
+// linear-speed algorithm: triangles are emitted greedily by a score that
+// favours vertices recently used (modelled as an LRU cache of cacheSize
+// entries) and vertices with few triangles left to draw.
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 32);
+
+// Reorder clusters of the cache-optimized triangle order so surfaces facing
+// away from the mesh center draw first, which lets early depth testing reject
+// more of what is behind them. Splits are only made where the cache would be
+// mostly cold anyway, keeping the ACMR within threshold times its input value.
+void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const VertexPosNormColTex* vertices, size_t vertexCount,
+    float threshold = 1.05f);
+
+// Renumber vertices in the order the index buffer first references them, so
+// vertex fetch walks the vertex buffer mostly forwards. Unreferenced vertices
+// are dropped. Returns the new vertex count.
+size_t OptimizeVertexFetch(uint32_t* indices, size_t indexCount, VertexPosNormColTex* vertices, size_t vertexCount);
+
+// All of the above, in that order.
+void OptimizeMesh(Mesh& mesh);
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ShaderTypes.h"
+
+// Software occlusion culling. Large occluders such as the room walls are
+// rasterized on the CPU into a small depth buffer, four pixels at a time. A
+// pyramid is built over it in which every texel holds the nearest and the
+// farthest depth of the 2x2 texels below, and occludee boxes are tested
+// against the pyramid before their draws are emitted.
+//
+// Depth is stored as 1/w, the reciprocal of view-space depth. It is linear
+// in screen space and does not depend on how the projection maps z, so
+// standard and reversed-Z view-projections work the same. Larger is nearer;
+// 0 means no occluder.
+//
+// Occluders are sampled at pixel centres and drawn double-sided. A pixel an
+// occluder only partly covers may hide a box peeking out from its other
+// part; occluders should be solid surfaces larger than a pixel.
+
+// Screen-space extent of a box: the pixels its projection overlaps, and its
+// nearest depth.
+struct OcclusionRect
+{
+    int MinX, MinY, MaxX, MaxY;     // Inclusive, clamped to the buffer.
+    float NearestDepth;             // 1/w of the box's nearest corner.
+};
+
+enum OcclusionRectResult
+{
+    ORR_OnScreen,
+    ORR_OffScreen,      // Nothing to draw.
+    ORR_CrossesNear,    // Part of the box is behind the near plane; treat as visible.
+};
+
+class OcclusionBuffer
+{
+public:
+    OcclusionBuffer();
+
+    // width must be a multiple of four. Returns false otherwise.
+    bool Create(uint32_t width, uint32_t height);
+
+    // Clear the buffer and set the (row-vector) view-projection that
+    // occluders are drawn and occludees tested with. nearZ is the view depth
+    // triangles are clipped at.
+    void Begin(FXMMATRIX viewProjection, float nearZ);
+
+    // Rasterize indexed triangles transformed by world.
+    void RasterizeOccluder(const VertexPosNormColTex* vertices, const uint16_t* indices, size_t indexCount, FXMMATRIX world);
+    // As above, once per instance, e.g. the room walls.
+    void RasterizeOccluders(const VertexPosNormColTex* vertices, const uint16_t* indices, size_t indexCount,
+        const PlaneInstanceData* instances, size_t instanceCount);
+
+    // Build the pyramid over the rasterized depth. Call after the last
+    // occluder and before testing.
+    void BuildHierarchy();
+
+    // Project a world-space box (center and half extents).
+    OcclusionRectResult ProjectBox(const XMFLOAT3& center, const XMFLOAT3& extents, OcclusionRect& rect) const;
+
+    // Whether any part of a world-space box may be in front of the occluders.
+    // Off-screen boxes are not visible; boxes crossing the near plane are.
+    // Starts at the level where the box covers at most 2x2 texels and only
+    // descends into texels it cannot decide. Safe to call from several
+    // threads once BuildHierarchy has returned.
+    bool IsBoxVisible(const XMFLOAT3& center, const XMFLOAT3& extents) const;
+
+    uint32_t GetWidth() const { return m_Width; }
+    uint32_t GetHeight() const { return m_Height; }
+    uint32_t GetLevelCount() const { return static_cast<uint32_t>(m_Levels.size()); }
+    uint32_t GetLevelWidth(uint32_t level) const { return m_Levels[level].Width; }
+    uint32_t GetLevelHeight(uint32_t level) const { return m_Levels[level].Height; }
+    // Level 0 is the rasterized depth, for which both are the same buffer.
+    const float* GetNearestDepths(uint32_t level) const;
+    const float* GetFarthestDepths(uint32_t level) const;
+
+    // Occluder triangles rasterized since Begin, after clipping.
+    uint32_t GetTriangleCount() const { return m_TriangleCount; }
+
+private:
+    struct Level
+    {
+        uint32_t Width, Height;
+        std::vector<float> Nearest;     // Max 1/w. Empty for level 0.
+        std::vector<float> Farthest;    // Min 1/w. Empty for level 0.
+    };
+
+    void RasterizeTriangle(FXMVECTOR clip0, FXMVECTOR clip1, FXMVECTOR clip2);
+    void SetupTriangle(FXMVECTOR clip0, FXMVECTOR clip1, FXMVECTOR clip2);
+    bool IsRectVisible(uint32_t level, int minX, int minY, int maxX, int maxY, const OcclusionRect& rect) const;
+
+    uint32_t m_Width, m_Height;
+    std::vector<float> m_Depth;
+    std::vector<Level> m_Levels;
+
+    XMMATRIX m_ViewProjection;
+    float m_NearZ;
+    uint32_t m_TriangleCount;
+};
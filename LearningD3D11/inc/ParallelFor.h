@@ -0,0 +1,53 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include "JobSystem.h"
+#include "Profiler.h"
+
+// Split [0, count) into chunks of grainSize and call func(begin, end) for each
+// chunk. Chunks are handed out dynamically so uneven work (e.g. screen tiles
+// with very different triangle counts) still balances across threads.
+//
+// Runs on JobSystem::GetDefault(): up to threadCount - 1 jobs take chunks
+// alongside the calling thread, which then helps with other jobs until they
+// are done. It may be called from inside jobs.
+template<typename Func>
+void ParallelFor(size_t count, size_t grainSize, Func func, unsigned int threadCount = 0)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    grainSize = std::max<size_t>(grainSize, 1);
+    const size_t chunkCount = (count + grainSize - 1) / grainSize;
+
+    JobSystem& jobs = JobSystem::GetDefault();
+    if (threadCount == 0)
+    {
+        threadCount = jobs.GetThreadCount();
+    }
+    threadCount = static_cast<unsigned int>(std::min<size_t>(threadCount, chunkCount));
+
+    std::atomic<size_t> nextChunk(0);
+    auto worker = [&]()
+    {
+        PROFILE_SCOPE("ParallelFor");
+        for (size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+        {
+            const size_t begin = chunk * grainSize;
+            const size_t end = std::min(begin + grainSize, count);
+            func(begin, end);
+        }
+    };
+
+    // The calling thread takes part in the work as well.
+    JobCounter counter;
+    for (unsigned int i = 1; i < threadCount; ++i)
+    {
+        jobs.Run(worker, &counter);
+    }
+    worker();
+    jobs.Wait(counter);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include "Mesh.h"
+
+// Procedural meshes centered on the origin. Every generator builds its mesh
+// counter-clockwise, converts it with ReverseWinding and then finishes it
+// according to MeshBuildOptions, so the results are ready to upload.
+
+struct MeshBuildOptions
+{
+    MeshBuildOptions()
+        : Format(IF_Auto)
+        , Optimize(true)
+        , Color(1.0f, 1.0f, 1.0f)
+    {}
+
+    IndexFormat Format;
+    bool Optimize;      // Run OptimizeMesh before packing the indices.
+    XMFLOAT3 Color;     // Written to every vertex.
+};
+
+// Cube with edge length size; each face is a tessellation x tessellation grid.
+Mesh CreateCubeMesh(float size, uint32_t tessellation = 1, const MeshBuildOptions& options = MeshBuildOptions());
+
+// Latitude/longitude sphere. The seam and poles have duplicated vertices so
+// texture coordinates do not wrap.
+Mesh CreateUVSphereMesh(float radius, uint32_t slices, uint32_t stacks, const MeshBuildOptions& options = MeshBuildOptions());
+
+// Icosahedron with every triangle split into four subdivisions times, pushed
+// out to the sphere. Evenly sized triangles, but the texture coordinates wrap
+// across the seam.
+Mesh CreateIcosphereMesh(float radius, uint32_t subdivisions, const MeshBuildOptions& options = MeshBuildOptions());
+
+// Flat grid in the XZ plane facing +Y, columns x rows quads.
+Mesh CreateGridMesh(float width, float depth, uint32_t columns, uint32_t rows, const MeshBuildOptions& options = MeshBuildOptions());
+
+// Capped cylinder along the Y axis.
+Mesh CreateCylinderMesh(float radius, float height, uint32_t slices, uint32_t stacks, const MeshBuildOptions& options = MeshBuildOptions());
+
+// Torus around the Y axis. majorRadius is the distance from the center to the
+// middle of the tube, minorRadius the radius of the tube.
+Mesh CreateTorusMesh(float majorRadius, float minorRadius, uint32_t majorSegments, uint32_t minorSegments,
+    const MeshBuildOptions& options = MeshBuildOptions());
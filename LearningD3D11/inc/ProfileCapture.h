@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Profiler.h"
+
+// Profile captures: the events collected from the Profiler over a number of
+// frames, with their names and track names copied so a capture can be saved
+// and loaded again.
+//
+// WriteChromeTrace writes the Chrome trace_event JSON format, which
+// chrome://tracing, Perfetto and Speedscope open. The binary capture (.ldpc)
+// is the same data at a fixed 24 bytes per event:
+//   ProfileCaptureHeader
+//   strings            StringSize bytes: TrackCount then NameCount
+//                      NUL-terminated strings
+//   padding            to 8 bytes
+//   events             EventCount * ProfileCaptureEvent, sorted by Start
+
+const uint32_t ProfileCaptureMagic = 0x4350444C;    // "LDPC"
+const uint32_t ProfileCaptureVersion = 1;
+
+struct ProfileCaptureHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t HeaderSize;        // sizeof(ProfileCaptureHeader)
+    uint32_t TrackCount;
+    uint32_t NameCount;
+    uint32_t Padding;
+    uint64_t EventCount;
+    uint64_t StringSize;
+    uint64_t DroppedEventCount;
+};
+static_assert(sizeof(ProfileCaptureHeader) == 48, "ProfileCaptureHeader is part of the file format");
+
+struct ProfileCaptureEvent
+{
+    uint32_t Name;              // Index into ProfileCapture::Names.
+    uint16_t Track;             // Index into ProfileCapture::TrackNames.
+    uint16_t Depth;
+    int64_t Start;              // Nanoseconds, ProfilerNow() clock.
+    int64_t Duration;           // Nanoseconds.
+};
+static_assert(sizeof(ProfileCaptureEvent) == 24, "ProfileCaptureEvent is part of the file format");
+
+struct ProfileCapture
+{
+    ProfileCapture() : DroppedEventCount(0) {}
+
+    std::vector<std::string> TrackNames;
+    std::vector<std::string> Names;
+    std::vector<ProfileCaptureEvent> Events;
+    uint64_t DroppedEventCount;
+};
+
+// Builds a capture from Profiler::Collect, once a frame.
+class ProfileRecorder
+{
+public:
+    ProfileRecorder() : m_Sorted(true) {}
+
+    // Append the events recorded since the last Collect.
+    void Collect();
+    void Clear();
+
+    // Events sorted by start time, with the current track names.
+    const ProfileCapture& GetCapture();
+
+private:
+    uint32_t GetNameIndex(const char* name);
+
+    ProfileCapture m_Capture;
+    std::vector<ProfileEvent> m_Events;
+    // Name pointers seen so far; the same literal can have several
+    // addresses, so a new pointer is looked up by its text as well.
+    std::unordered_map<const char*, uint32_t> m_NamePointers;
+    std::unordered_map<std::string, uint32_t> m_NameIndices;
+    bool m_Sorted;
+};
+
+bool WriteChromeTrace(const char* fileName, const ProfileCapture& capture);
+bool WriteProfileCapture(const char* fileName, const ProfileCapture& capture);
+// False if the file is missing, of another version, or damaged.
+bool ReadProfileCapture(const char* fileName, ProfileCapture& capture);
@@ -0,0 +1,163 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scoped CPU profiler.
+//
+// PROFILE_SCOPE("Name") times the rest of the enclosing block. Every thread
+// records into its own ring of ProfileEvents, so recording takes no lock:
+// the thread writes the event and publishes it with one release store, and
+// Profiler::Collect, called once a frame, drains every ring from the owner
+// thread. A full ring drops events (and counts them) rather than wait.
+//
+// Rings belong to tracks, the rows of a trace. A thread takes a ring when it
+// first records and hands it back when it exits, so short-lived threads
+// reuse a handful of "Worker" tracks instead of adding one per thread.
+// Other event sources, such as GPU timestamps, record on tracks of their own
+// with RecordEvent.
+//
+// Recording is off until Profiler::SetEnabled(true); a disabled zone costs a
+// relaxed load and a branch. Define PROFILER_ENABLED as 0 to compile the
+// zones out altogether.
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// Nanoseconds on a monotonic clock (QueryPerformanceCounter on Windows).
+inline int64_t ProfilerNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Names must outlive the capture: string literals or other static strings.
+struct ProfileEvent
+{
+    const char* Name;
+    int64_t Start;
+    int64_t End;
+    uint32_t Track;
+    uint32_t Depth;     // Nesting level on the track, 0 for outermost zones.
+};
+
+// Single producer, single consumer ring of events.
+class ProfileEventRing
+{
+public:
+    ProfileEventRing(uint32_t track, size_t capacity);
+
+    // Producer side.
+    void Record(const char* name, int64_t start, int64_t end, uint32_t track, uint32_t depth)
+    {
+        const uint64_t head = m_Head.load(std::memory_order_relaxed);
+        if (head - m_Tail.load(std::memory_order_acquire) >= m_Events.size())
+        {
+            m_DroppedCount.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        ProfileEvent& event = m_Events[head & m_Mask];
+        event.Name = name;
+        event.Start = start;
+        event.End = end;
+        event.Track = track;
+        event.Depth = depth;
+        m_Head.store(head + 1, std::memory_order_release);
+    }
+
+    // Consumer side. Appends the published events and frees their slots.
+    // Returns the number of events dropped since the last Drain.
+    uint64_t Drain(std::vector<ProfileEvent>& events);
+
+    uint32_t GetTrack() const { return m_Track; }
+
+    // Nesting of the owner thread's open zones. PushZone returns the depth
+    // of the zone being opened, PopZone restores it.
+    uint32_t PushZone() { return m_Depth++; }
+    void PopZone(uint32_t depth) { m_Depth = depth; }
+
+private:
+    uint32_t m_Track;
+    uint32_t m_Depth;
+    uint64_t m_Mask;
+    std::vector<ProfileEvent> m_Events;
+    std::atomic<uint64_t> m_Head;
+    std::atomic<uint64_t> m_Tail;
+    std::atomic<uint64_t> m_DroppedCount;
+};
+
+class Profiler
+{
+public:
+    static const size_t RingCapacity = 1 << 16;
+
+    static bool IsEnabled() { return s_Enabled.load(std::memory_order_relaxed); }
+    static void SetEnabled(bool enabled) { s_Enabled.store(enabled, std::memory_order_relaxed); }
+
+    // Ring of the calling thread, taken from the free list or created.
+    static ProfileEventRing& GetThreadRing();
+    // Name the calling thread's track. The name is copied.
+    static void SetThreadName(const char* name);
+
+    // Add a track for events that do not come from a thread's zones.
+    static uint32_t CreateTrack(const char* name);
+    // Record a finished event on a track from the calling thread's ring.
+    static void RecordEvent(uint32_t track, const char* name, int64_t start, int64_t end, uint32_t depth = 0);
+
+    // Move every published event into events. Returns the number of events
+    // dropped because a ring was full.
+    static uint64_t Collect(std::vector<ProfileEvent>& events);
+    // Copy of the track names, indexed by track.
+    static std::vector<std::string> GetTrackNames();
+
+private:
+    static std::atomic<bool> s_Enabled;
+};
+
+// Times its lifetime when the profiler was enabled at construction.
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name)
+        : m_Name(Profiler::IsEnabled() ? name : nullptr)
+    {
+        if (m_Name)
+        {
+            m_Ring = &Profiler::GetThreadRing();
+            m_Depth = m_Ring->PushZone();
+            m_Start = ProfilerNow();
+        }
+    }
+
+    ~ProfileScope()
+    {
+        if (m_Name)
+        {
+            const int64_t end = ProfilerNow();
+            m_Ring->PopZone(m_Depth);
+            m_Ring->Record(m_Name, m_Start, end, m_Ring->GetTrack(), m_Depth);
+        }
+    }
+
+private:
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    const char* m_Name;
+    ProfileEventRing* m_Ring;
+    int64_t m_Start;
+    uint32_t m_Depth;
+};
+
+#define PROFILE_CONCATENATE_(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCATENATE(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
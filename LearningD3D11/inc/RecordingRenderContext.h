@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "RenderQueue.h"
+
+// RenderContext that talks to no device. It records every call it receives,
+// so a queue can be executed headless and the resulting command stream
+// inspected or counted.
+class RecordingRenderContext : public RenderContext
+{
+public:
+    enum CommandType
+    {
+        CMD_SetInputLayout,
+        CMD_SetVertexShader,
+        CMD_SetPixelShader,
+        CMD_SetVertexBuffers,
+        CMD_SetIndexBuffer,
+        CMD_SetObjectConstants,
+        CMD_SetMaterial,
+        CMD_DrawIndexedInstanced,
+        NumCommandTypes
+    };
+
+    struct Command
+    {
+        CommandType Type;
+        uint32_t Arguments[5];
+    };
+
+    void SetInputLayout(uint8_t inputLayout) override;
+    void SetVertexShader(uint8_t vertexShader) override;
+    void SetPixelShader(uint8_t pixelShader) override;
+    void SetVertexBuffers(uint8_t vertexBuffer, uint8_t instanceBuffer) override;
+    void SetIndexBuffer(uint8_t indexBuffer) override;
+    void SetObjectConstants(uint32_t objectConstants) override;
+    void SetMaterial(uint16_t material) override;
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex,
+        uint32_t startInstance) override;
+
+    void Clear() { m_Commands.clear(); }
+    const std::vector<Command>& GetCommands() const { return m_Commands; }
+    size_t GetCommandCount(CommandType type) const;
+    // Everything except draws.
+    size_t GetStateChangeCount() const;
+
+private:
+    void Record(CommandType type, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, uint32_t d = 0, uint32_t e = 0);
+
+    std::vector<Command> m_Commands;
+};
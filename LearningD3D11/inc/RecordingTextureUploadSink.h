@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "TextureStreaming.h"
+
+// TextureUploadSink that talks to no device. It tracks which mips of every
+// texture would be resident and counts the work, so streaming can run and be
+// checked headless.
+class RecordingTextureUploadSink : public TextureUploadSink
+{
+public:
+    RecordingTextureUploadSink();
+
+    bool Upload(TextureHandle texture, const TextureImage& image, uint32_t firstMip) override;
+    bool Trim(TextureHandle texture, uint32_t firstMip) override;
+
+    // Most detailed resident mip, or 0xFFFFFFFF if the placeholder is bound.
+    uint32_t GetResidentMip(TextureHandle texture) const;
+    uint64_t GetBytesResident() const { return m_BytesResident; }
+    uint64_t GetPeakBytesResident() const { return m_PeakBytesResident; }
+    uint32_t GetUploadCount() const { return m_UploadCount; }
+    uint32_t GetTrimCount() const { return m_TrimCount; }
+    // Calls that did not match the recorded residency, e.g. trimming a mip
+    // that was never uploaded.
+    uint32_t GetErrorCount() const { return m_ErrorCount; }
+
+private:
+    struct ResidentTexture
+    {
+        uint32_t Width;
+        uint32_t Height;
+        TextureFormat Format;
+        uint32_t MipCount;
+        uint32_t FirstMip;
+    };
+
+    std::vector<ResidentTexture> m_Textures;
+    uint64_t m_BytesResident;
+    uint64_t m_PeakBytesResident;
+    uint32_t m_UploadCount;
+    uint32_t m_TrimCount;
+    uint32_t m_ErrorCount;
+};
@@ -0,0 +1,147 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Device-agnostic draw submission. Draws are recorded as packets that refer
+// to shaders, layouts, buffers and materials by small ids; the backend
+// (D3D11RenderContext, or RecordingRenderContext for headless runs) maps the
+// ids to real objects. Packets are sorted by a 64-bit key so draws sharing
+// state end up adjacent, and RenderStateCache drops binds that would not
+// change anything.
+
+// Id meaning "nothing bound" for optional slots.
+const uint8_t NoResource = 0xFF;
+// DrawPacket::ObjectConstants value for draws that only use per-frame constants.
+const uint32_t NoObjectConstants = 0xFFFFFFFF;
+// DrawPacket::Material value for draws whose instances carry their own
+// material index.
+const uint16_t NoMaterial = 0xFFFF;
+
+enum RenderPass
+{
+    RP_Opaque,          // Sorted by state, then front to back.
+    RP_Transparent,     // Sorted back to front.
+    NumRenderPasses
+};
+
+// Sort key layout, most significant first:
+//   63..60  pass
+//   59..54  vertex shader
+//   53..48  pixel shader
+//   47..42  input layout
+//   41..24  material
+//   23..0   depth
+uint64_t MakeSortKey(RenderPass pass, uint8_t vertexShader, uint8_t pixelShader, uint8_t inputLayout,
+    uint32_t material, uint32_t depth);
+
+// Map a view-space depth in [0, farPlane] to the 24 bit key field. Transparent
+// draws get the bits inverted so larger depths sort first.
+uint32_t QuantizeDepth(RenderPass pass, float viewDepth, float farPlane);
+
+struct DrawPacket
+{
+    uint64_t SortKey;
+
+    uint8_t VertexShader;
+    uint8_t PixelShader;
+    uint8_t InputLayout;
+    uint8_t VertexBuffer;       // Slot 0.
+    uint8_t InstanceBuffer;     // Slot 1, NoResource for non-instanced draws.
+    uint8_t IndexBuffer;
+    uint16_t Material;
+    uint32_t ObjectConstants;   // Index of the draw's per-object constants.
+
+    uint32_t IndexCount;
+    uint32_t StartIndex;        // First index of the range, e.g. a level of detail.
+    int32_t BaseVertex;         // Added to each index of the range.
+    uint32_t InstanceCount;
+    uint32_t StartInstance;
+};
+
+// Backend interface. Every call is a real state change or draw; redundant
+// calls are filtered out by RenderStateCache before they get here.
+class RenderContext
+{
+public:
+    virtual ~RenderContext() {}
+
+    virtual void SetInputLayout(uint8_t inputLayout) = 0;
+    virtual void SetVertexShader(uint8_t vertexShader) = 0;
+    virtual void SetPixelShader(uint8_t pixelShader) = 0;
+    virtual void SetVertexBuffers(uint8_t vertexBuffer, uint8_t instanceBuffer) = 0;
+    virtual void SetIndexBuffer(uint8_t indexBuffer) = 0;
+    virtual void SetObjectConstants(uint32_t objectConstants) = 0;
+    virtual void SetMaterial(uint16_t material) = 0;
+    virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex,
+        uint32_t startInstance) = 0;
+};
+
+// Shadow copy of the state bound on a RenderContext.
+class RenderStateCache
+{
+public:
+    RenderStateCache();
+
+    // Forget the shadow state, e.g. at the start of a frame or after other
+    // code has touched the device context directly.
+    void Invalidate();
+
+    // Bind the packet's state (skipping anything already bound) and draw.
+    void Draw(RenderContext& context, const DrawPacket& packet);
+
+    // Counters since the last ResetCounters.
+    uint32_t GetStateChangeCount() const { return m_StateChangeCount; }
+    uint32_t GetSkippedStateChangeCount() const { return m_SkippedStateChangeCount; }
+    uint32_t GetDrawCount() const { return m_DrawCount; }
+    void ResetCounters();
+
+private:
+    bool m_Valid;
+    DrawPacket m_Bound;
+
+    uint32_t m_StateChangeCount;
+    uint32_t m_SkippedStateChangeCount;
+    uint32_t m_DrawCount;
+};
+
+class RenderQueue
+{
+public:
+    RenderQueue() : m_Sorted(false) {}
+
+    void Clear();
+    void Reserve(size_t count);
+    void Submit(const DrawPacket& packet);
+
+    // Least significant digit radix sort of the keys, 8 bits per pass. Passes
+    // where every key has the same digit are skipped. Equal keys keep their
+    // submission order.
+    void Sort();
+
+    // Issue the packets through the cache, in sorted order if Sort was called
+    // since the last Submit, otherwise in submission order.
+    void Execute(RenderContext& context, RenderStateCache& cache) const;
+    // Issue only the packets of one pass, so passes can be bracketed (for
+    // GPU timing, say). After Sort the pass is found by binary search.
+    void Execute(RenderContext& context, RenderStateCache& cache, RenderPass pass) const;
+    // Issue packets [begin, end) of the execution order, e.g. a slice of a
+    // pass range recorded on its own thread.
+    void Execute(RenderContext& context, RenderStateCache& cache, size_t begin, size_t end) const;
+
+    // Positions [begin, end) of a pass's packets in the execution order. The
+    // pass must be contiguous, so the queue must be sorted (or submitted in
+    // pass order).
+    void GetPassRange(RenderPass pass, size_t& begin, size_t& end) const;
+
+    size_t GetPacketCount() const { return m_Packets.size(); }
+
+private:
+    std::vector<DrawPacket> m_Packets;
+    std::vector<uint32_t> m_Order;
+    bool m_Sorted;
+
+    // Radix sort scratch.
+    std::vector<uint64_t> m_Keys, m_KeysScratch;
+    std::vector<uint32_t> m_OrderScratch;
+};
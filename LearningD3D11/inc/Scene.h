@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "Transform.h"
+using namespace DirectX;
+
+// Handle to an entity in a Scene. Handles of destroyed entities are recycled.
+typedef uint32_t Entity;
+const Entity InvalidEntity = 0xFFFFFFFF;
+
+// Entity/component store. Every component lives in its own tightly packed
+// array (structure of arrays), indexed by the entity's dense index, so the
+// per-frame transform pass walks contiguous memory and can be split across
+// threads. Destroying an entity moves the last entity into its slot, which
+// keeps the arrays dense but changes that entity's index.
+//
+// An entity may have a parent, in which case its position, rotation and scale
+// are relative to the parent's world matrix. Parented entities are composed
+// after the parallel pass, parents before children, and their transform class
+// is CombineTransformClass of their own and their parent's.
+class Scene
+{
+public:
+    // Create an entity with an identity transform, no motion and material 0.
+    Entity CreateEntity();
+    void DestroyEntity(Entity entity);
+    bool IsAlive(Entity entity) const;
+    void Reserve(size_t count);
+
+    size_t GetEntityCount() const { return m_Entities.size(); }
+    // Dense index of an entity, valid until the next DestroyEntity.
+    size_t GetIndex(Entity entity) const { return m_EntityToIndex[entity]; }
+    Entity GetEntity(size_t index) const { return m_Entities[index]; }
+
+    // Component mutators.
+    void SetPosition(Entity entity, const XMFLOAT3& position);
+    void SetRotation(Entity entity, FXMVECTOR rotationQuaternion);
+    void SetScale(Entity entity, const XMFLOAT3& scale);
+    // Meters per second.
+    void SetLinearVelocity(Entity entity, const XMFLOAT3& linearVelocity);
+    // Rotation axis scaled by the rate in radians per second.
+    void SetAngularVelocity(Entity entity, const XMFLOAT3& angularVelocity);
+    void SetMaterialIndex(Entity entity, uint32_t materialIndex);
+    // Attach entity to parent, or detach it with InvalidEntity. parent must not
+    // be entity or one of its descendants. Destroying a parent detaches its
+    // children, whose local transforms then become their world transforms.
+    void SetParent(Entity entity, Entity parent);
+
+    // Component accessors.
+    const XMFLOAT3& GetPosition(Entity entity) const { return m_Positions[GetIndex(entity)]; }
+    const XMFLOAT3& GetLinearVelocity(Entity entity) const { return m_LinearVelocities[GetIndex(entity)]; }
+    uint32_t GetMaterialIndex(Entity entity) const { return m_MaterialIndices[GetIndex(entity)]; }
+    Entity GetParent(Entity entity) const { return m_Parents[GetIndex(entity)]; }
+    XMMATRIX GetWorldMatrix(Entity entity) const;
+    XMMATRIX GetInverseTransposeWorldMatrix(Entity entity) const;
+
+    // Dense component arrays, GetEntityCount() elements each.
+    const XMFLOAT4X4A* GetWorldMatrices() const { return m_WorldMatrices.data(); }
+    const XMFLOAT4X4A* GetInverseTransposeWorldMatrices() const { return m_InverseTransposeWorldMatrices.data(); }
+    const uint32_t* GetMaterialIndices() const { return m_MaterialIndices.data(); }
+
+    // Fixed-step simulation with render interpolation: SaveState before each
+    // step, Integrate the step, and Interpolate once per rendered frame to
+    // build the matrices for a point between the saved and the current state.
+    void SaveState();
+    // Integrate linear and angular velocity. Does not touch the matrices.
+    void Integrate(float deltaTime);
+    // Rebuild the world and inverse transpose world matrices of every entity
+    // from the saved state blended towards the current one by alpha (0 to 1).
+    // Runs in parallel over blocks of entities; inverse transposes use the
+    // fast path for each entity's transform class.
+    void Interpolate(float alpha);
+
+    // Integrate and rebuild the matrices for the current state.
+    void Update(float deltaTime);
+
+private:
+    // Sort the parented entities so that every parent comes before its children.
+    void SortHierarchy();
+
+    // Entity handle -> dense index, InvalidIndex for free handles.
+    std::vector<uint32_t> m_EntityToIndex;
+    std::vector<Entity> m_FreeEntities;
+
+    // Dense index -> entity handle.
+    std::vector<Entity> m_Entities;
+
+    // Components.
+    std::vector<XMFLOAT3> m_Positions;
+    std::vector<XMFLOAT4> m_Rotations;
+    std::vector<XMFLOAT3> m_PreviousPositions;
+    std::vector<XMFLOAT4> m_PreviousRotations;
+    std::vector<XMFLOAT3> m_Scales;
+    std::vector<XMFLOAT3> m_LinearVelocities;
+    std::vector<XMFLOAT3> m_AngularVelocities;
+    std::vector<uint32_t> m_MaterialIndices;
+    std::vector<TransformClass> m_TransformClasses;
+    std::vector<Entity> m_Parents;
+    std::vector<XMFLOAT4X4A> m_WorldMatrices;
+    std::vector<XMFLOAT4X4A> m_InverseTransposeWorldMatrices;
+
+    // Parented entities, parents first, and the world transform classes of all
+    // entities while any entity has a parent.
+    size_t m_ChildCount = 0;
+    bool m_HierarchyDirty = false;
+    std::vector<Entity> m_HierarchyOrder;
+    std::vector<TransformClass> m_WorldTransformClasses;
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+// Packed archive of compiled shaders (.ldsa).
+//
+// Layout:
+//   ShaderArchiveHeader
+//   entry table        BucketCount * ShaderArchiveEntry
+//   keys               KeySize bytes
+//   bytecode           each blob on a ShaderArchiveAlignment boundary
+//
+// A shader is stored under a key made of its name, its profile and the
+// preprocessor defines it was compiled with (see MakeShaderKey). The entry
+// table is a hash table with linear probing and a power of two bucket count
+// at most half full, so finding a shader in the mapped file hashes its key
+// and compares a couple of entries; nothing is parsed or allocated at load
+// time. All fields are little-endian and fixed size.
+
+const uint32_t ShaderArchiveMagic = 0x4153444C;     // "LDSA"
+const uint32_t ShaderArchiveVersion = 1;
+const uint32_t ShaderArchiveAlignment = 16;
+const uint32_t InvalidShaderEntry = 0xFFFFFFFF;
+
+struct ShaderDefine
+{
+    const char* Name;
+    const char* Value;
+};
+
+struct ShaderArchiveHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t HeaderSize;        // sizeof(ShaderArchiveHeader)
+    uint32_t EntryCount;
+    uint32_t BucketCount;       // Power of two.
+    uint32_t Padding;
+    uint64_t FileSize;
+    uint64_t TableOffset;
+    uint64_t KeyOffset;
+    uint64_t KeySize;
+    uint64_t DataOffset;
+};
+static_assert(sizeof(ShaderArchiveHeader) == 64, "ShaderArchiveHeader is part of the file format");
+
+// One bucket of the entry table. Empty buckets have a KeyLength of 0.
+struct ShaderArchiveEntry
+{
+    uint64_t KeyHash;
+    uint32_t KeyOffset;         // Relative to the key section.
+    uint32_t KeyLength;
+    uint64_t DataOffset;        // Relative to the start of the file.
+    uint32_t DataSize;
+    uint32_t Padding;
+};
+static_assert(sizeof(ShaderArchiveEntry) == 32, "ShaderArchiveEntry is part of the file format");
+
+// "name\0profile\0" followed by "NAME=VALUE\0" for every define, sorted by
+// name, so the order the defines are listed in does not matter.
+std::string MakeShaderKey(const char* name, const char* profile, const ShaderDefine* defines = nullptr, size_t defineCount = 0);
+// 64-bit FNV-1a.
+uint64_t HashShaderKey(const char* key, size_t length);
+
+// Collects compiled shaders in memory and writes them as one archive.
+class ShaderArchiveBuilder
+{
+public:
+    // Copies the bytecode. False if the key is already in the archive or the
+    // bytecode is empty.
+    bool Add(const char* name, const char* profile, const ShaderDefine* defines, size_t defineCount,
+        const void* bytecode, size_t bytecodeSize);
+    bool Add(const char* name, const char* profile, const void* bytecode, size_t bytecodeSize)
+    {
+        return Add(name, profile, nullptr, 0, bytecode, bytecodeSize);
+    }
+
+    size_t GetCount() const { return m_Shaders.size(); }
+
+    bool Write(const char* fileName) const;
+
+private:
+    struct Shader
+    {
+        std::string Key;
+        uint64_t KeyHash;
+        std::vector<uint8_t> Bytecode;
+    };
+
+    std::vector<Shader> m_Shaders;
+};
+
+// Read-only memory mapping of a shader archive. Entries are identified by
+// their bucket index, which stays the same for as long as the archive is
+// open, so callers can cache per-entry data in an array of GetBucketCount()
+// elements.
+class ShaderArchive
+{
+public:
+    ShaderArchive();
+    ~ShaderArchive();
+
+    // Maps the file and validates the header, the entry table and every
+    // entry's ranges. False if the file is missing, of another version, or
+    // damaged.
+    bool Open(const char* fileName);
+    void Close();
+    bool IsOpen() const { return m_Header != nullptr; }
+
+    // Bucket index of the shader, or InvalidShaderEntry if it is not in the
+    // archive.
+    uint32_t Find(const std::string& key) const;
+    uint32_t Find(const char* name, const char* profile, const ShaderDefine* defines = nullptr, size_t defineCount = 0) const
+    {
+        return Find(MakeShaderKey(name, profile, defines, defineCount));
+    }
+
+    uint32_t GetEntryCount() const { return m_Header->EntryCount; }
+    uint32_t GetBucketCount() const { return m_Header->BucketCount; }
+
+    // Bytecode in the mapping, valid until Close.
+    const void* GetBytecode(uint32_t entry) const;
+    size_t GetBytecodeSize(uint32_t entry) const;
+
+private:
+    ShaderArchive(const ShaderArchive&) = delete;
+    ShaderArchive& operator=(const ShaderArchive&) = delete;
+
+    MappedFile m_File;
+    const uint8_t* m_Data;
+    const ShaderArchiveHeader* m_Header;
+    const ShaderArchiveEntry* m_Entries;
+    const char* m_Keys;
+};
@@ -0,0 +1,157 @@
+#pragma once
+#include <cstdint>
+#include <DirectXMath.h>
+using namespace DirectX;
+
+// CPU-side mirrors of the vertex formats and constant buffers declared in the
+// HLSL shaders. Layouts must match the shader declarations byte for byte.
+
+#define MAX_LIGHTS 8
+
+// Vertex data for a colored cube.
+struct VertexPosNormColTex
+{
+    XMFLOAT3 Position;
+    XMFLOAT3 Normal;
+    XMFLOAT3 Color;
+    XMFLOAT2 Texture;
+};
+
+// Per-instance data (must be 16 byte aligned)
+struct alignas(16) PlaneInstanceData
+{
+    XMMATRIX WorldMatrix;
+    XMMATRIX InverseTransposeWorldMatrix;
+    // Index into the material table read by InstancedPixelShader.
+    uint32_t MaterialIndex;
+    uint32_t Padding[3];
+};
+
+// Per-instance data of the shadow vertex shaders: the first three columns of
+// the world matrix, all a depth-only draw needs.
+struct ShadowInstanceData
+{
+    XMFLOAT4 WorldColumns[3];
+};
+
+struct alignas(16) PerObjectTransformData
+{
+    XMMATRIX WorldMatrix;
+    XMMATRIX InverseTransposeWorldMatrix;
+    XMMATRIX WorldViewProjectMatrix;
+};
+
+// A structure to hold the data for a per-object constant buffer
+// defined in the vertex shader.
+struct PerFrameConstantBufferData
+{
+    XMMATRIX ViewProjectionMatrix;
+};
+
+struct alignas(16) _Material
+{
+    _Material()
+        : Emissive(0.0f, 0.0f, 0.0f, 1.0f)
+        , Ambient(0.1f, 0.1f, 0.1f, 1.0f)
+        , Diffuse(1.0f, 1.0f, 1.0f, 1.0f)
+        , Specular(1.0f, 1.0f, 1.0f, 1.0f)
+        , SpecularPower(128.0f)
+        , UseTexture(false)
+    {}
+
+    DirectX::XMFLOAT4 Emissive;
+    //----------------------------------- (16 byte boundary)
+    DirectX::XMFLOAT4 Ambient;
+    //----------------------------------- (16 byte boundary)
+    DirectX::XMFLOAT4 Diffuse;
+    //----------------------------------- (16 byte boundary)
+    DirectX::XMFLOAT4 Specular;
+    //----------------------------------- (16 byte boundary)
+    float SpecularPower;
+    // Add some padding complete the 16 byte boundary.
+    int UseTexture;
+    // Add some padding to complete the 16 byte boundary.
+    float Padding[2];
+    //----------------------------------- (16 byte boundary)
+    // Total:                             80 bytes (5 * 16)
+};
+
+struct MaterialProperties
+{
+    _Material Material;
+};
+
+enum LightType
+{
+    DirectionalLight = 0,
+    PointLight = 1,
+    SpotLight = 2
+};
+
+// Shading types.
+enum ShadingType
+{
+    PhongShading = 0,
+    BlinnPhongShading = 1
+};
+
+struct Light
+{
+    Light()
+        : Position(0.0f, 0.0f, 0.0f, 1.0f)
+        , Direction(0.0f, 0.0f, 1.0f, 0.0f)
+        , Color(1.0f, 1.0f, 1.0f, 1.0f)
+        , SpotAngle(DirectX::XM_PIDIV2)
+        , ConstantAttenuation(1.0f)
+        , LinearAttenuation(0.0f)
+        , QuadraticAttenuation(0.0f)
+        , LightType(DirectionalLight)
+        , Enabled(0)
+        , ShadowIndex(-1)
+    {}
+
+    DirectX::XMFLOAT4    Position;
+    //----------------------------------- (16 byte boundary)
+    DirectX::XMFLOAT4    Direction;
+    //----------------------------------- (16 byte boundary)
+    DirectX::XMFLOAT4    Color;
+    //----------------------------------- (16 byte boundary)
+    float       SpotAngle;
+    float       ConstantAttenuation;
+    float       LinearAttenuation;
+    float       QuadraticAttenuation;
+    //----------------------------------- (16 byte boundary)
+    int         LightType;
+    int         Enabled;
+    // First shadow map of the light, -1 if it casts no shadows.
+    int         ShadowIndex;
+    // Add some padding to make this struct size a multiple of 16 bytes.
+    int         Padding;
+    //----------------------------------- (16 byte boundary)
+};  // Total:                              80 bytes ( 5 * 16 )
+
+struct alignas(16) LightProperties
+{
+    LightProperties()
+        : EyePosition(0.0f, 0.0f, 0.0f, 1.0f)
+        , GlobalAmbient(0.2f, 0.2f, 0.8f, 1.0f)
+        , PhongShadingMode(PhongShading)
+    {}
+
+    DirectX::XMFLOAT4   EyePosition;
+    //----------------------------------- (16 byte boundary)
+    DirectX::XMFLOAT4   GlobalAmbient;
+    //----------------------------------- (16 byte boundary)
+    Light               Lights[MAX_LIGHTS]; // 80 * 8 bytes
+    //----------------------------------- (16 byte boundary)
+    int PhongShadingMode;
+    int Padding[3];
+    //----------------------------------- (16 byte boundary)
+    // Total:                             688 bytes (43 * 16)
+};
+
+static_assert(sizeof(PlaneInstanceData) == 144, "PlaneInstanceData must match the instanced input layout.");
+static_assert(sizeof(ShadowInstanceData) == 48, "ShadowInstanceData must match the shadow input layout.");
+static_assert(sizeof(_Material) == 80, "_Material must match the HLSL cbuffer layout.");
+static_assert(sizeof(Light) == 80, "Light must match the HLSL cbuffer layout.");
+static_assert(sizeof(LightProperties) == 688, "LightProperties must match the HLSL cbuffer layout.");
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <DirectXMath.h>
+#include "BoundingVolumeHierarchy.h"
+#include "Camera.h"
+#include "FrustumCulling.h"
+#include "ShaderTypes.h"
+using namespace DirectX;
+
+// Shadow maps for directional and spot lights, CPU side: where every map
+// looks and which casters it needs. Nothing here touches the device.
+//
+// A directional light covers the camera frustum with cascades. The view
+// depth range out to MaxDistance is split between uniform and logarithmic
+// spacing, and each cascade is an orthographic projection along the light
+// around the bounding sphere of its slice of the frustum. The sphere depends
+// only on the split depths and the camera projection, so the cascade keeps
+// its size as the camera turns, and its center is snapped to whole texels in
+// light space, so shadow edges do not crawl as the camera moves. In depth a
+// cascade runs from the caster nearest the light to the far side of its
+// sphere or the farthest caster, whichever is nearer. Receivers nearer the
+// light than every caster compare as lit, and the shader clamps the depth of
+// those beyond the range to the far plane.
+//
+// A spot light gets one perspective map over its cone, out to its range.
+//
+// Every map has a culling volume, the frustum of its projection; casters
+// outside it cannot land in the map. Casters too small to cover a texel of
+// a map are left out of it as well, since they would only alias.
+
+const uint32_t MaxShadowCascades = 4;
+const uint32_t MaxSpotShadows = 2;
+// Cascades first, then spot light maps. Must match MAX_SHADOW_VIEWS in
+// Lighting.hlsli.
+const uint32_t MaxShadowViews = MaxShadowCascades + MaxSpotShadows;
+
+struct ShadowSettings
+{
+    uint32_t CascadeCount;
+    float SplitLambda;          // 0 for uniform splits, 1 for logarithmic.
+    float MaxDistance;          // View depth where shadows end, if nearer than FarZ.
+    uint32_t Resolution;        // Texels along a side of every map.
+    float MinCasterTexels;      // Casters narrower than this in a map are culled from it.
+
+    ShadowSettings()
+        : CascadeCount(4)
+        , SplitLambda(0.75f)
+        , MaxDistance(40.0f)
+        , Resolution(2048)
+        , MinCasterTexels(1.0f)
+    {}
+};
+
+// One shadow map: a cascade or a spot light's.
+struct ShadowView
+{
+    XMMATRIX View;
+    XMMATRIX Projection;
+    XMMATRIX ViewProjection;    // Row vectors, world to the map's clip space.
+    Frustum Volume;             // Casters outside cannot land in the map.
+    float NearDepth, FarDepth;  // Camera view depths a cascade covers; 0 for spot lights.
+    float TexelSize;            // World size of a texel; per unit of distance from the light for spot lights.
+    bool Perspective;
+};
+
+// Everything the pixel shader needs to sample the maps. Must match the
+// ShadowParameters cbuffer in Lighting.hlsli.
+struct alignas(16) ShadowConstants
+{
+    XMMATRIX ShadowMatrices[MaxShadowViews];    // World to (u, v, depth) of each map.
+    //----------------------------------- (16 byte boundary)
+    float CascadeSplits[MaxShadowCascades];     // Far view depth of each cascade.
+    //----------------------------------- (16 byte boundary)
+    uint32_t CascadeCount;
+    float TexelSize;                            // 1 / resolution, in texture coordinates.
+    float Padding[2];
+    //----------------------------------- (16 byte boundary)
+    // Total:                             416 bytes (26 * 16)
+};
+
+// Split view depths [nearZ, farZ] into count cascades. splits receives
+// count + 1 depths, nearZ first and farZ last; each inner split is lerped by
+// lambda from the uniform to the logarithmic split.
+void ComputeCascadeSplits(float nearZ, float farZ, uint32_t count, float lambda, float* splits);
+
+// Fit settings.CascadeCount cascades of a directional light shining along
+// direction to the camera. casterBounds encloses every caster, e.g. the
+// scene tree's bounds; pass nullptr when there are none.
+void FitCascades(const Camera& camera, const XMFLOAT3& direction, const Aabb* casterBounds,
+    const ShadowSettings& settings, ShadowView* cascades);
+
+// Fit the perspective map of a spot light, out to range (ComputeLightRange)
+// or settings.MaxDistance, whichever is nearer.
+void FitSpotShadow(const Light& light, float range, const ShadowSettings& settings, ShadowView& view);
+
+// Whether a caster's world box (center and half extents) can land in the
+// view: inside its volume and at least minTexels texels wide. The narrow
+// phase after a broad one such as AabbTree::QueryFrustum with the volume.
+bool IsShadowCasterVisible(const ShadowView& view, const XMFLOAT3& center, const XMFLOAT3& extents, float minTexels);
+
+// Constants for viewCount maps of the given resolution, of which the first
+// cascadeCount are cascades.
+void GetShadowConstants(const ShadowView* views, uint32_t viewCount, uint32_t cascadeCount, uint32_t resolution,
+    ShadowConstants& constants);
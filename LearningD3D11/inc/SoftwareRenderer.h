@@ -0,0 +1,146 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Lighting.h"
+#include "ShaderTypes.h"
+
+// A CPU implementation of the Simple/Instanced shader pipeline used by the
+// D3D11 path. Draw calls run the vertex shader and bin the resulting
+// triangles into screen tiles; Flush() then rasterizes and shades every tile
+// in parallel. The result is an R8G8B8A8 color buffer that can be written to
+// a .tga file, so a frame can be produced without a GPU.
+//
+// Lit pixels are shaded a triangle at a time with ComputeLighting (see
+// Lighting.h): every enabled light in LightProperties, without shadows.
+class SoftwareRenderer
+{
+public:
+    enum PixelShader
+    {
+        PS_Simple,  // SimplePixelShader.hlsl
+        PS_Unlit,   // UnlitPixelShader.hlsl
+    };
+
+    static const unsigned int TileSize = 64;
+
+    SoftwareRenderer(unsigned int width, unsigned int height, unsigned int threadCount = 0);
+    ~SoftwareRenderer();
+
+    // Clear is deferred and performed per tile during Flush.
+    void Clear(const float clearColor[4], float clearDepth);
+
+    // Pipeline state. State is captured when a draw is submitted.
+    void SetLightProperties(const LightProperties& lightProperties);
+    void SetMaterial(const MaterialProperties& material);
+    void SetPixelShader(PixelShader pixelShader);
+    // RGBA8 texels (R in the low byte), sampled bilinear with wrap addressing.
+    void SetTexture(const uint32_t* texels, unsigned int width, unsigned int height);
+
+    // Runs SimpleVertexShader over the indexed vertices.
+    void DrawIndexed(const VertexPosNormColTex* vertices, const uint16_t* indices, unsigned int indexCount,
+        const PerObjectTransformData& perObject);
+
+    // Runs InstancedVertexShader once for each instance.
+    void DrawIndexedInstanced(const VertexPosNormColTex* vertices, const uint16_t* indices, unsigned int indexCountPerInstance,
+        const PlaneInstanceData* instances, unsigned int instanceCount, const PerFrameConstantBufferData& perFrame);
+
+    // Rasterize and shade all binned triangles and reset the bins.
+    void Flush();
+
+    // Write the color buffer as an uncompressed 32-bit TGA.
+    bool SaveTGA(const std::string& fileName) const;
+
+    // Write or read RGBA8 pixels (R in the low byte) as the TGA files above.
+    // LoadTGA accepts only that format.
+    static bool SaveTGA(const std::string& fileName, const uint32_t* pixels, unsigned int width, unsigned int height);
+    static bool LoadTGA(const std::string& fileName, std::vector<uint32_t>& pixels, unsigned int& width, unsigned int& height);
+
+    const uint32_t* GetColorBuffer() const { return m_ColorBuffer.data(); }
+    unsigned int GetWidth() const { return m_Width; }
+    unsigned int GetHeight() const { return m_Height; }
+    size_t GetBinnedTriangleCount() const { return m_Triangles.size(); }
+
+private:
+    // Output of the vertex shader (VertexShaderOutput in the HLSL).
+    struct ShadedVertex
+    {
+        XMFLOAT4 Position;
+        XMFLOAT4 PositionWS;
+        XMFLOAT3 NormalWS;
+        XMFLOAT4 Color;
+        XMFLOAT2 TexCoord;
+    };
+
+    // The lights of a draw, transposed once for the lighting kernel.
+    struct LightSnapshot
+    {
+        LightListSoA Lights;
+        XMFLOAT4 GlobalAmbient;
+    };
+
+    // Everything the pixel stage needs to know about a draw.
+    struct DrawState
+    {
+        MaterialProperties Material;
+        PixelShader Shader;
+        uint32_t LightPropertiesIndex;
+    };
+
+    // The pixels of one triangle that passed the depth test, lit together.
+    struct PixelBatch
+    {
+        std::vector<uint32_t> PixelIndices;
+        std::vector<XMFLOAT3> Positions;
+        std::vector<XMFLOAT3> Normals;
+        std::vector<XMFLOAT2> TexCoords;
+        std::vector<LightingResult> Lighting;
+    };
+
+    // A screen-space triangle ready for rasterization.
+    struct Triangle
+    {
+        float X[3], Y[3], Z[3], InvW[3];
+        ShadedVertex Vertices[3];
+        uint32_t DrawStateIndex;
+    };
+
+    void SubmitTriangle(const ShadedVertex& v0, const ShadedVertex& v1, const ShadedVertex& v2, uint32_t drawStateIndex);
+    void SetupTriangle(const ShadedVertex& v0, const ShadedVertex& v1, const ShadedVertex& v2, uint32_t drawStateIndex);
+    uint32_t GetDrawStateIndex();
+
+    void ShadeTile(unsigned int tileIndex);
+    void ShadePixels(const DrawState& state, PixelBatch& batch);
+    XMVECTOR SampleTexture(const XMFLOAT2& texcoord) const;
+
+    unsigned int m_Width;
+    unsigned int m_Height;
+    unsigned int m_TilesX;
+    unsigned int m_TilesY;
+    unsigned int m_ThreadCount;
+
+    std::vector<uint32_t> m_ColorBuffer;
+    std::vector<float> m_DepthBuffer;
+
+    bool m_ClearPending;
+    uint32_t m_ClearColor;
+    float m_ClearDepth;
+
+    // Current pipeline state.
+    MaterialProperties m_Material;
+    PixelShader m_PixelShader;
+    bool m_DrawStateDirty;
+    bool m_LightPropertiesDirty;
+    LightProperties m_LightProperties;
+
+    std::vector<uint32_t> m_Texture;
+    unsigned int m_TextureWidth;
+    unsigned int m_TextureHeight;
+
+    // Per-frame data, consumed by Flush.
+    std::vector<LightSnapshot> m_LightSnapshots;
+    std::vector<DrawState> m_DrawStates;
+    std::vector<Triangle> m_Triangles;
+    std::vector<std::vector<uint32_t>> m_TileBins;
+    std::vector<ShadedVertex> m_ShadedVertices;
+};
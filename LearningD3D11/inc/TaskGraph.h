@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+#include "JobSystem.h"
+
+// Stages of a frame declared with the resources they read and write, run on
+// a JobSystem as soon as the stages they depend on have finished.
+//
+// Dependencies follow from declaration order, as if the stages ran one after
+// another in that order: a stage waits for the last earlier stage that
+// writes anything it reads or writes, and for earlier stages reading
+// something it writes since that was last written. Stages that touch
+// nothing in common run in parallel. The graph is built once and run every
+// frame.
+class TaskGraph
+{
+public:
+    typedef uint32_t ResourceId;
+    typedef uint32_t TaskId;
+    typedef std::function<void()> TaskFunction;
+
+    TaskGraph() : m_Compiled(false) {}
+
+    // Names are for profiling and debugging. Both return the new id.
+    ResourceId AddResource(const char* name);
+    TaskId AddTask(const char* name, TaskFunction function,
+        std::initializer_list<ResourceId> reads, std::initializer_list<ResourceId> writes);
+    // As above for resource lists built at run time.
+    TaskId AddTask(const char* name, TaskFunction function,
+        const std::vector<ResourceId>& reads, const std::vector<ResourceId>& writes);
+
+    // Derive the dependencies. Called by the first Run after a change.
+    void Compile();
+
+    // Run every task once and wait for all of them. Not reentrant.
+    void Run(JobSystem& jobs);
+
+    size_t GetTaskCount() const { return m_Tasks.size(); }
+    const char* GetTaskName(TaskId task) const { return m_Tasks[task].Name.c_str(); }
+    // Tasks that must finish before task starts, after Compile.
+    const std::vector<TaskId>& GetPredecessors(TaskId task) const { return m_Tasks[task].Predecessors; }
+
+private:
+    struct Task
+    {
+        std::string Name;
+        TaskFunction Function;
+        std::vector<ResourceId> Reads;
+        std::vector<ResourceId> Writes;
+        std::vector<TaskId> Predecessors;
+        std::vector<TaskId> Successors;
+    };
+
+    void Submit(JobSystem& jobs, TaskId task, JobCounter& counter);
+
+    std::vector<Task> m_Tasks;
+    std::vector<std::string> m_ResourceNames;
+    bool m_Compiled;
+
+    // Predecessors still running, per task, during Run.
+    std::unique_ptr<std::atomic<uint32_t>[]> m_Remaining;
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include "TextureStreaming.h"
+
+// Offline texture cooking: full mip chain, block compression, DDS output.
+
+struct TextureCookOptions
+{
+    TextureCookOptions()
+        : Format(TF_BC7)
+        , GammaCorrectMips(true)
+        , SRGB(false)
+        , ThreadCount(0)
+    {}
+
+    TextureFormat Format;       // TF_RGBA8 only builds the mip chain.
+    bool GammaCorrectMips;      // Filter color in linear light (see GenerateMipChain).
+    bool SRGB;                  // Tag the output for sampling through an _SRGB view.
+    unsigned int ThreadCount;   // Block encoding threads, 0 for all cores.
+};
+
+// Build the mip chain of a single-level RGBA8 image and encode every level.
+bool CookTexture(const TextureImage& source, const TextureCookOptions& options, TextureImage& cooked);
+
+// Decode sourceFileName with decoder, cook it and write it as a DDS file.
+bool CookTextureFile(TextureDecoder& decoder, const std::string& sourceFileName, const std::string& cookedFileName,
+    const TextureCookOptions& options = TextureCookOptions());
@@ -0,0 +1,215 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Asynchronous texture streaming.
+//
+// Source images are decoded and their mip chains built on a pool of worker
+// threads. The owner thread calls TextureStreamer::Update once per frame,
+// which hands finished mips to a TextureUploadSink: first the mip tail (every
+// mip no larger than TailSize), then more detailed levels, a few per Update,
+// up to the level the texture was last used at. Until the tail arrives the
+// sink binds a placeholder. Resident mips are kept under a byte budget by dropping
+// the most detailed level of the least recently used textures.
+//
+// The streamer knows nothing about the device: D3D11TextureUploadSink
+// creates the textures, RecordingTextureUploadSink only tracks residency for
+// headless runs.
+
+typedef uint32_t TextureHandle;
+const TextureHandle InvalidTexture = 0xFFFFFFFF;
+
+enum TextureFormat
+{
+    TF_RGBA8,
+    TF_BC1,     // RGB and 1-bit alpha, 8 bytes per 4x4 block.
+    TF_BC3,     // RGBA, 16 bytes per 4x4 block.
+    TF_BC7,     // RGBA, 16 bytes per 4x4 block.
+};
+
+// Image and its mip chain. RGBA8 rows are tightly packed; block compressed
+// mips are rows of 4x4 blocks.
+struct TextureImage
+{
+    TextureImage() : Width(0), Height(0), Format(TF_RGBA8), SRGB(false) {}
+
+    uint32_t Width;
+    uint32_t Height;
+    TextureFormat Format;
+    bool SRGB;                                  // Sample through an _SRGB view format.
+    std::vector<std::vector<uint8_t>> Mips;     // Mips[0] is full resolution.
+
+    uint32_t GetMipCount() const { return static_cast<uint32_t>(Mips.size()); }
+};
+
+uint32_t GetMipDimension(uint32_t size, uint32_t mip);
+// Bytes per row of pixels, or of blocks for compressed formats.
+uint32_t GetMipPitch(TextureFormat format, uint32_t width, uint32_t mip);
+uint64_t GetMipSize(TextureFormat format, uint32_t width, uint32_t height, uint32_t mip);
+// Bytes of mips [firstMip, mipCount).
+uint64_t GetMipChainSize(TextureFormat format, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t firstMip);
+uint32_t GetFullMipCount(uint32_t width, uint32_t height);
+
+// Fill Mips[1..] of an RGBA8 image from Mips[0] with a 2x2 box filter, down
+// to 1x1. Odd sizes repeat the last row or column. With gammaCorrect, color
+// is treated as sRGB encoded and averaged in linear light; alpha is always
+// averaged as stored.
+void GenerateMipChain(TextureImage& image, bool gammaCorrect = true);
+
+// Loads a source image into image. Decoders either return a single RGBA8
+// level, whose mip chain the streamer builds, or every level of a cooked
+// image. Called on worker threads, so it must be safe to call concurrently.
+class TextureDecoder
+{
+public:
+    virtual ~TextureDecoder() {}
+
+    // fileName is UTF-8.
+    virtual bool Decode(const std::string& fileName, TextureImage& image) = 0;
+};
+
+// Owns the device copies of the streamed textures. Only ever called from
+// TextureStreamer::Update, on the owner thread.
+class TextureUploadSink
+{
+public:
+    virtual ~TextureUploadSink() {}
+
+    // Make mips [firstMip, image.GetMipCount()) of the texture resident,
+    // replacing what was resident before.
+    virtual bool Upload(TextureHandle texture, const TextureImage& image, uint32_t firstMip) = 0;
+    // Drop every mip more detailed than firstMip and keep the rest resident.
+    virtual bool Trim(TextureHandle texture, uint32_t firstMip) = 0;
+};
+
+struct TextureStreamingSettings
+{
+    TextureStreamingSettings()
+        : BudgetBytes(64ull << 20)
+        , UploadBytesPerUpdate(8ull << 20)
+        , TailSize(64)
+        , ThreadCount(0)
+    {}
+
+    uint64_t BudgetBytes;           // Resident mips of all textures.
+    uint64_t UploadBytesPerUpdate;  // Bounds the upload work of one Update.
+    uint32_t TailSize;              // Mips no larger than this are uploaded first, together, and never evicted.
+    unsigned int ThreadCount;       // Decode threads, 0 for GetDefaultThreadCount() - 1 (at least 1).
+};
+
+struct TextureStreamingStats
+{
+    uint32_t QueueDepth;            // Decodes waiting or running.
+    uint32_t TextureCount;
+    uint32_t ResidentTextureCount;  // At least the tail resident.
+    uint32_t FailedTextureCount;
+    uint64_t BytesResident;
+    uint64_t BudgetBytes;
+    uint64_t BytesUploaded;         // Since creation.
+    uint32_t MipsEvicted;           // Since creation.
+    double AverageTimeToFirstPixel; // Milliseconds from Request to the tail being resident.
+    double MaxTimeToFirstPixel;
+};
+
+class TextureStreamer
+{
+public:
+    TextureStreamer(TextureDecoder& decoder, TextureUploadSink& sink,
+        const TextureStreamingSettings& settings = TextureStreamingSettings());
+    // Waits for running decodes; queued ones are dropped.
+    ~TextureStreamer();
+
+    // Queue a texture for decoding. Requesting a file twice returns the same
+    // handle.
+    TextureHandle Request(const std::string& fileName);
+
+    // The texture is on screen this frame and wants mips from mip down to the
+    // tail. The smallest mip marked during a frame wins.
+    void MarkUsed(TextureHandle texture, uint32_t mip = 0);
+
+    // Consume finished decodes, evict and upload. Call once per frame on the
+    // thread that owns the sink; frameNumber must increase every call.
+    void Update(uint64_t frameNumber);
+
+    void SetBudget(uint64_t budgetBytes) { m_Settings.BudgetBytes = budgetBytes; }
+
+    // Most detailed resident mip, or the texture's mip count if nothing is
+    // resident yet (0 before its first decode finishes).
+    uint32_t GetResidentMip(TextureHandle texture) const;
+    uint32_t GetMipCount(TextureHandle texture) const;
+    bool IsFailed(TextureHandle texture) const;
+
+    TextureStreamingStats GetStats() const;
+
+private:
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    typedef std::chrono::steady_clock Clock;
+
+    // Everything here is only touched on the owner thread.
+    struct StreamedTexture
+    {
+        std::string FileName;
+        uint32_t Width;
+        uint32_t Height;
+        TextureFormat Format;
+        uint32_t MipCount;          // 0 until the first decode finishes.
+        uint32_t TailMip;           // First mip of the tail.
+        uint32_t ResidentMip;       // MipCount if nothing is resident.
+        uint32_t WantedMip;         // Smallest mip marked this frame, all bits set if unused.
+        uint64_t LastUsedFrame;
+        bool DecodePending;
+        bool Failed;
+        bool EverResident;
+        // Kept while mips are still being streamed in, freed once the
+        // wanted level is resident.
+        std::unique_ptr<TextureImage> Image;
+        Clock::time_point RequestTime;
+    };
+
+    struct DecodeResult
+    {
+        TextureHandle Texture;
+        std::unique_ptr<TextureImage> Image;    // Null if decoding failed.
+    };
+
+    void WorkerThread();
+    void QueueDecode(TextureHandle texture);
+    // First mip of the tail for an image of this size.
+    uint32_t GetTailMip(TextureFormat format, uint32_t width, uint32_t height, uint32_t mipCount) const;
+    // Drop LRU levels not used this frame until size more bytes fit in the
+    // budget. False if that is not possible.
+    bool MakeRoom(uint64_t size, TextureHandle requester);
+    bool StreamIn(TextureHandle handle, uint64_t& uploadBytes);
+
+    TextureDecoder& m_Decoder;
+    TextureUploadSink& m_Sink;
+    TextureStreamingSettings m_Settings;
+
+    std::vector<StreamedTexture> m_Textures;
+    uint64_t m_FrameNumber;
+    uint64_t m_BytesResident;
+    uint64_t m_BytesUploaded;
+    uint32_t m_MipsEvicted;
+    uint32_t m_FirstPixelCount;
+    double m_TotalTimeToFirstPixel;
+    double m_MaxTimeToFirstPixel;
+
+    // Shared with the workers.
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    std::deque<std::pair<TextureHandle, std::string>> m_DecodeQueue;
+    std::vector<DecodeResult> m_Finished;
+    uint32_t m_DecodesRunning;
+    bool m_Stopping;
+    std::vector<std::thread> m_Workers;
+};
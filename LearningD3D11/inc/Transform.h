@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <DirectXMath.h>
+using namespace DirectX;
+
+// What a world matrix is made of, from cheapest to most expensive to invert.
+// Matrices composed as scale * rotation * translation are at most
+// TC_AxisScale; anything with shear or projection is TC_General.
+enum TransformClass : uint8_t
+{
+    TC_Rigid,           // Rotation and translation only.
+    TC_UniformScale,    // Rigid with the same scale on every axis.
+    TC_AxisScale,       // Rigid with a different scale per local axis.
+    TC_General,         // Anything else, needs a full inverse.
+};
+
+// Classify a scale * rotation * translation transform from its scale.
+TransformClass ClassifyScale(const XMFLOAT3& scale);
+
+// Class of first * second (first applied first). A non-uniform scale that
+// follows a rotation introduces shear, so it is treated as general.
+TransformClass CombineTransformClass(TransformClass first, TransformClass second);
+
+// Build scale * rotation * translation without the general matrix products.
+// The class of the result is ClassifyScale(scale).
+XMMATRIX ComposeTransform(FXMVECTOR scale, FXMVECTOR rotationQuaternion, FXMVECTOR translation);
+
+// Transpose of the inverse of an affine world matrix, as used for
+// InverseTransposeWorldMatrix. Rigid, uniform and axis scaled transforms use a
+// closed form (each basis row divided by its squared length); TC_General falls
+// back to XMMatrixInverse.
+XMMATRIX ComputeInverseTransposeWorldMatrix(FXMMATRIX worldMatrix, TransformClass transformClass);
+
+// Batched version over arrays of matrices with one class per matrix. Works on
+// four matrices at a time in structure-of-arrays form; TC_General matrices in
+// a group, and the last count % 4, go through ComputeInverseTransposeWorldMatrix.
+void ComputeInverseTransposeWorldMatrices(const XMFLOAT4X4A* worldMatrices, const TransformClass* transformClasses,
+    size_t count, XMFLOAT4X4A* inverseTransposeWorldMatrices);
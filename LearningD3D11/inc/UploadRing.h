@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Bookkeeping for a ring of upload memory shared by several frames in flight.
+// It hands out aligned offsets and knows nothing about the device: the owner
+// calls EndFrame after the last allocation of a frame and RetireFrames once
+// the GPU is known to be done with a frame (e.g. a fence or event query has
+// signalled), which makes that frame's space reusable.
+class UploadRing
+{
+public:
+    static const size_t InvalidOffset = ~size_t(0);
+
+    // capacity is rounded down to a multiple of alignment, which must be a
+    // power of two. 256 matches D3D11.1 constant buffer offsets.
+    explicit UploadRing(size_t capacity = 0, size_t alignment = 256);
+
+    void Reset(size_t capacity, size_t alignment = 256);
+
+    // Offset of size bytes rounded up to the alignment, or InvalidOffset if
+    // the space not yet retired leaves no room. An allocation never straddles
+    // the end of the ring; the skipped tail is released with its frame.
+    size_t Allocate(size_t size);
+
+    // Close the current frame. Everything allocated since the previous
+    // EndFrame belongs to frameNumber, which must increase every call.
+    void EndFrame(uint64_t frameNumber);
+
+    // Release the space of every closed frame up to and including frameNumber.
+    void RetireFrames(uint64_t frameNumber);
+
+    // Oldest closed frame that has not been retired. Only valid if
+    // GetFramesInFlight() > 0.
+    uint64_t GetOldestFrameInFlight() const { return m_Frames.front().FrameNumber; }
+    size_t GetFramesInFlight() const { return m_Frames.size(); }
+
+    size_t GetCapacity() const { return m_Capacity; }
+    size_t GetAlignment() const { return m_Alignment; }
+    size_t GetUsedSize() const { return static_cast<size_t>(m_Allocated - m_Retired); }
+
+private:
+    struct Frame
+    {
+        uint64_t FrameNumber;
+        uint64_t AllocatedAtEnd;
+        size_t HeadAtEnd;
+    };
+
+    size_t m_Capacity;
+    size_t m_Alignment;
+
+    // Next allocation starts at m_Head; the oldest live data starts at m_Tail.
+    size_t m_Head;
+    size_t m_Tail;
+
+    // Running totals (including skipped space) so the used size does not
+    // depend on how often the ring has wrapped.
+    uint64_t m_Allocated;
+    uint64_t m_Retired;
+
+    std::deque<Frame> m_Frames;
+};
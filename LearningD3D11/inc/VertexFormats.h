@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <DirectXPackedVector.h>
+#include "ShaderTypes.h"
+
+// Compact alternative to VertexPosNormColTex (44 bytes) for static meshes.
+// VertexPacked is 20 bytes:
+//   Position   4 x 16 bit, R16G16B16A16_UNORM or _FLOAT (see PositionEncoding),
+//              decoded with the mesh's VertexQuantization.
+//   Normal     2 x 16 bit SNORM, octahedral encoding of the unit normal.
+//   Color      4 x 8 bit UNORM.
+//   Texture    2 x 16 bit FLOAT.
+// D3D11VertexFormats.h has the matching input elements and
+// shaders/VertexDecode.hlsli the shader side of the decode.
+
+enum PositionEncoding
+{
+    PE_Unorm16,     // [0, 1] over the mesh bounds; uniform precision of 1/65535 of the extent.
+    PE_Half,        // [-1, 1] around the bounds center; finer near the center, 1/2048 of the half extent at the edges.
+};
+
+struct VertexPacked
+{
+    uint16_t Position[4];   // w is unused.
+    int16_t Normal[2];
+    uint8_t Color[4];       // Alpha is always 255.
+    uint16_t Texture[2];
+};
+static_assert(sizeof(VertexPacked) == 20, "VertexPacked must match the packed input layout");
+
+// decoded position = encoded position * PositionScale + PositionBias. Matches
+// the MeshQuantization cbuffer in VertexDecode.hlsli.
+struct alignas(16) VertexQuantization
+{
+    XMFLOAT4 PositionScale;     // w is 0.
+    //----------------------------------- (16 byte boundary)
+    XMFLOAT4 PositionBias;      // w is 1.
+    //----------------------------------- (16 byte boundary)
+    // Total:                             32 bytes (2 * 16)
+};
+
+// Scale and bias mapping the bounds of the vertices onto the encoding's range.
+VertexQuantization ComputeVertexQuantization(const VertexPosNormColTex* vertices, size_t count, PositionEncoding encoding);
+
+// Octahedral mapping of a unit vector to [-1, 1]^2 (returned in x and y) and
+// back.
+XMVECTOR XM_CALLCONV EncodeOctahedral(FXMVECTOR normal);
+XMVECTOR XM_CALLCONV DecodeOctahedral(FXMVECTOR encoded);
+
+void PackVertices(const VertexPosNormColTex* vertices, size_t count, const VertexQuantization& quantization,
+    PositionEncoding encoding, VertexPacked* packedVertices);
+
+// Inverse of PackVertices, for tools and for measuring the encoding error.
+// Decoded normals are unit length.
+void UnpackVertices(const VertexPacked* packedVertices, size_t count, const VertexQuantization& quantization,
+    PositionEncoding encoding, VertexPosNormColTex* vertices);
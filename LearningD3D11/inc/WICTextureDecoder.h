@@ -0,0 +1,12 @@
+#pragma once
+#include "TextureStreaming.h"
+
+// Decodes any image format WIC supports (JPEG, PNG, BMP, ...) to 8-bit RGBA.
+// COM is initialized on the calling thread for the duration of each decode.
+// Cooked .dds files are read as they are, with all their mips (see
+// DDSFile.h).
+class WICTextureDecoder : public TextureDecoder
+{
+public:
+    bool Decode(const std::string& fileName, TextureImage& image) override;
+};
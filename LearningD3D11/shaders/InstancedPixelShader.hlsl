@@ -0,0 +1,20 @@
+#include "Lighting.hlsli"
+
+// The whole material table; each instance carries its index, so one draw can
+// mix materials.
+StructuredBuffer<_Material> Materials : register(t1);
+
+struct PixelShaderInput
+{
+    float2 texcoord : TEXCOORD;
+    float4 color : COLOR;
+    float3 normalWS : WS_NORMAL;
+    float4 positionWS : WS_POSTION;
+    nointerpolation uint materialIndex : MATERIALINDEX;
+    float4 position : SV_POSITION;
+};
+
+float4 InstancedPixelShader( PixelShaderInput IN ) : SV_TARGET
+{
+    return ShadeSurface(Materials[IN.materialIndex], IN.positionWS, IN.normalWS, IN.texcoord, IN.position.xy);
+}
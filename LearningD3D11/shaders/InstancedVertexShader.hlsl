@@ -11,6 +11,7 @@ struct AppData
 
     matrix worldMatrix : WORLDMATRIX;
     matrix inverseTransposeWorldMatrix : INVERSETRANSPOSEWORLDMATRIX;
+    uint materialIndex : MATERIALINDEX;
 
 };
 
@@ -20,6 +21,7 @@ struct VertexShaderOutput
     float4 color : COLOR;
     float3 normalWS : WS_NORMAL;
     float4 positionWS : WS_POSTION;
+    nointerpolation uint materialIndex : MATERIALINDEX;
     float4 position : SV_POSITION;
 };
 
@@ -33,6 +35,7 @@ VertexShaderOutput InstancedVertexShader( AppData IN )
     OUT.color = float4( IN.color, 1.0f );
     OUT.normalWS = mul((float3x3) IN.inverseTransposeWorldMatrix, IN.normal);
     OUT.positionWS = mul(IN.worldMatrix, float4(IN.position, 1));
+    OUT.materialIndex = IN.materialIndex;
     OUT.position = mul(MVP, float4(IN.position, 1.0f));
     return OUT;
 }
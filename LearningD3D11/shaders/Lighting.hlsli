@@ -0,0 +1,305 @@
+// Lighting shared by the lit pixel shaders, which differ only in where the
+// material comes from.
+
+#define MAX_LIGHTS 8
+// Shadow maps: cascades of one directional light first, then spot lights.
+// See ShadowMapping.h.
+#define MAX_SHADOW_CASCADES 4
+#define MAX_SHADOW_VIEWS 6
+ 
+// Light types.
+#define DIRECTIONAL_LIGHT 0
+#define POINT_LIGHT 1
+#define SPOT_LIGHT 2
+
+// Shading types.
+#define PHONG_SHADING 0
+#define BLINN_PHONG_SHADING 1
+
+struct _Material
+{
+    float4 Emissive;        // 16 bytes
+    //----------------------------------- (16 byte boundary)
+    float4 Ambient;         // 16 bytes
+    //------------------------------------(16 byte boundary)
+    float4 Diffuse;         // 16 bytes
+    //----------------------------------- (16 byte boundary)
+    float4 Specular;        // 16 bytes
+    //----------------------------------- (16 byte boundary)
+    float SpecularPower;    // 4 bytes
+    bool UseTexture;        // 4 bytes
+    float2 Padding;         // 8 bytes
+    //----------------------------------- (16 byte boundary)
+}; // Total:  // 80 bytes ( 5 * 16 )
+
+struct Light
+{
+    float4 Position; // 16 bytes
+    //----------------------------------- (16 byte boundary)
+    float4 Direction; // 16 bytes
+    //----------------------------------- (16 byte boundary)
+    float4 Color; // 16 bytes
+    //----------------------------------- (16 byte boundary)
+    float SpotAngle; // 4 bytes
+    float ConstantAttenuation; // 4 bytes
+    float LinearAttenuation; // 4 bytes
+    float QuadraticAttenuation; // 4 bytes
+    //----------------------------------- (16 byte boundary)
+    int LightType; // 4 bytes
+    bool Enabled; // 4 bytes
+    int ShadowIndex; // 4 bytes, first shadow map or -1
+    int Padding; // 4 bytes
+    //----------------------------------- (16 byte boundary)
+}; // Total: // 80 bytes (5 * 16)
+
+cbuffer LightProperties : register(b1)
+{
+    float4 EyePosition;       // 16 bytes
+    //----------------------------------- (16 byte boundary)
+    float4 GlobalAmbient;     // 16 bytes
+    //----------------------------------- (16 byte boundary)
+    Light Lights[MAX_LIGHTS]; // 80 * MAX_LIGHTS(8) = 640 bytes
+    //----------------------------------- (16 byte boundary)
+    int PhongShadingMode;     // 4 bytes
+    int3 Padding;             // 12 bytes
+    //----------------------------------- (16 byte boundary)
+};  // Total:// 688 bytes (43 * 16)
+
+struct LightingResult
+{
+    float4 Diffuse;
+    float4 Specular;
+};
+
+// Clustered lighting, see ClusteredLighting.h. The screen is split into
+// tiles and the view depth into exponential slices; each cluster has a range
+// of ClusterLightIndices, which index ClusterLights.
+cbuffer ClusterParameters : register(b2)
+{
+    matrix ViewMatrix;
+    uint3 ClusterCount;
+    uint ClusterPadding;
+    float2 TileSize;
+    float SliceScale;
+    float SliceBias;
+};
+
+// Shadow maps, one slice each. ShadowMatrices take world positions to
+// (u, v, depth) of each map; CascadeSplits holds the far view depth of each
+// cascade, beyond the last of which nothing is shadowed.
+cbuffer ShadowParameters : register(b3)
+{
+    matrix ShadowMatrices[MAX_SHADOW_VIEWS];
+    float4 CascadeSplits;
+    uint CascadeCount;
+    float ShadowTexelSize;
+    float2 ShadowPadding;
+};
+
+Texture2D Texture : register(t0);
+sampler Sampler : register(s0);
+
+StructuredBuffer<Light> ClusterLights : register(t2);
+StructuredBuffer<uint2> ClusterRanges : register(t3);       // Offset, count.
+StructuredBuffer<uint> ClusterLightIndices : register(t4);
+
+Texture2DArray<float> ShadowMaps : register(t5);
+SamplerComparisonState ShadowSampler : register(s1);
+ 
+float4 DoDiffuse(Light light, float3 surfaceToLightVector, float3 normal)
+{
+    float dotLightAndNormal = max(0, dot(surfaceToLightVector, normal)); // Keep the value positive.
+    return light.Color * dotLightAndNormal;
+}
+
+float4 DoSpecular(Light light, float3 surfaceToLightVector, float3 eyeVector, float3 normal, int phongMode, float specularPower)
+{
+    if (phongMode == PHONG_SHADING)
+    {
+        float3 reflectedLightVector = normalize(reflect(surfaceToLightVector, normal));
+        float dotEyeAndReflectedLight = max(0, dot(eyeVector, reflectedLightVector));
+        return light.Color * pow(dotEyeAndReflectedLight, specularPower);
+    }
+    else
+    {
+        float3 halfAngleVector = normalize(surfaceToLightVector + eyeVector);
+        float dotHalfAngleAndNormal = max(0, dot(normal, halfAngleVector));
+        return light.Color * pow(dotHalfAngleAndNormal, specularPower);
+    }
+}
+
+float DoAttenuation(Light light, float distance)
+{
+    return 1.0f / (light.ConstantAttenuation + 
+                    light.LinearAttenuation * distance + 
+                    light.QuadraticAttenuation * distance * distance);
+}
+
+LightingResult DoPointLight(Light light, float3 eyeVector, float4 surfacePosition, float3 normal, float specularPower)
+{
+    LightingResult result;
+    
+    float3 surfaceToLightVector = (light.Position - surfacePosition).xyz;
+    float distance = length(surfaceToLightVector);
+    surfaceToLightVector = surfaceToLightVector / distance; //normalize.
+    
+    float attenuation = DoAttenuation(light, distance);
+    
+    result.Diffuse = DoDiffuse(light, surfaceToLightVector, normal) * attenuation;
+    result.Specular = DoSpecular(light, eyeVector, surfaceToLightVector, normal, PhongShadingMode, specularPower) * attenuation;
+    
+    return result;
+}
+
+LightingResult DoDirectionalLight(Light light, float3 eyeVector, float3 normal, float specularPower)
+{
+    LightingResult result;
+
+    float3 surfaceToLightVector = -normalize(light.Direction.xyz);
+
+    result.Diffuse = DoDiffuse(light, surfaceToLightVector, normal);
+    result.Specular = DoSpecular(light, eyeVector, surfaceToLightVector, normal, PhongShadingMode, specularPower);
+
+    return result;
+}
+
+float DoSpotCone(Light light, float3 surfaceToLightVector)
+{
+    // SpotAngle is the half angle of the cone; fade over its outer quarter.
+    // GetSpotMaxCos in Lighting.h mirrors this for the CPU lighting.
+    float minCos = cos(light.SpotAngle);
+    float maxCos = lerp(minCos, 1, 0.25f);
+    float cosAngle = dot(normalize(light.Direction.xyz), -surfaceToLightVector);
+    return smoothstep(minCos, maxCos, cosAngle);
+}
+
+LightingResult DoSpotLight(Light light, float3 eyeVector, float4 surfacePosition, float3 normal, float specularPower)
+{
+    LightingResult result;
+
+    float3 surfaceToLightVector = (light.Position - surfacePosition).xyz;
+    float distance = length(surfaceToLightVector);
+    surfaceToLightVector = surfaceToLightVector / distance; //normalize.
+
+    float attenuation = DoAttenuation(light, distance) * DoSpotCone(light, surfaceToLightVector);
+
+    result.Diffuse = DoDiffuse(light, surfaceToLightVector, normal) * attenuation;
+    result.Specular = DoSpecular(light, eyeVector, surfaceToLightVector, normal, PhongShadingMode, specularPower) * attenuation;
+
+    return result;
+}
+
+// Fraction of a shadow map's light reaching the surface point: 3x3 bilinear
+// comparisons, 4x4 texels. Points outside the map are lit; points beyond
+// its far plane compare as if on it.
+float SampleShadowMap(uint slice, float4 surfacePosition)
+{
+    float4 shadowPosition = mul(ShadowMatrices[slice], surfacePosition);
+    shadowPosition.xyz /= shadowPosition.w;
+    float depth = min(shadowPosition.z, 1.0f);
+
+    float lit = 0;
+    [unroll]
+    for (int y = -1; y <= 1; ++y)
+    {
+        [unroll]
+        for (int x = -1; x <= 1; ++x)
+        {
+            float3 location = float3(shadowPosition.xy + float2(x, y) * ShadowTexelSize, slice);
+            lit += ShadowMaps.SampleCmpLevelZero(ShadowSampler, location, depth);
+        }
+    }
+    return lit / 9.0f;
+}
+
+// The light's shadow term, from the cascade the view depth falls in for a
+// directional light and from its one map for a spot light.
+float DoShadow(Light light, float4 surfacePosition, float viewDepth)
+{
+    if (light.ShadowIndex < 0)
+    {
+        return 1.0f;
+    }
+    if (light.LightType != DIRECTIONAL_LIGHT)
+    {
+        return SampleShadowMap(light.ShadowIndex, surfacePosition);
+    }
+
+    uint cascade = 0;
+    [unroll]
+    for (uint i = 0; i < MAX_SHADOW_CASCADES; ++i)
+    {
+        cascade += (i < CascadeCount && viewDepth > CascadeSplits[i]) ? 1 : 0;
+    }
+    return (cascade < CascadeCount) ? SampleShadowMap(light.ShadowIndex + cascade, surfacePosition) : 1.0f;
+}
+
+uint GetClusterIndex(float viewDepth, float2 screenPosition)
+{
+    uint2 tile = min((uint2)(screenPosition / TileSize), ClusterCount.xy - 1);
+    uint slice = (uint)clamp(floor(log(max(viewDepth, 1e-4f)) * SliceScale + SliceBias), 0, ClusterCount.z - 1);
+    return tile.x + ClusterCount.x * (tile.y + ClusterCount.y * slice);
+}
+
+// Sum of the lights assigned to the cluster containing the surface point.
+// screenPosition is SV_Position.xy.
+LightingResult ComputeLighting(float4 surfacePosition, float3 normal, float specularPower, float2 screenPosition)
+{
+    LightingResult totalResult = { { 0, 0, 0, 0 }, { 0, 0, 0, 0 } };
+
+    float viewDepth = mul(ViewMatrix, surfacePosition).z;
+    uint2 range = ClusterRanges[GetClusterIndex(viewDepth, screenPosition)];
+
+    [loop]
+    for (uint i = 0; i < range.y; ++i)
+    {
+        Light light = ClusterLights[ClusterLightIndices[range.x + i]];
+        LightingResult result;
+
+        [branch]
+        if (light.LightType == DIRECTIONAL_LIGHT)
+        {
+            result = DoDirectionalLight(light, EyePosition.xyz, normal, specularPower);
+        }
+        else if (light.LightType == POINT_LIGHT)
+        {
+            result = DoPointLight(light, EyePosition.xyz, surfacePosition, normal, specularPower);
+        }
+        else
+        {
+            result = DoSpotLight(light, EyePosition.xyz, surfacePosition, normal, specularPower);
+        }
+
+        float shadow = DoShadow(light, surfacePosition, viewDepth);
+        totalResult.Diffuse += result.Diffuse * shadow;
+        totalResult.Specular += result.Specular * shadow;
+    }
+
+    totalResult.Diffuse = saturate(totalResult.Diffuse);
+    totalResult.Specular = saturate(totalResult.Specular);
+
+    return totalResult;
+}
+
+// Emissive + ambient + diffuse + specular for one surface point.
+// screenPosition is SV_Position.xy.
+float4 ShadeSurface(_Material material, float4 positionWS, float3 normalWS, float2 texcoord, float2 screenPosition)
+{
+    LightingResult lit = ComputeLighting(positionWS, normalize(normalWS), material.SpecularPower, screenPosition);
+
+    float4 emissive = material.Emissive;
+    float4 ambient = material.Ambient * GlobalAmbient;
+    float4 diffuse = material.Diffuse * lit.Diffuse;
+    float4 specular = material.Specular * lit.Specular;
+    
+    float4 texColor = { 1, 1, 1, 1 };
+
+    if (material.UseTexture)
+    {
+        texColor = Texture.Sample(Sampler, texcoord);
+    }
+    
+    float4 finalColor = (emissive + ambient + diffuse + specular) * texColor;
+    
+    return finalColor;
+}
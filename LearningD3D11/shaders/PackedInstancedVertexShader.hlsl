@@ -0,0 +1,45 @@
+#include "VertexDecode.hlsli"
+
+cbuffer PerFrame : register( b0 )
+{
+    matrix viewProjectionMatrix;
+}
+
+struct AppData
+{
+    // VertexPacked, decoded to floats by the input assembler.
+    float4 position : POSITION;
+    float2 normal : NORMAL;
+    float4 color : COLOR;
+
+    matrix worldMatrix : WORLDMATRIX;
+    matrix inverseTransposeWorldMatrix : INVERSETRANSPOSEWORLDMATRIX;
+    uint materialIndex : MATERIALINDEX;
+};
+
+struct VertexShaderOutput
+{
+    float2 texcoord : TEXCOORD;
+    float4 color : COLOR;
+    float3 normalWS : WS_NORMAL;
+    float4 positionWS : WS_POSTION;
+    nointerpolation uint materialIndex : MATERIALINDEX;
+    float4 position : SV_POSITION;
+};
+
+VertexShaderOutput PackedInstancedVertexShader( AppData IN )
+{
+    VertexShaderOutput OUT;
+
+    float4 position = DecodePosition(IN.position);
+    float3 normal = DecodeOctahedral(IN.normal);
+    matrix MVP = mul(viewProjectionMatrix, IN.worldMatrix);
+
+    OUT.texcoord = float2(0, 0);
+    OUT.color = IN.color;
+    OUT.normalWS = mul((float3x3) IN.inverseTransposeWorldMatrix, normal);
+    OUT.positionWS = mul(IN.worldMatrix, position);
+    OUT.materialIndex = IN.materialIndex;
+    OUT.position = mul(MVP, position);
+    return OUT;
+}
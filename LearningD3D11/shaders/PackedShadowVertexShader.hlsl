@@ -0,0 +1,24 @@
+#include "VertexDecode.hlsli"
+
+// ShadowVertexShader for VertexPacked vertices.
+cbuffer PerFrame : register( b0 )
+{
+    matrix viewProjectionMatrix;    // The shadow map's.
+}
+
+struct AppData
+{
+    // VertexPacked position, decoded to floats by the input assembler.
+    float4 position : POSITION;
+
+    float4 worldColumn0 : WORLDCOLUMN0;
+    float4 worldColumn1 : WORLDCOLUMN1;
+    float4 worldColumn2 : WORLDCOLUMN2;
+};
+
+float4 PackedShadowVertexShader( AppData IN ) : SV_POSITION
+{
+    float4 position = DecodePosition(IN.position);
+    float4 positionWS = float4(dot(IN.worldColumn0, position), dot(IN.worldColumn1, position), dot(IN.worldColumn2, position), 1.0f);
+    return mul(viewProjectionMatrix, positionWS);
+}
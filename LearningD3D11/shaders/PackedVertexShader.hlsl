@@ -0,0 +1,41 @@
+#include "VertexDecode.hlsli"
+
+cbuffer PerObject : register( b0 )
+{
+    matrix worldMatrix;
+    matrix inverseTransposeWorldMatrix;
+    matrix worldViewProjectMatrix;
+}
+
+// VertexPacked, decoded to floats by the input assembler.
+struct AppData
+{
+    float4 position : POSITION;
+    float2 normal : NORMAL;
+    float4 color : COLOR;
+    float2 texcoord : TEXCOORD;
+};
+
+struct VertexShaderOutput
+{
+    float2 texcoord : TEXCOORD;
+    float4 color : COLOR;
+    float3 normalWS : WS_NORMAL;
+    float4 positionWS : WS_POSTION;
+    float4 position : SV_POSITION;
+};
+
+VertexShaderOutput PackedVertexShader( AppData IN )
+{
+    VertexShaderOutput OUT;
+
+    float4 position = DecodePosition(IN.position);
+    float3 normal = DecodeOctahedral(IN.normal);
+
+    OUT.texcoord = IN.texcoord;
+    OUT.color = IN.color;
+    OUT.normalWS = mul((float3x3)inverseTransposeWorldMatrix, normal);
+    OUT.positionWS = mul(worldMatrix, position);
+    OUT.position = mul(worldViewProjectMatrix, position);
+    return OUT;
+}
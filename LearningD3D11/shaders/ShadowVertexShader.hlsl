@@ -0,0 +1,22 @@
+// Depth-only pass into a shadow map. Each instance carries the first three
+// columns of its world matrix (ShadowInstanceData), all the position needs.
+cbuffer PerFrame : register( b0 )
+{
+    matrix viewProjectionMatrix;    // The shadow map's.
+}
+
+struct AppData
+{
+    float3 position : POSITION;
+
+    float4 worldColumn0 : WORLDCOLUMN0;
+    float4 worldColumn1 : WORLDCOLUMN1;
+    float4 worldColumn2 : WORLDCOLUMN2;
+};
+
+float4 ShadowVertexShader( AppData IN ) : SV_POSITION
+{
+    float4 position = float4(IN.position, 1.0f);
+    float4 positionWS = float4(dot(IN.worldColumn0, position), dot(IN.worldColumn1, position), dot(IN.worldColumn2, position), 1.0f);
+    return mul(viewProjectionMatrix, positionWS);
+}
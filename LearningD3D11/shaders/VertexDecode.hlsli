@@ -0,0 +1,23 @@
+// Decoding of VertexPacked attributes (see VertexFormats.h). The input
+// assembler already turns the UNORM/SNORM/FLOAT encodings into floats; this
+// applies the mesh's position scale and bias and unfolds the normal.
+
+cbuffer MeshQuantization : register(b1)
+{
+    float4 PositionScale;   // w is 0.
+    float4 PositionBias;    // w is 1.
+}
+
+float4 DecodePosition(float4 encodedPosition)
+{
+    return encodedPosition * PositionScale + PositionBias;
+}
+
+// Octahedral encoding in [-1, 1]^2 back to a unit vector.
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 normal = float3(encoded, 1 - abs(encoded.x) - abs(encoded.y));
+    float unfold = saturate(-normal.z);
+    normal.xy -= unfold * (normal.xy >= 0 ? 1 : -1);
+    return normalize(normal);
+}
@@ -0,0 +1,833 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "BlockCompression.h"
+#include "ParallelFor.h"
+
+namespace
+{
+    const int BlockPixels = 16;
+
+    // Weights of endpoint 1 for each index, in 64ths (BC7 4-bit indices).
+    const int BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    struct Vector4
+    {
+        float V[4];
+    };
+
+    // Principal axis of the first channelCount channels of the block by power
+    // iteration on the covariance matrix. Returns the mean as well. False if
+    // the block is a single color.
+    bool GetPrincipalAxis(const uint8_t* pixels, int channelCount, Vector4& mean, Vector4& axis)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            mean.V[c] = 0.0f;
+            axis.V[c] = 0.0f;
+        }
+        for (int i = 0; i < BlockPixels; ++i)
+        {
+            for (int c = 0; c < channelCount; ++c)
+            {
+                mean.V[c] += pixels[i * 4 + c];
+            }
+        }
+        for (int c = 0; c < channelCount; ++c)
+        {
+            mean.V[c] /= BlockPixels;
+        }
+
+        float covariance[4][4] = {};
+        for (int i = 0; i < BlockPixels; ++i)
+        {
+            float d[4];
+            for (int c = 0; c < channelCount; ++c)
+            {
+                d[c] = pixels[i * 4 + c] - mean.V[c];
+            }
+            for (int r = 0; r < channelCount; ++r)
+            {
+                for (int c = 0; c < channelCount; ++c)
+                {
+                    covariance[r][c] += d[r] * d[c];
+                }
+            }
+        }
+
+        // Start from the channel with the largest spread, which is never
+        // orthogonal to the principal axis unless the block is flat.
+        int largest = 0;
+        for (int c = 1; c < channelCount; ++c)
+        {
+            if (covariance[c][c] > covariance[largest][largest])
+            {
+                largest = c;
+            }
+        }
+        if (covariance[largest][largest] < 1e-3f)
+        {
+            return false;
+        }
+        for (int c = 0; c < channelCount; ++c)
+        {
+            axis.V[c] = covariance[largest][c];
+        }
+
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            float next[4] = {};
+            float length = 0.0f;
+            for (int r = 0; r < channelCount; ++r)
+            {
+                for (int c = 0; c < channelCount; ++c)
+                {
+                    next[r] += covariance[r][c] * axis.V[c];
+                }
+                length = std::max(length, std::fabs(next[r]));
+            }
+            if (length <= 0.0f)
+            {
+                return false;
+            }
+            for (int c = 0; c < channelCount; ++c)
+            {
+                axis.V[c] = next[c] / length;
+            }
+        }
+        return true;
+    }
+
+    // Endpoints at the extremes of the block's projection onto the axis.
+    void GetAxisEndpoints(const uint8_t* pixels, int channelCount, const Vector4& mean, const Vector4& axis, Vector4& endpoint0, Vector4& endpoint1)
+    {
+        float minT = std::numeric_limits<float>::max();
+        float maxT = -std::numeric_limits<float>::max();
+        for (int i = 0; i < BlockPixels; ++i)
+        {
+            float t = 0.0f;
+            for (int c = 0; c < channelCount; ++c)
+            {
+                t += (pixels[i * 4 + c] - mean.V[c]) * axis.V[c];
+            }
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+
+        float axisLengthSq = 0.0f;
+        for (int c = 0; c < channelCount; ++c)
+        {
+            axisLengthSq += axis.V[c] * axis.V[c];
+        }
+        for (int c = 0; c < 4; ++c)
+        {
+            endpoint0.V[c] = std::min(std::max(mean.V[c] + axis.V[c] * maxT / axisLengthSq, 0.0f), 255.0f);
+            endpoint1.V[c] = std::min(std::max(mean.V[c] + axis.V[c] * minT / axisLengthSq, 0.0f), 255.0f);
+        }
+    }
+
+    // Least-squares endpoints for fixed per-pixel weights of endpoint 1:
+    // minimizes the sum of |pixel - ((1 - w) * e0 + w * e1)|^2. False if the
+    // weights do not determine both endpoints.
+    bool FitEndpoints(const uint8_t* pixels, int channelCount, const float* weights, Vector4& endpoint0, Vector4& endpoint1)
+    {
+        float aa = 0.0f;
+        float ab = 0.0f;
+        float bb = 0.0f;
+        float ax[4] = {};
+        float bx[4] = {};
+        for (int i = 0; i < BlockPixels; ++i)
+        {
+            const float b = weights[i];
+            const float a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < channelCount; ++c)
+            {
+                ax[c] += a * pixels[i * 4 + c];
+                bx[c] += b * pixels[i * 4 + c];
+            }
+        }
+        const float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f)
+        {
+            return false;
+        }
+        for (int c = 0; c < channelCount; ++c)
+        {
+            endpoint0.V[c] = std::min(std::max((bb * ax[c] - ab * bx[c]) / determinant, 0.0f), 255.0f);
+            endpoint1.V[c] = std::min(std::max((aa * bx[c] - ab * ax[c]) / determinant, 0.0f), 255.0f);
+        }
+        return true;
+    }
+
+    // BC1 color endpoints.
+
+    uint16_t PackColor565(const Vector4& color)
+    {
+        const uint32_t r = static_cast<uint32_t>(color.V[0] * 31.0f / 255.0f + 0.5f);
+        const uint32_t g = static_cast<uint32_t>(color.V[1] * 63.0f / 255.0f + 0.5f);
+        const uint32_t b = static_cast<uint32_t>(color.V[2] * 31.0f / 255.0f + 0.5f);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    void UnpackColor565(uint16_t packed, int* rgb)
+    {
+        const int r = (packed >> 11) & 31;
+        const int g = (packed >> 5) & 63;
+        const int b = packed & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    void GetBC1Palette(uint16_t color0, uint16_t color1, bool fourColor, int palette[4][4])
+    {
+        UnpackColor565(color0, palette[0]);
+        UnpackColor565(color1, palette[1]);
+        for (int c = 0; c < 3; ++c)
+        {
+            if (fourColor)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            else
+            {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+        palette[0][3] = 255;
+        palette[1][3] = 255;
+        palette[2][3] = 255;
+        palette[3][3] = fourColor ? 255 : 0;
+    }
+
+    // Nearest four-color palette entry for every pixel. Returns the total
+    // squared error.
+    int GetBC1Indices(const uint8_t* pixels, uint16_t color0, uint16_t color1, uint32_t& indices)
+    {
+        int palette[4][4];
+        GetBC1Palette(color0, color1, true, palette);
+
+        int totalError = 0;
+        indices = 0;
+        for (int i = 0; i < BlockPixels; ++i)
+        {
+            int bestError = std::numeric_limits<int>::max();
+            uint32_t bestIndex = 0;
+            for (uint32_t index = 0; index < 4; ++index)
+            {
+                int error = 0;
+                for (int c = 0; c < 3; ++c)
+                {
+                    const int d = pixels[i * 4 + c] - palette[index][c];
+                    error += d * d;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    bestIndex = index;
+                }
+            }
+            indices |= bestIndex << (i * 2);
+            totalError += bestError;
+        }
+        return totalError;
+    }
+
+    void CompressColorBlock(const uint8_t* pixels, uint8_t* block)
+    {
+        Vector4 mean;
+        Vector4 axis;
+        Vector4 endpoint0;
+        Vector4 endpoint1;
+        if (GetPrincipalAxis(pixels, 3, mean, axis))
+        {
+            GetAxisEndpoints(pixels, 3, mean, axis, endpoint0, endpoint1);
+        }
+        else
+        {
+            endpoint0 = mean;
+            endpoint1 = mean;
+        }
+
+        uint16_t color0 = PackColor565(endpoint0);
+        uint16_t color1 = PackColor565(endpoint1);
+        uint32_t indices = 0;
+        int error = GetBC1Indices(pixels, color0, color1, indices);
+
+        // Refit the endpoints to the chosen indices while that helps.
+        static const float IndexWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+        for (int iteration = 0; iteration < 2 && error > 0 && color0 != color1; ++iteration)
+        {
+            float weights[BlockPixels];
+            for (int i = 0; i < BlockPixels; ++i)
+            {
+                weights[i] = IndexWeights[(indices >> (i * 2)) & 3];
+            }
+            if (!FitEndpoints(pixels, 3, weights, endpoint0, endpoint1))
+            {
+                break;
+            }
+            const uint16_t fitColor0 = PackColor565(endpoint0);
+            const uint16_t fitColor1 = PackColor565(endpoint1);
+            uint32_t fitIndices = 0;
+            const int fitError = GetBC1Indices(pixels, fitColor0, fitColor1, fitIndices);
+            if (fitError >= error)
+            {
+                break;
+            }
+            color0 = fitColor0;
+            color1 = fitColor1;
+            indices = fitIndices;
+            error = fitError;
+        }
+
+        // Four-color mode needs color0 > color1. Swapping the endpoints swaps
+        // indices 0 and 1, and 2 and 3. Equal endpoints select color0 only,
+        // which reads the same in either mode.
+        if (color0 < color1)
+        {
+            std::swap(color0, color1);
+            indices ^= 0x55555555;
+        }
+        else if (color0 == color1)
+        {
+            indices = 0;
+        }
+
+        block[0] = static_cast<uint8_t>(color0);
+        block[1] = static_cast<uint8_t>(color0 >> 8);
+        block[2] = static_cast<uint8_t>(color1);
+        block[3] = static_cast<uint8_t>(color1 >> 8);
+        std::memcpy(block + 4, &indices, 4);
+    }
+
+    void DecompressColorBlock(const uint8_t* block, bool allowThreeColor, uint8_t* pixels)
+    {
+        const uint16_t color0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+        const uint16_t color1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+        uint32_t indices;
+        std::memcpy(&indices, block + 4, 4);
+
+        int palette[4][4];
+        GetBC1Palette(color0, color1, !allowThreeColor || color0 > color1, palette);
+        for (int i = 0; i < BlockPixels; ++i)
+        {
+            const int* color = palette[(indices >> (i * 2)) & 3];
+            for (int c = 0; c < 4; ++c)
+            {
+                pixels[i * 4 + c] = static_cast<uint8_t>(color[c]);
+            }
+        }
+    }
+
+    // BC3 alpha: two 8-bit endpoints and 3-bit indices into eight values
+    // between them.
+
+    void GetAlphaPalette(int alpha0, int alpha1, int palette[8])
+    {
+        palette[0] = alpha0;
+        palette[1] = alpha1;
+        if (alpha0 > alpha1)
+        {
+            for (int i = 1; i < 7; ++i)
+            {
+                palette[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+            }
+        }
+        else
+        {
+            for (int i = 1; i < 5; ++i)
+            {
+                palette[i + 1] = ((5 - i) * alpha0 + i * alpha1) / 5;
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    void CompressAlphaBlock(const uint8_t* pixels, uint8_t* block)
+    {
+        int alpha0 = 0;
+        int alpha1 = 255;
+        for (int i = 0; i < BlockPixels; ++i)
+        {
+            alpha0 = std::max(alpha0, int(pixels[i * 4 + 3]));
+            alpha1 = std::min(alpha1, int(pixels[i * 4 + 3]));
+        }
+
+        uint64_t bits = 0;
+        if (alpha0 > alpha1)
+        {
+            int palette[8];
+            GetAlphaPalette(alpha0, alpha1, palette);
+            for (int i = 0; i < BlockPixels; ++i)
+            {
+                const int alpha = pixels[i * 4 + 3];
+                uint64_t bestIndex = 0;
+                int bestError = std::numeric_limits<int>::max();
+                for (int index = 0; index < 8; ++index)
+                {
+                    const int error = std::abs(alpha - palette[index]);
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        bestIndex = index;
+                    }
+                }
+                bits |= bestIndex << (i * 3);
+            }
+        }
+
+        block[0] = static_cast<uint8_t>(alpha0);
+        block[1] = static_cast<uint8_t>(alpha1);
+        for (int i = 0; i < 6; ++i)
+        {
+            block[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+        }
+    }
+
+    void DecompressAlphaBlock(const uint8_t* block, uint8_t* pixels)
+    {
+        int palette[8];
+        GetAlphaPalette(block[0], block[1], palette);
+        uint64_t bits = 0;
+        for (int i = 0; i < 6; ++i)
+        {
+            bits |= uint64_t(block[2 + i]) << (i * 8);
+        }
+        for (int i = 0; i < BlockPixels; ++i)
+        {
+            pixels[i * 4 + 3] = static_cast<uint8_t>(palette[(bits >> (i * 3)) & 7]);
+        }
+    }
+
+    // BC7 mode 6: 7-bit RGBA endpoints, each with its own p-bit shared by its
+    // four channels as their lowest bit.
+
+    struct BC7Endpoint
+    {
+        int Color[4];       // 7 bits.
+        int PBit;
+
+        int Expand(int channel) const { return (Color[channel] << 1) | PBit; }
+    };
+
+    BC7Endpoint QuantizeBC7Endpoint(const Vector4& endpoint)
+    {
+        BC7Endpoint best = {};
+        float bestError = std::numeric_limits<float>::max();
+        for (int pBit = 0; pBit < 2; ++pBit)
+        {
+            BC7Endpoint candidate;
+            candidate.PBit = pBit;
+            float error = 0.0f;
+            for (int c = 0; c < 4; ++c)
+            {
+                const int value = static_cast<int>((endpoint.V[c] - pBit) * 0.5f + 0.5f);
+                candidate.Color[c] = std::min(std::max(value, 0), 127);
+                const float d = float(candidate.Expand(c)) - endpoint.V[c];
+                error += d * d;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                best = candidate;
+            }
+        }
+        return best;
+    }
+
+    void GetBC7Palette(const BC7Endpoint& endpoint0, const BC7Endpoint& endpoint1, int palette[16][4])
+    {
+        for (int index = 0; index < 16; ++index)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                palette[index][c] = ((64 - BC7Weights[index]) * endpoint0.Expand(c) + BC7Weights[index] * endpoint1.Expand(c) + 32) >> 6;
+            }
+        }
+    }
+
+    int GetBC7Indices(const uint8_t* pixels, const BC7Endpoint& endpoint0, const BC7Endpoint& endpoint1, uint8_t* indices)
+    {
+        int palette[16][4];
+        GetBC7Palette(endpoint0, endpoint1, palette);
+
+        int totalError = 0;
+        for (int i = 0; i < BlockPixels; ++i)
+        {
+            int bestError = std::numeric_limits<int>::max();
+            uint8_t bestIndex = 0;
+            for (int index = 0; index < 16; ++index)
+            {
+                int error = 0;
+                for (int c = 0; c < 4; ++c)
+                {
+                    const int d = pixels[i * 4 + c] - palette[index][c];
+                    error += d * d;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    bestIndex = static_cast<uint8_t>(index);
+                }
+            }
+            indices[i] = bestIndex;
+            totalError += bestError;
+        }
+        return totalError;
+    }
+
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(uint8_t* bytes) : m_Bytes(bytes), m_Position(0) { std::memset(bytes, 0, 16); }
+
+        void Write(uint32_t value, int bitCount)
+        {
+            for (int bit = 0; bit < bitCount; ++bit, ++m_Position)
+            {
+                m_Bytes[m_Position >> 3] |= static_cast<uint8_t>(((value >> bit) & 1) << (m_Position & 7));
+            }
+        }
+
+    private:
+        uint8_t* m_Bytes;
+        int m_Position;
+    };
+
+    class BitReader
+    {
+    public:
+        explicit BitReader(const uint8_t* bytes) : m_Bytes(bytes), m_Position(0) {}
+
+        uint32_t Read(int bitCount)
+        {
+            uint32_t value = 0;
+            for (int bit = 0; bit < bitCount; ++bit, ++m_Position)
+            {
+                value |= uint32_t((m_Bytes[m_Position >> 3] >> (m_Position & 7)) & 1) << bit;
+            }
+            return value;
+        }
+
+    private:
+        const uint8_t* m_Bytes;
+        int m_Position;
+    };
+
+    // The 4x4 block at (blockX, blockY) of an RGBA8 mip, repeating the last
+    // row and column past the edges.
+    void LoadBlock(const uint8_t* image, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t* pixels)
+    {
+        for (uint32_t y = 0; y < 4; ++y)
+        {
+            const uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+            for (uint32_t x = 0; x < 4; ++x)
+            {
+                const uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+                std::memcpy(pixels + (y * 4 + x) * 4, image + (size_t(sourceY) * width + sourceX) * 4, 4);
+            }
+        }
+    }
+
+    void StoreBlock(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t* image)
+    {
+        for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; ++y)
+        {
+            for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; ++x)
+            {
+                std::memcpy(image + (size_t(blockY * 4 + y) * width + blockX * 4 + x) * 4, pixels + (y * 4 + x) * 4, 4);
+            }
+        }
+    }
+
+    uint32_t GetBlockSize(TextureFormat format)
+    {
+        return format == TF_BC1 ? 8 : 16;
+    }
+}
+
+void CompressBC1Block(const uint8_t* pixels, uint8_t* block)
+{
+    CompressColorBlock(pixels, block);
+}
+
+void CompressBC3Block(const uint8_t* pixels, uint8_t* block)
+{
+    CompressAlphaBlock(pixels, block);
+    CompressColorBlock(pixels, block + 8);
+}
+
+void CompressBC7Block(const uint8_t* pixels, uint8_t* block)
+{
+    Vector4 mean;
+    Vector4 axis;
+    Vector4 vector0;
+    Vector4 vector1;
+    if (GetPrincipalAxis(pixels, 4, mean, axis))
+    {
+        GetAxisEndpoints(pixels, 4, mean, axis, vector0, vector1);
+    }
+    else
+    {
+        vector0 = mean;
+        vector1 = mean;
+    }
+
+    BC7Endpoint endpoint0 = QuantizeBC7Endpoint(vector0);
+    BC7Endpoint endpoint1 = QuantizeBC7Endpoint(vector1);
+    uint8_t indices[BlockPixels];
+    int error = GetBC7Indices(pixels, endpoint0, endpoint1, indices);
+
+    for (int iteration = 0; iteration < 2 && error > 0; ++iteration)
+    {
+        float weights[BlockPixels];
+        for (int i = 0; i < BlockPixels; ++i)
+        {
+            weights[i] = BC7Weights[indices[i]] / 64.0f;
+        }
+        if (!FitEndpoints(pixels, 4, weights, vector0, vector1))
+        {
+            break;
+        }
+        const BC7Endpoint fitEndpoint0 = QuantizeBC7Endpoint(vector0);
+        const BC7Endpoint fitEndpoint1 = QuantizeBC7Endpoint(vector1);
+        uint8_t fitIndices[BlockPixels];
+        const int fitError = GetBC7Indices(pixels, fitEndpoint0, fitEndpoint1, fitIndices);
+        if (fitError >= error)
+        {
+            break;
+        }
+        endpoint0 = fitEndpoint0;
+        endpoint1 = fitEndpoint1;
+        std::memcpy(indices, fitIndices, sizeof(indices));
+        error = fitError;
+    }
+
+    // The first pixel's index is stored without its top bit, which must be
+    // zero; swapping the endpoints mirrors every index.
+    if (indices[0] >= 8)
+    {
+        std::swap(endpoint0, endpoint1);
+        for (int i = 0; i < BlockPixels; ++i)
+        {
+            indices[i] = static_cast<uint8_t>(15 - indices[i]);
+        }
+    }
+
+    BitWriter writer(block);
+    writer.Write(1 << 6, 7);
+    for (int c = 0; c < 4; ++c)
+    {
+        writer.Write(endpoint0.Color[c], 7);
+        writer.Write(endpoint1.Color[c], 7);
+    }
+    writer.Write(endpoint0.PBit, 1);
+    writer.Write(endpoint1.PBit, 1);
+    writer.Write(indices[0], 3);
+    for (int i = 1; i < BlockPixels; ++i)
+    {
+        writer.Write(indices[i], 4);
+    }
+}
+
+void DecompressBC1Block(const uint8_t* block, uint8_t* pixels)
+{
+    DecompressColorBlock(block, true, pixels);
+}
+
+void DecompressBC3Block(const uint8_t* block, uint8_t* pixels)
+{
+    DecompressColorBlock(block + 8, false, pixels);
+    DecompressAlphaBlock(block, pixels);
+}
+
+bool DecompressBC7Block(const uint8_t* block, uint8_t* pixels)
+{
+    BitReader reader(block);
+    if (reader.Read(7) != 1 << 6)
+    {
+        return false;
+    }
+
+    BC7Endpoint endpoint0;
+    BC7Endpoint endpoint1;
+    for (int c = 0; c < 4; ++c)
+    {
+        endpoint0.Color[c] = reader.Read(7);
+        endpoint1.Color[c] = reader.Read(7);
+    }
+    endpoint0.PBit = reader.Read(1);
+    endpoint1.PBit = reader.Read(1);
+
+    int palette[16][4];
+    GetBC7Palette(endpoint0, endpoint1, palette);
+    for (int i = 0; i < BlockPixels; ++i)
+    {
+        const int* color = palette[reader.Read(i == 0 ? 3 : 4)];
+        for (int c = 0; c < 4; ++c)
+        {
+            pixels[i * 4 + c] = static_cast<uint8_t>(color[c]);
+        }
+    }
+    return true;
+}
+
+bool CompressImage(const TextureImage& source, TextureFormat format, TextureImage& compressed, unsigned int threadCount)
+{
+    if (source.Format != TF_RGBA8 || format == TF_RGBA8 || source.GetMipCount() == 0)
+    {
+        return false;
+    }
+    for (uint32_t mip = 0; mip < source.GetMipCount(); ++mip)
+    {
+        if (source.Mips[mip].size() != GetMipSize(TF_RGBA8, source.Width, source.Height, mip))
+        {
+            return false;
+        }
+    }
+
+    compressed.Width = source.Width;
+    compressed.Height = source.Height;
+    compressed.Format = format;
+    compressed.SRGB = source.SRGB;
+    compressed.Mips.resize(source.GetMipCount());
+
+    // One job per block row of every mip, so the small mips do not each pay
+    // for starting the threads.
+    struct BlockRow
+    {
+        uint32_t Mip;
+        uint32_t Row;
+    };
+    std::vector<BlockRow> rows;
+    for (uint32_t mip = 0; mip < source.GetMipCount(); ++mip)
+    {
+        compressed.Mips[mip].resize(size_t(GetMipSize(format, source.Width, source.Height, mip)));
+        const uint32_t blockRows = (GetMipDimension(source.Height, mip) + 3) / 4;
+        for (uint32_t row = 0; row < blockRows; ++row)
+        {
+            rows.push_back(BlockRow{ mip, row });
+        }
+    }
+
+    const uint32_t blockSize = GetBlockSize(format);
+    ParallelFor(rows.size(), 4, [&](size_t begin, size_t end)
+    {
+        uint8_t pixels[BlockPixels * 4];
+        for (size_t job = begin; job < end; ++job)
+        {
+            const uint32_t mip = rows[job].Mip;
+            const uint32_t width = GetMipDimension(source.Width, mip);
+            const uint32_t height = GetMipDimension(source.Height, mip);
+            const uint32_t blocksX = (width + 3) / 4;
+            uint8_t* block = compressed.Mips[mip].data() + size_t(rows[job].Row) * blocksX * blockSize;
+            for (uint32_t blockX = 0; blockX < blocksX; ++blockX, block += blockSize)
+            {
+                LoadBlock(source.Mips[mip].data(), width, height, blockX, rows[job].Row, pixels);
+                switch (format)
+                {
+                case TF_BC1:
+                    CompressBC1Block(pixels, block);
+                    break;
+                case TF_BC3:
+                    CompressBC3Block(pixels, block);
+                    break;
+                default:
+                    CompressBC7Block(pixels, block);
+                    break;
+                }
+            }
+        }
+    }, threadCount);
+    return true;
+}
+
+bool DecompressImage(const TextureImage& compressed, TextureImage& decompressed)
+{
+    if (compressed.Format == TF_RGBA8)
+    {
+        return false;
+    }
+
+    decompressed.Width = compressed.Width;
+    decompressed.Height = compressed.Height;
+    decompressed.Format = TF_RGBA8;
+    decompressed.SRGB = compressed.SRGB;
+    decompressed.Mips.resize(compressed.GetMipCount());
+
+    const uint32_t blockSize = GetBlockSize(compressed.Format);
+    uint8_t pixels[BlockPixels * 4];
+    for (uint32_t mip = 0; mip < compressed.GetMipCount(); ++mip)
+    {
+        if (compressed.Mips[mip].size() != GetMipSize(compressed.Format, compressed.Width, compressed.Height, mip))
+        {
+            return false;
+        }
+        const uint32_t width = GetMipDimension(compressed.Width, mip);
+        const uint32_t height = GetMipDimension(compressed.Height, mip);
+        const uint32_t blocksX = (width + 3) / 4;
+        const uint32_t blocksY = (height + 3) / 4;
+        decompressed.Mips[mip].resize(size_t(width) * height * 4);
+
+        const uint8_t* block = compressed.Mips[mip].data();
+        for (uint32_t blockY = 0; blockY < blocksY; ++blockY)
+        {
+            for (uint32_t blockX = 0; blockX < blocksX; ++blockX, block += blockSize)
+            {
+                switch (compressed.Format)
+                {
+                case TF_BC1:
+                    DecompressBC1Block(block, pixels);
+                    break;
+                case TF_BC3:
+                    DecompressBC3Block(block, pixels);
+                    break;
+                default:
+                    if (!DecompressBC7Block(block, pixels))
+                    {
+                        return false;
+                    }
+                    break;
+                }
+                StoreBlock(pixels, width, height, blockX, blockY, decompressed.Mips[mip].data());
+            }
+        }
+    }
+    return true;
+}
+
+double ComputePSNR(const TextureImage& a, const TextureImage& b, bool includeAlpha)
+{
+    if (a.Format != TF_RGBA8 || b.Format != TF_RGBA8 || a.Width != b.Width || a.Height != b.Height
+        || a.Mips.empty() || b.Mips.empty() || a.Mips[0].size() != b.Mips[0].size())
+    {
+        return 0.0;
+    }
+
+    const int channelCount = includeAlpha ? 4 : 3;
+    const std::vector<uint8_t>& pixelsA = a.Mips[0];
+    const std::vector<uint8_t>& pixelsB = b.Mips[0];
+    uint64_t squaredError = 0;
+    for (size_t pixel = 0; pixel < pixelsA.size(); pixel += 4)
+    {
+        for (int c = 0; c < channelCount; ++c)
+        {
+            const int d = int(pixelsA[pixel + c]) - int(pixelsB[pixel + c]);
+            squaredError += uint64_t(d * d);
+        }
+    }
+    if (squaredError == 0)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    const double meanSquaredError = double(squaredError) / (double(pixelsA.size() / 4) * channelCount);
+    return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
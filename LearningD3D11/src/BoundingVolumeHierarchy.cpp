@@ -0,0 +1,883 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "BoundingVolumeHierarchy.h"
+
+namespace
+{
+    const uint32_t FlatLeaf = 0x80000000;
+    const uint32_t FlatEmpty = 0xFFFFFFFF;
+
+    // Nodes still to visit. A query pushes at most three more than it pops
+    // per level, so the fixed part holds any reasonable tree; deeper ones
+    // spill to the heap.
+    template<typename T>
+    class TraversalStack
+    {
+    public:
+        TraversalStack() : m_Size(0) {}
+
+        bool IsEmpty() const { return m_Size == 0; }
+
+        void Push(const T& value)
+        {
+            if (m_Size < FixedSize)
+            {
+                m_Fixed[m_Size] = value;
+            }
+            else
+            {
+                m_Spilled.push_back(value);
+            }
+            m_Size++;
+        }
+
+        T Pop()
+        {
+            m_Size--;
+            if (m_Size < FixedSize)
+            {
+                return m_Fixed[m_Size];
+            }
+            const T value = m_Spilled.back();
+            m_Spilled.pop_back();
+            return value;
+        }
+
+    private:
+        static const size_t FixedSize = 64;
+        T m_Fixed[FixedSize];
+        std::vector<T> m_Spilled;
+        size_t m_Size;
+    };
+
+    inline unsigned int LaneMask(FXMVECTOR comparison)
+    {
+#if defined(_XM_SSE_INTRINSICS_)
+        return static_cast<unsigned int>(_mm_movemask_ps(comparison));
+#else
+        uint32_t lanes[4];
+        XMStoreInt4(lanes, comparison);
+        return (lanes[0] ? 1u : 0u) | (lanes[1] ? 2u : 0u) | (lanes[2] ? 4u : 0u) | (lanes[3] ? 8u : 0u);
+#endif
+    }
+
+    inline Aabb Union(const Aabb& a, const Aabb& b)
+    {
+        Aabb result;
+        result.Min = XMFLOAT3(std::min(a.Min.x, b.Min.x), std::min(a.Min.y, b.Min.y), std::min(a.Min.z, b.Min.z));
+        result.Max = XMFLOAT3(std::max(a.Max.x, b.Max.x), std::max(a.Max.y, b.Max.y), std::max(a.Max.z, b.Max.z));
+        return result;
+    }
+
+    // Half the surface area; only ratios matter.
+    inline float Area(const Aabb& box)
+    {
+        const float x = box.Max.x - box.Min.x;
+        const float y = box.Max.y - box.Min.y;
+        const float z = box.Max.z - box.Min.z;
+        return x * y + y * z + z * x;
+    }
+
+    inline bool Contains(const Aabb& outer, const Aabb& inner)
+    {
+        return outer.Min.x <= inner.Min.x && outer.Min.y <= inner.Min.y && outer.Min.z <= inner.Min.z &&
+            inner.Max.x <= outer.Max.x && inner.Max.y <= outer.Max.y && inner.Max.z <= outer.Max.z;
+    }
+
+    inline bool Equal(const Aabb& a, const Aabb& b)
+    {
+        return Contains(a, b) && Contains(b, a);
+    }
+
+    inline Aabb Grow(const Aabb& box, float margin)
+    {
+        Aabb result;
+        result.Min = XMFLOAT3(box.Min.x - margin, box.Min.y - margin, box.Min.z - margin);
+        result.Max = XMFLOAT3(box.Max.x + margin, box.Max.y + margin, box.Max.z + margin);
+        return result;
+    }
+
+    // Narrow the distances at which a ray is inside four boxes to where it is
+    // between their planes along one axis. The ray's origin and inverse
+    // direction along that axis are splatted.
+    inline void Slab(FXMVECTOR minimum, FXMVECTOR maximum, FXMVECTOR origin, GXMVECTOR inverseDirection,
+        XMVECTOR& entry, XMVECTOR& exit)
+    {
+        const XMVECTOR t0 = XMVectorMultiply(XMVectorSubtract(minimum, origin), inverseDirection);
+        const XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(maximum, origin), inverseDirection);
+        entry = XMVectorMax(entry, XMVectorMin(t0, t1));
+        exit = XMVectorMin(exit, XMVectorMax(t0, t1));
+    }
+}
+
+Aabb MakeAabb(const XMFLOAT3& center, const XMFLOAT3& extents)
+{
+    Aabb box;
+    box.Min = XMFLOAT3(center.x - extents.x, center.y - extents.y, center.z - extents.z);
+    box.Max = XMFLOAT3(center.x + extents.x, center.y + extents.y, center.z + extents.z);
+    return box;
+}
+
+AabbTree::AabbTree(float margin)
+    : m_Margin(margin)
+    , m_Root(NullProxy)
+    , m_FreeList(NullProxy)
+    , m_ProxyCount(0)
+    , m_RotationCount(0)
+    , m_RefitPending(false)
+{
+}
+
+uint32_t AabbTree::CreateProxy(const Aabb& bounds, uint32_t userData)
+{
+    if (m_RefitPending)
+    {
+        Refit();
+    }
+
+    const uint32_t proxy = AllocateNode();
+    Node& node = m_Nodes[proxy];
+    node.Bounds = Grow(bounds, m_Margin);
+    node.UserData = userData;
+    node.Height = 0;
+    InsertLeaf(proxy);
+    m_ProxyCount++;
+    return proxy;
+}
+
+void AabbTree::DestroyProxy(uint32_t proxy)
+{
+    if (m_RefitPending)
+    {
+        Refit();
+    }
+
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    m_ProxyCount--;
+}
+
+void AabbTree::Clear()
+{
+    m_Nodes.clear();
+    m_FlatNodes.clear();
+    m_Root = NullProxy;
+    m_FreeList = NullProxy;
+    m_ProxyCount = 0;
+    m_RefitPending = false;
+}
+
+bool AabbTree::MoveProxy(uint32_t proxy, const Aabb& bounds)
+{
+    if (m_RefitPending)
+    {
+        Refit();
+    }
+
+    // Keep the fattened box while it holds the object and has not grown
+    // loose around an object that shrank, e.g. a cube that stopped spinning.
+    const Aabb& fatBounds = m_Nodes[proxy].Bounds;
+    if (Contains(fatBounds, bounds) && Contains(Grow(bounds, 4.0f * m_Margin), fatBounds))
+    {
+        return false;
+    }
+
+    RemoveLeaf(proxy);
+    m_Nodes[proxy].Bounds = Grow(bounds, m_Margin);
+    InsertLeaf(proxy);
+    return true;
+}
+
+void AabbTree::SetProxyBounds(uint32_t proxy, const Aabb& bounds)
+{
+    m_Nodes[proxy].Bounds = bounds;
+    for (uint32_t index = m_Nodes[proxy].Parent; index != NullProxy && !m_Nodes[index].Dirty; index = m_Nodes[index].Parent)
+    {
+        m_Nodes[index].Dirty = true;
+    }
+    m_RefitPending = true;
+}
+
+void AabbTree::Refit()
+{
+    if (m_Root != NullProxy)
+    {
+        RefitNode(m_Root);
+    }
+    m_RefitPending = false;
+}
+
+void AabbTree::RefitNode(uint32_t index)
+{
+    Node& node = m_Nodes[index];
+    if (node.IsLeaf() || !node.Dirty)
+    {
+        return;
+    }
+    RefitNode(node.Child1);
+    RefitNode(node.Child2);
+    node.Bounds = Union(m_Nodes[node.Child1].Bounds, m_Nodes[node.Child2].Bounds);
+    node.Dirty = false;
+}
+
+uint32_t AabbTree::AllocateNode()
+{
+    uint32_t index;
+    if (m_FreeList != NullProxy)
+    {
+        index = m_FreeList;
+        m_FreeList = m_Nodes[index].Parent;
+    }
+    else
+    {
+        index = static_cast<uint32_t>(m_Nodes.size());
+        m_Nodes.push_back(Node());
+    }
+
+    Node& node = m_Nodes[index];
+    node.Parent = NullProxy;
+    node.Child1 = node.Child2 = NullProxy;
+    node.UserData = 0;
+    node.Height = 0;
+    node.Dirty = false;
+    return index;
+}
+
+void AabbTree::FreeNode(uint32_t index)
+{
+    m_Nodes[index].Parent = m_FreeList;
+    m_Nodes[index].Height = -1;
+    m_FreeList = index;
+}
+
+void AabbTree::InsertLeaf(uint32_t leaf)
+{
+    if (m_Root == NullProxy)
+    {
+        m_Root = leaf;
+        m_Nodes[leaf].Parent = NullProxy;
+        return;
+    }
+
+    // Walk down towards the sibling that makes the new parent cheapest. Going
+    // past a node costs the growth of its box, inherited by every node below.
+    const Aabb leafBounds = m_Nodes[leaf].Bounds;
+    uint32_t sibling = m_Root;
+    while (!m_Nodes[sibling].IsLeaf())
+    {
+        const Node& node = m_Nodes[sibling];
+        const float area = Area(node.Bounds);
+        const float combinedArea = Area(Union(node.Bounds, leafBounds));
+        const float cost = 2.0f * combinedArea;
+        const float inheritance = 2.0f * (combinedArea - area);
+
+        float childCosts[2];
+        const uint32_t children[2] = { node.Child1, node.Child2 };
+        for (int i = 0; i < 2; ++i)
+        {
+            const Node& child = m_Nodes[children[i]];
+            const float childArea = Area(Union(child.Bounds, leafBounds));
+            childCosts[i] = (child.IsLeaf() ? childArea : childArea - Area(child.Bounds)) + inheritance;
+        }
+
+        if (cost < childCosts[0] && cost < childCosts[1])
+        {
+            break;
+        }
+        sibling = childCosts[0] < childCosts[1] ? children[0] : children[1];
+    }
+
+    const uint32_t newParent = AllocateNode();
+    const uint32_t oldParent = m_Nodes[sibling].Parent;
+    Node& parent = m_Nodes[newParent];
+    parent.Parent = oldParent;
+    parent.Child1 = sibling;
+    parent.Child2 = leaf;
+    m_Nodes[sibling].Parent = newParent;
+    m_Nodes[leaf].Parent = newParent;
+
+    if (oldParent == NullProxy)
+    {
+        m_Root = newParent;
+    }
+    else if (m_Nodes[oldParent].Child1 == sibling)
+    {
+        m_Nodes[oldParent].Child1 = newParent;
+    }
+    else
+    {
+        m_Nodes[oldParent].Child2 = newParent;
+    }
+
+    FixUpwards(newParent);
+}
+
+void AabbTree::RemoveLeaf(uint32_t leaf)
+{
+    if (leaf == m_Root)
+    {
+        m_Root = NullProxy;
+        return;
+    }
+
+    const uint32_t parent = m_Nodes[leaf].Parent;
+    const uint32_t grandParent = m_Nodes[parent].Parent;
+    const uint32_t sibling = m_Nodes[parent].Child1 == leaf ? m_Nodes[parent].Child2 : m_Nodes[parent].Child1;
+
+    m_Nodes[sibling].Parent = grandParent;
+    FreeNode(parent);
+    if (grandParent == NullProxy)
+    {
+        m_Root = sibling;
+        return;
+    }
+
+    if (m_Nodes[grandParent].Child1 == parent)
+    {
+        m_Nodes[grandParent].Child1 = sibling;
+    }
+    else
+    {
+        m_Nodes[grandParent].Child2 = sibling;
+    }
+    FixUpwards(grandParent);
+}
+
+void AabbTree::FixUpwards(uint32_t index)
+{
+    while (index != NullProxy)
+    {
+        UpdateNode(index);
+        Rotate(index);
+        index = m_Nodes[index].Parent;
+    }
+}
+
+void AabbTree::UpdateNode(uint32_t index)
+{
+    Node& node = m_Nodes[index];
+    const Node& child1 = m_Nodes[node.Child1];
+    const Node& child2 = m_Nodes[node.Child2];
+    node.Bounds = Union(child1.Bounds, child2.Bounds);
+    node.Height = 1 + std::max(child1.Height, child2.Height);
+}
+
+void AabbTree::Rotate(uint32_t index)
+{
+    // Swapping child x with grandchild y (under x's sibling z) leaves the
+    // node's own box alone and changes z's to the union of x and y's
+    // sibling. Take the swap that shrinks z the most, if any does.
+    const Node& node = m_Nodes[index];
+    uint32_t bestX = NullProxy, bestY = NullProxy, bestZ = NullProxy;
+    float bestReduction = 0.0f;
+    const uint32_t children[2] = { node.Child1, node.Child2 };
+    for (int i = 0; i < 2; ++i)
+    {
+        const uint32_t x = children[i];
+        const uint32_t z = children[1 - i];
+        const Node& nodeX = m_Nodes[x];
+        const Node& nodeZ = m_Nodes[z];
+        if (nodeZ.IsLeaf())
+        {
+            continue;
+        }
+
+        const uint32_t grandChildren[2] = { nodeZ.Child1, nodeZ.Child2 };
+        for (int j = 0; j < 2; ++j)
+        {
+            const Node& nodeS = m_Nodes[grandChildren[1 - j]];
+            const float reduction = Area(nodeZ.Bounds) - Area(Union(nodeX.Bounds, nodeS.Bounds));
+            if (reduction > bestReduction)
+            {
+                bestReduction = reduction;
+                bestX = x;
+                bestY = grandChildren[j];
+                bestZ = z;
+            }
+        }
+    }
+
+    if (bestX == NullProxy)
+    {
+        return;
+    }
+
+    Node& nodeA = m_Nodes[index];
+    Node& nodeZ = m_Nodes[bestZ];
+    if (nodeA.Child1 == bestX)
+    {
+        nodeA.Child1 = bestY;
+    }
+    else
+    {
+        nodeA.Child2 = bestY;
+    }
+    if (nodeZ.Child1 == bestY)
+    {
+        nodeZ.Child1 = bestX;
+    }
+    else
+    {
+        nodeZ.Child2 = bestX;
+    }
+    m_Nodes[bestY].Parent = index;
+    m_Nodes[bestX].Parent = bestZ;
+
+    UpdateNode(bestZ);
+    UpdateNode(index);
+    m_RotationCount++;
+}
+
+bool AabbTree::GetBounds(Aabb& bounds) const
+{
+    if (m_Root == NullProxy)
+    {
+        return false;
+    }
+    bounds = m_Nodes[m_Root].Bounds;
+    return true;
+}
+
+uint32_t AabbTree::GetHeight() const
+{
+    return m_Root == NullProxy ? 0 : static_cast<uint32_t>(m_Nodes[m_Root].Height);
+}
+
+float AabbTree::GetAreaRatio() const
+{
+    if (m_Root == NullProxy)
+    {
+        return 0.0f;
+    }
+
+    double internalArea = 0.0;
+    for (const Node& node : m_Nodes)
+    {
+        if (node.Height > 0)
+        {
+            internalArea += Area(node.Bounds);
+        }
+    }
+    const float rootArea = Area(m_Nodes[m_Root].Bounds);
+    return rootArea > 0.0f ? static_cast<float>(internalArea / rootArea) : 0.0f;
+}
+
+bool AabbTree::Validate() const
+{
+    if (m_Root == NullProxy)
+    {
+        return m_ProxyCount == 0;
+    }
+
+    uint32_t leafCount = 0;
+    return m_Nodes[m_Root].Parent == NullProxy && ValidateNode(m_Root, leafCount) && leafCount == m_ProxyCount;
+}
+
+bool AabbTree::ValidateNode(uint32_t index, uint32_t& leafCount) const
+{
+    const Node& node = m_Nodes[index];
+    if (node.IsLeaf())
+    {
+        leafCount++;
+        return node.Height == 0 && node.Child2 == NullProxy;
+    }
+
+    const Node& child1 = m_Nodes[node.Child1];
+    const Node& child2 = m_Nodes[node.Child2];
+    return child1.Parent == index && child2.Parent == index &&
+        node.Height == 1 + std::max(child1.Height, child2.Height) &&
+        (node.Dirty || Equal(node.Bounds, Union(child1.Bounds, child2.Bounds))) &&
+        ValidateNode(node.Child1, leafCount) && ValidateNode(node.Child2, leafCount);
+}
+
+void AabbTree::Flatten()
+{
+    if (m_RefitPending)
+    {
+        Refit();
+    }
+
+    m_FlatNodes.clear();
+    if (m_Root == NullProxy)
+    {
+        return;
+    }
+    if (!m_Nodes[m_Root].IsLeaf())
+    {
+        FlattenNode(m_Root);
+        return;
+    }
+
+    // A single proxy: one node with one child.
+    FlatNode flat;
+    const Aabb& bounds = m_Nodes[m_Root].Bounds;
+    flat.MinX = XMFLOAT4(bounds.Min.x, FLT_MAX, FLT_MAX, FLT_MAX);
+    flat.MinY = XMFLOAT4(bounds.Min.y, FLT_MAX, FLT_MAX, FLT_MAX);
+    flat.MinZ = XMFLOAT4(bounds.Min.z, FLT_MAX, FLT_MAX, FLT_MAX);
+    flat.MaxX = XMFLOAT4(bounds.Max.x, -FLT_MAX, -FLT_MAX, -FLT_MAX);
+    flat.MaxY = XMFLOAT4(bounds.Max.y, -FLT_MAX, -FLT_MAX, -FLT_MAX);
+    flat.MaxZ = XMFLOAT4(bounds.Max.z, -FLT_MAX, -FLT_MAX, -FLT_MAX);
+    flat.Children[0] = FlatLeaf | m_Nodes[m_Root].UserData;
+    flat.Children[1] = flat.Children[2] = flat.Children[3] = FlatEmpty;
+    m_FlatNodes.push_back(flat);
+}
+
+uint32_t AabbTree::FlattenNode(uint32_t index)
+{
+    const uint32_t flatIndex = static_cast<uint32_t>(m_FlatNodes.size());
+    m_FlatNodes.push_back(FlatNode());
+
+    // Open up the largest internal children until there are four.
+    uint32_t children[4] = { m_Nodes[index].Child1, m_Nodes[index].Child2, NullProxy, NullProxy };
+    uint32_t childCount = 2;
+    while (childCount < 4)
+    {
+        int largest = -1;
+        float largestArea = -1.0f;
+        for (uint32_t i = 0; i < childCount; ++i)
+        {
+            const Node& child = m_Nodes[children[i]];
+            if (!child.IsLeaf() && Area(child.Bounds) > largestArea)
+            {
+                largest = static_cast<int>(i);
+                largestArea = Area(child.Bounds);
+            }
+        }
+        if (largest < 0)
+        {
+            break;
+        }
+        const Node& opened = m_Nodes[children[largest]];
+        children[childCount++] = opened.Child2;
+        children[largest] = opened.Child1;
+    }
+
+    // Children first: the vector may grow. The first child's subtree follows
+    // this node directly.
+    uint32_t flatChildren[4];
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        if (i >= childCount)
+        {
+            flatChildren[i] = FlatEmpty;
+        }
+        else if (m_Nodes[children[i]].IsLeaf())
+        {
+            flatChildren[i] = FlatLeaf | m_Nodes[children[i]].UserData;
+        }
+        else
+        {
+            flatChildren[i] = FlattenNode(children[i]);
+        }
+    }
+
+    FlatNode& flat = m_FlatNodes[flatIndex];
+    float* minX = &flat.MinX.x;
+    float* minY = &flat.MinY.x;
+    float* minZ = &flat.MinZ.x;
+    float* maxX = &flat.MaxX.x;
+    float* maxY = &flat.MaxY.x;
+    float* maxZ = &flat.MaxZ.x;
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        flat.Children[i] = flatChildren[i];
+        if (i < childCount)
+        {
+            const Aabb& bounds = m_Nodes[children[i]].Bounds;
+            minX[i] = bounds.Min.x;
+            minY[i] = bounds.Min.y;
+            minZ[i] = bounds.Min.z;
+            maxX[i] = bounds.Max.x;
+            maxY[i] = bounds.Max.y;
+            maxZ[i] = bounds.Max.z;
+        }
+        else
+        {
+            minX[i] = minY[i] = minZ[i] = FLT_MAX;
+            maxX[i] = maxY[i] = maxZ[i] = -FLT_MAX;
+        }
+    }
+    return flatIndex;
+}
+
+void AabbTree::AppendSubtree(uint32_t flatIndex, std::vector<uint32_t>& results) const
+{
+    const FlatNode& node = m_FlatNodes[flatIndex];
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        const uint32_t child = node.Children[lane];
+        if (child == FlatEmpty)
+        {
+            continue;
+        }
+        if (child & FlatLeaf)
+        {
+            results.push_back(child & ~FlatLeaf);
+        }
+        else
+        {
+            AppendSubtree(child, results);
+        }
+    }
+}
+
+void AabbTree::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const
+{
+    if (m_FlatNodes.empty())
+    {
+        return;
+    }
+
+    XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int i = 0; i < 6; ++i)
+    {
+        const XMVECTOR plane = XMLoadFloat4(&frustum.Planes[i]);
+        planeX[i] = XMVectorSplatX(plane);
+        planeY[i] = XMVectorSplatY(plane);
+        planeZ[i] = XMVectorSplatZ(plane);
+        planeW[i] = XMVectorSplatW(plane);
+    }
+    const XMVECTOR half = XMVectorReplicate(0.5f);
+
+    TraversalStack<uint32_t> stack;
+    stack.Push(0);
+    while (!stack.IsEmpty())
+    {
+        const FlatNode& node = m_FlatNodes[stack.Pop()];
+        const XMVECTOR minX = XMLoadFloat4(&node.MinX);
+        const XMVECTOR minY = XMLoadFloat4(&node.MinY);
+        const XMVECTOR minZ = XMLoadFloat4(&node.MinZ);
+        const XMVECTOR maxX = XMLoadFloat4(&node.MaxX);
+        const XMVECTOR maxY = XMLoadFloat4(&node.MaxY);
+        const XMVECTOR maxZ = XMLoadFloat4(&node.MaxZ);
+        const XMVECTOR centerX = XMVectorMultiply(XMVectorAdd(minX, maxX), half);
+        const XMVECTOR centerY = XMVectorMultiply(XMVectorAdd(minY, maxY), half);
+        const XMVECTOR centerZ = XMVectorMultiply(XMVectorAdd(minZ, maxZ), half);
+        const XMVECTOR extentX = XMVectorMultiply(XMVectorSubtract(maxX, minX), half);
+        const XMVECTOR extentY = XMVectorMultiply(XMVectorSubtract(maxY, minY), half);
+        const XMVECTOR extentZ = XMVectorMultiply(XMVectorSubtract(maxZ, minZ), half);
+
+        // Outside if behind any plane by more than the box's projected
+        // radius; inside if in front of every plane by at least as much.
+        XMVECTOR outside = XMVectorFalseInt();
+        XMVECTOR inside = XMVectorTrueInt();
+        for (int i = 0; i < 6; ++i)
+        {
+            const XMVECTOR distance = planeX[i] * centerX + planeY[i] * centerY + planeZ[i] * centerZ + planeW[i];
+            const XMVECTOR radius = XMVectorAbs(planeX[i]) * extentX + XMVectorAbs(planeY[i]) * extentY + XMVectorAbs(planeZ[i]) * extentZ;
+            outside = XMVectorOrInt(outside, XMVectorLess(distance, XMVectorNegate(radius)));
+            inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(distance, radius));
+        }
+
+        const unsigned int visibleMask = ~LaneMask(outside) & 0xF;
+        const unsigned int insideMask = LaneMask(inside);
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            const uint32_t child = node.Children[lane];
+            if (!(visibleMask & (1u << lane)) || child == FlatEmpty)
+            {
+                continue;
+            }
+            if (child & FlatLeaf)
+            {
+                results.push_back(child & ~FlatLeaf);
+            }
+            else if (insideMask & (1u << lane))
+            {
+                AppendSubtree(child, results);
+            }
+            else
+            {
+                stack.Push(child);
+            }
+        }
+    }
+}
+
+void AabbTree::QueryAabb(const Aabb& bounds, std::vector<uint32_t>& results) const
+{
+    if (m_FlatNodes.empty())
+    {
+        return;
+    }
+
+    const XMVECTOR queryMinX = XMVectorReplicate(bounds.Min.x);
+    const XMVECTOR queryMinY = XMVectorReplicate(bounds.Min.y);
+    const XMVECTOR queryMinZ = XMVectorReplicate(bounds.Min.z);
+    const XMVECTOR queryMaxX = XMVectorReplicate(bounds.Max.x);
+    const XMVECTOR queryMaxY = XMVectorReplicate(bounds.Max.y);
+    const XMVECTOR queryMaxZ = XMVectorReplicate(bounds.Max.z);
+
+    TraversalStack<uint32_t> stack;
+    stack.Push(0);
+    while (!stack.IsEmpty())
+    {
+        const FlatNode& node = m_FlatNodes[stack.Pop()];
+        XMVECTOR overlap = XMVectorAndInt(
+            XMVectorLessOrEqual(XMLoadFloat4(&node.MinX), queryMaxX),
+            XMVectorGreaterOrEqual(XMLoadFloat4(&node.MaxX), queryMinX));
+        overlap = XMVectorAndInt(overlap, XMVectorAndInt(
+            XMVectorLessOrEqual(XMLoadFloat4(&node.MinY), queryMaxY),
+            XMVectorGreaterOrEqual(XMLoadFloat4(&node.MaxY), queryMinY)));
+        overlap = XMVectorAndInt(overlap, XMVectorAndInt(
+            XMVectorLessOrEqual(XMLoadFloat4(&node.MinZ), queryMaxZ),
+            XMVectorGreaterOrEqual(XMLoadFloat4(&node.MaxZ), queryMinZ)));
+
+        const unsigned int mask = LaneMask(overlap);
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            const uint32_t child = node.Children[lane];
+            if (!(mask & (1u << lane)) || child == FlatEmpty)
+            {
+                continue;
+            }
+            if (child & FlatLeaf)
+            {
+                results.push_back(child & ~FlatLeaf);
+            }
+            else
+            {
+                stack.Push(child);
+            }
+        }
+    }
+}
+
+void AabbTree::QuerySphere(const XMFLOAT3& center, float radius, std::vector<uint32_t>& results) const
+{
+    if (m_FlatNodes.empty())
+    {
+        return;
+    }
+
+    const XMVECTOR centerX = XMVectorReplicate(center.x);
+    const XMVECTOR centerY = XMVectorReplicate(center.y);
+    const XMVECTOR centerZ = XMVectorReplicate(center.z);
+    const XMVECTOR radiusSquared = XMVectorReplicate(radius * radius);
+    const XMVECTOR zero = XMVectorZero();
+
+    TraversalStack<uint32_t> stack;
+    stack.Push(0);
+    while (!stack.IsEmpty())
+    {
+        const FlatNode& node = m_FlatNodes[stack.Pop()];
+
+        // Distance from the centre to the nearest point of each box.
+        const XMVECTOR dx = XMVectorMax(XMVectorMax(XMLoadFloat4(&node.MinX) - centerX, centerX - XMLoadFloat4(&node.MaxX)), zero);
+        const XMVECTOR dy = XMVectorMax(XMVectorMax(XMLoadFloat4(&node.MinY) - centerY, centerY - XMLoadFloat4(&node.MaxY)), zero);
+        const XMVECTOR dz = XMVectorMax(XMVectorMax(XMLoadFloat4(&node.MinZ) - centerZ, centerZ - XMLoadFloat4(&node.MaxZ)), zero);
+        const unsigned int mask = LaneMask(XMVectorLessOrEqual(dx * dx + dy * dy + dz * dz, radiusSquared));
+
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            const uint32_t child = node.Children[lane];
+            if (!(mask & (1u << lane)) || child == FlatEmpty)
+            {
+                continue;
+            }
+            if (child & FlatLeaf)
+            {
+                results.push_back(child & ~FlatLeaf);
+            }
+            else
+            {
+                stack.Push(child);
+            }
+        }
+    }
+}
+
+bool AabbTree::RayCast(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, RayHit& hit) const
+{
+    if (m_FlatNodes.empty())
+    {
+        return false;
+    }
+
+    // A zero component would give 0 * infinity in the slab test; a tiny one
+    // keeps the result finite and the same.
+    auto inverse = [](float value)
+    {
+        return 1.0f / (std::fabs(value) > 1e-30f ? value : (value < 0.0f ? -1e-30f : 1e-30f));
+    };
+    const XMVECTOR originX = XMVectorReplicate(origin.x);
+    const XMVECTOR originY = XMVectorReplicate(origin.y);
+    const XMVECTOR originZ = XMVectorReplicate(origin.z);
+    const XMVECTOR inverseX = XMVectorReplicate(inverse(direction.x));
+    const XMVECTOR inverseY = XMVectorReplicate(inverse(direction.y));
+    const XMVECTOR inverseZ = XMVectorReplicate(inverse(direction.z));
+
+    struct StackEntry
+    {
+        uint32_t Node;
+        float Distance;
+    };
+    TraversalStack<StackEntry> stack;
+    stack.Push({ 0, 0.0f });
+
+    bool found = false;
+    float bestDistance = maxDistance;
+    while (!stack.IsEmpty())
+    {
+        const StackEntry entry = stack.Pop();
+        if (entry.Distance > bestDistance)
+        {
+            continue;
+        }
+
+        const FlatNode& node = m_FlatNodes[entry.Node];
+        XMVECTOR enter = XMVectorZero();
+        XMVECTOR exit = XMVectorReplicate(bestDistance);
+        Slab(XMLoadFloat4(&node.MinX), XMLoadFloat4(&node.MaxX), originX, inverseX, enter, exit);
+        Slab(XMLoadFloat4(&node.MinY), XMLoadFloat4(&node.MaxY), originY, inverseY, enter, exit);
+        Slab(XMLoadFloat4(&node.MinZ), XMLoadFloat4(&node.MaxZ), originZ, inverseZ, enter, exit);
+        const unsigned int mask = LaneMask(XMVectorLessOrEqual(enter, exit));
+        if (mask == 0)
+        {
+            continue;
+        }
+
+        XMFLOAT4 enterLanes;
+        XMStoreFloat4(&enterLanes, enter);
+        const float* enterLane = &enterLanes.x;
+
+        // Hit children nearest first: leaves are taken in that order, and
+        // nodes are pushed farthest first so the nearest is searched next.
+        int order[4];
+        int hitCount = 0;
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            if ((mask & (1u << lane)) && node.Children[lane] != FlatEmpty)
+            {
+                int i = hitCount++;
+                for (; i > 0 && enterLane[order[i - 1]] > enterLane[lane]; --i)
+                {
+                    order[i] = order[i - 1];
+                }
+                order[i] = lane;
+            }
+        }
+        for (int i = 0; i < hitCount; ++i)
+        {
+            const uint32_t child = node.Children[order[i]];
+            const float distance = enterLane[order[i]];
+            if ((child & FlatLeaf) && (distance < bestDistance || (!found && distance <= bestDistance)))
+            {
+                found = true;
+                bestDistance = distance;
+                hit.UserData = child & ~FlatLeaf;
+                hit.Distance = distance;
+            }
+        }
+        for (int i = hitCount - 1; i >= 0; --i)
+        {
+            const uint32_t child = node.Children[order[i]];
+            if (!(child & FlatLeaf) && enterLane[order[i]] <= bestDistance)
+            {
+                stack.Push({ child, enterLane[order[i]] });
+            }
+        }
+    }
+    return found;
+}
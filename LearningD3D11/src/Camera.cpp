@@ -1,5 +1,25 @@
+#include <cmath>
 #include "Camera.h"
 
+namespace
+{
+    const uint32_t JitterSequenceLength = 16;
+
+    // Radical inverse of index in the given base, in [0, 1).
+    float Halton(uint32_t index, uint32_t base)
+    {
+        float result = 0.0f;
+        float fraction = 1.0f / base;
+        while (index > 0)
+        {
+            result += fraction * (index % base);
+            index /= base;
+            fraction /= base;
+        }
+        return result;
+    }
+}
+
 XMFLOAT4 VectorToFloat4(const XMVECTOR &V)
 {
     XMFLOAT4 float4Position;
@@ -10,51 +30,214 @@ XMFLOAT4 VectorToFloat4(const XMVECTOR &V)
     return float4Position;
 }
 
-void Camera::Translate(XMVECTOR& translation)
+XMFLOAT2 GetJitterOffset(uint64_t frameIndex)
+{
+    // Index 0 of the sequence is 0 in every base; start at 1.
+    const uint32_t index = static_cast<uint32_t>(frameIndex % JitterSequenceLength) + 1;
+    return XMFLOAT2(Halton(index, 2) - 0.5f, Halton(index, 3) - 0.5f);
+}
+
+void Camera::Translate(FXMVECTOR translation)
+{
+    m_Position += translation;
+    m_ViewDirty = true;
+}
+
+void Camera::TranslateLocal(FXMVECTOR translation)
+{
+    const XMVECTOR localTranslation = XMQuaternionMultiply(m_Orientation, translation);
+    m_Position += localTranslation;
+    m_ViewDirty = true;
+}
+
+void Camera::Rotate(FXMVECTOR axis, float angleDegrees)
+{
+    m_Orientation = XMQuaternionMultiply(XMQuaternionRotationAxis(axis, XMConvertToRadians(angleDegrees)), m_Orientation);
+    m_ViewDirty = true;
+}
+
+void Camera::SetPosition(FXMVECTOR position)
+{
+    m_Position = position;
+    m_ViewDirty = true;
+}
+
+void Camera::SetOrientation(FXMVECTOR orientation)
 {
-    position += translation;
+    m_Orientation = orientation;
+    m_ViewDirty = true;
 }
 
-void Camera::TranslateLocal(XMVECTOR& translation)
+void Camera::SetProjection(const CameraProjection& projection)
 {
-    const XMVECTOR worldFwdVector = XMVectorSet(0, 0, 1, 0);
-    const XMVECTOR localFwdVector = XMQuaternionMultiply(orientation, worldFwdVector);
-    const XMVECTOR localTranslation = XMQuaternionMultiply(orientation, translation);
+    m_ProjectionSettings = projection;
+    m_ProjectionDirty = true;
+}
 
-    position += localTranslation;
+void Camera::SetJitter(const XMFLOAT2& offset, float viewportWidth, float viewportHeight)
+{
+    // Pixels to clip space; y points down the screen.
+    m_JitterClip = XMFLOAT2(2.0f * offset.x / viewportWidth, -2.0f * offset.y / viewportHeight);
+    m_ProjectionDirty = true;
 }
 
-XMFLOAT4 Camera::GetPositionFloat()
+XMFLOAT4 Camera::GetPositionFloat() const
 {
-    return VectorToFloat4(position);
+    return VectorToFloat4(m_Position);
 }
 
-XMFLOAT4 Camera::GetForwardDirectionFloat()
+const XMVECTOR& Camera::GetForwardVector() const
 {
-    const XMVECTOR worldFwdVector = XMVectorSet(0, 0, 1, 0);
-    const XMVECTOR localFwdVector = XMQuaternionMultiply(orientation, worldFwdVector);
-    return VectorToFloat4(localFwdVector);
+    Update();
+    return m_Forward;
 }
 
-void Camera::Rotate(XMVECTOR axis, float angleDegrees)
+XMFLOAT4 Camera::GetForwardDirectionFloat() const
 {
-    orientation = XMQuaternionMultiply(XMQuaternionRotationAxis(axis, XMConvertToRadians(angleDegrees)),orientation);
+    Update();
+    return VectorToFloat4(m_Forward);
 }
 
-XMMATRIX Camera::GetViewMatrix()
+const XMMATRIX& Camera::GetViewMatrix() const
 {
-    const XMVECTOR worldFwdVector = XMVectorSet(0, 0, 1, 0);
-    const XMVECTOR localFwdVector = XMQuaternionMultiply(orientation, worldFwdVector);
+    Update();
+    return m_View;
+}
 
-    XMVECTOR focusPoint = position + XMVectorScale(localFwdVector, 2.0f);
-    return XMMatrixLookAtLH(position, focusPoint, upVector);
+const XMMATRIX& Camera::GetProjectionMatrix() const
+{
+    Update();
+    return m_Projection;
+}
+
+const XMMATRIX& Camera::GetViewProjectionMatrix() const
+{
+    Update();
+    return m_ViewProjection;
+}
+
+const XMMATRIX& Camera::GetInverseViewProjectionMatrix() const
+{
+    Update();
+    return m_InverseViewProjection;
+}
+
+const Frustum& Camera::GetFrustum() const
+{
+    Update();
+    return m_Frustum;
+}
+
+const XMFLOAT3* Camera::GetFrustumCorners() const
+{
+    Update();
+    return m_Corners;
+}
+
+void Camera::Update() const
+{
+    if (!m_ViewDirty && !m_ProjectionDirty)
+    {
+        return;
+    }
+
+    if (m_ViewDirty)
+    {
+        const XMVECTOR worldFwdVector = XMVectorSet(0, 0, 1, 0);
+        m_Forward = XMQuaternionMultiply(m_Orientation, worldFwdVector);
+        m_View = XMMatrixLookToLH(m_Position, m_Forward, m_UpVector);
+        m_ViewDirty = false;
+    }
+
+    if (m_ProjectionDirty)
+    {
+        const CameraProjection& settings = m_ProjectionSettings;
+        const float fovY = XMConvertToRadians(settings.FieldOfViewY);
+        m_CullingProjection = XMMatrixPerspectiveFovLH(fovY, settings.AspectRatio, settings.NearZ, settings.FarZ);
+        if (settings.Depth == DM_ReversedInfinite)
+        {
+            // z_clip = NearZ and w_clip = z, so depth = NearZ / z.
+            const float yScale = 1.0f / std::tan(0.5f * fovY);
+            const float xScale = yScale / settings.AspectRatio;
+            m_Projection = XMMATRIX(
+                xScale, 0.0f, 0.0f, 0.0f,
+                0.0f, yScale, 0.0f, 0.0f,
+                0.0f, 0.0f, 0.0f, 1.0f,
+                0.0f, 0.0f, settings.NearZ, 0.0f);
+        }
+        else
+        {
+            m_Projection = m_CullingProjection;
+        }
+
+        // w_clip is view z in both forms, so adding the offset times z to x
+        // and y shifts the whole image by a constant amount.
+        const XMVECTOR jitter = XMVectorSet(m_JitterClip.x, m_JitterClip.y, 0.0f, 0.0f);
+        m_Projection.r[2] += jitter;
+        m_CullingProjection.r[2] += jitter;
+        m_ProjectionDirty = false;
+    }
+
+    m_ViewProjection = m_View * m_Projection;
+    m_InverseViewProjection = XMMatrixInverse(nullptr, m_ViewProjection);
+
+    // Planes and corners are built in view space and moved to world space.
+    // Going through the view-projection instead, as ExtractFrustumPlanes
+    // does, cancels most of the far plane's precision away, and the far plane
+    // stays at FarZ when depth does not end there.
+    const CameraProjection& settings = m_ProjectionSettings;
+    const float xScale = XMVectorGetX(m_CullingProjection.r[0]);
+    const float yScale = XMVectorGetY(m_CullingProjection.r[1]);
+    const XMVECTOR viewPlanes[6] =
+    {
+        XMVectorSet(xScale, 0.0f, 1.0f + m_JitterClip.x, 0.0f),     // Left:   -w <= x
+        XMVectorSet(-xScale, 0.0f, 1.0f - m_JitterClip.x, 0.0f),    // Right:   x <= w
+        XMVectorSet(0.0f, yScale, 1.0f + m_JitterClip.y, 0.0f),     // Bottom: -w <= y
+        XMVectorSet(0.0f, -yScale, 1.0f - m_JitterClip.y, 0.0f),    // Top:     y <= w
+        XMVectorSet(0.0f, 0.0f, 1.0f, -settings.NearZ),             // Near
+        XMVectorSet(0.0f, 0.0f, -1.0f, settings.FarZ),              // Far
+    };
+    // Planes transform by the inverse transpose of the point transform,
+    // which for the inverse view is the transposed view.
+    const XMMATRIX viewTranspose = XMMatrixTranspose(m_View);
+    for (int i = 0; i < 6; ++i)
+    {
+        XMStoreFloat4(&m_Frustum.Planes[i], XMPlaneTransform(XMPlaneNormalize(viewPlanes[i]), viewTranspose));
+    }
+
+    // The view is a rotation and a translation; its inverse is the
+    // transposed rotation followed by the camera position.
+    XMMATRIX inverseView = viewTranspose;
+    inverseView.r[3] = XMVectorSetW(m_Position, 1.0f);
+    inverseView.r[0] = XMVectorSetW(inverseView.r[0], 0.0f);
+    inverseView.r[1] = XMVectorSetW(inverseView.r[1], 0.0f);
+    inverseView.r[2] = XMVectorSetW(inverseView.r[2], 0.0f);
+    for (int i = 0; i < 8; ++i)
+    {
+        const float z = (i & 4) ? settings.FarZ : settings.NearZ;
+        const float x = (((i & 1) ? 1.0f : -1.0f) - m_JitterClip.x) * z / xScale;
+        const float y = (((i & 2) ? 1.0f : -1.0f) - m_JitterClip.y) * z / yScale;
+        XMStoreFloat3(&m_Corners[i], XMVector3TransformCoord(XMVectorSet(x, y, z, 1.0f), inverseView));
+    }
+}
+
+Camera Camera::Interpolate(const Camera& from, const Camera& to, float alpha)
+{
+    Camera camera = to;
+    camera.m_Position = XMVectorLerp(from.m_Position, to.m_Position, alpha);
+    camera.m_Orientation = XMQuaternionSlerp(from.m_Orientation, to.m_Orientation, alpha);
+    camera.m_ViewDirty = true;
+    return camera;
 }
 
 Camera::Camera()
+    : m_JitterClip(0.0f, 0.0f)
+    , m_ViewDirty(true)
+    , m_ProjectionDirty(true)
 {
-    position = XMVectorSet(0, 5, -10, 1);
-    upVector = XMVectorSet(0, 1, 0, 0);
-    orientation = XMQuaternionIdentity();
+    m_Position = XMVectorSet(0, 5, -10, 1);
+    m_UpVector = XMVectorSet(0, 1, 0, 0);
+    m_Orientation = XMQuaternionIdentity();
 }
 
 Camera::~Camera()
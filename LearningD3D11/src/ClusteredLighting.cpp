@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include "ClusteredLighting.h"
+#include "ParallelFor.h"
+
+namespace
+{
+    const uint32_t ClustersPerSlice = ClusterCountX * ClusterCountY;
+
+    // Tile index of a normalized device coordinate, clamped to the grid.
+    uint8_t TileIndex(float ndc, uint32_t tileCount)
+    {
+        const float tile = std::floor((ndc + 1.0f) * 0.5f * tileCount);
+        return static_cast<uint8_t>(std::min(std::max(tile, 0.0f), static_cast<float>(tileCount - 1)));
+    }
+
+    bool SphereIntersectsBox(const XMFLOAT4& sphere, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+    {
+        const float dx = std::max(std::max(boxMin.x - sphere.x, 0.0f), sphere.x - boxMax.x);
+        const float dy = std::max(std::max(boxMin.y - sphere.y, 0.0f), sphere.y - boxMax.y);
+        const float dz = std::max(std::max(boxMin.z - sphere.z, 0.0f), sphere.z - boxMax.z);
+        return dx * dx + dy * dy + dz * dz <= sphere.w * sphere.w;
+    }
+}
+
+float ComputeLightRange(const Light& light, float cutoff)
+{
+    if (light.LightType == DirectionalLight)
+    {
+        return FLT_MAX;
+    }
+
+    const float intensity = std::max(std::max(light.Color.x, light.Color.y), light.Color.z);
+    if (intensity <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    // Solve intensity / (c + l * d + q * d^2) = cutoff for d.
+    const float denominator = intensity / cutoff;
+    const float c = light.ConstantAttenuation;
+    const float l = light.LinearAttenuation;
+    const float q = light.QuadraticAttenuation;
+
+    if (c >= denominator)
+    {
+        return 0.0f;
+    }
+    if (q > 0.0f)
+    {
+        return (-l + std::sqrt(l * l + 4.0f * q * (denominator - c))) / (2.0f * q);
+    }
+    if (l > 0.0f)
+    {
+        return (denominator - c) / l;
+    }
+    return FLT_MAX;
+}
+
+LightClusterGrid::LightClusterGrid()
+    : m_Near(0.1f)
+    , m_Far(100.0f)
+    , m_TanHalfFovX(1.0f)
+    , m_TanHalfFovY(1.0f)
+{
+    m_Constants.ViewMatrix = XMMatrixIdentity();
+    m_Constants.ClusterCountX = ClusterCountX;
+    m_Constants.ClusterCountY = ClusterCountY;
+    m_Constants.ClusterCountZ = ClusterCountZ;
+    m_Constants.Padding = 0;
+    m_Constants.TileSizeX = 1.0f;
+    m_Constants.TileSizeY = 1.0f;
+    m_Constants.SliceScale = 0.0f;
+    m_Constants.SliceBias = 0.0f;
+
+    m_ClusterRanges.resize(ClusterCount);
+}
+
+void LightClusterGrid::SetProjection(FXMMATRIX projection, float viewportWidth, float viewportHeight)
+{
+    // XMMatrixPerspectiveFovLH: _33 = f / (f - n), _43 = -n * f / (f - n).
+    XMFLOAT4X4 p;
+    XMStoreFloat4x4(&p, projection);
+    SetProjection(projection, viewportWidth, viewportHeight, -p._43 / p._33, p._43 / (1.0f - p._33));
+}
+
+void LightClusterGrid::SetProjection(FXMMATRIX projection, float viewportWidth, float viewportHeight, float nearZ, float farZ)
+{
+    // _11 = 1 / tan(fovX / 2), _22 = 1 / tan(fovY / 2) in either depth mode.
+    XMFLOAT4X4 p;
+    XMStoreFloat4x4(&p, projection);
+    m_TanHalfFovX = 1.0f / p._11;
+    m_TanHalfFovY = 1.0f / p._22;
+    m_Near = nearZ;
+    m_Far = farZ;
+
+    const float logDepthRange = std::log(m_Far / m_Near);
+    m_Constants.TileSizeX = viewportWidth / ClusterCountX;
+    m_Constants.TileSizeY = viewportHeight / ClusterCountY;
+    m_Constants.SliceScale = ClusterCountZ / logDepthRange;
+    m_Constants.SliceBias = -static_cast<float>(ClusterCountZ) * std::log(m_Near) / logDepthRange;
+
+    m_ClusterBounds.resize(ClusterCount);
+    for (uint32_t z = 0; z < ClusterCountZ; ++z)
+    {
+        const float sliceNear = m_Near * std::pow(m_Far / m_Near, static_cast<float>(z) / ClusterCountZ);
+        const float sliceFar = m_Near * std::pow(m_Far / m_Near, static_cast<float>(z + 1) / ClusterCountZ);
+
+        for (uint32_t y = 0; y < ClusterCountY; ++y)
+        {
+            // Row 0 is the top of the screen.
+            const float top = (1.0f - 2.0f * y / ClusterCountY) * m_TanHalfFovY;
+            const float bottom = (1.0f - 2.0f * (y + 1) / ClusterCountY) * m_TanHalfFovY;
+
+            for (uint32_t x = 0; x < ClusterCountX; ++x)
+            {
+                const float left = (-1.0f + 2.0f * x / ClusterCountX) * m_TanHalfFovX;
+                const float right = (-1.0f + 2.0f * (x + 1) / ClusterCountX) * m_TanHalfFovX;
+
+                // The cluster is a frustum slab; bound its eight corners.
+                ClusterBounds& bounds = m_ClusterBounds[x + ClusterCountX * (y + ClusterCountY * z)];
+                bounds.Min = XMFLOAT3(std::min(left * sliceNear, left * sliceFar), std::min(bottom * sliceNear, bottom * sliceFar), sliceNear);
+                bounds.Max = XMFLOAT3(std::max(right * sliceNear, right * sliceFar), std::max(top * sliceNear, top * sliceFar), sliceFar);
+            }
+        }
+    }
+}
+
+uint32_t LightClusterGrid::GetSlice(float viewDepth) const
+{
+    if (viewDepth <= m_Near)
+    {
+        return 0;
+    }
+
+    const float slice = std::floor(std::log(viewDepth) * m_Constants.SliceScale + m_Constants.SliceBias);
+    return static_cast<uint32_t>(std::min(std::max(slice, 0.0f), static_cast<float>(ClusterCountZ - 1)));
+}
+
+void LightClusterGrid::BoundLight(FXMMATRIX view, const Light& light, float cutoff, LightBounds& bounds) const
+{
+    bounds.Visible = false;
+    if (!light.Enabled)
+    {
+        return;
+    }
+
+    const float range = ComputeLightRange(light, cutoff);
+    if (range <= 0.0f)
+    {
+        return;
+    }
+
+    if (range == FLT_MAX)
+    {
+        // Reaches every cluster.
+        bounds.Sphere = XMFLOAT4(0.0f, 0.0f, 0.0f, FLT_MAX);
+        bounds.MinX = 0;
+        bounds.MaxX = ClusterCountX - 1;
+        bounds.MinY = 0;
+        bounds.MaxY = ClusterCountY - 1;
+        bounds.MinZ = 0;
+        bounds.MaxZ = ClusterCountZ - 1;
+        bounds.Visible = true;
+        return;
+    }
+
+    XMVECTOR center = XMVector3TransformCoord(XMLoadFloat4(&light.Position), view);
+    float radius = range;
+
+    // A spot light only lights a cone of its range; bound the cone instead of
+    // the whole sphere when that is tighter.
+    const float halfAngle = light.SpotAngle;
+    if (light.LightType == SpotLight && halfAngle < XM_PIDIV2)
+    {
+        const XMVECTOR direction = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat4(&light.Direction), view));
+        const float cosHalfAngle = std::cos(halfAngle);
+        if (halfAngle <= XM_PIDIV4)
+        {
+            radius = range / (2.0f * cosHalfAngle);
+            center = XMVectorMultiplyAdd(direction, XMVectorReplicate(radius), center);
+        }
+        else
+        {
+            center = XMVectorMultiplyAdd(direction, XMVectorReplicate(range * cosHalfAngle), center);
+            radius = range * std::sin(halfAngle);
+        }
+    }
+
+    XMFLOAT3 c;
+    XMStoreFloat3(&c, center);
+    if (c.z + radius < m_Near || c.z - radius > m_Far)
+    {
+        return;
+    }
+
+    const float minDepth = std::max(c.z - radius, m_Near);
+    const float maxDepth = std::min(c.z + radius, m_Far);
+
+    bounds.Sphere = XMFLOAT4(c.x, c.y, c.z, radius);
+    if (!GetTileRange(c.x, c.y, radius, minDepth, maxDepth, bounds))
+    {
+        return;
+    }
+
+    bounds.MinZ = static_cast<uint8_t>(GetSlice(minDepth));
+    bounds.MaxZ = static_cast<uint8_t>(GetSlice(maxDepth));
+    bounds.Visible = true;
+}
+
+bool LightClusterGrid::GetTileRange(float x, float y, float radius, float minDepth, float maxDepth, LightBounds& bounds) const
+{
+    // Conservative x/z and y/z extents of the box [x - radius, x + radius] *
+    // [y - radius, y + radius] * [minDepth, maxDepth]: divide a negative edge
+    // by the smallest depth and a positive one by the largest.
+    const float left = x - radius, right = x + radius;
+    const float bottom = y - radius, top = y + radius;
+    const float minNdcX = left / (left < 0.0f ? minDepth : maxDepth) / m_TanHalfFovX;
+    const float maxNdcX = right / (right < 0.0f ? maxDepth : minDepth) / m_TanHalfFovX;
+    const float minNdcY = bottom / (bottom < 0.0f ? minDepth : maxDepth) / m_TanHalfFovY;
+    const float maxNdcY = top / (top < 0.0f ? maxDepth : minDepth) / m_TanHalfFovY;
+    if (maxNdcX < -1.0f || minNdcX > 1.0f || maxNdcY < -1.0f || minNdcY > 1.0f)
+    {
+        return false;
+    }
+
+    bounds.MinX = TileIndex(minNdcX, ClusterCountX);
+    bounds.MaxX = TileIndex(maxNdcX, ClusterCountX);
+    // Rows count down from the top of the screen.
+    bounds.MinY = static_cast<uint8_t>(ClusterCountY - 1 - TileIndex(maxNdcY, ClusterCountY));
+    bounds.MaxY = static_cast<uint8_t>(ClusterCountY - 1 - TileIndex(minNdcY, ClusterCountY));
+    return true;
+}
+
+void LightClusterGrid::FillSlice(uint32_t slice, size_t lightCount, SliceLights& sliceLights) const
+{
+    sliceLights.Counts.assign(ClustersPerSlice, 0);
+    sliceLights.Pairs.clear();
+
+    const ClusterBounds* sliceBounds = &m_ClusterBounds[slice * ClustersPerSlice];
+    const float sliceNear = sliceBounds[0].Min.z;
+    const float sliceFar = sliceBounds[0].Max.z;
+
+    for (size_t i = 0; i < lightCount; ++i)
+    {
+        const LightBounds& lightBounds = m_LightBounds[i];
+        if (!lightBounds.Visible || slice < lightBounds.MinZ || slice > lightBounds.MaxZ)
+        {
+            continue;
+        }
+
+        const XMFLOAT4& sphere = lightBounds.Sphere;
+        const bool unbounded = sphere.w == FLT_MAX;
+        LightBounds bounds = lightBounds;
+        if (!unbounded)
+        {
+            // Narrow the tile range to the part of the sphere inside this
+            // slice: its widest cross-section is at the depth closest to the
+            // center.
+            const float dz = std::max(std::max(sliceNear - sphere.z, sphere.z - sliceFar), 0.0f);
+            const float sliceRadiusSquared = sphere.w * sphere.w - dz * dz;
+            if (sliceRadiusSquared < 0.0f ||
+                !GetTileRange(sphere.x, sphere.y, std::sqrt(sliceRadiusSquared),
+                    std::max(sphere.z - sphere.w, sliceNear), std::min(sphere.z + sphere.w, sliceFar), bounds))
+            {
+                continue;
+            }
+        }
+
+        for (uint32_t y = bounds.MinY; y <= bounds.MaxY; ++y)
+        {
+            for (uint32_t x = bounds.MinX; x <= bounds.MaxX; ++x)
+            {
+                const uint32_t cluster = x + ClusterCountX * y;
+                if (unbounded || SphereIntersectsBox(sphere, sliceBounds[cluster].Min, sliceBounds[cluster].Max))
+                {
+                    sliceLights.Pairs.push_back((cluster << 24) | static_cast<uint32_t>(i));
+                    sliceLights.Counts[cluster]++;
+                }
+            }
+        }
+    }
+
+    // Group by cluster with a counting sort; lights stay in increasing order.
+    uint32_t offsets[ClustersPerSlice];
+    uint32_t offset = 0;
+    for (uint32_t cluster = 0; cluster < ClustersPerSlice; ++cluster)
+    {
+        offsets[cluster] = offset;
+        offset += sliceLights.Counts[cluster];
+    }
+
+    sliceLights.Indices.resize(sliceLights.Pairs.size());
+    for (uint32_t pair : sliceLights.Pairs)
+    {
+        sliceLights.Indices[offsets[pair >> 24]++] = pair & 0xFFFFFF;
+    }
+}
+
+void LightClusterGrid::AssignLights(FXMMATRIX view, const Light* lights, size_t lightCount, float cutoff, unsigned int threadCount)
+{
+    assert(!m_ClusterBounds.empty() && "SetProjection must be called first.");
+    assert(lightCount <= 0xFFFFFF);
+
+    m_Constants.ViewMatrix = view;
+
+    m_LightBounds.resize(lightCount);
+    ParallelFor(lightCount, 256, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            BoundLight(view, lights[i], cutoff, m_LightBounds[i]);
+        }
+    }, threadCount);
+
+    m_SliceLights.resize(ClusterCountZ);
+    ParallelFor(ClusterCountZ, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t slice = begin; slice < end; ++slice)
+        {
+            FillSlice(static_cast<uint32_t>(slice), lightCount, m_SliceLights[slice]);
+        }
+    }, threadCount);
+
+    // Lay the slices out one after another.
+    uint32_t sliceOffsets[ClusterCountZ];
+    uint32_t offset = 0;
+    for (uint32_t slice = 0; slice < ClusterCountZ; ++slice)
+    {
+        const SliceLights& sliceLights = m_SliceLights[slice];
+        sliceOffsets[slice] = offset;
+        for (uint32_t cluster = 0; cluster < ClustersPerSlice; ++cluster)
+        {
+            ClusterLightRange& range = m_ClusterRanges[slice * ClustersPerSlice + cluster];
+            range.Offset = offset;
+            range.Count = sliceLights.Counts[cluster];
+            offset += range.Count;
+        }
+    }
+
+    m_LightIndices.resize(offset);
+    ParallelFor(ClusterCountZ, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t slice = begin; slice < end; ++slice)
+        {
+            const std::vector<uint32_t>& indices = m_SliceLights[slice].Indices;
+            std::copy(indices.begin(), indices.end(), m_LightIndices.begin() + sliceOffsets[slice]);
+        }
+    }, threadCount);
+}
@@ -0,0 +1,171 @@
+#include <cstring>
+#include "CommandList.h"
+#include "ParallelFor.h"
+
+namespace
+{
+    // Argument bytes after the op byte, indexed by CommandListOp.
+    const size_t ArgumentSizes[NumCommandListOps] = { 1, 1, 1, 2, 1, 4, 2, 20 };
+
+    template<typename T>
+    uint8_t* Write(uint8_t* bytes, T value)
+    {
+        std::memcpy(bytes, &value, sizeof(T));
+        return bytes + sizeof(T);
+    }
+
+    template<typename T>
+    T Read(const uint8_t*& bytes)
+    {
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+        bytes += sizeof(T);
+        return value;
+    }
+}
+
+void CommandList::Clear()
+{
+    m_Bytes.clear();
+    m_CommandCount = 0;
+    m_DrawCount = 0;
+}
+
+uint8_t* CommandList::Append(CommandListOp op, size_t argumentSize)
+{
+    const size_t offset = m_Bytes.size();
+    m_Bytes.resize(offset + 1 + argumentSize);
+    m_Bytes[offset] = op;
+    m_CommandCount++;
+    return &m_Bytes[offset + 1];
+}
+
+void CommandList::SetInputLayout(uint8_t inputLayout)
+{
+    Write(Append(CLO_SetInputLayout, 1), inputLayout);
+}
+
+void CommandList::SetVertexShader(uint8_t vertexShader)
+{
+    Write(Append(CLO_SetVertexShader, 1), vertexShader);
+}
+
+void CommandList::SetPixelShader(uint8_t pixelShader)
+{
+    Write(Append(CLO_SetPixelShader, 1), pixelShader);
+}
+
+void CommandList::SetVertexBuffers(uint8_t vertexBuffer, uint8_t instanceBuffer)
+{
+    Write(Write(Append(CLO_SetVertexBuffers, 2), vertexBuffer), instanceBuffer);
+}
+
+void CommandList::SetIndexBuffer(uint8_t indexBuffer)
+{
+    Write(Append(CLO_SetIndexBuffer, 1), indexBuffer);
+}
+
+void CommandList::SetObjectConstants(uint32_t objectConstants)
+{
+    Write(Append(CLO_SetObjectConstants, 4), objectConstants);
+}
+
+void CommandList::SetMaterial(uint16_t material)
+{
+    Write(Append(CLO_SetMaterial, 2), material);
+}
+
+void CommandList::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex,
+    uint32_t startInstance)
+{
+    uint8_t* bytes = Append(CLO_DrawIndexedInstanced, 20);
+    bytes = Write(Write(bytes, indexCount), instanceCount);
+    Write(Write(Write(bytes, startIndex), baseVertex), startInstance);
+    m_DrawCount++;
+}
+
+void CommandList::Replay(RenderContext& context) const
+{
+    ReplayCommandStream(m_Bytes.data(), m_Bytes.size(), context);
+}
+
+bool ReplayCommandStream(const uint8_t* data, size_t size, RenderContext& context)
+{
+    const uint8_t* bytes = data;
+    const uint8_t* end = data + size;
+    while (bytes < end)
+    {
+        const uint8_t op = *bytes++;
+        if (op >= NumCommandListOps || static_cast<size_t>(end - bytes) < ArgumentSizes[op])
+        {
+            return false;
+        }
+
+        switch (op)
+        {
+        case CLO_SetInputLayout:
+            context.SetInputLayout(Read<uint8_t>(bytes));
+            break;
+        case CLO_SetVertexShader:
+            context.SetVertexShader(Read<uint8_t>(bytes));
+            break;
+        case CLO_SetPixelShader:
+            context.SetPixelShader(Read<uint8_t>(bytes));
+            break;
+        case CLO_SetVertexBuffers:
+        {
+            const uint8_t vertexBuffer = Read<uint8_t>(bytes);
+            const uint8_t instanceBuffer = Read<uint8_t>(bytes);
+            context.SetVertexBuffers(vertexBuffer, instanceBuffer);
+            break;
+        }
+        case CLO_SetIndexBuffer:
+            context.SetIndexBuffer(Read<uint8_t>(bytes));
+            break;
+        case CLO_SetObjectConstants:
+            context.SetObjectConstants(Read<uint32_t>(bytes));
+            break;
+        case CLO_SetMaterial:
+            context.SetMaterial(Read<uint16_t>(bytes));
+            break;
+        case CLO_DrawIndexedInstanced:
+        {
+            const uint32_t indexCount = Read<uint32_t>(bytes);
+            const uint32_t instanceCount = Read<uint32_t>(bytes);
+            const uint32_t startIndex = Read<uint32_t>(bytes);
+            const int32_t baseVertex = Read<int32_t>(bytes);
+            const uint32_t startInstance = Read<uint32_t>(bytes);
+            context.DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+            break;
+        }
+        }
+    }
+    return true;
+}
+
+void RecordCommandLists(const RenderQueue& queue, RenderPass pass, CommandList* lists, size_t listCount,
+    unsigned int threadCount)
+{
+    size_t passBegin = 0;
+    size_t passEnd = 0;
+    queue.GetPassRange(pass, passBegin, passEnd);
+    const size_t packetCount = passEnd - passBegin;
+
+    ParallelFor(listCount, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t list = begin; list < end; ++list)
+        {
+            lists[list].Clear();
+            // An even share of the packets.
+            const size_t first = passBegin + list * packetCount / listCount;
+            const size_t last = passBegin + (list + 1) * packetCount / listCount;
+            if (first < last)
+            {
+                // Roughly a state change and a draw per packet.
+                lists[list].Reserve((last - first) * 24);
+                RenderStateCache cache;
+                queue.Execute(lists[list], cache, first, last);
+            }
+        }
+    }, threadCount);
+}
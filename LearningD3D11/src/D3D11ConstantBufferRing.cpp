@@ -0,0 +1,168 @@
+#include <cassert>
+#include <cstring>
+#include "DirectXTemplate.h"
+#include "D3D11ConstantBufferRing.h"
+
+namespace
+{
+    // D3D11.1 constant buffer offsets and sizes are multiples of 16 constants.
+    const UINT ConstantBufferAlignment = 256;
+    const UINT BytesPerConstant = 16;
+}
+
+D3D11ConstantBufferRing::D3D11ConstantBufferRing()
+    : m_DeviceContext(nullptr)
+    , m_Buffer(nullptr)
+    , m_FrameNumber(0)
+    , m_CompletedFrameNumber(0)
+    , m_MappedData(nullptr)
+    , m_FirstMap(true)
+{
+}
+
+D3D11ConstantBufferRing::~D3D11ConstantBufferRing()
+{
+    Destroy();
+}
+
+bool D3D11ConstantBufferRing::Create(ID3D11Device* device, ID3D11DeviceContext* deviceContext, UINT size, unsigned int framesInFlight)
+{
+    assert(framesInFlight > 0);
+
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+    ZeroMemory(&options, sizeof(options));
+    if (FAILED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) ||
+        !options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer)
+    {
+        return false;
+    }
+
+    m_Ring.Reset(size, ConstantBufferAlignment);
+
+    D3D11_BUFFER_DESC bufferDesc;
+    ZeroMemory(&bufferDesc, sizeof(D3D11_BUFFER_DESC));
+
+    bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    bufferDesc.ByteWidth = static_cast<UINT>(m_Ring.GetCapacity());
+    bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+
+    if (FAILED(device->CreateBuffer(&bufferDesc, nullptr, &m_Buffer)))
+    {
+        return false;
+    }
+
+    D3D11_QUERY_DESC queryDesc = { D3D11_QUERY_EVENT, 0 };
+    m_FrameQueries.resize(framesInFlight, nullptr);
+    for (ID3D11Query*& query : m_FrameQueries)
+    {
+        if (FAILED(device->CreateQuery(&queryDesc, &query)))
+        {
+            Destroy();
+            return false;
+        }
+    }
+
+    m_DeviceContext = deviceContext;
+    m_FrameNumber = 0;
+    m_CompletedFrameNumber = 0;
+    m_FirstMap = true;
+    return true;
+}
+
+void D3D11ConstantBufferRing::Destroy()
+{
+    for (ID3D11Query*& query : m_FrameQueries)
+    {
+        SafeRelease(query);
+    }
+    m_FrameQueries.clear();
+    SafeRelease(m_Buffer);
+    m_DeviceContext = nullptr;
+}
+
+void D3D11ConstantBufferRing::WaitForFrame(uint64_t frameNumber)
+{
+    if (frameNumber <= m_CompletedFrameNumber)
+    {
+        return;
+    }
+
+    // Frame numbers start at 1, so frame n used query (n - 1) % count.
+    ID3D11Query* query = m_FrameQueries[(frameNumber - 1) % m_FrameQueries.size()];
+    while (m_DeviceContext->GetData(query, nullptr, 0, 0) == S_FALSE)
+    {
+        // Flush so the query is submitted, then spin.
+        m_DeviceContext->Flush();
+    }
+
+    m_CompletedFrameNumber = frameNumber;
+    m_Ring.RetireFrames(frameNumber);
+}
+
+void D3D11ConstantBufferRing::BeginFrame()
+{
+    m_FrameNumber++;
+
+    // The query slot this frame will use was last used framesInFlight frames ago.
+    const uint64_t queryCount = m_FrameQueries.size();
+    if (m_FrameNumber > queryCount)
+    {
+        WaitForFrame(m_FrameNumber - queryCount);
+    }
+}
+
+void D3D11ConstantBufferRing::EndFrame()
+{
+    m_Ring.EndFrame(m_FrameNumber);
+    m_DeviceContext->End(m_FrameQueries[(m_FrameNumber - 1) % m_FrameQueries.size()]);
+}
+
+bool D3D11ConstantBufferRing::Map()
+{
+    assert(!m_MappedData);
+
+    // The first map of a dynamic buffer has to discard; after that the ring
+    // guarantees we never overwrite data the GPU may still read.
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    const D3D11_MAP mapType = m_FirstMap ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+    if (FAILED(m_DeviceContext->Map(m_Buffer, 0, mapType, 0, &mappedResource)))
+    {
+        return false;
+    }
+
+    m_FirstMap = false;
+    m_MappedData = static_cast<unsigned char*>(mappedResource.pData);
+    return true;
+}
+
+bool D3D11ConstantBufferRing::Allocate(const void* data, UINT size, ConstantBufferSlice& slice)
+{
+    assert(m_MappedData);
+
+    size_t offset = m_Ring.Allocate(size);
+    while (offset == UploadRing::InvalidOffset && m_Ring.GetFramesInFlight() > 0)
+    {
+        WaitForFrame(m_Ring.GetOldestFrameInFlight());
+        offset = m_Ring.Allocate(size);
+    }
+
+    if (offset == UploadRing::InvalidOffset)
+    {
+        return false;
+    }
+
+    memcpy(m_MappedData + offset, data, size);
+
+    const UINT alignedSize = (size + ConstantBufferAlignment - 1) & ~(ConstantBufferAlignment - 1);
+    slice.FirstConstant = static_cast<UINT>(offset / BytesPerConstant);
+    slice.NumConstants = alignedSize / BytesPerConstant;
+    return true;
+}
+
+void D3D11ConstantBufferRing::Unmap()
+{
+    assert(m_MappedData);
+    m_DeviceContext->Unmap(m_Buffer, 0);
+    m_MappedData = nullptr;
+}
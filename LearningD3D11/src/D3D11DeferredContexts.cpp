@@ -0,0 +1,116 @@
+#include <atomic>
+#include <cassert>
+#include "DirectXTemplate.h"
+#include "D3D11DeferredContexts.h"
+#include "ParallelFor.h"
+
+D3D11DeferredContexts::D3D11DeferredContexts()
+    : m_DriverCommandLists(false)
+{
+}
+
+D3D11DeferredContexts::~D3D11DeferredContexts()
+{
+    Destroy();
+}
+
+bool D3D11DeferredContexts::Create(ID3D11Device* device, unsigned int contextCount)
+{
+    Destroy();
+
+    ID3D11Device1* device1 = nullptr;
+    if (FAILED(device->QueryInterface(__uuidof(ID3D11Device1), (void**)&device1)))
+    {
+        return false;
+    }
+
+    D3D11_FEATURE_DATA_THREADING threading = {};
+    m_DriverCommandLists = SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_THREADING, &threading, sizeof(threading)))
+        && threading.DriverCommandLists;
+
+    bool created = true;
+    for (unsigned int i = 0; created && i < contextCount; ++i)
+    {
+        ID3D11DeviceContext1* deviceContext = nullptr;
+        created = SUCCEEDED(device1->CreateDeferredContext1(0, &deviceContext));
+        if (created)
+        {
+            m_Contexts.push_back(deviceContext);
+        }
+    }
+    SafeRelease(device1);
+
+    if (!created)
+    {
+        Destroy();
+        return false;
+    }
+    m_CommandLists.assign(contextCount, nullptr);
+    return true;
+}
+
+void D3D11DeferredContexts::Destroy()
+{
+    ReleaseCommandLists();
+    m_CommandLists.clear();
+    for (ID3D11DeviceContext1*& deviceContext : m_Contexts)
+    {
+        SafeRelease(deviceContext);
+    }
+    m_Contexts.clear();
+    m_DriverCommandLists = false;
+}
+
+void D3D11DeferredContexts::ReleaseCommandLists()
+{
+    for (ID3D11CommandList*& commandList : m_CommandLists)
+    {
+        SafeRelease(commandList);
+    }
+}
+
+bool D3D11DeferredContexts::Record(const CommandList* lists, size_t count, const D3D11RenderContext& renderContext,
+    const BindStateFunction& bindState, unsigned int threadCount)
+{
+    assert(count <= m_Contexts.size());
+    ReleaseCommandLists();
+
+    std::atomic<bool> finished(true);
+    ParallelFor(count, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (lists[i].GetCommandCount() == 0)
+            {
+                continue;
+            }
+
+            ID3D11DeviceContext1* deviceContext = m_Contexts[i];
+            D3D11RenderContext context = renderContext;
+            context.SetDeviceContext(deviceContext);
+            bindState(deviceContext);
+            lists[i].Replay(context);
+
+            // The context is rebound from scratch by the next Record, so its
+            // state need not be kept.
+            if (FAILED(deviceContext->FinishCommandList(FALSE, &m_CommandLists[i])))
+            {
+                m_CommandLists[i] = nullptr;
+                finished = false;
+            }
+        }
+    }, threadCount);
+    return finished;
+}
+
+void D3D11DeferredContexts::Execute(ID3D11DeviceContext* immediateContext)
+{
+    for (ID3D11CommandList* commandList : m_CommandLists)
+    {
+        if (commandList)
+        {
+            immediateContext->ExecuteCommandList(commandList, FALSE);
+        }
+    }
+    ReleaseCommandLists();
+}
@@ -0,0 +1,189 @@
+#include <cassert>
+#include "DirectXTemplate.h"
+#include "D3D11GpuProfiler.h"
+
+namespace
+{
+    // Marks a zone opened past the frame's maxZones.
+    const uint32_t UntimedZone = 0xFFFFFFFF;
+}
+
+D3D11GpuProfiler::D3D11GpuProfiler()
+    : m_DeviceContext(nullptr)
+    , m_FrameNumber(0)
+    , m_CurrentFrame(nullptr)
+    , m_Track(0)
+    , m_SkippedFrameCount(0)
+{
+}
+
+D3D11GpuProfiler::~D3D11GpuProfiler()
+{
+    Destroy();
+}
+
+bool D3D11GpuProfiler::Create(ID3D11Device* device, ID3D11DeviceContext* deviceContext, unsigned int framesInFlight, unsigned int maxZones)
+{
+    assert(framesInFlight > 0);
+    Destroy();
+
+    D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+    D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+    m_Frames.resize(framesInFlight);
+    for (Frame& frame : m_Frames)
+    {
+        frame.Disjoint = nullptr;
+        frame.Start = nullptr;
+        frame.Zones.resize(maxZones, Zone{ nullptr, nullptr, nullptr, 0 });
+        frame.ZoneCount = 0;
+        frame.CpuStart = 0;
+        frame.Pending = false;
+    }
+    for (Frame& frame : m_Frames)
+    {
+        bool created = SUCCEEDED(device->CreateQuery(&disjointDesc, &frame.Disjoint))
+            && SUCCEEDED(device->CreateQuery(&timestampDesc, &frame.Start));
+        for (size_t i = 0; created && i < frame.Zones.size(); ++i)
+        {
+            created = SUCCEEDED(device->CreateQuery(&timestampDesc, &frame.Zones[i].Begin))
+                && SUCCEEDED(device->CreateQuery(&timestampDesc, &frame.Zones[i].End));
+        }
+        if (!created)
+        {
+            Destroy();
+            return false;
+        }
+    }
+
+    // One track however often the profiler is recreated.
+    static uint32_t track = Profiler::CreateTrack("GPU");
+    m_Track = track;
+    m_DeviceContext = deviceContext;
+    m_FrameNumber = 0;
+    m_SkippedFrameCount = 0;
+    return true;
+}
+
+void D3D11GpuProfiler::Destroy()
+{
+    for (Frame& frame : m_Frames)
+    {
+        SafeRelease(frame.Disjoint);
+        SafeRelease(frame.Start);
+        for (Zone& zone : frame.Zones)
+        {
+            SafeRelease(zone.Begin);
+            SafeRelease(zone.End);
+        }
+    }
+    m_Frames.clear();
+    m_CurrentFrame = nullptr;
+    m_OpenZones.clear();
+    m_DeviceContext = nullptr;
+}
+
+void D3D11GpuProfiler::BeginFrame()
+{
+    assert(!m_CurrentFrame);
+    if (m_Frames.empty())
+    {
+        return;
+    }
+
+    Frame& frame = m_Frames[m_FrameNumber++ % m_Frames.size()];
+    if (frame.Pending)
+    {
+        ReadBack(frame);
+    }
+    if (!Profiler::IsEnabled())
+    {
+        return;
+    }
+
+    frame.ZoneCount = 0;
+    frame.CpuStart = ProfilerNow();
+    m_DeviceContext->Begin(frame.Disjoint);
+    m_DeviceContext->End(frame.Start);
+    m_CurrentFrame = &frame;
+}
+
+void D3D11GpuProfiler::EndFrame()
+{
+    if (!m_CurrentFrame)
+    {
+        return;
+    }
+
+    assert(m_OpenZones.empty());
+    m_DeviceContext->End(m_CurrentFrame->Disjoint);
+    m_CurrentFrame->Pending = true;
+    m_CurrentFrame = nullptr;
+}
+
+void D3D11GpuProfiler::BeginZone(const char* name)
+{
+    if (!m_CurrentFrame)
+    {
+        return;
+    }
+
+    if (m_CurrentFrame->ZoneCount == m_CurrentFrame->Zones.size())
+    {
+        m_OpenZones.push_back(UntimedZone);
+        return;
+    }
+
+    Zone& zone = m_CurrentFrame->Zones[m_CurrentFrame->ZoneCount];
+    zone.Name = name;
+    zone.Depth = static_cast<uint32_t>(m_OpenZones.size());
+    m_DeviceContext->End(zone.Begin);
+    m_OpenZones.push_back(m_CurrentFrame->ZoneCount++);
+}
+
+void D3D11GpuProfiler::EndZone()
+{
+    if (!m_CurrentFrame)
+    {
+        return;
+    }
+
+    assert(!m_OpenZones.empty());
+    const uint32_t zone = m_OpenZones.back();
+    m_OpenZones.pop_back();
+    if (zone != UntimedZone)
+    {
+        m_DeviceContext->End(m_CurrentFrame->Zones[zone].End);
+    }
+}
+
+void D3D11GpuProfiler::ReadBack(Frame& frame)
+{
+    frame.Pending = false;
+
+    // The frame was issued framesInFlight frames ago and is normally done;
+    // if it is not, skip it rather than wait.
+    const UINT flags = D3D11_ASYNC_GETDATA_DONOTFLUSH;
+    D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+    UINT64 start = 0;
+    if (m_DeviceContext->GetData(frame.Disjoint, &disjoint, sizeof(disjoint), flags) != S_OK || disjoint.Disjoint ||
+        m_DeviceContext->GetData(frame.Start, &start, sizeof(start), flags) != S_OK)
+    {
+        ++m_SkippedFrameCount;
+        return;
+    }
+
+    const double nanosecondsPerTick = 1e9 / disjoint.Frequency;
+    for (uint32_t i = 0; i < frame.ZoneCount; ++i)
+    {
+        const Zone& zone = frame.Zones[i];
+        UINT64 begin = 0;
+        UINT64 end = 0;
+        if (m_DeviceContext->GetData(zone.Begin, &begin, sizeof(begin), flags) == S_OK &&
+            m_DeviceContext->GetData(zone.End, &end, sizeof(end), flags) == S_OK && end >= begin)
+        {
+            const int64_t cpuBegin = frame.CpuStart + static_cast<int64_t>((begin - start) * nanosecondsPerTick);
+            const int64_t cpuEnd = frame.CpuStart + static_cast<int64_t>((end - start) * nanosecondsPerTick);
+            Profiler::RecordEvent(m_Track, zone.Name, cpuBegin, cpuEnd, zone.Depth);
+        }
+    }
+}
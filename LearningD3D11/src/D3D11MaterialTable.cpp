@@ -0,0 +1,84 @@
+#include <algorithm>
+#include "DirectXTemplate.h"
+#include "D3D11MaterialTable.h"
+
+D3D11MaterialTable::D3D11MaterialTable()
+    : m_Device(nullptr)
+    , m_Buffer(nullptr)
+    , m_ShaderResourceView(nullptr)
+    , m_Capacity(0)
+{
+}
+
+D3D11MaterialTable::~D3D11MaterialTable()
+{
+    Destroy();
+}
+
+bool D3D11MaterialTable::Create(ID3D11Device* device, uint32_t capacity)
+{
+    Destroy();
+
+    D3D11_BUFFER_DESC bufferDesc;
+    ZeroMemory(&bufferDesc, sizeof(D3D11_BUFFER_DESC));
+
+    bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    bufferDesc.ByteWidth = sizeof(MaterialProperties) * std::max(capacity, 1u);
+    bufferDesc.CPUAccessFlags = 0;
+    bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    bufferDesc.StructureByteStride = sizeof(MaterialProperties);
+
+    if (FAILED(device->CreateBuffer(&bufferDesc, nullptr, &m_Buffer)))
+    {
+        return false;
+    }
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+    ZeroMemory(&viewDesc, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+
+    viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+    viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    viewDesc.Buffer.FirstElement = 0;
+    viewDesc.Buffer.NumElements = std::max(capacity, 1u);
+
+    if (FAILED(device->CreateShaderResourceView(m_Buffer, &viewDesc, &m_ShaderResourceView)))
+    {
+        Destroy();
+        return false;
+    }
+
+    m_Device = device;
+    m_Capacity = std::max(capacity, 1u);
+    return true;
+}
+
+void D3D11MaterialTable::Destroy()
+{
+    SafeRelease(m_ShaderResourceView);
+    SafeRelease(m_Buffer);
+    m_Capacity = 0;
+}
+
+bool D3D11MaterialTable::Update(ID3D11DeviceContext* deviceContext, MaterialTable& table)
+{
+    if (table.GetCount() > m_Capacity)
+    {
+        // Grow geometrically; the new buffer starts out empty.
+        if (!Create(m_Device, std::max(table.GetCount(), m_Capacity * 2)))
+        {
+            return false;
+        }
+        table.MarkAllDirty();
+    }
+
+    for (const MaterialRange& range : table.GetDirtyRanges())
+    {
+        const UINT stride = sizeof(MaterialProperties);
+        D3D11_BOX box = { range.Begin * stride, 0, 0, range.End * stride, 1, 1 };
+        deviceContext->UpdateSubresource(m_Buffer, 0, &box, table.GetData() + range.Begin, 0, 0);
+    }
+
+    table.ClearDirty();
+    return true;
+}
@@ -0,0 +1,84 @@
+#include "DirectXTemplate.h"
+#include "D3D11MeshFile.h"
+
+namespace
+{
+    const uint64_t MaxBufferSize = uint64_t(D3D11_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_A_TERM) * 1024 * 1024;
+
+    bool CreateImmutableBuffer(ID3D11Device* device, UINT bindFlags, const void* data, uint64_t size, ID3D11Buffer** buffer)
+    {
+        if (size == 0 || size > MaxBufferSize)
+        {
+            return false;
+        }
+
+        D3D11_BUFFER_DESC bufferDesc;
+        ZeroMemory(&bufferDesc, sizeof(D3D11_BUFFER_DESC));
+
+        bufferDesc.BindFlags = bindFlags;
+        bufferDesc.ByteWidth = static_cast<UINT>(size);
+        bufferDesc.CPUAccessFlags = 0;
+        bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+
+        D3D11_SUBRESOURCE_DATA resourceData;
+        ZeroMemory(&resourceData, sizeof(D3D11_SUBRESOURCE_DATA));
+        resourceData.pSysMem = data;
+
+        return SUCCEEDED(device->CreateBuffer(&bufferDesc, &resourceData, buffer));
+    }
+
+    const char* GetSemanticName(uint32_t semantic)
+    {
+        switch (semantic)
+        {
+        case MAS_Position: return "POSITION";
+        case MAS_Normal: return "NORMAL";
+        case MAS_Color: return "COLOR";
+        default: return "TEXCOORD";
+        }
+    }
+
+    DXGI_FORMAT GetAttributeFormat(uint32_t format)
+    {
+        switch (format)
+        {
+        case MAF_Float2: return DXGI_FORMAT_R32G32_FLOAT;
+        case MAF_Float3: return DXGI_FORMAT_R32G32B32_FLOAT;
+        case MAF_Half2: return DXGI_FORMAT_R16G16_FLOAT;
+        case MAF_Half4: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+        case MAF_Unorm16x4: return DXGI_FORMAT_R16G16B16A16_UNORM;
+        case MAF_Snorm16x2: return DXGI_FORMAT_R16G16_SNORM;
+        case MAF_Unorm8x4: return DXGI_FORMAT_R8G8B8A8_UNORM;
+        default: return DXGI_FORMAT_UNKNOWN;
+        }
+    }
+}
+
+bool CreateMeshFileBuffers(ID3D11Device* device, const MappedMeshFile& file,
+    ID3D11Buffer** vertexBuffer, ID3D11Buffer** indexBuffer)
+{
+    if (!CreateImmutableBuffer(device, D3D11_BIND_VERTEX_BUFFER, file.GetVertexData(), file.GetVertexDataSize(), vertexBuffer))
+    {
+        return false;
+    }
+    if (!CreateImmutableBuffer(device, D3D11_BIND_INDEX_BUFFER, file.GetIndexData(), file.GetIndexDataSize(), indexBuffer))
+    {
+        SafeRelease(*vertexBuffer);
+        return false;
+    }
+    return true;
+}
+
+DXGI_FORMAT GetMeshFileIndexFormat(const MeshFileHeader& header)
+{
+    return (header.IndexSize == 2) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+}
+
+void GetMeshFileInputElements(const MeshFileHeader& header, D3D11_INPUT_ELEMENT_DESC* elements)
+{
+    for (uint32_t i = 0; i < header.AttributeCount; ++i)
+    {
+        const MeshFileAttribute& attribute = header.Attributes[i];
+        elements[i] = { GetSemanticName(attribute.Semantic), 0, GetAttributeFormat(attribute.Format), 0, attribute.Offset, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+    }
+}
@@ -0,0 +1,130 @@
+#include <cassert>
+#include "D3D11RenderContext.h"
+
+D3D11RenderContext::D3D11RenderContext(ID3D11DeviceContext1* deviceContext, D3D11ShaderCache* shaderCache)
+    : m_DeviceContext(deviceContext)
+    , m_ShaderCache(shaderCache)
+    , m_ConstantBuffer(nullptr)
+    , m_ObjectConstants(nullptr)
+    , m_Materials(nullptr)
+{
+    m_FrameConstants.FirstConstant = 0;
+    m_FrameConstants.NumConstants = 0;
+}
+
+void D3D11RenderContext::RegisterInputLayout(uint8_t id, ID3D11InputLayout* inputLayout)
+{
+    Register(m_InputLayouts, id, inputLayout);
+}
+
+void D3D11RenderContext::RegisterVertexShader(uint8_t id, uint32_t shaderEntry)
+{
+    Register(m_VertexShaders, id, shaderEntry);
+}
+
+void D3D11RenderContext::RegisterPixelShader(uint8_t id, uint32_t shaderEntry)
+{
+    Register(m_PixelShaders, id, shaderEntry);
+}
+
+void D3D11RenderContext::RegisterVertexBuffer(uint8_t id, ID3D11Buffer* buffer, UINT stride)
+{
+    Register(m_VertexBuffers, id, VertexBuffer{ buffer, stride });
+}
+
+void D3D11RenderContext::RegisterIndexBuffer(uint8_t id, ID3D11Buffer* buffer, DXGI_FORMAT format)
+{
+    Register(m_IndexBuffers, id, IndexBuffer{ buffer, format });
+}
+
+void D3D11RenderContext::SetConstantBuffer(ID3D11Buffer* constantBuffer)
+{
+    m_ConstantBuffer = constantBuffer;
+}
+
+void D3D11RenderContext::SetFrameConstants(const ConstantBufferSlice& perFrame)
+{
+    m_FrameConstants = perFrame;
+}
+
+void D3D11RenderContext::SetObjectConstantSlices(const ConstantBufferSlice* objectConstants)
+{
+    m_ObjectConstants = objectConstants;
+}
+
+void D3D11RenderContext::SetMaterialSlices(const ConstantBufferSlice* materials)
+{
+    m_Materials = materials;
+}
+
+void D3D11RenderContext::SetInputLayout(uint8_t inputLayout)
+{
+    m_DeviceContext->IASetInputLayout(m_InputLayouts[inputLayout]);
+}
+
+void D3D11RenderContext::SetVertexShader(uint8_t vertexShader)
+{
+    m_DeviceContext->VSSetShader(m_ShaderCache->GetVertexShader(m_VertexShaders[vertexShader]), nullptr, 0);
+}
+
+void D3D11RenderContext::SetPixelShader(uint8_t pixelShader)
+{
+    if (pixelShader == NoResource)
+    {
+        // Depth only.
+        m_DeviceContext->PSSetShader(nullptr, nullptr, 0);
+        return;
+    }
+
+    m_DeviceContext->PSSetShader(m_ShaderCache->GetPixelShader(m_PixelShaders[pixelShader]), nullptr, 0);
+}
+
+void D3D11RenderContext::SetVertexBuffers(uint8_t vertexBuffer, uint8_t instanceBuffer)
+{
+    ID3D11Buffer* buffers[2] = { m_VertexBuffers[vertexBuffer].Buffer, nullptr };
+    UINT strides[2] = { m_VertexBuffers[vertexBuffer].Stride, 0 };
+    const UINT offsets[2] = { 0, 0 };
+
+    if (instanceBuffer != NoResource)
+    {
+        buffers[1] = m_VertexBuffers[instanceBuffer].Buffer;
+        strides[1] = m_VertexBuffers[instanceBuffer].Stride;
+    }
+
+    m_DeviceContext->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+}
+
+void D3D11RenderContext::SetIndexBuffer(uint8_t indexBuffer)
+{
+    m_DeviceContext->IASetIndexBuffer(m_IndexBuffers[indexBuffer].Buffer, m_IndexBuffers[indexBuffer].Format, 0);
+}
+
+void D3D11RenderContext::SetObjectConstants(uint32_t objectConstants)
+{
+    const ConstantBufferSlice* slice = &m_FrameConstants;
+    if (objectConstants != NoObjectConstants)
+    {
+        assert(m_ObjectConstants);
+        slice = &m_ObjectConstants[objectConstants];
+    }
+
+    m_DeviceContext->VSSetConstantBuffers1(0, 1, &m_ConstantBuffer, &slice->FirstConstant, &slice->NumConstants);
+}
+
+void D3D11RenderContext::SetMaterial(uint16_t material)
+{
+    if (material == NoMaterial)
+    {
+        // The pixel shader reads the material table instead.
+        return;
+    }
+
+    assert(m_Materials);
+    m_DeviceContext->PSSetConstantBuffers1(0, 1, &m_ConstantBuffer, &m_Materials[material].FirstConstant, &m_Materials[material].NumConstants);
+}
+
+void D3D11RenderContext::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex,
+    uint32_t startInstance)
+{
+    m_DeviceContext->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
@@ -0,0 +1,70 @@
+#include "DirectXTemplate.h"
+#include "D3D11ShaderCache.h"
+
+D3D11ShaderCache::D3D11ShaderCache()
+    : m_Device(nullptr)
+    , m_Archive(nullptr)
+    , m_CreatedCount(0)
+{
+}
+
+D3D11ShaderCache::~D3D11ShaderCache()
+{
+    Destroy();
+}
+
+void D3D11ShaderCache::Create(ID3D11Device* device, const ShaderArchive& archive)
+{
+    Destroy();
+    m_Device = device;
+    m_Archive = &archive;
+    m_Shaders.assign(archive.GetBucketCount(), CachedShader{ nullptr, false });
+}
+
+void D3D11ShaderCache::Destroy()
+{
+    for (CachedShader& cached : m_Shaders)
+    {
+        SafeRelease(cached.Shader);
+    }
+    m_Shaders.clear();
+    m_Device = nullptr;
+    m_Archive = nullptr;
+    m_CreatedCount = 0;
+}
+
+ID3D11VertexShader* D3D11ShaderCache::GetVertexShader(uint32_t entry)
+{
+    if (entry >= m_Shaders.size())
+    {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    CachedShader& cached = m_Shaders[entry];
+    if (!cached.Shader && !cached.Failed)
+    {
+        ID3D11VertexShader* vertexShader = nullptr;
+        cached.Failed = FAILED(m_Device->CreateVertexShader(m_Archive->GetBytecode(entry), m_Archive->GetBytecodeSize(entry), nullptr, &vertexShader));
+        cached.Shader = vertexShader;
+        m_CreatedCount += cached.Failed ? 0 : 1;
+    }
+    return static_cast<ID3D11VertexShader*>(cached.Shader);
+}
+
+ID3D11PixelShader* D3D11ShaderCache::GetPixelShader(uint32_t entry)
+{
+    if (entry >= m_Shaders.size())
+    {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    CachedShader& cached = m_Shaders[entry];
+    if (!cached.Shader && !cached.Failed)
+    {
+        ID3D11PixelShader* pixelShader = nullptr;
+        cached.Failed = FAILED(m_Device->CreatePixelShader(m_Archive->GetBytecode(entry), m_Archive->GetBytecodeSize(entry), nullptr, &pixelShader));
+        cached.Shader = pixelShader;
+        m_CreatedCount += cached.Failed ? 0 : 1;
+    }
+    return static_cast<ID3D11PixelShader*>(cached.Shader);
+}
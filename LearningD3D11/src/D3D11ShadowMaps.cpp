@@ -0,0 +1,166 @@
+#include "DirectXTemplate.h"
+#include "D3D11ShadowMaps.h"
+
+D3D11ShadowMaps::D3D11ShadowMaps()
+    : m_Texture(nullptr)
+    , m_ShaderResourceView(nullptr)
+    , m_Sampler(nullptr)
+    , m_RasterizerState(nullptr)
+    , m_DepthStencilState(nullptr)
+    , m_Resolution(0)
+{
+}
+
+D3D11ShadowMaps::~D3D11ShadowMaps()
+{
+    Destroy();
+}
+
+bool D3D11ShadowMaps::Create(ID3D11Device* device, UINT resolution, UINT sliceCount)
+{
+    Destroy();
+
+    // Typeless, so the same texture can be a depth target and a float SRV.
+    D3D11_TEXTURE2D_DESC textureDesc;
+    ZeroMemory(&textureDesc, sizeof(D3D11_TEXTURE2D_DESC));
+
+    textureDesc.Width = resolution;
+    textureDesc.Height = resolution;
+    textureDesc.MipLevels = 1;
+    textureDesc.ArraySize = sliceCount;
+    textureDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.SampleDesc.Quality = 0;
+    textureDesc.Usage = D3D11_USAGE_DEFAULT;
+    textureDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+
+    if (FAILED(device->CreateTexture2D(&textureDesc, nullptr, &m_Texture)))
+    {
+        return false;
+    }
+
+    m_DepthStencilViews.assign(sliceCount, nullptr);
+    for (UINT slice = 0; slice < sliceCount; ++slice)
+    {
+        D3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc;
+        ZeroMemory(&depthStencilViewDesc, sizeof(D3D11_DEPTH_STENCIL_VIEW_DESC));
+
+        depthStencilViewDesc.Format = DXGI_FORMAT_D32_FLOAT;
+        depthStencilViewDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+        depthStencilViewDesc.Texture2DArray.MipSlice = 0;
+        depthStencilViewDesc.Texture2DArray.FirstArraySlice = slice;
+        depthStencilViewDesc.Texture2DArray.ArraySize = 1;
+
+        if (FAILED(device->CreateDepthStencilView(m_Texture, &depthStencilViewDesc, &m_DepthStencilViews[slice])))
+        {
+            Destroy();
+            return false;
+        }
+    }
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+    ZeroMemory(&viewDesc, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+
+    viewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+    viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+    viewDesc.Texture2DArray.MostDetailedMip = 0;
+    viewDesc.Texture2DArray.MipLevels = 1;
+    viewDesc.Texture2DArray.FirstArraySlice = 0;
+    viewDesc.Texture2DArray.ArraySize = sliceCount;
+
+    if (FAILED(device->CreateShaderResourceView(m_Texture, &viewDesc, &m_ShaderResourceView)))
+    {
+        Destroy();
+        return false;
+    }
+
+    // Bilinear comparison: each sample is already a 2x2 percentage closer
+    // filter. Outside the map is lit.
+    D3D11_SAMPLER_DESC samplerDesc;
+    ZeroMemory(&samplerDesc, sizeof(D3D11_SAMPLER_DESC));
+
+    samplerDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+    samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+    samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+    samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+    samplerDesc.MipLODBias = 0.0f;
+    samplerDesc.MaxAnisotropy = 1;
+    samplerDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+    samplerDesc.BorderColor[0] = 1.0f;
+    samplerDesc.BorderColor[1] = 1.0f;
+    samplerDesc.BorderColor[2] = 1.0f;
+    samplerDesc.BorderColor[3] = 1.0f;
+    samplerDesc.MinLOD = 0;
+    samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+
+    if (FAILED(device->CreateSamplerState(&samplerDesc, &m_Sampler)))
+    {
+        Destroy();
+        return false;
+    }
+
+    D3D11_RASTERIZER_DESC rasterizerDesc;
+    ZeroMemory(&rasterizerDesc, sizeof(D3D11_RASTERIZER_DESC));
+
+    rasterizerDesc.CullMode = D3D11_CULL_BACK;
+    rasterizerDesc.DepthBias = 100;
+    rasterizerDesc.DepthBiasClamp = 0.01f;
+    rasterizerDesc.SlopeScaledDepthBias = 2.0f;
+    rasterizerDesc.DepthClipEnable = FALSE;
+    rasterizerDesc.FillMode = D3D11_FILL_SOLID;
+    rasterizerDesc.FrontCounterClockwise = FALSE;
+
+    if (FAILED(device->CreateRasterizerState(&rasterizerDesc, &m_RasterizerState)))
+    {
+        Destroy();
+        return false;
+    }
+
+    // Shadow maps always use standard depth, whatever the camera does.
+    D3D11_DEPTH_STENCIL_DESC depthStencilStateDesc;
+    ZeroMemory(&depthStencilStateDesc, sizeof(D3D11_DEPTH_STENCIL_DESC));
+
+    depthStencilStateDesc.DepthEnable = TRUE;
+    depthStencilStateDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+    depthStencilStateDesc.DepthFunc = D3D11_COMPARISON_LESS;
+    depthStencilStateDesc.StencilEnable = FALSE;
+
+    if (FAILED(device->CreateDepthStencilState(&depthStencilStateDesc, &m_DepthStencilState)))
+    {
+        Destroy();
+        return false;
+    }
+
+    m_Resolution = resolution;
+    return true;
+}
+
+void D3D11ShadowMaps::Destroy()
+{
+    SafeRelease(m_DepthStencilState);
+    SafeRelease(m_RasterizerState);
+    SafeRelease(m_Sampler);
+    SafeRelease(m_ShaderResourceView);
+    for (ID3D11DepthStencilView*& depthStencilView : m_DepthStencilViews)
+    {
+        SafeRelease(depthStencilView);
+    }
+    m_DepthStencilViews.clear();
+    SafeRelease(m_Texture);
+    m_Resolution = 0;
+}
+
+void D3D11ShadowMaps::BeginSlice(ID3D11DeviceContext* deviceContext, UINT slice)
+{
+    D3D11_VIEWPORT viewport = { 0 };
+    viewport.Width = static_cast<float>(m_Resolution);
+    viewport.Height = static_cast<float>(m_Resolution);
+    viewport.MinDepth = 0.0f;
+    viewport.MaxDepth = 1.0f;
+
+    deviceContext->ClearDepthStencilView(m_DepthStencilViews[slice], D3D11_CLEAR_DEPTH, 1.0f, 0);
+    deviceContext->OMSetRenderTargets(0, nullptr, m_DepthStencilViews[slice]);
+    deviceContext->OMSetDepthStencilState(m_DepthStencilState, 0);
+    deviceContext->RSSetState(m_RasterizerState);
+    deviceContext->RSSetViewports(1, &viewport);
+}
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cstring>
+#include "DirectXTemplate.h"
+#include "D3D11StructuredBuffer.h"
+
+D3D11StructuredBuffer::D3D11StructuredBuffer()
+    : m_Device(nullptr)
+    , m_Buffer(nullptr)
+    , m_ShaderResourceView(nullptr)
+    , m_Stride(0)
+    , m_Capacity(0)
+{
+}
+
+D3D11StructuredBuffer::~D3D11StructuredBuffer()
+{
+    Destroy();
+}
+
+bool D3D11StructuredBuffer::Create(ID3D11Device* device, UINT stride, UINT capacity)
+{
+    Destroy();
+    capacity = std::max(capacity, 1u);
+
+    D3D11_BUFFER_DESC bufferDesc;
+    ZeroMemory(&bufferDesc, sizeof(D3D11_BUFFER_DESC));
+
+    bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    bufferDesc.ByteWidth = stride * capacity;
+    bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    bufferDesc.StructureByteStride = stride;
+
+    if (FAILED(device->CreateBuffer(&bufferDesc, nullptr, &m_Buffer)))
+    {
+        return false;
+    }
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+    ZeroMemory(&viewDesc, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+
+    viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+    viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    viewDesc.Buffer.FirstElement = 0;
+    viewDesc.Buffer.NumElements = capacity;
+
+    if (FAILED(device->CreateShaderResourceView(m_Buffer, &viewDesc, &m_ShaderResourceView)))
+    {
+        Destroy();
+        return false;
+    }
+
+    m_Device = device;
+    m_Stride = stride;
+    m_Capacity = capacity;
+    return true;
+}
+
+void D3D11StructuredBuffer::Destroy()
+{
+    SafeRelease(m_ShaderResourceView);
+    SafeRelease(m_Buffer);
+    m_Capacity = 0;
+}
+
+bool D3D11StructuredBuffer::Update(ID3D11DeviceContext* deviceContext, const void* data, UINT count)
+{
+    if (count > m_Capacity && !Create(m_Device, m_Stride, std::max(count, m_Capacity * 2)))
+    {
+        return false;
+    }
+
+    if (count == 0)
+    {
+        return true;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    if (FAILED(deviceContext->Map(m_Buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)))
+    {
+        return false;
+    }
+
+    memcpy(mappedResource.pData, data, static_cast<size_t>(count) * m_Stride);
+    deviceContext->Unmap(m_Buffer, 0);
+    return true;
+}
@@ -0,0 +1,185 @@
+#include "DirectXTemplate.h"
+#include "D3D11TextureUploadSink.h"
+
+namespace
+{
+    DXGI_FORMAT GetDXGIFormat(TextureFormat format, bool srgb)
+    {
+        switch (format)
+        {
+        case TF_BC1:
+            return srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+        case TF_BC3:
+            return srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+        case TF_BC7:
+            return srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+        default:
+            return srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+        }
+    }
+}
+
+D3D11TextureUploadSink::D3D11TextureUploadSink()
+    : m_Device(nullptr)
+    , m_DeviceContext(nullptr)
+    , m_Placeholder(nullptr)
+    , m_PlaceholderView(nullptr)
+{
+}
+
+D3D11TextureUploadSink::~D3D11TextureUploadSink()
+{
+    Destroy();
+}
+
+bool D3D11TextureUploadSink::Create(ID3D11Device* device, ID3D11DeviceContext* deviceContext)
+{
+    Destroy();
+    m_Device = device;
+    m_DeviceContext = deviceContext;
+
+    D3D11_TEXTURE2D_DESC textureDesc;
+    ZeroMemory(&textureDesc, sizeof(D3D11_TEXTURE2D_DESC));
+    textureDesc.Width = 1;
+    textureDesc.Height = 1;
+    textureDesc.MipLevels = 1;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    const uint8_t grey[4] = { 128, 128, 128, 255 };
+    D3D11_SUBRESOURCE_DATA resourceData;
+    ZeroMemory(&resourceData, sizeof(D3D11_SUBRESOURCE_DATA));
+    resourceData.pSysMem = grey;
+    resourceData.SysMemPitch = sizeof(grey);
+
+    if (FAILED(m_Device->CreateTexture2D(&textureDesc, &resourceData, &m_Placeholder)))
+    {
+        return false;
+    }
+    return CreateView(m_Placeholder, &m_PlaceholderView);
+}
+
+void D3D11TextureUploadSink::Destroy()
+{
+    for (ResidentTexture& texture : m_Textures)
+    {
+        SafeRelease(texture.View);
+        SafeRelease(texture.Texture);
+    }
+    m_Textures.clear();
+    SafeRelease(m_PlaceholderView);
+    SafeRelease(m_Placeholder);
+    m_Device = nullptr;
+    m_DeviceContext = nullptr;
+}
+
+bool D3D11TextureUploadSink::CreateView(ID3D11Texture2D* texture, ID3D11ShaderResourceView** view)
+{
+    return SUCCEEDED(m_Device->CreateShaderResourceView(texture, nullptr, view));
+}
+
+void D3D11TextureUploadSink::Replace(TextureHandle texture, ID3D11Texture2D* newTexture, ID3D11ShaderResourceView* newView, uint32_t firstMip, uint32_t mipLevels)
+{
+    if (texture >= m_Textures.size())
+    {
+        m_Textures.resize(texture + 1, ResidentTexture{ nullptr, nullptr, 0, 0 });
+    }
+    ResidentTexture& resident = m_Textures[texture];
+    SafeRelease(resident.View);
+    SafeRelease(resident.Texture);
+    resident.Texture = newTexture;
+    resident.View = newView;
+    resident.FirstMip = firstMip;
+    resident.MipLevels = mipLevels;
+}
+
+bool D3D11TextureUploadSink::Upload(TextureHandle texture, const TextureImage& image, uint32_t firstMip)
+{
+    const uint32_t mipLevels = image.GetMipCount() - firstMip;
+
+    D3D11_TEXTURE2D_DESC textureDesc;
+    ZeroMemory(&textureDesc, sizeof(D3D11_TEXTURE2D_DESC));
+    textureDesc.Width = GetMipDimension(image.Width, firstMip);
+    textureDesc.Height = GetMipDimension(image.Height, firstMip);
+    textureDesc.MipLevels = mipLevels;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = GetDXGIFormat(image.Format, image.SRGB);
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    // The decoded mips are the initial data; no staging copy.
+    std::vector<D3D11_SUBRESOURCE_DATA> resourceData(mipLevels);
+    for (uint32_t level = 0; level < mipLevels; ++level)
+    {
+        resourceData[level].pSysMem = image.Mips[firstMip + level].data();
+        resourceData[level].SysMemPitch = GetMipPitch(image.Format, image.Width, firstMip + level);
+        resourceData[level].SysMemSlicePitch = 0;
+    }
+
+    ID3D11Texture2D* newTexture = nullptr;
+    ID3D11ShaderResourceView* newView = nullptr;
+    if (FAILED(m_Device->CreateTexture2D(&textureDesc, resourceData.data(), &newTexture)))
+    {
+        return false;
+    }
+    if (!CreateView(newTexture, &newView))
+    {
+        SafeRelease(newTexture);
+        return false;
+    }
+    Replace(texture, newTexture, newView, firstMip, mipLevels);
+    return true;
+}
+
+bool D3D11TextureUploadSink::Trim(TextureHandle texture, uint32_t firstMip)
+{
+    if (texture >= m_Textures.size() || !m_Textures[texture].Texture)
+    {
+        return false;
+    }
+    const ResidentTexture& resident = m_Textures[texture];
+    if (firstMip <= resident.FirstMip || firstMip >= resident.FirstMip + resident.MipLevels)
+    {
+        return false;
+    }
+    const uint32_t droppedLevels = firstMip - resident.FirstMip;
+    const uint32_t mipLevels = resident.MipLevels - droppedLevels;
+
+    D3D11_TEXTURE2D_DESC textureDesc;
+    resident.Texture->GetDesc(&textureDesc);
+    textureDesc.Width = GetMipDimension(textureDesc.Width, droppedLevels);
+    textureDesc.Height = GetMipDimension(textureDesc.Height, droppedLevels);
+    textureDesc.MipLevels = mipLevels;
+    textureDesc.Usage = D3D11_USAGE_DEFAULT;
+
+    ID3D11Texture2D* newTexture = nullptr;
+    ID3D11ShaderResourceView* newView = nullptr;
+    if (FAILED(m_Device->CreateTexture2D(&textureDesc, nullptr, &newTexture)))
+    {
+        return false;
+    }
+    if (!CreateView(newTexture, &newView))
+    {
+        SafeRelease(newTexture);
+        return false;
+    }
+    for (uint32_t level = 0; level < mipLevels; ++level)
+    {
+        m_DeviceContext->CopySubresourceRegion(newTexture, level, 0, 0, 0, resident.Texture, level + droppedLevels, nullptr);
+    }
+    Replace(texture, newTexture, newView, firstMip, mipLevels);
+    return true;
+}
+
+ID3D11ShaderResourceView* D3D11TextureUploadSink::GetShaderResourceView(TextureHandle texture) const
+{
+    if (texture < m_Textures.size() && m_Textures[texture].View)
+    {
+        return m_Textures[texture].View;
+    }
+    return m_PlaceholderView;
+}
@@ -0,0 +1,11 @@
+#include "D3D11VertexFormats.h"
+
+void GetPackedVertexElements(PositionEncoding encoding, D3D11_INPUT_ELEMENT_DESC* elements)
+{
+    const DXGI_FORMAT positionFormat = (encoding == PE_Unorm16) ? DXGI_FORMAT_R16G16B16A16_UNORM : DXGI_FORMAT_R16G16B16A16_FLOAT;
+
+    elements[0] = { "POSITION", 0, positionFormat, 0, offsetof(VertexPacked, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+    elements[1] = { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, offsetof(VertexPacked, Normal), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+    elements[2] = { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, offsetof(VertexPacked, Color), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+    elements[3] = { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, offsetof(VertexPacked, Texture), D3D11_INPUT_PER_VERTEX_DATA, 0 };
+}
@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "DDSFile.h"
+#include "MappedFile.h"
+
+namespace
+{
+    const uint32_t DDSMagic = 0x20534444;   // "DDS "
+
+    const uint32_t DDSD_CAPS = 0x1;
+    const uint32_t DDSD_HEIGHT = 0x2;
+    const uint32_t DDSD_WIDTH = 0x4;
+    const uint32_t DDSD_PITCH = 0x8;
+    const uint32_t DDSD_PIXELFORMAT = 0x1000;
+    const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    const uint32_t DDSD_LINEARSIZE = 0x80000;
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDSCAPS_COMPLEX = 0x8;
+    const uint32_t DDSCAPS_TEXTURE = 0x1000;
+    const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+    const uint32_t FourCCDX10 = 0x30315844;     // "DX10"
+    const uint32_t FourCCDXT1 = 0x31545844;     // "DXT1"
+    const uint32_t FourCCDXT5 = 0x35545844;     // "DXT5"
+
+    // DXGI_FORMAT values, so the tools build without the DXGI headers.
+    const uint32_t DXGIFormatR8G8B8A8Unorm = 28;
+    const uint32_t DXGIFormatR8G8B8A8UnormSRGB = 29;
+    const uint32_t DXGIFormatBC1Unorm = 71;
+    const uint32_t DXGIFormatBC1UnormSRGB = 72;
+    const uint32_t DXGIFormatBC3Unorm = 77;
+    const uint32_t DXGIFormatBC3UnormSRGB = 78;
+    const uint32_t DXGIFormatBC7Unorm = 98;
+    const uint32_t DXGIFormatBC7UnormSRGB = 99;
+    const uint32_t ResourceDimensionTexture2D = 3;
+
+    struct DDSPixelFormat
+    {
+        uint32_t Size;
+        uint32_t Flags;
+        uint32_t FourCC;
+        uint32_t RGBBitCount;
+        uint32_t RBitMask;
+        uint32_t GBitMask;
+        uint32_t BBitMask;
+        uint32_t ABitMask;
+    };
+
+    struct DDSHeader
+    {
+        uint32_t Size;
+        uint32_t Flags;
+        uint32_t Height;
+        uint32_t Width;
+        uint32_t PitchOrLinearSize;
+        uint32_t Depth;
+        uint32_t MipMapCount;
+        uint32_t Reserved1[11];
+        DDSPixelFormat PixelFormat;
+        uint32_t Caps;
+        uint32_t Caps2;
+        uint32_t Caps3;
+        uint32_t Caps4;
+        uint32_t Reserved2;
+    };
+    static_assert(sizeof(DDSHeader) == 124, "DDSHeader is part of the file format");
+
+    struct DDSHeaderDX10
+    {
+        uint32_t DXGIFormat;
+        uint32_t ResourceDimension;
+        uint32_t MiscFlag;
+        uint32_t ArraySize;
+        uint32_t MiscFlags2;
+    };
+    static_assert(sizeof(DDSHeaderDX10) == 20, "DDSHeaderDX10 is part of the file format");
+
+    uint32_t GetDXGIFormat(TextureFormat format, bool srgb)
+    {
+        switch (format)
+        {
+        case TF_BC1:
+            return srgb ? DXGIFormatBC1UnormSRGB : DXGIFormatBC1Unorm;
+        case TF_BC3:
+            return srgb ? DXGIFormatBC3UnormSRGB : DXGIFormatBC3Unorm;
+        case TF_BC7:
+            return srgb ? DXGIFormatBC7UnormSRGB : DXGIFormatBC7Unorm;
+        default:
+            return srgb ? DXGIFormatR8G8B8A8UnormSRGB : DXGIFormatR8G8B8A8Unorm;
+        }
+    }
+
+    bool GetTextureFormat(uint32_t dxgiFormat, TextureFormat& format, bool& srgb)
+    {
+        switch (dxgiFormat)
+        {
+        case DXGIFormatR8G8B8A8Unorm:
+        case DXGIFormatR8G8B8A8UnormSRGB:
+            format = TF_RGBA8;
+            break;
+        case DXGIFormatBC1Unorm:
+        case DXGIFormatBC1UnormSRGB:
+            format = TF_BC1;
+            break;
+        case DXGIFormatBC3Unorm:
+        case DXGIFormatBC3UnormSRGB:
+            format = TF_BC3;
+            break;
+        case DXGIFormatBC7Unorm:
+        case DXGIFormatBC7UnormSRGB:
+            format = TF_BC7;
+            break;
+        default:
+            return false;
+        }
+        srgb = dxgiFormat == GetDXGIFormat(format, true);
+        return true;
+    }
+}
+
+bool WriteDDSFile(const char* fileName, const TextureImage& image)
+{
+    const uint32_t mipCount = image.GetMipCount();
+    if (image.Width == 0 || image.Height == 0 || mipCount == 0 || mipCount > GetFullMipCount(image.Width, image.Height))
+    {
+        return false;
+    }
+    for (uint32_t mip = 0; mip < mipCount; ++mip)
+    {
+        if (image.Mips[mip].size() != GetMipSize(image.Format, image.Width, image.Height, mip))
+        {
+            return false;
+        }
+    }
+
+    DDSHeader header;
+    std::memset(&header, 0, sizeof(DDSHeader));
+    header.Size = sizeof(DDSHeader);
+    header.Flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+    header.Flags |= (image.Format == TF_RGBA8) ? DDSD_PITCH : DDSD_LINEARSIZE;
+    header.Height = image.Height;
+    header.Width = image.Width;
+    header.PitchOrLinearSize = (image.Format == TF_RGBA8)
+        ? GetMipPitch(image.Format, image.Width, 0)
+        : static_cast<uint32_t>(GetMipSize(image.Format, image.Width, image.Height, 0));
+    header.Depth = 1;
+    header.MipMapCount = mipCount;
+    header.PixelFormat.Size = sizeof(DDSPixelFormat);
+    header.PixelFormat.Flags = DDPF_FOURCC;
+    header.PixelFormat.FourCC = FourCCDX10;
+    header.Caps = DDSCAPS_TEXTURE | ((mipCount > 1) ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+    DDSHeaderDX10 headerDX10;
+    headerDX10.DXGIFormat = GetDXGIFormat(image.Format, image.SRGB);
+    headerDX10.ResourceDimension = ResourceDimensionTexture2D;
+    headerDX10.MiscFlag = 0;
+    headerDX10.ArraySize = 1;
+    headerDX10.MiscFlags2 = 0;
+
+    FILE* file = OpenFile(fileName, "wb");
+    if (!file)
+    {
+        return false;
+    }
+    bool written = fwrite(&DDSMagic, sizeof(DDSMagic), 1, file) == 1
+        && fwrite(&header, sizeof(DDSHeader), 1, file) == 1
+        && fwrite(&headerDX10, sizeof(DDSHeaderDX10), 1, file) == 1;
+    for (uint32_t mip = 0; written && mip < mipCount; ++mip)
+    {
+        written = fwrite(image.Mips[mip].data(), 1, image.Mips[mip].size(), file) == image.Mips[mip].size();
+    }
+    written = (fclose(file) == 0) && written;
+    if (!written)
+    {
+        RemoveFile(fileName);
+    }
+    return written;
+}
+
+bool ReadDDSFile(const char* fileName, TextureImage& image)
+{
+    FILE* file = OpenFile(fileName, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    uint32_t magic = 0;
+    DDSHeader header;
+    std::memset(&header, 0, sizeof(DDSHeader));
+    bool read = fread(&magic, sizeof(magic), 1, file) == 1 && magic == DDSMagic
+        && fread(&header, sizeof(DDSHeader), 1, file) == 1 && header.Size == sizeof(DDSHeader)
+        && (header.PixelFormat.Flags & DDPF_FOURCC) != 0
+        && header.Width > 0 && header.Height > 0;
+
+    TextureFormat format = TF_RGBA8;
+    bool srgb = false;
+    if (read && header.PixelFormat.FourCC == FourCCDX10)
+    {
+        DDSHeaderDX10 headerDX10;
+        read = fread(&headerDX10, sizeof(DDSHeaderDX10), 1, file) == 1
+            && headerDX10.ResourceDimension == ResourceDimensionTexture2D && headerDX10.ArraySize == 1
+            && GetTextureFormat(headerDX10.DXGIFormat, format, srgb);
+    }
+    else if (read && header.PixelFormat.FourCC == FourCCDXT1)
+    {
+        format = TF_BC1;
+    }
+    else if (read && header.PixelFormat.FourCC == FourCCDXT5)
+    {
+        format = TF_BC3;
+    }
+    else
+    {
+        read = false;
+    }
+
+    const uint32_t mipCount = (header.Flags & DDSD_MIPMAPCOUNT) ? std::max(header.MipMapCount, 1u) : 1;
+    read = read && mipCount <= GetFullMipCount(header.Width, header.Height);
+    if (read)
+    {
+        image.Width = header.Width;
+        image.Height = header.Height;
+        image.Format = format;
+        image.SRGB = srgb;
+        image.Mips.resize(mipCount);
+        for (uint32_t mip = 0; read && mip < mipCount; ++mip)
+        {
+            image.Mips[mip].resize(size_t(GetMipSize(format, header.Width, header.Height, mip)));
+            read = fread(image.Mips[mip].data(), 1, image.Mips[mip].size(), file) == image.Mips[mip].size();
+        }
+    }
+    fclose(file);
+    return read;
+}
@@ -0,0 +1,643 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <DirectXColors.h>
+#include "ClusteredLighting.h"
+#include "DemoScene.h"
+#include "ParallelFor.h"
+#include "ProceduralMesh.h"
+#include "Profiler.h"
+
+VertexPosNormColTex g_PlaneVerts[4] =
+{
+    { XMFLOAT3(-0.5f, 0.0f,  0.5f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT2(0.0f, 0.0f) }, // 0
+    { XMFLOAT3(0.5f, 0.0f,  0.5f), XMFLOAT3(0.0f, 1.0f, 0.0f),  XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT2(1.0f, 0.0f) }, // 1
+    { XMFLOAT3(0.5f, 0.0f, -0.5f), XMFLOAT3(0.0f, 1.0f, 0.0f),  XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT2(1.0f, 1.0f) }, // 2
+    { XMFLOAT3(-0.5f, 0.0f, -0.5f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT2(0.0f, 1.0f) }  // 3
+};
+
+uint16_t g_PlaneIndex[g_NumPlaneIndices] =
+{
+    0, 1, 3, 1, 2, 3
+};
+
+Mesh g_CubeMesh;
+
+Mesh g_LightMesh;
+LodChain g_LightLodChain;
+LodSettings g_LodSettings;
+uint32_t g_LightLodLevel = 0;
+
+MaterialTable g_MaterialTable;
+
+std::vector<Light> g_Lights;
+LightProperties g_LightProperties;
+
+Scene g_Scene;
+Entity g_SpinningCube = InvalidEntity;
+Entity g_LightCube = InvalidEntity;
+
+std::vector<Entity> g_CubeField;
+std::vector<CubeFieldDraw> g_CubeFieldDraws;
+
+AabbTree g_SceneTree(0.05f);
+std::vector<uint32_t> g_SceneProxies;
+std::vector<uint32_t> g_CubeFieldSlots;
+
+ShadowSettings g_ShadowSettings;
+uint32_t g_ShadowCascadeCount = 0;
+uint32_t g_ShadowViewCount = 0;
+ShadowView g_ShadowViews[MaxShadowViews];
+ShadowConstants g_ShadowConstants;
+std::vector<uint32_t> g_ShadowQueryResults[MaxShadowViews];
+
+namespace
+{
+    // Occlusion test results and per-chunk visible counts, for compacting
+    // the cube field instances.
+    std::vector<uint8_t> g_CubeFieldVisibility;
+    std::vector<uint32_t> g_CubeFieldChunkOffsets;
+    std::vector<uint32_t> g_SceneQueryResults;
+    // Casters per entity, and per-chunk caster counts for compacting them
+    // into each map's range.
+    std::vector<uint8_t> g_ShadowCasterFlags[MaxShadowViews];
+    std::vector<uint32_t> g_ShadowCasterChunkOffsets[MaxShadowViews];
+
+    // The part of the room the cube field is scattered through and bounces
+    // around in.
+    const XMFLOAT3 g_CubeFieldMin(-9.0f, 0.5f, -9.0f);
+    const XMFLOAT3 g_CubeFieldMax(9.0f, 19.5f, 9.0f);
+
+    // Reverse velocity if position is past minimum or maximum and moving
+    // further out. Returns whether it did.
+    bool BounceAxis(float position, float minimum, float maximum, float& velocity)
+    {
+        if ((position < minimum && velocity < 0.0f) || (position > maximum && velocity > 0.0f))
+        {
+            velocity = -velocity;
+            return true;
+        }
+        return false;
+    }
+}
+
+void CreateCube(float size)
+{
+    MeshBuildOptions options;
+    // The software renderer draws with 16-bit indices.
+    options.Format = IF_16Bit;
+    options.Color = XMFLOAT3(0.0f, 1.0f, 0.0f);
+    g_CubeMesh = CreateCubeMesh(size, 1, options);
+}
+
+void CreateLightMesh(float radius)
+{
+    // Subdivisions 3 down to 0. Each subdivision halves the angle an edge
+    // spans (atan(2) for the icosahedron), and a chord spanning angle a sits
+    // at most radius * (1 - cos(a / 2)) inside the sphere.
+    const uint32_t levelCount = 4;
+    Mesh levels[levelCount];
+    float geometricErrors[levelCount];
+    MeshBuildOptions options;
+    options.Color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+    for (uint32_t i = 0; i < levelCount; ++i)
+    {
+        const uint32_t subdivisions = levelCount - 1 - i;
+        levels[i] = CreateIcosphereMesh(radius, subdivisions, options);
+        const float edgeAngle = std::atan(2.0f) / static_cast<float>(1u << subdivisions);
+        geometricErrors[i] = radius * (1.0f - std::cos(0.5f * edgeAngle));
+    }
+
+    g_LightMesh = Mesh();
+    g_LightLodChain = AppendLodLevels(g_LightMesh, levels, geometricErrors, levelCount);
+    // The software renderer draws with 16-bit indices.
+    PackIndices(g_LightMesh, IF_16Bit);
+    g_LightLodLevel = 0;
+}
+
+void SelectLightLod(const Camera& camera, float viewportHeight)
+{
+    const XMMATRIX world = g_Scene.GetWorldMatrix(g_LightCube);
+    const float scale = std::max(XMVectorGetX(XMVector3Length(world.r[0])),
+        std::max(XMVectorGetX(XMVector3Length(world.r[1])), XMVectorGetX(XMVector3Length(world.r[2]))));
+
+    XMFLOAT3 eye, center;
+    XMStoreFloat3(&eye, camera.GetPositionVector());
+    XMStoreFloat3(&center, world.r[3]);
+    const float lodScale = ComputeLodScale(camera.GetProjectionMatrix(), viewportHeight);
+    g_LightLodLevel = SelectLod(g_LightLodChain, g_LodSettings, lodScale, eye, center,
+        g_LightLodChain.BoundingRadius * scale, g_LightLodLevel);
+}
+
+void CreatePlaneInstances(PlaneInstanceData* planeInstanceData)
+{
+    float scalePlane = 20.0f;
+    float translateOffset = scalePlane / 2.0f;
+    XMMATRIX scaleMatrix = XMMatrixScaling(scalePlane, 1.0f, scalePlane);
+    XMMATRIX translateMatrix = XMMatrixTranslation(0, 0, 0);
+    XMMATRIX rotateMatrix = XMMatrixRotationX(0.0f);
+
+    // Every plane is scale * rotation * translation with a per-axis scale.
+
+    // Floor plane.
+    XMMATRIX worldMatrix = scaleMatrix * rotateMatrix * translateMatrix;
+    planeInstanceData[0].WorldMatrix = worldMatrix;
+    planeInstanceData[0].InverseTransposeWorldMatrix = ComputeInverseTransposeWorldMatrix(worldMatrix, TC_AxisScale);
+
+    // Back wall plane.
+    translateMatrix = XMMatrixTranslation(0, translateOffset, translateOffset);
+    rotateMatrix = XMMatrixRotationX(XMConvertToRadians(-90));
+    worldMatrix = scaleMatrix * rotateMatrix * translateMatrix;
+
+    planeInstanceData[1].WorldMatrix = worldMatrix;
+    planeInstanceData[1].InverseTransposeWorldMatrix = ComputeInverseTransposeWorldMatrix(worldMatrix, TC_AxisScale);
+
+    // Ceiling plane.
+    translateMatrix = XMMatrixTranslation(0, translateOffset * 2.0f, 0);
+    rotateMatrix = XMMatrixRotationX(XMConvertToRadians(180));
+    worldMatrix = scaleMatrix * rotateMatrix * translateMatrix;
+
+    planeInstanceData[2].WorldMatrix = worldMatrix;
+    planeInstanceData[2].InverseTransposeWorldMatrix = ComputeInverseTransposeWorldMatrix(worldMatrix, TC_AxisScale);
+
+    // Front wall plane.
+    translateMatrix = XMMatrixTranslation(0, translateOffset, -translateOffset);
+    rotateMatrix = XMMatrixRotationX(XMConvertToRadians(90));
+    worldMatrix = scaleMatrix * rotateMatrix * translateMatrix;
+
+    planeInstanceData[3].WorldMatrix = worldMatrix;
+    planeInstanceData[3].InverseTransposeWorldMatrix = ComputeInverseTransposeWorldMatrix(worldMatrix, TC_AxisScale);
+
+    // Left wall plane.
+    translateMatrix = XMMatrixTranslation(-translateOffset, translateOffset, 0);
+    rotateMatrix = XMMatrixRotationZ(XMConvertToRadians(-90));
+    worldMatrix = scaleMatrix * rotateMatrix * translateMatrix;
+
+    planeInstanceData[4].WorldMatrix = worldMatrix;
+    planeInstanceData[4].InverseTransposeWorldMatrix = ComputeInverseTransposeWorldMatrix(worldMatrix, TC_AxisScale);
+
+    // Right wall plane.
+    translateMatrix = XMMatrixTranslation(translateOffset, translateOffset, 0);
+    rotateMatrix = XMMatrixRotationZ(XMConvertToRadians(90));
+    worldMatrix = scaleMatrix * rotateMatrix * translateMatrix;
+
+    planeInstanceData[5].WorldMatrix = worldMatrix;
+    planeInstanceData[5].InverseTransposeWorldMatrix = ComputeInverseTransposeWorldMatrix(worldMatrix, TC_AxisScale);
+
+    // Every wall uses the green material.
+    for (int i = 0; i < g_NumPlaneInstances; ++i)
+    {
+        planeInstanceData[i].MaterialIndex = 1;
+    }
+}
+
+void CreateMaterials()
+{
+    g_MaterialTable.Clear();
+
+    MaterialProperties defaultMaterial;
+    g_MaterialTable.Add(defaultMaterial);
+
+    MaterialProperties greenMaterial;
+    greenMaterial.Material.Ambient = XMFLOAT4(0.07568f, 0.61424f, 0.07568f, 1.0f);
+    greenMaterial.Material.Diffuse = XMFLOAT4(0.07568f, 0.61424f, 0.07568f, 1.0f);
+    greenMaterial.Material.Specular = XMFLOAT4(0.07568f, 0.61424f, 0.07568f, 1.0f);
+    greenMaterial.Material.SpecularPower = 76.8f;
+    g_MaterialTable.Add(greenMaterial);
+
+    MaterialProperties redPlasticMaterial;
+    redPlasticMaterial.Material.Diffuse = XMFLOAT4(0.6f, 0.1f, 0.1f, 1.0f);
+    redPlasticMaterial.Material.Specular = XMFLOAT4(1.0f, 0.2f, 0.2f, 1.0f);
+    redPlasticMaterial.Material.SpecularPower = 32.0f;
+	redPlasticMaterial.Material.UseTexture = true;
+    g_MaterialTable.Add(redPlasticMaterial);
+
+    MaterialProperties pearlMaterial;
+    pearlMaterial.Material.Ambient = XMFLOAT4(0.25f, 0.20725f, 0.20725f, 1.0f);
+    pearlMaterial.Material.Diffuse = XMFLOAT4(1.0f, 0.829f, 0.829f, 1.0f);
+    pearlMaterial.Material.Specular = XMFLOAT4(0.296648f, 0.296648f, 0.296648f, 1.0f);
+    pearlMaterial.Material.SpecularPower = 11.264f;
+    g_MaterialTable.Add(pearlMaterial);
+}
+
+void CreateLights()
+{
+    // The main light is a spot light shining down from above the spinning cube.
+    Light light;
+    light.Enabled = true;
+    light.LightType = LightType::SpotLight;
+    light.Color = XMFLOAT4(Colors::White);
+    light.Direction = XMFLOAT4(0.0f, -1.0f, 0.0f, 0.0f);
+    light.SpotAngle = XMConvertToRadians(45.0f);
+    light.ConstantAttenuation = 1.0f;
+    light.LinearAttenuation = 0.08f;
+    light.QuadraticAttenuation = 0.0f;
+    XMFLOAT4 LightPosition = XMFLOAT4(0, 12.0f, -1.0f, 1.0f);
+    light.Position = LightPosition;
+    g_LightProperties.Lights[0] = light;
+
+    g_Lights.clear();
+    g_Lights.push_back(light);
+
+    // A dim directional light slanting down through the room.
+    Light directionalLight;
+    directionalLight.Enabled = true;
+    directionalLight.LightType = LightType::DirectionalLight;
+    XMStoreFloat4(&directionalLight.Direction, XMVector3Normalize(XMVectorSet(0.4f, -1.0f, 0.3f, 0.0f)));
+    directionalLight.Color = XMFLOAT4(0.3f, 0.3f, 0.35f, 1.0f);
+    g_LightProperties.Lights[1] = directionalLight;
+    g_Lights.push_back(directionalLight);
+
+    // Small colored point lights scattered through the room. A fixed seed
+    // keeps runs comparable.
+    std::mt19937 random(5678);
+    std::uniform_real_distribution<float> horizontal(-9.5f, 9.5f);
+    std::uniform_real_distribution<float> vertical(0.5f, 19.5f);
+    std::uniform_real_distribution<float> colorComponent(0.2f, 1.0f);
+    for (int i = static_cast<int>(g_Lights.size()); i < g_NumSceneLights; ++i)
+    {
+        Light pointLight;
+        pointLight.Enabled = true;
+        pointLight.LightType = LightType::PointLight;
+        pointLight.Position = XMFLOAT4(horizontal(random), vertical(random), horizontal(random), 1.0f);
+        pointLight.Color = XMFLOAT4(colorComponent(random) * 0.5f, colorComponent(random) * 0.5f, colorComponent(random) * 0.5f, 1.0f);
+        pointLight.ConstantAttenuation = 1.0f;
+        pointLight.LinearAttenuation = 0.0f;
+        pointLight.QuadraticAttenuation = 16.0f;
+        g_Lights.push_back(pointLight);
+    }
+}
+
+void AssignShadowMaps()
+{
+    g_ShadowCascadeCount = 0;
+    for (Light& light : g_Lights)
+    {
+        light.ShadowIndex = -1;
+        if (light.LightType == DirectionalLight && g_ShadowCascadeCount == 0)
+        {
+            light.ShadowIndex = 0;
+            g_ShadowCascadeCount = std::min(std::max(g_ShadowSettings.CascadeCount, 1u), MaxShadowCascades);
+        }
+    }
+
+    g_ShadowViewCount = g_ShadowCascadeCount;
+    for (Light& light : g_Lights)
+    {
+        if (light.LightType == SpotLight && g_ShadowViewCount < g_ShadowCascadeCount + MaxSpotShadows)
+        {
+            light.ShadowIndex = static_cast<int>(g_ShadowViewCount++);
+        }
+    }
+}
+
+void CreateSceneEntities()
+{
+    g_Scene = Scene();
+    g_Scene.Reserve(g_NumCubeFieldInstances + 2);
+
+    g_SpinningCube = g_Scene.CreateEntity();
+    g_Scene.SetPosition(g_SpinningCube, XMFLOAT3(0, 10.0f, 0));
+    g_Scene.SetMaterialIndex(g_SpinningCube, 2);
+
+    g_LightCube = g_Scene.CreateEntity();
+    g_Scene.SetScale(g_LightCube, XMFLOAT3(0.2f, 0.2f, 0.2f));
+
+    // Scatter the cube field through the room. A fixed seed keeps runs comparable.
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> horizontal(g_CubeFieldMin.x, g_CubeFieldMax.x);
+    std::uniform_real_distribution<float> vertical(g_CubeFieldMin.y, g_CubeFieldMax.y);
+    std::uniform_real_distribution<float> axisComponent(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> angularSpeed(0.5f, 3.0f);
+    std::uniform_real_distribution<float> linearSpeed(-0.5f, 0.5f);
+
+    const uint32_t cubeFieldMaterials[] = { 1, 3 };
+
+    g_CubeField.clear();
+    g_CubeField.reserve(g_NumCubeFieldInstances);
+    for (int i = 0; i < g_NumCubeFieldInstances; ++i)
+    {
+        // Draw the values one statement at a time: argument evaluation order
+        // differs between compilers, and the software renderer's golden image
+        // depends on the scene being the same everywhere.
+        XMFLOAT3 position;
+        position.x = horizontal(random);
+        position.y = vertical(random);
+        position.z = horizontal(random);
+        XMFLOAT3 axisDirection;
+        axisDirection.x = axisComponent(random);
+        axisDirection.y = axisComponent(random);
+        axisDirection.z = axisComponent(random);
+
+        const Entity cube = g_Scene.CreateEntity();
+        g_Scene.SetPosition(cube, position);
+        g_Scene.SetScale(cube, XMFLOAT3(0.025f, 0.025f, 0.025f));
+
+        XMVECTOR axis = XMLoadFloat3(&axisDirection);
+        axis = XMVector3Normalize(XMVectorAdd(axis, XMVectorSet(0, 0.01f, 0, 0))) * angularSpeed(random);
+        XMFLOAT3 angularVelocity;
+        XMStoreFloat3(&angularVelocity, axis);
+        g_Scene.SetAngularVelocity(cube, angularVelocity);
+
+        XMFLOAT3 linearVelocity;
+        linearVelocity.x = linearSpeed(random);
+        linearVelocity.y = linearSpeed(random);
+        linearVelocity.z = linearSpeed(random);
+        g_Scene.SetLinearVelocity(cube, linearVelocity);
+
+        g_Scene.SetMaterialIndex(cube, cubeFieldMaterials[i % (sizeof(cubeFieldMaterials) / sizeof(cubeFieldMaterials[0]))]);
+        g_CubeField.push_back(cube);
+    }
+
+    // Group the cube field by material, one draw per group.
+    std::stable_sort(g_CubeField.begin(), g_CubeField.end(), [](Entity a, Entity b)
+    {
+        return g_Scene.GetMaterialIndex(a) < g_Scene.GetMaterialIndex(b);
+    });
+
+    g_CubeFieldDraws.clear();
+    for (size_t i = 0; i < g_CubeField.size(); ++i)
+    {
+        const uint32_t materialIndex = g_Scene.GetMaterialIndex(g_CubeField[i]);
+        if (g_CubeFieldDraws.empty() || g_CubeFieldDraws.back().MaterialIndex != materialIndex)
+        {
+            g_CubeFieldDraws.push_back({ materialIndex, static_cast<uint32_t>(i), 0 });
+        }
+        g_CubeFieldDraws.back().InstanceCount++;
+    }
+}
+
+void StepScene(float deltaTime, float spinAngle)
+{
+    XMVECTOR rotationAxis = XMVectorSet(0, 1, 1, 0);
+    g_Scene.SetRotation(g_SpinningCube, XMQuaternionRotationAxis(rotationAxis, XMConvertToRadians(spinAngle)));
+
+    const XMFLOAT4& lightPosition = g_LightProperties.Lights[0].Position;
+    g_Scene.SetPosition(g_LightCube, XMFLOAT3(lightPosition.x, lightPosition.y, lightPosition.z));
+
+    g_Scene.Integrate(deltaTime);
+
+    // Turn cubes that drifted out of the cube field's box back in.
+    ParallelFor(g_CubeField.size(), 4096, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const XMFLOAT3& position = g_Scene.GetPosition(g_CubeField[i]);
+            XMFLOAT3 velocity = g_Scene.GetLinearVelocity(g_CubeField[i]);
+            bool bounced = BounceAxis(position.x, g_CubeFieldMin.x, g_CubeFieldMax.x, velocity.x);
+            bounced |= BounceAxis(position.y, g_CubeFieldMin.y, g_CubeFieldMax.y, velocity.y);
+            bounced |= BounceAxis(position.z, g_CubeFieldMin.z, g_CubeFieldMax.z, velocity.z);
+            if (bounced)
+            {
+                g_Scene.SetLinearVelocity(g_CubeField[i], velocity);
+            }
+        }
+    });
+}
+
+// Arvo's method gives the box of the transformed cube.
+void GetEntityBox(const XMFLOAT4X4A& worldMatrix, XMFLOAT3& center, XMFLOAT3& extents)
+{
+    const XMMATRIX world = XMLoadFloat4x4A(&worldMatrix);
+    XMStoreFloat3(&center, world.r[3]);
+    XMStoreFloat3(&extents, XMVectorAbs(world.r[0]) + XMVectorAbs(world.r[1]) + XMVectorAbs(world.r[2]));
+}
+
+void BuildSceneTree()
+{
+    g_SceneTree.Clear();
+    g_Scene.Update(0.0f);
+
+    const XMFLOAT4X4A* worldMatrices = g_Scene.GetWorldMatrices();
+    g_SceneProxies.assign(g_Scene.GetEntityCount(), NullProxy);
+    g_CubeFieldSlots.assign(g_Scene.GetEntityCount(), NullProxy);
+    for (size_t i = 0; i < g_Scene.GetEntityCount(); ++i)
+    {
+        const Entity entity = g_Scene.GetEntity(i);
+        if (entity >= g_SceneProxies.size())
+        {
+            g_SceneProxies.resize(entity + 1, NullProxy);
+            g_CubeFieldSlots.resize(entity + 1, NullProxy);
+        }
+        XMFLOAT3 center, extents;
+        GetEntityBox(worldMatrices[i], center, extents);
+        g_SceneProxies[entity] = g_SceneTree.CreateProxy(MakeAabb(center, extents), entity);
+    }
+    for (size_t i = 0; i < g_CubeField.size(); ++i)
+    {
+        g_CubeFieldSlots[g_CubeField[i]] = static_cast<uint32_t>(i);
+    }
+    g_SceneTree.Flatten();
+}
+
+// Spinning and drifting a little stays within the fattened boxes, so the
+// tree is only flattened again when something moved further.
+void UpdateSceneTree()
+{
+    PROFILE_FUNCTION();
+    const XMFLOAT4X4A* worldMatrices = g_Scene.GetWorldMatrices();
+    bool moved = false;
+    for (size_t i = 0; i < g_Scene.GetEntityCount(); ++i)
+    {
+        XMFLOAT3 center, extents;
+        GetEntityBox(worldMatrices[i], center, extents);
+        moved |= g_SceneTree.MoveProxy(g_SceneProxies[g_Scene.GetEntity(i)], MakeAabb(center, extents));
+    }
+    if (moved)
+    {
+        g_SceneTree.Flatten();
+    }
+}
+
+void WriteCubeFieldInstances(PlaneInstanceData* instances)
+{
+    const XMFLOAT4X4A* worldMatrices = g_Scene.GetWorldMatrices();
+    const XMFLOAT4X4A* inverseTransposeWorldMatrices = g_Scene.GetInverseTransposeWorldMatrices();
+    const uint32_t* materialIndices = g_Scene.GetMaterialIndices();
+
+    ParallelFor(g_CubeField.size(), 4096, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const size_t index = g_Scene.GetIndex(g_CubeField[i]);
+            instances[i].WorldMatrix = XMLoadFloat4x4A(&worldMatrices[index]);
+            instances[i].InverseTransposeWorldMatrix = XMLoadFloat4x4A(&inverseTransposeWorldMatrices[index]);
+            instances[i].MaterialIndex = materialIndices[index];
+        }
+    });
+}
+
+uint32_t WriteVisibleCubeFieldInstances(PlaneInstanceData* instances, const Frustum& frustum, const OcclusionBuffer& occlusion)
+{
+    const size_t grainSize = 4096;
+    const size_t count = g_CubeField.size();
+    const XMFLOAT4X4A* worldMatrices = g_Scene.GetWorldMatrices();
+    const XMFLOAT4X4A* inverseTransposeWorldMatrices = g_Scene.GetInverseTransposeWorldMatrices();
+    const uint32_t* materialIndices = g_Scene.GetMaterialIndices();
+
+    g_CubeFieldVisibility.assign(count, 0);
+    g_CubeFieldChunkOffsets.assign((count + grainSize - 1) / grainSize, 0);
+
+    g_SceneQueryResults.clear();
+    g_SceneTree.QueryFrustum(frustum, g_SceneQueryResults);
+    for (uint32_t entity : g_SceneQueryResults)
+    {
+        if (g_CubeFieldSlots[entity] != NullProxy)
+        {
+            g_CubeFieldVisibility[g_CubeFieldSlots[entity]] = 1;
+        }
+    }
+
+    // ParallelFor chunks start at multiples of the grain size, so begin
+    // identifies the chunk.
+    ParallelFor(count, grainSize, [&](size_t begin, size_t end)
+    {
+        uint32_t visibleCount = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (!g_CubeFieldVisibility[i])
+            {
+                continue;
+            }
+            XMFLOAT3 center, extents;
+            GetEntityBox(worldMatrices[g_Scene.GetIndex(g_CubeField[i])], center, extents);
+            const bool visible = occlusion.IsBoxVisible(center, extents);
+            g_CubeFieldVisibility[i] = visible ? 1 : 0;
+            visibleCount += visible ? 1 : 0;
+        }
+        g_CubeFieldChunkOffsets[begin / grainSize] = visibleCount;
+    });
+
+    uint32_t visibleCount = 0;
+    for (uint32_t& offset : g_CubeFieldChunkOffsets)
+    {
+        const uint32_t chunkCount = offset;
+        offset = visibleCount;
+        visibleCount += chunkCount;
+    }
+
+    ParallelFor(count, grainSize, [&](size_t begin, size_t end)
+    {
+        uint32_t out = g_CubeFieldChunkOffsets[begin / grainSize];
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (g_CubeFieldVisibility[i])
+            {
+                const size_t index = g_Scene.GetIndex(g_CubeField[i]);
+                instances[out].WorldMatrix = XMLoadFloat4x4A(&worldMatrices[index]);
+                instances[out].InverseTransposeWorldMatrix = XMLoadFloat4x4A(&inverseTransposeWorldMatrices[index]);
+                instances[out].MaterialIndex = materialIndices[index];
+                ++out;
+            }
+        }
+    });
+    return visibleCount;
+}
+
+void FitShadowMaps(const Camera& camera)
+{
+    PROFILE_FUNCTION();
+    Aabb casterBounds;
+    const bool hasCasters = g_SceneTree.GetBounds(casterBounds);
+    for (const Light& light : g_Lights)
+    {
+        if (light.ShadowIndex < 0)
+        {
+            continue;
+        }
+        if (light.LightType == DirectionalLight)
+        {
+            const XMFLOAT3 direction(light.Direction.x, light.Direction.y, light.Direction.z);
+            FitCascades(camera, direction, hasCasters ? &casterBounds : nullptr, g_ShadowSettings, &g_ShadowViews[light.ShadowIndex]);
+        }
+        else
+        {
+            FitSpotShadow(light, ComputeLightRange(light, DefaultLightCutoff), g_ShadowSettings, g_ShadowViews[light.ShadowIndex]);
+        }
+    }
+    GetShadowConstants(g_ShadowViews, g_ShadowViewCount, g_ShadowCascadeCount, g_ShadowSettings.Resolution, g_ShadowConstants);
+}
+
+uint32_t WriteShadowCasters(uint32_t view, ShadowInstanceData* instances)
+{
+    const size_t grainSize = 4096;
+    const size_t count = g_Scene.GetEntityCount();
+    const ShadowView& shadowView = g_ShadowViews[view];
+    const float minCasterTexels = g_ShadowSettings.MinCasterTexels;
+    const XMFLOAT4X4A* worldMatrices = g_Scene.GetWorldMatrices();
+    std::vector<uint32_t>& queryResults = g_ShadowQueryResults[view];
+    std::vector<uint8_t>& casterFlags = g_ShadowCasterFlags[view];
+    std::vector<uint32_t>& chunkOffsets = g_ShadowCasterChunkOffsets[view];
+
+    casterFlags.assign(count, 0);
+    chunkOffsets.assign((count + grainSize - 1) / grainSize, 0);
+
+    // Flag the candidates by index, so the narrow phase walks the transforms
+    // in memory order rather than the tree's.
+    queryResults.clear();
+    g_SceneTree.QueryFrustum(shadowView.Volume, queryResults);
+    for (uint32_t entity : queryResults)
+    {
+        if (entity != g_LightCube)
+        {
+            casterFlags[g_Scene.GetIndex(entity)] = 1;
+        }
+    }
+
+    // ParallelFor chunks start at multiples of the grain size, so begin
+    // identifies the chunk.
+    ParallelFor(count, grainSize, [&](size_t begin, size_t end)
+    {
+        uint32_t casterCount = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (!casterFlags[i])
+            {
+                continue;
+            }
+            XMFLOAT3 center, extents;
+            GetEntityBox(worldMatrices[i], center, extents);
+            const bool caster = IsShadowCasterVisible(shadowView, center, extents, minCasterTexels);
+            casterFlags[i] = caster ? 1 : 0;
+            casterCount += caster ? 1 : 0;
+        }
+        chunkOffsets[begin / grainSize] = casterCount;
+    });
+
+    uint32_t casterCount = 0;
+    for (uint32_t& offset : chunkOffsets)
+    {
+        const uint32_t chunkCount = offset;
+        offset = casterCount;
+        casterCount += chunkCount;
+    }
+    assert(casterCount <= g_ShadowCasterCapacity);
+
+    ParallelFor(count, grainSize, [&](size_t begin, size_t end)
+    {
+        uint32_t out = chunkOffsets[begin / grainSize];
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (casterFlags[i])
+            {
+                // Columns of the row-vector world matrix.
+                const XMMATRIX columns = XMMatrixTranspose(XMLoadFloat4x4A(&worldMatrices[i]));
+                XMStoreFloat4(&instances[out].WorldColumns[0], columns.r[0]);
+                XMStoreFloat4(&instances[out].WorldColumns[1], columns.r[1]);
+                XMStoreFloat4(&instances[out].WorldColumns[2], columns.r[2]);
+                ++out;
+            }
+        }
+    });
+    return casterCount;
+}
+
+PerObjectTransformData GetPerObjectTransformData(Entity entity, FXMMATRIX viewProjection)
+{
+    PerObjectTransformData perObjectTransformData;
+    perObjectTransformData.WorldMatrix = g_Scene.GetWorldMatrix(entity);
+    perObjectTransformData.InverseTransposeWorldMatrix = g_Scene.GetInverseTransposeWorldMatrix(entity);
+    perObjectTransformData.WorldViewProjectMatrix = perObjectTransformData.WorldMatrix * viewProjection;
+    return perObjectTransformData;
+}
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "FrameScheduler.h"
+
+namespace
+{
+    int64_t ToNanoseconds(double seconds)
+    {
+        return static_cast<int64_t>(seconds * 1e9 + 0.5);
+    }
+}
+
+int64_t SteadyFrameClock::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SteadyFrameClock::Sleep(int64_t duration)
+{
+    std::this_thread::sleep_for(std::chrono::nanoseconds(duration));
+}
+
+void SteadyFrameClock::Spin()
+{
+    std::this_thread::yield();
+}
+
+void SimulatedFrameClock::Sleep(int64_t duration)
+{
+    m_Time += duration + m_Oversleep;
+    m_SleepTime += duration + m_Oversleep;
+}
+
+void SimulatedFrameClock::Spin()
+{
+    m_Time += m_SpinQuantum;
+    m_SpinTime += m_SpinQuantum;
+}
+
+FrameScheduler::FrameScheduler(FrameClock& clock, const FrameSchedulerSettings& settings)
+    : m_Clock(clock)
+    , m_Settings(settings)
+    , m_FixedStep(std::max<int64_t>(ToNanoseconds(settings.FixedStep), 1))
+    , m_FrameCap(ToNanoseconds(settings.FrameCap))
+    , m_SpinTime(ToNanoseconds(settings.SpinTime))
+    , m_Started(false)
+    , m_FrameStart(0)
+    , m_Deadline(0)
+    , m_Accumulator(0)
+    , m_FrameTimes(0.1, 1000)
+{
+    m_Settings.MaxStepsPerFrame = std::max(m_Settings.MaxStepsPerFrame, 1u);
+    ResetStats();
+}
+
+uint32_t FrameScheduler::BeginFrame()
+{
+    const int64_t now = m_Clock.Now();
+    if (!m_Started)
+    {
+        m_Started = true;
+        m_FrameStart = now;
+        m_Deadline = now + m_FrameCap;
+        return 0;
+    }
+
+    const int64_t elapsed = now - m_FrameStart;
+    m_FrameStart = now;
+    m_FrameTimes.Add(elapsed * 1e-6);
+    ++m_FrameCount;
+
+    m_Accumulator += elapsed;
+    int64_t steps = m_Accumulator / m_FixedStep;
+    if (steps > m_Settings.MaxStepsPerFrame)
+    {
+        // Keep the fraction of a step so interpolation stays smooth; only
+        // whole steps are dropped.
+        const int64_t dropped = (steps - m_Settings.MaxStepsPerFrame) * m_FixedStep;
+        m_Accumulator -= dropped;
+        m_DroppedTime += dropped;
+        steps = m_Settings.MaxStepsPerFrame;
+    }
+    m_Accumulator -= steps * m_FixedStep;
+    m_StepCount += steps;
+    return static_cast<uint32_t>(steps);
+}
+
+void FrameScheduler::EndFrame()
+{
+    if (m_FrameCap <= 0 || !m_Started)
+    {
+        return;
+    }
+
+    const int64_t waitStart = m_Clock.Now();
+    int64_t now = waitStart;
+    if (m_Deadline - now > m_SpinTime)
+    {
+        m_Clock.Sleep(m_Deadline - now - m_SpinTime);
+        now = m_Clock.Now();
+    }
+    while (now < m_Deadline)
+    {
+        m_Clock.Spin();
+        now = m_Clock.Now();
+    }
+    m_WaitTime += now - waitStart;
+
+    // Deadlines advance by exactly one cap so oversleeping in one frame is
+    // made up in the next. A frame that misses its deadline by more than a
+    // whole cap starts a new schedule instead of rushing the ones after it.
+    m_Deadline += m_FrameCap;
+    if (m_Deadline < now)
+    {
+        m_Deadline = now + m_FrameCap;
+    }
+}
+
+float FrameScheduler::GetInterpolation() const
+{
+    return static_cast<float>(static_cast<double>(m_Accumulator) / m_FixedStep);
+}
+
+FrameSchedulerStats FrameScheduler::GetStats() const
+{
+    FrameSchedulerStats stats;
+    stats.FrameCount = m_FrameCount;
+    stats.StepCount = m_StepCount;
+    stats.SimulatedTime = m_StepCount * m_FixedStep * 1e-9;
+    stats.DroppedTime = m_DroppedTime * 1e-9;
+    stats.WaitTime = m_WaitTime * 1e-9;
+    return stats;
+}
+
+void FrameScheduler::ResetStats()
+{
+    m_FrameTimes.Reset();
+    m_FrameCount = 0;
+    m_StepCount = 0;
+    m_DroppedTime = 0;
+    m_WaitTime = 0;
+}
@@ -0,0 +1,169 @@
+#include "FrustumCulling.h"
+
+namespace
+{
+    inline XMVECTOR LoadLanes(const std::vector<float>& values, size_t index)
+    {
+        return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&values[index]));
+    }
+
+    // One bit per lane, set when the lane's sign bit is set (i.e. the
+    // comparison that produced it was true).
+    inline unsigned int LaneMask(FXMVECTOR comparison)
+    {
+#if defined(_XM_SSE_INTRINSICS_)
+        return static_cast<unsigned int>(_mm_movemask_ps(comparison));
+#else
+        uint32_t lanes[4];
+        XMStoreInt4(lanes, comparison);
+        return (lanes[0] ? 1u : 0u) | (lanes[1] ? 2u : 0u) | (lanes[2] ? 4u : 0u) | (lanes[3] ? 8u : 0u);
+#endif
+    }
+}
+
+void ExtractFrustumPlanes(FXMMATRIX viewProjection, Frustum& frustum)
+{
+    // With row vectors, clip = v * M, so each clip coordinate is a dot product
+    // with a column of M.
+    const XMMATRIX m = XMMatrixTranspose(viewProjection);
+    const XMVECTOR planes[6] =
+    {
+        m.r[3] + m.r[0],  // Left:   -w <= x
+        m.r[3] - m.r[0],  // Right:   x <= w
+        m.r[3] + m.r[1],  // Bottom: -w <= y
+        m.r[3] - m.r[1],  // Top:     y <= w
+        m.r[2],           // Near:    0 <= z
+        m.r[3] - m.r[2],  // Far:     z <= w
+    };
+
+    for (int i = 0; i < 6; ++i)
+    {
+        // An infinite reversed-Z projection has a constant z, so its 0 <= z
+        // plane is at infinity and has no normal; normalizing it would give
+        // NaNs. Store a plane every point is inside instead.
+        const float w = XMVectorGetW(planes[i]);
+        if (XMVectorGetX(XMVector3LengthSq(planes[i])) <= 1e-12f * w * w)
+        {
+            frustum.Planes[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+            continue;
+        }
+        XMStoreFloat4(&frustum.Planes[i], XMPlaneNormalize(planes[i]));
+    }
+}
+
+void InstanceBoundsSoA::Resize(size_t count)
+{
+    const size_t paddedCount = (count + 3) & ~size_t(3);
+    CenterX.resize(paddedCount, 0.0f);
+    CenterY.resize(paddedCount, 0.0f);
+    CenterZ.resize(paddedCount, 0.0f);
+    ExtentX.resize(paddedCount, 0.0f);
+    ExtentY.resize(paddedCount, 0.0f);
+    ExtentZ.resize(paddedCount, 0.0f);
+    Radius.resize(paddedCount, 0.0f);
+    Count = count;
+}
+
+void ComputeInstanceBounds(const PlaneInstanceData* instances, size_t count,
+    const XMFLOAT3& localCenter, const XMFLOAT3& localExtents, InstanceBoundsSoA& bounds)
+{
+    bounds.Resize(count);
+
+    const XMVECTOR center = XMLoadFloat3(&localCenter);
+    const XMVECTOR extents = XMLoadFloat3(&localExtents);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const XMMATRIX& world = instances[i].WorldMatrix;
+
+        // Arvo's method: the world extents are the local extents transformed by
+        // the absolute value of the upper 3x3.
+        const XMVECTOR worldCenter = XMVector3Transform(center, world);
+        const XMVECTOR worldExtents =
+            XMVectorAbs(world.r[0]) * XMVectorSplatX(extents) +
+            XMVectorAbs(world.r[1]) * XMVectorSplatY(extents) +
+            XMVectorAbs(world.r[2]) * XMVectorSplatZ(extents);
+
+        bounds.CenterX[i] = XMVectorGetX(worldCenter);
+        bounds.CenterY[i] = XMVectorGetY(worldCenter);
+        bounds.CenterZ[i] = XMVectorGetZ(worldCenter);
+        bounds.ExtentX[i] = XMVectorGetX(worldExtents);
+        bounds.ExtentY[i] = XMVectorGetY(worldExtents);
+        bounds.ExtentZ[i] = XMVectorGetZ(worldExtents);
+        bounds.Radius[i] = XMVectorGetX(XMVector3Length(worldExtents));
+    }
+}
+
+size_t CullInstances(const Frustum& frustum, const InstanceBoundsSoA& bounds, CullVolume volume,
+    const PlaneInstanceData* instances, PlaneInstanceData* visibleInstances)
+{
+    // Broadcast each plane once up front.
+    XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+    XMVECTOR absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        const XMVECTOR plane = XMLoadFloat4(&frustum.Planes[p]);
+        planeX[p] = XMVectorSplatX(plane);
+        planeY[p] = XMVectorSplatY(plane);
+        planeZ[p] = XMVectorSplatZ(plane);
+        planeW[p] = XMVectorSplatW(plane);
+        absPlaneX[p] = XMVectorAbs(planeX[p]);
+        absPlaneY[p] = XMVectorAbs(planeY[p]);
+        absPlaneZ[p] = XMVectorAbs(planeZ[p]);
+    }
+
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < bounds.Count; i += 4)
+    {
+        const XMVECTOR centerX = LoadLanes(bounds.CenterX, i);
+        const XMVECTOR centerY = LoadLanes(bounds.CenterY, i);
+        const XMVECTOR centerZ = LoadLanes(bounds.CenterZ, i);
+
+        XMVECTOR radius = XMVectorZero();
+        XMVECTOR extentX = radius, extentY = radius, extentZ = radius;
+        if (volume == CV_Sphere)
+        {
+            radius = LoadLanes(bounds.Radius, i);
+        }
+        else
+        {
+            extentX = LoadLanes(bounds.ExtentX, i);
+            extentY = LoadLanes(bounds.ExtentY, i);
+            extentZ = LoadLanes(bounds.ExtentZ, i);
+        }
+
+        // A lane is culled once it is entirely behind any plane.
+        XMVECTOR outside = XMVectorFalseInt();
+        for (int p = 0; p < 6; ++p)
+        {
+            const XMVECTOR distance = XMVectorMultiplyAdd(centerX, planeX[p],
+                XMVectorMultiplyAdd(centerY, planeY[p], XMVectorMultiplyAdd(centerZ, planeZ[p], planeW[p])));
+
+            if (volume == CV_Box)
+            {
+                // Projected radius of the box onto the plane normal.
+                radius = XMVectorMultiplyAdd(extentX, absPlaneX[p],
+                    XMVectorMultiplyAdd(extentY, absPlaneY[p], XMVectorMultiply(extentZ, absPlaneZ[p])));
+            }
+
+            outside = XMVectorOrInt(outside, XMVectorLess(distance, XMVectorNegate(radius)));
+        }
+
+        // Compact the survivors into the output stream.
+        unsigned int visibleMask = ~LaneMask(outside) & 0xFu;
+        const size_t remaining = bounds.Count - i;
+        if (remaining < 4)
+        {
+            visibleMask &= (1u << remaining) - 1u;
+        }
+
+        while (visibleMask)
+        {
+            const unsigned int lane = (visibleMask & 1u) ? 0u : (visibleMask & 2u) ? 1u : (visibleMask & 4u) ? 2u : 3u;
+            visibleInstances[visibleCount++] = instances[i + lane];
+            visibleMask &= visibleMask - 1u;
+        }
+    }
+
+    return visibleCount;
+}
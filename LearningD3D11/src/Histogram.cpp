@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <cmath>
+#include "Histogram.h"
+
+Histogram::Histogram(double bucketWidth, size_t bucketCount)
+    : m_BucketWidth(bucketWidth)
+    , m_Buckets(bucketCount + 1, 0)
+{
+    Reset();
+}
+
+void Histogram::Add(double value)
+{
+    value = std::max(value, 0.0);
+    const double bucket = value / m_BucketWidth;
+    const size_t overflow = m_Buckets.size() - 1;
+    ++m_Buckets[bucket < overflow ? static_cast<size_t>(bucket) : overflow];
+
+    m_Min = m_Count ? std::min(m_Min, value) : value;
+    m_Max = m_Count ? std::max(m_Max, value) : value;
+    m_Sum += value;
+    ++m_Count;
+}
+
+void Histogram::Reset()
+{
+    std::fill(m_Buckets.begin(), m_Buckets.end(), 0);
+    m_Count = 0;
+    m_Sum = 0.0;
+    m_Min = 0.0;
+    m_Max = 0.0;
+}
+
+double Histogram::GetPercentile(double fraction) const
+{
+    if (m_Count == 0)
+    {
+        return 0.0;
+    }
+
+    // Rank of the sample, 1 based.
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * m_Count)));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket + 1 < m_Buckets.size(); ++bucket)
+    {
+        seen += m_Buckets[bucket];
+        if (seen >= rank)
+        {
+            return std::min(std::max((bucket + 1) * m_BucketWidth, m_Min), m_Max);
+        }
+    }
+    return m_Max;
+}
@@ -0,0 +1,263 @@
+#include "JobSystem.h"
+
+namespace
+{
+    // Idle rounds a worker spins through before it sleeps.
+    const int SpinCount = 64;
+
+    // Set on worker threads only; the creating thread is recognized by id.
+    thread_local const JobSystem* t_System = nullptr;
+    thread_local int t_ThreadIndex = -1;
+
+    uint32_t NextRandom(uint32_t& state)
+    {
+        // xorshift32.
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+}
+
+JobSystem::JobDeque::JobDeque()
+    : m_Top(0)
+    , m_Bottom(0)
+    , m_Jobs(new std::atomic<Job*>[Capacity])
+{
+}
+
+bool JobSystem::JobDeque::Push(Job* job)
+{
+    const int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+    const int64_t top = m_Top.load(std::memory_order_acquire);
+    if (bottom - top >= Capacity)
+    {
+        return false;
+    }
+    m_Jobs[bottom & (Capacity - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+JobSystem::Job* JobSystem::JobDeque::Pop()
+{
+    const int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+    m_Bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_Top.load(std::memory_order_relaxed);
+    if (top > bottom)
+    {
+        // Empty.
+        m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = m_Jobs[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+    if (top == bottom)
+    {
+        // The last job; a thief may be taking it at the same time.
+        if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            job = nullptr;
+        }
+        m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+JobSystem::Job* JobSystem::JobDeque::Steal()
+{
+    int64_t top = m_Top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+    if (top >= bottom)
+    {
+        return nullptr;
+    }
+
+    Job* job = m_Jobs[top & (Capacity - 1)].load(std::memory_order_relaxed);
+    if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+        // Lost the race to the owner or another thief.
+        return nullptr;
+    }
+    return job;
+}
+
+JobSystem::JobSystem(unsigned int threadCount)
+    : m_CreatingThread(std::this_thread::get_id())
+    , m_SharedCount(0)
+    , m_QueuedCount(0)
+    , m_SleepingCount(0)
+    , m_Quit(false)
+    , m_StealCount(0)
+{
+    if (threadCount == 0)
+    {
+        threadCount = GetDefaultThreadCount();
+    }
+    for (unsigned int i = 0; i < threadCount; ++i)
+    {
+        m_Deques.emplace_back(new JobDeque());
+    }
+    m_Workers.reserve(threadCount - 1);
+    for (unsigned int i = 1; i < threadCount; ++i)
+    {
+        m_Workers.emplace_back(&JobSystem::WorkerMain, this, static_cast<int>(i));
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+        m_Quit = true;
+    }
+    m_Wake.notify_all();
+    for (std::thread& worker : m_Workers)
+    {
+        worker.join();
+    }
+}
+
+JobSystem& JobSystem::GetDefault()
+{
+    // Never destroyed, so the workers are not joined while the process exits.
+    static JobSystem* system = new JobSystem();
+    return *system;
+}
+
+int JobSystem::GetThreadIndex() const
+{
+    if (t_System == this)
+    {
+        return t_ThreadIndex;
+    }
+    return std::this_thread::get_id() == m_CreatingThread ? 0 : -1;
+}
+
+void JobSystem::Run(JobFunction function, JobCounter* counter)
+{
+    if (counter)
+    {
+        counter->m_Count.fetch_add(1, std::memory_order_relaxed);
+    }
+    Job* job = new Job{ std::move(function), counter };
+
+    // Counted before it can be taken, so the count never goes below zero.
+    m_QueuedCount.fetch_add(1);
+    const int threadIndex = GetThreadIndex();
+    if (threadIndex < 0 || !m_Deques[threadIndex]->Push(job))
+    {
+        std::lock_guard<std::mutex> lock(m_SharedMutex);
+        m_SharedJobs.push_back(job);
+        m_SharedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // A worker going to sleep counts itself before it checks m_QueuedCount,
+    // so either it sees this job or it is seen here.
+    if (m_SleepingCount.load() != 0)
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+        m_Wake.notify_one();
+    }
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+    const int threadIndex = GetThreadIndex();
+    uint32_t random = static_cast<uint32_t>(threadIndex + 2) * 2654435761u;
+    while (!counter.IsDone())
+    {
+        if (Job* job = FindJob(threadIndex, random))
+        {
+            Execute(job);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+JobSystem::Job* JobSystem::FindJob(int threadIndex, uint32_t& random)
+{
+    Job* job = (threadIndex >= 0) ? m_Deques[threadIndex]->Pop() : nullptr;
+
+    if (!job && m_SharedCount.load(std::memory_order_relaxed) != 0)
+    {
+        std::lock_guard<std::mutex> lock(m_SharedMutex);
+        if (!m_SharedJobs.empty())
+        {
+            job = m_SharedJobs.front();
+            m_SharedJobs.pop_front();
+            m_SharedCount.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Steal, starting from a random thread so thieves spread out.
+    const size_t threadCount = m_Deques.size();
+    const size_t start = NextRandom(random) % threadCount;
+    for (size_t i = 0; !job && i < threadCount; ++i)
+    {
+        const size_t victim = (start + i) % threadCount;
+        if (static_cast<int>(victim) != threadIndex)
+        {
+            job = m_Deques[victim]->Steal();
+            if (job)
+            {
+                m_StealCount.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    if (job)
+    {
+        m_QueuedCount.fetch_sub(1);
+    }
+    return job;
+}
+
+void JobSystem::Execute(Job* job)
+{
+    job->Function();
+
+    // Free the job, and whatever its function captured, before the waiter
+    // can see the count drop.
+    JobCounter* counter = job->Counter;
+    delete job;
+    if (counter)
+    {
+        counter->m_Count.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void JobSystem::WorkerMain(int threadIndex)
+{
+    t_System = this;
+    t_ThreadIndex = threadIndex;
+    uint32_t random = static_cast<uint32_t>(threadIndex + 2) * 2654435761u;
+
+    int idleCount = 0;
+    while (!m_Quit.load(std::memory_order_relaxed))
+    {
+        if (Job* job = FindJob(threadIndex, random))
+        {
+            Execute(job);
+            idleCount = 0;
+        }
+        else if (++idleCount < SpinCount)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::unique_lock<std::mutex> lock(m_SleepMutex);
+            m_SleepingCount.fetch_add(1);
+            m_Wake.wait(lock, [this]() { return m_Quit.load() || m_QueuedCount.load() != 0; });
+            m_SleepingCount.fetch_sub(1);
+            idleCount = 0;
+        }
+    }
+}
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <cfloat>
+#include "LevelOfDetail.h"
+#include "ParallelFor.h"
+
+namespace
+{
+    // Instances per ParallelFor chunk, a multiple of four.
+    const size_t LodChunkSize = 16384;
+
+    // Level k (k >= 1) is switched to once the distance from the eye to an
+    // instance's centre reaches radius * Coarsen[k], and kept while it stays
+    // above radius * Keep[k]. Comparing centre distances against multiples of
+    // the radius lets the batched pass work on squared distances.
+    struct SwitchFactors
+    {
+        float Coarsen[MaxLodCount];
+        float Keep[MaxLodCount];
+        uint32_t LevelCount;
+    };
+
+    SwitchFactors ComputeSwitchFactors(const LodChain& chain, const LodSettings& settings, float lodScale)
+    {
+        // Level k fits when e_k * (r / R) * lodScale / (distance - r) <= threshold,
+        // that is when distance >= r * (1 + e_k * lodScale / (R * threshold)).
+        SwitchFactors factors;
+        factors.LevelCount = chain.LevelCount;
+        factors.Coarsen[0] = factors.Keep[0] = 0.0f;
+        for (uint32_t k = 1; k < chain.LevelCount; ++k)
+        {
+            const float factor = chain.Levels[k].GeometricError * lodScale / (chain.BoundingRadius * settings.PixelErrorThreshold);
+            factors.Coarsen[k] = 1.0f + factor * (1.0f + settings.Hysteresis);
+            factors.Keep[k] = 1.0f + factor * (1.0f - settings.Hysteresis);
+        }
+        return factors;
+    }
+
+    inline XMVECTOR LoadLanes(const std::vector<float>& values, size_t index)
+    {
+        return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&values[index]));
+    }
+
+    inline uint32_t ClampLevel(uint32_t current, uint32_t finest, uint32_t coarsest)
+    {
+        return std::min(std::max(current, finest), coarsest);
+    }
+}
+
+LodChain AppendLodLevels(Mesh& mesh, const Mesh* levels, const float* geometricErrors, uint32_t levelCount)
+{
+    LodChain chain;
+    if (levelCount == 0 || levelCount > MaxLodCount)
+    {
+        return chain;
+    }
+
+    for (uint32_t i = 0; i < levelCount; ++i)
+    {
+        LodLevel& level = chain.Levels[i];
+        level.StartIndex = static_cast<uint32_t>(mesh.Indices.size());
+        level.IndexCount = static_cast<uint32_t>(levels[i].Indices.size());
+        level.BaseVertex = static_cast<int32_t>(mesh.Vertices.size());
+        level.GeometricError = geometricErrors[i];
+
+        // Indices stay relative to the level's own vertices.
+        mesh.Vertices.insert(mesh.Vertices.end(), levels[i].Vertices.begin(), levels[i].Vertices.end());
+        mesh.Indices.insert(mesh.Indices.end(), levels[i].Indices.begin(), levels[i].Indices.end());
+    }
+    chain.LevelCount = levelCount;
+
+    XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+    XMVECTOR maximum = XMVectorReplicate(-FLT_MAX);
+    for (const VertexPosNormColTex& vertex : levels[0].Vertices)
+    {
+        const XMVECTOR position = XMLoadFloat3(&vertex.Position);
+        minimum = XMVectorMin(minimum, position);
+        maximum = XMVectorMax(maximum, position);
+    }
+    if (!levels[0].Vertices.empty())
+    {
+        chain.BoundingRadius = XMVectorGetX(XMVector3Length(0.5f * (maximum - minimum)));
+    }
+    return chain;
+}
+
+float ComputeLodScale(FXMMATRIX projection, float viewportHeight)
+{
+    return 0.5f * viewportHeight * XMVectorGetY(projection.r[1]);
+}
+
+uint32_t SelectLod(const LodChain& chain, const LodSettings& settings, float lodScale,
+    const XMFLOAT3& eye, const XMFLOAT3& center, float radius, uint32_t currentLevel)
+{
+    const SwitchFactors factors = ComputeSwitchFactors(chain, settings, lodScale);
+
+    const float dx = center.x - eye.x;
+    const float dy = center.y - eye.y;
+    const float dz = center.z - eye.z;
+    const float distanceSquared = dx * dx + dy * dy + dz * dz;
+
+    uint32_t finest = 0, coarsest = 0;
+    for (uint32_t k = 1; k < factors.LevelCount; ++k)
+    {
+        const float coarsen = radius * factors.Coarsen[k];
+        const float keep = radius * factors.Keep[k];
+        finest += distanceSquared >= coarsen * coarsen ? 1 : 0;
+        coarsest += distanceSquared >= keep * keep ? 1 : 0;
+    }
+    return ClampLevel(currentLevel, finest, coarsest);
+}
+
+LodSelector::LodSelector()
+    : m_InstanceCount(0)
+{
+    std::fill(m_LevelStarts, m_LevelStarts + MaxLodCount + 1, 0u);
+}
+
+void LodSelector::Reset()
+{
+    std::fill(m_Levels.begin(), m_Levels.end(), static_cast<uint8_t>(0));
+}
+
+void LodSelector::Select(const LodChain& chain, const LodSettings& settings, float lodScale,
+    FXMVECTOR eye, const InstanceBoundsSoA& bounds, unsigned int threadCount)
+{
+    const size_t count = bounds.Count;
+    m_InstanceCount = count;
+    m_Levels.resize(count, 0);
+    m_Instances.resize(count);
+
+    const size_t chunkCount = (count + LodChunkSize - 1) / LodChunkSize;
+    m_ChunkCounts.assign(chunkCount * MaxLodCount, 0);
+
+    const SwitchFactors factors = ComputeSwitchFactors(chain, settings, lodScale);
+    XMVECTOR coarsen[MaxLodCount], keep[MaxLodCount];
+    for (uint32_t k = 1; k < factors.LevelCount; ++k)
+    {
+        coarsen[k] = XMVectorReplicate(factors.Coarsen[k]);
+        keep[k] = XMVectorReplicate(factors.Keep[k]);
+    }
+    const XMVECTOR eyeX = XMVectorSplatX(eye);
+    const XMVECTOR eyeY = XMVectorSplatY(eye);
+    const XMVECTOR eyeZ = XMVectorSplatZ(eye);
+    const XMVECTOR one = XMVectorReplicate(1.0f);
+
+    // Pass 1: the new level of every instance, and how many of each level
+    // every chunk holds.
+    ParallelFor(chunkCount, 1, [&](size_t beginChunk, size_t endChunk)
+    {
+        for (size_t chunk = beginChunk; chunk < endChunk; ++chunk)
+        {
+            uint32_t* chunkCounts = &m_ChunkCounts[chunk * MaxLodCount];
+            const size_t begin = chunk * LodChunkSize;
+            const size_t end = std::min(begin + LodChunkSize, count);
+            for (size_t i = begin; i < end; i += 4)
+            {
+                const XMVECTOR dx = LoadLanes(bounds.CenterX, i) - eyeX;
+                const XMVECTOR dy = LoadLanes(bounds.CenterY, i) - eyeY;
+                const XMVECTOR dz = LoadLanes(bounds.CenterZ, i) - eyeZ;
+                const XMVECTOR distanceSquared = dx * dx + dy * dy + dz * dz;
+                const XMVECTOR radius = LoadLanes(bounds.Radius, i);
+
+                // Count the switch distances passed; the masks are all ones
+                // or zero, so and-ing them with 1.0f adds one per pass.
+                XMVECTOR finest = XMVectorZero();
+                XMVECTOR coarsest = XMVectorZero();
+                for (uint32_t k = 1; k < factors.LevelCount; ++k)
+                {
+                    const XMVECTOR coarsenDistance = radius * coarsen[k];
+                    const XMVECTOR keepDistance = radius * keep[k];
+                    finest += XMVectorAndInt(XMVectorGreaterOrEqual(distanceSquared, coarsenDistance * coarsenDistance), one);
+                    coarsest += XMVectorAndInt(XMVectorGreaterOrEqual(distanceSquared, keepDistance * keepDistance), one);
+                }
+
+                XMFLOAT4 finestLanes, coarsestLanes;
+                XMStoreFloat4(&finestLanes, finest);
+                XMStoreFloat4(&coarsestLanes, coarsest);
+                const float* finestLane = &finestLanes.x;
+                const float* coarsestLane = &coarsestLanes.x;
+                const size_t laneCount = std::min<size_t>(4, end - i);
+                for (size_t lane = 0; lane < laneCount; ++lane)
+                {
+                    const uint32_t level = ClampLevel(m_Levels[i + lane],
+                        static_cast<uint32_t>(finestLane[lane]), static_cast<uint32_t>(coarsestLane[lane]));
+                    m_Levels[i + lane] = static_cast<uint8_t>(level);
+                    chunkCounts[level]++;
+                }
+            }
+        }
+    }, threadCount);
+
+    // Turn the counts into the position of each chunk's first instance of
+    // every level, levels first so each level's instances are contiguous.
+    uint32_t offset = 0;
+    for (uint32_t level = 0; level < MaxLodCount; ++level)
+    {
+        m_LevelStarts[level] = offset;
+        for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+        {
+            uint32_t& slot = m_ChunkCounts[chunk * MaxLodCount + level];
+            const uint32_t levelCount = slot;
+            slot = offset;
+            offset += levelCount;
+        }
+    }
+    m_LevelStarts[MaxLodCount] = offset;
+
+    // Pass 2: scatter the instance indices. Chunks write disjoint ranges and
+    // keep instance order within a level.
+    ParallelFor(chunkCount, 1, [&](size_t beginChunk, size_t endChunk)
+    {
+        for (size_t chunk = beginChunk; chunk < endChunk; ++chunk)
+        {
+            uint32_t* cursors = &m_ChunkCounts[chunk * MaxLodCount];
+            const size_t begin = chunk * LodChunkSize;
+            const size_t end = std::min(begin + LodChunkSize, count);
+            for (size_t i = begin; i < end; ++i)
+            {
+                m_Instances[cursors[m_Levels[i]]++] = static_cast<uint32_t>(i);
+            }
+        }
+    }, threadCount);
+}
@@ -0,0 +1,589 @@
+#include "Lighting.h"
+#include <algorithm>
+#include <cmath>
+#if defined(_XM_AVX2_INTRINSICS_)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Scalar versions of the Lighting.hlsli helpers, argument for argument.
+
+    float DoAttenuation(const Light& light, float distance)
+    {
+        return 1.0f / (light.ConstantAttenuation +
+            light.LinearAttenuation * distance +
+            light.QuadraticAttenuation * distance * distance);
+    }
+
+    float SmoothStep(float minValue, float maxValue, float x)
+    {
+        const float t = std::min(std::max((x - minValue) / (maxValue - minValue), 0.0f), 1.0f);
+        return t * t * (3.0f - 2.0f * t);
+    }
+
+    float DoSpotCone(const Light& light, FXMVECTOR surfaceToLightVector)
+    {
+        const float minCos = std::cos(light.SpotAngle);
+        const float maxCos = GetSpotMaxCos(minCos);
+        const XMVECTOR direction = XMVector3Normalize(XMVectorSetW(XMLoadFloat4(&light.Direction), 0.0f));
+        const float cosAngle = XMVectorGetX(XMVector3Dot(direction, -surfaceToLightVector));
+        return SmoothStep(minCos, maxCos, cosAngle);
+    }
+
+    float DoDiffuse(FXMVECTOR surfaceToLightVector, FXMVECTOR normal)
+    {
+        return std::max(0.0f, XMVectorGetX(XMVector3Dot(surfaceToLightVector, normal)));
+    }
+
+    float DoSpecular(FXMVECTOR surfaceToLightVector, FXMVECTOR eyeVector, FXMVECTOR normal, int phongMode, float specularPower)
+    {
+        if (phongMode == PhongShading)
+        {
+            // HLSL reflect(i, n) = i - 2 * dot(i, n) * n
+            const XMVECTOR reflectedLightVector = XMVector3Normalize(XMVector3Reflect(surfaceToLightVector, normal));
+            return std::pow(std::max(0.0f, XMVectorGetX(XMVector3Dot(eyeVector, reflectedLightVector))), specularPower);
+        }
+        else
+        {
+            const XMVECTOR halfAngleVector = XMVector3Normalize(surfaceToLightVector + eyeVector);
+            return std::pow(std::max(0.0f, XMVectorGetX(XMVector3Dot(normal, halfAngleVector))), specularPower);
+        }
+    }
+
+    // 4-wide helpers. Each XMVECTOR holds one component for four points.
+
+    struct Vector3x4
+    {
+        XMVECTOR X, Y, Z;
+    };
+
+    inline XMVECTOR Dot(const Vector3x4& a, const Vector3x4& b)
+    {
+        return XMVectorMultiplyAdd(a.X, b.X, XMVectorMultiplyAdd(a.Y, b.Y, XMVectorMultiply(a.Z, b.Z)));
+    }
+
+    inline Vector3x4 Scale(const Vector3x4& v, FXMVECTOR s)
+    {
+        Vector3x4 result = { XMVectorMultiply(v.X, s), XMVectorMultiply(v.Y, s), XMVectorMultiply(v.Z, s) };
+        return result;
+    }
+
+    inline Vector3x4 Normalize(const Vector3x4& v)
+    {
+        return Scale(v, XMVectorReciprocalSqrt(Dot(v, v)));
+    }
+
+    inline XMVECTOR SmoothStep4(FXMVECTOR minValue, FXMVECTOR maxValue, FXMVECTOR x)
+    {
+        const XMVECTOR t = XMVectorSaturate(XMVectorDivide(XMVectorSubtract(x, minValue), XMVectorSubtract(maxValue, minValue)));
+        return XMVectorMultiply(XMVectorMultiply(t, t), XMVectorNegativeMultiplySubtract(XMVectorReplicate(2.0f), t, XMVectorReplicate(3.0f)));
+    }
+
+    // Load four AoS float3 values and transpose them into SoA lanes.
+    inline Vector3x4 LoadTransposed(const XMFLOAT3* values)
+    {
+        XMMATRIX m(XMLoadFloat3(&values[0]), XMLoadFloat3(&values[1]), XMLoadFloat3(&values[2]), XMLoadFloat3(&values[3]));
+        m = XMMatrixTranspose(m);
+        Vector3x4 result = { m.r[0], m.r[1], m.r[2] };
+        return result;
+    }
+
+    struct LightingAccumulator
+    {
+        XMVECTOR Diffuse[4];
+        XMVECTOR Specular[4];
+    };
+
+    // Evaluate every light for Lanes groups of four points. Looping over the
+    // groups inside the light loop amortizes the light broadcasts.
+    template<int Lanes>
+    void ComputeLightingLanes(const LightListSoA& lights, float specularPower,
+        const XMFLOAT3* positions, const XMFLOAT3* normals, LightingResult* results)
+    {
+        const XMVECTOR zero = XMVectorZero();
+        const XMVECTOR power = XMVectorReplicate(specularPower);
+        const Vector3x4 eyeVector = {
+            XMVectorReplicate(lights.EyeVectorX), XMVectorReplicate(lights.EyeVectorY), XMVectorReplicate(lights.EyeVectorZ) };
+
+        Vector3x4 P[Lanes], N[Lanes], R[Lanes];
+        LightingAccumulator accumulator[Lanes];
+
+        for (int lane = 0; lane < Lanes; ++lane)
+        {
+            P[lane] = LoadTransposed(positions + lane * 4);
+            N[lane] = LoadTransposed(normals + lane * 4);
+
+            // The reflection in DoSpecular's Phong term does not depend on
+            // the light: normalize(reflect(eyeVector, normal)).
+            const XMVECTOR twoDotEN = XMVectorScale(Dot(eyeVector, N[lane]), 2.0f);
+            const Vector3x4 reflected = {
+                XMVectorNegativeMultiplySubtract(twoDotEN, N[lane].X, eyeVector.X),
+                XMVectorNegativeMultiplySubtract(twoDotEN, N[lane].Y, eyeVector.Y),
+                XMVectorNegativeMultiplySubtract(twoDotEN, N[lane].Z, eyeVector.Z) };
+            R[lane] = Normalize(reflected);
+
+            for (int c = 0; c < 4; ++c)
+            {
+                accumulator[lane].Diffuse[c] = zero;
+                accumulator[lane].Specular[c] = zero;
+            }
+        }
+
+        for (uint32_t i = 0; i < lights.LightCount; ++i)
+        {
+            const int lightType = lights.LightType[i];
+            const XMVECTOR color[4] = {
+                XMVectorReplicate(lights.ColorR[i]), XMVectorReplicate(lights.ColorG[i]),
+                XMVectorReplicate(lights.ColorB[i]), XMVectorReplicate(lights.ColorA[i]) };
+            const Vector3x4 lightPosition = {
+                XMVectorReplicate(lights.PositionX[i]), XMVectorReplicate(lights.PositionY[i]), XMVectorReplicate(lights.PositionZ[i]) };
+            const Vector3x4 lightDirection = {
+                XMVectorReplicate(lights.DirectionX[i]), XMVectorReplicate(lights.DirectionY[i]), XMVectorReplicate(lights.DirectionZ[i]) };
+            const XMVECTOR constantAttenuation = XMVectorReplicate(lights.ConstantAttenuation[i]);
+            const XMVECTOR linearAttenuation = XMVectorReplicate(lights.LinearAttenuation[i]);
+            const XMVECTOR quadraticAttenuation = XMVectorReplicate(lights.QuadraticAttenuation[i]);
+            const XMVECTOR spotMinCos = XMVectorReplicate(lights.SpotMinCos[i]);
+            const XMVECTOR spotMaxCos = XMVectorReplicate(lights.SpotMaxCos[i]);
+
+            for (int lane = 0; lane < Lanes; ++lane)
+            {
+                Vector3x4 L;
+                XMVECTOR intensity;
+
+                if (lightType == DirectionalLight)
+                {
+                    L.X = XMVectorNegate(lightDirection.X);
+                    L.Y = XMVectorNegate(lightDirection.Y);
+                    L.Z = XMVectorNegate(lightDirection.Z);
+                    intensity = XMVectorSplatOne();
+                }
+                else
+                {
+                    L.X = XMVectorSubtract(lightPosition.X, P[lane].X);
+                    L.Y = XMVectorSubtract(lightPosition.Y, P[lane].Y);
+                    L.Z = XMVectorSubtract(lightPosition.Z, P[lane].Z);
+
+                    const XMVECTOR distanceSq = Dot(L, L);
+                    const XMVECTOR invDistance = XMVectorReciprocalSqrt(distanceSq);
+                    const XMVECTOR distance = XMVectorMultiply(distanceSq, invDistance);
+                    L = Scale(L, invDistance);
+
+                    // DoAttenuation
+                    intensity = XMVectorReciprocal(XMVectorMultiplyAdd(
+                        XMVectorMultiplyAdd(quadraticAttenuation, distance, linearAttenuation), distance, constantAttenuation));
+
+                    if (lightType == SpotLight)
+                    {
+                        // DoSpotCone
+                        const XMVECTOR cosAngle = XMVectorNegate(Dot(lightDirection, L));
+                        intensity = XMVectorMultiply(intensity, SmoothStep4(spotMinCos, spotMaxCos, cosAngle));
+                    }
+                }
+
+                // DoDiffuse
+                const XMVECTOR diffuse = XMVectorMultiply(XMVectorMax(zero, Dot(L, N[lane])), intensity);
+
+                // DoSpecular
+                XMVECTOR specularBase;
+                if (lights.PhongShadingMode == PhongShading)
+                {
+                    specularBase = XMVectorMax(zero, Dot(L, R[lane]));
+                }
+                else
+                {
+                    Vector3x4 H = { XMVectorAdd(eyeVector.X, L.X), XMVectorAdd(eyeVector.Y, L.Y), XMVectorAdd(eyeVector.Z, L.Z) };
+                    specularBase = XMVectorMax(zero, Dot(N[lane], Normalize(H)));
+                }
+                const XMVECTOR specular = XMVectorMultiply(XMVectorPow(specularBase, power), intensity);
+
+                for (int c = 0; c < 4; ++c)
+                {
+                    accumulator[lane].Diffuse[c] = XMVectorMultiplyAdd(color[c], diffuse, accumulator[lane].Diffuse[c]);
+                    accumulator[lane].Specular[c] = XMVectorMultiplyAdd(color[c], specular, accumulator[lane].Specular[c]);
+                }
+            }
+        }
+
+        // Transpose back to one LightingResult per point.
+        for (int lane = 0; lane < Lanes; ++lane)
+        {
+            const XMMATRIX diffuse = XMMatrixTranspose(XMMATRIX(
+                XMVectorSaturate(accumulator[lane].Diffuse[0]), XMVectorSaturate(accumulator[lane].Diffuse[1]),
+                XMVectorSaturate(accumulator[lane].Diffuse[2]), XMVectorSaturate(accumulator[lane].Diffuse[3])));
+            const XMMATRIX specular = XMMatrixTranspose(XMMATRIX(
+                XMVectorSaturate(accumulator[lane].Specular[0]), XMVectorSaturate(accumulator[lane].Specular[1]),
+                XMVectorSaturate(accumulator[lane].Specular[2]), XMVectorSaturate(accumulator[lane].Specular[3])));
+
+            for (int p = 0; p < 4; ++p)
+            {
+                XMStoreFloat4(&results[lane * 4 + p].Diffuse, diffuse.r[p]);
+                XMStoreFloat4(&results[lane * 4 + p].Specular, specular.r[p]);
+            }
+        }
+    }
+
+#if defined(_XM_AVX2_INTRINSICS_)
+    // 8-wide helpers for the AVX2 build. XMVECTOR stays 4-wide there, so
+    // these use AVX registers directly; each __m256 holds one component for
+    // eight points.
+
+    struct Vector3x8
+    {
+        __m256 X, Y, Z;
+    };
+
+    inline __m256 Dot(const Vector3x8& a, const Vector3x8& b)
+    {
+        return _mm256_fmadd_ps(a.X, b.X, _mm256_fmadd_ps(a.Y, b.Y, _mm256_mul_ps(a.Z, b.Z)));
+    }
+
+    inline Vector3x8 Scale(const Vector3x8& v, __m256 s)
+    {
+        Vector3x8 result = { _mm256_mul_ps(v.X, s), _mm256_mul_ps(v.Y, s), _mm256_mul_ps(v.Z, s) };
+        return result;
+    }
+
+    inline Vector3x8 Normalize(const Vector3x8& v)
+    {
+        return Scale(v, _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(Dot(v, v))));
+    }
+
+    inline __m256 SmoothStep8(__m256 minValue, __m256 maxValue, __m256 x)
+    {
+        __m256 t = _mm256_div_ps(_mm256_sub_ps(x, minValue), _mm256_sub_ps(maxValue, minValue));
+        t = _mm256_min_ps(_mm256_max_ps(t, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+        return _mm256_mul_ps(_mm256_mul_ps(t, t), _mm256_fnmadd_ps(_mm256_set1_ps(2.0f), t, _mm256_set1_ps(3.0f)));
+    }
+
+    // Natural logarithm of positive x (Cephes logf, within 2 ulp).
+    inline __m256 Log8(__m256 x)
+    {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256i bits = _mm256_castps_si256(x);
+        __m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+        // Mantissa in [0.5, 1), then shifted to [sqrt(0.5), sqrt(2)) - 1.
+        __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F000000)));
+        const __m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OQ);
+        exponent = _mm256_sub_ps(exponent, _mm256_and_ps(small, one));
+        m = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(small, m)), one);
+
+        const __m256 z = _mm256_mul_ps(m, m);
+        __m256 y = _mm256_set1_ps(7.0376836292e-2f);
+        y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.1514610310e-1f));
+        y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(1.1676998740e-1f));
+        y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.2420140846e-1f));
+        y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(1.4249322787e-1f));
+        y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.6668057665e-1f));
+        y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(2.0000714765e-1f));
+        y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-2.4999993993e-1f));
+        y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(3.3333331174e-1f));
+        y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+        y = _mm256_fmadd_ps(exponent, _mm256_set1_ps(-2.12194440e-4f), y);
+        y = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, y);
+        return _mm256_fmadd_ps(exponent, _mm256_set1_ps(0.693359375f), _mm256_add_ps(m, y));
+    }
+
+    // e^x (Cephes expf). Underflows to 0 below -87.
+    inline __m256 Exp8(__m256 x)
+    {
+        const __m256 underflow = _mm256_cmp_ps(x, _mm256_set1_ps(-87.0f), _CMP_LT_OQ);
+        x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.0f)), _mm256_set1_ps(88.0f));
+
+        const __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        x = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+        x = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), x);
+
+        const __m256 z = _mm256_mul_ps(x, x);
+        __m256 y = _mm256_set1_ps(1.9875691500e-4f);
+        y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507e-3f));
+        y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073e-3f));
+        y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894e-2f));
+        y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459e-1f));
+        y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201e-1f));
+        y = _mm256_add_ps(_mm256_fmadd_ps(y, z, x), _mm256_set1_ps(1.0f));
+
+        const __m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+        return _mm256_andnot_ps(underflow, _mm256_mul_ps(y, _mm256_castsi256_ps(scale)));
+    }
+
+    // pow for the specular term: base >= 0, and pow(0, power) = 0.
+    inline __m256 Pow8(__m256 base, __m256 power)
+    {
+        const __m256 positive = _mm256_cmp_ps(base, _mm256_setzero_ps(), _CMP_GT_OQ);
+        const __m256 safeBase = _mm256_blendv_ps(_mm256_set1_ps(1.0f), base, positive);
+        return _mm256_and_ps(positive, Exp8(_mm256_mul_ps(power, Log8(safeBase))));
+    }
+
+    // Load eight AoS float3 values into SoA lanes.
+    inline Vector3x8 LoadTransposed8(const XMFLOAT3* values)
+    {
+        const float* components = &values[0].x;
+        const __m256i offsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+        Vector3x8 result = {
+            _mm256_i32gather_ps(components, offsets, 4),
+            _mm256_i32gather_ps(components + 1, offsets, 4),
+            _mm256_i32gather_ps(components + 2, offsets, 4) };
+        return result;
+    }
+
+    // As ComputeLightingLanes, for Lanes groups of eight points.
+    template<int Lanes>
+    void ComputeLightingLanes8(const LightListSoA& lights, float specularPower,
+        const XMFLOAT3* positions, const XMFLOAT3* normals, LightingResult* results)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 power = _mm256_set1_ps(specularPower);
+        const Vector3x8 eyeVector = {
+            _mm256_set1_ps(lights.EyeVectorX), _mm256_set1_ps(lights.EyeVectorY), _mm256_set1_ps(lights.EyeVectorZ) };
+
+        Vector3x8 P[Lanes], N[Lanes], R[Lanes];
+        __m256 diffuseSum[Lanes][4], specularSum[Lanes][4];
+
+        for (int lane = 0; lane < Lanes; ++lane)
+        {
+            P[lane] = LoadTransposed8(positions + lane * 8);
+            N[lane] = LoadTransposed8(normals + lane * 8);
+
+            const __m256 twoDotEN = _mm256_mul_ps(Dot(eyeVector, N[lane]), _mm256_set1_ps(2.0f));
+            const Vector3x8 reflected = {
+                _mm256_fnmadd_ps(twoDotEN, N[lane].X, eyeVector.X),
+                _mm256_fnmadd_ps(twoDotEN, N[lane].Y, eyeVector.Y),
+                _mm256_fnmadd_ps(twoDotEN, N[lane].Z, eyeVector.Z) };
+            R[lane] = Normalize(reflected);
+
+            for (int c = 0; c < 4; ++c)
+            {
+                diffuseSum[lane][c] = zero;
+                specularSum[lane][c] = zero;
+            }
+        }
+
+        for (uint32_t i = 0; i < lights.LightCount; ++i)
+        {
+            const int lightType = lights.LightType[i];
+            const __m256 color[4] = {
+                _mm256_set1_ps(lights.ColorR[i]), _mm256_set1_ps(lights.ColorG[i]),
+                _mm256_set1_ps(lights.ColorB[i]), _mm256_set1_ps(lights.ColorA[i]) };
+            const Vector3x8 lightPosition = {
+                _mm256_set1_ps(lights.PositionX[i]), _mm256_set1_ps(lights.PositionY[i]), _mm256_set1_ps(lights.PositionZ[i]) };
+            const Vector3x8 lightDirection = {
+                _mm256_set1_ps(lights.DirectionX[i]), _mm256_set1_ps(lights.DirectionY[i]), _mm256_set1_ps(lights.DirectionZ[i]) };
+            const __m256 constantAttenuation = _mm256_set1_ps(lights.ConstantAttenuation[i]);
+            const __m256 linearAttenuation = _mm256_set1_ps(lights.LinearAttenuation[i]);
+            const __m256 quadraticAttenuation = _mm256_set1_ps(lights.QuadraticAttenuation[i]);
+            const __m256 spotMinCos = _mm256_set1_ps(lights.SpotMinCos[i]);
+            const __m256 spotMaxCos = _mm256_set1_ps(lights.SpotMaxCos[i]);
+
+            for (int lane = 0; lane < Lanes; ++lane)
+            {
+                Vector3x8 L;
+                __m256 intensity;
+
+                if (lightType == DirectionalLight)
+                {
+                    L.X = _mm256_sub_ps(zero, lightDirection.X);
+                    L.Y = _mm256_sub_ps(zero, lightDirection.Y);
+                    L.Z = _mm256_sub_ps(zero, lightDirection.Z);
+                    intensity = one;
+                }
+                else
+                {
+                    L.X = _mm256_sub_ps(lightPosition.X, P[lane].X);
+                    L.Y = _mm256_sub_ps(lightPosition.Y, P[lane].Y);
+                    L.Z = _mm256_sub_ps(lightPosition.Z, P[lane].Z);
+
+                    const __m256 distance = _mm256_sqrt_ps(Dot(L, L));
+                    L = Scale(L, _mm256_div_ps(one, distance));
+
+                    // DoAttenuation
+                    intensity = _mm256_div_ps(one, _mm256_fmadd_ps(
+                        _mm256_fmadd_ps(quadraticAttenuation, distance, linearAttenuation), distance, constantAttenuation));
+
+                    if (lightType == SpotLight)
+                    {
+                        // DoSpotCone
+                        const __m256 cosAngle = _mm256_sub_ps(zero, Dot(lightDirection, L));
+                        intensity = _mm256_mul_ps(intensity, SmoothStep8(spotMinCos, spotMaxCos, cosAngle));
+                    }
+                }
+
+                // DoDiffuse
+                const __m256 diffuse = _mm256_mul_ps(_mm256_max_ps(zero, Dot(L, N[lane])), intensity);
+
+                // DoSpecular
+                __m256 specularBase;
+                if (lights.PhongShadingMode == PhongShading)
+                {
+                    specularBase = _mm256_max_ps(zero, Dot(L, R[lane]));
+                }
+                else
+                {
+                    Vector3x8 H = { _mm256_add_ps(eyeVector.X, L.X), _mm256_add_ps(eyeVector.Y, L.Y), _mm256_add_ps(eyeVector.Z, L.Z) };
+                    specularBase = _mm256_max_ps(zero, Dot(N[lane], Normalize(H)));
+                }
+                const __m256 specular = _mm256_mul_ps(Pow8(specularBase, power), intensity);
+
+                for (int c = 0; c < 4; ++c)
+                {
+                    diffuseSum[lane][c] = _mm256_fmadd_ps(color[c], diffuse, diffuseSum[lane][c]);
+                    specularSum[lane][c] = _mm256_fmadd_ps(color[c], specular, specularSum[lane][c]);
+                }
+            }
+        }
+
+        // Saturate and write one LightingResult per point.
+        for (int lane = 0; lane < Lanes; ++lane)
+        {
+            alignas(32) float diffuse[4][8];
+            alignas(32) float specular[4][8];
+            for (int c = 0; c < 4; ++c)
+            {
+                _mm256_store_ps(diffuse[c], _mm256_min_ps(_mm256_max_ps(diffuseSum[lane][c], zero), one));
+                _mm256_store_ps(specular[c], _mm256_min_ps(_mm256_max_ps(specularSum[lane][c], zero), one));
+            }
+            for (int p = 0; p < 8; ++p)
+            {
+                results[lane * 8 + p].Diffuse = XMFLOAT4(diffuse[0][p], diffuse[1][p], diffuse[2][p], diffuse[3][p]);
+                results[lane * 8 + p].Specular = XMFLOAT4(specular[0][p], specular[1][p], specular[2][p], specular[3][p]);
+            }
+        }
+    }
+#endif
+}
+
+void TransposeLights(const LightProperties& lightProperties, LightListSoA& lights)
+{
+    lights.LightCount = 0;
+    for (int i = 0; i < MAX_LIGHTS; ++i)
+    {
+        const Light& light = lightProperties.Lights[i];
+        if (!light.Enabled)
+        {
+            continue;
+        }
+
+        // The shader normalizes the direction wherever it uses it.
+        XMFLOAT3 direction;
+        XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSetW(XMLoadFloat4(&light.Direction), 0.0f)));
+
+        const uint32_t n = lights.LightCount++;
+        lights.PositionX[n] = light.Position.x;
+        lights.PositionY[n] = light.Position.y;
+        lights.PositionZ[n] = light.Position.z;
+        lights.DirectionX[n] = direction.x;
+        lights.DirectionY[n] = direction.y;
+        lights.DirectionZ[n] = direction.z;
+        lights.ColorR[n] = light.Color.x;
+        lights.ColorG[n] = light.Color.y;
+        lights.ColorB[n] = light.Color.z;
+        lights.ColorA[n] = light.Color.w;
+        lights.SpotMinCos[n] = std::cos(light.SpotAngle);
+        lights.SpotMaxCos[n] = GetSpotMaxCos(lights.SpotMinCos[n]);
+        lights.ConstantAttenuation[n] = light.ConstantAttenuation;
+        lights.LinearAttenuation[n] = light.LinearAttenuation;
+        lights.QuadraticAttenuation[n] = light.QuadraticAttenuation;
+        lights.LightType[n] = light.LightType;
+    }
+
+    lights.EyeVectorX = lightProperties.EyePosition.x;
+    lights.EyeVectorY = lightProperties.EyePosition.y;
+    lights.EyeVectorZ = lightProperties.EyePosition.z;
+    lights.PhongShadingMode = lightProperties.PhongShadingMode;
+}
+
+LightingResult ComputeLightingScalar(const LightProperties& lightProperties, float specularPower,
+    const XMFLOAT3& position, const XMFLOAT3& normal)
+{
+    const XMVECTOR P = XMLoadFloat3(&position);
+    const XMVECTOR N = XMLoadFloat3(&normal);
+    const XMVECTOR eyeVector = XMVectorSetW(XMLoadFloat4(&lightProperties.EyePosition), 0.0f);
+
+    XMVECTOR totalDiffuse = XMVectorZero();
+    XMVECTOR totalSpecular = XMVectorZero();
+
+    for (int i = 0; i < MAX_LIGHTS; ++i)
+    {
+        const Light& light = lightProperties.Lights[i];
+        if (!light.Enabled)
+        {
+            continue;
+        }
+
+        XMVECTOR surfaceToLightVector;
+        float attenuation = 1.0f;
+
+        if (light.LightType == DirectionalLight)
+        {
+            // DoDirectionalLight
+            surfaceToLightVector = -XMVector3Normalize(XMVectorSetW(XMLoadFloat4(&light.Direction), 0.0f));
+        }
+        else
+        {
+            // DoPointLight and DoSpotLight
+            surfaceToLightVector = XMVectorSetW(XMLoadFloat4(&light.Position), 0.0f) - P;
+            const float distance = XMVectorGetX(XMVector3Length(surfaceToLightVector));
+            surfaceToLightVector = surfaceToLightVector / distance;
+
+            attenuation = DoAttenuation(light, distance);
+            if (light.LightType == SpotLight)
+            {
+                attenuation *= DoSpotCone(light, surfaceToLightVector);
+            }
+        }
+
+        const XMVECTOR color = XMLoadFloat4(&light.Color);
+        totalDiffuse += color * (DoDiffuse(surfaceToLightVector, N) * attenuation);
+        // The shader passes the eye and light vectors in this order; keep it so
+        // the output matches the GPU.
+        totalSpecular += color * (DoSpecular(eyeVector, surfaceToLightVector, N, lightProperties.PhongShadingMode, specularPower) * attenuation);
+    }
+
+    LightingResult result;
+    XMStoreFloat4(&result.Diffuse, XMVectorSaturate(totalDiffuse));
+    XMStoreFloat4(&result.Specular, XMVectorSaturate(totalSpecular));
+    return result;
+}
+
+void ComputeLighting(const LightListSoA& lights, float specularPower,
+    const XMFLOAT3* positions, const XMFLOAT3* normals, size_t count, LightingResult* results)
+{
+    size_t i = 0;
+#if defined(_XM_AVX2_INTRINSICS_)
+    for (; i + 16 <= count; i += 16)
+    {
+        ComputeLightingLanes8<2>(lights, specularPower, positions + i, normals + i, results + i);
+    }
+    for (; i + 8 <= count; i += 8)
+    {
+        ComputeLightingLanes8<1>(lights, specularPower, positions + i, normals + i, results + i);
+    }
+#else
+    for (; i + 16 <= count; i += 16)
+    {
+        ComputeLightingLanes<4>(lights, specularPower, positions + i, normals + i, results + i);
+    }
+#endif
+    for (; i + 4 <= count; i += 4)
+    {
+        ComputeLightingLanes<1>(lights, specularPower, positions + i, normals + i, results + i);
+    }
+
+    if (i < count)
+    {
+        // Pad the tail out to a full lane by repeating the last point.
+        XMFLOAT3 tailPositions[4];
+        XMFLOAT3 tailNormals[4];
+        LightingResult tailResults[4];
+        for (size_t j = 0; j < 4; ++j)
+        {
+            const size_t source = std::min(i + j, count - 1);
+            tailPositions[j] = positions[source];
+            tailNormals[j] = normals[source];
+        }
+
+        ComputeLightingLanes<1>(lights, specularPower, tailPositions, tailNormals, tailResults);
+        std::copy(tailResults, tailResults + (count - i), results + i);
+    }
+}
@@ -0,0 +1,178 @@
+#include "MappedFile.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+std::wstring WidenPath(const char* fileName)
+{
+    const int length = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, fileName, -1, nullptr, 0);
+    if (length <= 0)
+    {
+        return std::wstring();
+    }
+    std::wstring wideFileName(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, fileName, -1, &wideFileName[0], length);
+    wideFileName.resize(length - 1);
+    return wideFileName;
+}
+
+FILE* OpenFile(const char* fileName, const char* mode)
+{
+    const std::wstring wideFileName = WidenPath(fileName);
+    const std::wstring wideMode = WidenPath(mode);
+    FILE* file = nullptr;
+    if (wideFileName.empty() || _wfopen_s(&file, wideFileName.c_str(), wideMode.c_str()) != 0)
+    {
+        return nullptr;
+    }
+    return file;
+}
+
+bool RemoveFile(const char* fileName)
+{
+    const std::wstring wideFileName = WidenPath(fileName);
+    return !wideFileName.empty() && _wremove(wideFileName.c_str()) == 0;
+}
+
+bool SeekFile(FILE* file, uint64_t offset)
+{
+    return _fseeki64(file, static_cast<int64_t>(offset), SEEK_SET) == 0;
+}
+#else
+FILE* OpenFile(const char* fileName, const char* mode)
+{
+    return std::fopen(fileName, mode);
+}
+
+bool RemoveFile(const char* fileName)
+{
+    return std::remove(fileName) == 0;
+}
+
+bool SeekFile(FILE* file, uint64_t offset)
+{
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+}
+#endif
+
+MappedFile::MappedFile()
+#ifdef _WIN32
+    : m_FileHandle(INVALID_HANDLE_VALUE)
+    , m_MappingHandle(nullptr)
+    , m_Data(nullptr)
+#else
+    : m_Data(nullptr)
+#endif
+    , m_Size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const char* fileName, FileAccessPattern access)
+{
+    Close();
+
+    const std::wstring wideFileName = WidenPath(fileName);
+    const DWORD accessFlag = (access == FAP_Sequential) ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+    m_FileHandle = CreateFileW(wideFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | accessFlag, nullptr);
+    if (m_FileHandle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_FileHandle, &fileSize) || fileSize.QuadPart <= 0)
+    {
+        Close();
+        return false;
+    }
+
+    m_MappingHandle = CreateFileMappingW(m_FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_MappingHandle)
+    {
+        Close();
+        return false;
+    }
+    m_Data = static_cast<const uint8_t*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!m_Data)
+    {
+        Close();
+        return false;
+    }
+    m_Size = static_cast<uint64_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data)
+    {
+        UnmapViewOfFile(m_Data);
+        m_Data = nullptr;
+    }
+    if (m_MappingHandle)
+    {
+        CloseHandle(m_MappingHandle);
+        m_MappingHandle = nullptr;
+    }
+    if (m_FileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_FileHandle);
+        m_FileHandle = INVALID_HANDLE_VALUE;
+    }
+    m_Size = 0;
+}
+#else
+bool MappedFile::Open(const char* fileName, FileAccessPattern access)
+{
+    Close();
+
+    const int fileDescriptor = open(fileName, O_RDONLY | O_CLOEXEC);
+    if (fileDescriptor < 0)
+    {
+        return false;
+    }
+
+    // The mapping keeps the file referenced, so the descriptor is not needed
+    // past this point.
+    struct stat status;
+    void* data = MAP_FAILED;
+    if (fstat(fileDescriptor, &status) == 0 && status.st_size > 0)
+    {
+        data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    }
+    close(fileDescriptor);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    posix_madvise(data, static_cast<size_t>(status.st_size),
+        (access == FAP_Sequential) ? POSIX_MADV_SEQUENTIAL : POSIX_MADV_RANDOM);
+    m_Data = static_cast<const uint8_t*>(data);
+    m_Size = static_cast<uint64_t>(status.st_size);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data)
+    {
+        munmap(const_cast<uint8_t*>(m_Data), static_cast<size_t>(m_Size));
+        m_Data = nullptr;
+    }
+    m_Size = 0;
+}
+#endif
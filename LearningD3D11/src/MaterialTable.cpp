@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <cassert>
+#include "MaterialTable.h"
+
+static_assert(sizeof(MaterialProperties) == 80, "MaterialProperties must match the HLSL structured buffer stride.");
+
+uint32_t MaterialTable::Add(const MaterialProperties& material)
+{
+    const uint32_t index = GetCount();
+    m_Materials.push_back(material);
+    MarkDirty(index);
+    return index;
+}
+
+void MaterialTable::Set(uint32_t index, const MaterialProperties& material)
+{
+    assert(index < GetCount());
+    m_Materials[index] = material;
+    MarkDirty(index);
+}
+
+void MaterialTable::Clear()
+{
+    m_Materials.clear();
+    m_DirtyRanges.clear();
+}
+
+void MaterialTable::MarkAllDirty()
+{
+    m_DirtyRanges.clear();
+    if (!m_Materials.empty())
+    {
+        m_DirtyRanges.push_back({ 0, GetCount() });
+    }
+}
+
+void MaterialTable::MarkDirty(uint32_t index)
+{
+    // First range that ends at or after index, i.e. the only one that can
+    // contain index or be extended by it on the left.
+    auto next = std::lower_bound(m_DirtyRanges.begin(), m_DirtyRanges.end(), index,
+        [](const MaterialRange& range, uint32_t value) { return range.End < value; });
+
+    if (next != m_DirtyRanges.end() && next->Begin <= index + 1)
+    {
+        if (index < next->End)
+        {
+            // Already dirty (or adjacent on the left of next).
+            next->Begin = std::min(next->Begin, index);
+            return;
+        }
+
+        // index == next->End: grow next to the right and absorb its successor
+        // if they now touch.
+        next->End = index + 1;
+        auto after = next + 1;
+        if (after != m_DirtyRanges.end() && after->Begin == next->End)
+        {
+            next->End = after->End;
+            m_DirtyRanges.erase(after);
+        }
+        return;
+    }
+
+    m_DirtyRanges.insert(next, { index, index + 1 });
+}
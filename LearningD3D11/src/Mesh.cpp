@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <cassert>
+#include "Mesh.h"
+
+const void* Mesh::GetIndexData() const
+{
+    return (Format == IF_16Bit) ? static_cast<const void*>(Indices16.data()) : static_cast<const void*>(Indices.data());
+}
+
+size_t Mesh::GetIndexSize() const
+{
+    return (Format == IF_16Bit) ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+bool PackIndices(Mesh& mesh, IndexFormat format)
+{
+    const bool fits16Bit = mesh.Vertices.size() <= 0x10000;
+    if (format == IF_Auto)
+    {
+        format = fits16Bit ? IF_16Bit : IF_32Bit;
+    }
+    if (format == IF_16Bit && !fits16Bit)
+    {
+        return false;
+    }
+
+    mesh.Format = format;
+    mesh.Indices16.clear();
+    if (format == IF_16Bit)
+    {
+        mesh.Indices16.resize(mesh.Indices.size());
+        std::transform(mesh.Indices.begin(), mesh.Indices.end(), mesh.Indices16.begin(),
+            [](uint32_t index) { return static_cast<uint16_t>(index); });
+    }
+    mesh.Indices16.shrink_to_fit();
+    return true;
+}
+
+void ReverseWinding(Mesh& mesh)
+{
+    assert((mesh.Indices.size() % 3) == 0);
+    for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+    {
+        std::swap(mesh.Indices[i], mesh.Indices[i + 2]);
+    }
+
+    for (VertexPosNormColTex& vertex : mesh.Vertices)
+    {
+        vertex.Texture.x = 1.0f - vertex.Texture.x;
+    }
+}
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    // A vertex is in the cache if it was pushed within the last cacheSize
+    // misses; tracking the miss count at which each vertex was pushed makes
+    // the FIFO test O(1).
+    std::vector<uint32_t> pushedAt(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t misses = 0;
+    size_t referencedCount = 0;
+
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        const uint32_t index = indices[i];
+        assert(index < vertexCount);
+
+        if (pushedAt[index] == 0 || misses - pushedAt[index] >= cacheSize)
+        {
+            misses++;
+            pushedAt[index] = misses;
+        }
+        if (!referenced[index])
+        {
+            referenced[index] = true;
+            referencedCount++;
+        }
+    }
+
+    VertexCacheStatistics statistics;
+    statistics.VerticesTransformed = misses;
+    statistics.ACMR = indexCount ? static_cast<float>(misses) / (indexCount / 3) : 0.0f;
+    statistics.ATVR = referencedCount ? static_cast<float>(misses) / referencedCount : 0.0f;
+    return statistics;
+}
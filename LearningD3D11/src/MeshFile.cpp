@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include "MeshFile.h"
+
+namespace
+{
+    void AddAttribute(MeshFileHeader& header, MeshAttributeSemantic semantic, MeshAttributeFormat format, size_t offset)
+    {
+        MeshFileAttribute& attribute = header.Attributes[header.AttributeCount++];
+        attribute.Semantic = semantic;
+        attribute.Format = format;
+        attribute.Offset = static_cast<uint32_t>(offset);
+        attribute.Padding = 0;
+    }
+}
+
+void GetMeshFileVertexLayout(MeshVertexFormat format, MeshFileHeader& header)
+{
+    header.VertexFormat = format;
+    header.AttributeCount = 0;
+    std::memset(header.Attributes, 0, sizeof(header.Attributes));
+
+    if (format == MVF_PosNormColTex)
+    {
+        header.VertexStride = sizeof(VertexPosNormColTex);
+        AddAttribute(header, MAS_Position, MAF_Float3, offsetof(VertexPosNormColTex, Position));
+        AddAttribute(header, MAS_Normal, MAF_Float3, offsetof(VertexPosNormColTex, Normal));
+        AddAttribute(header, MAS_Color, MAF_Float3, offsetof(VertexPosNormColTex, Color));
+        AddAttribute(header, MAS_Texcoord, MAF_Float2, offsetof(VertexPosNormColTex, Texture));
+    }
+    else
+    {
+        header.VertexStride = sizeof(VertexPacked);
+        AddAttribute(header, MAS_Position, (format == MVF_PackedUnorm16) ? MAF_Unorm16x4 : MAF_Half4, offsetof(VertexPacked, Position));
+        AddAttribute(header, MAS_Normal, MAF_Snorm16x2, offsetof(VertexPacked, Normal));
+        AddAttribute(header, MAS_Color, MAF_Unorm8x4, offsetof(VertexPacked, Color));
+        AddAttribute(header, MAS_Texcoord, MAF_Half2, offsetof(VertexPacked, Texture));
+    }
+}
+
+MeshFileWriter::MeshFileWriter()
+    : m_File(nullptr)
+    , m_Offset(0)
+    , m_Failed(false)
+{
+    std::memset(&m_Header, 0, sizeof(MeshFileHeader));
+}
+
+MeshFileWriter::~MeshFileWriter()
+{
+    Abort();
+}
+
+bool MeshFileWriter::Open(const char* fileName, MeshVertexFormat format, uint32_t indexSize)
+{
+    Abort();
+    if (indexSize != 2 && indexSize != 4)
+    {
+        return false;
+    }
+    m_File = OpenFile(fileName, "wb");
+    if (!m_File)
+    {
+        return false;
+    }
+    m_FileName = fileName;
+    m_Submeshes.clear();
+    m_Failed = false;
+
+    std::memset(&m_Header, 0, sizeof(MeshFileHeader));
+    m_Header.Magic = MeshFileMagic;
+    m_Header.Version = MeshFileVersion;
+    m_Header.HeaderSize = sizeof(MeshFileHeader);
+    m_Header.IndexSize = indexSize;
+    GetMeshFileVertexLayout(format, m_Header);
+    SetQuantization({ XMFLOAT4(1.0f, 1.0f, 1.0f, 0.0f), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f) });
+
+    // The header is written last; reserve its space and start the vertices
+    // on the next boundary.
+    m_Offset = 0;
+    if (fwrite(&m_Header, sizeof(MeshFileHeader), 1, m_File) != 1)
+    {
+        m_Failed = true;
+    }
+    m_Offset += sizeof(MeshFileHeader);
+    WritePadding();
+    m_Header.VertexDataOffset = m_Offset;
+    return !m_Failed;
+}
+
+void MeshFileWriter::Abort()
+{
+    if (m_File)
+    {
+        fclose(m_File);
+        m_File = nullptr;
+        RemoveFile(m_FileName.c_str());
+    }
+}
+
+void MeshFileWriter::SetQuantization(const VertexQuantization& quantization)
+{
+    std::memcpy(m_Header.PositionScale, &quantization.PositionScale, sizeof(m_Header.PositionScale));
+    std::memcpy(m_Header.PositionBias, &quantization.PositionBias, sizeof(m_Header.PositionBias));
+}
+
+void MeshFileWriter::SetBounds(const float boundsMin[3], const float boundsMax[3])
+{
+    std::copy(boundsMin, boundsMin + 3, m_Header.BoundsMin);
+    std::copy(boundsMax, boundsMax + 3, m_Header.BoundsMax);
+}
+
+bool MeshFileWriter::WritePadding()
+{
+    static const uint8_t zeros[MeshFileAlignment] = {};
+    const uint64_t padding = AlignOffset(m_Offset, MeshFileAlignment) - m_Offset;
+    if (padding > 0 && fwrite(zeros, 1, static_cast<size_t>(padding), m_File) != padding)
+    {
+        m_Failed = true;
+    }
+    m_Offset += padding;
+    return !m_Failed;
+}
+
+bool MeshFileWriter::WriteVertices(const void* vertices, size_t count)
+{
+    if (!m_File || m_Header.IndexCount > 0)
+    {
+        return false;
+    }
+    const size_t size = count * m_Header.VertexStride;
+    if (fwrite(vertices, 1, size, m_File) != size)
+    {
+        m_Failed = true;
+    }
+    m_Offset += size;
+    m_Header.VertexCount += count;
+    return !m_Failed;
+}
+
+bool MeshFileWriter::WriteIndices(const void* indices, size_t count)
+{
+    if (!m_File)
+    {
+        return false;
+    }
+    if (m_Header.IndexCount == 0)
+    {
+        WritePadding();
+        m_Header.IndexDataOffset = m_Offset;
+    }
+    const size_t size = count * m_Header.IndexSize;
+    if (fwrite(indices, 1, size, m_File) != size)
+    {
+        m_Failed = true;
+    }
+    m_Offset += size;
+    m_Header.IndexCount += count;
+    return !m_Failed;
+}
+
+void MeshFileWriter::AddSubmesh(const MeshFileSubmesh& submesh)
+{
+    m_Submeshes.push_back(submesh);
+}
+
+bool MeshFileWriter::Close()
+{
+    if (!m_File)
+    {
+        return false;
+    }
+    if (m_Header.IndexCount == 0)
+    {
+        WritePadding();
+        m_Header.IndexDataOffset = m_Offset;
+    }
+
+    WritePadding();
+    m_Header.SubmeshCount = static_cast<uint32_t>(m_Submeshes.size());
+    m_Header.SubmeshTableOffset = m_Offset;
+    const size_t tableSize = sizeof(MeshFileSubmesh) * m_Submeshes.size();
+    if (tableSize > 0 && fwrite(m_Submeshes.data(), 1, tableSize, m_File) != tableSize)
+    {
+        m_Failed = true;
+    }
+    m_Offset += tableSize;
+    m_Header.FileSize = m_Offset;
+
+    if (!SeekFile(m_File, 0) || fwrite(&m_Header, sizeof(MeshFileHeader), 1, m_File) != 1)
+    {
+        m_Failed = true;
+    }
+    if (fclose(m_File) != 0)
+    {
+        m_Failed = true;
+    }
+    m_File = nullptr;
+
+    if (m_Failed)
+    {
+        RemoveFile(m_FileName.c_str());
+    }
+    return !m_Failed;
+}
+
+bool WriteMeshFile(const char* fileName, const Mesh& mesh, MeshVertexFormat format)
+{
+    float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (const VertexPosNormColTex& vertex : mesh.Vertices)
+    {
+        const float position[3] = { vertex.Position.x, vertex.Position.y, vertex.Position.z };
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            boundsMin[axis] = std::min(boundsMin[axis], position[axis]);
+            boundsMax[axis] = std::max(boundsMax[axis], position[axis]);
+        }
+    }
+    if (mesh.Vertices.empty())
+    {
+        std::fill(boundsMin, boundsMin + 3, 0.0f);
+        std::fill(boundsMax, boundsMax + 3, 0.0f);
+    }
+
+    MeshFileWriter writer;
+    if (!writer.Open(fileName, format, static_cast<uint32_t>(mesh.GetIndexSize())))
+    {
+        return false;
+    }
+    writer.SetBounds(boundsMin, boundsMax);
+
+    if (format == MVF_PosNormColTex)
+    {
+        writer.WriteVertices(mesh.Vertices.data(), mesh.Vertices.size());
+    }
+    else
+    {
+        const PositionEncoding encoding = (format == MVF_PackedUnorm16) ? PE_Unorm16 : PE_Half;
+        const VertexQuantization quantization = ComputeVertexQuantization(mesh.Vertices.data(), mesh.Vertices.size(), encoding);
+        std::vector<VertexPacked> packedVertices(mesh.Vertices.size());
+        PackVertices(mesh.Vertices.data(), mesh.Vertices.size(), quantization, encoding, packedVertices.data());
+
+        writer.SetQuantization(quantization);
+        writer.WriteVertices(packedVertices.data(), packedVertices.size());
+    }
+    writer.WriteIndices(mesh.GetIndexData(), mesh.GetIndexCount());
+
+    MeshFileSubmesh submesh;
+    submesh.IndexStart = 0;
+    submesh.IndexCount = static_cast<uint32_t>(mesh.GetIndexCount());
+    submesh.BaseVertex = 0;
+    submesh.MaterialIndex = 0;
+    std::copy(boundsMin, boundsMin + 3, submesh.BoundsMin);
+    std::copy(boundsMax, boundsMax + 3, submesh.BoundsMax);
+    writer.AddSubmesh(submesh);
+
+    return writer.Close();
+}
+
+MappedMeshFile::MappedMeshFile()
+    : m_Data(nullptr)
+    , m_Header(nullptr)
+{
+}
+
+MappedMeshFile::~MappedMeshFile()
+{
+    Close();
+}
+
+bool MappedMeshFile::Open(const char* fileName)
+{
+    Close();
+
+    // Sequential scan: the sections are read front to back once, when they
+    // are handed to the GPU.
+    if (!m_File.Open(fileName, FAP_Sequential) || m_File.GetSize() < sizeof(MeshFileHeader))
+    {
+        Close();
+        return false;
+    }
+    m_Data = m_File.GetData();
+
+    const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(m_Data);
+    const uint64_t size = m_File.GetSize();
+    bool valid = header->Magic == MeshFileMagic
+        && header->Version == MeshFileVersion
+        && header->HeaderSize == sizeof(MeshFileHeader)
+        && header->FileSize == size
+        && header->VertexFormat <= MVF_PackedHalf
+        && header->AttributeCount <= MaxMeshFileAttributes
+        && header->VertexStride > 0
+        && (header->IndexSize == 2 || header->IndexSize == 4)
+        && header->VertexCount <= size / header->VertexStride
+        && header->IndexCount <= size / header->IndexSize
+        && header->SubmeshCount <= size / sizeof(MeshFileSubmesh);
+    valid = valid
+        && header->VertexDataOffset % MeshFileAlignment == 0
+        && header->IndexDataOffset % MeshFileAlignment == 0
+        && header->SubmeshTableOffset % MeshFileAlignment == 0
+        && IsRangeInFile(header->VertexDataOffset, header->VertexCount * header->VertexStride, size)
+        && IsRangeInFile(header->IndexDataOffset, header->IndexCount * header->IndexSize, size)
+        && IsRangeInFile(header->SubmeshTableOffset, uint64_t(header->SubmeshCount) * sizeof(MeshFileSubmesh), size);
+    if (!valid)
+    {
+        Close();
+        return false;
+    }
+    m_Header = header;
+
+    const MeshFileSubmesh* submeshes = GetSubmeshes();
+    for (uint32_t i = 0; i < header->SubmeshCount; ++i)
+    {
+        if (submeshes[i].IndexStart > header->IndexCount || submeshes[i].IndexCount > header->IndexCount - submeshes[i].IndexStart)
+        {
+            Close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void MappedMeshFile::Close()
+{
+    m_File.Close();
+    m_Data = nullptr;
+    m_Header = nullptr;
+}
+
+const void* MappedMeshFile::GetVertexData() const
+{
+    return m_Data + m_Header->VertexDataOffset;
+}
+
+const void* MappedMeshFile::GetIndexData() const
+{
+    return m_Data + m_Header->IndexDataOffset;
+}
+
+const MeshFileSubmesh* MappedMeshFile::GetSubmeshes() const
+{
+    return reinterpret_cast<const MeshFileSubmesh*>(m_Data + m_Header->SubmeshTableOffset);
+}
+
+uint64_t MappedMeshFile::GetVertexDataSize() const
+{
+    return m_Header->VertexCount * m_Header->VertexStride;
+}
+
+uint64_t MappedMeshFile::GetIndexDataSize() const
+{
+    return m_Header->IndexCount * m_Header->IndexSize;
+}
+
+VertexQuantization MappedMeshFile::GetQuantization() const
+{
+    VertexQuantization quantization;
+    std::memcpy(&quantization.PositionScale, m_Header->PositionScale, sizeof(m_Header->PositionScale));
+    std::memcpy(&quantization.PositionBias, m_Header->PositionBias, sizeof(m_Header->PositionBias));
+    return quantization;
+}
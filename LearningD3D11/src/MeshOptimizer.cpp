@@ -0,0 +1,379 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+#include <vector>
+#include "MeshOptimizer.h"
+
+namespace
+{
+    const uint32_t MaxCacheSize = 64;
+    const uint32_t MaxValenceScores = 64;
+    const uint32_t InvalidPosition = ~0u;
+
+    // Scoring parameters from Forsyth's "Linear-Speed Vertex Cache
+    // Optimisation".
+    const float CacheDecayPower = 1.5f;
+    const float LastTriangleScore = 0.75f;
+    const float ValenceBoostScale = 2.0f;
+    const float ValenceBoostPower = 0.5f;
+
+    struct VertexScoreTable
+    {
+        float Cache[MaxCacheSize + 3];
+        float Valence[MaxValenceScores];
+
+        explicit VertexScoreTable(uint32_t cacheSize)
+        {
+            for (uint32_t position = 0; position < cacheSize + 3; ++position)
+            {
+                if (position < 3)
+                {
+                    // The last triangle's vertices score the same whatever
+                    // order they were used in.
+                    Cache[position] = LastTriangleScore;
+                }
+                else if (position < cacheSize)
+                {
+                    const float scale = 1.0f / (cacheSize - 3);
+                    Cache[position] = std::pow(1.0f - (position - 3) * scale, CacheDecayPower);
+                }
+                else
+                {
+                    Cache[position] = 0.0f;
+                }
+            }
+
+            Valence[0] = 0.0f;
+            for (uint32_t valence = 1; valence < MaxValenceScores; ++valence)
+            {
+                Valence[valence] = ValenceBoostScale * std::pow(static_cast<float>(valence), -ValenceBoostPower);
+            }
+        }
+
+        float Score(uint32_t cachePosition, uint32_t remainingValence) const
+        {
+            if (remainingValence == 0)
+            {
+                // Nothing left to draw with this vertex.
+                return -1.0f;
+            }
+
+            const float cacheScore = (cachePosition == InvalidPosition) ? 0.0f : Cache[cachePosition];
+            const float valenceScore = (remainingValence < MaxValenceScores) ? Valence[remainingValence]
+                : ValenceBoostScale * std::pow(static_cast<float>(remainingValence), -ValenceBoostPower);
+            return cacheScore + valenceScore;
+        }
+    };
+
+    // FIFO cache misses of one triangle. timestamps holds, per vertex, the
+    // miss count at which it entered the cache.
+    uint32_t SimulateTriangle(const uint32_t* triangle, std::vector<uint32_t>& timestamps, uint32_t& misses, uint32_t cacheSize)
+    {
+        uint32_t triangleMisses = 0;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const uint32_t index = triangle[corner];
+            if (timestamps[index] == 0 || misses - timestamps[index] >= cacheSize)
+            {
+                misses++;
+                timestamps[index] = misses;
+                triangleMisses++;
+            }
+        }
+        return triangleMisses;
+    }
+
+    // Empty the simulated cache in O(1) by making every timestamp too old.
+    void FlushCache(uint32_t& misses, uint32_t cacheSize)
+    {
+        misses += cacheSize;
+    }
+}
+
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    assert((indexCount % 3) == 0);
+    cacheSize = std::min(std::max(cacheSize, 4u), MaxCacheSize);
+
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    const VertexScoreTable scoreTable(cacheSize);
+
+    // Triangles using each vertex, as one array with per-vertex offsets. The
+    // first Valence[v] entries of a vertex's range are its undrawn triangles.
+    std::vector<uint32_t> valence(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        valence[indices[i]]++;
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + valence[v];
+    }
+
+    std::vector<uint32_t> adjacency(indexCount);
+    {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                const uint32_t v = indices[t * 3 + corner];
+                adjacency[fill[v]++] = static_cast<uint32_t>(t);
+            }
+        }
+    }
+
+    std::vector<uint32_t> cachePosition(vertexCount, InvalidPosition);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        vertexScore[v] = scoreTable.Score(InvalidPosition, valence[v]);
+    }
+
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> output(indexCount);
+
+    // LRU cache, most recent first, with room for one triangle's overflow.
+    uint32_t cache[MaxCacheSize + 3];
+    uint32_t cacheCount = 0;
+
+    size_t inputCursor = 0;
+    uint32_t bestTriangle = 0;
+    for (size_t outputTriangle = 0; outputTriangle < triangleCount; ++outputTriangle)
+    {
+        if (bestTriangle == InvalidPosition)
+        {
+            // Nothing in the cache has triangles left; continue with the
+            // first undrawn triangle in input order.
+            while (emitted[inputCursor])
+            {
+                inputCursor++;
+            }
+            bestTriangle = static_cast<uint32_t>(inputCursor);
+        }
+
+        const uint32_t* triangle = indices + bestTriangle * 3;
+        std::copy(triangle, triangle + 3, output.begin() + outputTriangle * 3);
+        emitted[bestTriangle] = true;
+
+        // Remove the triangle from its vertices' undrawn lists.
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const uint32_t v = triangle[corner];
+            uint32_t* begin = adjacency.data() + adjacencyOffsets[v];
+            uint32_t* end = begin + valence[v];
+            uint32_t* it = std::find(begin, end, bestTriangle);
+            assert(it != end);
+            std::swap(*it, *(end - 1));
+            valence[v]--;
+        }
+
+        // Move the triangle's vertices to the front of the cache.
+        uint32_t newCache[MaxCacheSize + 3];
+        uint32_t newCacheCount = 0;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            newCache[newCacheCount++] = triangle[corner];
+        }
+        for (uint32_t i = 0; i < cacheCount; ++i)
+        {
+            const uint32_t v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+            {
+                newCache[newCacheCount++] = v;
+            }
+        }
+
+        // Rescore every vertex whose position changed, including the ones
+        // pushed out, and the undrawn triangles around them. The best of
+        // those is the next triangle.
+        float bestScore = -1.0f;
+        bestTriangle = InvalidPosition;
+        for (uint32_t i = 0; i < newCacheCount; ++i)
+        {
+            const uint32_t v = newCache[i];
+            const uint32_t position = (i < cacheSize) ? i : InvalidPosition;
+            cachePosition[v] = position;
+
+            const float score = scoreTable.Score(position, valence[v]);
+            const float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            const uint32_t* begin = adjacency.data() + adjacencyOffsets[v];
+            for (const uint32_t* it = begin; it != begin + valence[v]; ++it)
+            {
+                triangleScore[*it] += delta;
+                if (triangleScore[*it] > bestScore)
+                {
+                    bestScore = triangleScore[*it];
+                    bestTriangle = *it;
+                }
+            }
+        }
+
+        cacheCount = std::min(newCacheCount, cacheSize);
+        std::copy(newCache, newCache + cacheCount, cache);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const VertexPosNormColTex* vertices, size_t vertexCount,
+    float threshold)
+{
+    assert((indexCount % 3) == 0);
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Cache model used to find split points; matches AnalyzeVertexCache.
+    const uint32_t cacheSize = 16;
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    uint32_t misses = 0;
+
+    // Hard boundaries: triangles where the cache is completely cold, so the
+    // triangle order can be broken there for free.
+    std::vector<uint32_t> hardClusters;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        if (SimulateTriangle(indices + t * 3, timestamps, misses, cacheSize) == 3)
+        {
+            hardClusters.push_back(static_cast<uint32_t>(t));
+        }
+    }
+    if (hardClusters.empty() || hardClusters[0] != 0)
+    {
+        hardClusters.insert(hardClusters.begin(), 0);
+    }
+    hardClusters.push_back(static_cast<uint32_t>(triangleCount));
+
+    // Soft boundaries: within a hard cluster, split wherever the running ACMR
+    // since the last split is already within threshold of the cluster's.
+    std::vector<uint32_t> clusters;
+    for (size_t c = 0; c + 1 < hardClusters.size(); ++c)
+    {
+        const uint32_t start = hardClusters[c];
+        const uint32_t end = hardClusters[c + 1];
+
+        FlushCache(misses, cacheSize);
+        const uint32_t missesBefore = misses;
+        for (uint32_t t = start; t < end; ++t)
+        {
+            SimulateTriangle(indices + t * 3, timestamps, misses, cacheSize);
+        }
+        const float clusterThreshold = threshold * static_cast<float>(misses - missesBefore) / (end - start);
+
+        FlushCache(misses, cacheSize);
+        uint32_t clusterStart = start;
+        uint32_t runningMisses = 0;
+        for (uint32_t t = start; t < end; ++t)
+        {
+            runningMisses += SimulateTriangle(indices + t * 3, timestamps, misses, cacheSize);
+            const uint32_t runningTriangles = t - clusterStart + 1;
+
+            if (t + 1 == end || static_cast<float>(runningMisses) / runningTriangles <= clusterThreshold)
+            {
+                clusters.push_back(clusterStart);
+                clusterStart = t + 1;
+                runningMisses = 0;
+                FlushCache(misses, cacheSize);
+            }
+        }
+    }
+    clusters.push_back(static_cast<uint32_t>(triangleCount));
+    const size_t clusterCount = clusters.size() - 1;
+
+    // Area-weighted mesh centroid.
+    XMVECTOR meshCentroid = XMVectorZero();
+    float meshArea = 0.0f;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        const XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3]].Position);
+        const XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+        const XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+        const float area = XMVectorGetX(XMVector3Length(XMVector3Cross(p1 - p0, p2 - p0)));
+        meshCentroid += (p0 + p1 + p2) * (area / 3.0f);
+        meshArea += area;
+    }
+    meshCentroid = (meshArea > 0.0f) ? meshCentroid / meshArea : XMVectorZero();
+
+    // Sort clusters by how much they face away from the mesh center. With the
+    // winding ReverseWinding produces, the outward face normal is
+    // (p1 - p0) x (p2 - p0).
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        XMVECTOR centroid = XMVectorZero();
+        XMVECTOR normal = XMVectorZero();
+        float area = 0.0f;
+        for (uint32_t t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            const XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3]].Position);
+            const XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+            const XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+            const XMVECTOR areaNormal = XMVector3Cross(p1 - p0, p2 - p0);
+            const float triangleArea = XMVectorGetX(XMVector3Length(areaNormal));
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += areaNormal;
+            area += triangleArea;
+        }
+        centroid = (area > 0.0f) ? centroid / area : centroid;
+        sortKeys[c] = XMVectorGetX(XMVector3Dot(centroid - meshCentroid, XMVector3Normalize(normal)));
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indexCount);
+    for (uint32_t c : order)
+    {
+        output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+size_t OptimizeVertexFetch(uint32_t* indices, size_t indexCount, VertexPosNormColTex* vertices, size_t vertexCount)
+{
+    std::vector<uint32_t> remap(vertexCount, InvalidPosition);
+    std::vector<VertexPosNormColTex> reordered;
+    reordered.reserve(vertexCount);
+
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t& index = indices[i];
+        if (remap[index] == InvalidPosition)
+        {
+            remap[index] = static_cast<uint32_t>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    std::copy(reordered.begin(), reordered.end(), vertices);
+    return reordered.size();
+}
+
+void OptimizeMesh(Mesh& mesh)
+{
+    OptimizeVertexCache(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.size());
+    OptimizeOverdraw(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.data(), mesh.Vertices.size());
+    mesh.Vertices.resize(OptimizeVertexFetch(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.data(), mesh.Vertices.size()));
+}
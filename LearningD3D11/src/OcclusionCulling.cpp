@@ -0,0 +1,413 @@
+#include <algorithm>
+#include <cmath>
+#include "OcclusionCulling.h"
+
+namespace
+{
+    inline unsigned int LaneMask(FXMVECTOR comparison)
+    {
+#if defined(_XM_SSE_INTRINSICS_)
+        return static_cast<unsigned int>(_mm_movemask_ps(comparison));
+#else
+        uint32_t lanes[4];
+        XMStoreInt4(lanes, comparison);
+        return (lanes[0] ? 1u : 0u) | (lanes[1] ? 2u : 0u) | (lanes[2] ? 4u : 0u) | (lanes[3] ? 8u : 0u);
+#endif
+    }
+
+    // One clip coordinate of a box's corners, from that coordinate of its
+    // centre and of each axis scaled by the extent, all splatted: the four
+    // corners at -z, then the four at +z, each as -x-y, +x-y, -x+y, +x+y.
+    inline void BoxCorners(FXMVECTOR center, FXMVECTOR axisX, FXMVECTOR axisY, GXMVECTOR axisZ,
+        XMVECTOR& nearCorners, XMVECTOR& farCorners)
+    {
+        const XMVECTOR signX = XMVectorSet(-1.0f, 1.0f, -1.0f, 1.0f);
+        const XMVECTOR signY = XMVectorSet(-1.0f, -1.0f, 1.0f, 1.0f);
+        const XMVECTOR face = XMVectorAdd(center, XMVectorAdd(XMVectorMultiply(signX, axisX), XMVectorMultiply(signY, axisY)));
+        nearCorners = XMVectorSubtract(face, axisZ);
+        farCorners = XMVectorAdd(face, axisZ);
+    }
+
+    inline float HorizontalMin(FXMVECTOR v)
+    {
+        XMFLOAT4 lanes;
+        XMStoreFloat4(&lanes, v);
+        return std::min(std::min(lanes.x, lanes.y), std::min(lanes.z, lanes.w));
+    }
+
+    inline float HorizontalMax(FXMVECTOR v)
+    {
+        XMFLOAT4 lanes;
+        XMStoreFloat4(&lanes, v);
+        return std::max(std::max(lanes.x, lanes.y), std::max(lanes.z, lanes.w));
+    }
+}
+
+OcclusionBuffer::OcclusionBuffer()
+    : m_Width(0)
+    , m_Height(0)
+    , m_ViewProjection(XMMatrixIdentity())
+    , m_NearZ(0.1f)
+    , m_TriangleCount(0)
+{
+}
+
+bool OcclusionBuffer::Create(uint32_t width, uint32_t height)
+{
+    if (width == 0 || height == 0 || (width % 4) != 0)
+    {
+        return false;
+    }
+
+    m_Width = width;
+    m_Height = height;
+    m_Depth.assign(static_cast<size_t>(width) * height, 0.0f);
+
+    m_Levels.clear();
+    Level level;
+    level.Width = width;
+    level.Height = height;
+    m_Levels.push_back(level);
+    while (level.Width > 1 || level.Height > 1)
+    {
+        level.Width = (level.Width + 1) / 2;
+        level.Height = (level.Height + 1) / 2;
+        level.Nearest.assign(static_cast<size_t>(level.Width) * level.Height, 0.0f);
+        level.Farthest.assign(static_cast<size_t>(level.Width) * level.Height, 0.0f);
+        m_Levels.push_back(level);
+    }
+    return true;
+}
+
+void OcclusionBuffer::Begin(FXMMATRIX viewProjection, float nearZ)
+{
+    std::fill(m_Depth.begin(), m_Depth.end(), 0.0f);
+    m_ViewProjection = viewProjection;
+    m_NearZ = nearZ;
+    m_TriangleCount = 0;
+}
+
+void OcclusionBuffer::RasterizeOccluder(const VertexPosNormColTex* vertices, const uint16_t* indices, size_t indexCount, FXMMATRIX world)
+{
+    const XMMATRIX worldViewProjection = world * m_ViewProjection;
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        RasterizeTriangle(
+            XMVector3Transform(XMLoadFloat3(&vertices[indices[i]].Position), worldViewProjection),
+            XMVector3Transform(XMLoadFloat3(&vertices[indices[i + 1]].Position), worldViewProjection),
+            XMVector3Transform(XMLoadFloat3(&vertices[indices[i + 2]].Position), worldViewProjection));
+    }
+}
+
+void OcclusionBuffer::RasterizeOccluders(const VertexPosNormColTex* vertices, const uint16_t* indices, size_t indexCount,
+    const PlaneInstanceData* instances, size_t instanceCount)
+{
+    for (size_t i = 0; i < instanceCount; ++i)
+    {
+        RasterizeOccluder(vertices, indices, indexCount, instances[i].WorldMatrix);
+    }
+}
+
+void OcclusionBuffer::RasterizeTriangle(FXMVECTOR clip0, FXMVECTOR clip1, FXMVECTOR clip2)
+{
+    const XMVECTOR input[3] = { clip0, clip1, clip2 };
+
+    // Trivially reject triangles that are entirely outside one side plane or
+    // in front of the near plane.
+    unsigned int outsideMask[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        XMFLOAT4 p;
+        XMStoreFloat4(&p, input[i]);
+        outsideMask[i] =
+            (p.x < -p.w ? 0x01u : 0u) | (p.x > p.w ? 0x02u : 0u) |
+            (p.y < -p.w ? 0x04u : 0u) | (p.y > p.w ? 0x08u : 0u) |
+            (p.w < m_NearZ ? 0x10u : 0u);
+    }
+    if (outsideMask[0] & outsideMask[1] & outsideMask[2])
+    {
+        return;
+    }
+
+    if (((outsideMask[0] | outsideMask[1] | outsideMask[2]) & 0x10u) == 0)
+    {
+        SetupTriangle(clip0, clip1, clip2);
+        return;
+    }
+
+    // Clip at w = nearZ, which is view depth nearZ whatever the depth mapping.
+    XMVECTOR clipped[4];
+    int clippedCount = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        const XMVECTOR a = input[i];
+        const XMVECTOR b = input[(i + 1) % 3];
+        const float aW = XMVectorGetW(a);
+        const float bW = XMVectorGetW(b);
+        const bool aInside = aW >= m_NearZ;
+        const bool bInside = bW >= m_NearZ;
+
+        if (aInside)
+        {
+            clipped[clippedCount++] = a;
+        }
+        if (aInside != bInside)
+        {
+            clipped[clippedCount++] = XMVectorLerp(a, b, (aW - m_NearZ) / (aW - bW));
+        }
+    }
+
+    for (int i = 1; i + 1 < clippedCount; ++i)
+    {
+        SetupTriangle(clipped[0], clipped[i], clipped[i + 1]);
+    }
+}
+
+void OcclusionBuffer::SetupTriangle(FXMVECTOR clip0, FXMVECTOR clip1, FXMVECTOR clip2)
+{
+    // Set up in double precision. Near-clipped occluders around the camera
+    // put vertices hundreds of screens away, where float edge functions would
+    // lose every bit that matters on screen.
+    const XMVECTOR input[3] = { clip0, clip1, clip2 };
+    double X[3], Y[3], Z[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        XMFLOAT4 p;
+        XMStoreFloat4(&p, input[i]);
+        const double invW = 1.0 / p.w;
+        X[i] = (p.x * invW * 0.5 + 0.5) * m_Width;
+        Y[i] = (-p.y * invW * 0.5 + 0.5) * m_Height;
+        Z[i] = invW;
+    }
+
+    // Occluders are double-sided: flip the triangles facing away so the edge
+    // functions are positive inside either way.
+    double area = (X[1] - X[0]) * (Y[2] - Y[0]) - (X[2] - X[0]) * (Y[1] - Y[0]);
+    if (area < 0.0)
+    {
+        std::swap(X[1], X[2]);
+        std::swap(Y[1], Y[2]);
+        std::swap(Z[1], Z[2]);
+        area = -area;
+    }
+    if (!(area > 0.0))
+    {
+        return;
+    }
+
+    // Pixels whose centres may be inside.
+    const double minX = std::max(0.0, std::ceil(std::min({ X[0], X[1], X[2] }) - 0.5));
+    const double minY = std::max(0.0, std::ceil(std::min({ Y[0], Y[1], Y[2] }) - 0.5));
+    const double maxX = std::min(m_Width - 1.0, std::floor(std::max({ X[0], X[1], X[2] }) - 0.5));
+    const double maxY = std::min(m_Height - 1.0, std::floor(std::max({ Y[0], Y[1], Y[2] }) - 0.5));
+    if (minX > maxX || minY > maxY)
+    {
+        return;
+    }
+    m_TriangleCount++;
+
+    // Edge functions E(x, y) = A * (x - Xa) + B * (y - Ya), positive inside.
+    // Each one over the area is the barycentric weight of the opposite
+    // vertex, so the depth gradient follows from them too.
+    double A[3], B[3];
+    double depthA = 0.0, depthB = 0.0;
+    for (int e = 0; e < 3; ++e)
+    {
+        const int a = (e + 1) % 3;
+        const int b = (e + 2) % 3;
+        A[e] = -(Y[b] - Y[a]);
+        B[e] = X[b] - X[a];
+        depthA += A[e] * Z[e] / area;
+        depthB += B[e] * Z[e] / area;
+    }
+
+    // Four pixels per step, starting at a multiple of four so the buffer
+    // loads never cross the end of a row. Each row starts from exact values
+    // and steps in float.
+    const int startX = static_cast<int>(minX) & ~3;
+    const int endX = static_cast<int>(maxX);
+    const double startCenterX = startX + 0.5;
+    const XMVECTOR laneOffsets = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+    XMVECTOR edgeLanes[3], edgeStep[3];
+    for (int e = 0; e < 3; ++e)
+    {
+        edgeLanes[e] = XMVectorScale(laneOffsets, static_cast<float>(A[e]));
+        edgeStep[e] = XMVectorReplicate(static_cast<float>(4.0 * A[e]));
+    }
+    const XMVECTOR depthLanes = XMVectorScale(laneOffsets, static_cast<float>(depthA));
+    const XMVECTOR depthStep = XMVectorReplicate(static_cast<float>(4.0 * depthA));
+    const XMVECTOR zero = XMVectorZero();
+
+    for (int y = static_cast<int>(minY); y <= static_cast<int>(maxY); ++y)
+    {
+        const double centerY = y + 0.5;
+        XMVECTOR edge[3];
+        for (int e = 0; e < 3; ++e)
+        {
+            const int a = (e + 1) % 3;
+            const double rowStart = A[e] * (startCenterX - X[a]) + B[e] * (centerY - Y[a]);
+            edge[e] = XMVectorAdd(XMVectorReplicate(static_cast<float>(rowStart)), edgeLanes[e]);
+        }
+        const double depthRowStart = Z[0] + depthA * (startCenterX - X[0]) + depthB * (centerY - Y[0]);
+        XMVECTOR depth = XMVectorAdd(XMVectorReplicate(static_cast<float>(depthRowStart)), depthLanes);
+
+        float* row = &m_Depth[static_cast<size_t>(y) * m_Width];
+        for (int x = startX; x <= endX; x += 4)
+        {
+            const XMVECTOR inside = XMVectorAndInt(XMVectorAndInt(
+                XMVectorGreaterOrEqual(edge[0], zero), XMVectorGreaterOrEqual(edge[1], zero)),
+                XMVectorGreaterOrEqual(edge[2], zero));
+            if (LaneMask(inside))
+            {
+                XMFLOAT4* pixels = reinterpret_cast<XMFLOAT4*>(&row[x]);
+                const XMVECTOR stored = XMLoadFloat4(pixels);
+                XMStoreFloat4(pixels, XMVectorSelect(stored, XMVectorMax(stored, depth), inside));
+            }
+
+            for (int e = 0; e < 3; ++e)
+            {
+                edge[e] = XMVectorAdd(edge[e], edgeStep[e]);
+            }
+            depth = XMVectorAdd(depth, depthStep);
+        }
+    }
+}
+
+void OcclusionBuffer::BuildHierarchy()
+{
+    for (size_t l = 1; l < m_Levels.size(); ++l)
+    {
+        const uint32_t sourceLevel = static_cast<uint32_t>(l - 1);
+        const float* sourceNearest = GetNearestDepths(sourceLevel);
+        const float* sourceFarthest = GetFarthestDepths(sourceLevel);
+        const uint32_t sourceWidth = m_Levels[sourceLevel].Width;
+        const uint32_t sourceHeight = m_Levels[sourceLevel].Height;
+
+        Level& level = m_Levels[l];
+        for (uint32_t y = 0; y < level.Height; ++y)
+        {
+            // Odd sizes repeat the last row and column.
+            const size_t row0 = static_cast<size_t>(2 * y) * sourceWidth;
+            const size_t row1 = static_cast<size_t>(std::min(2 * y + 1, sourceHeight - 1)) * sourceWidth;
+            for (uint32_t x = 0; x < level.Width; ++x)
+            {
+                const size_t x0 = 2 * x;
+                const size_t x1 = std::min(2 * x + 1, sourceWidth - 1);
+                level.Nearest[y * level.Width + x] = std::max(
+                    std::max(sourceNearest[row0 + x0], sourceNearest[row0 + x1]),
+                    std::max(sourceNearest[row1 + x0], sourceNearest[row1 + x1]));
+                level.Farthest[y * level.Width + x] = std::min(
+                    std::min(sourceFarthest[row0 + x0], sourceFarthest[row0 + x1]),
+                    std::min(sourceFarthest[row1 + x0], sourceFarthest[row1 + x1]));
+            }
+        }
+    }
+}
+
+const float* OcclusionBuffer::GetNearestDepths(uint32_t level) const
+{
+    return level == 0 ? m_Depth.data() : m_Levels[level].Nearest.data();
+}
+
+const float* OcclusionBuffer::GetFarthestDepths(uint32_t level) const
+{
+    return level == 0 ? m_Depth.data() : m_Levels[level].Farthest.data();
+}
+
+OcclusionRectResult OcclusionBuffer::ProjectBox(const XMFLOAT3& center, const XMFLOAT3& extents, OcclusionRect& rect) const
+{
+    // clip(center + offset) = clip(center) + offset * M, so the eight
+    // corners are the centre's clip position plus or minus each axis' row
+    // scaled by its extent.
+    const XMVECTOR clipCenter = XMVector3Transform(XMLoadFloat3(&center), m_ViewProjection);
+    const XMVECTOR axisX = XMVectorScale(m_ViewProjection.r[0], extents.x);
+    const XMVECTOR axisY = XMVectorScale(m_ViewProjection.r[1], extents.y);
+    const XMVECTOR axisZ = XMVectorScale(m_ViewProjection.r[2], extents.z);
+    XMVECTOR x0, x1, y0, y1, w0, w1;
+    BoxCorners(XMVectorSplatX(clipCenter), XMVectorSplatX(axisX), XMVectorSplatX(axisY), XMVectorSplatX(axisZ), x0, x1);
+    BoxCorners(XMVectorSplatY(clipCenter), XMVectorSplatY(axisX), XMVectorSplatY(axisY), XMVectorSplatY(axisZ), y0, y1);
+    BoxCorners(XMVectorSplatW(clipCenter), XMVectorSplatW(axisX), XMVectorSplatW(axisY), XMVectorSplatW(axisZ), w0, w1);
+
+    if (HorizontalMin(XMVectorMin(w0, w1)) < m_NearZ)
+    {
+        return ORR_CrossesNear;
+    }
+
+    const XMVECTOR invW0 = XMVectorReciprocal(w0);
+    const XMVECTOR invW1 = XMVectorReciprocal(w1);
+    const XMVECTOR screenX0 = XMVectorMultiply(x0, invW0);
+    const XMVECTOR screenX1 = XMVectorMultiply(x1, invW1);
+    const XMVECTOR screenY0 = XMVectorMultiply(y0, invW0);
+    const XMVECTOR screenY1 = XMVectorMultiply(y1, invW1);
+
+    // Normalized device coordinates to pixels, y down.
+    const float minX = (HorizontalMin(XMVectorMin(screenX0, screenX1)) * 0.5f + 0.5f) * m_Width;
+    const float maxX = (HorizontalMax(XMVectorMax(screenX0, screenX1)) * 0.5f + 0.5f) * m_Width;
+    const float minY = (-HorizontalMax(XMVectorMax(screenY0, screenY1)) * 0.5f + 0.5f) * m_Height;
+    const float maxY = (-HorizontalMin(XMVectorMin(screenY0, screenY1)) * 0.5f + 0.5f) * m_Height;
+    if (maxX <= 0.0f || maxY <= 0.0f || minX >= static_cast<float>(m_Width) || minY >= static_cast<float>(m_Height))
+    {
+        return ORR_OffScreen;
+    }
+
+    // Every pixel the rectangle overlaps.
+    rect.MinX = std::max(0, static_cast<int>(std::floor(minX)));
+    rect.MinY = std::max(0, static_cast<int>(std::floor(minY)));
+    rect.MaxX = std::min(static_cast<int>(m_Width) - 1, std::max(rect.MinX, static_cast<int>(std::ceil(maxX)) - 1));
+    rect.MaxY = std::min(static_cast<int>(m_Height) - 1, std::max(rect.MinY, static_cast<int>(std::ceil(maxY)) - 1));
+    rect.NearestDepth = HorizontalMax(XMVectorMax(invW0, invW1));
+    return ORR_OnScreen;
+}
+
+bool OcclusionBuffer::IsBoxVisible(const XMFLOAT3& center, const XMFLOAT3& extents) const
+{
+    OcclusionRect rect;
+    const OcclusionRectResult result = ProjectBox(center, extents, rect);
+    if (result != ORR_OnScreen)
+    {
+        return result == ORR_CrossesNear;
+    }
+
+    uint32_t level = 0;
+    while (level + 1 < m_Levels.size() &&
+        ((rect.MaxX >> level) - (rect.MinX >> level) > 1 || (rect.MaxY >> level) - (rect.MinY >> level) > 1))
+    {
+        ++level;
+    }
+    return IsRectVisible(level, rect.MinX >> level, rect.MinY >> level, rect.MaxX >> level, rect.MaxY >> level, rect);
+}
+
+bool OcclusionBuffer::IsRectVisible(uint32_t level, int minX, int minY, int maxX, int maxY, const OcclusionRect& rect) const
+{
+    const float* nearest = GetNearestDepths(level);
+    const float* farthest = GetFarthestDepths(level);
+    const uint32_t width = m_Levels[level].Width;
+    for (int y = minY; y <= maxY; ++y)
+    {
+        for (int x = minX; x <= maxX; ++x)
+        {
+            const size_t texel = static_cast<size_t>(y) * width + x;
+            if (rect.NearestDepth >= nearest[texel])
+            {
+                // In front of every occluder pixel below the texel.
+                return true;
+            }
+            if (rect.NearestDepth < farthest[texel])
+            {
+                // Behind all of them.
+                continue;
+            }
+
+            // Some of each; look at the texels below that the box overlaps.
+            // Level 0 never gets here, its nearest and farthest are equal.
+            const uint32_t child = level - 1;
+            if (IsRectVisible(child,
+                std::max(2 * x, rect.MinX >> child), std::max(2 * y, rect.MinY >> child),
+                std::min(2 * x + 1, rect.MaxX >> child), std::min(2 * y + 1, rect.MaxY >> child), rect))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
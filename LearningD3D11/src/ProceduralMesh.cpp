@@ -0,0 +1,384 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <unordered_map>
+#include "MeshOptimizer.h"
+#include "ProceduralMesh.h"
+
+namespace
+{
+    XMFLOAT3 ToFloat3(FXMVECTOR v)
+    {
+        XMFLOAT3 result;
+        XMStoreFloat3(&result, v);
+        return result;
+    }
+
+    void AddVertex(Mesh& mesh, FXMVECTOR position, FXMVECTOR normal, float u, float v, const XMFLOAT3& color)
+    {
+        mesh.Vertices.push_back({ ToFloat3(position), ToFloat3(normal), color, XMFLOAT2(u, v) });
+    }
+
+    void AddTriangle(Mesh& mesh, uint32_t i0, uint32_t i1, uint32_t i2)
+    {
+        mesh.Indices.push_back(i0);
+        mesh.Indices.push_back(i1);
+        mesh.Indices.push_back(i2);
+    }
+
+    // Two triangles for a quad whose corners are given counter-clockwise.
+    void AddQuad(Mesh& mesh, uint32_t i0, uint32_t i1, uint32_t i2, uint32_t i3)
+    {
+        AddTriangle(mesh, i0, i1, i2);
+        AddTriangle(mesh, i0, i2, i3);
+    }
+
+    Mesh FinishMesh(Mesh&& mesh, const MeshBuildOptions& options)
+    {
+        ReverseWinding(mesh);
+
+        if (options.Optimize)
+        {
+            OptimizeMesh(mesh);
+        }
+
+        // Too many vertices for the requested 16-bit format; fall back to 32.
+        if (!PackIndices(mesh, options.Format))
+        {
+            PackIndices(mesh, IF_32Bit);
+        }
+        return std::move(mesh);
+    }
+}
+
+Mesh CreateCubeMesh(float size, uint32_t tessellation, const MeshBuildOptions& options)
+{
+    // A cube has six faces, each one pointing in a different direction.
+    const int FaceCount = 6;
+
+    static const XMVECTORF32 faceNormals[FaceCount] =
+    {
+        { 0,  0,  1 },
+        { 0,  0, -1 },
+        { 1,  0,  0 },
+        { -1,  0,  0 },
+        { 0,  1,  0 },
+        { 0, -1,  0 },
+    };
+
+    tessellation = std::max(tessellation, 1u);
+    const uint32_t stride = tessellation + 1;
+    const float halfSize = size / 2;
+
+    Mesh mesh;
+    mesh.Vertices.reserve(FaceCount * stride * stride);
+    mesh.Indices.reserve(FaceCount * tessellation * tessellation * 6);
+
+    for (int face = 0; face < FaceCount; ++face)
+    {
+        const XMVECTOR normal = faceNormals[face];
+
+        // Get two vectors perpendicular both to the face normal and to each other.
+        const XMVECTOR basis = (face >= 4) ? g_XMIdentityR2 : g_XMIdentityR1;
+        const XMVECTOR side1 = XMVector3Cross(normal, basis);
+        const XMVECTOR side2 = XMVector3Cross(normal, side1);
+
+        const uint32_t base = static_cast<uint32_t>(mesh.Vertices.size());
+        for (uint32_t i = 0; i <= tessellation; ++i)
+        {
+            const float a = -1.0f + 2.0f * i / tessellation;
+            for (uint32_t j = 0; j <= tessellation; ++j)
+            {
+                const float b = -1.0f + 2.0f * j / tessellation;
+                const XMVECTOR position = (normal + side1 * a + side2 * b) * halfSize;
+                AddVertex(mesh, position, normal, (1.0f - a) * 0.5f, (1.0f + b) * 0.5f, options.Color);
+            }
+        }
+
+        for (uint32_t i = 0; i < tessellation; ++i)
+        {
+            for (uint32_t j = 0; j < tessellation; ++j)
+            {
+                const uint32_t corner = base + i * stride + j;
+                AddQuad(mesh, corner, corner + 1, corner + stride + 1, corner + stride);
+            }
+        }
+    }
+
+    return FinishMesh(std::move(mesh), options);
+}
+
+Mesh CreateUVSphereMesh(float radius, uint32_t slices, uint32_t stacks, const MeshBuildOptions& options)
+{
+    slices = std::max(slices, 3u);
+    stacks = std::max(stacks, 2u);
+    const uint32_t stride = slices + 1;
+
+    Mesh mesh;
+    mesh.Vertices.reserve((stacks + 1) * stride);
+    mesh.Indices.reserve(stacks * slices * 6);
+
+    // Rings from the south pole up.
+    for (uint32_t i = 0; i <= stacks; ++i)
+    {
+        const float v = 1.0f - static_cast<float>(i) / stacks;
+        const float latitude = i * XM_PI / stacks - XM_PIDIV2;
+        float dy, dxz;
+        XMScalarSinCos(&dy, &dxz, latitude);
+
+        for (uint32_t j = 0; j <= slices; ++j)
+        {
+            const float u = static_cast<float>(j) / slices;
+            const float longitude = j * XM_2PI / slices;
+            float dx, dz;
+            XMScalarSinCos(&dx, &dz, longitude);
+
+            const XMVECTOR normal = XMVectorSet(dx * dxz, dy, dz * dxz, 0.0f);
+            AddVertex(mesh, normal * radius, normal, u, v, options.Color);
+        }
+    }
+
+    // The quads touching a pole have two corners on it; only their other
+    // triangle has any area.
+    for (uint32_t i = 0; i < stacks; ++i)
+    {
+        for (uint32_t j = 0; j < slices; ++j)
+        {
+            const uint32_t corner = i * stride + j;
+            if (i + 1 < stacks)
+            {
+                AddTriangle(mesh, corner, corner + stride, corner + stride + 1);
+            }
+            if (i > 0)
+            {
+                AddTriangle(mesh, corner, corner + stride + 1, corner + 1);
+            }
+        }
+    }
+
+    return FinishMesh(std::move(mesh), options);
+}
+
+Mesh CreateIcosphereMesh(float radius, uint32_t subdivisions, const MeshBuildOptions& options)
+{
+    // Icosahedron: three orthogonal golden rectangles.
+    const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+    const XMFLOAT3 corners[12] =
+    {
+        { -1,  t,  0 }, { 1,  t,  0 }, { -1, -t,  0 }, { 1, -t,  0 },
+        { 0, -1,  t }, { 0,  1,  t }, { 0, -1, -t }, { 0,  1, -t },
+        { t,  0, -1 }, { t,  0,  1 }, { -t,  0, -1 }, { -t,  0,  1 },
+    };
+    const uint32_t faces[20][3] =
+    {
+        { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+        { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+        { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+        { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 },
+    };
+
+    std::vector<XMFLOAT3> positions;
+    std::vector<uint32_t> indices;
+    for (const XMFLOAT3& corner : corners)
+    {
+        positions.push_back(ToFloat3(XMVector3Normalize(XMLoadFloat3(&corner))));
+    }
+    for (const auto& face : faces)
+    {
+        // The table is clockwise; flip it to match the other generators.
+        indices.push_back(face[0]);
+        indices.push_back(face[2]);
+        indices.push_back(face[1]);
+    }
+
+    // Split every triangle into four, sharing the new vertex on each edge
+    // with the neighbouring triangle.
+    std::unordered_map<uint64_t, uint32_t> midpoints;
+    for (uint32_t level = 0; level < subdivisions; ++level)
+    {
+        midpoints.clear();
+        midpoints.reserve(indices.size() / 2);
+
+        auto midpoint = [&positions, &midpoints](uint32_t a, uint32_t b)
+        {
+            const uint64_t key = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+            auto inserted = midpoints.insert(std::make_pair(key, static_cast<uint32_t>(positions.size())));
+            if (inserted.second)
+            {
+                const XMVECTOR position = XMLoadFloat3(&positions[a]) + XMLoadFloat3(&positions[b]);
+                positions.push_back(ToFloat3(XMVector3Normalize(position)));
+            }
+            return inserted.first->second;
+        };
+
+        std::vector<uint32_t> subdivided;
+        subdivided.reserve(indices.size() * 4);
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            const uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+            const uint32_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+            const uint32_t split[12] = { a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca };
+            subdivided.insert(subdivided.end(), split, split + 12);
+        }
+        indices.swap(subdivided);
+    }
+
+    Mesh mesh;
+    mesh.Vertices.reserve(positions.size());
+    for (const XMFLOAT3& position : positions)
+    {
+        const XMVECTOR normal = XMLoadFloat3(&position);
+        const float u = 0.5f + std::atan2(position.z, position.x) / XM_2PI;
+        const float v = 0.5f - std::asin(position.y) / XM_PI;
+        AddVertex(mesh, normal * radius, normal, u, v, options.Color);
+    }
+    mesh.Indices.swap(indices);
+
+    return FinishMesh(std::move(mesh), options);
+}
+
+Mesh CreateGridMesh(float width, float depth, uint32_t columns, uint32_t rows, const MeshBuildOptions& options)
+{
+    columns = std::max(columns, 1u);
+    rows = std::max(rows, 1u);
+    const uint32_t stride = columns + 1;
+    const XMVECTOR normal = g_XMIdentityR1;
+
+    Mesh mesh;
+    mesh.Vertices.reserve((rows + 1) * stride);
+    mesh.Indices.reserve(rows * columns * 6);
+
+    for (uint32_t row = 0; row <= rows; ++row)
+    {
+        const float v = static_cast<float>(row) / rows;
+        for (uint32_t column = 0; column <= columns; ++column)
+        {
+            const float u = static_cast<float>(column) / columns;
+            const XMVECTOR position = XMVectorSet((u - 0.5f) * width, 0.0f, (0.5f - v) * depth, 0.0f);
+            AddVertex(mesh, position, normal, u, v, options.Color);
+        }
+    }
+
+    for (uint32_t row = 0; row < rows; ++row)
+    {
+        for (uint32_t column = 0; column < columns; ++column)
+        {
+            const uint32_t corner = row * stride + column;
+            AddQuad(mesh, corner, corner + stride, corner + stride + 1, corner + 1);
+        }
+    }
+
+    return FinishMesh(std::move(mesh), options);
+}
+
+Mesh CreateCylinderMesh(float radius, float height, uint32_t slices, uint32_t stacks, const MeshBuildOptions& options)
+{
+    slices = std::max(slices, 3u);
+    stacks = std::max(stacks, 1u);
+    const uint32_t stride = slices + 1;
+    const float halfHeight = height / 2;
+
+    Mesh mesh;
+    mesh.Vertices.reserve((stacks + 1) * stride + 2 * (slices + 1));
+    mesh.Indices.reserve(stacks * slices * 6 + 2 * slices * 3);
+
+    // Side, from the bottom ring up.
+    for (uint32_t i = 0; i <= stacks; ++i)
+    {
+        const float v = 1.0f - static_cast<float>(i) / stacks;
+        const float y = -halfHeight + height * i / stacks;
+        for (uint32_t j = 0; j <= slices; ++j)
+        {
+            const float u = static_cast<float>(j) / slices;
+            float dx, dz;
+            XMScalarSinCos(&dx, &dz, j * XM_2PI / slices);
+
+            const XMVECTOR normal = XMVectorSet(dx, 0.0f, dz, 0.0f);
+            AddVertex(mesh, XMVectorSet(dx * radius, y, dz * radius, 0.0f), normal, u, v, options.Color);
+        }
+    }
+
+    for (uint32_t i = 0; i < stacks; ++i)
+    {
+        for (uint32_t j = 0; j < slices; ++j)
+        {
+            const uint32_t corner = i * stride + j;
+            AddQuad(mesh, corner, corner + stride, corner + stride + 1, corner + 1);
+        }
+    }
+
+    // Caps: a center vertex and a fan around it.
+    for (int cap = 0; cap < 2; ++cap)
+    {
+        const bool top = (cap == 1);
+        const float y = top ? halfHeight : -halfHeight;
+        const XMVECTOR normal = XMVectorSet(0.0f, top ? 1.0f : -1.0f, 0.0f, 0.0f);
+
+        const uint32_t center = static_cast<uint32_t>(mesh.Vertices.size());
+        AddVertex(mesh, XMVectorSet(0.0f, y, 0.0f, 0.0f), normal, 0.5f, 0.5f, options.Color);
+        for (uint32_t j = 0; j < slices; ++j)
+        {
+            float dx, dz;
+            XMScalarSinCos(&dx, &dz, j * XM_2PI / slices);
+            AddVertex(mesh, XMVectorSet(dx * radius, y, dz * radius, 0.0f), normal, 0.5f + dx * 0.5f, 0.5f - dz * 0.5f, options.Color);
+        }
+
+        for (uint32_t j = 0; j < slices; ++j)
+        {
+            const uint32_t current = center + 1 + j;
+            const uint32_t next = center + 1 + (j + 1) % slices;
+            if (top)
+            {
+                AddTriangle(mesh, center, next, current);
+            }
+            else
+            {
+                AddTriangle(mesh, center, current, next);
+            }
+        }
+    }
+
+    return FinishMesh(std::move(mesh), options);
+}
+
+Mesh CreateTorusMesh(float majorRadius, float minorRadius, uint32_t majorSegments, uint32_t minorSegments,
+    const MeshBuildOptions& options)
+{
+    majorSegments = std::max(majorSegments, 3u);
+    minorSegments = std::max(minorSegments, 3u);
+    const uint32_t stride = minorSegments + 1;
+
+    Mesh mesh;
+    mesh.Vertices.reserve((majorSegments + 1) * stride);
+    mesh.Indices.reserve(majorSegments * minorSegments * 6);
+
+    for (uint32_t i = 0; i <= majorSegments; ++i)
+    {
+        const float u = static_cast<float>(i) / majorSegments;
+        float sinMajor, cosMajor;
+        XMScalarSinCos(&sinMajor, &cosMajor, i * XM_2PI / majorSegments);
+
+        const XMVECTOR tubeCenter = XMVectorSet(cosMajor * majorRadius, 0.0f, sinMajor * majorRadius, 0.0f);
+
+        for (uint32_t j = 0; j <= minorSegments; ++j)
+        {
+            const float v = static_cast<float>(j) / minorSegments;
+            float sinMinor, cosMinor;
+            XMScalarSinCos(&sinMinor, &cosMinor, j * XM_2PI / minorSegments);
+
+            const XMVECTOR normal = XMVectorSet(cosMajor * cosMinor, sinMinor, sinMajor * cosMinor, 0.0f);
+            AddVertex(mesh, tubeCenter + normal * minorRadius, normal, u, v, options.Color);
+        }
+    }
+
+    for (uint32_t i = 0; i < majorSegments; ++i)
+    {
+        for (uint32_t j = 0; j < minorSegments; ++j)
+        {
+            const uint32_t corner = i * stride + j;
+            AddQuad(mesh, corner, corner + stride, corner + stride + 1, corner + 1);
+        }
+    }
+
+    return FinishMesh(std::move(mesh), options);
+}
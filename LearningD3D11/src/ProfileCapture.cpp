@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "MappedFile.h"
+#include "ProfileCapture.h"
+
+namespace
+{
+    // Name as a JSON string, quotes included.
+    std::string QuoteJSON(const std::string& text)
+    {
+        std::string quoted("\"");
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                quoted.push_back('\\');
+                quoted.push_back(c);
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                quoted.append(escaped);
+            }
+            else
+            {
+                quoted.push_back(c);
+            }
+        }
+        quoted.push_back('"');
+        return quoted;
+    }
+}
+
+void ProfileRecorder::Collect()
+{
+    m_Events.clear();
+    m_Capture.DroppedEventCount += Profiler::Collect(m_Events);
+
+    for (const ProfileEvent& event : m_Events)
+    {
+        ProfileCaptureEvent captureEvent;
+        captureEvent.Name = GetNameIndex(event.Name);
+        captureEvent.Track = static_cast<uint16_t>(event.Track);
+        captureEvent.Depth = static_cast<uint16_t>(std::min<uint32_t>(event.Depth, UINT16_MAX));
+        captureEvent.Start = event.Start;
+        captureEvent.Duration = event.End - event.Start;
+        m_Sorted = m_Sorted && (m_Capture.Events.empty() || m_Capture.Events.back().Start <= captureEvent.Start);
+        m_Capture.Events.push_back(captureEvent);
+    }
+}
+
+void ProfileRecorder::Clear()
+{
+    m_Capture.Events.clear();
+    m_Capture.DroppedEventCount = 0;
+    m_Sorted = true;
+}
+
+const ProfileCapture& ProfileRecorder::GetCapture()
+{
+    if (!m_Sorted)
+    {
+        // Stable, so a zone stays ahead of the zones nested in it that start
+        // on the same tick.
+        std::stable_sort(m_Capture.Events.begin(), m_Capture.Events.end(), [](const ProfileCaptureEvent& a, const ProfileCaptureEvent& b)
+        {
+            return a.Start < b.Start;
+        });
+        m_Sorted = true;
+    }
+    m_Capture.TrackNames = Profiler::GetTrackNames();
+    return m_Capture;
+}
+
+uint32_t ProfileRecorder::GetNameIndex(const char* name)
+{
+    auto pointer = m_NamePointers.find(name);
+    if (pointer != m_NamePointers.end())
+    {
+        return pointer->second;
+    }
+
+    auto text = m_NameIndices.find(name);
+    uint32_t index;
+    if (text != m_NameIndices.end())
+    {
+        index = text->second;
+    }
+    else
+    {
+        index = static_cast<uint32_t>(m_Capture.Names.size());
+        m_Capture.Names.push_back(name);
+        m_NameIndices.emplace(name, index);
+    }
+    m_NamePointers.emplace(name, index);
+    return index;
+}
+
+bool WriteChromeTrace(const char* fileName, const ProfileCapture& capture)
+{
+    FILE* file = OpenFile(fileName, "wb");
+    if (!file)
+    {
+        return false;
+    }
+
+    // Timestamps are microseconds from the first event.
+    int64_t origin = 0;
+    for (size_t i = 0; i < capture.Events.size(); ++i)
+    {
+        origin = (i == 0) ? capture.Events[i].Start : std::min(origin, capture.Events[i].Start);
+    }
+
+    bool written = fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n") > 0;
+    for (size_t track = 0; written && track < capture.TrackNames.size(); ++track)
+    {
+        written = fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":%s}},\n"
+            "{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"sort_index\":%zu}},\n",
+            track, QuoteJSON(capture.TrackNames[track]).c_str(), track, track) > 0;
+    }
+
+    std::vector<std::string> quotedNames(capture.Names.size());
+    std::transform(capture.Names.begin(), capture.Names.end(), quotedNames.begin(), QuoteJSON);
+    for (size_t i = 0; written && i < capture.Events.size(); ++i)
+    {
+        const ProfileCaptureEvent& event = capture.Events[i];
+        written = fprintf(file, "{\"name\":%s,\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+            quotedNames[event.Name].c_str(), event.Track, (event.Start - origin) * 1e-3, event.Duration * 1e-3,
+            (i + 1 < capture.Events.size()) ? "," : "") > 0;
+    }
+    written = written && fprintf(file, "]}\n") > 0;
+
+    written = (fclose(file) == 0) && written;
+    if (!written)
+    {
+        RemoveFile(fileName);
+    }
+    return written;
+}
+
+bool WriteProfileCapture(const char* fileName, const ProfileCapture& capture)
+{
+    std::string strings;
+    for (const std::string& trackName : capture.TrackNames)
+    {
+        strings.append(trackName);
+        strings.push_back('\0');
+    }
+    for (const std::string& name : capture.Names)
+    {
+        strings.append(name);
+        strings.push_back('\0');
+    }
+    strings.resize(size_t(AlignOffset(strings.size(), 8)), '\0');
+
+    ProfileCaptureHeader header;
+    std::memset(&header, 0, sizeof(ProfileCaptureHeader));
+    header.Magic = ProfileCaptureMagic;
+    header.Version = ProfileCaptureVersion;
+    header.HeaderSize = sizeof(ProfileCaptureHeader);
+    header.TrackCount = static_cast<uint32_t>(capture.TrackNames.size());
+    header.NameCount = static_cast<uint32_t>(capture.Names.size());
+    header.EventCount = capture.Events.size();
+    header.StringSize = strings.size();
+    header.DroppedEventCount = capture.DroppedEventCount;
+
+    FILE* file = OpenFile(fileName, "wb");
+    if (!file)
+    {
+        return false;
+    }
+    bool written = fwrite(&header, sizeof(ProfileCaptureHeader), 1, file) == 1
+        && fwrite(strings.data(), 1, strings.size(), file) == strings.size()
+        && fwrite(capture.Events.data(), sizeof(ProfileCaptureEvent), capture.Events.size(), file) == capture.Events.size();
+    written = (fclose(file) == 0) && written;
+    if (!written)
+    {
+        RemoveFile(fileName);
+    }
+    return written;
+}
+
+bool ReadProfileCapture(const char* fileName, ProfileCapture& capture)
+{
+    FILE* file = OpenFile(fileName, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    ProfileCaptureHeader header;
+    std::memset(&header, 0, sizeof(ProfileCaptureHeader));
+    bool read = fread(&header, sizeof(ProfileCaptureHeader), 1, file) == 1
+        && header.Magic == ProfileCaptureMagic
+        && header.Version == ProfileCaptureVersion
+        && header.HeaderSize == sizeof(ProfileCaptureHeader)
+        && header.StringSize % 8 == 0 && header.StringSize < (uint64_t(1) << 32)
+        && header.EventCount < (uint64_t(1) << 40);
+
+    std::string strings;
+    if (read)
+    {
+        strings.resize(size_t(header.StringSize));
+        read = fread(&strings[0], 1, strings.size(), file) == strings.size();
+    }
+
+    std::vector<std::string> parsed;
+    for (size_t begin = 0; read && parsed.size() < uint64_t(header.TrackCount) + header.NameCount; )
+    {
+        const size_t end = strings.find('\0', begin);
+        read = end != std::string::npos;
+        if (read)
+        {
+            parsed.push_back(strings.substr(begin, end - begin));
+            begin = end + 1;
+        }
+    }
+
+    std::vector<ProfileCaptureEvent> events;
+    if (read)
+    {
+        events.resize(size_t(header.EventCount));
+        read = fread(events.data(), sizeof(ProfileCaptureEvent), events.size(), file) == events.size();
+    }
+    for (size_t i = 0; read && i < events.size(); ++i)
+    {
+        read = events[i].Name < header.NameCount && events[i].Track < header.TrackCount && events[i].Duration >= 0;
+    }
+    fclose(file);
+
+    if (read)
+    {
+        capture.TrackNames.assign(parsed.begin(), parsed.begin() + header.TrackCount);
+        capture.Names.assign(parsed.begin() + header.TrackCount, parsed.end());
+        capture.Events = std::move(events);
+        capture.DroppedEventCount = header.DroppedEventCount;
+    }
+    return read;
+}
@@ -0,0 +1,145 @@
+#include <memory>
+#include <mutex>
+#include "Profiler.h"
+
+namespace
+{
+    struct ProfilerState
+    {
+        std::mutex Mutex;
+        std::vector<std::unique_ptr<ProfileEventRing>> Rings;
+        // Rings of exited threads, ready for the next new thread.
+        std::vector<ProfileEventRing*> FreeRings;
+        std::vector<std::string> TrackNames;
+        // Tracks renamed with SetThreadName; their rings are not reused.
+        std::vector<bool> NamedTracks;
+    };
+
+    ProfilerState& GetState()
+    {
+        static ProfilerState state;
+        return state;
+    }
+
+    // Hands the thread's ring back when the thread exits.
+    struct ThreadRingOwner
+    {
+        ThreadRingOwner() : Ring(nullptr) {}
+        ~ThreadRingOwner()
+        {
+            if (Ring)
+            {
+                ProfilerState& state = GetState();
+                std::lock_guard<std::mutex> lock(state.Mutex);
+                if (!state.NamedTracks[Ring->GetTrack()])
+                {
+                    state.FreeRings.push_back(Ring);
+                }
+            }
+        }
+
+        ProfileEventRing* Ring;
+    };
+
+    thread_local ThreadRingOwner t_ThreadRing;
+
+    uint32_t AddTrack(ProfilerState& state, const std::string& name)
+    {
+        state.TrackNames.push_back(name);
+        state.NamedTracks.push_back(false);
+        return static_cast<uint32_t>(state.TrackNames.size() - 1);
+    }
+}
+
+std::atomic<bool> Profiler::s_Enabled(false);
+
+ProfileEventRing::ProfileEventRing(uint32_t track, size_t capacity)
+    : m_Track(track)
+    , m_Depth(0)
+    , m_Head(0)
+    , m_Tail(0)
+    , m_DroppedCount(0)
+{
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    m_Events.resize(size);
+    m_Mask = size - 1;
+}
+
+uint64_t ProfileEventRing::Drain(std::vector<ProfileEvent>& events)
+{
+    const uint64_t tail = m_Tail.load(std::memory_order_relaxed);
+    const uint64_t head = m_Head.load(std::memory_order_acquire);
+    for (uint64_t i = tail; i < head; ++i)
+    {
+        events.push_back(m_Events[i & m_Mask]);
+    }
+    m_Tail.store(head, std::memory_order_release);
+    return m_DroppedCount.exchange(0, std::memory_order_relaxed);
+}
+
+ProfileEventRing& Profiler::GetThreadRing()
+{
+    if (!t_ThreadRing.Ring)
+    {
+        ProfilerState& state = GetState();
+        std::lock_guard<std::mutex> lock(state.Mutex);
+        if (!state.FreeRings.empty())
+        {
+            t_ThreadRing.Ring = state.FreeRings.back();
+            state.FreeRings.pop_back();
+        }
+        else
+        {
+            const uint32_t track = AddTrack(state, "Worker " + std::to_string(state.Rings.size()));
+            state.Rings.emplace_back(new ProfileEventRing(track, RingCapacity));
+            t_ThreadRing.Ring = state.Rings.back().get();
+        }
+    }
+    return *t_ThreadRing.Ring;
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+    const uint32_t track = GetThreadRing().GetTrack();
+    ProfilerState& state = GetState();
+    std::lock_guard<std::mutex> lock(state.Mutex);
+    state.TrackNames[track] = name;
+    state.NamedTracks[track] = true;
+}
+
+uint32_t Profiler::CreateTrack(const char* name)
+{
+    ProfilerState& state = GetState();
+    std::lock_guard<std::mutex> lock(state.Mutex);
+    const uint32_t track = AddTrack(state, name);
+    state.NamedTracks[track] = true;
+    return track;
+}
+
+void Profiler::RecordEvent(uint32_t track, const char* name, int64_t start, int64_t end, uint32_t depth)
+{
+    GetThreadRing().Record(name, start, end, track, depth);
+}
+
+uint64_t Profiler::Collect(std::vector<ProfileEvent>& events)
+{
+    ProfilerState& state = GetState();
+    std::lock_guard<std::mutex> lock(state.Mutex);
+    uint64_t droppedCount = 0;
+    for (const std::unique_ptr<ProfileEventRing>& ring : state.Rings)
+    {
+        droppedCount += ring->Drain(events);
+    }
+    return droppedCount;
+}
+
+std::vector<std::string> Profiler::GetTrackNames()
+{
+    ProfilerState& state = GetState();
+    std::lock_guard<std::mutex> lock(state.Mutex);
+    return state.TrackNames;
+}
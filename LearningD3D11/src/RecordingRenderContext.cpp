@@ -0,0 +1,66 @@
+#include "RecordingRenderContext.h"
+
+void RecordingRenderContext::Record(CommandType type, uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e)
+{
+    Command command = { type, { a, b, c, d, e } };
+    m_Commands.push_back(command);
+}
+
+void RecordingRenderContext::SetInputLayout(uint8_t inputLayout)
+{
+    Record(CMD_SetInputLayout, inputLayout);
+}
+
+void RecordingRenderContext::SetVertexShader(uint8_t vertexShader)
+{
+    Record(CMD_SetVertexShader, vertexShader);
+}
+
+void RecordingRenderContext::SetPixelShader(uint8_t pixelShader)
+{
+    Record(CMD_SetPixelShader, pixelShader);
+}
+
+void RecordingRenderContext::SetVertexBuffers(uint8_t vertexBuffer, uint8_t instanceBuffer)
+{
+    Record(CMD_SetVertexBuffers, vertexBuffer, instanceBuffer);
+}
+
+void RecordingRenderContext::SetIndexBuffer(uint8_t indexBuffer)
+{
+    Record(CMD_SetIndexBuffer, indexBuffer);
+}
+
+void RecordingRenderContext::SetObjectConstants(uint32_t objectConstants)
+{
+    Record(CMD_SetObjectConstants, objectConstants);
+}
+
+void RecordingRenderContext::SetMaterial(uint16_t material)
+{
+    Record(CMD_SetMaterial, material);
+}
+
+void RecordingRenderContext::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex,
+    uint32_t startInstance)
+{
+    Record(CMD_DrawIndexedInstanced, indexCount, instanceCount, startIndex, static_cast<uint32_t>(baseVertex), startInstance);
+}
+
+size_t RecordingRenderContext::GetCommandCount(CommandType type) const
+{
+    size_t count = 0;
+    for (const Command& command : m_Commands)
+    {
+        if (command.Type == type)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t RecordingRenderContext::GetStateChangeCount() const
+{
+    return m_Commands.size() - GetCommandCount(CMD_DrawIndexedInstanced);
+}
@@ -0,0 +1,64 @@
+#include <algorithm>
+#include "RecordingTextureUploadSink.h"
+
+namespace
+{
+    const uint32_t NotResident = 0xFFFFFFFF;
+}
+
+RecordingTextureUploadSink::RecordingTextureUploadSink()
+    : m_BytesResident(0)
+    , m_PeakBytesResident(0)
+    , m_UploadCount(0)
+    , m_TrimCount(0)
+    , m_ErrorCount(0)
+{
+}
+
+bool RecordingTextureUploadSink::Upload(TextureHandle texture, const TextureImage& image, uint32_t firstMip)
+{
+    if (texture >= m_Textures.size())
+    {
+        m_Textures.resize(texture + 1, ResidentTexture{ 0, 0, TF_RGBA8, 0, NotResident });
+    }
+    ResidentTexture& resident = m_Textures[texture];
+    if (firstMip >= image.GetMipCount())
+    {
+        ++m_ErrorCount;
+        return false;
+    }
+
+    if (resident.FirstMip != NotResident)
+    {
+        m_BytesResident -= GetMipChainSize(resident.Format, resident.Width, resident.Height, resident.MipCount, resident.FirstMip);
+    }
+    resident.Width = image.Width;
+    resident.Height = image.Height;
+    resident.Format = image.Format;
+    resident.MipCount = image.GetMipCount();
+    resident.FirstMip = firstMip;
+    m_BytesResident += GetMipChainSize(resident.Format, resident.Width, resident.Height, resident.MipCount, resident.FirstMip);
+    m_PeakBytesResident = std::max(m_PeakBytesResident, m_BytesResident);
+    ++m_UploadCount;
+    return true;
+}
+
+bool RecordingTextureUploadSink::Trim(TextureHandle texture, uint32_t firstMip)
+{
+    if (texture >= m_Textures.size() || m_Textures[texture].FirstMip == NotResident
+        || firstMip <= m_Textures[texture].FirstMip || firstMip >= m_Textures[texture].MipCount)
+    {
+        ++m_ErrorCount;
+        return false;
+    }
+    ResidentTexture& resident = m_Textures[texture];
+    m_BytesResident -= GetMipChainSize(resident.Format, resident.Width, resident.Height, firstMip, resident.FirstMip);
+    resident.FirstMip = firstMip;
+    ++m_TrimCount;
+    return true;
+}
+
+uint32_t RecordingTextureUploadSink::GetResidentMip(TextureHandle texture) const
+{
+    return (texture < m_Textures.size()) ? m_Textures[texture].FirstMip : NotResident;
+}
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cassert>
+#include "RenderQueue.h"
+
+uint64_t MakeSortKey(RenderPass pass, uint8_t vertexShader, uint8_t pixelShader, uint8_t inputLayout,
+    uint32_t material, uint32_t depth)
+{
+    assert(vertexShader < 64 && pixelShader < 64 && inputLayout < 64);
+    assert(material < (1u << 18) && depth < (1u << 24));
+
+    return (static_cast<uint64_t>(pass) << 60) |
+        (static_cast<uint64_t>(vertexShader) << 54) |
+        (static_cast<uint64_t>(pixelShader) << 48) |
+        (static_cast<uint64_t>(inputLayout) << 42) |
+        (static_cast<uint64_t>(material) << 24) |
+        static_cast<uint64_t>(depth);
+}
+
+uint32_t QuantizeDepth(RenderPass pass, float viewDepth, float farPlane)
+{
+    const uint32_t maxDepth = (1u << 24) - 1;
+    const float normalizedDepth = std::min(std::max(viewDepth / farPlane, 0.0f), 1.0f);
+    const uint32_t depth = static_cast<uint32_t>(normalizedDepth * maxDepth);
+    return pass == RP_Transparent ? maxDepth - depth : depth;
+}
+
+// m_Bound is zeroed so that Draw's comparisons read defined values before
+// the first packet; m_Valid still forces every bind of that packet.
+RenderStateCache::RenderStateCache()
+    : m_Bound()
+{
+    Invalidate();
+    ResetCounters();
+}
+
+void RenderStateCache::Invalidate()
+{
+    m_Valid = false;
+}
+
+void RenderStateCache::ResetCounters()
+{
+    m_StateChangeCount = 0;
+    m_SkippedStateChangeCount = 0;
+    m_DrawCount = 0;
+}
+
+void RenderStateCache::Draw(RenderContext& context, const DrawPacket& packet)
+{
+    // Bind one piece of state unless the shadow copy says it is already bound.
+    auto bind = [&](bool changed, auto&& apply)
+    {
+        if (changed || !m_Valid)
+        {
+            apply();
+            m_StateChangeCount++;
+        }
+        else
+        {
+            m_SkippedStateChangeCount++;
+        }
+    };
+
+    bind(packet.InputLayout != m_Bound.InputLayout, [&]() { context.SetInputLayout(packet.InputLayout); });
+    bind(packet.VertexShader != m_Bound.VertexShader, [&]() { context.SetVertexShader(packet.VertexShader); });
+    bind(packet.PixelShader != m_Bound.PixelShader, [&]() { context.SetPixelShader(packet.PixelShader); });
+    bind(packet.VertexBuffer != m_Bound.VertexBuffer || packet.InstanceBuffer != m_Bound.InstanceBuffer,
+        [&]() { context.SetVertexBuffers(packet.VertexBuffer, packet.InstanceBuffer); });
+    bind(packet.IndexBuffer != m_Bound.IndexBuffer, [&]() { context.SetIndexBuffer(packet.IndexBuffer); });
+    bind(packet.ObjectConstants != m_Bound.ObjectConstants, [&]() { context.SetObjectConstants(packet.ObjectConstants); });
+    bind(packet.Material != m_Bound.Material, [&]() { context.SetMaterial(packet.Material); });
+
+    m_Bound = packet;
+    m_Valid = true;
+
+    context.DrawIndexedInstanced(packet.IndexCount, packet.InstanceCount, packet.StartIndex, packet.BaseVertex, packet.StartInstance);
+    m_DrawCount++;
+}
+
+void RenderQueue::Clear()
+{
+    m_Packets.clear();
+    m_Sorted = false;
+}
+
+void RenderQueue::Reserve(size_t count)
+{
+    m_Packets.reserve(count);
+}
+
+void RenderQueue::Submit(const DrawPacket& packet)
+{
+    m_Packets.push_back(packet);
+    m_Sorted = false;
+}
+
+void RenderQueue::Sort()
+{
+    const size_t count = m_Packets.size();
+
+    m_Keys.resize(count);
+    m_KeysScratch.resize(count);
+    m_Order.resize(count);
+    m_OrderScratch.resize(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_Keys[i] = m_Packets[i].SortKey;
+        m_Order[i] = static_cast<uint32_t>(i);
+    }
+
+    for (unsigned int shift = 0; shift < 64; shift += 8)
+    {
+        size_t histogram[256] = {};
+        for (size_t i = 0; i < count; ++i)
+        {
+            histogram[(m_Keys[i] >> shift) & 0xFF]++;
+        }
+
+        // All keys share this digit, nothing would move.
+        if (count == 0 || histogram[(m_Keys[0] >> shift) & 0xFF] == count)
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t& bucket : histogram)
+        {
+            const size_t bucketCount = bucket;
+            bucket = offset;
+            offset += bucketCount;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const size_t destination = histogram[(m_Keys[i] >> shift) & 0xFF]++;
+            m_KeysScratch[destination] = m_Keys[i];
+            m_OrderScratch[destination] = m_Order[i];
+        }
+
+        m_Keys.swap(m_KeysScratch);
+        m_Order.swap(m_OrderScratch);
+    }
+
+    m_Sorted = true;
+}
+
+void RenderQueue::Execute(RenderContext& context, RenderStateCache& cache) const
+{
+    if (m_Sorted)
+    {
+        for (uint32_t index : m_Order)
+        {
+            cache.Draw(context, m_Packets[index]);
+        }
+    }
+    else
+    {
+        for (const DrawPacket& packet : m_Packets)
+        {
+            cache.Draw(context, packet);
+        }
+    }
+}
+
+void RenderQueue::Execute(RenderContext& context, RenderStateCache& cache, RenderPass pass) const
+{
+    if (m_Sorted)
+    {
+        size_t begin = 0;
+        size_t end = 0;
+        GetPassRange(pass, begin, end);
+        Execute(context, cache, begin, end);
+    }
+    else
+    {
+        for (const DrawPacket& packet : m_Packets)
+        {
+            if ((packet.SortKey >> 60) == static_cast<uint64_t>(pass))
+            {
+                cache.Draw(context, packet);
+            }
+        }
+    }
+}
+
+void RenderQueue::Execute(RenderContext& context, RenderStateCache& cache, size_t begin, size_t end) const
+{
+    assert(begin <= end && end <= m_Packets.size());
+    for (size_t i = begin; i < end; ++i)
+    {
+        cache.Draw(context, m_Packets[m_Sorted ? m_Order[i] : i]);
+    }
+}
+
+void RenderQueue::GetPassRange(RenderPass pass, size_t& begin, size_t& end) const
+{
+    // The pass is the top digit of the keys.
+    const uint64_t passBegin = static_cast<uint64_t>(pass) << 60;
+    const uint64_t passEnd = passBegin + (uint64_t(1) << 60);
+    if (m_Sorted)
+    {
+        begin = std::lower_bound(m_Keys.begin(), m_Keys.end(), passBegin) - m_Keys.begin();
+        end = std::lower_bound(m_Keys.begin() + begin, m_Keys.end(), passEnd) - m_Keys.begin();
+    }
+    else
+    {
+        auto inPass = [&](const DrawPacket& packet) { return packet.SortKey >= passBegin && packet.SortKey < passEnd; };
+        begin = std::find_if(m_Packets.begin(), m_Packets.end(), inPass) - m_Packets.begin();
+        end = std::find_if_not(m_Packets.begin() + begin, m_Packets.end(), inPass) - m_Packets.begin();
+        assert(std::none_of(m_Packets.begin() + end, m_Packets.end(), inPass));
+    }
+}
@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <cassert>
+#include "Scene.h"
+#include "ParallelFor.h"
+
+namespace
+{
+    const uint32_t InvalidIndex = 0xFFFFFFFF;
+
+    // Entities per ParallelFor chunk.
+    const size_t UpdateGrainSize = 1024;
+}
+
+Entity Scene::CreateEntity()
+{
+    Entity entity;
+    if (!m_FreeEntities.empty())
+    {
+        entity = m_FreeEntities.back();
+        m_FreeEntities.pop_back();
+    }
+    else
+    {
+        entity = static_cast<Entity>(m_EntityToIndex.size());
+        m_EntityToIndex.push_back(InvalidIndex);
+    }
+
+    m_EntityToIndex[entity] = static_cast<uint32_t>(m_Entities.size());
+    m_Entities.push_back(entity);
+
+    XMFLOAT4X4A identity;
+    XMStoreFloat4x4A(&identity, XMMatrixIdentity());
+
+    m_Positions.push_back(XMFLOAT3(0.0f, 0.0f, 0.0f));
+    m_Rotations.push_back(XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+    m_PreviousPositions.push_back(m_Positions.back());
+    m_PreviousRotations.push_back(m_Rotations.back());
+    m_Scales.push_back(XMFLOAT3(1.0f, 1.0f, 1.0f));
+    m_LinearVelocities.push_back(XMFLOAT3(0.0f, 0.0f, 0.0f));
+    m_AngularVelocities.push_back(XMFLOAT3(0.0f, 0.0f, 0.0f));
+    m_MaterialIndices.push_back(0);
+    m_TransformClasses.push_back(TC_Rigid);
+    m_Parents.push_back(InvalidEntity);
+    m_WorldMatrices.push_back(identity);
+    m_InverseTransposeWorldMatrices.push_back(identity);
+
+    return entity;
+}
+
+void Scene::DestroyEntity(Entity entity)
+{
+    assert(IsAlive(entity));
+
+    // Detach the entity and its children before its handle is recycled.
+    if (m_ChildCount > 0)
+    {
+        SetParent(entity, InvalidEntity);
+        for (size_t i = 0; i < m_Parents.size() && m_ChildCount > 0; ++i)
+        {
+            if (m_Parents[i] == entity)
+            {
+                m_Parents[i] = InvalidEntity;
+                --m_ChildCount;
+                m_HierarchyDirty = true;
+            }
+        }
+    }
+
+    // Move the last entity into the hole to keep the arrays dense.
+    const uint32_t index = m_EntityToIndex[entity];
+    const uint32_t lastIndex = static_cast<uint32_t>(m_Entities.size() - 1);
+    if (index != lastIndex)
+    {
+        const Entity lastEntity = m_Entities[lastIndex];
+        m_Entities[index] = lastEntity;
+        m_Positions[index] = m_Positions[lastIndex];
+        m_Rotations[index] = m_Rotations[lastIndex];
+        m_PreviousPositions[index] = m_PreviousPositions[lastIndex];
+        m_PreviousRotations[index] = m_PreviousRotations[lastIndex];
+        m_Scales[index] = m_Scales[lastIndex];
+        m_LinearVelocities[index] = m_LinearVelocities[lastIndex];
+        m_AngularVelocities[index] = m_AngularVelocities[lastIndex];
+        m_MaterialIndices[index] = m_MaterialIndices[lastIndex];
+        m_TransformClasses[index] = m_TransformClasses[lastIndex];
+        m_Parents[index] = m_Parents[lastIndex];
+        m_WorldMatrices[index] = m_WorldMatrices[lastIndex];
+        m_InverseTransposeWorldMatrices[index] = m_InverseTransposeWorldMatrices[lastIndex];
+        m_EntityToIndex[lastEntity] = index;
+    }
+
+    m_Entities.pop_back();
+    m_Positions.pop_back();
+    m_Rotations.pop_back();
+    m_PreviousPositions.pop_back();
+    m_PreviousRotations.pop_back();
+    m_Scales.pop_back();
+    m_LinearVelocities.pop_back();
+    m_AngularVelocities.pop_back();
+    m_MaterialIndices.pop_back();
+    m_TransformClasses.pop_back();
+    m_Parents.pop_back();
+    m_WorldMatrices.pop_back();
+    m_InverseTransposeWorldMatrices.pop_back();
+
+    m_EntityToIndex[entity] = InvalidIndex;
+    m_FreeEntities.push_back(entity);
+}
+
+bool Scene::IsAlive(Entity entity) const
+{
+    return entity < m_EntityToIndex.size() && m_EntityToIndex[entity] != InvalidIndex;
+}
+
+void Scene::Reserve(size_t count)
+{
+    m_EntityToIndex.reserve(count);
+    m_Entities.reserve(count);
+    m_Positions.reserve(count);
+    m_Rotations.reserve(count);
+    m_PreviousPositions.reserve(count);
+    m_PreviousRotations.reserve(count);
+    m_Scales.reserve(count);
+    m_LinearVelocities.reserve(count);
+    m_AngularVelocities.reserve(count);
+    m_MaterialIndices.reserve(count);
+    m_TransformClasses.reserve(count);
+    m_Parents.reserve(count);
+    m_WorldMatrices.reserve(count);
+    m_InverseTransposeWorldMatrices.reserve(count);
+}
+
+void Scene::SetPosition(Entity entity, const XMFLOAT3& position)
+{
+    m_Positions[GetIndex(entity)] = position;
+}
+
+void Scene::SetRotation(Entity entity, FXMVECTOR rotationQuaternion)
+{
+    XMStoreFloat4(&m_Rotations[GetIndex(entity)], rotationQuaternion);
+}
+
+void Scene::SetScale(Entity entity, const XMFLOAT3& scale)
+{
+    const size_t index = GetIndex(entity);
+    m_Scales[index] = scale;
+    m_TransformClasses[index] = ClassifyScale(scale);
+}
+
+void Scene::SetLinearVelocity(Entity entity, const XMFLOAT3& linearVelocity)
+{
+    m_LinearVelocities[GetIndex(entity)] = linearVelocity;
+}
+
+void Scene::SetAngularVelocity(Entity entity, const XMFLOAT3& angularVelocity)
+{
+    m_AngularVelocities[GetIndex(entity)] = angularVelocity;
+}
+
+void Scene::SetMaterialIndex(Entity entity, uint32_t materialIndex)
+{
+    m_MaterialIndices[GetIndex(entity)] = materialIndex;
+}
+
+void Scene::SetParent(Entity entity, Entity parent)
+{
+    assert(parent == InvalidEntity || IsAlive(parent));
+    for (Entity ancestor = parent; ancestor != InvalidEntity; ancestor = GetParent(ancestor))
+    {
+        assert(ancestor != entity);
+    }
+
+    Entity& currentParent = m_Parents[GetIndex(entity)];
+    if (currentParent == parent)
+    {
+        return;
+    }
+    m_ChildCount += (parent != InvalidEntity) ? 1 : 0;
+    m_ChildCount -= (currentParent != InvalidEntity) ? 1 : 0;
+    currentParent = parent;
+    m_HierarchyDirty = true;
+}
+
+XMMATRIX Scene::GetWorldMatrix(Entity entity) const
+{
+    return XMLoadFloat4x4A(&m_WorldMatrices[GetIndex(entity)]);
+}
+
+XMMATRIX Scene::GetInverseTransposeWorldMatrix(Entity entity) const
+{
+    return XMLoadFloat4x4A(&m_InverseTransposeWorldMatrices[GetIndex(entity)]);
+}
+
+void Scene::SaveState()
+{
+    m_PreviousPositions = m_Positions;
+    m_PreviousRotations = m_Rotations;
+}
+
+void Scene::Integrate(float deltaTime)
+{
+    ParallelFor(m_Entities.size(), UpdateGrainSize, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const XMVECTOR position = XMLoadFloat3(&m_Positions[i]);
+            XMStoreFloat3(&m_Positions[i], XMVectorMultiplyAdd(XMLoadFloat3(&m_LinearVelocities[i]), XMVectorReplicate(deltaTime), position));
+
+            const XMVECTOR angularVelocity = XMLoadFloat3(&m_AngularVelocities[i]);
+            const float angularSpeed = XMVectorGetX(XMVector3Length(angularVelocity));
+            if (angularSpeed > 0.0f)
+            {
+                const XMVECTOR deltaRotation = XMQuaternionRotationNormal(angularVelocity / angularSpeed, angularSpeed * deltaTime);
+                const XMVECTOR rotation = XMQuaternionMultiply(XMLoadFloat4(&m_Rotations[i]), deltaRotation);
+                XMStoreFloat4(&m_Rotations[i], XMQuaternionNormalize(rotation));
+            }
+        }
+    });
+}
+
+void Scene::SortHierarchy()
+{
+    // Depth first, so a parent, being one level shallower, always comes
+    // before its children.
+    std::vector<std::pair<uint32_t, Entity>> depths;
+    depths.reserve(m_ChildCount);
+    for (size_t i = 0; i < m_Entities.size(); ++i)
+    {
+        if (m_Parents[i] != InvalidEntity)
+        {
+            uint32_t depth = 0;
+            for (Entity ancestor = m_Parents[i]; ancestor != InvalidEntity; ancestor = GetParent(ancestor))
+            {
+                ++depth;
+            }
+            depths.push_back(std::make_pair(depth, m_Entities[i]));
+        }
+    }
+    std::sort(depths.begin(), depths.end());
+
+    m_HierarchyOrder.clear();
+    for (const std::pair<uint32_t, Entity>& depth : depths)
+    {
+        m_HierarchyOrder.push_back(depth.second);
+    }
+    m_HierarchyDirty = false;
+}
+
+void Scene::Interpolate(float alpha)
+{
+    // At alpha 1 the current state is used as it is, which also covers
+    // callers that never save a state.
+    const bool current = alpha >= 1.0f;
+    const bool hierarchy = m_ChildCount > 0;
+    ParallelFor(m_Entities.size(), UpdateGrainSize, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            XMVECTOR position = XMLoadFloat3(&m_Positions[i]);
+            XMVECTOR rotation = XMLoadFloat4(&m_Rotations[i]);
+            if (!current)
+            {
+                position = XMVectorLerp(XMLoadFloat3(&m_PreviousPositions[i]), position, alpha);
+                rotation = XMQuaternionSlerp(XMLoadFloat4(&m_PreviousRotations[i]), rotation, alpha);
+            }
+
+            const XMMATRIX worldMatrix = ComposeTransform(XMLoadFloat3(&m_Scales[i]), rotation, position);
+            XMStoreFloat4x4A(&m_WorldMatrices[i], worldMatrix);
+        }
+
+        if (!hierarchy)
+        {
+            ComputeInverseTransposeWorldMatrices(&m_WorldMatrices[begin], &m_TransformClasses[begin], end - begin,
+                &m_InverseTransposeWorldMatrices[begin]);
+        }
+    });
+
+    if (!hierarchy)
+    {
+        return;
+    }
+
+    // Children hold their local matrices so far. Their parents' are final
+    // by the time they are reached.
+    if (m_HierarchyDirty)
+    {
+        SortHierarchy();
+    }
+    m_WorldTransformClasses = m_TransformClasses;
+    for (Entity entity : m_HierarchyOrder)
+    {
+        const size_t index = GetIndex(entity);
+        const size_t parentIndex = GetIndex(m_Parents[index]);
+        const XMMATRIX worldMatrix = XMLoadFloat4x4A(&m_WorldMatrices[index]) * XMLoadFloat4x4A(&m_WorldMatrices[parentIndex]);
+        XMStoreFloat4x4A(&m_WorldMatrices[index], worldMatrix);
+        m_WorldTransformClasses[index] = CombineTransformClass(m_TransformClasses[index], m_WorldTransformClasses[parentIndex]);
+    }
+
+    ParallelFor(m_Entities.size(), UpdateGrainSize, [&](size_t begin, size_t end)
+    {
+        ComputeInverseTransposeWorldMatrices(&m_WorldMatrices[begin], &m_WorldTransformClasses[begin], end - begin,
+            &m_InverseTransposeWorldMatrices[begin]);
+    });
+}
+
+void Scene::Update(float deltaTime)
+{
+    Integrate(deltaTime);
+    Interpolate(1.0f);
+}
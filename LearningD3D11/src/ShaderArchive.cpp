@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "ShaderArchive.h"
+
+namespace
+{
+    bool WriteZeros(FILE* file, uint64_t count)
+    {
+        static const uint8_t zeros[ShaderArchiveAlignment] = {};
+        while (count > 0)
+        {
+            const size_t chunk = static_cast<size_t>(std::min<uint64_t>(count, sizeof(zeros)));
+            if (fwrite(zeros, 1, chunk, file) != chunk)
+            {
+                return false;
+            }
+            count -= chunk;
+        }
+        return true;
+    }
+}
+
+std::string MakeShaderKey(const char* name, const char* profile, const ShaderDefine* defines, size_t defineCount)
+{
+    std::string key(name);
+    key.push_back('\0');
+    key.append(profile);
+    key.push_back('\0');
+
+    std::vector<const ShaderDefine*> sortedDefines(defineCount);
+    for (size_t i = 0; i < defineCount; ++i)
+    {
+        sortedDefines[i] = &defines[i];
+    }
+    std::sort(sortedDefines.begin(), sortedDefines.end(), [](const ShaderDefine* a, const ShaderDefine* b)
+    {
+        return std::strcmp(a->Name, b->Name) < 0;
+    });
+    for (const ShaderDefine* define : sortedDefines)
+    {
+        key.append(define->Name);
+        key.push_back('=');
+        key.append(define->Value ? define->Value : "1");
+        key.push_back('\0');
+    }
+    return key;
+}
+
+uint64_t HashShaderKey(const char* key, size_t length)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= static_cast<uint8_t>(key[i]);
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+bool ShaderArchiveBuilder::Add(const char* name, const char* profile, const ShaderDefine* defines, size_t defineCount,
+    const void* bytecode, size_t bytecodeSize)
+{
+    if (bytecodeSize == 0 || bytecodeSize > UINT32_MAX)
+    {
+        return false;
+    }
+
+    Shader shader;
+    shader.Key = MakeShaderKey(name, profile, defines, defineCount);
+    shader.KeyHash = HashShaderKey(shader.Key.data(), shader.Key.size());
+    for (const Shader& existing : m_Shaders)
+    {
+        if (existing.KeyHash == shader.KeyHash && existing.Key == shader.Key)
+        {
+            return false;
+        }
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(bytecode);
+    shader.Bytecode.assign(bytes, bytes + bytecodeSize);
+    m_Shaders.push_back(std::move(shader));
+    return true;
+}
+
+bool ShaderArchiveBuilder::Write(const char* fileName) const
+{
+    // At most half full, so probe sequences stay short.
+    uint32_t bucketCount = 1;
+    while (bucketCount < m_Shaders.size() * 2)
+    {
+        bucketCount *= 2;
+    }
+
+    ShaderArchiveHeader header;
+    std::memset(&header, 0, sizeof(ShaderArchiveHeader));
+    header.Magic = ShaderArchiveMagic;
+    header.Version = ShaderArchiveVersion;
+    header.HeaderSize = sizeof(ShaderArchiveHeader);
+    header.EntryCount = static_cast<uint32_t>(m_Shaders.size());
+    header.BucketCount = bucketCount;
+    header.TableOffset = sizeof(ShaderArchiveHeader);
+    header.KeyOffset = header.TableOffset + uint64_t(bucketCount) * sizeof(ShaderArchiveEntry);
+
+    std::vector<ShaderArchiveEntry> entries(bucketCount);
+    std::memset(entries.data(), 0, entries.size() * sizeof(ShaderArchiveEntry));
+    std::string keys;
+    uint64_t dataSize = 0;
+    for (const Shader& shader : m_Shaders)
+    {
+        uint32_t bucket = static_cast<uint32_t>(shader.KeyHash) & (bucketCount - 1);
+        while (entries[bucket].KeyLength != 0)
+        {
+            bucket = (bucket + 1) & (bucketCount - 1);
+        }
+        ShaderArchiveEntry& entry = entries[bucket];
+        entry.KeyHash = shader.KeyHash;
+        entry.KeyOffset = static_cast<uint32_t>(keys.size());
+        entry.KeyLength = static_cast<uint32_t>(shader.Key.size());
+        entry.DataOffset = dataSize;     // Relative for now.
+        entry.DataSize = static_cast<uint32_t>(shader.Bytecode.size());
+        keys.append(shader.Key);
+        dataSize = AlignOffset(dataSize + shader.Bytecode.size(), ShaderArchiveAlignment);
+    }
+    header.KeySize = keys.size();
+    header.DataOffset = AlignOffset(header.KeyOffset + header.KeySize, ShaderArchiveAlignment);
+    header.FileSize = header.DataOffset + dataSize;
+    for (ShaderArchiveEntry& entry : entries)
+    {
+        if (entry.KeyLength != 0)
+        {
+            entry.DataOffset += header.DataOffset;
+        }
+    }
+
+    FILE* file = OpenFile(fileName, "wb");
+    if (!file)
+    {
+        return false;
+    }
+    bool written = fwrite(&header, sizeof(ShaderArchiveHeader), 1, file) == 1
+        && fwrite(entries.data(), sizeof(ShaderArchiveEntry), entries.size(), file) == entries.size()
+        && fwrite(keys.data(), 1, keys.size(), file) == keys.size()
+        && WriteZeros(file, header.DataOffset - header.KeyOffset - header.KeySize);
+    for (size_t i = 0; written && i < m_Shaders.size(); ++i)
+    {
+        const std::vector<uint8_t>& bytecode = m_Shaders[i].Bytecode;
+        written = fwrite(bytecode.data(), 1, bytecode.size(), file) == bytecode.size()
+            && WriteZeros(file, AlignOffset(bytecode.size(), ShaderArchiveAlignment) - bytecode.size());
+    }
+    written = (fclose(file) == 0) && written;
+    if (!written)
+    {
+        RemoveFile(fileName);
+    }
+    return written;
+}
+
+ShaderArchive::ShaderArchive()
+    : m_Data(nullptr)
+    , m_Header(nullptr)
+    , m_Entries(nullptr)
+    , m_Keys(nullptr)
+{
+}
+
+ShaderArchive::~ShaderArchive()
+{
+    Close();
+}
+
+bool ShaderArchive::Open(const char* fileName)
+{
+    Close();
+
+    // Random access: only the table and the shaders that are used get
+    // touched.
+    if (!m_File.Open(fileName, FAP_Random) || m_File.GetSize() < sizeof(ShaderArchiveHeader))
+    {
+        Close();
+        return false;
+    }
+    m_Data = m_File.GetData();
+
+    const ShaderArchiveHeader* header = reinterpret_cast<const ShaderArchiveHeader*>(m_Data);
+    const uint64_t size = m_File.GetSize();
+    bool valid = header->Magic == ShaderArchiveMagic
+        && header->Version == ShaderArchiveVersion
+        && header->HeaderSize == sizeof(ShaderArchiveHeader)
+        && header->FileSize == size
+        && header->BucketCount > 0 && (header->BucketCount & (header->BucketCount - 1)) == 0
+        && header->EntryCount < header->BucketCount
+        && header->TableOffset % sizeof(uint64_t) == 0
+        && IsRangeInFile(header->TableOffset, uint64_t(header->BucketCount) * sizeof(ShaderArchiveEntry), size)
+        && IsRangeInFile(header->KeyOffset, header->KeySize, size);
+    if (!valid)
+    {
+        Close();
+        return false;
+    }
+
+    // Check every entry once here so lookups can trust the table.
+    const ShaderArchiveEntry* entries = reinterpret_cast<const ShaderArchiveEntry*>(m_Data + header->TableOffset);
+    uint32_t entryCount = 0;
+    for (uint32_t bucket = 0; valid && bucket < header->BucketCount; ++bucket)
+    {
+        const ShaderArchiveEntry& entry = entries[bucket];
+        if (entry.KeyLength != 0)
+        {
+            ++entryCount;
+            valid = IsRangeInFile(entry.KeyOffset, entry.KeyLength, header->KeySize)
+                && IsRangeInFile(entry.DataOffset, entry.DataSize, size);
+        }
+    }
+    if (!valid || entryCount != header->EntryCount)
+    {
+        Close();
+        return false;
+    }
+
+    m_Header = header;
+    m_Entries = entries;
+    m_Keys = reinterpret_cast<const char*>(m_Data + header->KeyOffset);
+    return true;
+}
+
+void ShaderArchive::Close()
+{
+    m_File.Close();
+    m_Data = nullptr;
+    m_Header = nullptr;
+    m_Entries = nullptr;
+    m_Keys = nullptr;
+}
+
+uint32_t ShaderArchive::Find(const std::string& key) const
+{
+    if (!m_Header || key.empty())
+    {
+        return InvalidShaderEntry;
+    }
+
+    const uint64_t hash = HashShaderKey(key.data(), key.size());
+    const uint32_t mask = m_Header->BucketCount - 1;
+    // The table always has an empty bucket, which ends every probe.
+    for (uint32_t bucket = static_cast<uint32_t>(hash) & mask; ; bucket = (bucket + 1) & mask)
+    {
+        const ShaderArchiveEntry& entry = m_Entries[bucket];
+        if (entry.KeyLength == 0)
+        {
+            return InvalidShaderEntry;
+        }
+        if (entry.KeyHash == hash && entry.KeyLength == key.size()
+            && std::memcmp(m_Keys + entry.KeyOffset, key.data(), key.size()) == 0)
+        {
+            return bucket;
+        }
+    }
+}
+
+const void* ShaderArchive::GetBytecode(uint32_t entry) const
+{
+    return m_Data + m_Entries[entry].DataOffset;
+}
+
+size_t ShaderArchive::GetBytecodeSize(uint32_t entry) const
+{
+    return m_Entries[entry].DataSize;
+}
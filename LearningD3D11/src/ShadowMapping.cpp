@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cmath>
+#include "ShadowMapping.h"
+
+namespace
+{
+    // Looking along direction from position, with whichever world axis is
+    // further from the direction as up.
+    XMMATRIX GetLightView(FXMVECTOR position, FXMVECTOR direction)
+    {
+        const XMVECTOR forward = XMVector3Normalize(direction);
+        const XMVECTOR up = (std::fabs(XMVectorGetY(forward)) < 0.99f) ? XMVectorSet(0, 1, 0, 0) : XMVectorSet(0, 0, 1, 0);
+        return XMMatrixLookToLH(position, forward, up);
+    }
+
+    // Nearest and farthest view depth of a world box.
+    void GetDepthRange(FXMMATRIX view, const Aabb& bounds, float& nearZ, float& farZ)
+    {
+        const XMVECTOR minimum = XMLoadFloat3(&bounds.Min);
+        const XMVECTOR maximum = XMLoadFloat3(&bounds.Max);
+        const XMVECTOR center = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+        const XMVECTOR extents = XMVectorScale(XMVectorSubtract(maximum, minimum), 0.5f);
+
+        // With row vectors, view depth is a dot product with the third column.
+        const XMVECTOR depthColumn = XMMatrixTranspose(view).r[2];
+        const float centerZ = XMVectorGetX(XMVector3Dot(depthColumn, center)) + XMVectorGetW(depthColumn);
+        const float extentZ = XMVectorGetX(XMVector3Dot(XMVectorAbs(depthColumn), extents));
+        nearZ = centerZ - extentZ;
+        farZ = centerZ + extentZ;
+    }
+
+    void SetViewProjection(ShadowView& view)
+    {
+        view.ViewProjection = XMMatrixMultiply(view.View, view.Projection);
+        ExtractFrustumPlanes(view.ViewProjection, view.Volume);
+    }
+}
+
+void ComputeCascadeSplits(float nearZ, float farZ, uint32_t count, float lambda, float* splits)
+{
+    splits[0] = nearZ;
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        const float fraction = static_cast<float>(i) / count;
+        const float logarithmic = nearZ * std::pow(farZ / nearZ, fraction);
+        const float uniform = nearZ + (farZ - nearZ) * fraction;
+        splits[i] = lambda * logarithmic + (1.0f - lambda) * uniform;
+    }
+    splits[count] = farZ;
+}
+
+void FitCascades(const Camera& camera, const XMFLOAT3& direction, const Aabb* casterBounds,
+    const ShadowSettings& settings, ShadowView* cascades)
+{
+    const CameraProjection& projection = camera.GetProjection();
+    const uint32_t count = std::min(std::max(settings.CascadeCount, 1u), MaxShadowCascades);
+    float splits[MaxShadowCascades + 1];
+    ComputeCascadeSplits(projection.NearZ, std::min(projection.FarZ, settings.MaxDistance), count, settings.SplitLambda, splits);
+
+    // Squared distance of a frustum corner from the view axis, per unit of
+    // depth squared.
+    const float tanHalfFovY = std::tan(0.5f * XMConvertToRadians(projection.FieldOfViewY));
+    const float tanHalfFovX = tanHalfFovY * projection.AspectRatio;
+    const float cornerSlope = tanHalfFovX * tanHalfFovX + tanHalfFovY * tanHalfFovY;
+
+    const XMMATRIX inverseView = XMMatrixInverse(nullptr, camera.GetViewMatrix());
+    const XMMATRIX lightView = GetLightView(XMVectorZero(), XMLoadFloat3(&direction));
+
+    float casterNearZ = 0.0f, casterFarZ = 0.0f;
+    if (casterBounds)
+    {
+        GetDepthRange(lightView, *casterBounds, casterNearZ, casterFarZ);
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        ShadowView& cascade = cascades[i];
+        const float nearDepth = splits[i];
+        const float farDepth = splits[i + 1];
+
+        // The slice's bounding sphere is centered on the view axis, where
+        // the near and the far corners are equally far, or at the far plane
+        // if the far corners are further out than that.
+        const float centerDepth = std::min(0.5f * (nearDepth + farDepth) * (1.0f + cornerSlope), farDepth);
+        const float nearDistanceSq = (centerDepth - nearDepth) * (centerDepth - nearDepth) + nearDepth * nearDepth * cornerSlope;
+        const float farDistanceSq = (farDepth - centerDepth) * (farDepth - centerDepth) + farDepth * farDepth * cornerSlope;
+        const float radius = std::sqrt(std::max(nearDistanceSq, farDistanceSq));
+
+        // Snap the center to the texel grid of the light's view. Snapping
+        // moves it by up to a texel, so the map is a texel wider than the
+        // sphere on every side.
+        const float texelSize = 2.0f * radius / (settings.Resolution - 2);
+        const float halfSize = 0.5f * texelSize * settings.Resolution;
+        const XMVECTOR center = XMVector3Transform(XMVectorSet(0.0f, 0.0f, centerDepth, 1.0f), inverseView);
+        XMFLOAT3 lightCenter;
+        XMStoreFloat3(&lightCenter, XMVector3Transform(center, lightView));
+        lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+        lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+
+        // Casters between the light and the sphere must be in the map, and
+        // nothing beyond the sphere or the farthest caster need be.
+        float nearZ = lightCenter.z - radius;
+        float farZ = lightCenter.z + radius;
+        if (casterBounds)
+        {
+            nearZ = casterNearZ;
+            farZ = std::max(std::min(farZ, casterFarZ), nearZ + texelSize);
+        }
+
+        cascade.View = lightView;
+        cascade.Projection = XMMatrixOrthographicOffCenterLH(lightCenter.x - halfSize, lightCenter.x + halfSize,
+            lightCenter.y - halfSize, lightCenter.y + halfSize, nearZ, farZ);
+        SetViewProjection(cascade);
+        cascade.NearDepth = nearDepth;
+        cascade.FarDepth = farDepth;
+        cascade.TexelSize = texelSize;
+        cascade.Perspective = false;
+    }
+}
+
+void FitSpotShadow(const Light& light, float range, const ShadowSettings& settings, ShadowView& view)
+{
+    const float farZ = std::max(std::min(range, settings.MaxDistance), 0.1f);
+    const float nearZ = std::min(0.05f, 0.5f * farZ);
+    // The map is square around the cone. Cones near a half sphere are
+    // narrowed so the projection stays finite.
+    const float fieldOfView = std::min(2.0f * light.SpotAngle, XMConvertToRadians(170.0f));
+
+    view.View = GetLightView(XMLoadFloat4(&light.Position), XMLoadFloat4(&light.Direction));
+    view.Projection = XMMatrixPerspectiveFovLH(fieldOfView, 1.0f, nearZ, farZ);
+    SetViewProjection(view);
+    view.NearDepth = 0.0f;
+    view.FarDepth = 0.0f;
+    view.TexelSize = 2.0f * std::tan(0.5f * fieldOfView) / settings.Resolution;
+    view.Perspective = true;
+}
+
+bool IsShadowCasterVisible(const ShadowView& view, const XMFLOAT3& center, const XMFLOAT3& extents, float minTexels)
+{
+    const XMVECTOR boxCenter = XMLoadFloat3(&center);
+    const XMVECTOR boxExtents = XMLoadFloat3(&extents);
+
+    for (const XMFLOAT4& volumePlane : view.Volume.Planes)
+    {
+        const XMVECTOR plane = XMLoadFloat4(&volumePlane);
+        const float distance = XMVectorGetX(XMPlaneDotCoord(plane, boxCenter)) +
+            XMVectorGetX(XMVector3Dot(XMVectorAbs(plane), boxExtents));
+        if (distance < 0.0f)
+        {
+            return false;
+        }
+    }
+
+    // Width of the box's bounding sphere against the texel size where the
+    // box is nearest the light.
+    const float width = 2.0f * XMVectorGetX(XMVector3Length(boxExtents));
+    float texelSize = view.TexelSize;
+    if (view.Perspective)
+    {
+        const float nearestDepth = XMVectorGetZ(XMVector3Transform(boxCenter, view.View)) - 0.5f * width;
+        texelSize *= std::max(nearestDepth, 0.0f);
+    }
+    return width >= minTexels * texelSize;
+}
+
+void GetShadowConstants(const ShadowView* views, uint32_t viewCount, uint32_t cascadeCount, uint32_t resolution,
+    ShadowConstants& constants)
+{
+    // Clip space to texture coordinates, v pointing down.
+    const XMMATRIX clipToTexture(
+        0.5f, 0.0f, 0.0f, 0.0f,
+        0.0f, -0.5f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.5f, 0.5f, 0.0f, 1.0f);
+
+    viewCount = std::min(viewCount, MaxShadowViews);
+    cascadeCount = std::min(cascadeCount, std::min(viewCount, MaxShadowCascades));
+    for (uint32_t i = 0; i < MaxShadowViews; ++i)
+    {
+        constants.ShadowMatrices[i] = (i < viewCount) ? XMMatrixMultiply(views[i].ViewProjection, clipToTexture) : XMMatrixIdentity();
+    }
+    for (uint32_t i = 0; i < MaxShadowCascades; ++i)
+    {
+        constants.CascadeSplits[i] = (i < cascadeCount) ? views[i].FarDepth : 0.0f;
+    }
+    constants.CascadeCount = cascadeCount;
+    constants.TexelSize = 1.0f / resolution;
+    constants.Padding[0] = 0.0f;
+    constants.Padding[1] = 0.0f;
+}
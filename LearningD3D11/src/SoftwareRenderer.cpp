@@ -0,0 +1,625 @@
+#include "SoftwareRenderer.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace
+{
+    uint32_t PackColor(FXMVECTOR color)
+    {
+        XMFLOAT4 c;
+        XMStoreFloat4(&c, XMVectorSaturate(color));
+        const uint32_t r = static_cast<uint32_t>(c.x * 255.0f + 0.5f);
+        const uint32_t g = static_cast<uint32_t>(c.y * 255.0f + 0.5f);
+        const uint32_t b = static_cast<uint32_t>(c.z * 255.0f + 0.5f);
+        const uint32_t a = static_cast<uint32_t>(c.w * 255.0f + 0.5f);
+        return r | (g << 8) | (b << 16) | (a << 24);
+    }
+
+    XMVECTOR UnpackColor(uint32_t color)
+    {
+        return XMVectorSet(
+            static_cast<float>(color & 0xFF),
+            static_cast<float>((color >> 8) & 0xFF),
+            static_cast<float>((color >> 16) & 0xFF),
+            static_cast<float>(color >> 24)) * (1.0f / 255.0f);
+    }
+
+    // An edge is "top" if it is horizontal and the triangle lies below it, and
+    // "left" if the triangle lies to its right. Pixels exactly on an edge are
+    // only owned by top and left edges (D3D fill convention).
+    bool IsTopLeft(float ax, float ay, float bx, float by)
+    {
+        const float dx = bx - ax;
+        const float dy = by - ay;
+        return (dy == 0.0f && dx > 0.0f) || dy < 0.0f;
+    }
+
+    void LoadShadedVertex(const XMFLOAT4& position, const XMFLOAT4& positionWS, const XMFLOAT3& normalWS,
+        const XMFLOAT4& color, const XMFLOAT2& texcoord, XMVECTOR out[5])
+    {
+        out[0] = XMLoadFloat4(&position);
+        out[1] = XMLoadFloat4(&positionWS);
+        out[2] = XMLoadFloat3(&normalWS);
+        out[3] = XMLoadFloat4(&color);
+        out[4] = XMLoadFloat2(&texcoord);
+    }
+}
+
+SoftwareRenderer::SoftwareRenderer(unsigned int width, unsigned int height, unsigned int threadCount)
+    : m_Width(width)
+    , m_Height(height)
+    , m_TilesX((width + TileSize - 1) / TileSize)
+    , m_TilesY((height + TileSize - 1) / TileSize)
+    , m_ThreadCount(threadCount > 0 ? threadCount : GetDefaultThreadCount())
+    , m_ColorBuffer(width * height, 0)
+    , m_DepthBuffer(width * height, 1.0f)
+    , m_ClearPending(false)
+    , m_ClearColor(0)
+    , m_ClearDepth(1.0f)
+    , m_PixelShader(PS_Simple)
+    , m_DrawStateDirty(true)
+    , m_LightPropertiesDirty(true)
+    , m_TextureWidth(0)
+    , m_TextureHeight(0)
+    , m_TileBins(m_TilesX * m_TilesY)
+{
+}
+
+SoftwareRenderer::~SoftwareRenderer()
+{
+}
+
+void SoftwareRenderer::Clear(const float clearColor[4], float clearDepth)
+{
+    m_ClearPending = true;
+    m_ClearColor = PackColor(XMVectorSet(clearColor[0], clearColor[1], clearColor[2], clearColor[3]));
+    m_ClearDepth = clearDepth;
+}
+
+void SoftwareRenderer::SetLightProperties(const LightProperties& lightProperties)
+{
+    m_LightProperties = lightProperties;
+    m_LightPropertiesDirty = true;
+    m_DrawStateDirty = true;
+}
+
+void SoftwareRenderer::SetMaterial(const MaterialProperties& material)
+{
+    m_Material = material;
+    m_DrawStateDirty = true;
+}
+
+void SoftwareRenderer::SetPixelShader(PixelShader pixelShader)
+{
+    m_PixelShader = pixelShader;
+    m_DrawStateDirty = true;
+}
+
+void SoftwareRenderer::SetTexture(const uint32_t* texels, unsigned int width, unsigned int height)
+{
+    if (texels && width > 0 && height > 0)
+    {
+        m_Texture.assign(texels, texels + width * height);
+        m_TextureWidth = width;
+        m_TextureHeight = height;
+    }
+    else
+    {
+        m_Texture.clear();
+        m_TextureWidth = 0;
+        m_TextureHeight = 0;
+    }
+}
+
+uint32_t SoftwareRenderer::GetDrawStateIndex()
+{
+    if (m_LightPropertiesDirty)
+    {
+        LightSnapshot snapshot;
+        TransposeLights(m_LightProperties, snapshot.Lights);
+        snapshot.GlobalAmbient = m_LightProperties.GlobalAmbient;
+        m_LightSnapshots.push_back(snapshot);
+        m_LightPropertiesDirty = false;
+    }
+
+    if (m_DrawStateDirty)
+    {
+        DrawState state;
+        state.Material = m_Material;
+        state.Shader = m_PixelShader;
+        state.LightPropertiesIndex = static_cast<uint32_t>(m_LightSnapshots.size() - 1);
+        m_DrawStates.push_back(state);
+        m_DrawStateDirty = false;
+    }
+
+    return static_cast<uint32_t>(m_DrawStates.size() - 1);
+}
+
+void SoftwareRenderer::DrawIndexed(const VertexPosNormColTex* vertices, const uint16_t* indices, unsigned int indexCount,
+    const PerObjectTransformData& perObject)
+{
+    if (indexCount < 3)
+    {
+        return;
+    }
+
+    const uint32_t drawStateIndex = GetDrawStateIndex();
+    const unsigned int vertexCount = *std::max_element(indices, indices + indexCount) + 1u;
+    m_ShadedVertices.resize(vertexCount);
+
+    // SimpleVertexShader
+    ParallelFor(vertexCount, 1024, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const VertexPosNormColTex& in = vertices[i];
+            ShadedVertex& out = m_ShadedVertices[i];
+
+            const XMVECTOR position = XMVectorSetW(XMLoadFloat3(&in.Position), 1.0f);
+            out.TexCoord = in.Texture;
+            out.Color = XMFLOAT4(in.Color.x, in.Color.y, in.Color.z, 1.0f);
+            XMStoreFloat3(&out.NormalWS, XMVector3TransformNormal(XMLoadFloat3(&in.Normal), perObject.InverseTransposeWorldMatrix));
+            XMStoreFloat4(&out.PositionWS, XMVector4Transform(position, perObject.WorldMatrix));
+            XMStoreFloat4(&out.Position, XMVector4Transform(position, perObject.WorldViewProjectMatrix));
+        }
+    }, m_ThreadCount);
+
+    for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+    {
+        SubmitTriangle(m_ShadedVertices[indices[i]], m_ShadedVertices[indices[i + 1]], m_ShadedVertices[indices[i + 2]], drawStateIndex);
+    }
+}
+
+void SoftwareRenderer::DrawIndexedInstanced(const VertexPosNormColTex* vertices, const uint16_t* indices, unsigned int indexCountPerInstance,
+    const PlaneInstanceData* instances, unsigned int instanceCount, const PerFrameConstantBufferData& perFrame)
+{
+    if (indexCountPerInstance < 3 || instanceCount == 0)
+    {
+        return;
+    }
+
+    const uint32_t drawStateIndex = GetDrawStateIndex();
+    const unsigned int vertexCount = *std::max_element(indices, indices + indexCountPerInstance) + 1u;
+    m_ShadedVertices.resize(static_cast<size_t>(vertexCount) * instanceCount);
+
+    // InstancedVertexShader
+    ParallelFor(instanceCount, 16, [&](size_t begin, size_t end)
+    {
+        for (size_t instance = begin; instance < end; ++instance)
+        {
+            const PlaneInstanceData& instanceData = instances[instance];
+            const XMMATRIX mvp = instanceData.WorldMatrix * perFrame.ViewProjectionMatrix;
+
+            for (unsigned int i = 0; i < vertexCount; ++i)
+            {
+                const VertexPosNormColTex& in = vertices[i];
+                ShadedVertex& out = m_ShadedVertices[instance * vertexCount + i];
+
+                const XMVECTOR position = XMVectorSetW(XMLoadFloat3(&in.Position), 1.0f);
+                out.TexCoord = XMFLOAT2(0.0f, 0.0f);
+                out.Color = XMFLOAT4(in.Color.x, in.Color.y, in.Color.z, 1.0f);
+                XMStoreFloat3(&out.NormalWS, XMVector3TransformNormal(XMLoadFloat3(&in.Normal), instanceData.InverseTransposeWorldMatrix));
+                XMStoreFloat4(&out.PositionWS, XMVector4Transform(position, instanceData.WorldMatrix));
+                XMStoreFloat4(&out.Position, XMVector4Transform(position, mvp));
+            }
+        }
+    }, m_ThreadCount);
+
+    for (unsigned int instance = 0; instance < instanceCount; ++instance)
+    {
+        const ShadedVertex* instanceVertices = &m_ShadedVertices[static_cast<size_t>(instance) * vertexCount];
+        for (unsigned int i = 0; i + 2 < indexCountPerInstance; i += 3)
+        {
+            SubmitTriangle(instanceVertices[indices[i]], instanceVertices[indices[i + 1]], instanceVertices[indices[i + 2]], drawStateIndex);
+        }
+    }
+}
+
+void SoftwareRenderer::SubmitTriangle(const ShadedVertex& v0, const ShadedVertex& v1, const ShadedVertex& v2, uint32_t drawStateIndex)
+{
+    const ShadedVertex* input[3] = { &v0, &v1, &v2 };
+
+    // Trivially reject triangles that are entirely outside one clip plane.
+    unsigned int outsideMask[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        const XMFLOAT4& p = input[i]->Position;
+        outsideMask[i] =
+            (p.x < -p.w ? 0x01u : 0u) | (p.x > p.w ? 0x02u : 0u) |
+            (p.y < -p.w ? 0x04u : 0u) | (p.y > p.w ? 0x08u : 0u) |
+            (p.z < 0.0f ? 0x10u : 0u) | (p.z > p.w ? 0x20u : 0u);
+    }
+    if (outsideMask[0] & outsideMask[1] & outsideMask[2])
+    {
+        return;
+    }
+
+    // Only the near plane needs real clipping; the other planes are handled by
+    // the rasterizer's screen bounds and the per-pixel depth range test.
+    if (((outsideMask[0] | outsideMask[1] | outsideMask[2]) & 0x10u) == 0)
+    {
+        SetupTriangle(v0, v1, v2, drawStateIndex);
+        return;
+    }
+
+    ShadedVertex clipped[4];
+    int clippedCount = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        const ShadedVertex& a = *input[i];
+        const ShadedVertex& b = *input[(i + 1) % 3];
+        const bool aInside = a.Position.z >= 0.0f;
+        const bool bInside = b.Position.z >= 0.0f;
+
+        if (aInside)
+        {
+            clipped[clippedCount++] = a;
+        }
+
+        if (aInside != bInside)
+        {
+            const float t = a.Position.z / (a.Position.z - b.Position.z);
+            XMVECTOR va[5], vb[5];
+            LoadShadedVertex(a.Position, a.PositionWS, a.NormalWS, a.Color, a.TexCoord, va);
+            LoadShadedVertex(b.Position, b.PositionWS, b.NormalWS, b.Color, b.TexCoord, vb);
+
+            ShadedVertex& out = clipped[clippedCount++];
+            XMStoreFloat4(&out.Position, XMVectorLerp(va[0], vb[0], t));
+            XMStoreFloat4(&out.PositionWS, XMVectorLerp(va[1], vb[1], t));
+            XMStoreFloat3(&out.NormalWS, XMVectorLerp(va[2], vb[2], t));
+            XMStoreFloat4(&out.Color, XMVectorLerp(va[3], vb[3], t));
+            XMStoreFloat2(&out.TexCoord, XMVectorLerp(va[4], vb[4], t));
+        }
+    }
+
+    for (int i = 1; i + 1 < clippedCount; ++i)
+    {
+        SetupTriangle(clipped[0], clipped[i], clipped[i + 1], drawStateIndex);
+    }
+}
+
+void SoftwareRenderer::SetupTriangle(const ShadedVertex& v0, const ShadedVertex& v1, const ShadedVertex& v2, uint32_t drawStateIndex)
+{
+    Triangle triangle;
+    const ShadedVertex* input[3] = { &v0, &v1, &v2 };
+
+    for (int i = 0; i < 3; ++i)
+    {
+        const XMFLOAT4& p = input[i]->Position;
+        const float invW = 1.0f / p.w;
+        triangle.X[i] = (p.x * invW * 0.5f + 0.5f) * m_Width;
+        triangle.Y[i] = (-p.y * invW * 0.5f + 0.5f) * m_Height;
+        triangle.Z[i] = p.z * invW;
+        triangle.InvW[i] = invW;
+        triangle.Vertices[i] = *input[i];
+    }
+
+    // Back-face culling: the rasterizer state uses CULL_BACK with clockwise
+    // front faces, which have a positive area in y-down screen space.
+    const float area = (triangle.X[1] - triangle.X[0]) * (triangle.Y[2] - triangle.Y[0]) -
+        (triangle.X[2] - triangle.X[0]) * (triangle.Y[1] - triangle.Y[0]);
+    if (!(area > 0.0f))
+    {
+        return;
+    }
+
+    const float minX = std::max(0.0f, std::min({ triangle.X[0], triangle.X[1], triangle.X[2] }));
+    const float minY = std::max(0.0f, std::min({ triangle.Y[0], triangle.Y[1], triangle.Y[2] }));
+    const float maxX = std::min(static_cast<float>(m_Width - 1), std::max({ triangle.X[0], triangle.X[1], triangle.X[2] }));
+    const float maxY = std::min(static_cast<float>(m_Height - 1), std::max({ triangle.Y[0], triangle.Y[1], triangle.Y[2] }));
+    if (minX > maxX || minY > maxY)
+    {
+        return;
+    }
+
+    triangle.DrawStateIndex = drawStateIndex;
+    const uint32_t triangleIndex = static_cast<uint32_t>(m_Triangles.size());
+    m_Triangles.push_back(triangle);
+
+    const unsigned int tileMinX = static_cast<unsigned int>(minX) / TileSize;
+    const unsigned int tileMinY = static_cast<unsigned int>(minY) / TileSize;
+    const unsigned int tileMaxX = static_cast<unsigned int>(maxX) / TileSize;
+    const unsigned int tileMaxY = static_cast<unsigned int>(maxY) / TileSize;
+
+    for (unsigned int ty = tileMinY; ty <= tileMaxY; ++ty)
+    {
+        for (unsigned int tx = tileMinX; tx <= tileMaxX; ++tx)
+        {
+            m_TileBins[ty * m_TilesX + tx].push_back(triangleIndex);
+        }
+    }
+}
+
+void SoftwareRenderer::Flush()
+{
+    ParallelFor(m_TileBins.size(), 1, [this](size_t begin, size_t end)
+    {
+        for (size_t tile = begin; tile < end; ++tile)
+        {
+            ShadeTile(static_cast<unsigned int>(tile));
+        }
+    }, m_ThreadCount);
+
+    m_ClearPending = false;
+    m_Triangles.clear();
+    m_DrawStates.clear();
+    m_LightSnapshots.clear();
+    m_DrawStateDirty = true;
+    m_LightPropertiesDirty = true;
+    for (auto& bin : m_TileBins)
+    {
+        bin.clear();
+    }
+}
+
+void SoftwareRenderer::ShadeTile(unsigned int tileIndex)
+{
+    const unsigned int tileX0 = (tileIndex % m_TilesX) * TileSize;
+    const unsigned int tileY0 = (tileIndex / m_TilesX) * TileSize;
+    const unsigned int tileX1 = std::min(tileX0 + TileSize, m_Width);
+    const unsigned int tileY1 = std::min(tileY0 + TileSize, m_Height);
+
+    if (m_ClearPending)
+    {
+        for (unsigned int y = tileY0; y < tileY1; ++y)
+        {
+            std::fill(&m_ColorBuffer[y * m_Width + tileX0], &m_ColorBuffer[y * m_Width + tileX1], m_ClearColor);
+            std::fill(&m_DepthBuffer[y * m_Width + tileX0], &m_DepthBuffer[y * m_Width + tileX1], m_ClearDepth);
+        }
+    }
+
+    // Lit pixels are batched until the draw state changes. Later triangles
+    // may cover a batched pixel again, which is fine as the batch is written
+    // in order.
+    PixelBatch batch;
+    uint32_t batchDrawStateIndex = 0;
+    auto flushBatch = [&]()
+    {
+        if (!batch.PixelIndices.empty())
+        {
+            ShadePixels(m_DrawStates[batchDrawStateIndex], batch);
+            batch.PixelIndices.clear();
+            batch.Positions.clear();
+            batch.Normals.clear();
+            batch.TexCoords.clear();
+        }
+    };
+
+    for (uint32_t triangleIndex : m_TileBins[tileIndex])
+    {
+        const Triangle& tri = m_Triangles[triangleIndex];
+        const DrawState& state = m_DrawStates[tri.DrawStateIndex];
+        if (tri.DrawStateIndex != batchDrawStateIndex)
+        {
+            flushBatch();
+            batchDrawStateIndex = tri.DrawStateIndex;
+        }
+
+        const int minX = std::max(static_cast<int>(tileX0), static_cast<int>(std::floor(std::min({ tri.X[0], tri.X[1], tri.X[2] }))));
+        const int minY = std::max(static_cast<int>(tileY0), static_cast<int>(std::floor(std::min({ tri.Y[0], tri.Y[1], tri.Y[2] }))));
+        const int maxX = std::min(static_cast<int>(tileX1) - 1, static_cast<int>(std::ceil(std::max({ tri.X[0], tri.X[1], tri.X[2] }))));
+        const int maxY = std::min(static_cast<int>(tileY1) - 1, static_cast<int>(std::ceil(std::max({ tri.Y[0], tri.Y[1], tri.Y[2] }))));
+
+        // Edge function coefficients: E(x, y) = A * x + B * y + C, positive inside.
+        float A[3], B[3], C[3];
+        bool topLeft[3];
+        for (int e = 0; e < 3; ++e)
+        {
+            const int a = (e + 1) % 3;
+            const int b = (e + 2) % 3;
+            A[e] = -(tri.Y[b] - tri.Y[a]);
+            B[e] = tri.X[b] - tri.X[a];
+            C[e] = -(A[e] * tri.X[a] + B[e] * tri.Y[a]);
+            topLeft[e] = IsTopLeft(tri.X[a], tri.Y[a], tri.X[b], tri.Y[b]);
+        }
+        const float invArea = 1.0f / (A[0] * tri.X[0] + B[0] * tri.Y[0] + C[0]);
+
+        XMVECTOR attributes[3][5];
+        for (int i = 0; i < 3; ++i)
+        {
+            const ShadedVertex& v = tri.Vertices[i];
+            LoadShadedVertex(v.Position, v.PositionWS, v.NormalWS, v.Color, v.TexCoord, attributes[i]);
+        }
+
+        for (int y = minY; y <= maxY; ++y)
+        {
+            const float py = y + 0.5f;
+            for (int x = minX; x <= maxX; ++x)
+            {
+                const float px = x + 0.5f;
+
+                float w[3];
+                bool inside = true;
+                for (int e = 0; e < 3 && inside; ++e)
+                {
+                    w[e] = A[e] * px + B[e] * py + C[e];
+                    inside = w[e] > 0.0f || (w[e] == 0.0f && topLeft[e]);
+                }
+                if (!inside)
+                {
+                    continue;
+                }
+
+                const float b0 = w[0] * invArea;
+                const float b1 = w[1] * invArea;
+                const float b2 = w[2] * invArea;
+
+                const float depth = b0 * tri.Z[0] + b1 * tri.Z[1] + b2 * tri.Z[2];
+                float& storedDepth = m_DepthBuffer[y * m_Width + x];
+                if (depth < 0.0f || depth > 1.0f || !(depth < storedDepth))
+                {
+                    continue;
+                }
+                storedDepth = depth;
+
+                if (state.Shader == PS_Unlit)
+                {
+                    // UnlitPixelShader
+                    m_ColorBuffer[y * m_Width + x] = PackColor(XMVectorSplatOne());
+                    continue;
+                }
+
+                // Perspective-correct attribute interpolation.
+                const float p0 = b0 * tri.InvW[0];
+                const float p1 = b1 * tri.InvW[1];
+                const float p2 = b2 * tri.InvW[2];
+                const float invSum = 1.0f / (p0 + p1 + p2);
+                const float w0 = p0 * invSum;
+                const float w1 = p1 * invSum;
+                const float w2 = p2 * invSum;
+
+                XMFLOAT3 position, normal;
+                XMFLOAT2 texcoord;
+                XMStoreFloat3(&position, attributes[0][1] * w0 + attributes[1][1] * w1 + attributes[2][1] * w2);
+                XMStoreFloat3(&normal, XMVector3Normalize(attributes[0][2] * w0 + attributes[1][2] * w1 + attributes[2][2] * w2));
+                XMStoreFloat2(&texcoord, attributes[0][4] * w0 + attributes[1][4] * w1 + attributes[2][4] * w2);
+
+                batch.PixelIndices.push_back(y * m_Width + x);
+                batch.Positions.push_back(position);
+                batch.Normals.push_back(normal);
+                batch.TexCoords.push_back(texcoord);
+            }
+        }
+    }
+
+    flushBatch();
+}
+
+void SoftwareRenderer::ShadePixels(const DrawState& state, PixelBatch& batch)
+{
+    // SimplePixelShader
+    const LightSnapshot& lights = m_LightSnapshots[state.LightPropertiesIndex];
+    const _Material& material = state.Material.Material;
+    const size_t count = batch.PixelIndices.size();
+
+    // ComputeLighting
+    batch.Lighting.resize(count);
+    ComputeLighting(lights.Lights, material.SpecularPower, batch.Positions.data(), batch.Normals.data(), count, batch.Lighting.data());
+
+    const XMVECTOR emissive = XMLoadFloat4(&material.Emissive);
+    const XMVECTOR ambient = XMLoadFloat4(&material.Ambient) * XMLoadFloat4(&lights.GlobalAmbient);
+    const XMVECTOR materialDiffuse = XMLoadFloat4(&material.Diffuse);
+    const XMVECTOR materialSpecular = XMLoadFloat4(&material.Specular);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const XMVECTOR diffuse = materialDiffuse * XMLoadFloat4(&batch.Lighting[i].Diffuse);
+        const XMVECTOR specular = materialSpecular * XMLoadFloat4(&batch.Lighting[i].Specular);
+
+        XMVECTOR texColor = XMVectorSplatOne();
+        if (material.UseTexture)
+        {
+            texColor = SampleTexture(batch.TexCoords[i]);
+        }
+
+        m_ColorBuffer[batch.PixelIndices[i]] = PackColor((emissive + ambient + diffuse + specular) * texColor);
+    }
+}
+
+XMVECTOR SoftwareRenderer::SampleTexture(const XMFLOAT2& texcoord) const
+{
+    if (m_Texture.empty())
+    {
+        return XMVectorSplatOne();
+    }
+
+    // Bilinear with WRAP addressing from mip 0 only; the D3D sampler reads the
+    // whole mip chain, so minified texels can differ from the GPU image.
+    const float u = texcoord.x * m_TextureWidth - 0.5f;
+    const float v = texcoord.y * m_TextureHeight - 0.5f;
+    const float fu = std::floor(u);
+    const float fv = std::floor(v);
+    const float tu = u - fu;
+    const float tv = v - fv;
+
+    auto wrap = [](int i, unsigned int size)
+    {
+        const int s = static_cast<int>(size);
+        return static_cast<unsigned int>(((i % s) + s) % s);
+    };
+
+    const unsigned int x0 = wrap(static_cast<int>(fu), m_TextureWidth);
+    const unsigned int x1 = wrap(static_cast<int>(fu) + 1, m_TextureWidth);
+    const unsigned int y0 = wrap(static_cast<int>(fv), m_TextureHeight);
+    const unsigned int y1 = wrap(static_cast<int>(fv) + 1, m_TextureHeight);
+
+    const XMVECTOR c00 = UnpackColor(m_Texture[y0 * m_TextureWidth + x0]);
+    const XMVECTOR c10 = UnpackColor(m_Texture[y0 * m_TextureWidth + x1]);
+    const XMVECTOR c01 = UnpackColor(m_Texture[y1 * m_TextureWidth + x0]);
+    const XMVECTOR c11 = UnpackColor(m_Texture[y1 * m_TextureWidth + x1]);
+
+    return XMVectorLerp(XMVectorLerp(c00, c10, tu), XMVectorLerp(c01, c11, tu), tv);
+}
+
+bool SoftwareRenderer::SaveTGA(const std::string& fileName) const
+{
+    return SaveTGA(fileName, m_ColorBuffer.data(), m_Width, m_Height);
+}
+
+bool SoftwareRenderer::SaveTGA(const std::string& fileName, const uint32_t* pixels, unsigned int width, unsigned int height)
+{
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    uint8_t header[18] = { 0 };
+    header[2] = 2; // Uncompressed true-color.
+    header[12] = static_cast<uint8_t>(width & 0xFF);
+    header[13] = static_cast<uint8_t>(width >> 8);
+    header[14] = static_cast<uint8_t>(height & 0xFF);
+    header[15] = static_cast<uint8_t>(height >> 8);
+    header[16] = 32;   // Bits per pixel.
+    header[17] = 0x28; // 8 alpha bits, top-left origin.
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    // TGA stores pixels as BGRA.
+    std::vector<uint8_t> row(width * 4);
+    for (unsigned int y = 0; y < height; ++y)
+    {
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            const uint32_t c = pixels[y * width + x];
+            row[x * 4 + 0] = static_cast<uint8_t>((c >> 16) & 0xFF);
+            row[x * 4 + 1] = static_cast<uint8_t>((c >> 8) & 0xFF);
+            row[x * 4 + 2] = static_cast<uint8_t>(c & 0xFF);
+            row[x * 4 + 3] = static_cast<uint8_t>(c >> 24);
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+
+    return static_cast<bool>(file);
+}
+
+bool SoftwareRenderer::LoadTGA(const std::string& fileName, std::vector<uint32_t>& pixels, unsigned int& width, unsigned int& height)
+{
+    std::ifstream file(fileName, std::ios::binary);
+    uint8_t header[18];
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        header[0] != 0 || header[1] != 0 || header[2] != 2 || header[16] != 32 || header[17] != 0x28)
+    {
+        return false;
+    }
+
+    width = header[12] | (header[13] << 8);
+    height = header[14] | (header[15] << 8);
+    pixels.resize(width * height);
+
+    std::vector<uint8_t> row(width * 4);
+    for (unsigned int y = 0; y < height; ++y)
+    {
+        if (!file.read(reinterpret_cast<char*>(row.data()), row.size()))
+        {
+            return false;
+        }
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            pixels[y * width + x] = row[x * 4 + 2] | (row[x * 4 + 1] << 8) | (row[x * 4 + 0] << 16) | (static_cast<uint32_t>(row[x * 4 + 3]) << 24);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cassert>
+#include "Profiler.h"
+#include "TaskGraph.h"
+
+TaskGraph::ResourceId TaskGraph::AddResource(const char* name)
+{
+    m_ResourceNames.push_back(name);
+    return static_cast<ResourceId>(m_ResourceNames.size() - 1);
+}
+
+TaskGraph::TaskId TaskGraph::AddTask(const char* name, TaskFunction function,
+    std::initializer_list<ResourceId> reads, std::initializer_list<ResourceId> writes)
+{
+    return AddTask(name, std::move(function), std::vector<ResourceId>(reads), std::vector<ResourceId>(writes));
+}
+
+TaskGraph::TaskId TaskGraph::AddTask(const char* name, TaskFunction function,
+    const std::vector<ResourceId>& reads, const std::vector<ResourceId>& writes)
+{
+    Task task;
+    task.Name = name;
+    task.Function = std::move(function);
+    task.Reads = reads;
+    task.Writes = writes;
+    m_Tasks.push_back(std::move(task));
+    m_Compiled = false;
+    return static_cast<TaskId>(m_Tasks.size() - 1);
+}
+
+void TaskGraph::Compile()
+{
+    const TaskId none = 0xFFFFFFFF;
+    std::vector<TaskId> lastWriter(m_ResourceNames.size(), none);
+    std::vector<std::vector<TaskId>> readersSinceWrite(m_ResourceNames.size());
+
+    for (Task& task : m_Tasks)
+    {
+        task.Predecessors.clear();
+        task.Successors.clear();
+    }
+
+    for (TaskId id = 0; id < m_Tasks.size(); ++id)
+    {
+        Task& task = m_Tasks[id];
+        for (ResourceId resource : task.Reads)
+        {
+            assert(resource < m_ResourceNames.size());
+            if (lastWriter[resource] != none)
+            {
+                task.Predecessors.push_back(lastWriter[resource]);
+            }
+        }
+        for (ResourceId resource : task.Writes)
+        {
+            assert(resource < m_ResourceNames.size());
+            if (lastWriter[resource] != none)
+            {
+                task.Predecessors.push_back(lastWriter[resource]);
+            }
+            task.Predecessors.insert(task.Predecessors.end(), readersSinceWrite[resource].begin(), readersSinceWrite[resource].end());
+        }
+
+        std::sort(task.Predecessors.begin(), task.Predecessors.end());
+        task.Predecessors.erase(std::unique(task.Predecessors.begin(), task.Predecessors.end()), task.Predecessors.end());
+        // A task reading and writing a resource does not wait for itself.
+        task.Predecessors.erase(std::remove(task.Predecessors.begin(), task.Predecessors.end(), id), task.Predecessors.end());
+        for (TaskId predecessor : task.Predecessors)
+        {
+            m_Tasks[predecessor].Successors.push_back(id);
+        }
+
+        // Update the access history after the task's own accesses are resolved.
+        for (ResourceId resource : task.Reads)
+        {
+            readersSinceWrite[resource].push_back(id);
+        }
+        for (ResourceId resource : task.Writes)
+        {
+            lastWriter[resource] = id;
+            readersSinceWrite[resource].clear();
+        }
+    }
+
+    m_Remaining.reset(new std::atomic<uint32_t>[m_Tasks.size()]);
+    m_Compiled = true;
+}
+
+void TaskGraph::Run(JobSystem& jobs)
+{
+    if (!m_Compiled)
+    {
+        Compile();
+    }
+
+    for (TaskId id = 0; id < m_Tasks.size(); ++id)
+    {
+        m_Remaining[id].store(static_cast<uint32_t>(m_Tasks[id].Predecessors.size()), std::memory_order_relaxed);
+    }
+
+    // A task queues its ready successors before it returns, so the counter
+    // cannot reach zero while tasks remain.
+    JobCounter counter;
+    for (TaskId id = 0; id < m_Tasks.size(); ++id)
+    {
+        if (m_Tasks[id].Predecessors.empty())
+        {
+            Submit(jobs, id, counter);
+        }
+    }
+    jobs.Wait(counter);
+}
+
+void TaskGraph::Submit(JobSystem& jobs, TaskId id, JobCounter& counter)
+{
+    jobs.Run([this, &jobs, id, &counter]()
+    {
+        const Task& task = m_Tasks[id];
+        {
+            PROFILE_SCOPE(task.Name.c_str());
+            task.Function();
+        }
+        for (TaskId successor : task.Successors)
+        {
+            // The last predecessor to finish queues the successor.
+            if (m_Remaining[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                Submit(jobs, successor, counter);
+            }
+        }
+    }, &counter);
+}
@@ -0,0 +1,33 @@
+#include "BlockCompression.h"
+#include "DDSFile.h"
+#include "TextureCooker.h"
+
+bool CookTexture(const TextureImage& source, const TextureCookOptions& options, TextureImage& cooked)
+{
+    if (source.Format != TF_RGBA8 || source.GetMipCount() != 1
+        || source.Mips[0].size() != GetMipSize(TF_RGBA8, source.Width, source.Height, 0))
+    {
+        return false;
+    }
+
+    TextureImage mipChain = source;
+    mipChain.SRGB = options.SRGB;
+    GenerateMipChain(mipChain, options.GammaCorrectMips);
+
+    if (options.Format == TF_RGBA8)
+    {
+        cooked = std::move(mipChain);
+        return true;
+    }
+    return CompressImage(mipChain, options.Format, cooked, options.ThreadCount);
+}
+
+bool CookTextureFile(TextureDecoder& decoder, const std::string& sourceFileName, const std::string& cookedFileName,
+    const TextureCookOptions& options)
+{
+    TextureImage source;
+    TextureImage cooked;
+    return decoder.Decode(sourceFileName, source)
+        && CookTexture(source, options, cooked)
+        && WriteDDSFile(cookedFileName.c_str(), cooked);
+}
@@ -0,0 +1,546 @@
+#include <algorithm>
+#include <cmath>
+#include <DirectXMath.h>
+#include "ParallelFor.h"
+#include "TextureStreaming.h"
+
+using namespace DirectX;
+
+namespace
+{
+    // WantedMip of a texture not marked used this frame.
+    const uint32_t NotWanted = 0xFFFFFFFF;
+}
+
+uint32_t GetMipDimension(uint32_t size, uint32_t mip)
+{
+    return std::max(size >> mip, 1u);
+}
+
+uint32_t GetMipPitch(TextureFormat format, uint32_t width, uint32_t mip)
+{
+    const uint32_t mipWidth = GetMipDimension(width, mip);
+    switch (format)
+    {
+    case TF_BC1: return (mipWidth + 3) / 4 * 8;
+    case TF_BC3:
+    case TF_BC7: return (mipWidth + 3) / 4 * 16;
+    default: return mipWidth * 4;
+    }
+}
+
+uint64_t GetMipSize(TextureFormat format, uint32_t width, uint32_t height, uint32_t mip)
+{
+    const uint32_t mipHeight = GetMipDimension(height, mip);
+    const uint32_t rows = (format == TF_RGBA8) ? mipHeight : (mipHeight + 3) / 4;
+    return uint64_t(GetMipPitch(format, width, mip)) * rows;
+}
+
+uint64_t GetMipChainSize(TextureFormat format, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t firstMip)
+{
+    uint64_t size = 0;
+    for (uint32_t mip = firstMip; mip < mipCount; ++mip)
+    {
+        size += GetMipSize(format, width, height, mip);
+    }
+    return size;
+}
+
+uint32_t GetFullMipCount(uint32_t width, uint32_t height)
+{
+    uint32_t mipCount = 1;
+    while ((width >> mipCount) > 0 || (height >> mipCount) > 0)
+    {
+        ++mipCount;
+    }
+    return mipCount;
+}
+
+namespace
+{
+    // sRGB <-> linear conversion tables. Linear values are quantized to 14
+    // bits on the way back, fine enough that every 8-bit sRGB value
+    // round-trips.
+    struct GammaTables
+    {
+        static const int LinearSteps = 16383;
+
+        GammaTables()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                const float c = i / 255.0f;
+                ToLinear[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+            }
+            for (int i = 0; i <= LinearSteps; ++i)
+            {
+                const float l = static_cast<float>(i) / LinearSteps;
+                const float c = (l <= 0.0031308f) ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+                ToSRGB[i] = static_cast<uint8_t>(std::min(c * 255.0f + 0.5f, 255.0f));
+            }
+        }
+
+        float ToLinear[256];
+        uint8_t ToSRGB[LinearSteps + 1];
+    };
+
+    const GammaTables& GetGammaTables()
+    {
+        static const GammaTables tables;
+        return tables;
+    }
+
+    inline XMVECTOR XM_CALLCONV LoadLinear(const uint8_t* pixel, const float* toLinear)
+    {
+        return XMVectorSet(toLinear[pixel[0]], toLinear[pixel[1]], toLinear[pixel[2]], pixel[3] * (1.0f / 255.0f));
+    }
+
+    // One level of the chain. Each output pixel averages its 2x2 footprint as
+    // a float4 (RGB in linear light, alpha as stored).
+    void DownsampleGammaCorrect(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight,
+        uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight)
+    {
+        const GammaTables& tables = GetGammaTables();
+        const XMVECTOR scale = XMVectorSet(GammaTables::LinearSteps * 0.25f, GammaTables::LinearSteps * 0.25f,
+            GammaTables::LinearSteps * 0.25f, 255.0f * 0.25f);
+        const XMVECTOR half = XMVectorReplicate(0.5f);
+
+        for (uint32_t y = 0; y < dstHeight; ++y)
+        {
+            const uint8_t* row0 = src + size_t(std::min(2 * y, srcHeight - 1)) * srcWidth * 4;
+            const uint8_t* row1 = src + size_t(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * 4;
+            uint8_t* out = dst + size_t(y) * dstWidth * 4;
+            for (uint32_t x = 0; x < dstWidth; ++x, out += 4)
+            {
+                const size_t x0 = size_t(std::min(2 * x, srcWidth - 1)) * 4;
+                const size_t x1 = size_t(std::min(2 * x + 1, srcWidth - 1)) * 4;
+                XMVECTOR sum = XMVectorAdd(LoadLinear(row0 + x0, tables.ToLinear), LoadLinear(row0 + x1, tables.ToLinear));
+                sum = XMVectorAdd(sum, XMVectorAdd(LoadLinear(row1 + x0, tables.ToLinear), LoadLinear(row1 + x1, tables.ToLinear)));
+
+                XMFLOAT4 quantized;
+                XMStoreFloat4(&quantized, XMVectorMultiplyAdd(sum, scale, half));
+                out[0] = tables.ToSRGB[static_cast<int>(quantized.x)];
+                out[1] = tables.ToSRGB[static_cast<int>(quantized.y)];
+                out[2] = tables.ToSRGB[static_cast<int>(quantized.z)];
+                out[3] = static_cast<uint8_t>(quantized.w);
+            }
+        }
+    }
+
+    void Downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight,
+        uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight)
+    {
+        for (uint32_t y = 0; y < dstHeight; ++y)
+        {
+            const uint8_t* row0 = src + size_t(std::min(2 * y, srcHeight - 1)) * srcWidth * 4;
+            const uint8_t* row1 = src + size_t(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * 4;
+            uint8_t* out = dst + size_t(y) * dstWidth * 4;
+            for (uint32_t x = 0; x < dstWidth; ++x)
+            {
+                const size_t x0 = size_t(std::min(2 * x, srcWidth - 1)) * 4;
+                const size_t x1 = size_t(std::min(2 * x + 1, srcWidth - 1)) * 4;
+                for (int c = 0; c < 4; ++c)
+                {
+                    out[x * 4 + c] = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+void GenerateMipChain(TextureImage& image, bool gammaCorrect)
+{
+    const uint32_t mipCount = GetFullMipCount(image.Width, image.Height);
+    image.Mips.resize(mipCount);
+
+    for (uint32_t mip = 1; mip < mipCount; ++mip)
+    {
+        const uint32_t srcWidth = GetMipDimension(image.Width, mip - 1);
+        const uint32_t srcHeight = GetMipDimension(image.Height, mip - 1);
+        const uint32_t dstWidth = GetMipDimension(image.Width, mip);
+        const uint32_t dstHeight = GetMipDimension(image.Height, mip);
+        image.Mips[mip].resize(size_t(dstWidth) * dstHeight * 4);
+
+        if (gammaCorrect)
+        {
+            DownsampleGammaCorrect(image.Mips[mip - 1].data(), srcWidth, srcHeight, image.Mips[mip].data(), dstWidth, dstHeight);
+        }
+        else
+        {
+            Downsample(image.Mips[mip - 1].data(), srcWidth, srcHeight, image.Mips[mip].data(), dstWidth, dstHeight);
+        }
+    }
+}
+
+TextureStreamer::TextureStreamer(TextureDecoder& decoder, TextureUploadSink& sink, const TextureStreamingSettings& settings)
+    : m_Decoder(decoder)
+    , m_Sink(sink)
+    , m_Settings(settings)
+    , m_FrameNumber(0)
+    , m_BytesResident(0)
+    , m_BytesUploaded(0)
+    , m_MipsEvicted(0)
+    , m_FirstPixelCount(0)
+    , m_TotalTimeToFirstPixel(0.0)
+    , m_MaxTimeToFirstPixel(0.0)
+    , m_DecodesRunning(0)
+    , m_Stopping(false)
+{
+    // Leave a core for the owner thread.
+    unsigned int threadCount = m_Settings.ThreadCount;
+    if (threadCount == 0)
+    {
+        threadCount = std::max(GetDefaultThreadCount(), 2u) - 1;
+    }
+    for (unsigned int i = 0; i < threadCount; ++i)
+    {
+        m_Workers.emplace_back(&TextureStreamer::WorkerThread, this);
+    }
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+        m_DecodeQueue.clear();
+    }
+    m_Condition.notify_all();
+    for (auto& worker : m_Workers)
+    {
+        worker.join();
+    }
+}
+
+void TextureStreamer::WorkerThread()
+{
+    for (;;)
+    {
+        std::pair<TextureHandle, std::string> job;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this]() { return m_Stopping || !m_DecodeQueue.empty(); });
+            if (m_Stopping)
+            {
+                return;
+            }
+            job = std::move(m_DecodeQueue.front());
+            m_DecodeQueue.pop_front();
+            ++m_DecodesRunning;
+        }
+
+        std::unique_ptr<TextureImage> image(new TextureImage());
+        bool decoded = m_Decoder.Decode(job.second, *image) && image->Width > 0 && image->Height > 0
+            && image->GetMipCount() > 0 && image->GetMipCount() <= GetFullMipCount(image->Width, image->Height);
+        for (uint32_t mip = 0; decoded && mip < image->GetMipCount(); ++mip)
+        {
+            decoded = image->Mips[mip].size() == GetMipSize(image->Format, image->Width, image->Height, mip);
+        }
+        if (decoded && image->Format == TF_RGBA8 && image->GetMipCount() == 1)
+        {
+            GenerateMipChain(*image);
+        }
+        else if (!decoded)
+        {
+            image.reset();
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        DecodeResult result;
+        result.Texture = job.first;
+        result.Image = std::move(image);
+        m_Finished.push_back(std::move(result));
+        --m_DecodesRunning;
+    }
+}
+
+TextureHandle TextureStreamer::Request(const std::string& fileName)
+{
+    for (size_t i = 0; i < m_Textures.size(); ++i)
+    {
+        if (m_Textures[i].FileName == fileName)
+        {
+            return static_cast<TextureHandle>(i);
+        }
+    }
+
+    StreamedTexture texture;
+    texture.FileName = fileName;
+    texture.Width = 0;
+    texture.Height = 0;
+    texture.Format = TF_RGBA8;
+    texture.MipCount = 0;
+    texture.TailMip = 0;
+    texture.ResidentMip = 0;
+    texture.WantedMip = NotWanted;
+    texture.LastUsedFrame = 0;
+    texture.DecodePending = false;
+    texture.Failed = false;
+    texture.EverResident = false;
+    texture.RequestTime = Clock::now();
+    m_Textures.push_back(std::move(texture));
+
+    const TextureHandle handle = static_cast<TextureHandle>(m_Textures.size() - 1);
+    QueueDecode(handle);
+    return handle;
+}
+
+void TextureStreamer::QueueDecode(TextureHandle texture)
+{
+    m_Textures[texture].DecodePending = true;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_DecodeQueue.emplace_back(texture, m_Textures[texture].FileName);
+    }
+    m_Condition.notify_one();
+}
+
+void TextureStreamer::MarkUsed(TextureHandle texture, uint32_t mip)
+{
+    StreamedTexture& streamedTexture = m_Textures[texture];
+    streamedTexture.WantedMip = std::min(streamedTexture.WantedMip, mip);
+}
+
+uint32_t TextureStreamer::GetTailMip(TextureFormat format, uint32_t width, uint32_t height, uint32_t mipCount) const
+{
+    uint32_t mip = 0;
+    while (mip + 1 < mipCount && std::max(GetMipDimension(width, mip), GetMipDimension(height, mip)) > m_Settings.TailSize)
+    {
+        ++mip;
+    }
+    // The most detailed level of a block compressed texture must be a whole
+    // number of blocks.
+    while (format != TF_RGBA8 && mip > 0 && (GetMipDimension(width, mip) % 4 != 0 || GetMipDimension(height, mip) % 4 != 0))
+    {
+        --mip;
+    }
+    return mip;
+}
+
+bool TextureStreamer::MakeRoom(uint64_t size, TextureHandle requester)
+{
+    while (m_BytesResident + size > m_Settings.BudgetBytes)
+    {
+        // Least recently used texture with a level above its tail. Textures
+        // used this frame only qualify for levels more detailed than they
+        // want.
+        size_t victim = m_Textures.size();
+        for (size_t i = 0; i < m_Textures.size(); ++i)
+        {
+            const StreamedTexture& texture = m_Textures[i];
+            const bool usedThisFrame = texture.LastUsedFrame == m_FrameNumber && texture.WantedMip != NotWanted;
+            const bool evictable = i != requester && texture.MipCount > 0 && texture.ResidentMip < texture.TailMip
+                && (!usedThisFrame || texture.ResidentMip < texture.WantedMip);
+            if (evictable && (victim == m_Textures.size() || texture.LastUsedFrame < m_Textures[victim].LastUsedFrame))
+            {
+                victim = i;
+            }
+        }
+        if (victim == m_Textures.size())
+        {
+            return false;
+        }
+
+        StreamedTexture& texture = m_Textures[victim];
+        const TextureHandle handle = static_cast<TextureHandle>(victim);
+        if (!m_Sink.Trim(handle, texture.ResidentMip + 1))
+        {
+            return false;
+        }
+        m_BytesResident -= GetMipSize(texture.Format, texture.Width, texture.Height, texture.ResidentMip);
+        ++texture.ResidentMip;
+        ++m_MipsEvicted;
+        // It can be decoded again if it comes back on screen.
+        texture.Image.reset();
+    }
+    return true;
+}
+
+bool TextureStreamer::StreamIn(TextureHandle handle, uint64_t& uploadBytes)
+{
+    StreamedTexture& texture = m_Textures[handle];
+    const bool tailResident = texture.ResidentMip < texture.MipCount;
+
+    // Nothing resident: the whole tail, regardless of the upload limit, so
+    // the placeholder is replaced as soon as possible.
+    uint32_t targetMip = texture.ResidentMip;
+    uint64_t reserved = 0;
+    if (!tailResident)
+    {
+        reserved = GetMipChainSize(texture.Format, texture.Width, texture.Height, texture.MipCount, texture.TailMip);
+        if (!MakeRoom(reserved, handle))
+        {
+            return false;
+        }
+        targetMip = texture.TailMip;
+    }
+
+    // Then as many more detailed levels as the budget and the upload limit
+    // allow, but always at least one so large top levels are not starved.
+    const bool wanted = texture.WantedMip != NotWanted;
+    while (wanted && targetMip > texture.WantedMip)
+    {
+        const uint32_t mip = targetMip - 1;
+        const uint64_t chainSize = GetMipChainSize(texture.Format, texture.Width, texture.Height, texture.MipCount, mip);
+        if (uploadBytes + chainSize > m_Settings.UploadBytesPerUpdate && (uploadBytes > 0 || targetMip != texture.ResidentMip))
+        {
+            break;
+        }
+        const uint64_t levelSize = GetMipSize(texture.Format, texture.Width, texture.Height, mip);
+        if (!MakeRoom(reserved + levelSize, handle))
+        {
+            break;
+        }
+        reserved += levelSize;
+        targetMip = mip;
+    }
+
+    if (targetMip == texture.ResidentMip)
+    {
+        return false;
+    }
+
+    if (!m_Sink.Upload(handle, *texture.Image, targetMip))
+    {
+        texture.Failed = !tailResident;
+        texture.Image.reset();
+        return false;
+    }
+
+    const uint64_t chainSize = GetMipChainSize(texture.Format, texture.Width, texture.Height, texture.MipCount, targetMip);
+    uploadBytes += chainSize;
+    m_BytesUploaded += chainSize;
+    m_BytesResident += reserved;
+    texture.ResidentMip = targetMip;
+
+    if (!texture.EverResident)
+    {
+        texture.EverResident = true;
+        const double timeToFirstPixel = std::chrono::duration<double, std::milli>(Clock::now() - texture.RequestTime).count();
+        m_TotalTimeToFirstPixel += timeToFirstPixel;
+        m_MaxTimeToFirstPixel = std::max(m_MaxTimeToFirstPixel, timeToFirstPixel);
+        ++m_FirstPixelCount;
+    }
+    return true;
+}
+
+void TextureStreamer::Update(uint64_t frameNumber)
+{
+    m_FrameNumber = frameNumber;
+    for (StreamedTexture& texture : m_Textures)
+    {
+        if (texture.WantedMip != NotWanted)
+        {
+            texture.LastUsedFrame = frameNumber;
+        }
+    }
+
+    std::vector<DecodeResult> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        finished.swap(m_Finished);
+        // Textures on screen decode before everything else queued.
+        std::stable_partition(m_DecodeQueue.begin(), m_DecodeQueue.end(), [this](const std::pair<TextureHandle, std::string>& job)
+        {
+            return m_Textures[job.first].WantedMip != NotWanted;
+        });
+    }
+    for (DecodeResult& result : finished)
+    {
+        StreamedTexture& texture = m_Textures[result.Texture];
+        texture.DecodePending = false;
+        if (!result.Image)
+        {
+            // The placeholder stays bound.
+            texture.Failed = true;
+            continue;
+        }
+        if (texture.MipCount == 0)
+        {
+            texture.Width = result.Image->Width;
+            texture.Height = result.Image->Height;
+            texture.Format = result.Image->Format;
+            texture.MipCount = result.Image->GetMipCount();
+            texture.TailMip = GetTailMip(texture.Format, texture.Width, texture.Height, texture.MipCount);
+            texture.ResidentMip = texture.MipCount;
+        }
+        texture.Image = std::move(result.Image);
+    }
+
+    // Tails first, so new textures replace their placeholder before anything
+    // gains detail, then the detail levels of textures on screen.
+    uint64_t uploadBytes = 0;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (size_t i = 0; i < m_Textures.size(); ++i)
+        {
+            StreamedTexture& texture = m_Textures[i];
+            const bool tailResident = texture.ResidentMip < texture.MipCount;
+            if (texture.Image && !texture.Failed && tailResident == (pass == 1))
+            {
+                StreamIn(static_cast<TextureHandle>(i), uploadBytes);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < m_Textures.size(); ++i)
+    {
+        StreamedTexture& texture = m_Textures[i];
+        if (texture.Failed || texture.MipCount == 0)
+        {
+            texture.WantedMip = NotWanted;
+            continue;
+        }
+
+        const bool tailResident = texture.ResidentMip < texture.MipCount;
+        const bool needsDetail = texture.WantedMip != NotWanted && texture.ResidentMip > texture.WantedMip;
+        if (texture.Image && tailResident && !needsDetail)
+        {
+            texture.Image.reset();
+        }
+        else if (!texture.Image && needsDetail && !texture.DecodePending)
+        {
+            QueueDecode(static_cast<TextureHandle>(i));
+        }
+        texture.WantedMip = NotWanted;
+    }
+}
+
+uint32_t TextureStreamer::GetResidentMip(TextureHandle texture) const
+{
+    return m_Textures[texture].ResidentMip;
+}
+
+uint32_t TextureStreamer::GetMipCount(TextureHandle texture) const
+{
+    return m_Textures[texture].MipCount;
+}
+
+bool TextureStreamer::IsFailed(TextureHandle texture) const
+{
+    return m_Textures[texture].Failed;
+}
+
+TextureStreamingStats TextureStreamer::GetStats() const
+{
+    TextureStreamingStats stats;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        stats.QueueDepth = static_cast<uint32_t>(m_DecodeQueue.size()) + m_DecodesRunning;
+    }
+    stats.TextureCount = static_cast<uint32_t>(m_Textures.size());
+    stats.ResidentTextureCount = 0;
+    stats.FailedTextureCount = 0;
+    for (const StreamedTexture& texture : m_Textures)
+    {
+        stats.ResidentTextureCount += (texture.ResidentMip < texture.MipCount) ? 1 : 0;
+        stats.FailedTextureCount += texture.Failed ? 1 : 0;
+    }
+    stats.BytesResident = m_BytesResident;
+    stats.BudgetBytes = m_Settings.BudgetBytes;
+    stats.BytesUploaded = m_BytesUploaded;
+    stats.MipsEvicted = m_MipsEvicted;
+    stats.AverageTimeToFirstPixel = (m_FirstPixelCount > 0) ? m_TotalTimeToFirstPixel / m_FirstPixelCount : 0.0;
+    stats.MaxTimeToFirstPixel = m_MaxTimeToFirstPixel;
+    return stats;
+}
@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cmath>
+#include "Transform.h"
+
+namespace
+{
+    // Relative tolerance when comparing scale factors.
+    const float ScaleEpsilon = 1e-5f;
+
+    bool NearlyEqual(float a, float b)
+    {
+        return std::abs(a - b) <= ScaleEpsilon * std::max(std::abs(a), std::abs(b));
+    }
+
+    // For a world matrix whose upper 3x3 rows are orthogonal (scale then
+    // rotation), the inverse transpose of the 3x3 is each row divided by its
+    // squared length. The translation column of the result is then -N * t.
+    inline XMMATRIX InverseTransposeFromOrthogonalRows(FXMMATRIX worldMatrix, FXMVECTOR inverseLengthsSquared)
+    {
+        XMMATRIX normalMatrix(
+            XMVectorMultiply(worldMatrix.r[0], XMVectorSplatX(inverseLengthsSquared)),
+            XMVectorMultiply(worldMatrix.r[1], XMVectorSplatY(inverseLengthsSquared)),
+            XMVectorMultiply(worldMatrix.r[2], XMVectorSplatZ(inverseLengthsSquared)),
+            XMVectorZero());
+
+        // Work on columns so the three dot products with t happen at once.
+        normalMatrix = XMMatrixTranspose(normalMatrix);
+        const XMVECTOR translation = worldMatrix.r[3];
+        normalMatrix.r[3] = XMVectorNegate(
+            XMVectorMultiplyAdd(normalMatrix.r[0], XMVectorSplatX(translation),
+            XMVectorMultiplyAdd(normalMatrix.r[1], XMVectorSplatY(translation),
+            XMVectorMultiply(normalMatrix.r[2], XMVectorSplatZ(translation)))));
+
+        normalMatrix = XMMatrixTranspose(normalMatrix);
+        normalMatrix.r[3] = g_XMIdentityR3;
+        return normalMatrix;
+    }
+
+    // Squared lengths of the first three rows in lanes x, y and z.
+    inline XMVECTOR RowLengthsSquared(FXMMATRIX worldMatrix)
+    {
+        XMMATRIX squared(
+            XMVectorMultiply(worldMatrix.r[0], worldMatrix.r[0]),
+            XMVectorMultiply(worldMatrix.r[1], worldMatrix.r[1]),
+            XMVectorMultiply(worldMatrix.r[2], worldMatrix.r[2]),
+            XMVectorZero());
+        squared = XMMatrixTranspose(squared);
+        return XMVectorAdd(XMVectorAdd(squared.r[0], squared.r[1]), squared.r[2]);
+    }
+}
+
+TransformClass ClassifyScale(const XMFLOAT3& scale)
+{
+    if (!NearlyEqual(scale.x, scale.y) || !NearlyEqual(scale.x, scale.z))
+    {
+        return TC_AxisScale;
+    }
+    return NearlyEqual(std::abs(scale.x), 1.0f) ? TC_Rigid : TC_UniformScale;
+}
+
+TransformClass CombineTransformClass(TransformClass first, TransformClass second)
+{
+    // Rigid and uniform scale transforms keep the rows of first orthogonal,
+    // a non-uniform scale after a (possible) rotation does not.
+    if (second == TC_AxisScale)
+    {
+        return TC_General;
+    }
+    return std::max(first, second);
+}
+
+XMMATRIX ComposeTransform(FXMVECTOR scale, FXMVECTOR rotationQuaternion, FXMVECTOR translation)
+{
+    // Scaling first only scales the rows of the rotation.
+    XMMATRIX worldMatrix = XMMatrixRotationQuaternion(rotationQuaternion);
+    worldMatrix.r[0] = XMVectorMultiply(worldMatrix.r[0], XMVectorSplatX(scale));
+    worldMatrix.r[1] = XMVectorMultiply(worldMatrix.r[1], XMVectorSplatY(scale));
+    worldMatrix.r[2] = XMVectorMultiply(worldMatrix.r[2], XMVectorSplatZ(scale));
+    worldMatrix.r[3] = XMVectorSelect(g_XMIdentityR3, translation, g_XMSelect1110);
+    return worldMatrix;
+}
+
+XMMATRIX ComputeInverseTransposeWorldMatrix(FXMMATRIX worldMatrix, TransformClass transformClass)
+{
+    switch (transformClass)
+    {
+    case TC_Rigid:
+        return InverseTransposeFromOrthogonalRows(worldMatrix, g_XMOne);
+    case TC_UniformScale:
+        return InverseTransposeFromOrthogonalRows(worldMatrix, XMVectorReciprocal(XMVector3Dot(worldMatrix.r[0], worldMatrix.r[0])));
+    case TC_AxisScale:
+        return InverseTransposeFromOrthogonalRows(worldMatrix, XMVectorReciprocal(RowLengthsSquared(worldMatrix)));
+    default:
+        return XMMatrixTranspose(XMMatrixInverse(nullptr, worldMatrix));
+    }
+}
+
+void ComputeInverseTransposeWorldMatrices(const XMFLOAT4X4A* worldMatrices, const TransformClass* transformClasses,
+    size_t count, XMFLOAT4X4A* inverseTransposeWorldMatrices)
+{
+    const XMVECTOR rigid = XMVectorReplicateInt(TC_Rigid);
+    const XMVECTOR uniformScale = XMVectorReplicateInt(TC_UniformScale);
+
+    // Four matrices at a time in structure-of-arrays form: lane j of every
+    // vector belongs to matrix j, so the row lengths and the dot products with
+    // the translations of all four are a handful of vector operations.
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const XMFLOAT4X4A* world = worldMatrices + i;
+        XMMATRIX rows[4];
+        for (int row = 0; row < 4; ++row)
+        {
+            rows[row] = XMMatrixTranspose(XMMATRIX(
+                XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(world[0].m[row])),
+                XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(world[1].m[row])),
+                XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(world[2].m[row])),
+                XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(world[3].m[row]))));
+        }
+
+        XMVECTOR inverseLengthsSquared[3];
+        for (int row = 0; row < 3; ++row)
+        {
+            const XMVECTOR lengthSquared = XMVectorMultiplyAdd(rows[row].r[0], rows[row].r[0],
+                XMVectorMultiplyAdd(rows[row].r[1], rows[row].r[1], XMVectorMultiply(rows[row].r[2], rows[row].r[2])));
+            inverseLengthsSquared[row] = XMVectorReciprocal(lengthSquared);
+        }
+
+        // Per lane: 1 for rigid, the first row's for uniform scale and each
+        // row's own for axis scale, as ComputeInverseTransposeWorldMatrix.
+        const XMVECTOR classes = XMVectorSetInt(transformClasses[i], transformClasses[i + 1],
+            transformClasses[i + 2], transformClasses[i + 3]);
+        const XMVECTOR isRigid = XMVectorEqualInt(classes, rigid);
+        const XMVECTOR isUniformScale = XMVectorEqualInt(classes, uniformScale);
+
+        XMMATRIX normalRows[3];
+        for (int row = 0; row < 3; ++row)
+        {
+            XMVECTOR scale = XMVectorSelect(inverseLengthsSquared[row], inverseLengthsSquared[0], isUniformScale);
+            scale = XMVectorSelect(scale, g_XMOne, isRigid);
+            const XMVECTOR x = XMVectorMultiply(rows[row].r[0], scale);
+            const XMVECTOR y = XMVectorMultiply(rows[row].r[1], scale);
+            const XMVECTOR z = XMVectorMultiply(rows[row].r[2], scale);
+            const XMVECTOR w = XMVectorNegate(XMVectorMultiplyAdd(x, rows[3].r[0],
+                XMVectorMultiplyAdd(y, rows[3].r[1], XMVectorMultiply(z, rows[3].r[2]))));
+            normalRows[row] = XMMatrixTranspose(XMMATRIX(x, y, z, w));
+        }
+
+        for (int j = 0; j < 4; ++j)
+        {
+            XMFLOAT4X4A& inverseTranspose = inverseTransposeWorldMatrices[i + j];
+            if (transformClasses[i + j] == TC_General)
+            {
+                XMStoreFloat4x4A(&inverseTranspose, XMMatrixTranspose(XMMatrixInverse(nullptr, XMLoadFloat4x4A(&world[j]))));
+                continue;
+            }
+            XMStoreFloat4x4A(&inverseTranspose,
+                XMMATRIX(normalRows[0].r[j], normalRows[1].r[j], normalRows[2].r[j], g_XMIdentityR3));
+        }
+    }
+
+    for (; i < count; ++i)
+    {
+        const XMMATRIX worldMatrix = XMLoadFloat4x4A(&worldMatrices[i]);
+        XMStoreFloat4x4A(&inverseTransposeWorldMatrices[i], ComputeInverseTransposeWorldMatrix(worldMatrix, transformClasses[i]));
+    }
+}
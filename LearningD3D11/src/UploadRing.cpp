@@ -0,0 +1,94 @@
+#include <cassert>
+#include "UploadRing.h"
+
+UploadRing::UploadRing(size_t capacity, size_t alignment)
+{
+    Reset(capacity, alignment);
+}
+
+void UploadRing::Reset(size_t capacity, size_t alignment)
+{
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    m_Alignment = alignment;
+    m_Capacity = capacity & ~(alignment - 1);
+    m_Head = 0;
+    m_Tail = 0;
+    m_Allocated = 0;
+    m_Retired = 0;
+    m_Frames.clear();
+}
+
+size_t UploadRing::Allocate(size_t size)
+{
+    const size_t alignedSize = (size + m_Alignment - 1) & ~(m_Alignment - 1);
+    const size_t used = GetUsedSize();
+    if (alignedSize == 0 || alignedSize > m_Capacity - used)
+    {
+        return InvalidOffset;
+    }
+
+    if (used == 0)
+    {
+        // Nothing is live, so start again at zero rather than wrap, which
+        // would leave no room for an allocation larger than m_Tail. Frames
+        // still in flight are empty and must retire to the new tail.
+        m_Head = 0;
+        m_Tail = 0;
+        for (Frame& frame : m_Frames)
+        {
+            frame.HeadAtEnd = 0;
+        }
+    }
+
+    if (m_Head >= m_Tail)
+    {
+        // Free space is [m_Head, capacity) followed by [0, m_Tail).
+        if (m_Head + alignedSize <= m_Capacity)
+        {
+            const size_t offset = m_Head;
+            m_Head += alignedSize;
+            m_Allocated += alignedSize;
+            return offset;
+        }
+
+        if (alignedSize <= m_Tail)
+        {
+            // Skip the end of the ring and start again at zero.
+            m_Allocated += (m_Capacity - m_Head) + alignedSize;
+            m_Head = alignedSize;
+            return 0;
+        }
+
+        return InvalidOffset;
+    }
+
+    // Free space is [m_Head, m_Tail).
+    if (m_Head + alignedSize <= m_Tail)
+    {
+        const size_t offset = m_Head;
+        m_Head += alignedSize;
+        m_Allocated += alignedSize;
+        return offset;
+    }
+
+    return InvalidOffset;
+}
+
+void UploadRing::EndFrame(uint64_t frameNumber)
+{
+    assert(m_Frames.empty() || frameNumber > m_Frames.back().FrameNumber);
+
+    Frame frame = { frameNumber, m_Allocated, m_Head };
+    m_Frames.push_back(frame);
+}
+
+void UploadRing::RetireFrames(uint64_t frameNumber)
+{
+    while (!m_Frames.empty() && m_Frames.front().FrameNumber <= frameNumber)
+    {
+        m_Tail = m_Frames.front().HeadAtEnd;
+        m_Retired = m_Frames.front().AllocatedAtEnd;
+        m_Frames.pop_front();
+    }
+}
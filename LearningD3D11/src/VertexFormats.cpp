@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include "VertexFormats.h"
+
+using namespace DirectX::PackedVector;
+
+VertexQuantization ComputeVertexQuantization(const VertexPosNormColTex* vertices, size_t count, PositionEncoding encoding)
+{
+    XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+    XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const XMVECTOR position = XMLoadFloat3(&vertices[i].Position);
+        boundsMin = XMVectorMin(boundsMin, position);
+        boundsMax = XMVectorMax(boundsMax, position);
+    }
+    if (count == 0)
+    {
+        boundsMin = boundsMax = XMVectorZero();
+    }
+
+    XMVECTOR scale, bias;
+    if (encoding == PE_Unorm16)
+    {
+        scale = boundsMax - boundsMin;
+        bias = boundsMin;
+    }
+    else
+    {
+        scale = (boundsMax - boundsMin) * 0.5f;
+        bias = (boundsMax + boundsMin) * 0.5f;
+    }
+
+    // Flat axes still need a non-zero scale to divide by.
+    scale = XMVectorSelect(scale, g_XMOne, XMVectorLessOrEqual(scale, XMVectorZero()));
+
+    VertexQuantization quantization;
+    XMStoreFloat4(&quantization.PositionScale, XMVectorSetW(scale, 0.0f));
+    XMStoreFloat4(&quantization.PositionBias, XMVectorSetW(bias, 1.0f));
+    return quantization;
+}
+
+XMVECTOR XM_CALLCONV EncodeOctahedral(FXMVECTOR normal)
+{
+    // Project onto the octahedron |x| + |y| + |z| = 1.
+    const XMVECTOR absolute = XMVectorAbs(normal);
+    const XMVECTOR sum = XMVector3Dot(absolute, g_XMOne);
+    const XMVECTOR projected = XMVectorDivide(normal, sum);
+
+    // Fold the lower half over the diagonals: xy = (1 - |yx|) * sign(xy).
+    const XMVECTOR signs = XMVectorOrInt(XMVectorAndInt(projected, g_XMNegativeZero), g_XMOne);
+    const XMVECTOR swapped = XMVectorSwizzle<1, 0, 2, 3>(XMVectorAbs(projected));
+    const XMVECTOR folded = XMVectorMultiply(XMVectorSubtract(g_XMOne, swapped), signs);
+
+    const XMVECTOR lowerHalf = XMVectorLess(XMVectorSplatZ(projected), XMVectorZero());
+    return XMVectorSelect(projected, folded, lowerHalf);
+}
+
+XMVECTOR XM_CALLCONV DecodeOctahedral(FXMVECTOR encoded)
+{
+    // z = 1 - |x| - |y|; where that is negative, unfold x and y.
+    const XMVECTOR absolute = XMVectorAbs(encoded);
+    const XMVECTOR z = XMVectorSubtract(XMVectorSubtract(g_XMOne, XMVectorSplatX(absolute)), XMVectorSplatY(absolute));
+    const XMVECTOR unfold = XMVectorSaturate(XMVectorNegate(z));
+
+    const XMVECTOR signs = XMVectorOrInt(XMVectorAndInt(encoded, g_XMNegativeZero), g_XMOne);
+    const XMVECTOR xy = XMVectorNegativeMultiplySubtract(unfold, signs, encoded);
+
+    return XMVector3Normalize(XMVectorSelect(z, xy, g_XMSelect1100));
+}
+
+void PackVertices(const VertexPosNormColTex* vertices, size_t count, const VertexQuantization& quantization,
+    PositionEncoding encoding, VertexPacked* packedVertices)
+{
+    const XMVECTOR inverseScale = XMVectorReciprocal(XMVectorSetW(XMLoadFloat4(&quantization.PositionScale), 1.0f));
+    const XMVECTOR bias = XMVectorSetW(XMLoadFloat4(&quantization.PositionBias), 0.0f);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const VertexPosNormColTex& vertex = vertices[i];
+        VertexPacked& packed = packedVertices[i];
+
+        const XMVECTOR position = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&vertex.Position), bias), inverseScale);
+        if (encoding == PE_Unorm16)
+        {
+            XMStoreUShortN4(reinterpret_cast<XMUSHORTN4*>(packed.Position), position);
+        }
+        else
+        {
+            XMStoreHalf4(reinterpret_cast<XMHALF4*>(packed.Position), position);
+        }
+
+        XMStoreShortN2(reinterpret_cast<XMSHORTN2*>(packed.Normal), EncodeOctahedral(XMLoadFloat3(&vertex.Normal)));
+        XMStoreUByteN4(reinterpret_cast<XMUBYTEN4*>(packed.Color), XMVectorSetW(XMLoadFloat3(&vertex.Color), 1.0f));
+        XMStoreHalf2(reinterpret_cast<XMHALF2*>(packed.Texture), XMLoadFloat2(&vertex.Texture));
+    }
+}
+
+void UnpackVertices(const VertexPacked* packedVertices, size_t count, const VertexQuantization& quantization,
+    PositionEncoding encoding, VertexPosNormColTex* vertices)
+{
+    const XMVECTOR scale = XMLoadFloat4(&quantization.PositionScale);
+    const XMVECTOR bias = XMLoadFloat4(&quantization.PositionBias);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const VertexPacked& packed = packedVertices[i];
+        VertexPosNormColTex& vertex = vertices[i];
+
+        const XMVECTOR position = (encoding == PE_Unorm16)
+            ? XMLoadUShortN4(reinterpret_cast<const XMUSHORTN4*>(packed.Position))
+            : XMLoadHalf4(reinterpret_cast<const XMHALF4*>(packed.Position));
+        XMStoreFloat3(&vertex.Position, XMVectorMultiplyAdd(position, scale, bias));
+
+        XMStoreFloat3(&vertex.Normal, DecodeOctahedral(XMLoadShortN2(reinterpret_cast<const XMSHORTN2*>(packed.Normal))));
+        XMStoreFloat3(&vertex.Color, XMLoadUByteN4(reinterpret_cast<const XMUBYTEN4*>(packed.Color)));
+        XMStoreFloat2(&vertex.Texture, XMLoadHalf2(reinterpret_cast<const XMHALF2*>(packed.Texture)));
+    }
+}
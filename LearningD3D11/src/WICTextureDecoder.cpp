@@ -0,0 +1,56 @@
+#include "DirectXTemplate.h"
+#include <wincodec.h>
+#include "DDSFile.h"
+#include "MappedFile.h"
+#include "WICTextureDecoder.h"
+
+namespace
+{
+    bool DecodeWithWIC(const std::wstring& fileName, TextureImage& image)
+    {
+        IWICImagingFactory* factory = nullptr;
+        IWICBitmapDecoder* decoder = nullptr;
+        IWICBitmapFrameDecode* frame = nullptr;
+        IWICFormatConverter* converter = nullptr;
+
+        bool decoded = SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory)))
+            && SUCCEEDED(factory->CreateDecoderFromFilename(fileName.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder))
+            && SUCCEEDED(decoder->GetFrame(0, &frame))
+            && SUCCEEDED(factory->CreateFormatConverter(&converter))
+            && SUCCEEDED(converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom));
+
+        UINT width = 0;
+        UINT height = 0;
+        decoded = decoded && SUCCEEDED(converter->GetSize(&width, &height)) && width > 0 && height > 0;
+        if (decoded)
+        {
+            const UINT stride = width * 4;
+            image.Width = width;
+            image.Height = height;
+            image.Mips.assign(1, std::vector<uint8_t>(size_t(stride) * height));
+            decoded = SUCCEEDED(converter->CopyPixels(nullptr, stride, static_cast<UINT>(image.Mips[0].size()), image.Mips[0].data()));
+        }
+
+        SafeRelease(converter);
+        SafeRelease(frame);
+        SafeRelease(decoder);
+        SafeRelease(factory);
+        return decoded;
+    }
+}
+
+bool WICTextureDecoder::Decode(const std::string& fileName, TextureImage& image)
+{
+    if (fileName.size() >= 4 && _stricmp(fileName.c_str() + fileName.size() - 4, ".dds") == 0)
+    {
+        return ReadDDSFile(fileName.c_str(), image);
+    }
+
+    const HRESULT initializeResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    const bool decoded = DecodeWithWIC(WidenPath(fileName.c_str()), image);
+    if (SUCCEEDED(initializeResult))
+    {
+        CoUninitialize();
+    }
+    return decoded;
+}
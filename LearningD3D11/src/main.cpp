@@ -1,16 +1,65 @@
 #include <DirectXTemplate.h>
+#include <shellapi.h>
 #include <algorithm>
 #include <chrono>
+#include <functional>
+#include <string>
 #include <vector>
 #include <memory>
 #include <iterator>
-#include "Effects.h"
+#include <cfloat>
+#include <cmath>
 #include "Camera.h"
-#define MAX_LIGHTS 8
+#include "ShaderTypes.h"
+#include "ParallelFor.h"
+#include "JobSystem.h"
+#include "TaskGraph.h"
+#include "FrustumCulling.h"
+#include "BoundingVolumeHierarchy.h"
+#include "LevelOfDetail.h"
+#include "OcclusionCulling.h"
+#include "ShadowMapping.h"
+#include "Scene.h"
+#include "FrameScheduler.h"
+#include "Profiler.h"
+#include "ProfileCapture.h"
+#include "Transform.h"
+#include "MeshFile.h"
+#include "ShaderArchive.h"
+#include "VertexFormats.h"
+#include "RenderQueue.h"
+#include "CommandList.h"
+#include "ClusteredLighting.h"
+#include "DemoScene.h"
+#include "MaterialTable.h"
+#include "D3D11ConstantBufferRing.h"
+#include "D3D11DeferredContexts.h"
+#include "D3D11GpuProfiler.h"
+#include "D3D11MaterialTable.h"
+#include "D3D11MeshFile.h"
+#include "D3D11ShaderCache.h"
+#include "D3D11ShadowMaps.h"
+#include "D3D11StructuredBuffer.h"
+#include "D3D11TextureUploadSink.h"
+#include "D3D11VertexFormats.h"
+#include "D3D11RenderContext.h"
+#include "TextureStreaming.h"
+#include "TextureCooker.h"
+#include "WICTextureDecoder.h"
 
 using namespace DirectX;
 
 Camera g_Camera;
+// Camera before the last simulation step, and the one between the two that
+// the frame is rendered from.
+Camera g_PreviousCamera;
+Camera g_RenderCamera;
+// The window renders with reversed-Z depth and no far plane; the headless
+// modes keep the standard projection.
+const DepthMode g_DepthMode = DM_ReversedInfinite;
+// Sub-pixel jitter of the projection, for a temporal resolve to use. Off
+// until there is one.
+const bool g_EnableCameraJitter = false;
 
 const LONG g_WindowWidth = 1280;
 const LONG g_WindowHeight = 720;
@@ -19,10 +68,14 @@ LPCWSTR g_WindowName = L"DirectX Template";
 HWND g_WindowHandle = 0;
 
 const BOOL g_EnableVSync = TRUE;
+// Simulation at 60 Hz. No frame cap: Present already waits for vsync.
+const FrameSchedulerSettings g_FrameSchedulerSettings;
 
 // Direct3D device and swap chain.
 ID3D11Device* g_d3dDevice = nullptr;
 ID3D11DeviceContext* g_d3dDeviceContext = nullptr;
+// D3D11.1 interface for binding constant buffer ranges.
+ID3D11DeviceContext1* g_d3dDeviceContext1 = nullptr;
 IDXGISwapChain* g_d3dSwapChain = nullptr;
 
 // Render target view for the back buffer of the swap chain.
@@ -30,7 +83,18 @@ ID3D11RenderTargetView* g_d3dRenderTargetView = nullptr;
 // Depth/stencil view for use as a depth buffer.
 ID3D11DepthStencilView* g_d3dDepthStencilView = nullptr;
 
-ID3D11ShaderResourceView* g_textureShaderResourceView = nullptr;
+// Textures are decoded on worker threads and streamed in a few mips at a
+// time; a grey placeholder is bound until a texture's first mips arrive.
+const uint64_t g_TextureBudget = 256ull << 20;
+WICTextureDecoder g_TextureDecoder;
+D3D11TextureUploadSink g_TextureUploadSink;
+std::unique_ptr<TextureStreamer> g_TextureStreamer;
+TextureHandle g_ContainerTexture = InvalidTexture;
+// The container texture streams from its cooked copy (BC7 with a full mip
+// chain) when there is one; run with -cooktextures to create it.
+const char* g_ContainerTextureSource = "../assets/container.jpg";
+const char* g_ContainerTextureCooked = "../assets/container.dds";
+uint64_t g_FrameNumber = 0;
 
 // A texture to associate to the depth stencil view.
 ID3D11Texture2D* g_d3dDepthStencilBuffer = nullptr;
@@ -51,171 +115,158 @@ ID3D11InputLayout* g_d3dInstancedInputLayout = nullptr;
 ID3D11Buffer* g_d3dInstancedVertexBuffer_Instances = nullptr;
 ID3D11Buffer* g_d3dInstancedVertexBuffer_Vertices = nullptr;
 ID3D11Buffer* g_d3dInstancedIndexBuffer = nullptr;
-ID3D11Buffer* g_d3dLightPropertiesConstantBuffer = nullptr;
-ID3D11Buffer* g_d3dMaterialPropertiesConstantBuffer = nullptr;
+ID3D11Buffer* g_d3dCubeFieldInstanceBuffer = nullptr;
+ID3D11Buffer* g_d3dPackedVertexBuffer = nullptr;
+ID3D11Buffer* g_d3dLightVertexBuffer = nullptr;
+ID3D11Buffer* g_d3dLightIndexBuffer = nullptr;
+ID3D11InputLayout* g_d3dPackedInputLayout = nullptr;
+ID3D11InputLayout* g_d3dPackedInstancedInputLayout = nullptr;
 
 // Shader data
-ID3D11VertexShader* g_d3dVertexShader = nullptr;
-ID3D11VertexShader* g_d3dInstancedVertexShader = nullptr;
-ID3D11PixelShader* g_d3dPixelShader = nullptr;
-ID3D11PixelShader* g_d3dUnlitPixelShader = nullptr;
+// The compiled shaders are packed into one archive after the build (see
+// -packshaders), which is mapped at startup. Shader objects are created the
+// first time a draw binds them.
+#if _DEBUG
+const char* g_ShaderArchiveFileName = "Shaders_d.ldsa";
+#else
+const char* g_ShaderArchiveFileName = "Shaders.ldsa";
+#endif
+ShaderArchive g_ShaderArchive;
+D3D11ShaderCache g_ShaderCache;
 
 
 // Shader resources
-enum ConstanBuffer
-{
-    CB_Frame,
-    CB_Object,
-    NumConstantBuffers
-};
-
-ID3D11Buffer* g_d3dConstantBuffers[NumConstantBuffers];
+// Every cbuffer of a frame is a slice of this ring; up to g_FramesInFlight
+// frames are queued before the CPU waits on the GPU.
+const unsigned int g_FramesInFlight = 3;
+const UINT g_ConstantBufferRingSize = 1024 * 1024;
+D3D11ConstantBufferRing g_ConstantBufferRing;
+
+// Profiling. -trace records g_TraceFrameCount frames of CPU and GPU zones
+// and writes them to the trace files.
+const unsigned int g_GpuProfilerMaxZones = 32;
+D3D11GpuProfiler g_GpuProfiler;
+ProfileRecorder g_ProfileRecorder;
+const int g_TraceFrameCount = 300;
+int g_TracedFrameCount = 0;
 
 // Demo parameters
 XMMATRIX g_ViewMatrix;
-XMMATRIX g_ProjectionMatrix;
-
-// Vertex data for a colored cube.
-struct VertexPosNormColTex
-{
-    XMFLOAT3 Position;
-    XMFLOAT3 Normal;
-    XMFLOAT3 Color;
-    XMFLOAT2 Texture;
-};
-
-// Per-instance data (must be 16 byte aligned)
-struct alignas(16) PlaneInstanceData
-{
-    XMMATRIX WorldMatrix;
-    XMMATRIX InverseTransposeWorldMatrix;
-};
-
-struct alignas(16) PerObjectTransformData
-{
-    XMMATRIX WorldMatrix;
-    XMMATRIX InverseTransposeWorldMatrix;
-    XMMATRIX WorldViewProjectMatrix;
-} g_PerObjTransformData;
-
-// A structure to hold the data for a per-object constant buffer
-// defined in the vertex shader.
-struct PerFrameConstantBufferData
-{
-    XMMATRIX ViewProjectionMatrix;
-} g_PerFrameTransformData;
 
-struct alignas(16) _Material
+PerFrameConstantBufferData g_PerFrameTransformData;
+
+// The material table and the lights of the scene, uploaded to structured
+// buffers.
+D3D11MaterialTable g_d3dMaterialTable;
+LightClusterGrid g_LightClusters;
+D3D11StructuredBuffer g_d3dClusterLights;
+D3D11StructuredBuffer g_d3dClusterRanges;
+D3D11StructuredBuffer g_d3dClusterLightIndices;
+
+// Draw the cube mesh from 20 byte VertexPacked vertices instead of 44 byte
+// VertexPosNormColTex ones. The software renderer always uses g_CubeMesh.
+const bool g_UsePackedVertices = true;
+const PositionEncoding g_CubePositionEncoding = PE_Unorm16;
+VertexQuantization g_CubeQuantization;
+
+// The GPU cube buffers are created straight from the memory-mapped cooked
+// mesh. It is cooked from the procedural cube when the file is missing or
+// holds another vertex format; delete it after changing CreateCube.
+const char* g_CubeMeshFileName = "Cube.ldmesh";
+uint32_t g_CubeIndexCount = 0;
+DXGI_FORMAT g_CubeIndexFormat = DXGI_FORMAT_R16_UINT;
+
+// Plane instances are kept on the CPU so they can be frustum culled every
+// frame; only the survivors are written to the instance buffer.
+PlaneInstanceData* g_PlaneInstanceData = nullptr;
+InstanceBoundsSoA g_PlaneInstanceBounds;
+Frustum g_Frustum;
+
+// The walls are also rasterized into a small CPU depth buffer every frame,
+// and cube field instances hidden behind them are left out of the instance
+// buffer.
+const bool g_EnableOcclusionCulling = true;
+const uint32_t g_OcclusionBufferWidth = 320;
+const uint32_t g_OcclusionBufferHeight = 180;
+OcclusionBuffer g_OcclusionBuffer;
+
+// A left click picks the entity under the cursor with the scene tree.
+bool g_PickRequested = false;
+int g_PickX = 0;
+int g_PickY = 0;
+Entity g_PickedEntity = InvalidEntity;
+
+// The shadow maps of the lights DemoScene assigns them to, and the buffer
+// every map's casters are written to.
+D3D11ShadowMaps g_d3dShadowMaps;
+ID3D11InputLayout* g_d3dShadowInputLayout = nullptr;
+ID3D11InputLayout* g_d3dPackedShadowInputLayout = nullptr;
+ID3D11Buffer* g_d3dShadowCasterBuffer = nullptr;
+UINT g_ShadowCasterCounts[MaxShadowViews] = {};
+
+// Draws go through a sorted render queue. These are the ids packets use for
+// the D3D11 objects above.
+enum InputLayoutId { IL_Simple, IL_Instanced, IL_Packed, IL_PackedInstanced, IL_Shadow, IL_PackedShadow };
+enum VertexShaderId { VS_Simple, VS_Instanced, VS_Packed, VS_PackedInstanced, VS_Shadow, VS_PackedShadow };
+enum PixelShaderId { PX_Simple, PX_Unlit, PX_Instanced };
+enum VertexBufferId { VB_Cube, VB_CubePacked, VB_Plane, VB_PlaneInstances, VB_CubeFieldInstances, VB_Light, VB_ShadowCasters };
+enum IndexBufferId { IB_Cube, IB_Plane, IB_Light };
+
+// Every shader in the archive, with the id draw packets bind it by. The name
+// is the .hlsl file's; -packshaders reads <name>.cso (<name>_d.cso in debug
+// builds).
+struct ArchivedShader
 {
-    _Material()
-        : Emissive(0.0f, 0.0f, 0.0f, 1.0f)
-        , Ambient(0.1f, 0.1f, 0.1f, 1.0f)
-        , Diffuse(1.0f, 1.0f, 1.0f, 1.0f)
-        , Specular(1.0f, 1.0f, 1.0f, 1.0f)
-        , SpecularPower(128.0f)
-        , UseTexture(false)
-    {}
-
-    DirectX::XMFLOAT4 Emissive;
-    //----------------------------------- (16 byte boundary)
-    DirectX::XMFLOAT4 Ambient;
-    //----------------------------------- (16 byte boundary)
-    DirectX::XMFLOAT4 Diffuse;
-    //----------------------------------- (16 byte boundary)
-    DirectX::XMFLOAT4 Specular;
-    //----------------------------------- (16 byte boundary)
-    float SpecularPower;
-    // Add some padding complete the 16 byte boundary.
-    int UseTexture;
-    // Add some padding to complete the 16 byte boundary.
-    float Padding[2];
-    //----------------------------------- (16 byte boundary)
-    // Total: 80 bytes (5 * 16)
+    const char* Name;
+    const char* Profile;
+    uint8_t Id;     // VertexShaderId or PixelShaderId, by profile.
 };
 
-struct MaterialProperties
+const ArchivedShader g_ArchivedShaders[] =
 {
-    _Material Material;
+    { "SimpleVertexShader", "vs_5_0", VS_Simple },
+    { "InstancedVertexShader", "vs_5_0", VS_Instanced },
+    { "PackedVertexShader", "vs_5_0", VS_Packed },
+    { "PackedInstancedVertexShader", "vs_5_0", VS_PackedInstanced },
+    { "ShadowVertexShader", "vs_5_0", VS_Shadow },
+    { "PackedShadowVertexShader", "vs_5_0", VS_PackedShadow },
+    { "SimplePixelShader", "ps_5_0", PX_Simple },
+    { "UnlitPixelShader", "ps_5_0", PX_Unlit },
+    { "InstancedPixelShader", "ps_5_0", PX_Instanced },
 };
 
-enum LightType
-{
-    DirectionalLight = 0,
-    PointLight = 1,
-    SpotLight = 2
-};
-
-struct Light
-{
-    Light()
-        : Position(0.0f, 0.0f, 0.0f, 1.0f)
-        , Direction(0.0f, 0.0f, 1.0f, 0.0f)
-        , Color(1.0f, 1.0f, 1.0f, 1.0f)
-        , SpotAngle(DirectX::XM_PIDIV2)
-        , ConstantAttenuation(1.0f)
-        , LinearAttenuation(0.0f)
-        , QuadraticAttenuation(0.0f)
-        , LightType(DirectionalLight)
-        , Enabled(0)
-    {}
-
-    DirectX::XMFLOAT4    Position;
-    //----------------------------------- (16 byte boundary)
-    DirectX::XMFLOAT4    Direction;
-    //----------------------------------- (16 byte boundary)
-    DirectX::XMFLOAT4    Color;
-    //----------------------------------- (16 byte boundary)
-    float       SpotAngle;
-    float       ConstantAttenuation;
-    float       LinearAttenuation;
-    float       QuadraticAttenuation;
-    //----------------------------------- (16 byte boundary)
-    int         LightType;
-    int         Enabled;
-    // Add some padding to make this struct size a multiple of 16 bytes.
-    int         Padding[2];
-    //----------------------------------- (16 byte boundary)
-};  // Total:                              80 bytes ( 5 * 16 )
-
-struct alignas(16) LightProperties
-{
-    LightProperties()
-        : EyePosition(0.0f, 0.0f, 0.0f, 1.0f)
-        , GlobalAmbient(0.2f, 0.2f, 0.8f, 1.0f)
-    {}
-
-    DirectX::XMFLOAT4   EyePosition;
-    //----------------------------------- (16 byte boundary)
-    DirectX::XMFLOAT4   GlobalAmbient;
-    //----------------------------------- (16 byte boundary)
-    Light               Lights[MAX_LIGHTS]; // 80 * 8 bytes
-    //----------------------------------- (16 byte boundary)
-    int PhongShadingMode;
-    int Padding[3];
-    //----------------------------------- (16 byte boundary)
-    // Total:                             672 bytes (42 * 16)
-} g_LightProperties;
-
-std::vector<MaterialProperties> g_MaterialProperties;
-
-VertexPosNormColTex* g_Vertices;
-WORD* g_Indicies;
-int g_VerticesLength, g_IndicesLength;
-
-// Vertices for a unit plane.
-VertexPosNormColTex g_PlaneVerts[4] =
-{
-    { XMFLOAT3(-0.5f, 0.0f,  0.5f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT2(0.0f, 0.0f) }, // 0
-    { XMFLOAT3(0.5f, 0.0f,  0.5f), XMFLOAT3(0.0f, 1.0f, 0.0f),  XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT2(1.0f, 0.0f) }, // 1
-    { XMFLOAT3(0.5f, 0.0f, -0.5f), XMFLOAT3(0.0f, 1.0f, 0.0f),  XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT2(1.0f, 1.0f) }, // 2
-    { XMFLOAT3(-0.5f, 0.0f, -0.5f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT2(0.0f, 1.0f) }  // 3
-};
-
-// Index buffer for the unit plane.
-WORD g_PlaneIndex[6] =
-{
-    0, 1, 3, 1, 2, 3
-};
+RenderQueue g_RenderQueue;
+RenderStateCache g_RenderStateCache;
+D3D11RenderContext* g_RenderContext = nullptr;
+std::vector<PerObjectTransformData> g_ObjectConstants;
+std::vector<ConstantBufferSlice> g_ObjectConstantSlices;
+std::vector<ConstantBufferSlice> g_MaterialSlices;
+// Slices bound for the whole frame rather than per draw.
+ConstantBufferSlice g_LightSlice = {};
+ConstantBufferSlice g_ClusterSlice = {};
+ConstantBufferSlice g_QuantizationSlice = {};
+ConstantBufferSlice g_ShadowSlice = {};
+// Per-frame constants of each shadow map's pass: its view-projection.
+ConstantBufferSlice g_ShadowViewSlices[MaxShadowViews] = {};
+
+// Record the draws of each pass into command lists on worker threads and
+// replay them on deferred contexts, one list per worker, instead of issuing
+// them on the immediate context (-deferredcontexts).
+bool g_UseDeferredContexts = false;
+D3D11DeferredContexts g_DeferredContexts;
+std::vector<CommandList> g_CommandLists;
+
+// The CPU work of a frame as a task graph: camera, transforms, culling, light
+// binning and draw collection run on the job system as soon as their inputs
+// are ready. Built once by LoadContent, run by Render.
+TaskGraph g_FrameGraph;
+float g_FrameInterpolation = 1.0f;
+// Instance buffers Render maps for the graph's stages to write.
+PlaneInstanceData* g_MappedPlaneInstances = nullptr;
+PlaneInstanceData* g_MappedCubeFieldInstances = nullptr;
+ShadowInstanceData* g_MappedShadowCasters = nullptr;
+UINT g_VisiblePlaneInstanceCount = 0;
+UINT g_VisibleCubeFieldInstanceCount = 0;
 
 // Forward declarations.
 LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
@@ -227,6 +278,8 @@ bool LoadContent();
 void UnloadContent();
 
 void Update(float deltaTime);
+void PrepareCamera(float interpolation);
+void BuildFrameGraph();
 void Render();
 void Cleanup();
 
@@ -237,95 +290,25 @@ ArrayLength(const A& a)
     return std::extent<A>::value;
 }
 
-void CreateCube(float size)
+// The entity whose box a ray from g_Camera through pixel (x, y) hits first,
+// or InvalidEntity.
+Entity PickEntity(int x, int y)
 {
-    // A cube has six faces, each one pointing in a different direction.
-    const int FaceCount = 6;
-
-    static const XMVECTORF32 faceNormals[FaceCount] =
-    {
-        { 0,  0,  1 },
-        { 0,  0, -1 },
-        { 1,  0,  0 },
-        { -1,  0,  0 },
-        { 0,  1,  0 },
-        { 0, -1,  0 },
-    };
-
-    static const XMFLOAT2 textureCoordinates[4] =
-    {
-        { 1, 0 },
-        { 1, 1 },
-        { 0, 1 },
-        { 0, 0 },
-    };
-
-    std::vector<VertexPosNormColTex> vertices;
-    std::vector<uint16_t> indices;
-
-    size /= 2;
-
-    // Create each face in turn.
-    for (int i = 0; i < FaceCount; i++)
-    {
-        XMVECTOR normal = faceNormals[i];
-
-        // Get two vectors perpendicular both to the face normal and to each other.
-        XMVECTOR basis = (i >= 4) ? g_XMIdentityR2 : g_XMIdentityR1;
-
-        XMVECTOR side1 = XMVector3Cross(normal, basis);
-        XMVECTOR side2 = XMVector3Cross(normal, side1);
-
-        // Six indices (two triangles) per face.
-        uint16_t vbase = static_cast<uint16_t>(vertices.size());
-        indices.push_back(vbase + 0);
-        indices.push_back(vbase + 1);
-        indices.push_back(vbase + 2);
-
-        indices.push_back(vbase + 0);
-        indices.push_back(vbase + 2);
-        indices.push_back(vbase + 3);
-
-        auto vectorToFloat3 = [](XMVECTOR& v)
-        {
-            return XMFLOAT3(XMVectorGetX(v), XMVectorGetY(v), XMVectorGetZ(v));
-        };
-
-        // Four vertices per face.
-        vertices.push_back({ vectorToFloat3((normal - side1 - side2) * size), vectorToFloat3(normal), XMFLOAT3(0.0f, 1.0f, 0.0f), textureCoordinates[0] });
-        vertices.push_back({ vectorToFloat3((normal - side1 + side2) * size), vectorToFloat3(normal), XMFLOAT3(0.0f, 1.0f, 0.0f), textureCoordinates[1] });
-        vertices.push_back({ vectorToFloat3((normal + side1 + side2) * size), vectorToFloat3(normal), XMFLOAT3(0.0f, 1.0f, 0.0f), textureCoordinates[2] });
-        vertices.push_back({ vectorToFloat3((normal + side1 - side2) * size), vectorToFloat3(normal), XMFLOAT3(0.0f, 1.0f, 0.0f), textureCoordinates[3] });
-    }
-
-    {// Reverse Winding order
-        assert((indices.size() % 3) == 0);
-        for (auto it = indices.begin(); it != indices.end(); it += 3)
-        {
-            std::swap(*it, *(it + 2));
-        }
-
-        for (auto it = vertices.begin(); it != vertices.end(); ++it)
-        {
-            it->Texture.x = (1.f - it->Texture.x);
-        }
-    }
-
-    if (g_Vertices)
-    {
-        delete[] g_Vertices;
-    }
-    g_VerticesLength = static_cast<int>(vertices.size());
-    g_Vertices = new VertexPosNormColTex[g_VerticesLength];
-    std::copy(vertices.begin(), vertices.end(), stdext::checked_array_iterator<VertexPosNormColTex*>(g_Vertices, g_VerticesLength));
-
-    if (g_Indicies)
+    const XMMATRIX& projection = g_Camera.GetProjectionMatrix();
+    const float ndcX = 2.0f * (x + 0.5f) / g_Viewport.Width - 1.0f;
+    const float ndcY = 1.0f - 2.0f * (y + 0.5f) / g_Viewport.Height;
+    const XMVECTOR viewDirection = XMVectorSet(ndcX / XMVectorGetX(projection.r[0]), ndcY / XMVectorGetY(projection.r[1]), 1.0f, 0.0f);
+    const XMMATRIX inverseView = XMMatrixInverse(nullptr, g_Camera.GetViewMatrix());
+
+    XMFLOAT3 origin, direction;
+    XMStoreFloat3(&origin, inverseView.r[3]);
+    XMStoreFloat3(&direction, XMVector3Normalize(XMVector3TransformNormal(viewDirection, inverseView)));
+    RayHit hit;
+    if (!g_SceneTree.RayCast(origin, direction, g_Camera.GetProjection().FarZ, hit))
     {
-        delete[] g_Indicies;
+        return InvalidEntity;
     }
-    g_IndicesLength = static_cast<int>(indices.size());
-    g_Indicies = new WORD[g_IndicesLength];
-    std::copy(indices.begin(), indices.end(), stdext::checked_array_iterator<WORD*>(g_Indicies, g_IndicesLength));
+    return hit.UserData;
 }
 
 /**
@@ -381,6 +364,13 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
         EndPaint(hwnd, &paintStruct);
     }
     break;
+    case WM_LBUTTONDOWN:
+    {
+        g_PickRequested = true;
+        g_PickX = static_cast<short>(LOWORD(lParam));
+        g_PickY = static_cast<short>(HIWORD(lParam));
+    }
+    break;
     case WM_DESTROY:
     {
         PostQuitMessage(0);
@@ -394,38 +384,76 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 }
 
 /**
-* The main application loop.
+* Collect the frame's zones while -trace is recording and write the trace
+* files once g_TraceFrameCount frames are in.
+*/
+void CollectTraceFrame()
+{
+    if (!Profiler::IsEnabled())
+    {
+        return;
+    }
+
+    g_ProfileRecorder.Collect();
+    if (++g_TracedFrameCount == g_TraceFrameCount)
+    {
+        Profiler::SetEnabled(false);
+        const ProfileCapture& capture = g_ProfileRecorder.GetCapture();
+        if (!WriteChromeTrace("Trace.json", capture) || !WriteProfileCapture("Trace.ldpc", capture))
+        {
+            MessageBoxA(nullptr, "Failed to write the trace.", "Error", MB_OK | MB_ICONERROR);
+        }
+        g_ProfileRecorder.Clear();
+    }
+}
+
+/**
+* The main application loop. The simulation advances in fixed steps and
+* every frame renders between the last two steps.
 */
 int Run()
 {
     MSG msg = { 0 };
 
-    static DWORD previousTime = timeGetTime();
-    static const float targetFramerate = 30.0f;
-    static const float maxTimeStep = 1.0f / targetFramerate;
+    // Sleeps in the frame cap are only as fine as the system timer.
+    timeBeginPeriod(1);
+
+    SteadyFrameClock clock;
+    FrameScheduler scheduler(clock, g_FrameSchedulerSettings);
+    g_PreviousCamera = g_Camera;
+    g_Scene.SaveState();
 
     while (msg.message != WM_QUIT)
     {
-        if (PeekMessage(&msg, 0, 0, 0, PM_REMOVE))
+        while (msg.message != WM_QUIT && PeekMessage(&msg, 0, 0, 0, PM_REMOVE))
         {
             TranslateMessage(&msg);
             DispatchMessage(&msg);
         }
-        else
+        if (msg.message == WM_QUIT)
         {
-            DWORD currentTime = timeGetTime();
-            float deltaTime = (currentTime - previousTime) / 1000.0f;
-            previousTime = currentTime;
-
-            // Cap the delta time to the max time step (useful if your 
-            // debugging and you don't want the deltaTime value to explode.
-            deltaTime = std::min<float>(deltaTime, maxTimeStep);
+            break;
+        }
 
-            Update(deltaTime);
+        {// Simulate, render and wait for the frame cap.
+            PROFILE_SCOPE("Frame");
+            const uint32_t stepCount = scheduler.BeginFrame();
+            for (uint32_t step = 0; step < stepCount; ++step)
+            {
+                g_PreviousCamera = g_Camera;
+                g_Scene.SaveState();
+                Update(scheduler.GetFixedStep());
+            }
+            g_FrameInterpolation = scheduler.GetInterpolation();
             Render();
+            scheduler.EndFrame();
         }
+
+        CollectTraceFrame();
     }
 
+    timeEndPeriod(1);
+
     return static_cast<int>(msg.wParam);
 }
 
@@ -499,6 +527,12 @@ int InitDirectX(HINSTANCE hInstance, BOOL vSync)
         return -1;
     }
 
+    hr = g_d3dDeviceContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&g_d3dDeviceContext1);
+    if (FAILED(hr))
+    {
+        return -1;
+    }
+
     // Next initialize the back buffer of the swap chain and associate it to a 
     // render target view.
     ID3D11Texture2D* backBuffer;
@@ -523,7 +557,8 @@ int InitDirectX(HINSTANCE hInstance, BOOL vSync)
     depthStencilBufferDesc.ArraySize = 1;
     depthStencilBufferDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
     depthStencilBufferDesc.CPUAccessFlags = 0; // No CPU access required.
-    depthStencilBufferDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+    // Reversed Z only gains precision with a float depth buffer.
+    depthStencilBufferDesc.Format = (g_DepthMode == DM_ReversedInfinite) ? DXGI_FORMAT_D32_FLOAT_S8X24_UINT : DXGI_FORMAT_D24_UNORM_S8_UINT;
     depthStencilBufferDesc.Width = clientWidth;
     depthStencilBufferDesc.Height = clientHeight;
     depthStencilBufferDesc.MipLevels = 1;
@@ -549,7 +584,7 @@ int InitDirectX(HINSTANCE hInstance, BOOL vSync)
 
     depthStencilStateDesc.DepthEnable = TRUE;
     depthStencilStateDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
-    depthStencilStateDesc.DepthFunc = D3D11_COMPARISON_LESS;
+    depthStencilStateDesc.DepthFunc = (g_DepthMode == DM_ReversedInfinite) ? D3D11_COMPARISON_GREATER : D3D11_COMPARISON_LESS;
     depthStencilStateDesc.StencilEnable = FALSE;
 
     hr = g_d3dDevice->CreateDepthStencilState(&depthStencilStateDesc, &g_d3dDepthStencilState);
@@ -601,7 +636,7 @@ int InitDirectX(HINSTANCE hInstance, BOOL vSync)
     samplerDesc.BorderColor[2] = 1.0f;
     samplerDesc.BorderColor[3] = 1.0f;
     samplerDesc.MinLOD = 0;
-    samplerDesc.MaxLOD = 0;
+    samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
 
     hr = g_d3dDevice->CreateSamplerState(&samplerDesc, &g_d3dSamplerState);
     if (FAILED(hr))
@@ -614,6 +649,7 @@ int InitDirectX(HINSTANCE hInstance, BOOL vSync)
 
 bool LoadContent()
 {
+    PROFILE_FUNCTION();
     assert(g_d3dDevice);
 
     D3D11_SUBRESOURCE_DATA resourceData;
@@ -621,163 +657,111 @@ bool LoadContent()
 
     HRESULT hr;
 
-    {// Create Cube Index/Vertex data
-        CreateCube(2.0f);
-    }
-
-    {// Create an initialize the simple vertex buffer.
-        D3D11_BUFFER_DESC vertexBufferDesc;
-        ZeroMemory(&vertexBufferDesc, sizeof(D3D11_BUFFER_DESC));
+    {// Map the cooked cube mesh and create its buffers from the mapping.
+        const MeshVertexFormat cubeVertexFormat = !g_UsePackedVertices ? MVF_PosNormColTex :
+            (g_CubePositionEncoding == PE_Unorm16) ? MVF_PackedUnorm16 : MVF_PackedHalf;
 
-        vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-        vertexBufferDesc.ByteWidth = sizeof(VertexPosNormColTex) * g_VerticesLength;
-        vertexBufferDesc.CPUAccessFlags = 0;
-        vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-
-        resourceData.pSysMem = g_Vertices;
-
-        hr = g_d3dDevice->CreateBuffer(&vertexBufferDesc, &resourceData, &g_d3dSimpleVertexBuffer);
-        if (FAILED(hr))
+        MappedMeshFile cubeMeshFile;
+        if (!cubeMeshFile.Open(g_CubeMeshFileName) || cubeMeshFile.GetHeader().VertexFormat != cubeVertexFormat)
         {
-            MessageBoxA(nullptr, "Failed to create vertex buffer for simple vertex shader.", "Error", MB_OK | MB_ICONERROR);
-            return false;
+            cubeMeshFile.Close();
+            CreateCube(2.0f);
+            const bool cooked = WriteMeshFile(g_CubeMeshFileName, g_CubeMesh, cubeVertexFormat);
+            g_CubeMesh = Mesh();
+            if (!cooked || !cubeMeshFile.Open(g_CubeMeshFileName))
+            {
+                MessageBoxA(nullptr, "Failed to cook the cube mesh file.", "Error", MB_OK | MB_ICONERROR);
+                return false;
+            }
         }
-    }
-
-    {// Create and initialize the simple index buffer.
-        D3D11_BUFFER_DESC indexBufferDesc;
-        ZeroMemory(&indexBufferDesc, sizeof(D3D11_BUFFER_DESC));
 
-        indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-        indexBufferDesc.ByteWidth = sizeof(WORD) * g_IndicesLength;
-        indexBufferDesc.CPUAccessFlags = 0;
-        indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-        resourceData.pSysMem = g_Indicies;
-
-        hr = g_d3dDevice->CreateBuffer(&indexBufferDesc, &resourceData, &g_d3dSimpleIndexBuffer);
-        if (FAILED(hr))
+        ID3D11Buffer** cubeVertexBuffer = g_UsePackedVertices ? &g_d3dPackedVertexBuffer : &g_d3dSimpleVertexBuffer;
+        if (!CreateMeshFileBuffers(g_d3dDevice, cubeMeshFile, cubeVertexBuffer, &g_d3dSimpleIndexBuffer))
         {
-            MessageBoxA(nullptr, "Failed to create index buffer for simple vertex shader.", "Error", MB_OK | MB_ICONERROR);
+            MessageBoxA(nullptr, "Failed to create the cube vertex and index buffers.", "Error", MB_OK | MB_ICONERROR);
             return false;
         }
+        g_CubeQuantization = cubeMeshFile.GetQuantization();
+        g_CubeIndexCount = static_cast<uint32_t>(cubeMeshFile.GetHeader().IndexCount);
+        g_CubeIndexFormat = GetMeshFileIndexFormat(cubeMeshFile.GetHeader());
     }
 
-    {// Create the constant buffers for the variables defined in the vertex shaders.
-        D3D11_BUFFER_DESC constantBufferDesc;
-        ZeroMemory(&constantBufferDesc, sizeof(D3D11_BUFFER_DESC));
+    {// Create the light gizmo buffers, every level of detail in one pair.
+        CreateLightMesh(1.0f);
 
-        constantBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-        constantBufferDesc.ByteWidth = sizeof(XMMATRIX);
-        constantBufferDesc.CPUAccessFlags = 0;
-        constantBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+        D3D11_BUFFER_DESC bufferDesc;
+        ZeroMemory(&bufferDesc, sizeof(D3D11_BUFFER_DESC));
+        bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        bufferDesc.ByteWidth = static_cast<UINT>(sizeof(VertexPosNormColTex) * g_LightMesh.Vertices.size());
+        bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+        resourceData.pSysMem = g_LightMesh.Vertices.data();
 
-        hr = g_d3dDevice->CreateBuffer(&constantBufferDesc, nullptr, &g_d3dConstantBuffers[CB_Frame]);
+        hr = g_d3dDevice->CreateBuffer(&bufferDesc, &resourceData, &g_d3dLightVertexBuffer);
         if (FAILED(hr))
         {
-            MessageBoxA(nullptr, "Failed to create instanced vertex shader cbuffer.", "Error", MB_OK | MB_ICONERROR);
+            MessageBoxA(nullptr, "Failed to create the light gizmo vertex buffer.", "Error", MB_OK | MB_ICONERROR);
             return false;
         }
 
-        constantBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-        constantBufferDesc.ByteWidth = sizeof(PerObjectTransformData);
-        constantBufferDesc.CPUAccessFlags = 0;
-        constantBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+        bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+        bufferDesc.ByteWidth = static_cast<UINT>(g_LightMesh.GetIndexSize() * g_LightMesh.GetIndexCount());
+        resourceData.pSysMem = g_LightMesh.GetIndexData();
 
-        hr = g_d3dDevice->CreateBuffer(&constantBufferDesc, nullptr, &g_d3dConstantBuffers[CB_Object]);
+        hr = g_d3dDevice->CreateBuffer(&bufferDesc, &resourceData, &g_d3dLightIndexBuffer);
         if (FAILED(hr))
         {
-            MessageBoxA(nullptr, "Failed to create simple vertex shader cbuffer.", "Error", MB_OK | MB_ICONERROR);
+            MessageBoxA(nullptr, "Failed to create the light gizmo index buffer.", "Error", MB_OK | MB_ICONERROR);
             return false;
         }
     }
 
-    {// Load the compiled vertex shader.
-        ID3DBlob* vertexShaderBlob;
-#if _DEBUG
-        LPCWSTR compiledVertexShaderObject = L"SimpleVertexShader_d.cso";
-#else
-        LPCWSTR compiledVertexShaderObject = L"SimpleVertexShader.cso";
-#endif
-
-        hr = D3DReadFileToBlob(compiledVertexShaderObject, &vertexShaderBlob);
-        if (FAILED(hr))
+    {// Create the constant buffer ring that all cbuffers are allocated from.
+        if (!g_ConstantBufferRing.Create(g_d3dDevice, g_d3dDeviceContext, g_ConstantBufferRingSize, g_FramesInFlight))
         {
+            MessageBoxA(nullptr, "Failed to create constant buffer ring. Direct3D 11.1 constant buffer offsets are required.", "Error", MB_OK | MB_ICONERROR);
             return false;
         }
+    }
 
-        hr = g_d3dDevice->CreateVertexShader(vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(), nullptr, &g_d3dVertexShader);
-        if (FAILED(hr))
+    {// Create the GPU zone queries, read back one frame later than the constant buffer ring waits.
+        if (!g_GpuProfiler.Create(g_d3dDevice, g_d3dDeviceContext, g_FramesInFlight + 1, g_GpuProfilerMaxZones))
         {
+            MessageBoxA(nullptr, "Failed to create GPU profiler queries.", "Error", MB_OK | MB_ICONERROR);
             return false;
         }
-
-        {// Create the input layout for the simple vertex shader.
-            D3D11_INPUT_ELEMENT_DESC vertexLayoutDesc[] =
-            {
-                { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-                { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-                { "COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-            };
-
-            hr = g_d3dDevice->CreateInputLayout(vertexLayoutDesc, _countof(vertexLayoutDesc), vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(), &g_d3dInputLayout);
-            if (FAILED(hr))
-            {
-                return false;
-            }
-
-            SafeRelease(vertexShaderBlob);
-        }
     }
 
-    {// Load the compiled pixel shader.
-        ID3DBlob* pixelShaderBlob;
-#if _DEBUG
-        LPCWSTR compiledPixelShaderObject = L"SimplePixelShader_d.cso";
-#else
-        LPCWSTR compiledPixelShaderObject = L"SimplePixelShader.cso";
-#endif
-
-        hr = D3DReadFileToBlob(compiledPixelShaderObject, &pixelShaderBlob);
-        if (FAILED(hr))
+    {// Map the shader archive. Shader objects are created on first use.
+        if (!g_ShaderArchive.Open(g_ShaderArchiveFileName))
         {
-            MessageBoxA(g_WindowHandle, "Failed to load pixel shader blob.", "Error", MB_OK | MB_ICONERROR);
+            MessageBoxA(g_WindowHandle, "Failed to open the shader archive. Run with -packshaders after building the shaders.", "Error", MB_OK | MB_ICONERROR);
             return false;
         }
+        g_ShaderCache.Create(g_d3dDevice, g_ShaderArchive);
+    }
 
-        hr = g_d3dDevice->CreatePixelShader(pixelShaderBlob->GetBufferPointer(), pixelShaderBlob->GetBufferSize(), nullptr, &g_d3dPixelShader);
-        if (FAILED(hr))
+    {// Create the input layout for the simple vertex shader.
+        const uint32_t vertexShader = g_ShaderArchive.Find("SimpleVertexShader", "vs_5_0");
+        if (vertexShader == InvalidShaderEntry)
         {
-            MessageBoxA(g_WindowHandle, "Failed to create pixel shader.", "Error", MB_OK | MB_ICONERROR);
+            MessageBoxA(g_WindowHandle, "Failed to find the simple vertex shader in the shader archive.", "Error", MB_OK | MB_ICONERROR);
             return false;
         }
 
-        SafeRelease(pixelShaderBlob);
-    }
-
-    {// Load the compiled unlit pixel shader.
-        ID3DBlob* unlitPixelShaderBlob;
-#if _DEBUG
-        LPCWSTR compiledUnlitPixelShaderObject = L"UnlitPixelShader_d.cso";
-#else
-        LPCWSTR compiledUnlitPixelShaderObject = L"UnlitPixelShader.cso";
-#endif
-
-        hr = D3DReadFileToBlob(compiledUnlitPixelShaderObject, &unlitPixelShaderBlob);
-        if (FAILED(hr))
+        D3D11_INPUT_ELEMENT_DESC vertexLayoutDesc[] =
         {
-            MessageBoxA(g_WindowHandle, "Failed to load pixel shader blob.", "Error", MB_OK | MB_ICONERROR);
-            return false;
-        }
+            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        };
 
-        hr = g_d3dDevice->CreatePixelShader(unlitPixelShaderBlob->GetBufferPointer(), unlitPixelShaderBlob->GetBufferSize(), nullptr, &g_d3dUnlitPixelShader);
+        hr = g_d3dDevice->CreateInputLayout(vertexLayoutDesc, _countof(vertexLayoutDesc), g_ShaderArchive.GetBytecode(vertexShader),
+            g_ShaderArchive.GetBytecodeSize(vertexShader), &g_d3dInputLayout);
         if (FAILED(hr))
         {
-            MessageBoxA(g_WindowHandle, "Failed to create pixel shader.", "Error", MB_OK | MB_ICONERROR);
             return false;
         }
-
-        SafeRelease(unlitPixelShaderBlob);
     }
 
     {// Setup the projection matrix.
@@ -789,22 +773,26 @@ bool LoadContent()
         float clientWidth = static_cast<float>(clientRect.right - clientRect.left);
         float clientHeight = static_cast<float>(clientRect.bottom - clientRect.top);
 
-        g_ProjectionMatrix = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), clientWidth / clientHeight, 0.1f, 100.0f);
+        CameraProjection projection;
+        projection.AspectRatio = clientWidth / clientHeight;
+        projection.Depth = g_DepthMode;
+        g_Camera.SetProjection(projection);
+        // Lights are binned out to FarZ, where the frustum planes cull.
+        g_LightClusters.SetProjection(g_Camera.GetProjectionMatrix(), clientWidth, clientHeight, projection.NearZ, projection.FarZ);
     }
 
-    {// Load textures
-        auto effectFactory = std::unique_ptr<EffectFactory>(new EffectFactory(g_d3dDevice));
-        effectFactory->SetDirectory(L"..\\assets");
-
-        try
+    {// Start streaming textures. One that fails to decode keeps the placeholder.
+        if (!g_TextureUploadSink.Create(g_d3dDevice, g_d3dDeviceContext))
         {
-            effectFactory->CreateTexture(L"container.jpg", g_d3dDeviceContext, &g_textureShaderResourceView);
-        }
-        catch (std::exception&)
-        {
-            MessageBoxA(nullptr, "Failed to load texture.", "Error", MB_OK | MB_ICONERROR);
+            MessageBoxA(nullptr, "Failed to create the placeholder texture.", "Error", MB_OK | MB_ICONERROR);
             return false;
         }
+
+        TextureStreamingSettings settings;
+        settings.BudgetBytes = g_TextureBudget;
+        g_TextureStreamer.reset(new TextureStreamer(g_TextureDecoder, g_TextureUploadSink, settings));
+        const bool cooked = GetFileAttributesW(WidenPath(g_ContainerTextureCooked).c_str()) != INVALID_FILE_ATTRIBUTES;
+        g_ContainerTexture = g_TextureStreamer->Request(cooked ? g_ContainerTextureCooked : g_ContainerTextureSource);
     }
 
     {// Create and setup the per-instance buffer data
@@ -834,76 +822,28 @@ bool LoadContent()
         }
 
         // Move onto the plane (quad) instance data.
-        const int numInstances = 6;
-        PlaneInstanceData* planeInstanceData = (PlaneInstanceData*)_aligned_malloc(sizeof(PlaneInstanceData) * numInstances, 16);
-
-        float scalePlane = 20.0f;
-        float translateOffset = scalePlane / 2.0f;
-        XMMATRIX scaleMatrix = XMMatrixScaling(scalePlane, 1.0f, scalePlane);
-        XMMATRIX translateMatrix = XMMatrixTranslation(0, 0, 0);
-        XMMATRIX rotateMatrix = XMMatrixRotationX(0.0f);
-
-        // Floor plane.
-        XMMATRIX worldMatrix = scaleMatrix * rotateMatrix * translateMatrix;
-        planeInstanceData[0].WorldMatrix = worldMatrix;
-        planeInstanceData[0].InverseTransposeWorldMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, worldMatrix));
-
-        // Back wall plane.
-        translateMatrix = XMMatrixTranslation(0, translateOffset, translateOffset);
-        rotateMatrix = XMMatrixRotationX(XMConvertToRadians(-90));
-        worldMatrix = scaleMatrix * rotateMatrix * translateMatrix;
-
-        planeInstanceData[1].WorldMatrix = worldMatrix;
-        planeInstanceData[1].InverseTransposeWorldMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, worldMatrix));
-
-        // Ceiling plane.
-        translateMatrix = XMMatrixTranslation(0, translateOffset * 2.0f, 0);
-        rotateMatrix = XMMatrixRotationX(XMConvertToRadians(180));
-        worldMatrix = scaleMatrix * rotateMatrix * translateMatrix;
-
-        planeInstanceData[2].WorldMatrix = worldMatrix;
-        planeInstanceData[2].InverseTransposeWorldMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, worldMatrix));
+        const int numInstances = g_NumPlaneInstances;
+        g_PlaneInstanceData = (PlaneInstanceData*)_aligned_malloc(sizeof(PlaneInstanceData) * numInstances, 16);
+        CreatePlaneInstances(g_PlaneInstanceData);
 
-        // Front wall plane.
-        translateMatrix = XMMatrixTranslation(0, translateOffset, -translateOffset);
-        rotateMatrix = XMMatrixRotationX(XMConvertToRadians(90));
-        worldMatrix = scaleMatrix * rotateMatrix * translateMatrix;
-
-        planeInstanceData[3].WorldMatrix = worldMatrix;
-        planeInstanceData[3].InverseTransposeWorldMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, worldMatrix));
-
-        // Left wall plane.
-        translateMatrix = XMMatrixTranslation(-translateOffset, translateOffset, 0);
-        rotateMatrix = XMMatrixRotationZ(XMConvertToRadians(-90));
-        worldMatrix = scaleMatrix * rotateMatrix * translateMatrix;
-
-        planeInstanceData[4].WorldMatrix = worldMatrix;
-        planeInstanceData[4].InverseTransposeWorldMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, worldMatrix));
-
-        // Right wall plane.
-        translateMatrix = XMMatrixTranslation(translateOffset, translateOffset, 0);
-        rotateMatrix = XMMatrixRotationZ(XMConvertToRadians(90));
-        worldMatrix = scaleMatrix * rotateMatrix * translateMatrix;
-
-        planeInstanceData[5].WorldMatrix = worldMatrix;
-        planeInstanceData[5].InverseTransposeWorldMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, worldMatrix));
+        // World bounds of the unit plane for culling.
+        ComputeInstanceBounds(g_PlaneInstanceData, numInstances, XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.0f, 0.5f), g_PlaneInstanceBounds);
 
         {// Create the per-instance instance buffer.
+            // Dynamic: rewritten every frame with the instances that survive culling.
             D3D11_BUFFER_DESC instanceBufferDesc;
             ZeroMemory(&instanceBufferDesc, sizeof(D3D11_BUFFER_DESC));
 
             instanceBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
             instanceBufferDesc.ByteWidth = sizeof(PlaneInstanceData) * numInstances;
-            instanceBufferDesc.CPUAccessFlags = 0;
-            instanceBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+            instanceBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+            instanceBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
 
             ZeroMemory(&resourceData, sizeof(D3D11_SUBRESOURCE_DATA));
-            resourceData.pSysMem = planeInstanceData;
+            resourceData.pSysMem = g_PlaneInstanceData;
 
             hr = g_d3dDevice->CreateBuffer(&instanceBufferDesc, &resourceData, &g_d3dInstancedVertexBuffer_Instances);
 
-            _aligned_free(planeInstanceData);
-
             if (FAILED(hr))
             {
                 MessageBoxA(g_WindowHandle, "Failed to create instanced vertex buffer.", "Error", MB_OK | MB_ICONERROR);
@@ -912,12 +852,42 @@ bool LoadContent()
         }
     }
 
+    {// Create the scene entities and the tree scene queries use.
+        CreateSceneEntities();
+        BuildSceneTree();
+    }
+
+    {// Create the occlusion buffer the walls are rasterized into.
+        if (!g_OcclusionBuffer.Create(g_OcclusionBufferWidth, g_OcclusionBufferHeight))
+        {
+            MessageBoxA(g_WindowHandle, "Failed to create the occlusion buffer.", "Error", MB_OK | MB_ICONERROR);
+            return false;
+        }
+    }
+
+    {// Create the cube field instance buffer, rewritten every frame.
+        D3D11_BUFFER_DESC instanceBufferDesc;
+        ZeroMemory(&instanceBufferDesc, sizeof(D3D11_BUFFER_DESC));
+
+        instanceBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        instanceBufferDesc.ByteWidth = sizeof(PlaneInstanceData) * g_NumCubeFieldInstances;
+        instanceBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        instanceBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+
+        hr = g_d3dDevice->CreateBuffer(&instanceBufferDesc, nullptr, &g_d3dCubeFieldInstanceBuffer);
+        if (FAILED(hr))
+        {
+            MessageBoxA(g_WindowHandle, "Failed to create cube field instance buffer.", "Error", MB_OK | MB_ICONERROR);
+            return false;
+        }
+    }
+
     {// Create the per-instance index buffer.
         D3D11_BUFFER_DESC instancedIndexBufferDesc;
         ZeroMemory(&instancedIndexBufferDesc, sizeof(D3D11_BUFFER_DESC));
 
         instancedIndexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-        instancedIndexBufferDesc.ByteWidth = sizeof(WORD) * _countof(g_PlaneIndex);
+        instancedIndexBufferDesc.ByteWidth = sizeof(WORD) * g_NumPlaneIndices;
         instancedIndexBufferDesc.CPUAccessFlags = 0;
         instancedIndexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
         resourceData.pSysMem = g_PlaneIndex;
@@ -930,29 +900,14 @@ bool LoadContent()
         }
     }
 
-    { // Load the compiled instanced vertex shader.
-        ID3DBlob* instancedVertexShaderBlob;
-#if _DEBUG
-        LPCWSTR compiledInstancedVertexShaderObject = L"InstancedVertexShader_d.cso";
-#else
-        LPCWSTR compiledInstancedVertexShaderObject = L"InstancedVertexShader.cso";
-#endif
-
-        hr = D3DReadFileToBlob(compiledInstancedVertexShaderObject, &instancedVertexShaderBlob);
-        if (FAILED(hr))
-        {
-            MessageBoxA(g_WindowHandle, "Failed to load instanced vertex shader blob.", "Error", MB_OK | MB_ICONERROR);
-            return false;
-        }
-
-        hr = g_d3dDevice->CreateVertexShader(instancedVertexShaderBlob->GetBufferPointer(), instancedVertexShaderBlob->GetBufferSize(), nullptr, &g_d3dInstancedVertexShader);
-        if (FAILED(hr))
+    {// Create the input layout for the instanced vertex shader.
+        const uint32_t instancedVertexShader = g_ShaderArchive.Find("InstancedVertexShader", "vs_5_0");
+        if (instancedVertexShader == InvalidShaderEntry)
         {
-            MessageBoxA(g_WindowHandle, "Failed to create instanced vertex shader.", "Error", MB_OK | MB_ICONERROR);
+            MessageBoxA(g_WindowHandle, "Failed to find the instanced vertex shader in the shader archive.", "Error", MB_OK | MB_ICONERROR);
             return false;
         }
 
-        // Create the input layout for rendering instanced vertex data.
         D3D11_INPUT_ELEMENT_DESC instancedVertexLayoutDesc[] =
         {
             // Per-vertex data.
@@ -968,97 +923,220 @@ bool LoadContent()
             { "INVERSETRANSPOSEWORLDMATRIX", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
             { "INVERSETRANSPOSEWORLDMATRIX", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
             { "INVERSETRANSPOSEWORLDMATRIX", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "MATERIALINDEX", 0, DXGI_FORMAT_R32_UINT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
         };
 
-        hr = g_d3dDevice->CreateInputLayout(instancedVertexLayoutDesc, _countof(instancedVertexLayoutDesc), instancedVertexShaderBlob->GetBufferPointer(),
-            instancedVertexShaderBlob->GetBufferSize(), &g_d3dInstancedInputLayout);
+        hr = g_d3dDevice->CreateInputLayout(instancedVertexLayoutDesc, _countof(instancedVertexLayoutDesc), g_ShaderArchive.GetBytecode(instancedVertexShader),
+            g_ShaderArchive.GetBytecodeSize(instancedVertexShader), &g_d3dInstancedInputLayout);
         if (FAILED(hr))
         {
             MessageBoxA(g_WindowHandle, "Failed to create input layout.", "Error", MB_OK | MB_ICONERROR);
             return false;
         }
+    }
 
-        SafeRelease(instancedVertexShaderBlob);
-    }
-
-    {// Create some materials
-        MaterialProperties defaultMaterial;
-        g_MaterialProperties.push_back(defaultMaterial);
-
-        MaterialProperties greenMaterial;
-        greenMaterial.Material.Ambient = XMFLOAT4(0.07568f, 0.61424f, 0.07568f, 1.0f);
-        greenMaterial.Material.Diffuse = XMFLOAT4(0.07568f, 0.61424f, 0.07568f, 1.0f);
-        greenMaterial.Material.Specular = XMFLOAT4(0.07568f, 0.61424f, 0.07568f, 1.0f);
-        greenMaterial.Material.SpecularPower = 76.8f;
-        g_MaterialProperties.push_back(greenMaterial);
-
-        MaterialProperties redPlasticMaterial;
-        redPlasticMaterial.Material.Diffuse = XMFLOAT4(0.6f, 0.1f, 0.1f, 1.0f);
-        redPlasticMaterial.Material.Specular = XMFLOAT4(1.0f, 0.2f, 0.2f, 1.0f);
-        redPlasticMaterial.Material.SpecularPower = 32.0f;
-		redPlasticMaterial.Material.UseTexture = true;
-        g_MaterialProperties.push_back(redPlasticMaterial);
-
-        MaterialProperties pearlMaterial;
-        pearlMaterial.Material.Ambient = XMFLOAT4(0.25f, 0.20725f, 0.20725f, 1.0f);
-        pearlMaterial.Material.Diffuse = XMFLOAT4(1.0f, 0.829f, 0.829f, 1.0f);
-        pearlMaterial.Material.Specular = XMFLOAT4(0.296648f, 0.296648f, 0.296648f, 1.0f);
-        pearlMaterial.Material.SpecularPower = 11.264f;
-        g_MaterialProperties.push_back(pearlMaterial);
-    }
-
-    {// Set a light
-        Light light;
-        light.Enabled = true;
-        light.LightType = LightType::PointLight;
-        light.Color = XMFLOAT4(Colors::White);
-        light.SpotAngle = XMConvertToRadians(45.0f);
-        light.ConstantAttenuation = 1.0f;
-        light.LinearAttenuation = 0.08f;
-        light.QuadraticAttenuation = 0.0f;
-        XMFLOAT4 LightPosition = XMFLOAT4(0, 12.0f, -1.0f, 1.0f);
-        light.Position = LightPosition;
-        g_LightProperties.Lights[0] = light;
-    }
-
-    {// Create constant buffer for light data
-        D3D11_BUFFER_DESC constantBufferDesc;
-        ZeroMemory(&constantBufferDesc, sizeof(D3D11_BUFFER_DESC));
-
-        constantBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-        constantBufferDesc.ByteWidth = sizeof(LightProperties);
-        constantBufferDesc.CPUAccessFlags = 0;
-        constantBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-
-        hr = g_d3dDevice->CreateBuffer(&constantBufferDesc, nullptr, &g_d3dLightPropertiesConstantBuffer);
-        if (FAILED(hr))
+    {// Create the input layouts of the packed vertex shaders.
+        struct PackedShader
+        {
+            const char* Name;
+            ID3D11InputLayout** InputLayout;
+            bool Instanced;
+        };
+
+        const PackedShader packedShaders[2] =
+        {
+            { "PackedVertexShader", &g_d3dPackedInputLayout, false },
+            { "PackedInstancedVertexShader", &g_d3dPackedInstancedInputLayout, true },
+        };
+
+        // Per-vertex elements from VertexPacked, followed by the same
+        // per-instance data as the instanced input layout.
+        D3D11_INPUT_ELEMENT_DESC packedVertexLayoutDesc[PackedVertexElementCount + 9];
+        GetPackedVertexElements(g_CubePositionEncoding, packedVertexLayoutDesc);
+        const D3D11_INPUT_ELEMENT_DESC instanceLayoutDesc[9] =
+        {
+            { "WORLDMATRIX", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "WORLDMATRIX", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "WORLDMATRIX", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "WORLDMATRIX", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "INVERSETRANSPOSEWORLDMATRIX", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "INVERSETRANSPOSEWORLDMATRIX", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "INVERSETRANSPOSEWORLDMATRIX", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "INVERSETRANSPOSEWORLDMATRIX", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "MATERIALINDEX", 0, DXGI_FORMAT_R32_UINT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        };
+        std::copy(std::begin(instanceLayoutDesc), std::end(instanceLayoutDesc), packedVertexLayoutDesc + PackedVertexElementCount);
+
+        for (const PackedShader& packedShader : packedShaders)
+        {
+            const uint32_t vertexShader = g_ShaderArchive.Find(packedShader.Name, "vs_5_0");
+            if (vertexShader == InvalidShaderEntry)
+            {
+                MessageBoxA(g_WindowHandle, "Failed to find a packed vertex shader in the shader archive.", "Error", MB_OK | MB_ICONERROR);
+                return false;
+            }
+
+            const UINT elementCount = packedShader.Instanced ? _countof(packedVertexLayoutDesc) : PackedVertexElementCount;
+            hr = g_d3dDevice->CreateInputLayout(packedVertexLayoutDesc, elementCount, g_ShaderArchive.GetBytecode(vertexShader),
+                g_ShaderArchive.GetBytecodeSize(vertexShader), packedShader.InputLayout);
+            if (FAILED(hr))
+            {
+                MessageBoxA(g_WindowHandle, "Failed to create packed vertex input layout.", "Error", MB_OK | MB_ICONERROR);
+                return false;
+            }
+        }
+    }
+
+    {// Create some materials and the structured buffer they are read from.
+        CreateMaterials();
+        if (!g_d3dMaterialTable.Create(g_d3dDevice, g_MaterialTable.GetCount()))
         {
-            MessageBoxA(nullptr, "Failed to create lights cbuffer.", "Error", MB_OK | MB_ICONERROR);
+            MessageBoxA(nullptr, "Failed to create material table buffer.", "Error", MB_OK | MB_ICONERROR);
             return false;
         }
     }
 
-    { // Create constant buffer for materials 
-        D3D11_BUFFER_DESC constantBufferDesc;
-        ZeroMemory(&constantBufferDesc, sizeof(D3D11_BUFFER_DESC));
+    {// Set the lights and create the buffers the cluster lists are read from.
+        CreateLights();
+        if (!g_d3dClusterLights.Create(g_d3dDevice, sizeof(Light), static_cast<UINT>(g_Lights.size())) ||
+            !g_d3dClusterRanges.Create(g_d3dDevice, sizeof(ClusterLightRange), ClusterCount) ||
+            !g_d3dClusterLightIndices.Create(g_d3dDevice, sizeof(uint32_t), ClusterCount * 8))
+        {
+            MessageBoxA(nullptr, "Failed to create light cluster buffers.", "Error", MB_OK | MB_ICONERROR);
+            return false;
+        }
+    }
 
-        constantBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-        constantBufferDesc.ByteWidth = sizeof(MaterialProperties);
-        constantBufferDesc.CPUAccessFlags = 0;
-        constantBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    {// Create the shadow maps, the buffer their casters are written to and its input layouts.
+        AssignShadowMaps();
+        const UINT viewCount = std::max(g_ShadowViewCount, 1u);
+        if (!g_d3dShadowMaps.Create(g_d3dDevice, g_ShadowSettings.Resolution, viewCount))
+        {
+            MessageBoxA(g_WindowHandle, "Failed to create shadow maps.", "Error", MB_OK | MB_ICONERROR);
+            return false;
+        }
 
-        hr = g_d3dDevice->CreateBuffer(&constantBufferDesc, nullptr, &g_d3dMaterialPropertiesConstantBuffer);
+        D3D11_BUFFER_DESC casterBufferDesc;
+        ZeroMemory(&casterBufferDesc, sizeof(D3D11_BUFFER_DESC));
+
+        casterBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        casterBufferDesc.ByteWidth = sizeof(ShadowInstanceData) * g_ShadowCasterCapacity * viewCount;
+        casterBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        casterBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+
+        hr = g_d3dDevice->CreateBuffer(&casterBufferDesc, nullptr, &g_d3dShadowCasterBuffer);
         if (FAILED(hr))
         {
-            MessageBoxA(nullptr, "Failed to create lights cbuffer.", "Error", MB_OK | MB_ICONERROR);
+            MessageBoxA(g_WindowHandle, "Failed to create shadow caster buffer.", "Error", MB_OK | MB_ICONERROR);
             return false;
         }
+
+        // Positions only, from either vertex format, followed by the
+        // ShadowInstanceData columns.
+        const D3D11_INPUT_ELEMENT_DESC casterLayoutDesc[3] =
+        {
+            { "WORLDCOLUMN", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "WORLDCOLUMN", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "WORLDCOLUMN", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        };
+        D3D11_INPUT_ELEMENT_DESC shadowLayoutDesc[4] =
+        {
+            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(VertexPosNormColTex, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        };
+        std::copy(std::begin(casterLayoutDesc), std::end(casterLayoutDesc), shadowLayoutDesc + 1);
+        D3D11_INPUT_ELEMENT_DESC packedShadowLayoutDesc[PackedVertexElementCount + 3];
+        GetPackedVertexElements(g_CubePositionEncoding, packedShadowLayoutDesc);
+        std::copy(std::begin(casterLayoutDesc), std::end(casterLayoutDesc), packedShadowLayoutDesc + PackedVertexElementCount);
+
+        struct ShadowShader
+        {
+            const char* Name;
+            const D3D11_INPUT_ELEMENT_DESC* Elements;
+            UINT ElementCount;
+            ID3D11InputLayout** InputLayout;
+        };
+
+        const ShadowShader shadowShaders[2] =
+        {
+            { "ShadowVertexShader", shadowLayoutDesc, _countof(shadowLayoutDesc), &g_d3dShadowInputLayout },
+            { "PackedShadowVertexShader", packedShadowLayoutDesc, _countof(packedShadowLayoutDesc), &g_d3dPackedShadowInputLayout },
+        };
+
+        for (const ShadowShader& shadowShader : shadowShaders)
+        {
+            const uint32_t vertexShader = g_ShaderArchive.Find(shadowShader.Name, "vs_5_0");
+            if (vertexShader == InvalidShaderEntry)
+            {
+                MessageBoxA(g_WindowHandle, "Failed to find a shadow vertex shader in the shader archive.", "Error", MB_OK | MB_ICONERROR);
+                return false;
+            }
+
+            hr = g_d3dDevice->CreateInputLayout(shadowShader.Elements, shadowShader.ElementCount, g_ShaderArchive.GetBytecode(vertexShader),
+                g_ShaderArchive.GetBytecodeSize(vertexShader), shadowShader.InputLayout);
+            if (FAILED(hr))
+            {
+                MessageBoxA(g_WindowHandle, "Failed to create shadow input layout.", "Error", MB_OK | MB_ICONERROR);
+                return false;
+            }
+        }
     }
+
+    {// Register everything the render queue draws with.
+        g_RenderContext = new D3D11RenderContext(g_d3dDeviceContext1, &g_ShaderCache);
+        g_RenderContext->RegisterInputLayout(IL_Simple, g_d3dInputLayout);
+        g_RenderContext->RegisterInputLayout(IL_Instanced, g_d3dInstancedInputLayout);
+        g_RenderContext->RegisterInputLayout(IL_Packed, g_d3dPackedInputLayout);
+        g_RenderContext->RegisterInputLayout(IL_PackedInstanced, g_d3dPackedInstancedInputLayout);
+        g_RenderContext->RegisterInputLayout(IL_Shadow, g_d3dShadowInputLayout);
+        g_RenderContext->RegisterInputLayout(IL_PackedShadow, g_d3dPackedShadowInputLayout);
+        for (const ArchivedShader& shader : g_ArchivedShaders)
+        {
+            const uint32_t entry = g_ShaderArchive.Find(shader.Name, shader.Profile);
+            if (entry == InvalidShaderEntry)
+            {
+                MessageBoxA(g_WindowHandle, "Failed to find a shader in the shader archive.", "Error", MB_OK | MB_ICONERROR);
+                return false;
+            }
+            if (shader.Profile[0] == 'v')
+            {
+                g_RenderContext->RegisterVertexShader(shader.Id, entry);
+            }
+            else
+            {
+                g_RenderContext->RegisterPixelShader(shader.Id, entry);
+            }
+        }
+        g_RenderContext->RegisterVertexBuffer(VB_Cube, g_d3dSimpleVertexBuffer, sizeof(VertexPosNormColTex));
+        g_RenderContext->RegisterVertexBuffer(VB_CubePacked, g_d3dPackedVertexBuffer, sizeof(VertexPacked));
+        g_RenderContext->RegisterVertexBuffer(VB_Plane, g_d3dInstancedVertexBuffer_Vertices, sizeof(VertexPosNormColTex));
+        g_RenderContext->RegisterVertexBuffer(VB_PlaneInstances, g_d3dInstancedVertexBuffer_Instances, sizeof(PlaneInstanceData));
+        g_RenderContext->RegisterVertexBuffer(VB_CubeFieldInstances, g_d3dCubeFieldInstanceBuffer, sizeof(PlaneInstanceData));
+        g_RenderContext->RegisterVertexBuffer(VB_Light, g_d3dLightVertexBuffer, sizeof(VertexPosNormColTex));
+        g_RenderContext->RegisterVertexBuffer(VB_ShadowCasters, g_d3dShadowCasterBuffer, sizeof(ShadowInstanceData));
+        g_RenderContext->RegisterIndexBuffer(IB_Cube, g_d3dSimpleIndexBuffer, g_CubeIndexFormat);
+        g_RenderContext->RegisterIndexBuffer(IB_Plane, g_d3dInstancedIndexBuffer, DXGI_FORMAT_R16_UINT);
+        g_RenderContext->RegisterIndexBuffer(IB_Light, g_d3dLightIndexBuffer, DXGI_FORMAT_R16_UINT);
+        g_RenderContext->SetConstantBuffer(g_ConstantBufferRing.GetBuffer());
+    }
+
+    if (g_UseDeferredContexts)
+    {// One deferred context and command list per worker.
+        const unsigned int workerCount = GetDefaultThreadCount();
+        if (!g_DeferredContexts.Create(g_d3dDevice, workerCount))
+        {
+            MessageBoxA(g_WindowHandle, "Failed to create deferred contexts.", "Error", MB_OK | MB_ICONERROR);
+            return false;
+        }
+        g_CommandLists.resize(workerCount);
+    }
+
+    BuildFrameGraph();
     return true;
 }
 
 void Update(float deltaTime)
 {
+    PROFILE_FUNCTION();
     const float speed = 4.0f;
 
     XMVECTOR cameraTranslation = XMVectorSet(0, 0, 0, 0);
@@ -1125,25 +1203,39 @@ void Update(float deltaTime)
     // Generate a vector.
 #endif
 
-    // Need to share the eye position in order to calculate specular.
-    g_LightProperties.EyePosition = g_Camera.GetForwardDirectionFloat();
-    g_ViewMatrix = g_Camera.GetViewMatrix();
-
-    const XMMATRIX viewProjectionMatrix = g_ViewMatrix * g_ProjectionMatrix;
-    g_PerFrameTransformData.ViewProjectionMatrix = viewProjectionMatrix;
-
     static float angle = 0.0f;
     if (GetKeyState('Z') & 0x8000)
     {
         angle += 90.0f * (deltaTime / 2.0f);
     }
-    XMVECTOR rotationAxis = XMVectorSet(0, 1, 1, 0);
-    const XMMATRIX rotationMatrix = XMMatrixRotationAxis(rotationAxis, XMConvertToRadians(angle));
-    const XMMATRIX translation = XMMatrixTranslation(0, 10.f, 0);
+    StepScene(deltaTime, angle);
 
-    g_PerObjTransformData.WorldMatrix = rotationMatrix * translation;
-    g_PerObjTransformData.WorldViewProjectMatrix = g_PerObjTransformData.WorldMatrix * viewProjectionMatrix;
-    g_PerObjTransformData.InverseTransposeWorldMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, g_PerObjTransformData.WorldMatrix));
+    // The scene tree is as the last rendered frame left it.
+    if (g_PickRequested)
+    {
+        g_PickRequested = false;
+        g_PickedEntity = PickEntity(g_PickX, g_PickY);
+        char message[128];
+        sprintf_s(message, "Picked entity %d at (%d, %d)\n", g_PickedEntity == InvalidEntity ? -1 : static_cast<int>(g_PickedEntity), g_PickX, g_PickY);
+        OutputDebugStringA(message);
+    }
+}
+
+// Build the view matrix and the frustum for a point between the previous and
+// the current camera; 1 renders the current state.
+void PrepareCamera(float interpolation)
+{
+    g_RenderCamera = Camera::Interpolate(g_PreviousCamera, g_Camera, interpolation);
+    if (g_EnableCameraJitter)
+    {
+        g_RenderCamera.SetJitter(GetJitterOffset(g_FrameNumber), g_Viewport.Width, g_Viewport.Height);
+    }
+
+    // Need to share the eye position in order to calculate specular.
+    g_LightProperties.EyePosition = g_RenderCamera.GetForwardDirectionFloat();
+    g_ViewMatrix = g_RenderCamera.GetViewMatrix();
+    g_PerFrameTransformData.ViewProjectionMatrix = g_RenderCamera.GetViewProjectionMatrix();
+    g_Frustum = g_RenderCamera.GetFrustum();
 }
 
 // Clear the color and depth buffers.
@@ -1155,6 +1247,7 @@ void Clear(const FLOAT clearColor[4], FLOAT clearDepth, UINT8 clearStencil)
 
 void Present(bool vSync)
 {
+    PROFILE_FUNCTION();
     if (vSync)
     {
         g_d3dSwapChain->Present(1, 0);
@@ -1165,108 +1258,529 @@ void Present(bool vSync)
     }
 }
 
-void Render()
+// Queue the frame's draws. Instance buffers are filled here, per-object
+// constants go to g_ObjectConstants.
+void SubmitDraws(RenderQueue& queue, UINT visiblePlaneInstanceCount)
 {
-    assert(g_d3dDevice);
-    assert(g_d3dDeviceContext);
+    const float farPlane = 100.0f;
+    const XMVECTOR eyePosition = g_RenderCamera.GetPositionVector();
+
+    auto viewDepth = [&](FXMVECTOR position)
+    {
+        return XMVectorGetX(XMVector3Length(XMVectorSubtract(position, eyePosition)));
+    };
 
-    Clear(Colors::CornflowerBlue, 1.0f, 0);
+    DrawPacket packet;
 
-    {// Set common render states used in all draw calls.
-        g_d3dDeviceContext->OMSetRenderTargets(1, &g_d3dRenderTargetView, g_d3dDepthStencilView);
-        g_d3dDeviceContext->OMSetDepthStencilState(g_d3dDepthStencilState, 0);
-        g_d3dDeviceContext->RSSetState(g_d3dRasterizerState);
-        g_d3dDeviceContext->RSSetViewports(1, &g_Viewport);
-        g_d3dDeviceContext->PSSetShader(g_d3dPixelShader, nullptr, 0);
-        g_d3dDeviceContext->UpdateSubresource(g_d3dLightPropertiesConstantBuffer, 0, nullptr, &g_LightProperties, 0, 0);
-        g_d3dDeviceContext->PSSetConstantBuffers(1, 1, &g_d3dLightPropertiesConstantBuffer);
-		g_d3dDeviceContext->PSSetSamplers(0, 1, &g_d3dSamplerState);
-		g_d3dDeviceContext->PSSetShaderResources(0, 1, &g_textureShaderResourceView);
-		g_d3dDeviceContext->UpdateSubresource(g_d3dConstantBuffers[CB_Frame], 0, nullptr, &g_PerFrameTransformData, 0, 0);
-        g_d3dDeviceContext->UpdateSubresource(g_d3dConstantBuffers[CB_Object], 0, nullptr, &g_PerObjTransformData, 0, 0);
+    { // Instanced walls.
+        if (visiblePlaneInstanceCount > 0)
+        {
+            packet.VertexShader = VS_Instanced;
+            packet.PixelShader = PX_Instanced;
+            packet.InputLayout = IL_Instanced;
+            packet.VertexBuffer = VB_Plane;
+            packet.InstanceBuffer = VB_PlaneInstances;
+            packet.IndexBuffer = IB_Plane;
+            packet.Material = NoMaterial;
+            packet.ObjectConstants = NoObjectConstants;
+            packet.IndexCount = g_NumPlaneIndices;
+            packet.StartIndex = 0;
+            packet.BaseVertex = 0;
+            packet.InstanceCount = visiblePlaneInstanceCount;
+            packet.StartInstance = 0;
+            // The room surrounds the camera, draw it last among opaque geometry.
+            packet.SortKey = MakeSortKey(RP_Opaque, packet.VertexShader, packet.PixelShader, packet.InputLayout, packet.Material,
+                QuantizeDepth(RP_Opaque, farPlane, farPlane));
+            queue.Submit(packet);
+        }
     }
 
-    { // Instanced render walls.
-        const UINT vertexStride[2] = { sizeof(VertexPosNormColTex), sizeof(PlaneInstanceData) };
-        const UINT offset[2] = { 0, 0 };
-        ID3D11Buffer* buffers[2] = { g_d3dInstancedVertexBuffer_Vertices, g_d3dInstancedVertexBuffer_Instances };
+    { // Instanced cube field, every material in one packet.
+        if (g_VisibleCubeFieldInstanceCount > 0)
+        {
+            packet.VertexShader = g_UsePackedVertices ? VS_PackedInstanced : VS_Instanced;
+            packet.PixelShader = PX_Instanced;
+            packet.InputLayout = g_UsePackedVertices ? IL_PackedInstanced : IL_Instanced;
+            packet.VertexBuffer = g_UsePackedVertices ? VB_CubePacked : VB_Cube;
+            packet.InstanceBuffer = VB_CubeFieldInstances;
+            packet.IndexBuffer = IB_Cube;
+            packet.Material = NoMaterial;
+            packet.ObjectConstants = NoObjectConstants;
+            packet.IndexCount = g_CubeIndexCount;
+            packet.StartIndex = 0;
+            packet.BaseVertex = 0;
+            packet.InstanceCount = g_VisibleCubeFieldInstanceCount;
+            packet.StartInstance = 0;
+            packet.SortKey = MakeSortKey(RP_Opaque, packet.VertexShader, packet.PixelShader, packet.InputLayout, packet.Material, 0);
+            queue.Submit(packet);
+        }
+    }
 
-        g_d3dDeviceContext->IASetVertexBuffers(0, 2, buffers, vertexStride, offset);
-        g_d3dDeviceContext->IASetInputLayout(g_d3dInstancedInputLayout);
-        g_d3dDeviceContext->IASetIndexBuffer(g_d3dInstancedIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-        g_d3dDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    { // Spinning cube and light gizmo.
+        const Entity entities[2] = { g_SpinningCube, g_LightCube };
+        const uint8_t pixelShaders[2] = { PX_Simple, PX_Unlit };
 
-        g_d3dDeviceContext->VSSetShader(g_d3dInstancedVertexShader, nullptr, 0);
-        g_d3dDeviceContext->VSSetConstantBuffers(0, 1, &g_d3dConstantBuffers[CB_Frame]);
+        SelectLightLod(g_RenderCamera, static_cast<float>(g_WindowHeight));
+        const LodLevel& lightLevel = g_LightLodChain.Levels[g_LightLodLevel];
 
-        g_d3dDeviceContext->UpdateSubresource(g_d3dMaterialPropertiesConstantBuffer, 0, nullptr, &g_MaterialProperties[1], 0, 0);
+        for (int i = 0; i < 2; ++i)
+        {
+            packet.VertexShader = g_UsePackedVertices ? VS_Packed : VS_Simple;
+            packet.PixelShader = pixelShaders[i];
+            packet.InputLayout = g_UsePackedVertices ? IL_Packed : IL_Simple;
+            packet.VertexBuffer = g_UsePackedVertices ? VB_CubePacked : VB_Cube;
+            packet.InstanceBuffer = NoResource;
+            packet.IndexBuffer = IB_Cube;
+            packet.Material = static_cast<uint16_t>(g_Scene.GetMaterialIndex(entities[i]));
+            packet.ObjectConstants = static_cast<uint32_t>(g_ObjectConstants.size());
+            packet.IndexCount = g_CubeIndexCount;
+            packet.StartIndex = 0;
+            packet.BaseVertex = 0;
+            packet.InstanceCount = 1;
+            packet.StartInstance = 0;
+            if (entities[i] == g_LightCube)
+            {
+                packet.VertexShader = VS_Simple;
+                packet.InputLayout = IL_Simple;
+                packet.VertexBuffer = VB_Light;
+                packet.IndexBuffer = IB_Light;
+                packet.IndexCount = lightLevel.IndexCount;
+                packet.StartIndex = lightLevel.StartIndex;
+                packet.BaseVertex = lightLevel.BaseVertex;
+            }
 
-        g_d3dDeviceContext->PSSetConstantBuffers(0, 1, &g_d3dMaterialPropertiesConstantBuffer);
+            const PerObjectTransformData perObjectTransformData = GetPerObjectTransformData(entities[i], g_PerFrameTransformData.ViewProjectionMatrix);
+            g_ObjectConstants.push_back(perObjectTransformData);
 
-        g_d3dDeviceContext->DrawIndexedInstanced(_countof(g_PlaneIndex), 6, 0, 0, 0);
+            packet.SortKey = MakeSortKey(RP_Opaque, packet.VertexShader, packet.PixelShader, packet.InputLayout, packet.Material,
+                QuantizeDepth(RP_Opaque, viewDepth(perObjectTransformData.WorldMatrix.r[3]), farPlane));
+            queue.Submit(packet);
+        }
     }
+}
 
-    { // Render Cubes
-        { // Spinning Cube
-            const UINT vertexStride = sizeof(VertexPosNormColTex);
-            const UINT offset = 0;
+// Declare the CPU stages of a frame. A stage waits only for the stages that
+// write what it reads, so culling and light binning overlap the transforms.
+void BuildFrameGraph()
+{
+    const TaskGraph::ResourceId camera = g_FrameGraph.AddResource("Camera");
+    const TaskGraph::ResourceId transforms = g_FrameGraph.AddResource("Transforms");
+    const TaskGraph::ResourceId wallInstances = g_FrameGraph.AddResource("Wall instances");
+    const TaskGraph::ResourceId cubeFieldInstances = g_FrameGraph.AddResource("Cube field instances");
+    const TaskGraph::ResourceId lightClusters = g_FrameGraph.AddResource("Light clusters");
+    const TaskGraph::ResourceId drawQueue = g_FrameGraph.AddResource("Draw queue");
+    const TaskGraph::ResourceId occlusionBuffer = g_FrameGraph.AddResource("Occlusion buffer");
+    const TaskGraph::ResourceId sceneTree = g_FrameGraph.AddResource("Scene tree");
+    const TaskGraph::ResourceId shadowViews = g_FrameGraph.AddResource("Shadow views");
+
+    g_FrameGraph.AddTask("Camera", []()
+    {
+        PrepareCamera(g_FrameInterpolation);
+    }, {}, { camera });
 
-            g_d3dDeviceContext->IASetVertexBuffers(0, 1, &g_d3dSimpleVertexBuffer, &vertexStride, &offset);
-            g_d3dDeviceContext->IASetInputLayout(g_d3dInputLayout);
-            g_d3dDeviceContext->IASetIndexBuffer(g_d3dSimpleIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-            g_d3dDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    g_FrameGraph.AddTask("Transforms", []()
+    {
+        g_Scene.Interpolate(g_FrameInterpolation);
+    }, {}, { transforms });
 
-            g_d3dDeviceContext->VSSetShader(g_d3dVertexShader, nullptr, 0);
-            g_d3dDeviceContext->VSSetConstantBuffers(0, 1, &g_d3dConstantBuffers[CB_Object]);
+    g_FrameGraph.AddTask("Update scene tree", []()
+    {
+        UpdateSceneTree();
+    }, { transforms }, { sceneTree });
 
-            g_d3dDeviceContext->UpdateSubresource(g_d3dMaterialPropertiesConstantBuffer, 0, nullptr, &g_MaterialProperties[2], 0, 0);
+    g_FrameGraph.AddTask("Cull walls", []()
+    {
+        g_VisiblePlaneInstanceCount = 0;
+        if (g_MappedPlaneInstances)
+        {
+            g_VisiblePlaneInstanceCount = static_cast<UINT>(CullInstances(g_Frustum, g_PlaneInstanceBounds, CV_Box,
+                g_PlaneInstanceData, g_MappedPlaneInstances));
+        }
+    }, { camera }, { wallInstances });
 
-            g_d3dDeviceContext->PSSetConstantBuffers(0, 1, &g_d3dMaterialPropertiesConstantBuffer);
+    g_FrameGraph.AddTask("Rasterize occluders", []()
+    {
+        g_OcclusionBuffer.Begin(g_RenderCamera.GetViewProjectionMatrix(), g_RenderCamera.GetProjection().NearZ);
+        g_OcclusionBuffer.RasterizeOccluders(g_PlaneVerts, g_PlaneIndex, g_NumPlaneIndices, g_PlaneInstanceData, g_NumPlaneInstances);
+        g_OcclusionBuffer.BuildHierarchy();
+    }, { camera }, { occlusionBuffer });
 
-            g_d3dDeviceContext->DrawIndexed(g_IndicesLength, 0, 0);
+    g_FrameGraph.AddTask("Write cube field", []()
+    {
+        g_VisibleCubeFieldInstanceCount = 0;
+        if (g_MappedCubeFieldInstances && g_EnableOcclusionCulling)
+        {
+            g_VisibleCubeFieldInstanceCount = WriteVisibleCubeFieldInstances(g_MappedCubeFieldInstances, g_Frustum, g_OcclusionBuffer);
         }
+        else if (g_MappedCubeFieldInstances)
+        {
+            WriteCubeFieldInstances(g_MappedCubeFieldInstances);
+            g_VisibleCubeFieldInstanceCount = static_cast<UINT>(g_CubeField.size());
+        }
+    }, { camera, transforms, sceneTree, occlusionBuffer }, { cubeFieldInstances });
 
-        { // Light Cube
+    g_FrameGraph.AddTask("Fit shadow maps", []()
+    {
+        FitShadowMaps(g_RenderCamera);
+    }, { camera, sceneTree }, { shadowViews });
 
-            const XMMATRIX worldMatrix = XMMatrixScaling(0.2f, 0.2f, 0.2f) * XMMatrixTranslation(
-                g_LightProperties.Lights[0].Position.x,
-                g_LightProperties.Lights[0].Position.y,
-                g_LightProperties.Lights[0].Position.z);
+    // Each shadow map culls its casters into its own range of the buffer,
+    // independently of the others.
+    for (uint32_t view = 0; view < g_ShadowViewCount; ++view)
+    {
+        const TaskGraph::ResourceId shadowCasters = g_FrameGraph.AddResource("Shadow casters");
+        g_FrameGraph.AddTask("Cull shadow casters", [view]()
+        {
+            g_ShadowCasterCounts[view] = 0;
+            if (g_MappedShadowCasters)
+            {
+                g_ShadowCasterCounts[view] = WriteShadowCasters(view, g_MappedShadowCasters + view * g_ShadowCasterCapacity);
+            }
+        }, { shadowViews, transforms, sceneTree }, { shadowCasters });
+    }
+
+    g_FrameGraph.AddTask("Light binning", []()
+    {
+        g_LightClusters.AssignLights(g_ViewMatrix, g_Lights.data(), g_Lights.size());
+    }, { camera }, { lightClusters });
 
-            g_PerObjTransformData.WorldViewProjectMatrix = worldMatrix * g_ViewMatrix * g_ProjectionMatrix;
-            g_d3dDeviceContext->UpdateSubresource(g_d3dConstantBuffers[CB_Object], 0, nullptr, &g_PerObjTransformData, 0, 0);
+    g_FrameGraph.AddTask("Collect draws", []()
+    {
+        g_ObjectConstants.clear();
+        g_RenderQueue.Clear();
+        SubmitDraws(g_RenderQueue, g_VisiblePlaneInstanceCount);
+        g_RenderQueue.Sort();
+    }, { camera, transforms, wallInstances, cubeFieldInstances }, { drawQueue });
 
-            g_d3dDeviceContext->PSSetShader(g_d3dUnlitPixelShader, nullptr, 0);
+    g_FrameGraph.Compile();
+}
 
+// Bind the state every draw of a frame shares: output, rasterizer, samplers,
+// the container texture and the shadow maps.
+void BindCommonState(ID3D11DeviceContext* deviceContext)
+{
+    deviceContext->OMSetRenderTargets(1, &g_d3dRenderTargetView, g_d3dDepthStencilView);
+    deviceContext->OMSetDepthStencilState(g_d3dDepthStencilState, 0);
+    deviceContext->RSSetState(g_d3dRasterizerState);
+    deviceContext->RSSetViewports(1, &g_Viewport);
+    deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    deviceContext->PSSetSamplers(0, 1, &g_d3dSamplerState);
+    ID3D11ShaderResourceView* texture = g_TextureUploadSink.GetShaderResourceView(g_ContainerTexture);
+    deviceContext->PSSetShaderResources(0, 1, &texture);
+    ID3D11SamplerState* shadowSampler = g_d3dShadowMaps.GetSampler();
+    deviceContext->PSSetSamplers(1, 1, &shadowSampler);
+    ID3D11ShaderResourceView* shadowMaps = g_d3dShadowMaps.GetShaderResourceView();
+    deviceContext->PSSetShaderResources(5, 1, &shadowMaps);
+}
 
-            g_d3dDeviceContext->DrawIndexed(g_IndicesLength, 0, 0);
+// Bind everything Render binds on the immediate context before its draws, on
+// a deferred context that starts from the default state.
+void BindFrameState(ID3D11DeviceContext1* deviceContext)
+{
+    BindCommonState(deviceContext);
+
+    ID3D11ShaderResourceView* views[4] =
+    {
+        g_d3dMaterialTable.GetShaderResourceView(),
+        g_d3dClusterLights.GetShaderResourceView(),
+        g_d3dClusterRanges.GetShaderResourceView(),
+        g_d3dClusterLightIndices.GetShaderResourceView(),
+    };
+    deviceContext->PSSetShaderResources(1, 4, views);
+
+    ID3D11Buffer* constantBuffer = g_ConstantBufferRing.GetBuffer();
+    deviceContext->PSSetConstantBuffers1(1, 1, &constantBuffer, &g_LightSlice.FirstConstant, &g_LightSlice.NumConstants);
+    deviceContext->PSSetConstantBuffers1(2, 1, &constantBuffer, &g_ClusterSlice.FirstConstant, &g_ClusterSlice.NumConstants);
+    deviceContext->PSSetConstantBuffers1(3, 1, &constantBuffer, &g_ShadowSlice.FirstConstant, &g_ShadowSlice.NumConstants);
+    deviceContext->VSSetConstantBuffers1(1, 1, &constantBuffer, &g_QuantizationSlice.FirstConstant, &g_QuantizationSlice.NumConstants);
+}
+
+void Render()
+{
+    PROFILE_FUNCTION();
+    assert(g_d3dDevice);
+    assert(g_d3dDeviceContext);
+
+    g_ConstantBufferRing.BeginFrame();
+    g_GpuProfiler.BeginFrame();
+
+    {// Stream in textures. The container texture is on every cube and wall.
+        PROFILE_SCOPE("Texture streaming");
+        g_TextureStreamer->MarkUsed(g_ContainerTexture);
+        g_TextureStreamer->Update(++g_FrameNumber);
+    }
+
+    {// Clear the back buffer and the depth buffer.
+        GPU_PROFILE_SCOPE(&g_GpuProfiler, "Clear");
+        Clear(Colors::CornflowerBlue, (g_DepthMode == DM_ReversedInfinite) ? 0.0f : 1.0f, 0);
+    }
+
+    {// Set common render states used in all draw calls.
+        BindCommonState(g_d3dDeviceContext);
+    }
+
+    {// Run the frame graph with the instance buffers mapped for its stages to fill.
+        PROFILE_SCOPE("Frame graph");
+        D3D11_MAPPED_SUBRESOURCE mappedPlaneInstances;
+        D3D11_MAPPED_SUBRESOURCE mappedCubeFieldInstances;
+        D3D11_MAPPED_SUBRESOURCE mappedShadowCasters;
+        const bool planeInstancesMapped = SUCCEEDED(g_d3dDeviceContext->Map(g_d3dInstancedVertexBuffer_Instances, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedPlaneInstances));
+        const bool cubeFieldInstancesMapped = SUCCEEDED(g_d3dDeviceContext->Map(g_d3dCubeFieldInstanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedCubeFieldInstances));
+        const bool shadowCastersMapped = SUCCEEDED(g_d3dDeviceContext->Map(g_d3dShadowCasterBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedShadowCasters));
+        g_MappedPlaneInstances = planeInstancesMapped ? static_cast<PlaneInstanceData*>(mappedPlaneInstances.pData) : nullptr;
+        g_MappedCubeFieldInstances = cubeFieldInstancesMapped ? static_cast<PlaneInstanceData*>(mappedCubeFieldInstances.pData) : nullptr;
+        g_MappedShadowCasters = shadowCastersMapped ? static_cast<ShadowInstanceData*>(mappedShadowCasters.pData) : nullptr;
+
+        g_FrameGraph.Run(JobSystem::GetDefault());
+
+        if (planeInstancesMapped)
+        {
+            g_d3dDeviceContext->Unmap(g_d3dInstancedVertexBuffer_Instances, 0);
         }
+        if (cubeFieldInstancesMapped)
+        {
+            g_d3dDeviceContext->Unmap(g_d3dCubeFieldInstanceBuffer, 0);
+        }
+        if (shadowCastersMapped)
+        {
+            g_d3dDeviceContext->Unmap(g_d3dShadowCasterBuffer, 0);
+        }
+        g_MappedPlaneInstances = nullptr;
+        g_MappedCubeFieldInstances = nullptr;
+        g_MappedShadowCasters = nullptr;
     }
 
+    {// Upload the materials edited since the last frame and bind the table.
+        PROFILE_SCOPE("Material upload");
+        GPU_PROFILE_SCOPE(&g_GpuProfiler, "Material upload");
+        if (g_d3dMaterialTable.Update(g_d3dDeviceContext, g_MaterialTable))
+        {
+            ID3D11ShaderResourceView* materialTable = g_d3dMaterialTable.GetShaderResourceView();
+            g_d3dDeviceContext->PSSetShaderResources(1, 1, &materialTable);
+        }
+    }
+
+    {// Upload the light lists the frame graph binned.
+        PROFILE_SCOPE("Light clusters");
+        GPU_PROFILE_SCOPE(&g_GpuProfiler, "Light cluster upload");
+        const std::vector<ClusterLightRange>& clusterRanges = g_LightClusters.GetClusterRanges();
+        const std::vector<uint32_t>& lightIndices = g_LightClusters.GetLightIndices();
+        if (g_d3dClusterLights.Update(g_d3dDeviceContext, g_Lights.data(), static_cast<UINT>(g_Lights.size())) &&
+            g_d3dClusterRanges.Update(g_d3dDeviceContext, clusterRanges.data(), static_cast<UINT>(clusterRanges.size())) &&
+            g_d3dClusterLightIndices.Update(g_d3dDeviceContext, lightIndices.data(), static_cast<UINT>(lightIndices.size())))
+        {
+            ID3D11ShaderResourceView* clusterViews[3] =
+            {
+                g_d3dClusterLights.GetShaderResourceView(),
+                g_d3dClusterRanges.GetShaderResourceView(),
+                g_d3dClusterLightIndices.GetShaderResourceView(),
+            };
+            g_d3dDeviceContext->PSSetShaderResources(2, 3, clusterViews);
+        }
+    }
+
+    bool constantsWritten = false;
+    ConstantBufferSlice frameSlice = {};
+    {// Write this frame's constants into the ring.
+        PROFILE_SCOPE("Constants");
+        g_ObjectConstantSlices.resize(g_ObjectConstants.size());
+        g_MaterialSlices.resize(g_MaterialTable.GetCount());
+
+        if (g_ConstantBufferRing.Map())
+        {
+            constantsWritten =
+                g_ConstantBufferRing.Allocate(&g_PerFrameTransformData, sizeof(PerFrameConstantBufferData), frameSlice) &&
+                g_ConstantBufferRing.Allocate(&g_LightProperties, sizeof(LightProperties), g_LightSlice) &&
+                g_ConstantBufferRing.Allocate(&g_LightClusters.GetConstants(), sizeof(ClusterConstants), g_ClusterSlice) &&
+                g_ConstantBufferRing.Allocate(&g_CubeQuantization, sizeof(VertexQuantization), g_QuantizationSlice) &&
+                g_ConstantBufferRing.Allocate(&g_ShadowConstants, sizeof(ShadowConstants), g_ShadowSlice);
+            for (uint32_t i = 0; constantsWritten && i < g_ShadowViewCount; ++i)
+            {
+                // The view-projection is where PerFrameConstantBufferData expects it.
+                constantsWritten = g_ConstantBufferRing.Allocate(&g_ShadowViews[i].ViewProjection, sizeof(PerFrameConstantBufferData), g_ShadowViewSlices[i]);
+            }
+            for (size_t i = 0; constantsWritten && i < g_ObjectConstants.size(); ++i)
+            {
+                constantsWritten = g_ConstantBufferRing.Allocate(&g_ObjectConstants[i], sizeof(PerObjectTransformData), g_ObjectConstantSlices[i]);
+            }
+            for (uint32_t i = 0; constantsWritten && i < g_MaterialTable.GetCount(); ++i)
+            {
+                constantsWritten = g_ConstantBufferRing.Allocate(&g_MaterialTable.Get(i), sizeof(MaterialProperties), g_MaterialSlices[i]);
+            }
+            g_ConstantBufferRing.Unmap();
+        }
+
+        ID3D11Buffer* constantBuffer = g_ConstantBufferRing.GetBuffer();
+        g_d3dDeviceContext1->PSSetConstantBuffers1(1, 1, &constantBuffer, &g_LightSlice.FirstConstant, &g_LightSlice.NumConstants);
+        g_d3dDeviceContext1->PSSetConstantBuffers1(2, 1, &constantBuffer, &g_ClusterSlice.FirstConstant, &g_ClusterSlice.NumConstants);
+        g_d3dDeviceContext1->PSSetConstantBuffers1(3, 1, &constantBuffer, &g_ShadowSlice.FirstConstant, &g_ShadowSlice.NumConstants);
+        // The cube is the only packed mesh, so its quantization stays bound for the frame.
+        g_d3dDeviceContext1->VSSetConstantBuffers1(1, 1, &constantBuffer, &g_QuantizationSlice.FirstConstant, &g_QuantizationSlice.NumConstants);
+        g_RenderContext->SetFrameConstants(frameSlice);
+        g_RenderContext->SetObjectConstantSlices(g_ObjectConstantSlices.data());
+        g_RenderContext->SetMaterialSlices(g_MaterialSlices.data());
+    }
+
+    if (constantsWritten)
+    {// Draw each shadow map's casters, then return to the back buffer with the maps bound.
+        PROFILE_SCOPE("Shadow maps");
+        GPU_PROFILE_SCOPE(&g_GpuProfiler, "Shadow maps");
+        ID3D11ShaderResourceView* noShadowMaps = nullptr;
+        g_d3dDeviceContext->PSSetShaderResources(5, 1, &noShadowMaps);
+
+        DrawPacket packet;
+        packet.SortKey = 0;
+        packet.VertexShader = g_UsePackedVertices ? VS_PackedShadow : VS_Shadow;
+        packet.PixelShader = NoResource;
+        packet.InputLayout = g_UsePackedVertices ? IL_PackedShadow : IL_Shadow;
+        packet.VertexBuffer = g_UsePackedVertices ? VB_CubePacked : VB_Cube;
+        packet.InstanceBuffer = VB_ShadowCasters;
+        packet.IndexBuffer = IB_Cube;
+        packet.Material = NoMaterial;
+        packet.ObjectConstants = NoObjectConstants;
+        packet.IndexCount = g_CubeIndexCount;
+        packet.StartIndex = 0;
+        packet.BaseVertex = 0;
+
+        for (uint32_t view = 0; view < g_ShadowViewCount; ++view)
+        {
+            g_d3dShadowMaps.BeginSlice(g_d3dDeviceContext, view);
+            if (g_ShadowCasterCounts[view] == 0)
+            {
+                continue;
+            }
+            // Only the per-frame constants change between maps, which the
+            // state cache cannot see.
+            g_RenderContext->SetFrameConstants(g_ShadowViewSlices[view]);
+            g_RenderStateCache.Invalidate();
+            packet.InstanceCount = g_ShadowCasterCounts[view];
+            packet.StartInstance = view * g_ShadowCasterCapacity;
+            g_RenderStateCache.Draw(*g_RenderContext, packet);
+        }
+
+        g_RenderContext->SetFrameConstants(frameSlice);
+        BindCommonState(g_d3dDeviceContext);
+    }
+
+    if (constantsWritten && !g_UseDeferredContexts)
+    {// Issue the draws in sorted order, a pass at a time so each pass gets a GPU zone.
+        PROFILE_SCOPE("Draws");
+        static const char* passNames[NumRenderPasses] = { "Opaque", "Transparent" };
+        g_RenderStateCache.Invalidate();
+        for (int pass = 0; pass < NumRenderPasses; ++pass)
+        {
+            GPU_PROFILE_SCOPE(&g_GpuProfiler, passNames[pass]);
+            g_RenderQueue.Execute(*g_RenderContext, g_RenderStateCache, static_cast<RenderPass>(pass));
+        }
+    }
+    else if (constantsWritten)
+    {// Record each pass on the workers, then execute its command lists in order.
+        PROFILE_SCOPE("Draws");
+        static const char* passNames[NumRenderPasses] = { "Opaque", "Transparent" };
+        for (int pass = 0; pass < NumRenderPasses; ++pass)
+        {
+            {
+                PROFILE_SCOPE("Record command lists");
+                RecordCommandLists(g_RenderQueue, static_cast<RenderPass>(pass), g_CommandLists.data(), g_CommandLists.size());
+                g_DeferredContexts.Record(g_CommandLists.data(), g_CommandLists.size(), *g_RenderContext, BindFrameState);
+            }
+            GPU_PROFILE_SCOPE(&g_GpuProfiler, passNames[pass]);
+            g_DeferredContexts.Execute(g_d3dDeviceContext);
+        }
+    }
+
+    g_ConstantBufferRing.EndFrame();
+    g_GpuProfiler.EndFrame();
+
     Present(g_EnableVSync);
 }
 
-void UnloadContent()
+/**
+* Pack the compiled shaders listed in g_ArchivedShaders into the shader
+* archive. Runs in the output directory as the post-build step, after the
+* shaders have been compiled to loose .cso files.
+*/
+int PackShaderArchive()
 {
-    delete[] g_Vertices;
-    delete[] g_Indicies;
+    char message[256];
+    ShaderArchiveBuilder builder;
+    for (const ArchivedShader& shader : g_ArchivedShaders)
+    {
+        std::wstring fileName(shader.Name, shader.Name + strlen(shader.Name));
+#if _DEBUG
+        fileName += L"_d";
+#endif
+        fileName += L".cso";
+
+        ID3DBlob* shaderBlob = nullptr;
+        bool added = SUCCEEDED(D3DReadFileToBlob(fileName.c_str(), &shaderBlob))
+            && builder.Add(shader.Name, shader.Profile, shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize());
+        SafeRelease(shaderBlob);
+        if (!added)
+        {
+            sprintf_s(message, "Failed to add %s to the shader archive.\n", shader.Name);
+            OutputDebugStringA(message);
+            std::cout << message;
+            return -1;
+        }
+    }
+
+    if (!builder.Write(g_ShaderArchiveFileName))
+    {
+        sprintf_s(message, "Failed to write the shader archive.\n");
+        OutputDebugStringA(message);
+        std::cout << message;
+        return -1;
+    }
+    sprintf_s(message, "Packed %zu shaders.\n", builder.GetCount());
+    OutputDebugStringA(message);
+    std::cout << message;
+    return 0;
+}
 
-    SafeRelease(g_d3dConstantBuffers[CB_Frame]);
-    SafeRelease(g_d3dConstantBuffers[CB_Object]);
+void UnloadContent()
+{
+    g_CubeMesh = Mesh();
+    _aligned_free(g_PlaneInstanceData);
+    g_PlaneInstanceData = nullptr;
+    g_Scene = Scene();
+    g_CubeField.clear();
+    g_CubeFieldDraws.clear();
+    g_SceneTree.Clear();
+    g_SceneProxies.clear();
+    g_CubeFieldSlots.clear();
+    delete g_RenderContext;
+    g_RenderContext = nullptr;
+    g_DeferredContexts.Destroy();
+    g_CommandLists.clear();
+
+    g_ConstantBufferRing.Destroy();
+    g_GpuProfiler.Destroy();
     SafeRelease(g_d3dSimpleIndexBuffer);
     SafeRelease(g_d3dSimpleVertexBuffer);
     SafeRelease(g_d3dInputLayout);
-    SafeRelease(g_d3dVertexShader);
     SafeRelease(g_d3dInstancedIndexBuffer);
+    SafeRelease(g_d3dLightIndexBuffer);
+    SafeRelease(g_d3dLightVertexBuffer);
     SafeRelease(g_d3dInstancedVertexBuffer_Instances);
+    SafeRelease(g_d3dCubeFieldInstanceBuffer);
     SafeRelease(g_d3dInstancedVertexBuffer_Vertices);
     SafeRelease(g_d3dInstancedInputLayout);
-    SafeRelease(g_d3dInstancedVertexShader);
-    SafeRelease(g_d3dPixelShader);
-    SafeRelease(g_d3dUnlitPixelShader);
-    SafeRelease(g_textureShaderResourceView);
-    SafeRelease(g_d3dLightPropertiesConstantBuffer);
-    SafeRelease(g_d3dMaterialPropertiesConstantBuffer);
+    SafeRelease(g_d3dPackedVertexBuffer);
+    SafeRelease(g_d3dPackedInputLayout);
+    SafeRelease(g_d3dPackedInstancedInputLayout);
+    SafeRelease(g_d3dShadowCasterBuffer);
+    SafeRelease(g_d3dShadowInputLayout);
+    SafeRelease(g_d3dPackedShadowInputLayout);
+    g_d3dShadowMaps.Destroy();
+    g_d3dMaterialTable.Destroy();
+    g_d3dClusterLights.Destroy();
+    g_d3dClusterRanges.Destroy();
+    g_d3dClusterLightIndices.Destroy();
+    g_TextureStreamer.reset();
+    g_TextureUploadSink.Destroy();
+    g_ShaderCache.Destroy();
+    g_ShaderArchive.Close();
 }
 
 void Cleanup()
@@ -1278,6 +1792,7 @@ void Cleanup()
     SafeRelease(g_d3dRasterizerState);
     SafeRelease(g_d3dSamplerState);
     SafeRelease(g_d3dSwapChain);
+    SafeRelease(g_d3dDeviceContext1);
     SafeRelease(g_d3dDeviceContext);
 
     //ID3D11Debug *d3dDebug = nullptr;
@@ -1302,6 +1817,53 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, LPWSTR cmdLine,
         return -1;
     }
 
+    // Start the job system here so the main thread is its thread 0.
+    JobSystem::GetDefault();
+
+    // The headless checks and benchmarks are in LearningD3D11Tests; these
+    // are the app's own flags.
+    std::vector<std::wstring> arguments;
+    {
+        int argumentCount = 0;
+        LPWSTR* argumentList = CommandLineToArgvW(GetCommandLineW(), &argumentCount);
+        if (argumentList)
+        {
+            arguments.assign(argumentList + 1, argumentList + argumentCount);
+            LocalFree(argumentList);
+        }
+    }
+    auto hasFlag = [&arguments](const wchar_t* flag)
+    {
+        return std::find(arguments.begin(), arguments.end(), flag) != arguments.end();
+    };
+
+    // -cooktextures writes the cooked copies of the source textures.
+    if (hasFlag(L"-cooktextures"))
+    {
+        if (!CookTextureFile(g_TextureDecoder, g_ContainerTextureSource, g_ContainerTextureCooked))
+        {
+            MessageBoxA(nullptr, "Failed to cook the container texture.", "Error", MB_OK | MB_ICONERROR);
+            return -1;
+        }
+        return 0;
+    }
+
+    // -packshaders packs the compiled shaders into the shader archive.
+    if (hasFlag(L"-packshaders"))
+    {
+        return PackShaderArchive();
+    }
+
+    // -deferredcontexts records the draws on worker threads.
+    g_UseDeferredContexts = hasFlag(L"-deferredcontexts");
+
+    // -trace records the first frames of CPU and GPU zones to Trace.json and Trace.ldpc.
+    if (hasFlag(L"-trace"))
+    {
+        Profiler::SetThreadName("Main");
+        Profiler::SetEnabled(true);
+    }
+
     if (InitApplication(hInstance, cmdShow) != 0)
     {
         MessageBox(nullptr, TEXT("Failed to create applicaiton window."), TEXT("Error"), MB_OK);
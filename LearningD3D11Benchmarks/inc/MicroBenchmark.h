@@ -0,0 +1,129 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Small micro-benchmark harness with Google Benchmark's command line flags
+// and JSON output, so runs can be compared with its tools/compare.py.
+//
+//   void BM_Something(BenchmarkState& state)
+//   {
+//       // Setup is not timed.
+//       while (state.KeepRunning())
+//       {
+//           DoNotOptimize(Something());
+//       }
+//   }
+//   BENCHMARK(BM_Something, "Group/Something");
+//
+// Every benchmark is first run with a growing iteration count until a run
+// takes --benchmark_min_time seconds, then --benchmark_repetitions times
+// with that count. Times are wall clock nanoseconds per iteration; the JSON
+// reports every repetition and the mean, median and standard deviation.
+//
+// Flags:
+//   --benchmark_filter=<text>       only benchmarks whose name contains text
+//   --benchmark_min_time=<seconds>  default 0.1
+//   --benchmark_repetitions=<n>     default 5
+//   --benchmark_out=<file>          write the results as JSON
+//   --benchmark_list_tests          print the names and exit
+
+class BenchmarkState
+{
+public:
+    explicit BenchmarkState(uint64_t iterations)
+        : m_Iterations(iterations), m_Remaining(iterations), m_Running(false), m_Elapsed(0), m_ItemsProcessed(0) {}
+
+    bool KeepRunning()
+    {
+        if (m_Remaining == 0)
+        {
+            StopTiming();
+            return false;
+        }
+        if (!m_Running)
+        {
+            StartTiming();
+        }
+        --m_Remaining;
+        return true;
+    }
+
+    // Exclude work inside the loop from the time.
+    void PauseTiming() { StopTiming(); }
+    void ResumeTiming() { StartTiming(); }
+
+    uint64_t GetIterations() const { return m_Iterations; }
+    double GetElapsedSeconds() const { return m_Elapsed; }
+
+    // Items handled over the whole run, reported as items per second.
+    void SetItemsProcessed(uint64_t items) { m_ItemsProcessed = items; }
+    uint64_t GetItemsProcessed() const { return m_ItemsProcessed; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void StartTiming()
+    {
+        m_Running = true;
+        m_Start = Clock::now();
+    }
+
+    void StopTiming()
+    {
+        if (m_Running)
+        {
+            m_Elapsed += std::chrono::duration<double>(Clock::now() - m_Start).count();
+            m_Running = false;
+        }
+    }
+
+    uint64_t m_Iterations;
+    uint64_t m_Remaining;
+    bool m_Running;
+    Clock::time_point m_Start;
+    double m_Elapsed;
+    uint64_t m_ItemsProcessed;
+};
+
+typedef void (*BenchmarkFunction)(BenchmarkState& state);
+
+// Returns true so it can initialize a static.
+bool RegisterBenchmark(const char* name, BenchmarkFunction function);
+
+// Run the registered benchmarks as the flags say. configuration describes
+// the build (e.g. the SIMD instruction set) and goes into the JSON context.
+// Returns 0, or 1 if a flag is malformed or the output cannot be written.
+int RunBenchmarks(int argc, char** argv, const char* configuration);
+
+#define BENCHMARK_CONCATENATE_(a, b) a##b
+#define BENCHMARK_CONCATENATE(a, b) BENCHMARK_CONCATENATE_(a, b)
+#define BENCHMARK(function, name) \
+    static const bool BENCHMARK_CONCATENATE(benchmarkRegistered, __LINE__) = RegisterBenchmark(name, function)
+
+// Keep the compiler from dropping a computation whose result is unused.
+template<typename T>
+inline void DoNotOptimize(const T& value)
+{
+#if defined(_MSC_VER)
+    // Reading through a volatile pointer forces the value to be computed
+    // and stored.
+    static volatile char sink;
+    sink = *reinterpret_cast<const volatile char*>(&value);
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "g"(&value) : "memory");
+#endif
+}
+
+// Make every pending store visible, so writes in the loop are not dropped.
+inline void ClobberMemory()
+{
+#if defined(_MSC_VER)
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : : "memory");
+#endif
+}
@@ -0,0 +1,356 @@
+// Micro-benchmarks for the camera, mesh and transform code the renderer runs
+// on the CPU. Run one configuration per DirectXMath code path and compare the
+// JSON across commits, e.g. with Google Benchmark's tools/compare.py:
+//
+//   LearningD3D11Benchmarks --benchmark_out=SSE2.json
+//   compare.py benchmarks Baseline.json SSE2.json
+//
+// The Visual Studio project has an SSE2, AVX, AVX2 and NoIntrinsics
+// configuration; elsewhere build the LearningD3D11Benchmarks CMake target,
+// with LEARNINGD3D11_SIMD picking the path.
+#include <vector>
+#include "Camera.h"
+#include "FrustumCulling.h"
+#include "MicroBenchmark.h"
+#include "ProceduralMesh.h"
+#include "Transform.h"
+
+namespace
+{
+    // Enough matrices to leave the L1 cache, as many as a busy scene has.
+    const size_t BatchSize = 1024;
+
+    // The DirectXMath code path this build uses.
+    const char* GetConfiguration()
+    {
+#if defined(_XM_NO_INTRINSICS_)
+        return "NoIntrinsics";
+#elif defined(_XM_AVX2_INTRINSICS_)
+        return "AVX2";
+#elif defined(_XM_AVX_INTRINSICS_)
+        return "AVX";
+#elif defined(_XM_SSE_INTRINSICS_)
+        return "SSE2";
+#elif defined(_XM_ARM_NEON_INTRINSICS_)
+        return "NEON";
+#else
+        return "Unknown";
+#endif
+    }
+
+    // The six walls of the room LoadContent builds, each
+    // scale * rotation * translation.
+    void CreateWallMatrices(XMFLOAT4X4A (&worldMatrices)[6])
+    {
+        const float scalePlane = 20.0f;
+        const float translateOffset = scalePlane / 2.0f;
+        const XMMATRIX scaleMatrix = XMMatrixScaling(scalePlane, 1.0f, scalePlane);
+
+        XMStoreFloat4x4A(&worldMatrices[0], scaleMatrix);
+        XMStoreFloat4x4A(&worldMatrices[1], scaleMatrix * XMMatrixRotationX(XMConvertToRadians(-90))
+            * XMMatrixTranslation(0, translateOffset, translateOffset));
+        XMStoreFloat4x4A(&worldMatrices[2], scaleMatrix * XMMatrixRotationX(XMConvertToRadians(180))
+            * XMMatrixTranslation(0, translateOffset * 2.0f, 0));
+        XMStoreFloat4x4A(&worldMatrices[3], scaleMatrix * XMMatrixRotationX(XMConvertToRadians(90))
+            * XMMatrixTranslation(0, translateOffset, -translateOffset));
+        XMStoreFloat4x4A(&worldMatrices[4], scaleMatrix * XMMatrixRotationZ(XMConvertToRadians(-90))
+            * XMMatrixTranslation(-translateOffset, translateOffset, 0));
+        XMStoreFloat4x4A(&worldMatrices[5], scaleMatrix * XMMatrixRotationZ(XMConvertToRadians(90))
+            * XMMatrixTranslation(translateOffset, translateOffset, 0));
+    }
+
+    // Scale, rotation and translation for BatchSize objects like Scene's.
+    void CreateTransforms(std::vector<XMFLOAT3>& scales, std::vector<XMFLOAT4>& rotations, std::vector<XMFLOAT3>& positions)
+    {
+        scales.resize(BatchSize);
+        rotations.resize(BatchSize);
+        positions.resize(BatchSize);
+        for (size_t i = 0; i < BatchSize; ++i)
+        {
+            const float t = static_cast<float>(i);
+            scales[i] = XMFLOAT3(1.0f + (i % 3), 1.0f + (i % 5) * 0.5f, 1.0f + (i % 7) * 0.25f);
+            XMStoreFloat4(&rotations[i], XMQuaternionRotationRollPitchYaw(t * 0.1f, t * 0.2f, t * 0.3f));
+            positions[i] = XMFLOAT3(t * 0.5f, (i % 10) * 1.0f, -t * 0.25f);
+        }
+    }
+
+    void CreateWorldMatrices(std::vector<XMFLOAT4X4A>& worldMatrices, std::vector<TransformClass>& transformClasses)
+    {
+        std::vector<XMFLOAT3> scales;
+        std::vector<XMFLOAT4> rotations;
+        std::vector<XMFLOAT3> positions;
+        CreateTransforms(scales, rotations, positions);
+
+        worldMatrices.resize(BatchSize);
+        transformClasses.resize(BatchSize);
+        for (size_t i = 0; i < BatchSize; ++i)
+        {
+            XMStoreFloat4x4A(&worldMatrices[i],
+                ComposeTransform(XMLoadFloat3(&scales[i]), XMLoadFloat4(&rotations[i]), XMLoadFloat3(&positions[i])));
+            transformClasses[i] = ClassifyScale(scales[i]);
+        }
+    }
+
+    Camera CreateCamera()
+    {
+        Camera camera;
+        XMVECTOR position = XMVectorSet(0.0f, 5.0f, -9.0f, 1.0f);
+        camera.Translate(position);
+        camera.Rotate(XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), 20.0f);
+        CameraProjection projection;
+        projection.AspectRatio = 1280.0f / 720.0f;
+        camera.SetProjection(projection);
+        return camera;
+    }
+
+    // The per-frame camera work for cameraCount views, such as shadow and
+    // reflection cameras: each moves by step (zero for views standing still)
+    // and is asked for its view-projection and frustum.
+    void RunCameraFrames(BenchmarkState& state, size_t cameraCount, float step)
+    {
+        std::vector<Camera> cameras(cameraCount, CreateCamera());
+        for (size_t i = 0; i < cameraCount; ++i)
+        {
+            cameras[i].Rotate(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), 360.0f * i / cameraCount);
+        }
+        const XMVECTOR translation = XMVectorSet(0.0f, 0.0f, step, 0.0f);
+        while (state.KeepRunning())
+        {
+            for (Camera& camera : cameras)
+            {
+                if (step != 0.0f)
+                {
+                    camera.TranslateLocal(translation);
+                }
+                DoNotOptimize(camera.GetViewProjectionMatrix());
+                DoNotOptimize(camera.GetFrustum());
+            }
+        }
+        state.SetItemsProcessed(state.GetIterations() * cameraCount);
+    }
+}
+
+// Camera
+
+void BM_CameraGetViewMatrix(BenchmarkState& state)
+{
+    Camera camera = CreateCamera();
+    while (state.KeepRunning())
+    {
+        DoNotOptimize(camera.GetViewMatrix());
+    }
+}
+BENCHMARK(BM_CameraGetViewMatrix, "Camera/GetViewMatrix");
+
+void BM_CameraTranslateLocal(BenchmarkState& state)
+{
+    Camera camera = CreateCamera();
+    XMVECTOR translation = XMVectorSet(0.0f, 0.0f, 0.01f, 0.0f);
+    while (state.KeepRunning())
+    {
+        camera.TranslateLocal(translation);
+    }
+    DoNotOptimize(camera.GetPositionVector());
+}
+BENCHMARK(BM_CameraTranslateLocal, "Camera/TranslateLocal");
+
+void BM_CameraRotate(BenchmarkState& state)
+{
+    const XMVECTOR axis = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+    Camera camera = CreateCamera();
+    uint64_t iteration = 0;
+    while (state.KeepRunning())
+    {
+        // Start over now and then so rounding does not denormalize the
+        // orientation over billions of iterations.
+        if ((++iteration & 255) == 0)
+        {
+            camera = CreateCamera();
+        }
+        camera.Rotate(axis, 0.5f);
+    }
+    DoNotOptimize(camera.GetViewMatrix());
+}
+BENCHMARK(BM_CameraRotate, "Camera/Rotate");
+
+void BM_CameraGetForwardDirectionFloat(BenchmarkState& state)
+{
+    Camera camera = CreateCamera();
+    while (state.KeepRunning())
+    {
+        DoNotOptimize(camera.GetForwardDirectionFloat());
+    }
+}
+BENCHMARK(BM_CameraGetForwardDirectionFloat, "Camera/GetForwardDirectionFloat");
+
+// Rebuilding every derived value after a move.
+void BM_CameraUpdate(BenchmarkState& state)
+{
+    Camera camera = CreateCamera();
+    const XMVECTOR translation = XMVectorSet(0.0f, 0.0f, 0.001f, 0.0f);
+    while (state.KeepRunning())
+    {
+        camera.TranslateLocal(translation);
+        DoNotOptimize(camera.GetFrustumCorners());
+    }
+}
+BENCHMARK(BM_CameraUpdate, "Camera/Update");
+
+void BM_VectorToFloat4(BenchmarkState& state)
+{
+    XMVECTOR vector = XMVectorSet(1.0f, 2.0f, 3.0f, 4.0f);
+    while (state.KeepRunning())
+    {
+        DoNotOptimize(vector);
+        DoNotOptimize(VectorToFloat4(vector));
+    }
+}
+BENCHMARK(BM_VectorToFloat4, "Camera/VectorToFloat4");
+
+// Mesh
+
+void BM_CreateCubeMesh(BenchmarkState& state)
+{
+    // The cube LoadContent creates.
+    MeshBuildOptions options;
+    options.Format = IF_16Bit;
+    while (state.KeepRunning())
+    {
+        Mesh cube = CreateCubeMesh(2.0f, 1, options);
+        DoNotOptimize(cube.Vertices.data());
+    }
+}
+BENCHMARK(BM_CreateCubeMesh, "Mesh/CreateCubeMesh");
+
+void BM_CreateCubeMeshTessellated(BenchmarkState& state)
+{
+    MeshBuildOptions options;
+    options.Format = IF_16Bit;
+    while (state.KeepRunning())
+    {
+        Mesh cube = CreateCubeMesh(2.0f, 16, options);
+        DoNotOptimize(cube.Vertices.data());
+    }
+}
+BENCHMARK(BM_CreateCubeMeshTessellated, "Mesh/CreateCubeMesh/Tessellation16");
+
+// Transform
+
+// The wall inverses LoadContent computes, with the full XMMatrixInverse it
+// used to call and with the closed form it calls now.
+void BM_InverseTransposeWallsGeneral(BenchmarkState& state)
+{
+    XMFLOAT4X4A worldMatrices[6];
+    CreateWallMatrices(worldMatrices);
+    while (state.KeepRunning())
+    {
+        for (const XMFLOAT4X4A& worldMatrix : worldMatrices)
+        {
+            DoNotOptimize(ComputeInverseTransposeWorldMatrix(XMLoadFloat4x4A(&worldMatrix), TC_General));
+        }
+    }
+    state.SetItemsProcessed(state.GetIterations() * 6);
+}
+BENCHMARK(BM_InverseTransposeWallsGeneral, "Transform/InverseTranspose/Walls/General");
+
+void BM_InverseTransposeWallsAxisScale(BenchmarkState& state)
+{
+    XMFLOAT4X4A worldMatrices[6];
+    CreateWallMatrices(worldMatrices);
+    while (state.KeepRunning())
+    {
+        for (const XMFLOAT4X4A& worldMatrix : worldMatrices)
+        {
+            DoNotOptimize(ComputeInverseTransposeWorldMatrix(XMLoadFloat4x4A(&worldMatrix), TC_AxisScale));
+        }
+    }
+    state.SetItemsProcessed(state.GetIterations() * 6);
+}
+BENCHMARK(BM_InverseTransposeWallsAxisScale, "Transform/InverseTranspose/Walls/AxisScale");
+
+void BM_InverseTransposeBatch(BenchmarkState& state)
+{
+    std::vector<XMFLOAT4X4A> worldMatrices;
+    std::vector<TransformClass> transformClasses;
+    CreateWorldMatrices(worldMatrices, transformClasses);
+    std::vector<XMFLOAT4X4A> inverseTransposeWorldMatrices(BatchSize);
+    while (state.KeepRunning())
+    {
+        ComputeInverseTransposeWorldMatrices(worldMatrices.data(), transformClasses.data(), BatchSize,
+            inverseTransposeWorldMatrices.data());
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(state.GetIterations() * BatchSize);
+}
+BENCHMARK(BM_InverseTransposeBatch, "Transform/InverseTranspose/Batch1024");
+
+// Scene::Update's world matrices, and the general products they replaced.
+void BM_ComposeTransformBatch(BenchmarkState& state)
+{
+    std::vector<XMFLOAT3> scales;
+    std::vector<XMFLOAT4> rotations;
+    std::vector<XMFLOAT3> positions;
+    CreateTransforms(scales, rotations, positions);
+    std::vector<XMFLOAT4X4A> worldMatrices(BatchSize);
+    while (state.KeepRunning())
+    {
+        for (size_t i = 0; i < BatchSize; ++i)
+        {
+            XMStoreFloat4x4A(&worldMatrices[i],
+                ComposeTransform(XMLoadFloat3(&scales[i]), XMLoadFloat4(&rotations[i]), XMLoadFloat3(&positions[i])));
+        }
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(state.GetIterations() * BatchSize);
+}
+BENCHMARK(BM_ComposeTransformBatch, "Transform/Compose/Batch1024");
+
+void BM_MatrixProductTransformBatch(BenchmarkState& state)
+{
+    std::vector<XMFLOAT3> scales;
+    std::vector<XMFLOAT4> rotations;
+    std::vector<XMFLOAT3> positions;
+    CreateTransforms(scales, rotations, positions);
+    std::vector<XMFLOAT4X4A> worldMatrices(BatchSize);
+    while (state.KeepRunning())
+    {
+        for (size_t i = 0; i < BatchSize; ++i)
+        {
+            const XMMATRIX worldMatrix = XMMatrixScalingFromVector(XMLoadFloat3(&scales[i]))
+                * XMMatrixRotationQuaternion(XMLoadFloat4(&rotations[i]))
+                * XMMatrixTranslationFromVector(XMLoadFloat3(&positions[i]));
+            XMStoreFloat4x4A(&worldMatrices[i], worldMatrix);
+        }
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(state.GetIterations() * BatchSize);
+}
+BENCHMARK(BM_MatrixProductTransformBatch, "Transform/MatrixProduct/Batch1024");
+
+// Frame
+
+// The per-frame camera work: view matrix, view-projection product and
+// frustum planes, for a camera that moved.
+void BM_FrameViewProjection(BenchmarkState& state)
+{
+    RunCameraFrames(state, 1, 0.001f);
+}
+BENCHMARK(BM_FrameViewProjection, "Frame/ViewProjection");
+
+void BM_FrameCameras64(BenchmarkState& state)
+{
+    RunCameraFrames(state, 64, 0.001f);
+}
+BENCHMARK(BM_FrameCameras64, "Frame/Cameras64");
+
+// Views that did not move answer from the cache.
+void BM_FrameStillCameras64(BenchmarkState& state)
+{
+    RunCameraFrames(state, 64, 0.0f);
+}
+BENCHMARK(BM_FrameStillCameras64, "Frame/Cameras64/Still");
+
+int main(int argc, char** argv)
+{
+    return RunBenchmarks(argc, argv, GetConfiguration());
+}
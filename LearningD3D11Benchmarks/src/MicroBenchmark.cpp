@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MicroBenchmark.h"
+
+namespace
+{
+    struct RegisteredBenchmark
+    {
+        const char* Name;
+        BenchmarkFunction Function;
+    };
+
+    struct BenchmarkSettings
+    {
+        BenchmarkSettings()
+            : MinTime(0.1)
+            , Repetitions(5)
+            , ListTests(false)
+        {}
+
+        std::string Filter;
+        double MinTime;
+        int Repetitions;
+        std::string OutFile;
+        bool ListTests;
+    };
+
+    struct BenchmarkRun
+    {
+        std::string Name;
+        uint64_t Iterations;
+        double Nanoseconds;         // Per iteration.
+        double ItemsPerSecond;      // 0 if the benchmark reports no items.
+    };
+
+    // Function-local so registration from other translation units' statics
+    // does not depend on initialization order.
+    std::vector<RegisteredBenchmark>& GetRegistry()
+    {
+        static std::vector<RegisteredBenchmark> registry;
+        return registry;
+    }
+
+    // Value of "--name=value", or nullptr if argument is another flag.
+    const char* GetFlagValue(const char* argument, const char* name)
+    {
+        const size_t length = std::strlen(name);
+        if (std::strncmp(argument, name, length) == 0 && argument[length] == '=')
+        {
+            return argument + length + 1;
+        }
+        return nullptr;
+    }
+
+    bool ParseFlags(int argc, char** argv, BenchmarkSettings& settings)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const char* value = nullptr;
+            char* end = nullptr;
+            if ((value = GetFlagValue(argv[i], "--benchmark_filter")) != nullptr)
+            {
+                settings.Filter = value;
+            }
+            else if ((value = GetFlagValue(argv[i], "--benchmark_min_time")) != nullptr)
+            {
+                settings.MinTime = std::strtod(value, &end);
+                if (end == value || settings.MinTime <= 0.0)
+                {
+                    return false;
+                }
+            }
+            else if ((value = GetFlagValue(argv[i], "--benchmark_repetitions")) != nullptr)
+            {
+                settings.Repetitions = static_cast<int>(std::strtol(value, &end, 10));
+                if (end == value || settings.Repetitions < 1)
+                {
+                    return false;
+                }
+            }
+            else if ((value = GetFlagValue(argv[i], "--benchmark_out")) != nullptr)
+            {
+                settings.OutFile = value;
+            }
+            else if (std::strcmp(argv[i], "--benchmark_list_tests") == 0)
+            {
+                settings.ListTests = true;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    double RunOnce(BenchmarkFunction function, uint64_t iterations, uint64_t& itemsProcessed)
+    {
+        BenchmarkState state(iterations);
+        function(state);
+        itemsProcessed = state.GetItemsProcessed();
+        return state.GetElapsedSeconds();
+    }
+
+    // Iterations for one run of about minTime seconds, growing the count
+    // tenfold at most per trial as Google Benchmark does.
+    uint64_t CalibrateIterations(BenchmarkFunction function, double minTime)
+    {
+        const uint64_t maxIterations = 1000000000;
+        uint64_t iterations = 1;
+        for (;;)
+        {
+            uint64_t itemsProcessed = 0;
+            const double seconds = RunOnce(function, iterations, itemsProcessed);
+            if (seconds >= minTime || iterations >= maxIterations)
+            {
+                return iterations;
+            }
+
+            // Aim 40% past the target so the next trial usually passes.
+            double multiplier = (seconds > 0.0) ? minTime * 1.4 / seconds : 10.0;
+            multiplier = std::min(std::max(multiplier, 2.0), 10.0);
+            iterations = std::min(static_cast<uint64_t>(iterations * multiplier), maxIterations);
+        }
+    }
+
+    // Name as a JSON string, quotes included. Benchmark names are plain
+    // ASCII, so only quotes and backslashes need escaping.
+    std::string QuoteJSON(const std::string& text)
+    {
+        std::string quoted("\"");
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                quoted.push_back('\\');
+            }
+            quoted.push_back(c);
+        }
+        quoted.push_back('"');
+        return quoted;
+    }
+
+    bool WriteRun(FILE* file, const BenchmarkRun& run, const char* runType, const char* aggregateName, bool last)
+    {
+        bool written = fprintf(file,
+            "    {\n"
+            "      \"name\": %s,\n"
+            "      \"run_name\": %s,\n"
+            "      \"run_type\": \"%s\",\n",
+            QuoteJSON(aggregateName[0] ? run.Name + "_" + aggregateName : run.Name).c_str(),
+            QuoteJSON(run.Name).c_str(), runType) > 0;
+        if (written && aggregateName[0])
+        {
+            written = fprintf(file, "      \"aggregate_name\": \"%s\",\n", aggregateName) > 0;
+        }
+        written = written && fprintf(file,
+            "      \"iterations\": %llu,\n"
+            "      \"real_time\": %.4f,\n"
+            "      \"cpu_time\": %.4f,\n"
+            "      \"time_unit\": \"ns\"",
+            static_cast<unsigned long long>(run.Iterations), run.Nanoseconds, run.Nanoseconds) > 0;
+        if (written && run.ItemsPerSecond > 0.0)
+        {
+            written = fprintf(file, ",\n      \"items_per_second\": %.4f", run.ItemsPerSecond) > 0;
+        }
+        return written && fprintf(file, "\n    }%s\n", last ? "" : ",") > 0;
+    }
+
+    // Google Benchmark's JSON schema, with the build configuration added to
+    // the context so runs of different configurations are not compared by
+    // mistake.
+    bool WriteJSON(const std::string& fileName, const char* configuration, const std::vector<BenchmarkRun>& runs,
+        const std::vector<size_t>& groupEnds)
+    {
+        FILE* file = std::fopen(fileName.c_str(), "wb");
+        if (!file)
+        {
+            return false;
+        }
+
+        char date[64] = "";
+        const time_t now = std::time(nullptr);
+        struct tm local;
+#if defined(_MSC_VER)
+        localtime_s(&local, &now);
+#else
+        localtime_r(&now, &local);
+#endif
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &local);
+
+        bool written = fprintf(file,
+            "{\n"
+            "  \"context\": {\n"
+            "    \"date\": \"%s\",\n"
+            "    \"num_cpus\": %u,\n"
+            "    \"configuration\": %s,\n"
+#if defined(NDEBUG)
+            "    \"library_build_type\": \"release\"\n"
+#else
+            "    \"library_build_type\": \"debug\"\n"
+#endif
+            "  },\n"
+            "  \"benchmarks\": [\n",
+            date, std::thread::hardware_concurrency(), QuoteJSON(configuration).c_str()) > 0;
+
+        size_t groupBegin = 0;
+        for (size_t group = 0; written && group < groupEnds.size(); ++group)
+        {
+            const size_t groupEnd = groupEnds[group];
+            const bool lastGroup = group + 1 == groupEnds.size();
+            const size_t count = groupEnd - groupBegin;
+            for (size_t i = groupBegin; written && i < groupEnd; ++i)
+            {
+                written = WriteRun(file, runs[i], "iteration", "", lastGroup && count == 1 && i + 1 == groupEnd);
+            }
+
+            // Aggregates only make sense over several repetitions.
+            if (written && count > 1)
+            {
+                std::vector<double> times;
+                std::vector<double> rates;
+                for (size_t i = groupBegin; i < groupEnd; ++i)
+                {
+                    times.push_back(runs[i].Nanoseconds);
+                    rates.push_back(runs[i].ItemsPerSecond);
+                }
+
+                BenchmarkRun mean = runs[groupBegin];
+                double sum = 0.0;
+                double rateSum = 0.0;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    sum += times[i];
+                    rateSum += rates[i];
+                }
+                mean.Nanoseconds = sum / count;
+                mean.ItemsPerSecond = rateSum / count;
+
+                BenchmarkRun median = runs[groupBegin];
+                std::sort(times.begin(), times.end());
+                std::sort(rates.begin(), rates.end());
+                median.Nanoseconds = (count % 2) ? times[count / 2] : (times[count / 2 - 1] + times[count / 2]) * 0.5;
+                median.ItemsPerSecond = (count % 2) ? rates[count / 2] : (rates[count / 2 - 1] + rates[count / 2]) * 0.5;
+
+                BenchmarkRun deviation = runs[groupBegin];
+                double squares = 0.0;
+                double rateSquares = 0.0;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    squares += (times[i] - mean.Nanoseconds) * (times[i] - mean.Nanoseconds);
+                    rateSquares += (rates[i] - mean.ItemsPerSecond) * (rates[i] - mean.ItemsPerSecond);
+                }
+                deviation.Nanoseconds = std::sqrt(squares / (count - 1));
+                deviation.ItemsPerSecond = std::sqrt(rateSquares / (count - 1));
+
+                written = WriteRun(file, mean, "aggregate", "mean", false)
+                    && WriteRun(file, median, "aggregate", "median", false)
+                    && WriteRun(file, deviation, "aggregate", "stddev", lastGroup);
+            }
+            groupBegin = groupEnd;
+        }
+        written = written && fprintf(file, "  ]\n}\n") > 0;
+
+        written = (std::fclose(file) == 0) && written;
+        if (!written)
+        {
+            std::remove(fileName.c_str());
+        }
+        return written;
+    }
+}
+
+bool RegisterBenchmark(const char* name, BenchmarkFunction function)
+{
+    GetRegistry().push_back(RegisteredBenchmark{ name, function });
+    return true;
+}
+
+int RunBenchmarks(int argc, char** argv, const char* configuration)
+{
+    BenchmarkSettings settings;
+    if (!ParseFlags(argc, argv, settings))
+    {
+        fprintf(stderr, "Usage: %s [--benchmark_filter=<text>] [--benchmark_min_time=<seconds>]\n"
+            "    [--benchmark_repetitions=<n>] [--benchmark_out=<file>] [--benchmark_list_tests]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<RegisteredBenchmark> benchmarks;
+    for (const RegisteredBenchmark& benchmark : GetRegistry())
+    {
+        if (std::strstr(benchmark.Name, settings.Filter.c_str()))
+        {
+            benchmarks.push_back(benchmark);
+        }
+    }
+    std::sort(benchmarks.begin(), benchmarks.end(), [](const RegisteredBenchmark& a, const RegisteredBenchmark& b)
+    {
+        return std::strcmp(a.Name, b.Name) < 0;
+    });
+
+    if (settings.ListTests)
+    {
+        for (const RegisteredBenchmark& benchmark : benchmarks)
+        {
+            printf("%s\n", benchmark.Name);
+        }
+        return 0;
+    }
+
+    printf("Configuration: %s\n", configuration);
+    printf("%-48s %14s %14s %14s\n", "Benchmark", "Time (ns)", "Iterations", "Items/s");
+    std::vector<BenchmarkRun> runs;
+    std::vector<size_t> groupEnds;
+    for (const RegisteredBenchmark& benchmark : benchmarks)
+    {
+        const uint64_t iterations = CalibrateIterations(benchmark.Function, settings.MinTime);
+        for (int repetition = 0; repetition < settings.Repetitions; ++repetition)
+        {
+            uint64_t itemsProcessed = 0;
+            const double seconds = RunOnce(benchmark.Function, iterations, itemsProcessed);
+
+            BenchmarkRun run;
+            run.Name = benchmark.Name;
+            run.Iterations = iterations;
+            run.Nanoseconds = seconds * 1e9 / iterations;
+            run.ItemsPerSecond = (itemsProcessed && seconds > 0.0) ? itemsProcessed / seconds : 0.0;
+            runs.push_back(run);
+
+            printf("%-48s %14.2f %14llu %14.4g\n", run.Name.c_str(), run.Nanoseconds,
+                static_cast<unsigned long long>(run.Iterations), run.ItemsPerSecond);
+        }
+        groupEnds.push_back(runs.size());
+    }
+
+    if (!settings.OutFile.empty() && !WriteJSON(settings.OutFile, configuration, runs, groupEnds))
+    {
+        fprintf(stderr, "Could not write %s\n", settings.OutFile.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Headless checks and benchmarks of the device-independent code. None of
+// them creates a window or a D3D device. Each prints its results to stdout
+// and returns 0 on success and -1 if a check failed.
+
+// Print "<mode>: FAILED <what>" unless condition holds, and return condition.
+// The modes count failures with failureCount += !Check(...).
+bool Check(const char* mode, bool condition, const char* what);
+
+// Size of the app's window; the scene modes render and cull as seen in it.
+const int g_ScreenWidth = 1280;
+const int g_ScreenHeight = 720;
+
+// Shader, layout and buffer ids the queue modes submit. Only equality
+// matters to the queue, so these need not match the app's.
+enum InputLayoutId { IL_Simple, IL_Instanced };
+enum VertexShaderId { VS_Simple, VS_Instanced };
+enum PixelShaderId { PX_Simple, PX_Unlit };
+enum VertexBufferId { VB_Cube, VB_CubeFieldInstances };
+enum IndexBufferId { IB_Cube };
+
+// SceneTests.cpp
+int RunSoftware(const std::string& outputFileName, const std::string& goldenFileName, int frameCount);
+int RunRenderQueueStats(int drawCount);
+int RunShadowBenchmark();
+int RunSceneUpdateBenchmark(int entityCount);
+int RunTransformBenchmark(int matrixCount);
+
+// RenderingTests.cpp
+int RunClusteredLightingBenchmark(int lightCount, int frameCount);
+int RunVertexFormatBenchmark();
+int RunCommandListBenchmark(int drawCount);
+int RunCameraBenchmark();
+int RunCullingBenchmark(int instanceCount);
+int RunLodBenchmark(int instanceCount);
+int RunOcclusionBenchmark(int boxCount);
+int RunBvhBenchmark();
+int RunLightingBenchmark(int pointCount);
+int RunMaterialTableBenchmark(int materialCount);
+
+// AssetTests.cpp
+int RunMeshBenchmark();
+int RunMeshFileBenchmark();
+int RunTextureStreamingBenchmark(int textureCount, int frameCount);
+int RunTextureCookerBenchmark(uint32_t size, int repeatCount);
+int RunShaderArchiveBenchmark(int shaderCount);
+
+// RuntimeTests.cpp
+int RunFrameSchedulerBenchmark();
+int RunProfilerBenchmark();
+int RunJobSystemBenchmark();
+int RunUploadRingBenchmark();
@@ -0,0 +1,657 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "BlockCompression.h"
+#include "DDSFile.h"
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "ParallelFor.h"
+#include "ProceduralMesh.h"
+#include "RecordingTextureUploadSink.h"
+#include "ShaderArchive.h"
+#include "TestModes.h"
+#include "TextureCooker.h"
+#include "TextureStreaming.h"
+#include "VertexFormats.h"
+
+using namespace DirectX;
+
+/**
+* Generate every procedural mesh at a tessellation of a couple of million
+* triangles and time generation and each optimization pass, reporting ACMR
+* and ATVR (16 entry FIFO cache) before and after.
+* No window or D3D device is created.
+*/
+int RunMeshBenchmark()
+{
+    struct MeshCase
+    {
+        const char* Name;
+        Mesh (*Create)(const MeshBuildOptions& options);
+    };
+
+    const MeshCase meshCases[] =
+    {
+        { "cube", [](const MeshBuildOptions& options) { return CreateCubeMesh(2.0f, 400, options); } },
+        { "uv sphere", [](const MeshBuildOptions& options) { return CreateUVSphereMesh(1.0f, 1024, 1024, options); } },
+        { "icosphere", [](const MeshBuildOptions& options) { return CreateIcosphereMesh(1.0f, 8, options); } },
+        { "grid", [](const MeshBuildOptions& options) { return CreateGridMesh(10.0f, 10.0f, 1024, 1024, options); } },
+        { "cylinder", [](const MeshBuildOptions& options) { return CreateCylinderMesh(1.0f, 2.0f, 2048, 512, options); } },
+        { "torus", [](const MeshBuildOptions& options) { return CreateTorusMesh(1.0f, 0.3f, 2048, 512, options); } },
+    };
+
+    auto elapsedMilliseconds = [](std::chrono::high_resolution_clock::time_point startTime)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+    };
+
+    char message[256];
+    snprintf(message, sizeof(message), "  %-10s %9s %8s %8s %8s %8s %15s %15s\n",
+        "mesh", "triangles", "generate", "vcache", "overdraw", "vfetch", "ACMR", "ATVR");
+    std::cout << message;
+
+    for (const MeshCase& meshCase : meshCases)
+    {
+        // Generate unoptimized so each pass can be timed on its own.
+        MeshBuildOptions options;
+        options.Optimize = false;
+
+        auto startTime = std::chrono::high_resolution_clock::now();
+        Mesh mesh = meshCase.Create(options);
+        const double generateTime = elapsedMilliseconds(startTime);
+
+        const VertexCacheStatistics before = AnalyzeVertexCache(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.size());
+
+        startTime = std::chrono::high_resolution_clock::now();
+        OptimizeVertexCache(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.size());
+        const double vertexCacheTime = elapsedMilliseconds(startTime);
+
+        startTime = std::chrono::high_resolution_clock::now();
+        OptimizeOverdraw(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.data(), mesh.Vertices.size());
+        const double overdrawTime = elapsedMilliseconds(startTime);
+
+        startTime = std::chrono::high_resolution_clock::now();
+        mesh.Vertices.resize(OptimizeVertexFetch(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.data(), mesh.Vertices.size()));
+        const double vertexFetchTime = elapsedMilliseconds(startTime);
+
+        const VertexCacheStatistics after = AnalyzeVertexCache(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.size());
+
+        snprintf(message, sizeof(message), "  %-10s %9zu %6.0fms %6.0fms %6.0fms %6.0fms %6.3f -> %5.3f %6.3f -> %5.3f\n",
+            meshCase.Name, mesh.GetTriangleCount(), generateTime, vertexCacheTime, overdrawTime, vertexFetchTime,
+            before.ACMR, after.ACMR, before.ATVR, after.ATVR);
+        std::cout << message;
+    }
+
+    return 0;
+}
+
+namespace
+{
+    // Size of the mesh file cooked by -meshfile.
+    const uint64_t g_MeshFileBenchmarkSize = 2ull << 30;
+}
+
+/**
+* Cook a mesh file of about g_MeshFileBenchmarkSize bytes from copies of a
+* packed grid, then load it twice: memory mapped, and read into heap buffers.
+* Both loads end by copying the vertex and index sections through a staging
+* block, as CreateBuffer does with pSysMem, so the difference is the
+* intermediate copy the mapping avoids. The file was just written, so both
+* loads read from a warm file cache. No window or D3D device is created.
+*/
+int RunMeshFileBenchmark()
+{
+    using Clock = std::chrono::high_resolution_clock;
+    const char* fileName = "MeshFileBenchmark.ldmesh";
+    char message[256];
+
+    MeshBuildOptions options;
+    options.Format = IF_32Bit;
+    options.Optimize = false;
+    const Mesh grid = CreateGridMesh(100.0f, 100.0f, 1024, 1024, options);
+    const size_t vertexCount = grid.Vertices.size();
+    const size_t indexCount = grid.GetIndexCount();
+
+    const VertexQuantization quantization = ComputeVertexQuantization(grid.Vertices.data(), vertexCount, PE_Unorm16);
+    std::vector<VertexPacked> packedVertices(vertexCount);
+    PackVertices(grid.Vertices.data(), vertexCount, quantization, PE_Unorm16, packedVertices.data());
+
+    const uint64_t chunkSize = sizeof(VertexPacked) * vertexCount + sizeof(uint32_t) * indexCount;
+    const uint32_t chunkCount = static_cast<uint32_t>((g_MeshFileBenchmarkSize + chunkSize - 1) / chunkSize);
+
+    {// Cook: all vertex chunks, then all index chunks, one submesh per chunk.
+        const Clock::time_point start = Clock::now();
+
+        MeshFileWriter writer;
+        bool written = writer.Open(fileName, MVF_PackedUnorm16, sizeof(uint32_t));
+        writer.SetQuantization(quantization);
+        const float boundsMin[3] = { -50.0f, 0.0f, -50.0f };
+        const float boundsMax[3] = { 50.0f, 0.0f, 50.0f };
+        writer.SetBounds(boundsMin, boundsMax);
+        for (uint32_t chunk = 0; chunk < chunkCount && written; ++chunk)
+        {
+            written = writer.WriteVertices(packedVertices.data(), vertexCount);
+        }
+        for (uint32_t chunk = 0; chunk < chunkCount && written; ++chunk)
+        {
+            written = writer.WriteIndices(grid.Indices.data(), indexCount);
+
+            MeshFileSubmesh submesh;
+            submesh.IndexStart = static_cast<uint32_t>(chunk * indexCount);
+            submesh.IndexCount = static_cast<uint32_t>(indexCount);
+            submesh.BaseVertex = static_cast<uint32_t>(chunk * vertexCount);
+            submesh.MaterialIndex = 0;
+            std::copy(boundsMin, boundsMin + 3, submesh.BoundsMin);
+            std::copy(boundsMax, boundsMax + 3, submesh.BoundsMax);
+            writer.AddSubmesh(submesh);
+        }
+        if (!written || !writer.Close())
+        {
+            snprintf(message, sizeof(message), "Failed to write %.2f GB mesh file.\n", g_MeshFileBenchmarkSize / double(1ull << 30));
+            std::cout << message;
+            return -1;
+        }
+
+        const double cookTime = std::chrono::duration<double>(Clock::now() - start).count();
+        snprintf(message, sizeof(message), "Mesh file: %u submeshes, %.2f GB, cooked in %.2f s (%.2f GB/s)\n",
+            chunkCount, chunkCount * chunkSize / double(1ull << 30), cookTime, chunkCount * chunkSize / double(1ull << 30) / cookTime);
+        std::cout << message;
+    }
+
+    // Stand-in for the driver's copy of pSysMem into GPU memory.
+    std::vector<uint8_t> staging(64 << 20);
+    auto upload = [&staging](const void* data, uint64_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (uint64_t offset = 0; offset < size; offset += staging.size())
+        {
+            const size_t blockSize = static_cast<size_t>(std::min<uint64_t>(staging.size(), size - offset));
+            memcpy(staging.data(), bytes + offset, blockSize);
+        }
+    };
+
+    double mappedOpenTime = 0.0, mappedLoadTime = 0.0;
+    uint64_t loadedSize = 0;
+    {// Memory mapped: validate the header, then upload straight from the mapping.
+        const Clock::time_point start = Clock::now();
+
+        MappedMeshFile file;
+        if (!file.Open(fileName))
+        {
+            RemoveFile(fileName);
+            return -1;
+        }
+        mappedOpenTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        upload(file.GetVertexData(), file.GetVertexDataSize());
+        upload(file.GetIndexData(), file.GetIndexDataSize());
+        loadedSize = file.GetVertexDataSize() + file.GetIndexDataSize();
+        mappedLoadTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    double readLoadTime = 0.0;
+    {// Read into heap buffers, then upload from those.
+        const Clock::time_point start = Clock::now();
+
+        FILE* file = OpenFile(fileName, "rb");
+        MeshFileHeader header;
+        if (!file || fread(&header, sizeof(MeshFileHeader), 1, file) != 1)
+        {
+            if (file)
+            {
+                fclose(file);
+            }
+            RemoveFile(fileName);
+            return -1;
+        }
+        std::vector<uint8_t> vertexData(static_cast<size_t>(header.VertexCount * header.VertexStride));
+        std::vector<uint8_t> indexData(static_cast<size_t>(header.IndexCount * header.IndexSize));
+        SeekFile(file, header.VertexDataOffset);
+        const bool read = fread(vertexData.data(), 1, vertexData.size(), file) == vertexData.size();
+        SeekFile(file, header.IndexDataOffset);
+        const bool readIndices = fread(indexData.data(), 1, indexData.size(), file) == indexData.size();
+        fclose(file);
+        if (!read || !readIndices)
+        {
+            RemoveFile(fileName);
+            return -1;
+        }
+
+        upload(vertexData.data(), vertexData.size());
+        upload(indexData.data(), indexData.size());
+        readLoadTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+    RemoveFile(fileName);
+
+    const double loadedGB = loadedSize / double(1ull << 30);
+    snprintf(message, sizeof(message), "  mapped: open %.3f ms, load %.1f ms (%.2f GB/s)\n", mappedOpenTime, mappedLoadTime, loadedGB / (mappedLoadTime / 1000.0));
+    std::cout << message;
+    snprintf(message, sizeof(message), "  read:   load %.1f ms (%.2f GB/s)\n", readLoadTime, loadedGB / (readLoadTime / 1000.0));
+    std::cout << message;
+
+    return 0;
+}
+
+namespace
+{
+    // Procedural stand-in for image files, for the headless streaming run. The
+    // size comes from the number in the name: 256 << (n % 4) pixels square.
+    class ProceduralTextureDecoder : public TextureDecoder
+    {
+    public:
+        bool Decode(const std::string& fileName, TextureImage& image) override
+        {
+            const size_t digits = fileName.find_first_of("0123456789");
+            if (digits == std::string::npos)
+            {
+                return false;
+            }
+            const int number = std::stoi(fileName.substr(digits));
+            image.Width = image.Height = 256u << (number % 4);
+            image.Mips.assign(1, std::vector<uint8_t>(size_t(image.Width) * image.Height * 4));
+
+            uint8_t* pixel = image.Mips[0].data();
+            for (uint32_t y = 0; y < image.Height; ++y)
+            {
+                for (uint32_t x = 0; x < image.Width; ++x, pixel += 4)
+                {
+                    const uint8_t checker = (((x >> 4) ^ (y >> 4)) & 1) ? 255 : 0;
+                    pixel[0] = checker;
+                    pixel[1] = static_cast<uint8_t>(number * 37);
+                    pixel[2] = static_cast<uint8_t>(x ^ y);
+                    pixel[3] = 255;
+                }
+            }
+            return true;
+        }
+    };
+}
+
+/**
+* Stream textureCount procedural textures under a budget smaller than their
+* total size while a window of visible textures slides across them, and
+* report queue depth, residency and time to first pixel. Fails if the budget
+* is exceeded or the recorded residency disagrees with the streamer's.
+* No window or D3D device is created.
+*/
+int RunTextureStreamingBenchmark(int textureCount, int frameCount)
+{
+    const int visibleCount = 32;
+    const uint64_t budget = 128ull << 20;
+
+    ProceduralTextureDecoder decoder;
+    RecordingTextureUploadSink sink;
+    TextureStreamingSettings settings;
+    settings.BudgetBytes = budget;
+    TextureStreamer streamer(decoder, sink, settings);
+
+    std::vector<TextureHandle> textures;
+    uint64_t totalSize = 0;
+    for (int i = 0; i < textureCount; ++i)
+    {
+        textures.push_back(streamer.Request("texture" + std::to_string(i)));
+        const uint32_t size = 256u << (i % 4);
+        totalSize += GetMipChainSize(TF_RGBA8, size, size, GetFullMipCount(size, size), 0);
+    }
+
+    char message[256];
+    snprintf(message, sizeof(message), "Texture streaming: %d textures, %.0f MB with all mips, %.0f MB budget\n",
+        textureCount, totalSize / double(1 << 20), budget / double(1 << 20));
+    std::cout << message;
+    snprintf(message, sizeof(message), "  %6s %6s %9s %12s %10s %8s %18s\n", "frame", "queue", "resident", "MB resident", "MB upload", "evicted", "first pixel ms");
+    std::cout << message;
+
+    int result = 0;
+    for (int frame = 1; frame <= frameCount; ++frame)
+    {
+        // The visible window advances one texture every 8 frames; nearer
+        // textures want more detail.
+        const int firstVisible = (frame / 8) % textureCount;
+        for (int i = 0; i < visibleCount; ++i)
+        {
+            streamer.MarkUsed(textures[(firstVisible + i) % textureCount], i % 3);
+        }
+        streamer.Update(frame);
+        // Rendering time, during which the decode threads run.
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+        const TextureStreamingStats stats = streamer.GetStats();
+        if (stats.BytesResident > budget || stats.BytesResident != sink.GetBytesResident() || sink.GetErrorCount() > 0)
+        {
+            snprintf(message, sizeof(message), "  frame %d: %llu bytes resident, sink has %llu, %u sink errors\n", frame,
+                static_cast<unsigned long long>(stats.BytesResident), static_cast<unsigned long long>(sink.GetBytesResident()), sink.GetErrorCount());
+            std::cout << message;
+            result = -1;
+            break;
+        }
+
+        if (frame % (frameCount / 10) == 0)
+        {
+            snprintf(message, sizeof(message), "  %6d %6u %4u/%-4u %12.1f %10.1f %8u %8.1f / %7.1f\n", frame, stats.QueueDepth,
+                stats.ResidentTextureCount, stats.TextureCount, stats.BytesResident / double(1 << 20),
+                stats.BytesUploaded / double(1 << 20), stats.MipsEvicted, stats.AverageTimeToFirstPixel, stats.MaxTimeToFirstPixel);
+            std::cout << message;
+        }
+    }
+
+    snprintf(message, sizeof(message), "  peak %.1f MB resident, %u uploads, %u trims\n",
+        sink.GetPeakBytesResident() / double(1 << 20), sink.GetUploadCount(), sink.GetTrimCount());
+    std::cout << message;
+    return result;
+}
+
+/**
+* Cook a procedural image with gradients, soft edges and noise to BC1, BC3
+* and BC7 and report encoding throughput in megapixels per second (all mips)
+* and the PSNR of the decoded top level. Also times the gamma-correct mip
+* filter and checks that a cooked texture survives a DDS round trip.
+* Fails if any format drops below its quality bar.
+* No window or D3D device is created.
+*/
+int RunTextureCookerBenchmark(uint32_t size, int repeatCount)
+{
+    TextureImage source;
+    source.Width = source.Height = size;
+    source.Mips.assign(1, std::vector<uint8_t>(size_t(size) * size * 4));
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> noise(-6, 6);
+    uint8_t* pixel = source.Mips[0].data();
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x, pixel += 4)
+        {
+            const float u = float(x) / size;
+            const float v = float(y) / size;
+            const float wave = 0.5f + 0.5f * std::sin(u * 18.0f) * std::cos(v * 11.0f);
+            const float radius = std::sqrt((u - 0.5f) * (u - 0.5f) + (v - 0.5f) * (v - 0.5f));
+            const bool tile = ((x >> 6) ^ (y >> 6)) & 1;
+            pixel[0] = static_cast<uint8_t>(std::min(std::max(int(wave * 230.0f) + 20 * tile + noise(random), 0), 255));
+            pixel[1] = static_cast<uint8_t>(std::min(std::max(int(u * 200.0f + v * 55.0f) + noise(random), 0), 255));
+            pixel[2] = static_cast<uint8_t>(std::min(std::max(int((1.0f - wave) * 160.0f) + 60 * tile + noise(random), 0), 255));
+            pixel[3] = static_cast<uint8_t>(std::min(std::max(int(255.0f - radius * 300.0f), 0), 255));
+        }
+    }
+
+    char message[256];
+    snprintf(message, sizeof(message), "Texture cooker: %ux%u source, %u threads\n", size, size, GetDefaultThreadCount());
+    std::cout << message;
+
+    // Mip generation on its own.
+    TextureImage mipChain;
+    for (int gammaCorrect = 1; gammaCorrect >= 0; --gammaCorrect)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (int repeat = 0; repeat < repeatCount; ++repeat)
+        {
+            mipChain = source;
+            GenerateMipChain(mipChain, gammaCorrect != 0);
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() / repeatCount;
+        snprintf(message, sizeof(message), "  mip chain (%s) %8.1f MP/s\n", gammaCorrect ? "gamma correct" : "as stored", double(size) * size / seconds / 1e6);
+        std::cout << message;
+    }
+
+    // Each format's quality bar; BC1 is measured on color only.
+    const struct
+    {
+        TextureFormat Format;
+        const char* Name;
+        bool IncludeAlpha;
+        double MinimumPSNR;
+    } formats[] =
+    {
+        { TF_BC1, "BC1", false, 30.0 },
+        { TF_BC3, "BC3", true, 32.0 },
+        { TF_BC7, "BC7", true, 36.0 },
+    };
+
+    const double mipChainPixels = double(GetMipChainSize(TF_RGBA8, size, size, mipChain.GetMipCount(), 0)) / 4;
+    int result = 0;
+    for (const auto& format : formats)
+    {
+        TextureImage compressed;
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (int repeat = 0; repeat < repeatCount; ++repeat)
+        {
+            CompressImage(mipChain, format.Format, compressed);
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() / repeatCount;
+
+        TextureImage decompressed;
+        const double psnr = DecompressImage(compressed, decompressed) ? ComputePSNR(source, decompressed, format.IncludeAlpha) : 0.0;
+        const bool passed = psnr >= format.MinimumPSNR;
+        snprintf(message, sizeof(message), "  %s %8.2f MP/s %6.2f dB PSNR (at least %.0f) %s\n", format.Name,
+            mipChainPixels / seconds / 1e6, psnr, format.MinimumPSNR, passed ? "" : "FAILED");
+        std::cout << message;
+        result = passed ? result : -1;
+    }
+
+    // The runtime loads exactly what the cooker wrote.
+    TextureCookOptions options;
+    options.Format = TF_BC7;
+    options.SRGB = true;
+    TextureImage cooked;
+    TextureImage loaded;
+    const char* fileName = "TextureCookerBenchmark.dds";
+    const bool roundTrip = CookTexture(source, options, cooked)
+        && WriteDDSFile(fileName, cooked) && ReadDDSFile(fileName, loaded)
+        && loaded.Width == cooked.Width && loaded.Height == cooked.Height
+        && loaded.Format == cooked.Format && loaded.SRGB == cooked.SRGB && loaded.Mips == cooked.Mips;
+    RemoveFile(fileName);
+    snprintf(message, sizeof(message), "  DDS round trip (BC7 sRGB, %u mips) %s\n", cooked.GetMipCount(), roundTrip ? "passed" : "FAILED");
+    std::cout << message;
+    return roundTrip ? result : -1;
+}
+
+/**
+* Build an archive of shaderCount synthetic shader variants and time mapping
+* it, looking every variant up (with and without building the key) and
+* looking up missing ones. The same bytecode read from one loose file per
+* shader is the baseline. Fails if a lookup returns the wrong bytecode.
+* Timings are with a warm file cache. No window or D3D device is created.
+*/
+int RunShaderArchiveBenchmark(int shaderCount)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const char* archiveFileName = "ShaderArchiveBenchmark.ldsa";
+    const int baseShaderCount = 500;
+    const char* featureNames[4] = { "NORMAL_MAP", "SHADOWS", "FOG", "ALPHA_TEST" };
+
+    // Shader i is base shader i % 500 in stage (i / 500) % 2, variant
+    // i / 1000, with the variant's feature bits as defines listed in no
+    // particular order. Its bytecode starts with i.
+    struct Variant
+    {
+        std::string Name;
+        const char* Profile;
+        std::string Value;
+        std::vector<ShaderDefine> Defines;
+    };
+    std::vector<Variant> variants(shaderCount);
+    std::vector<std::vector<uint8_t>> bytecodes(shaderCount);
+    std::mt19937 random(15);
+    for (int i = 0; i < shaderCount; ++i)
+    {
+        Variant& variant = variants[i];
+        variant.Name = "Shader" + std::to_string(i % baseShaderCount);
+        variant.Profile = ((i / baseShaderCount) % 2) ? "ps_5_0" : "vs_5_0";
+        variant.Value = std::to_string(i / (2 * baseShaderCount));
+        variant.Defines.push_back(ShaderDefine{ "VARIANT", variant.Value.c_str() });
+        for (int feature = 0; feature < 4; ++feature)
+        {
+            if ((i / (2 * baseShaderCount)) & (1 << feature))
+            {
+                variant.Defines.insert(variant.Defines.begin(), ShaderDefine{ featureNames[feature], "1" });
+            }
+        }
+
+        bytecodes[i].resize(1024 + random() % 5120);
+        for (uint8_t& byte : bytecodes[i])
+        {
+            byte = static_cast<uint8_t>(random());
+        }
+        std::memcpy(bytecodes[i].data(), &i, sizeof(i));
+    }
+
+    char message[256];
+    int result = 0;
+
+    auto start = Clock::now();
+    ShaderArchiveBuilder builder;
+    for (int i = 0; i < shaderCount; ++i)
+    {
+        const Variant& variant = variants[i];
+        if (!builder.Add(variant.Name.c_str(), variant.Profile, variant.Defines.data(), variant.Defines.size(), bytecodes[i].data(), bytecodes[i].size()))
+        {
+            result = -1;
+        }
+    }
+    if (!builder.Write(archiveFileName))
+    {
+        snprintf(message, sizeof(message), "Shader archive: failed to write %d shaders\n", shaderCount);
+        std::cout << message;
+        return -1;
+    }
+    const double buildSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Mapping and validating the table.
+    const int openCount = 100;
+    ShaderArchive archive;
+    start = Clock::now();
+    for (int repeat = 0; repeat < openCount; ++repeat)
+    {
+        archive.Close();
+        if (!archive.Open(archiveFileName))
+        {
+            result = -1;
+            break;
+        }
+    }
+    const double openSeconds = std::chrono::duration<double>(Clock::now() - start).count() / openCount;
+
+    snprintf(message, sizeof(message), "Shader archive: %u shaders in %u buckets, built and written in %.1f ms\n",
+        archive.IsOpen() ? archive.GetEntryCount() : 0, archive.IsOpen() ? archive.GetBucketCount() : 0, buildSeconds * 1000.0);
+    std::cout << message;
+    if (!archive.IsOpen())
+    {
+        RemoveFile(archiveFileName);
+        return -1;
+    }
+
+    // Lookups with prebuilt keys, with keys built from name, profile and
+    // defines, and of keys that are not in the archive.
+    std::vector<std::string> keys(shaderCount);
+    std::vector<std::string> missingKeys(shaderCount);
+    for (int i = 0; i < shaderCount; ++i)
+    {
+        keys[i] = MakeShaderKey(variants[i].Name.c_str(), variants[i].Profile, variants[i].Defines.data(), variants[i].Defines.size());
+        missingKeys[i] = MakeShaderKey(variants[i].Name.c_str(), "cs_5_0", variants[i].Defines.data(), variants[i].Defines.size());
+    }
+
+    const int lookupRepeats = 20;
+    uint64_t checksum = 0;
+    start = Clock::now();
+    for (int repeat = 0; repeat < lookupRepeats; ++repeat)
+    {
+        for (int i = 0; i < shaderCount; ++i)
+        {
+            checksum += archive.Find(keys[i]);
+        }
+    }
+    const double lookupSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (int repeat = 0; repeat < lookupRepeats; ++repeat)
+    {
+        for (int i = 0; i < shaderCount; ++i)
+        {
+            const Variant& variant = variants[i];
+            checksum += archive.Find(variant.Name.c_str(), variant.Profile, variant.Defines.data(), variant.Defines.size());
+        }
+    }
+    const double keyedLookupSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    int missesFound = 0;
+    start = Clock::now();
+    for (int repeat = 0; repeat < lookupRepeats; ++repeat)
+    {
+        for (int i = 0; i < shaderCount; ++i)
+        {
+            missesFound += (archive.Find(missingKeys[i]) != InvalidShaderEntry) ? 1 : 0;
+        }
+    }
+    const double missSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Every variant finds its own bytecode.
+    int wrongShaders = missesFound;
+    for (int i = 0; i < shaderCount; ++i)
+    {
+        const uint32_t entry = archive.Find(keys[i]);
+        if (entry == InvalidShaderEntry || archive.GetBytecodeSize(entry) != bytecodes[i].size()
+            || std::memcmp(archive.GetBytecode(entry), bytecodes[i].data(), bytecodes[i].size()) != 0)
+        {
+            ++wrongShaders;
+        }
+    }
+    archive.Close();
+    RemoveFile(archiveFileName);
+
+    // Baseline: one file per shader.
+    for (int i = 0; i < shaderCount; ++i)
+    {
+        const std::string fileName = "ShaderArchiveBenchmark" + std::to_string(i) + ".cso";
+        FILE* file = OpenFile(fileName.c_str(), "wb");
+        if (file)
+        {
+            fwrite(bytecodes[i].data(), 1, bytecodes[i].size(), file);
+            fclose(file);
+        }
+    }
+    std::vector<uint8_t> buffer;
+    start = Clock::now();
+    for (int i = 0; i < shaderCount; ++i)
+    {
+        const std::string fileName = "ShaderArchiveBenchmark" + std::to_string(i) + ".cso";
+        FILE* file = OpenFile(fileName.c_str(), "rb");
+        if (!file)
+        {
+            ++wrongShaders;
+            continue;
+        }
+        buffer.resize(bytecodes[i].size());
+        if (fread(buffer.data(), 1, buffer.size(), file) != buffer.size())
+        {
+            ++wrongShaders;
+        }
+        fclose(file);
+        checksum += buffer[0];
+    }
+    const double looseSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    for (int i = 0; i < shaderCount; ++i)
+    {
+        RemoveFile(("ShaderArchiveBenchmark" + std::to_string(i) + ".cso").c_str());
+    }
+
+    snprintf(message, sizeof(message), "  open and map %10.1f us\n", openSeconds * 1e6);
+    std::cout << message;
+    snprintf(message, sizeof(message), "  lookup       %10.1f ns (prebuilt key)\n", lookupSeconds * 1e9 / (double(shaderCount) * lookupRepeats));
+    std::cout << message;
+    snprintf(message, sizeof(message), "  lookup       %10.1f ns (name, profile and defines)\n", keyedLookupSeconds * 1e9 / (double(shaderCount) * lookupRepeats));
+    std::cout << message;
+    snprintf(message, sizeof(message), "  miss         %10.1f ns\n", missSeconds * 1e9 / (double(shaderCount) * lookupRepeats));
+    std::cout << message;
+    snprintf(message, sizeof(message), "  loose files  %10.1f ms to open and read all %d (%.1f us each)\n",
+        looseSeconds * 1000.0, shaderCount, looseSeconds * 1e6 / shaderCount);
+    std::cout << message;
+    snprintf(message, sizeof(message), "  %d wrong or missing shaders (checksum %llu)\n", wrongShaders, static_cast<unsigned long long>(checksum));
+    std::cout << message;
+    return (wrongShaders == 0) ? result : -1;
+}
@@ -0,0 +1,1973 @@
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <vector>
+#include "BoundingVolumeHierarchy.h"
+#include "Camera.h"
+#include "ClusteredLighting.h"
+#include "CommandList.h"
+#include "DemoScene.h"
+#include "FrustumCulling.h"
+#include "LevelOfDetail.h"
+#include "Lighting.h"
+#include "MaterialTable.h"
+#include "OcclusionCulling.h"
+#include "ParallelFor.h"
+#include "ProceduralMesh.h"
+#include "RecordingRenderContext.h"
+#include "RenderQueue.h"
+#include "TestModes.h"
+#include "VertexFormats.h"
+
+using namespace DirectX;
+
+namespace
+{
+    // Time allowed for assigning lights to clusters, in milliseconds per frame.
+    const double g_LightAssignmentBudget = 2.0;
+
+    // What a cluster's light list must lie between. AssignLights may drop a
+    // light that touches a cluster's box but not the frustum cell inside it,
+    // so the list is checked from both sides.
+    struct ClusterLightBounds
+    {
+        std::vector<uint32_t> Touching;     // Sphere touches the cluster's box.
+        std::vector<uint32_t> Covering;     // Sphere covers a point of the cell.
+    };
+
+    // Brute force over every light and cluster, without the tile and slice
+    // ranges AssignLights narrows the search with. The spheres are the ones
+    // BoundLight documents: the range for point lights, the cone's bounding
+    // sphere for spot lights and everything for directional lights. The cell
+    // points are a 3 x 3 x 3 lattice from corner to corner.
+    std::vector<ClusterLightBounds> AssignLightsBruteForce(FXMMATRIX view, float tanHalfFovX, float tanHalfFovY,
+        float nearZ, float farZ, const std::vector<Light>& lights)
+    {
+        std::vector<XMFLOAT4> spheres(lights.size());
+        for (size_t i = 0; i < lights.size(); ++i)
+        {
+            const Light& light = lights[i];
+            const float range = light.Enabled ? ComputeLightRange(light, DefaultLightCutoff) : 0.0f;
+            XMVECTOR center = XMVector3TransformCoord(XMLoadFloat4(&light.Position), view);
+            float radius = range;
+            if (range != FLT_MAX && light.LightType == SpotLight && light.SpotAngle < XM_PIDIV2)
+            {
+                const XMVECTOR direction = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat4(&light.Direction), view));
+                if (light.SpotAngle <= XM_PIDIV4)
+                {
+                    radius = range / (2.0f * std::cos(light.SpotAngle));
+                    center = XMVectorMultiplyAdd(direction, XMVectorReplicate(radius), center);
+                }
+                else
+                {
+                    center = XMVectorMultiplyAdd(direction, XMVectorReplicate(range * std::cos(light.SpotAngle)), center);
+                    radius = range * std::sin(light.SpotAngle);
+                }
+            }
+            XMStoreFloat4(&spheres[i], XMVectorSetW(center, radius));
+        }
+
+        std::vector<ClusterLightBounds> clusterLights(ClusterCount);
+        for (uint32_t z = 0; z < ClusterCountZ; ++z)
+        {
+            const float sliceNear = nearZ * std::pow(farZ / nearZ, static_cast<float>(z) / ClusterCountZ);
+            const float sliceFar = nearZ * std::pow(farZ / nearZ, static_cast<float>(z + 1) / ClusterCountZ);
+            for (uint32_t y = 0; y < ClusterCountY; ++y)
+            {
+                const float top = (1.0f - 2.0f * y / ClusterCountY) * tanHalfFovY;
+                const float bottom = (1.0f - 2.0f * (y + 1) / ClusterCountY) * tanHalfFovY;
+                for (uint32_t x = 0; x < ClusterCountX; ++x)
+                {
+                    const float left = (-1.0f + 2.0f * x / ClusterCountX) * tanHalfFovX;
+                    const float right = (-1.0f + 2.0f * (x + 1) / ClusterCountX) * tanHalfFovX;
+                    const XMFLOAT3 boxMin(std::min(left * sliceNear, left * sliceFar), std::min(bottom * sliceNear, bottom * sliceFar), sliceNear);
+                    const XMFLOAT3 boxMax(std::max(right * sliceNear, right * sliceFar), std::max(top * sliceNear, top * sliceFar), sliceFar);
+
+                    ClusterLightBounds& bounds = clusterLights[x + ClusterCountX * (y + ClusterCountY * z)];
+                    for (size_t i = 0; i < lights.size(); ++i)
+                    {
+                        const XMFLOAT4& sphere = spheres[i];
+                        if (sphere.w <= 0.0f)
+                        {
+                            continue;
+                        }
+                        if (sphere.w == FLT_MAX)
+                        {
+                            bounds.Touching.push_back(static_cast<uint32_t>(i));
+                            bounds.Covering.push_back(static_cast<uint32_t>(i));
+                            continue;
+                        }
+
+                        // The grid derives its cluster bounds from the
+                        // projection matrix, so both tests leave a little
+                        // room for rounding: touching is tested a little
+                        // outside the sphere and covering a little inside.
+                        const float dx = std::max(std::max(boxMin.x - sphere.x, 0.0f), sphere.x - boxMax.x);
+                        const float dy = std::max(std::max(boxMin.y - sphere.y, 0.0f), sphere.y - boxMax.y);
+                        const float dz = std::max(std::max(boxMin.z - sphere.z, 0.0f), sphere.z - boxMax.z);
+                        if (dx * dx + dy * dy + dz * dz > sphere.w * sphere.w * 1.001f)
+                        {
+                            continue;
+                        }
+                        bounds.Touching.push_back(static_cast<uint32_t>(i));
+
+                        const float coveredRadiusSquared = sphere.w * sphere.w * 0.999f;
+                        bool covers = false;
+                        for (int point = 0; point < 27 && !covers; ++point)
+                        {
+                            const float depth = sliceNear + (sliceFar - sliceNear) * 0.5f * (point / 9);
+                            const float px = (left + (right - left) * 0.5f * (point % 3)) * depth - sphere.x;
+                            const float py = (bottom + (top - bottom) * 0.5f * ((point / 3) % 3)) * depth - sphere.y;
+                            const float pz = depth - sphere.z;
+                            covers = px * px + py * py + pz * pz <= coveredRadiusSquared;
+                        }
+                        if (covers)
+                        {
+                            bounds.Covering.push_back(static_cast<uint32_t>(i));
+                        }
+                    }
+                }
+            }
+        }
+        return clusterLights;
+    }
+}
+
+/**
+* Assign lightCount random lights to the cluster grid every frame for
+* frameCount frames, with the camera orbiting the room. A few of the frames
+* are checked against a brute force pass over every light and cluster: each
+* list must be in increasing order, hold only lights touching the cluster's
+* box and every light covering a point of its cell. The time per frame is reported, with g_LightAssignmentBudget for
+* reference; it is not checked, as it depends on the machine.
+* No window or D3D device is created.
+* Returns -1 if a check failed.
+*/
+int RunClusteredLightingBenchmark(int lightCount, int frameCount)
+{
+    const int checkedFrameCount = 4;
+    const float aspectRatio = static_cast<float>(g_ScreenWidth) / g_ScreenHeight;
+    const float fovY = XMConvertToRadians(45.0f);
+    const float nearZ = 0.1f, farZ = 100.0f;
+    const XMMATRIX projectionMatrix = XMMatrixPerspectiveFovLH(fovY, aspectRatio, nearZ, farZ);
+    const float tanHalfFovY = std::tan(0.5f * fovY);
+    const float tanHalfFovX = tanHalfFovY * aspectRatio;
+    int failureCount = 0;
+
+    LightClusterGrid clusters;
+    clusters.SetProjection(projectionMatrix, static_cast<float>(g_ScreenWidth), static_cast<float>(g_ScreenHeight));
+
+    // Mostly point lights, some spot lights and a couple of directional
+    // lights, scattered through and a little beyond the room.
+    std::mt19937 random(4321);
+    std::uniform_real_distribution<float> position(-12.0f, 12.0f);
+    std::uniform_real_distribution<float> height(-2.0f, 22.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_real_distribution<float> axisComponent(-1.0f, 1.0f);
+
+    std::vector<Light> lights(lightCount);
+    for (int i = 0; i < lightCount; ++i)
+    {
+        Light& light = lights[i];
+        light.Enabled = true;
+        light.LightType = (i < 2) ? DirectionalLight : (i % 8 == 0) ? SpotLight : PointLight;
+        light.Position = XMFLOAT4(position(random), height(random), position(random), 1.0f);
+        XMStoreFloat4(&light.Direction, XMVector3Normalize(XMVectorSet(axisComponent(random), axisComponent(random), axisComponent(random), 0.0f)));
+        light.Color = XMFLOAT4(unit(random), unit(random), unit(random), 1.0f);
+        light.SpotAngle = XMConvertToRadians(15.0f + 45.0f * unit(random));
+        light.ConstantAttenuation = 1.0f;
+        light.LinearAttenuation = 0.0f;
+        light.QuadraticAttenuation = 4.0f + 60.0f * unit(random);
+    }
+
+    double totalSeconds = 0.0;
+    double maxSeconds = 0.0;
+    size_t totalIndices = 0;
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        float sinAngle, cosAngle;
+        XMScalarSinCos(&sinAngle, &cosAngle, XM_2PI * frame / frameCount);
+        const XMVECTOR eyePosition = XMVectorSet(18.0f * sinAngle, 10.0f, -18.0f * cosAngle, 1.0f);
+        const XMMATRIX view = XMMatrixLookAtLH(eyePosition, XMVectorSet(0.0f, 10.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+        const auto startTime = std::chrono::high_resolution_clock::now();
+        clusters.AssignLights(view, lights.data(), lights.size());
+        const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+        totalSeconds += seconds;
+        maxSeconds = std::max(maxSeconds, seconds);
+        totalIndices += clusters.GetLightIndices().size();
+
+        if (frame % std::max(frameCount / checkedFrameCount, 1) == 0)
+        {
+            const std::vector<ClusterLightBounds> expected = AssignLightsBruteForce(view, tanHalfFovX, tanHalfFovY,
+                nearZ, farZ, lights);
+            const std::vector<ClusterLightRange>& ranges = clusters.GetClusterRanges();
+            const std::vector<uint32_t>& indices = clusters.GetLightIndices();
+            uint32_t mismatchCount = 0;
+            for (uint32_t cluster = 0; cluster < ClusterCount; ++cluster)
+            {
+                const uint32_t* begin = indices.data() + ranges[cluster].Offset;
+                const uint32_t* end = begin + ranges[cluster].Count;
+                const bool increasing = std::adjacent_find(begin, end, std::greater_equal<uint32_t>()) == end;
+                const ClusterLightBounds& bounds = expected[cluster];
+                const bool matches = increasing
+                    && std::includes(bounds.Touching.begin(), bounds.Touching.end(), begin, end)
+                    && std::includes(begin, end, bounds.Covering.begin(), bounds.Covering.end());
+                mismatchCount += matches ? 0 : 1;
+            }
+            char what[128];
+            snprintf(what, sizeof(what), "frame %d: %u of %u clusters differ from brute force", frame, mismatchCount, ClusterCount);
+            failureCount += !Check("Clustered lighting", mismatchCount == 0, what);
+        }
+    }
+
+    const double averageMilliseconds = totalSeconds * 1000.0 / frameCount;
+    const bool withinBudget = averageMilliseconds <= g_LightAssignmentBudget;
+
+    char message[256];
+    snprintf(message, sizeof(message), "Clustered lighting: %d lights, %u clusters, %.3f ms/frame avg, %.3f ms max, %.1f lights/cluster (%u threads) %s\n",
+        lightCount, ClusterCount, averageMilliseconds, maxSeconds * 1000.0,
+        static_cast<double>(totalIndices) / (static_cast<double>(frameCount) * ClusterCount), GetDefaultThreadCount(),
+        withinBudget ? "within budget" : "over budget");
+    std::cout << message;
+
+    return failureCount == 0 ? 0 : -1;
+}
+
+/**
+* Pack a dense sphere into VertexPacked with each position encoding, unpack
+* it again and report the round trip error, the packing and unpacking
+* throughput and the bytes per vertex.
+* No window or D3D device is created.
+* Returns -1 if any error is larger than the encoding allows.
+*/
+int RunVertexFormatBenchmark()
+{
+    MeshBuildOptions options;
+    options.Optimize = false;
+    options.Color = XMFLOAT3(0.3f, 0.6f, 0.9f);
+    const Mesh mesh = CreateUVSphereMesh(10.0f, 1024, 1024, options);
+    const size_t vertexCount = mesh.Vertices.size();
+
+    std::vector<VertexPacked> packedVertices(vertexCount);
+    std::vector<VertexPosNormColTex> unpackedVertices(vertexCount);
+
+    struct EncodingCase
+    {
+        const char* Name;
+        PositionEncoding Encoding;
+        float PositionTolerance;    // Fraction of the largest mesh extent.
+    };
+
+    // Half the quantization step, plus a little for float rounding.
+    const EncodingCase encodingCases[] =
+    {
+        { "unorm16", PE_Unorm16, 1.5e-5f },
+        { "half", PE_Half, 5.0e-4f },
+    };
+    const float normalTolerance = 0.01f;          // Degrees.
+    const float colorTolerance = 0.5f / 255.0f + 1e-6f;
+    const float texcoordTolerance = 1.0f / 4096.0f;
+
+    char message[256];
+    snprintf(message, sizeof(message), "Vertex formats: %zu vertices, %zu -> %zu bytes per vertex (%.0f%% smaller)\n", vertexCount,
+        sizeof(VertexPosNormColTex), sizeof(VertexPacked), 100.0 * (1.0 - static_cast<double>(sizeof(VertexPacked)) / sizeof(VertexPosNormColTex)));
+    std::cout << message;
+
+    bool withinTolerance = true;
+    for (const EncodingCase& encodingCase : encodingCases)
+    {
+        const VertexQuantization quantization = ComputeVertexQuantization(mesh.Vertices.data(), vertexCount, encodingCase.Encoding);
+
+        const int iterations = 10;
+        auto startTime = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            PackVertices(mesh.Vertices.data(), vertexCount, quantization, encodingCase.Encoding, packedVertices.data());
+        }
+        const double packSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count() / iterations;
+
+        startTime = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            UnpackVertices(packedVertices.data(), vertexCount, quantization, encodingCase.Encoding, unpackedVertices.data());
+        }
+        const double unpackSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count() / iterations;
+
+        const float extent = std::max(std::max(quantization.PositionScale.x, quantization.PositionScale.y), quantization.PositionScale.z) *
+            ((encodingCase.Encoding == PE_Half) ? 2.0f : 1.0f);
+
+        float positionError = 0.0f, normalError = 0.0f, colorError = 0.0f, texcoordError = 0.0f;
+        for (size_t i = 0; i < vertexCount; ++i)
+        {
+            const VertexPosNormColTex& original = mesh.Vertices[i];
+            const VertexPosNormColTex& decoded = unpackedVertices[i];
+
+            const XMVECTOR originalNormal = XMLoadFloat3(&original.Normal);
+            const XMVECTOR decodedNormal = XMLoadFloat3(&decoded.Normal);
+            const float normalAngle = std::atan2(XMVectorGetX(XMVector3Length(XMVector3Cross(originalNormal, decodedNormal))),
+                XMVectorGetX(XMVector3Dot(originalNormal, decodedNormal)));
+
+            positionError = std::max(positionError, XMVectorGetX(XMVector3Length(XMLoadFloat3(&original.Position) - XMLoadFloat3(&decoded.Position))));
+            normalError = std::max(normalError, XMConvertToDegrees(normalAngle));
+            const XMVECTOR colorDifference = XMVectorAbs(XMLoadFloat3(&original.Color) - XMLoadFloat3(&decoded.Color));
+            colorError = std::max(colorError, std::max(std::max(XMVectorGetX(colorDifference), XMVectorGetY(colorDifference)), XMVectorGetZ(colorDifference)));
+            texcoordError = std::max(texcoordError, std::max(std::abs(original.Texture.x - decoded.Texture.x), std::abs(original.Texture.y - decoded.Texture.y)));
+        }
+        positionError /= extent;
+
+        const bool caseWithinTolerance = positionError <= encodingCase.PositionTolerance && normalError <= normalTolerance &&
+            colorError <= colorTolerance && texcoordError <= texcoordTolerance;
+        withinTolerance = withinTolerance && caseWithinTolerance;
+
+        snprintf(message, sizeof(message), "  %-8s pack %.1f Mvertices/s (%.0f MB/s in), unpack %.1f Mvertices/s\n", encodingCase.Name,
+            vertexCount / packSeconds * 1e-6, vertexCount * sizeof(VertexPosNormColTex) / packSeconds * 1e-6, vertexCount / unpackSeconds * 1e-6);
+        std::cout << message;
+
+        snprintf(message, sizeof(message), "  %-8s max error: position %.2e of extent, normal %.4f deg, color %.4f, texcoord %.2e %s\n", "",
+            positionError, normalError, colorError, texcoordError, caseWithinTolerance ? "ok" : "TOO LARGE");
+        std::cout << message;
+    }
+
+    return withinTolerance ? 0 : -1;
+}
+
+/**
+* Record a sorted queue of drawCount draws into command lists on 1 to N
+* threads, one list per thread, and report the time and speedup over one
+* thread. Recording alone is timed, and recording followed by replaying each
+* list on its own recording context, which stands in for the D3D11 calls a
+* deferred context makes. Fails if the lists replayed in order do not issue
+* the same draws as executing the queue directly. No window or D3D device is
+* created.
+*/
+int RunCommandListBenchmark(int drawCount)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const int repeatCount = 20;
+    const float farPlane = 100.0f;
+
+    // Draws with the shader, layout and material mix of RunRenderQueueStats,
+    // every tenth one transparent.
+    RenderQueue queue;
+    queue.Reserve(drawCount);
+    std::mt19937 random(19);
+    for (int i = 0; i < drawCount; ++i)
+    {
+        const bool instanced = (i % 8) == 0;
+        const RenderPass pass = (i % 10) == 9 ? RP_Transparent : RP_Opaque;
+
+        DrawPacket packet;
+        packet.VertexShader = instanced ? VS_Instanced : VS_Simple;
+        packet.PixelShader = (i % 4) == 1 ? PX_Unlit : PX_Simple;
+        packet.InputLayout = instanced ? IL_Instanced : IL_Simple;
+        packet.VertexBuffer = VB_Cube;
+        packet.InstanceBuffer = instanced ? static_cast<uint8_t>(VB_CubeFieldInstances) : NoResource;
+        packet.IndexBuffer = IB_Cube;
+        packet.Material = static_cast<uint16_t>(random() % 16);
+        packet.ObjectConstants = instanced ? NoObjectConstants : static_cast<uint32_t>(i);
+        packet.IndexCount = 36;
+        packet.StartIndex = 0;
+        packet.BaseVertex = 0;
+        packet.InstanceCount = 1;
+        packet.StartInstance = instanced ? static_cast<uint32_t>(i) : 0;
+        packet.SortKey = MakeSortKey(pass, packet.VertexShader, packet.PixelShader, packet.InputLayout, packet.Material,
+            QuantizeDepth(pass, static_cast<float>(random() % 10000) * 0.01f, farPlane));
+        queue.Submit(packet);
+    }
+    queue.Sort();
+
+    // The draws as a single context sees them.
+    RecordingRenderContext expected;
+    RenderStateCache expectedCache;
+    for (int pass = 0; pass < NumRenderPasses; ++pass)
+    {
+        queue.Execute(expected, expectedCache, static_cast<RenderPass>(pass));
+    }
+
+    auto getDraws = [](const RecordingRenderContext& context)
+    {
+        std::vector<RecordingRenderContext::Command> draws;
+        for (const RecordingRenderContext::Command& command : context.GetCommands())
+        {
+            if (command.Type == RecordingRenderContext::CMD_DrawIndexedInstanced)
+            {
+                draws.push_back(command);
+            }
+        }
+        return draws;
+    };
+    const std::vector<RecordingRenderContext::Command> expectedDraws = getDraws(expected);
+
+    char message[256];
+    snprintf(message, sizeof(message), "Command lists: %d draws, %zu state changes on one context\n",
+        drawCount, expected.GetStateChangeCount());
+    std::cout << message;
+
+    snprintf(message, sizeof(message), "  %-8s %12s %8s %16s %8s %10s %12s\n", "threads", "record ms", "speedup", "record+replay ms", "speedup", "bytes", "state changes");
+    std::cout << message;
+
+    const unsigned int maxThreadCount = GetDefaultThreadCount();
+    double baseRecordSeconds = 0.0;
+    double baseReplaySeconds = 0.0;
+    bool passed = true;
+    for (unsigned int threadCount = 1; ; threadCount = std::min(threadCount * 2, maxThreadCount))
+    {
+        std::vector<CommandList> lists(threadCount);
+        std::vector<RecordingRenderContext> contexts(threadCount);
+
+        double recordSeconds = 0.0;
+        double replaySeconds = 0.0;
+        for (int repeat = 0; repeat < repeatCount; ++repeat)
+        {
+            auto start = Clock::now();
+            for (int pass = 0; pass < NumRenderPasses; ++pass)
+            {
+                RecordCommandLists(queue, static_cast<RenderPass>(pass), lists.data(), lists.size(), threadCount);
+            }
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            recordSeconds = (repeat == 0) ? seconds : std::min(recordSeconds, seconds);
+
+            // Record and replay on the same worker, as D3D11DeferredContexts
+            // does after RecordCommandLists.
+            start = Clock::now();
+            for (int pass = 0; pass < NumRenderPasses; ++pass)
+            {
+                RecordCommandLists(queue, static_cast<RenderPass>(pass), lists.data(), lists.size(), threadCount);
+                ParallelFor(lists.size(), 1, [&](size_t begin, size_t end)
+                {
+                    for (size_t list = begin; list < end; ++list)
+                    {
+                        contexts[list].Clear();
+                        lists[list].Replay(contexts[list]);
+                    }
+                }, threadCount);
+            }
+            const double replay = std::chrono::duration<double>(Clock::now() - start).count();
+            replaySeconds = (repeat == 0) ? replay : std::min(replaySeconds, replay);
+        }
+
+        // Replay every pass's lists in order and compare the draws.
+        RecordingRenderContext replayed;
+        size_t byteCount = 0;
+        for (int pass = 0; pass < NumRenderPasses; ++pass)
+        {
+            RecordCommandLists(queue, static_cast<RenderPass>(pass), lists.data(), lists.size(), threadCount);
+            for (const CommandList& list : lists)
+            {
+                list.Replay(replayed);
+                byteCount += list.GetSize();
+            }
+        }
+        const std::vector<RecordingRenderContext::Command> replayedDraws = getDraws(replayed);
+        const bool matches = replayedDraws.size() == expectedDraws.size() &&
+            std::equal(replayedDraws.begin(), replayedDraws.end(), expectedDraws.begin(),
+                [](const RecordingRenderContext::Command& a, const RecordingRenderContext::Command& b)
+                {
+                    return std::equal(std::begin(a.Arguments), std::end(a.Arguments), std::begin(b.Arguments));
+                });
+        passed = passed && matches;
+
+        if (threadCount == 1)
+        {
+            baseRecordSeconds = recordSeconds;
+            baseReplaySeconds = replaySeconds;
+        }
+        snprintf(message, sizeof(message), "  %-8u %12.3f %7.2fx %16.3f %7.2fx %10zu %12zu%s\n", threadCount,
+            recordSeconds * 1000.0, baseRecordSeconds / recordSeconds, replaySeconds * 1000.0, baseReplaySeconds / replaySeconds,
+            byteCount, replayed.GetStateChangeCount(), matches ? "" : "  MISMATCH");
+        std::cout << message;
+
+        if (threadCount == maxThreadCount)
+        {
+            break;
+        }
+    }
+    return passed ? 0 : -1;
+}
+
+/**
+* Check the camera's derived values: frustum planes against
+* ExtractFrustumPlanes and the corners, depth in both depth modes, the
+* inverse view-projection round trip, jitter and cache invalidation. Report
+* the depth resolution of both modes. Then time the per-frame camera work for
+* 1 and 64 cameras, as for shadow and reflection views, moving every frame,
+* standing still, and rebuilt on every query as before the cache.
+* No window or D3D device is created.
+*/
+int RunCameraBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    char message[256];
+    int failureCount = 0;
+    auto nearlyEqual = [](float a, float b, float tolerance)
+    {
+        return std::abs(a - b) <= tolerance * std::max(1.0f, std::abs(b));
+    };
+
+    const float width = static_cast<float>(g_ScreenWidth);
+    const float height = static_cast<float>(g_ScreenHeight);
+    CameraProjection projection;
+    projection.AspectRatio = width / height;
+    CameraProjection reversedProjection = projection;
+    reversedProjection.Depth = DM_ReversedInfinite;
+
+    Camera camera;
+    camera.Rotate(XMVectorSet(0, 1, 0, 0), 30.0f);
+    camera.Rotate(XMVectorSet(1, 0, 0, 0), 15.0f);
+    camera.SetProjection(projection);
+
+    // World position at the given view space point.
+    auto viewToWorld = [](const Camera& camera, float x, float y, float z)
+    {
+        return XMVector3TransformCoord(XMVectorSet(x, y, z, 1.0f), XMMatrixInverse(nullptr, camera.GetViewMatrix()));
+    };
+    auto depthAt = [&](const Camera& camera, float viewDepth)
+    {
+        const XMVECTOR clip = XMVector4Transform(XMVectorSetW(viewToWorld(camera, 0.0f, 0.0f, viewDepth), 1.0f), camera.GetViewProjectionMatrix());
+        return XMVectorGetZ(clip) / XMVectorGetW(clip);
+    };
+
+    {// Planes: the same as ExtractFrustumPlanes gives, in both depth modes.
+        Frustum expected;
+        ExtractFrustumPlanes(camera.GetViewMatrix() * XMMatrixPerspectiveFovLH(XMConvertToRadians(projection.FieldOfViewY),
+            projection.AspectRatio, projection.NearZ, projection.FarZ), expected);
+        Camera reversed = camera;
+        reversed.SetProjection(reversedProjection);
+
+        bool equal = true;
+        for (int plane = 0; plane < 6; ++plane)
+        {
+            const float* a = &camera.GetFrustum().Planes[plane].x;
+            const float* b = &reversed.GetFrustum().Planes[plane].x;
+            const float* c = &expected.Planes[plane].x;
+            for (int i = 0; i < 4; ++i)
+            {
+                equal = equal && nearlyEqual(a[i], c[i], 1e-4f) && nearlyEqual(b[i], c[i], 1e-4f);
+            }
+        }
+        failureCount += !Check("Camera", equal, "frustum planes");
+    }
+
+    {// Corners: each on its three planes and inside the other three.
+        const Frustum& frustum = camera.GetFrustum();
+        const XMFLOAT3* corners = camera.GetFrustumCorners();
+        bool onPlanes = true;
+        for (int i = 0; i < 8; ++i)
+        {
+            const int cornerPlanes[3] = { (i & 1) ? 1 : 0, (i & 2) ? 3 : 2, (i & 4) ? 5 : 4 };
+            for (int plane = 0; plane < 6; ++plane)
+            {
+                const float distance = XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&frustum.Planes[plane]), XMLoadFloat3(&corners[i])));
+                const bool onPlane = plane == cornerPlanes[0] || plane == cornerPlanes[1] || plane == cornerPlanes[2];
+                onPlanes = onPlanes && (onPlane ? std::abs(distance) < 1e-3f : distance > -1e-3f);
+            }
+            const float viewDepth = XMVectorGetZ(XMVector3TransformCoord(XMLoadFloat3(&corners[i]), camera.GetViewMatrix()));
+            onPlanes = onPlanes && nearlyEqual(viewDepth, (i & 4) ? projection.FarZ : projection.NearZ, 1e-4f);
+        }
+        failureCount += !Check("Camera", onPlanes, "frustum corners");
+
+        // A point past FarZ or behind the camera is outside.
+        const XMVECTOR beyond = viewToWorld(camera, 0.0f, 0.0f, projection.FarZ * 1.01f);
+        const XMVECTOR behind = viewToWorld(camera, 0.0f, 0.0f, -1.0f);
+        failureCount += !Check("Camera", XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&frustum.Planes[5]), beyond)) < 0.0f &&
+            XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&frustum.Planes[4]), behind)) < 0.0f, "near and far planes");
+    }
+
+    {// Depth: 0 to 1 in standard mode; 1 at the near plane falling towards 0 without reaching it when reversed.
+        failureCount += !Check("Camera", nearlyEqual(depthAt(camera, projection.NearZ), 0.0f, 1e-4f) && nearlyEqual(depthAt(camera, projection.FarZ), 1.0f, 1e-4f),
+            "standard depth range");
+
+        Camera reversed = camera;
+        reversed.SetProjection(reversedProjection);
+        bool decreasing = nearlyEqual(depthAt(reversed, projection.NearZ), 1.0f, 1e-4f);
+        float previous = 1.0f;
+        for (float viewDepth = 1.0f; viewDepth < 1e7f; viewDepth *= 10.0f)
+        {
+            const float depth = depthAt(reversed, viewDepth);
+            decreasing = decreasing && depth < previous && depth > 0.0f && nearlyEqual(depth, projection.NearZ / viewDepth, 1e-4f);
+            previous = depth;
+        }
+        failureCount += !Check("Camera", decreasing, "reversed infinite depth");
+    }
+
+    {// Clip space back to world space through the inverse.
+        std::mt19937 random(21);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> depth(projection.NearZ * 2.0f, projection.FarZ * 0.9f);
+        bool roundTrips = true;
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            Camera modeCamera = camera;
+            modeCamera.SetProjection(mode == 0 ? projection : reversedProjection);
+            for (int i = 0; i < 1000; ++i)
+            {
+                const float z = depth(random);
+                const XMVECTOR world = XMVectorSetW(viewToWorld(modeCamera, unit(random) * z * 0.4f, unit(random) * z * 0.4f, z), 1.0f);
+                const XMVECTOR clip = XMVector4Transform(world, modeCamera.GetViewProjectionMatrix());
+                const XMVECTOR back = XMVector4Transform(clip, modeCamera.GetInverseViewProjectionMatrix());
+                const XMVECTOR error = XMVectorSubtract(XMVectorDivide(back, XMVectorSplatW(back)), world);
+                roundTrips = roundTrips && XMVectorGetX(XMVector3Length(error)) < 1e-3f * z;
+            }
+        }
+        failureCount += !Check("Camera", roundTrips, "inverse view-projection");
+    }
+
+    {// Jitter moves the image by the offset in pixels, and the sequence covers the pixel.
+        const XMVECTOR world = XMVectorSetW(viewToWorld(camera, 1.0f, -2.0f, 20.0f), 1.0f);
+        auto toScreen = [&](const Camera& jittered)
+        {
+            const XMVECTOR clip = XMVector4Transform(world, jittered.GetViewProjectionMatrix());
+            const float w = XMVectorGetW(clip);
+            return XMFLOAT2((XMVectorGetX(clip) / w + 1.0f) * 0.5f * width, (1.0f - XMVectorGetY(clip) / w) * 0.5f * height);
+        };
+        const XMFLOAT2 unjittered = toScreen(camera);
+        bool shifted = true;
+        float meanX = 0.0f;
+        float meanY = 0.0f;
+        for (uint64_t frame = 0; frame < 16; ++frame)
+        {
+            const XMFLOAT2 offset = GetJitterOffset(frame);
+            Camera jittered = camera;
+            jittered.SetJitter(offset, width, height);
+            const XMFLOAT2 screen = toScreen(jittered);
+            shifted = shifted && std::abs(screen.x - unjittered.x - offset.x) < 1e-2f && std::abs(screen.y - unjittered.y - offset.y) < 1e-2f
+                && offset.x >= -0.5f && offset.x < 0.5f && offset.y >= -0.5f && offset.y < 0.5f;
+            for (uint64_t other = 0; other < frame; ++other)
+            {
+                shifted = shifted && (GetJitterOffset(other).x != offset.x || GetJitterOffset(other).y != offset.y);
+            }
+            meanX += offset.x / 16.0f;
+            meanY += offset.y / 16.0f;
+        }
+        failureCount += !Check("Camera", shifted && std::abs(meanX) < 0.05f && std::abs(meanY) < 0.05f, "jitter");
+    }
+
+    {// Every change invalidates the cache; interpolation rebuilds.
+        const XMMATRIX before = camera.GetViewProjectionMatrix();
+        const XMVECTOR position = camera.GetPositionVector();
+        camera.Translate(XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f));
+        const bool moved = !XMVector4NearEqual(camera.GetViewProjectionMatrix().r[3], before.r[3], XMVectorReplicate(1e-5f));
+        camera.SetPosition(position);
+        const bool restored = XMVector4NearEqual(camera.GetViewProjectionMatrix().r[3], before.r[3], XMVectorReplicate(1e-5f));
+
+        Camera from = camera;
+        from.Translate(XMVectorSet(0.0f, 0.0f, -4.0f, 0.0f));
+        from.GetFrustum();
+        const Camera middle = Camera::Interpolate(from, camera, 0.5f);
+        const bool interpolated = nearlyEqual(middle.GetFrustumCorners()[0].z, 0.5f * (from.GetFrustumCorners()[0].z + camera.GetFrustumCorners()[0].z), 1e-4f);
+        failureCount += !Check("Camera", moved && restored && interpolated, "cache invalidation");
+    }
+
+    {// World-space depth resolution: the smallest distance change the depth buffer records.
+        Camera reversed = camera;
+        reversed.SetProjection(reversedProjection);
+        const float distances[4] = { 10.0f, 50.0f, 100.0f, 1000.0f };
+        snprintf(message, sizeof(message), "Camera depth resolution: %10s %18s %18s\n", "distance", "D24 standard mm", "D32F reversed mm");
+        std::cout << message;
+        for (float distance : distances)
+        {
+            // Standard: depth = f / (f - n) - n f / ((f - n) z) in 2^24 steps.
+            // Reversed: depth = n / z at float precision.
+            const float n = projection.NearZ;
+            const float f = projection.FarZ;
+            const double standardSlope = double(n) * f / ((double(f) - n) * distance * distance);
+            const double standard = (distance <= f) ? (1.0 / (1 << 24)) / standardSlope : 0.0;
+            const float reversedDepth = depthAt(reversed, distance);
+            const double reversedStep = (reversedDepth - std::nextafter(reversedDepth, 0.0f)) / (double(n) / (double(distance) * distance));
+            if (standard > 0.0)
+            {
+                snprintf(message, sizeof(message), "                         %10.0f %18.3f %18.3f\n", distance, standard * 1000.0, reversedStep * 1000.0);
+            }
+            else
+            {
+                snprintf(message, sizeof(message), "                         %10.0f %18s %18.3f\n", distance, "clipped", reversedStep * 1000.0);
+            }
+            std::cout << message;
+        }
+    }
+
+    {// Per-frame camera cost.
+        const int frameCount = 2000;
+        const unsigned int cameraCounts[2] = { 1, 64 };
+        volatile float sink = 0.0f;
+        snprintf(message, sizeof(message), "Camera frames: %8s %14s %14s %14s\n", "cameras", "moving us", "still us", "uncached us");
+        std::cout << message;
+        for (unsigned int cameraCount : cameraCounts)
+        {
+            std::vector<Camera> cameras(cameraCount);
+            for (unsigned int i = 0; i < cameraCount; ++i)
+            {
+                cameras[i].Rotate(XMVectorSet(0, 1, 0, 0), 360.0f * i / cameraCount);
+                cameras[i].SetProjection(projection);
+            }
+            const XMVECTOR step = XMVectorSet(0.0f, 0.0f, 0.001f, 0.0f);
+
+            // What a frame reads: the view-projection for the constants and
+            // the planes for culling.
+            auto timeFrames = [&](const std::function<void(Camera&)>& frame)
+            {
+                const auto start = Clock::now();
+                for (int i = 0; i < frameCount; ++i)
+                {
+                    for (Camera& view : cameras)
+                    {
+                        frame(view);
+                    }
+                }
+                return std::chrono::duration<double>(Clock::now() - start).count() * 1e6 / frameCount;
+            };
+            const double moving = timeFrames([&](Camera& view)
+            {
+                view.TranslateLocal(step);
+                sink = sink + XMVectorGetX(view.GetViewProjectionMatrix().r[0]) + view.GetFrustum().Planes[0].w;
+            });
+            const double still = timeFrames([&](Camera& view)
+            {
+                sink = sink + XMVectorGetX(view.GetViewProjectionMatrix().r[0]) + view.GetFrustum().Planes[0].w;
+            });
+            // The work PrepareFrame did per frame before the cache: the
+            // forward vector once for the eye and once for the view matrix.
+            const XMMATRIX projectionMatrix = XMMatrixPerspectiveFovLH(XMConvertToRadians(projection.FieldOfViewY),
+                projection.AspectRatio, projection.NearZ, projection.FarZ);
+            const double uncached = timeFrames([&](Camera& view)
+            {
+                const XMVECTOR worldFwdVector = XMVectorSet(0, 0, 1, 0);
+                const XMVECTOR eye = XMQuaternionMultiply(view.GetOrientation(), worldFwdVector);
+                const XMVECTOR forward = XMQuaternionMultiply(view.GetOrientation(), worldFwdVector);
+                const XMMATRIX viewMatrix = XMMatrixLookAtLH(view.GetPositionVector(), view.GetPositionVector() + XMVectorScale(forward, 2.0f), XMVectorSet(0, 1, 0, 0));
+                const XMMATRIX viewProjection = viewMatrix * projectionMatrix;
+                Frustum frustum;
+                ExtractFrustumPlanes(viewProjection, frustum);
+                sink = sink + XMVectorGetX(viewProjection.r[0]) + frustum.Planes[0].w + XMVectorGetX(eye);
+            });
+
+            snprintf(message, sizeof(message), "               %8u %14.3f %14.3f %14.3f\n", cameraCount, moving, still, uncached);
+            std::cout << message;
+        }
+    }
+
+    return failureCount == 0 ? 0 : -1;
+}
+
+/**
+* Select levels of detail for instanceCount instances of the light gizmo's
+* chain headless, time the batched pass and check its lists, its agreement
+* with SelectLod, and that hysteresis stops instances near a switch distance
+* from flipping while the camera sways. No window or D3D device is created.
+*/
+int RunLodBenchmark(int instanceCount)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const int frameCount = 30;
+    char message[256];
+    int failureCount = 0;
+
+    CreateLightMesh(1.0f);
+    const LodChain chain = g_LightLodChain;
+    g_LightMesh = Mesh();
+
+    CameraProjection projection;
+    projection.AspectRatio = static_cast<float>(g_ScreenWidth) / g_ScreenHeight;
+    Camera camera;
+    camera.SetProjection(projection);
+    const float lodScale = ComputeLodScale(camera.GetProjectionMatrix(), static_cast<float>(g_ScreenHeight));
+
+    // Instances of radius 0.5 to 3 spread over 600 m square, far enough for
+    // every level to show up.
+    InstanceBoundsSoA bounds;
+    bounds.Resize(instanceCount);
+    std::mt19937 random(22);
+    std::uniform_real_distribution<float> ground(-300.0f, 300.0f);
+    std::uniform_real_distribution<float> height(0.0f, 50.0f);
+    std::uniform_real_distribution<float> radius(0.5f, 3.0f);
+    for (int i = 0; i < instanceCount; ++i)
+    {
+        bounds.CenterX[i] = ground(random);
+        bounds.CenterY[i] = height(random);
+        bounds.CenterZ[i] = ground(random);
+        bounds.Radius[i] = radius(random);
+        bounds.ExtentX[i] = bounds.ExtentY[i] = bounds.ExtentZ[i] = bounds.Radius[i] * 0.57735f;
+    }
+    auto eyeAt = [](int frame)
+    {
+        return XMVectorSet(-200.0f + 10.0f * frame, 10.0f, 5.0f * frame, 1.0f);
+    };
+
+    // The level lists partition the instances, ascending within each level.
+    auto listsValid = [&](const LodSelector& selector)
+    {
+        bool valid = selector.GetLevelStart(0) == 0 && selector.GetLevelStart(MaxLodCount) == static_cast<uint32_t>(instanceCount);
+        for (uint32_t level = 0; level < MaxLodCount && valid; ++level)
+        {
+            const uint32_t* instances = selector.GetInstances() + selector.GetLevelStart(level);
+            for (uint32_t i = 0; i < selector.GetLevelInstanceCount(level); ++i)
+            {
+                valid = valid && selector.GetLevel(instances[i]) == level && (i == 0 || instances[i - 1] < instances[i]);
+            }
+            valid = valid && (level < chain.LevelCount || selector.GetLevelInstanceCount(level) == 0);
+        }
+        return valid;
+    };
+
+    {// Timing, and the same result on any number of threads.
+        snprintf(message, sizeof(message), "LOD selection: %d instances, %u levels, %d frames\n", instanceCount, chain.LevelCount, frameCount);
+        std::cout << message;
+        snprintf(message, sizeof(message), "  %-8s %10s %12s %10s %10s %10s %10s\n", "threads", "ms/frame", "ns/instance", "level 0", "level 1", "level 2", "level 3");
+        std::cout << message;
+
+        std::vector<uint8_t> singleThreadLevels;
+        std::vector<uint32_t> singleThreadInstances;
+        const unsigned int threadCounts[2] = { 1, GetDefaultThreadCount() };
+        for (unsigned int threadCount : threadCounts)
+        {
+            LodSelector selector;
+            double seconds = 0.0;
+            for (int frame = 0; frame < frameCount; ++frame)
+            {
+                const auto start = Clock::now();
+                selector.Select(chain, g_LodSettings, lodScale, eyeAt(frame), bounds, threadCount);
+                seconds += std::chrono::duration<double>(Clock::now() - start).count();
+            }
+            failureCount += !Check("LOD", listsValid(selector), "level lists");
+
+            std::vector<uint8_t> levels(instanceCount);
+            for (int i = 0; i < instanceCount; ++i)
+            {
+                levels[i] = static_cast<uint8_t>(selector.GetLevel(i));
+            }
+            std::vector<uint32_t> instances(selector.GetInstances(), selector.GetInstances() + instanceCount);
+            if (threadCount == 1)
+            {
+                singleThreadLevels = levels;
+                singleThreadInstances = instances;
+            }
+            else
+            {
+                failureCount += !Check("LOD", levels == singleThreadLevels && instances == singleThreadInstances, "thread count independence");
+            }
+
+            snprintf(message, sizeof(message), "  %-8u %10.3f %12.2f %10u %10u %10u %10u\n", threadCount,
+                seconds * 1000.0 / frameCount, seconds * 1e9 / (static_cast<double>(frameCount) * instanceCount),
+                selector.GetLevelInstanceCount(0), selector.GetLevelInstanceCount(1), selector.GetLevelInstanceCount(2), selector.GetLevelInstanceCount(3));
+            std::cout << message;
+        }
+    }
+
+    {// The batched pass agrees with SelectLod, lane for lane.
+        LodSelector selector;
+        std::vector<uint32_t> previous(instanceCount, 0);
+        bool agrees = true;
+        for (int frame = 0; frame < 4; ++frame)
+        {
+            const XMVECTOR eye = eyeAt(frame * 8);
+            selector.Select(chain, g_LodSettings, lodScale, eye, bounds);
+            XMFLOAT3 eyePosition;
+            XMStoreFloat3(&eyePosition, eye);
+            for (int i = 0; i < instanceCount; ++i)
+            {
+                const XMFLOAT3 center(bounds.CenterX[i], bounds.CenterY[i], bounds.CenterZ[i]);
+                const uint32_t expected = SelectLod(chain, g_LodSettings, lodScale, eyePosition, center, bounds.Radius[i], previous[i]);
+                agrees = agrees && selector.GetLevel(i) == expected;
+                previous[i] = selector.GetLevel(i);
+            }
+        }
+        failureCount += !Check("LOD", agrees, "batched and scalar selection");
+    }
+
+    {// Sway the eye by 5 cm. With hysteresis the levels settle after one
+        // swing either way; without, instances on a switch distance flip.
+        const int swayFrames = 16;
+        uint32_t flips[2] = { 0, 0 };
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            LodSettings settings = g_LodSettings;
+            settings.Hysteresis = pass == 0 ? g_LodSettings.Hysteresis : 0.0f;
+            LodSelector selector;
+            const XMVECTOR eye = eyeAt(0);
+            selector.Select(chain, settings, lodScale, eye, bounds);
+
+            std::vector<uint8_t> levels(instanceCount);
+            for (int frame = 0; frame < swayFrames; ++frame)
+            {
+                const XMVECTOR offset = XMVectorSet((frame & 1) ? -0.05f : 0.05f, 0.0f, 0.0f, 0.0f);
+                selector.Select(chain, settings, lodScale, eye + offset, bounds);
+                for (int i = 0; i < instanceCount; ++i)
+                {
+                    const uint8_t level = static_cast<uint8_t>(selector.GetLevel(i));
+                    flips[pass] += (frame >= 2 && level != levels[i]) ? 1 : 0;
+                    levels[i] = level;
+                }
+            }
+        }
+        failureCount += !Check("LOD", flips[0] == 0, "hysteresis");
+        failureCount += !Check("LOD", flips[1] > 0, "sway reaches a switch distance");
+
+        snprintf(message, sizeof(message), "  Level changes while swaying 5 cm for %d frames: %u with %.0f%% hysteresis, %u without\n",
+            swayFrames - 2, flips[0], g_LodSettings.Hysteresis * 100.0f, flips[1]);
+        std::cout << message;
+    }
+
+    return failureCount == 0 ? 0 : -1;
+}
+
+/**
+* Check the software occlusion buffer headless: the rasterizer against a
+* double precision reference, the hierarchical box test against a brute force
+* test of every pixel, and the room's walls hiding and revealing boxes from
+* outside and inside with standard and reversed-Z projections. Then time
+* rasterizing the walls, many small occluders, and box tests on 1 to N
+* threads. No window or D3D device is created.
+*/
+int RunOcclusionBenchmark(int boxCount)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    // The app's occlusion buffer size.
+    const uint32_t width = 320;
+    const uint32_t height = 180;
+    char message[256];
+    int failureCount = 0;
+
+    OcclusionBuffer occlusion;
+    failureCount += !Check("Occlusion", !occlusion.Create(width + 2, height), "width not a multiple of four is refused");
+    failureCount += !Check("Occlusion", occlusion.Create(width, height), "create");
+
+    CameraProjection projection;
+    projection.AspectRatio = static_cast<float>(width) / height;
+    Camera camera;
+    camera.SetProjection(projection);
+
+    PlaneInstanceData walls[g_NumPlaneInstances];
+    CreatePlaneInstances(walls);
+
+    std::mt19937 random(23);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    {// Single triangles in front of the camera against a per-pixel reference.
+        // Pixel centres within a hundredth of a pixel of an edge may go
+        // either way and are skipped.
+        camera.SetPosition(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+        const XMMATRIX viewProjection = camera.GetViewProjectionMatrix();
+        const uint16_t indices[3] = { 0, 1, 2 };
+        uint32_t mismatchCount = 0, pixelCount = 0;
+        for (int triangle = 0; triangle < 500; ++triangle)
+        {
+            VertexPosNormColTex vertices[3] = {};
+            double X[3], Y[3], Z[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                const float z = 1.0f + 49.0f * unit(random);
+                vertices[i].Position = XMFLOAT3((unit(random) * 2.4f - 1.2f) * z, (unit(random) * 1.4f - 0.7f) * z, z);
+                XMFLOAT4 clip;
+                XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&vertices[i].Position), viewProjection));
+                X[i] = (clip.x / static_cast<double>(clip.w) * 0.5 + 0.5) * width;
+                Y[i] = (-clip.y / static_cast<double>(clip.w) * 0.5 + 0.5) * height;
+                Z[i] = 1.0 / clip.w;
+            }
+            occlusion.Begin(viewProjection, projection.NearZ);
+            occlusion.RasterizeOccluder(vertices, indices, 3, XMMatrixIdentity());
+
+            const double area = (X[1] - X[0]) * (Y[2] - Y[0]) - (X[2] - X[0]) * (Y[1] - Y[0]);
+            if (std::fabs(area) < 1e-6)
+            {
+                continue;
+            }
+            const float* depth = occlusion.GetNearestDepths(0);
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    // Signed pixel distances to the edges, positive inside,
+                    // and the barycentric weights.
+                    const double px = x + 0.5, py = y + 0.5;
+                    double distance = DBL_MAX, weights[3];
+                    for (int e = 0; e < 3; ++e)
+                    {
+                        const int a = (e + 1) % 3, b = (e + 2) % 3;
+                        const double edge = ((X[b] - X[a]) * (py - Y[a]) - (Y[b] - Y[a]) * (px - X[a])) / area;
+                        weights[e] = edge;
+                        const double length = std::sqrt((X[b] - X[a]) * (X[b] - X[a]) + (Y[b] - Y[a]) * (Y[b] - Y[a]));
+                        distance = std::min(distance, edge * std::fabs(area) / length);
+                    }
+                    if (std::fabs(distance) < 0.01)
+                    {
+                        continue;
+                    }
+                    const float stored = depth[y * width + x];
+                    if (distance > 0.0)
+                    {
+                        const double expected = weights[0] * Z[0] + weights[1] * Z[1] + weights[2] * Z[2];
+                        mismatchCount += std::fabs(stored - expected) > 1e-4 * std::max({ Z[0], Z[1], Z[2] }) ? 1 : 0;
+                        ++pixelCount;
+                    }
+                    else
+                    {
+                        mismatchCount += stored != 0.0f ? 1 : 0;
+                    }
+                }
+            }
+        }
+        failureCount += !Check("Occlusion", pixelCount > 0 && mismatchCount == 0, "rasterizer matches the reference");
+        snprintf(message, sizeof(message), "Occlusion buffer %ux%u, %u levels: rasterizer %u covered pixels checked, %u mismatches\n",
+            width, height, occlusion.GetLevelCount(), pixelCount, mismatchCount);
+        std::cout << message;
+    }
+
+    // The hierarchy must give exactly the answer of testing the box's nearest
+    // depth against every pixel its rectangle overlaps.
+    auto bruteForceVisible = [&](const XMFLOAT3& center, const XMFLOAT3& extents)
+    {
+        OcclusionRect rect;
+        const OcclusionRectResult result = occlusion.ProjectBox(center, extents, rect);
+        if (result != ORR_OnScreen)
+        {
+            return result == ORR_CrossesNear;
+        }
+        const float* depth = occlusion.GetNearestDepths(0);
+        for (int y = rect.MinY; y <= rect.MaxY; ++y)
+        {
+            for (int x = rect.MinX; x <= rect.MaxX; ++x)
+            {
+                if (rect.NearestDepth >= depth[y * width + x])
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    // Random boxes within [minimum, maximum] on every axis; the box test
+    // must agree with brute force and with expectVisible (-1 for don't care)
+    // for every box that is on screen. Returns the share that agreed.
+    auto testBoxes = [&](const XMFLOAT3& minimum, const XMFLOAT3& maximum, int expectVisible, int count, uint32_t& disagreeCount)
+    {
+        std::uniform_real_distribution<float> size(0.1f, 1.0f);
+        int onScreenCount = 0, agreeCount = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            const XMFLOAT3 extents(size(random), size(random), size(random));
+            const XMFLOAT3 center(
+                minimum.x + extents.x + (maximum.x - minimum.x - 2.0f * extents.x) * unit(random),
+                minimum.y + extents.y + (maximum.y - minimum.y - 2.0f * extents.y) * unit(random),
+                minimum.z + extents.z + (maximum.z - minimum.z - 2.0f * extents.z) * unit(random));
+            const bool visible = occlusion.IsBoxVisible(center, extents);
+            disagreeCount += visible != bruteForceVisible(center, extents) ? 1 : 0;
+
+            OcclusionRect rect;
+            if (occlusion.ProjectBox(center, extents, rect) != ORR_OffScreen)
+            {
+                ++onScreenCount;
+                agreeCount += (expectVisible < 0 || visible == (expectVisible != 0)) ? 1 : 0;
+            }
+        }
+        return onScreenCount > 0 ? static_cast<double>(agreeCount) / onScreenCount : 0.0;
+    };
+
+    {// The room from outside the front wall and from inside, with both
+        // depth mappings. Walls span x and z from -10 to 10, y from 0 to 20.
+        snprintf(message, sizeof(message), "  %-18s %-10s %14s %14s\n", "depth", "camera", "hidden/total", "shown/total");
+        std::cout << message;
+
+        const int count = boxCount / 10;
+        uint32_t disagreeCount = 0;
+        const DepthMode depthModes[2] = { DM_Standard, DM_ReversedInfinite };
+        for (DepthMode depthMode : depthModes)
+        {
+            projection.Depth = depthMode;
+            camera.SetProjection(projection);
+            for (int inside = 0; inside < 2; ++inside)
+            {
+                camera.SetPosition(inside ? XMVectorSet(0.0f, 10.0f, 0.0f, 1.0f) : XMVectorSet(0.0f, 10.0f, -30.0f, 1.0f));
+                occlusion.Begin(camera.GetViewProjectionMatrix(), projection.NearZ);
+                occlusion.RasterizeOccluders(g_PlaneVerts, g_PlaneIndex, g_NumPlaneIndices, walls, g_NumPlaneInstances);
+                occlusion.BuildHierarchy();
+
+                double hidden, shown;
+                if (!inside)
+                {
+                    // Everything in the room is behind the front wall; boxes
+                    // between the camera and the wall are not.
+                    hidden = testBoxes(XMFLOAT3(-9.0f, 1.0f, -9.0f), XMFLOAT3(9.0f, 19.0f, 9.0f), 0, count, disagreeCount);
+                    shown = testBoxes(XMFLOAT3(-10.0f, 0.0f, -28.0f), XMFLOAT3(10.0f, 20.0f, -11.0f), 1, count, disagreeCount);
+                }
+                else
+                {
+                    // Past the far wall is hidden, anywhere inside is not.
+                    hidden = testBoxes(XMFLOAT3(-60.0f, -30.0f, 11.0f), XMFLOAT3(60.0f, 50.0f, 60.0f), 0, count, disagreeCount);
+                    shown = testBoxes(XMFLOAT3(-9.5f, 0.5f, -9.5f), XMFLOAT3(9.5f, 19.5f, 9.5f), 1, count, disagreeCount);
+                }
+                failureCount += !Check("Occlusion", hidden == 1.0, "boxes behind the walls are hidden");
+                failureCount += !Check("Occlusion", shown == 1.0, "boxes in front of the walls are shown");
+
+                snprintf(message, sizeof(message), "  %-18s %-10s %13.3f%% %13.3f%%\n", depthMode == DM_Standard ? "standard" : "reversed infinite",
+                    inside ? "inside" : "outside", hidden * 100.0, shown * 100.0);
+                std::cout << message;
+            }
+        }
+        failureCount += !Check("Occlusion", disagreeCount == 0, "hierarchical and brute force box tests agree");
+
+        // Random boxes anywhere, including across the near plane.
+        testBoxes(XMFLOAT3(-40.0f, -20.0f, -40.0f), XMFLOAT3(40.0f, 40.0f, 40.0f), -1, count, disagreeCount);
+        failureCount += !Check("Occlusion", disagreeCount == 0, "hierarchical and brute force box tests agree anywhere");
+        projection.Depth = DM_Standard;
+        camera.SetProjection(projection);
+    }
+
+    {// Timings, from outside the front wall.
+        const int frameCount = 100;
+        camera.SetPosition(XMVectorSet(0.0f, 10.0f, -30.0f, 1.0f));
+        const XMMATRIX viewProjection = camera.GetViewProjectionMatrix();
+
+        auto start = Clock::now();
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            occlusion.Begin(viewProjection, projection.NearZ);
+            occlusion.RasterizeOccluders(g_PlaneVerts, g_PlaneIndex, g_NumPlaneIndices, walls, g_NumPlaneInstances);
+            occlusion.BuildHierarchy();
+        }
+        const double wallSeconds = std::chrono::duration<double>(Clock::now() - start).count() / frameCount;
+        const uint32_t wallTriangleCount = occlusion.GetTriangleCount();
+
+        // Quads of 1 to 4 m scattered in front of the walls.
+        const int quadCount = 2000;
+        std::vector<VertexPosNormColTex> quadVertices(quadCount * 4);
+        std::vector<uint16_t> quadIndices;
+        for (int quad = 0; quad < quadCount; ++quad)
+        {
+            const XMFLOAT3 center(-20.0f + 40.0f * unit(random), 20.0f * unit(random), -25.0f + 35.0f * unit(random));
+            const float size = 0.5f + 1.5f * unit(random);
+            const XMVECTOR axisX = XMVector3Normalize(XMVectorSet(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f, 0.0f));
+            const XMVECTOR axisY = XMVector3Normalize(XMVector3Cross(axisX, XMVectorSet(0.3f, 1.0f, 0.2f, 0.0f)));
+            for (int corner = 0; corner < 4; ++corner)
+            {
+                const float sx = (corner == 1 || corner == 2) ? size : -size;
+                const float sy = (corner >= 2) ? size : -size;
+                XMStoreFloat3(&quadVertices[quad * 4 + corner].Position, XMLoadFloat3(&center) + sx * axisX + sy * axisY);
+            }
+            const uint16_t base = static_cast<uint16_t>(quad * 4);
+            const uint16_t quadIndex[6] = { base, static_cast<uint16_t>(base + 1), static_cast<uint16_t>(base + 2),
+                base, static_cast<uint16_t>(base + 2), static_cast<uint16_t>(base + 3) };
+            quadIndices.insert(quadIndices.end(), quadIndex, quadIndex + 6);
+        }
+        start = Clock::now();
+        uint32_t quadTriangleCount = 0;
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            occlusion.Begin(viewProjection, projection.NearZ);
+            occlusion.RasterizeOccluder(quadVertices.data(), quadIndices.data(), quadIndices.size(), XMMatrixIdentity());
+            quadTriangleCount = occlusion.GetTriangleCount();
+        }
+        const double quadSeconds = std::chrono::duration<double>(Clock::now() - start).count() / frameCount;
+
+        snprintf(message, sizeof(message), "Walls: %u triangles rasterized and pyramid built in %.3f ms\n", wallTriangleCount, wallSeconds * 1000.0);
+        std::cout << message;
+        snprintf(message, sizeof(message), "Quads: %u triangles in %.3f ms, %.2f M triangles/s\n",
+            quadTriangleCount, quadSeconds * 1000.0, quadTriangleCount / quadSeconds * 1e-6);
+        std::cout << message;
+
+        // Box tests against the walls, boxes spread through and around the room.
+        occlusion.Begin(viewProjection, projection.NearZ);
+        occlusion.RasterizeOccluders(g_PlaneVerts, g_PlaneIndex, g_NumPlaneIndices, walls, g_NumPlaneInstances);
+        occlusion.BuildHierarchy();
+        std::vector<XMFLOAT3> centers(boxCount), extents(boxCount);
+        for (int i = 0; i < boxCount; ++i)
+        {
+            centers[i] = XMFLOAT3(-15.0f + 30.0f * unit(random), -5.0f + 30.0f * unit(random), -25.0f + 40.0f * unit(random));
+            extents[i] = XMFLOAT3(0.1f + 0.9f * unit(random), 0.1f + 0.9f * unit(random), 0.1f + 0.9f * unit(random));
+        }
+        std::vector<uint8_t> visible(boxCount);
+        snprintf(message, sizeof(message), "Box tests: %d boxes\n  %-8s %10s %12s %10s\n", boxCount, "threads", "ms", "M boxes/s", "visible");
+        std::cout << message;
+        std::vector<uint8_t> singleThreadVisible;
+        const unsigned int threadCounts[2] = { 1, GetDefaultThreadCount() };
+        for (unsigned int threadCount : threadCounts)
+        {
+            start = Clock::now();
+            ParallelFor(boxCount, 4096, [&](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    visible[i] = occlusion.IsBoxVisible(centers[i], extents[i]) ? 1 : 0;
+                }
+            }, threadCount);
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            if (threadCount == 1)
+            {
+                singleThreadVisible = visible;
+            }
+            else
+            {
+                failureCount += !Check("Occlusion", visible == singleThreadVisible, "thread count independence");
+            }
+
+            size_t visibleCount = 0;
+            for (uint8_t v : visible)
+            {
+                visibleCount += v;
+            }
+            snprintf(message, sizeof(message), "  %-8u %10.3f %12.2f %10zu\n", threadCount, seconds * 1000.0, boxCount / seconds * 1e-6, visibleCount);
+            std::cout << message;
+        }
+    }
+
+    return failureCount == 0 ? 0 : -1;
+}
+
+/**
+* Build an AABB tree of 100k and of 1M random boxes headless, then move,
+* refit and flatten it and run frustum, ray, sphere and box queries. Every
+* stage is timed, the tree is validated after each change, and a sample of
+* every query kind is checked against brute force over all the boxes.
+* No window or D3D device is created.
+*/
+int RunBvhBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const int objectCounts[2] = { 100000, 1000000 };
+    const int queryCount = 100000;
+    const int frustumCount = 200;
+    const int checkedQueryCount = 200;
+    char message[256];
+    int failureCount = 0;
+    auto print = [&]()
+    {
+        std::cout << message;
+    };
+    auto secondsSince = [](Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    for (int objectCount : objectCounts)
+    {
+        // Boxes of 0.1 to 1 m at the same density at every count.
+        const float side = 100.0f * std::cbrt(objectCount / 100000.0f);
+        std::mt19937 random(24);
+        std::uniform_real_distribution<float> position(-0.5f * side, 0.5f * side);
+        std::uniform_real_distribution<float> size(0.05f, 0.5f);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::vector<XMFLOAT3> centers(objectCount), extents(objectCount);
+        for (int i = 0; i < objectCount; ++i)
+        {
+            centers[i] = XMFLOAT3(position(random), position(random), position(random));
+            extents[i] = XMFLOAT3(size(random), size(random), size(random));
+        }
+
+        snprintf(message, sizeof(message), "AABB tree: %d boxes in a %.0f m cube\n", objectCount, side);
+        print();
+
+        AabbTree tree(0.1f);
+        std::vector<uint32_t> proxies(objectCount);
+        auto start = Clock::now();
+        for (int i = 0; i < objectCount; ++i)
+        {
+            proxies[i] = tree.CreateProxy(MakeAabb(centers[i], extents[i]), static_cast<uint32_t>(i));
+        }
+        double seconds = secondsSince(start);
+        failureCount += !Check("BVH", tree.Validate(), "tree after build");
+        snprintf(message, sizeof(message), "  build    %10.2f ms %8.0f ns/insert, height %u, area ratio %.1f, %u rotations\n",
+            seconds * 1000.0, seconds * 1e9 / objectCount, tree.GetHeight(), tree.GetAreaRatio(), tree.GetRotationCount());
+        print();
+
+        // Small moves stay inside the fattened boxes; large ones reinsert.
+        const float moveDistances[2] = { 0.05f, 1.0f };
+        for (float distance : moveDistances)
+        {
+            for (int i = 0; i < objectCount; ++i)
+            {
+                centers[i].x += distance * unit(random);
+                centers[i].y += distance * unit(random);
+                centers[i].z += distance * unit(random);
+            }
+            uint32_t reinsertCount = 0;
+            start = Clock::now();
+            for (int i = 0; i < objectCount; ++i)
+            {
+                reinsertCount += tree.MoveProxy(proxies[i], MakeAabb(centers[i], extents[i])) ? 1 : 0;
+            }
+            seconds = secondsSince(start);
+            failureCount += !Check("BVH", tree.Validate(), "tree after moving");
+            snprintf(message, sizeof(message), "  move %4.2f %8.2f ms %8.0f ns/object, %u reinserted, height %u, area ratio %.1f\n",
+                distance, seconds * 1000.0, seconds * 1e9 / objectCount, reinsertCount, tree.GetHeight(), tree.GetAreaRatio());
+            print();
+        }
+
+        {// Refit after every box changed, then after a tenth did.
+            const int refitCounts[2] = { objectCount, objectCount / 10 };
+            for (int refitCount : refitCounts)
+            {
+                start = Clock::now();
+                for (int i = 0; i < refitCount; ++i)
+                {
+                    const int object = refitCount == objectCount ? i : (i * 10 + 3) % objectCount;
+                    const Aabb& fatBounds = tree.GetFatBounds(proxies[object]);
+                    Aabb bounds = fatBounds;
+                    bounds.Max.y += 0.01f;
+                    tree.SetProxyBounds(proxies[object], bounds);
+                }
+                tree.Refit();
+                seconds = secondsSince(start);
+                failureCount += !Check("BVH", tree.Validate(), "tree after refit");
+                snprintf(message, sizeof(message), "  refit %7d boxes %8.2f ms\n", refitCount, seconds * 1000.0);
+                print();
+            }
+        }
+
+        start = Clock::now();
+        tree.Flatten();
+        seconds = secondsSince(start);
+        snprintf(message, sizeof(message), "  flatten  %10.2f ms, %u four-wide nodes\n", seconds * 1000.0, tree.GetFlatNodeCount());
+        print();
+
+        // Brute force runs over the boxes the tree holds.
+        std::vector<Aabb> boxes(objectCount);
+        for (int i = 0; i < objectCount; ++i)
+        {
+            boxes[i] = tree.GetFatBounds(proxies[i]);
+        }
+        auto sameResults = [](std::vector<uint32_t> results, std::vector<uint32_t> expected)
+        {
+            std::sort(results.begin(), results.end());
+            std::sort(expected.begin(), expected.end());
+            return results == expected;
+        };
+        std::uniform_real_distribution<float> inside(-0.45f * side, 0.45f * side);
+        auto randomPoint = [&]()
+        {
+            return XMFLOAT3(inside(random), inside(random), inside(random));
+        };
+        auto randomDirection = [&]()
+        {
+            XMFLOAT3 direction;
+            XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random), 0.0f)));
+            return direction;
+        };
+        std::vector<uint32_t> results, expected;
+
+        {// Frustums of cameras looking anywhere, 50 m deep.
+            CameraProjection projection;
+            projection.FarZ = 50.0f;
+            std::vector<Frustum> frustums(frustumCount);
+            for (Frustum& frustum : frustums)
+            {
+                Camera camera;
+                camera.SetProjection(projection);
+                const XMFLOAT3 eye = randomPoint();
+                camera.SetPosition(XMVectorSet(eye.x, eye.y, eye.z, 1.0f));
+                camera.SetOrientation(XMQuaternionNormalize(XMVectorSet(unit(random), unit(random), unit(random), unit(random))));
+                frustum = camera.GetFrustum();
+            }
+
+            bool agrees = true;
+            for (int q = 0; q < checkedQueryCount / 10; ++q)
+            {
+                const Frustum& frustum = frustums[q];
+                results.clear();
+                tree.QueryFrustum(frustum, results);
+                expected.clear();
+                for (int i = 0; i < objectCount; ++i)
+                {
+                    const Aabb& box = boxes[i];
+                    const float center[3] = { (box.Min.x + box.Max.x) * 0.5f, (box.Min.y + box.Max.y) * 0.5f, (box.Min.z + box.Max.z) * 0.5f };
+                    const float extent[3] = { (box.Max.x - box.Min.x) * 0.5f, (box.Max.y - box.Min.y) * 0.5f, (box.Max.z - box.Min.z) * 0.5f };
+                    bool outside = false;
+                    for (const XMFLOAT4& plane : frustum.Planes)
+                    {
+                        const float planeDistance = plane.x * center[0] + plane.y * center[1] + plane.z * center[2] + plane.w;
+                        const float radius = std::fabs(plane.x) * extent[0] + std::fabs(plane.y) * extent[1] + std::fabs(plane.z) * extent[2];
+                        outside = outside || planeDistance < -radius;
+                    }
+                    if (!outside)
+                    {
+                        expected.push_back(i);
+                    }
+                }
+                agrees = agrees && sameResults(results, expected);
+            }
+            failureCount += !Check("BVH", agrees, "frustum queries match brute force");
+
+            size_t resultCount = 0;
+            start = Clock::now();
+            for (const Frustum& frustum : frustums)
+            {
+                results.clear();
+                tree.QueryFrustum(frustum, results);
+                resultCount += results.size();
+            }
+            seconds = secondsSince(start);
+            snprintf(message, sizeof(message), "  frustum  %10.3f ms/query, %8.0f boxes/query\n",
+                seconds * 1000.0 / frustumCount, static_cast<double>(resultCount) / frustumCount);
+            print();
+        }
+
+        {// Spheres of 2 m and boxes of 4 m.
+            const float radius = 2.0f;
+            const XMFLOAT3 half(2.0f, 2.0f, 2.0f);
+            std::vector<XMFLOAT3> points(queryCount);
+            for (XMFLOAT3& point : points)
+            {
+                point = randomPoint();
+            }
+
+            bool spheresAgree = true, boxesAgree = true;
+            for (int q = 0; q < checkedQueryCount; ++q)
+            {
+                const XMFLOAT3& c = points[q];
+                results.clear();
+                tree.QuerySphere(c, radius, results);
+                expected.clear();
+                for (int i = 0; i < objectCount; ++i)
+                {
+                    const Aabb& box = boxes[i];
+                    const float dx = std::max(std::max(box.Min.x - c.x, c.x - box.Max.x), 0.0f);
+                    const float dy = std::max(std::max(box.Min.y - c.y, c.y - box.Max.y), 0.0f);
+                    const float dz = std::max(std::max(box.Min.z - c.z, c.z - box.Max.z), 0.0f);
+                    if (dx * dx + dy * dy + dz * dz <= radius * radius)
+                    {
+                        expected.push_back(i);
+                    }
+                }
+                spheresAgree = spheresAgree && sameResults(results, expected);
+
+                const Aabb query = MakeAabb(c, half);
+                results.clear();
+                tree.QueryAabb(query, results);
+                expected.clear();
+                for (int i = 0; i < objectCount; ++i)
+                {
+                    const Aabb& box = boxes[i];
+                    if (box.Min.x <= query.Max.x && box.Max.x >= query.Min.x && box.Min.y <= query.Max.y &&
+                        box.Max.y >= query.Min.y && box.Min.z <= query.Max.z && box.Max.z >= query.Min.z)
+                    {
+                        expected.push_back(i);
+                    }
+                }
+                boxesAgree = boxesAgree && sameResults(results, expected);
+            }
+            failureCount += !Check("BVH", spheresAgree, "sphere queries match brute force");
+            failureCount += !Check("BVH", boxesAgree, "box queries match brute force");
+
+            size_t sphereResultCount = 0, boxResultCount = 0;
+            start = Clock::now();
+            for (const XMFLOAT3& point : points)
+            {
+                results.clear();
+                tree.QuerySphere(point, radius, results);
+                sphereResultCount += results.size();
+            }
+            const double sphereSeconds = secondsSince(start);
+            start = Clock::now();
+            for (const XMFLOAT3& point : points)
+            {
+                results.clear();
+                tree.QueryAabb(MakeAabb(point, half), results);
+                boxResultCount += results.size();
+            }
+            const double boxSeconds = secondsSince(start);
+            snprintf(message, sizeof(message), "  sphere   %10.2f M queries/s, %6.1f boxes/query\n",
+                queryCount / sphereSeconds * 1e-6, static_cast<double>(sphereResultCount) / queryCount);
+            print();
+            snprintf(message, sizeof(message), "  box      %10.2f M queries/s, %6.1f boxes/query\n",
+                queryCount / boxSeconds * 1e-6, static_cast<double>(boxResultCount) / queryCount);
+            print();
+        }
+
+        {// Rays up to 100 m from inside the volume, on 1 to N threads.
+            const float maxDistance = 100.0f;
+            std::vector<XMFLOAT3> origins(queryCount), directions(queryCount);
+            for (int q = 0; q < queryCount; ++q)
+            {
+                origins[q] = randomPoint();
+                directions[q] = randomDirection();
+            }
+
+            bool agrees = true;
+            for (int q = 0; q < checkedQueryCount; ++q)
+            {
+                const XMFLOAT3& o = origins[q];
+                const XMFLOAT3& d = directions[q];
+                bool expectedFound = false;
+                float expectedDistance = maxDistance;
+                for (int i = 0; i < objectCount; ++i)
+                {
+                    const Aabb& box = boxes[i];
+                    const float minimum[3] = { box.Min.x, box.Min.y, box.Min.z };
+                    const float maximum[3] = { box.Max.x, box.Max.y, box.Max.z };
+                    const float origin[3] = { o.x, o.y, o.z };
+                    const float direction[3] = { d.x, d.y, d.z };
+                    float enter = 0.0f, exit = maxDistance;
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        const float inverse = 1.0f / (std::fabs(direction[axis]) > 1e-30f ? direction[axis] : 1e-30f);
+                        const float t0 = (minimum[axis] - origin[axis]) * inverse;
+                        const float t1 = (maximum[axis] - origin[axis]) * inverse;
+                        enter = std::max(enter, std::min(t0, t1));
+                        exit = std::min(exit, std::max(t0, t1));
+                    }
+                    if (enter <= exit && enter <= expectedDistance)
+                    {
+                        expectedFound = true;
+                        expectedDistance = enter;
+                    }
+                }
+                RayHit hit;
+                const bool found = tree.RayCast(o, d, maxDistance, hit);
+                agrees = agrees && found == expectedFound && (!found || hit.Distance == expectedDistance);
+            }
+            failureCount += !Check("BVH", agrees, "ray casts match brute force");
+
+            const unsigned int threadCounts[2] = { 1, GetDefaultThreadCount() };
+            for (unsigned int threadCount : threadCounts)
+            {
+                std::atomic<uint32_t> hitCount(0);
+                start = Clock::now();
+                ParallelFor(queryCount, 1024, [&](size_t begin, size_t end)
+                {
+                    uint32_t hits = 0;
+                    for (size_t q = begin; q < end; ++q)
+                    {
+                        RayHit hit;
+                        hits += tree.RayCast(origins[q], directions[q], maxDistance, hit) ? 1 : 0;
+                    }
+                    hitCount += hits;
+                }, threadCount);
+                seconds = secondsSince(start);
+                snprintf(message, sizeof(message), "  rays     %10.2f M rays/s on %u threads, %u hit\n",
+                    queryCount / seconds * 1e-6, threadCount, hitCount.load());
+                print();
+            }
+        }
+    }
+
+    return failureCount == 0 ? 0 : -1;
+}
+
+/**
+* Light pointCount random surface points with every light type headless,
+* check that ComputeLighting agrees with ComputeLightingScalar in both
+* shading modes and for counts that leave a partial lane, and report points
+* per second for each. No window or D3D device is created.
+*/
+int RunLightingBenchmark(int pointCount)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const float specularPower = 32.0f;
+    const float tolerance = 1e-3f;
+    char message[256];
+    int failureCount = 0;
+
+    // Two lights of each type around a 20 m room, and one left disabled.
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> room(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> color(0.2f, 1.0f);
+    auto randomDirection = [&]()
+    {
+        XMFLOAT3 direction;
+        XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random), 0.0f)));
+        return direction;
+    };
+
+    LightProperties lightProperties;
+    lightProperties.EyePosition = XMFLOAT4(0.0f, -0.6f, 0.8f, 0.0f);
+    const int lightTypes[MAX_LIGHTS] = { DirectionalLight, DirectionalLight, PointLight, PointLight, SpotLight, SpotLight, SpotLight, PointLight };
+    for (int i = 0; i < MAX_LIGHTS; ++i)
+    {
+        Light& light = lightProperties.Lights[i];
+        const XMFLOAT3 direction = randomDirection();
+        light.Position = XMFLOAT4(room(random), room(random), room(random), 1.0f);
+        // Directions are not unit length in the constant buffer either.
+        light.Direction = XMFLOAT4(direction.x * 2.0f, direction.y * 2.0f, direction.z * 2.0f, 0.0f);
+        light.Color = XMFLOAT4(color(random), color(random), color(random), 1.0f);
+        light.SpotAngle = XMConvertToRadians(20.0f + 40.0f * (unit(random) + 1.0f));
+        light.ConstantAttenuation = 1.0f;
+        light.LinearAttenuation = 0.08f;
+        light.QuadraticAttenuation = 0.0f;
+        light.LightType = lightTypes[i];
+        light.Enabled = i != MAX_LIGHTS - 1;
+    }
+
+    std::vector<XMFLOAT3> positions(pointCount);
+    std::vector<XMFLOAT3> normals(pointCount);
+    for (int i = 0; i < pointCount; ++i)
+    {
+        positions[i] = XMFLOAT3(room(random), room(random), room(random));
+        normals[i] = randomDirection();
+    }
+
+    // The scalar results for the first count points.
+    std::vector<LightingResult> results(pointCount);
+    std::vector<LightingResult> expectedResults(pointCount);
+    auto computeScalar = [&](const LightProperties& properties, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            expectedResults[i] = ComputeLightingScalar(properties, specularPower, positions[i], normals[i]);
+        }
+    };
+
+    // Largest difference over the first count points, or FLT_MAX on NaN.
+    auto maxError = [&](size_t count)
+    {
+        float error = 0.0f;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const LightingResult& expected = expectedResults[i];
+            const float differences[8] = {
+                results[i].Diffuse.x - expected.Diffuse.x, results[i].Diffuse.y - expected.Diffuse.y,
+                results[i].Diffuse.z - expected.Diffuse.z, results[i].Diffuse.w - expected.Diffuse.w,
+                results[i].Specular.x - expected.Specular.x, results[i].Specular.y - expected.Specular.y,
+                results[i].Specular.z - expected.Specular.z, results[i].Specular.w - expected.Specular.w };
+            for (float difference : differences)
+            {
+                error = (difference == difference) ? std::max(error, std::fabs(difference)) : FLT_MAX;
+            }
+        }
+        return error;
+    };
+
+    snprintf(message, sizeof(message), "Lighting: %d points, %d lights, tolerance %g\n", pointCount, MAX_LIGHTS - 1, tolerance);
+    std::cout << message;
+    snprintf(message, sizeof(message), "  %-12s %14s %14s %10s %12s\n", "mode", "scalar pts/s", "SIMD pts/s", "speedup", "max error");
+    std::cout << message;
+
+    const int shadingModes[2] = { PhongShading, BlinnPhongShading };
+    for (int shadingMode : shadingModes)
+    {
+        lightProperties.PhongShadingMode = shadingMode;
+        LightListSoA lights;
+        TransposeLights(lightProperties, lights);
+        failureCount += !Check("Lighting", lights.LightCount == MAX_LIGHTS - 1, "disabled lights are skipped");
+
+        // Every count up to two full 16-point batches, so each tail is covered.
+        computeScalar(lightProperties, 40);
+        for (size_t count = 1; count <= 40; ++count)
+        {
+            ComputeLighting(lights, specularPower, positions.data(), normals.data(), count, results.data());
+            char what[64];
+            snprintf(what, sizeof(what), "%d points", static_cast<int>(count));
+            failureCount += !Check("Lighting", maxError(count) <= tolerance, what);
+        }
+
+        auto start = Clock::now();
+        ComputeLighting(lights, specularPower, positions.data(), normals.data(), pointCount, results.data());
+        const double simdSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        start = Clock::now();
+        computeScalar(lightProperties, pointCount);
+        const double scalarSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        const float error = maxError(pointCount);
+        failureCount += !Check("Lighting", error <= tolerance, shadingMode == PhongShading ? "Phong against scalar" : "Blinn-Phong against scalar");
+
+        snprintf(message, sizeof(message), "  %-12s %14.0f %14.0f %9.2fx %12.2e\n", shadingMode == PhongShading ? "Phong" : "Blinn-Phong",
+            pointCount / scalarSeconds, pointCount / simdSeconds, scalarSeconds / simdSeconds, error);
+        std::cout << message;
+    }
+
+    return failureCount == 0 ? 0 : -1;
+}
+
+/**
+* Scatter instanceCount boxes through a 2 km square around the camera, then
+* time ComputeInstanceBounds and CullInstances with spheres and boxes while
+* the camera turns, and check the survivors against a scalar plane test.
+* Also check that a reversed-Z infinite projection's planes hold no NaNs and
+* cull nothing by distance. No window or D3D device is created.
+*/
+int RunCullingBenchmark(int instanceCount)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const int frameCount = 10;
+    char message[256];
+    int failureCount = 0;
+
+    std::vector<PlaneInstanceData> instances(instanceCount);
+    std::mt19937 random(31);
+    std::uniform_real_distribution<float> ground(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> height(0.0f, 100.0f);
+    std::uniform_real_distribution<float> scale(0.5f, 4.0f);
+    std::uniform_real_distribution<float> angle(0.0f, XM_2PI);
+    for (PlaneInstanceData& instance : instances)
+    {
+        XMFLOAT3 position;
+        position.x = ground(random);
+        position.y = height(random);
+        position.z = ground(random);
+        const float size = scale(random);
+        const float yaw = angle(random);
+        instance.WorldMatrix = XMMatrixScaling(size, size, size) * XMMatrixRotationY(yaw) * XMMatrixTranslation(position.x, position.y, position.z);
+        instance.InverseTransposeWorldMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, instance.WorldMatrix));
+        instance.MaterialIndex = 0;
+    }
+    const XMFLOAT3 localCenter(0.0f, 0.0f, 0.0f);
+    const XMFLOAT3 localExtents(1.0f, 1.0f, 1.0f);
+
+    CameraProjection projection;
+    projection.AspectRatio = static_cast<float>(g_ScreenWidth) / g_ScreenHeight;
+    projection.FarZ = 500.0f;
+    Camera camera;
+    camera.SetProjection(projection);
+
+    InstanceBoundsSoA bounds;
+    std::vector<PlaneInstanceData> visibleInstances(instanceCount);
+
+    // Visible unless entirely behind a plane, within a margin that the SIMD
+    // pass's rounding may fall either side of.
+    auto agreesWithScalar = [&](const Frustum& frustum, CullVolume volume, size_t visibleCount)
+    {
+        size_t next = 0;
+        for (int i = 0; i < instanceCount; ++i)
+        {
+            float margin = FLT_MAX;
+            for (const XMFLOAT4& plane : frustum.Planes)
+            {
+                const float distance = plane.x * bounds.CenterX[i] + plane.y * bounds.CenterY[i] + plane.z * bounds.CenterZ[i] + plane.w;
+                const float radius = (volume == CV_Sphere) ? bounds.Radius[i] :
+                    std::abs(plane.x) * bounds.ExtentX[i] + std::abs(plane.y) * bounds.ExtentY[i] + std::abs(plane.z) * bounds.ExtentZ[i];
+                margin = std::min(margin, distance + radius);
+            }
+
+            const bool visible = next < visibleCount &&
+                std::memcmp(&visibleInstances[next], &instances[i], sizeof(PlaneInstanceData)) == 0;
+            if (visible != (margin >= 0.0f) && std::abs(margin) > 1e-3f)
+            {
+                return false;
+            }
+            next += visible ? 1 : 0;
+        }
+        return next == visibleCount;
+    };
+
+    snprintf(message, sizeof(message), "Culling: %d instances, %d frames\n", instanceCount, frameCount);
+    std::cout << message;
+
+    {// Bounds.
+        const auto start = Clock::now();
+        ComputeInstanceBounds(instances.data(), instances.size(), localCenter, localExtents, bounds);
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        snprintf(message, sizeof(message), "  %-8s %10.3f ms %10.2f ns/instance\n", "bounds", seconds * 1000.0, seconds * 1e9 / instanceCount);
+        std::cout << message;
+    }
+
+    const CullVolume volumes[2] = { CV_Sphere, CV_Box };
+    for (CullVolume volume : volumes)
+    {
+        double seconds = 0.0;
+        size_t visibleTotal = 0;
+        bool agrees = true;
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            camera.Rotate(XMVectorSet(0, 1, 0, 0), 360.0f / frameCount);
+            const Frustum& frustum = camera.GetFrustum();
+
+            const auto start = Clock::now();
+            const size_t visibleCount = CullInstances(frustum, bounds, volume, instances.data(), visibleInstances.data());
+            seconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+            visibleTotal += visibleCount;
+            agrees = agrees && agreesWithScalar(frustum, volume, visibleCount);
+        }
+        failureCount += !Check("Culling", agrees, volume == CV_Sphere ? "sphere culling against the scalar test" : "box culling against the scalar test");
+
+        snprintf(message, sizeof(message), "  %-8s %10.3f ms %10.2f ns/instance %8.2f%% visible\n", volume == CV_Sphere ? "spheres" : "boxes",
+            seconds * 1000.0 / frameCount, seconds * 1e9 / (static_cast<double>(frameCount) * instanceCount),
+            100.0 * visibleTotal / (static_cast<double>(frameCount) * instanceCount));
+        std::cout << message;
+    }
+
+    {// Reversed-Z infinite: the z = 0 plane is at infinity. It must come out
+        // as a plane that culls nothing, not as NaNs that cull everything.
+        CameraProjection reversedProjection = projection;
+        reversedProjection.Depth = DM_ReversedInfinite;
+        Camera reversed = camera;
+        reversed.SetProjection(reversedProjection);
+        Frustum frustum;
+        ExtractFrustumPlanes(reversed.GetViewProjectionMatrix(), frustum);
+
+        bool finite = true;
+        for (const XMFLOAT4& plane : frustum.Planes)
+        {
+            finite = finite && std::isfinite(plane.x) && std::isfinite(plane.y) && std::isfinite(plane.z) && std::isfinite(plane.w);
+        }
+        failureCount += !Check("Culling", finite, "reversed-Z infinite planes are finite");
+        failureCount += !Check("Culling", frustum.Planes[4].x == 0.0f && frustum.Planes[4].y == 0.0f && frustum.Planes[4].z == 0.0f && frustum.Planes[4].w > 0.0f,
+            "reversed-Z infinite far plane culls nothing");
+
+        // A box 100 km straight ahead survives every plane.
+        InstanceBoundsSoA distant;
+        PlaneInstanceData instance = instances[0];
+        const XMVECTOR ahead = reversed.GetPositionVector() + XMVectorScale(reversed.GetForwardVector(), 100000.0f);
+        instance.WorldMatrix = XMMatrixTranslationFromVector(ahead);
+        ComputeInstanceBounds(&instance, 1, localCenter, localExtents, distant);
+        PlaneInstanceData visible;
+        failureCount += !Check("Culling", CullInstances(frustum, distant, CV_Box, &instance, &visible) == 1, "reversed-Z infinite keeps distant boxes");
+    }
+
+    return failureCount == 0 ? 0 : -1;
+}
+
+/**
+* Write random materials of a growing MaterialTable, singly and in runs, and
+* upload it each frame to a CPU stand-in for the GPU buffer the way
+* D3D11MaterialTable::Update does. Check that the dirty ranges stay sorted,
+* disjoint and merged, cover exactly the written entries, and that the copy
+* always matches the table. Report the bytes uploaded against full uploads
+* and time the dirty tracking. No window or D3D device is created.
+*/
+int RunMaterialTableBenchmark(int materialCount)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const int frameCount = 1000;
+    char message[256];
+    int failureCount = 0;
+
+    // Each material is tagged with the frame and index it was written at.
+    auto makeMaterial = [](int frame, uint32_t index)
+    {
+        MaterialProperties material;
+        material.Material.Emissive = XMFLOAT4(static_cast<float>(frame), static_cast<float>(index), 0.0f, 1.0f);
+        material.Material.SpecularPower = static_cast<float>(index % 128);
+        return material;
+    };
+    auto sameMaterial = [](const MaterialProperties& a, const MaterialProperties& b)
+    {
+        return std::memcmp(&a, &b, sizeof(MaterialProperties)) == 0;
+    };
+
+    MaterialTable table;
+    std::vector<MaterialProperties> gpuCopy;
+    uint32_t gpuCapacity = 0;
+    std::vector<bool> written;
+
+    std::mt19937 random(41);
+    std::uniform_int_distribution<int> writesPerFrame(0, 64);
+    std::uniform_int_distribution<int> runLength(1, 16);
+    std::uniform_int_distribution<int> addsPerFrame(0, 8);
+
+    bool rangesValid = true;
+    bool copyMatches = true;
+    uint64_t uploadedBytes = 0;
+    uint64_t fullUploadBytes = 0;
+    uint64_t rangeCount = 0;
+    double trackingSeconds = 0.0;
+
+    // Start with a quarter of the materials so the buffer has to grow.
+    for (int i = 0; i < materialCount / 4; ++i)
+    {
+        table.Add(makeMaterial(0, static_cast<uint32_t>(i)));
+    }
+    written.assign(table.GetCount(), true);
+
+    for (int frame = 1; frame <= frameCount; ++frame)
+    {
+        const auto start = Clock::now();
+        if (table.GetCount() < static_cast<uint32_t>(materialCount))
+        {
+            const int addCount = addsPerFrame(random);
+            for (int i = 0; i < addCount && table.GetCount() < static_cast<uint32_t>(materialCount); ++i)
+            {
+                table.Add(makeMaterial(frame, table.GetCount()));
+                written.push_back(true);
+            }
+        }
+
+        // Writes to single materials and to runs of neighbours, some of them
+        // written twice in a frame.
+        const int writeCount = writesPerFrame(random);
+        std::uniform_int_distribution<uint32_t> index(0, table.GetCount() - 1);
+        for (int i = 0; i < writeCount; ++i)
+        {
+            const uint32_t first = index(random);
+            const uint32_t last = std::min(table.GetCount(), first + static_cast<uint32_t>(runLength(random)));
+            for (uint32_t j = first; j < last; ++j)
+            {
+                table.Set(j, makeMaterial(frame, j));
+                written[j] = true;
+            }
+        }
+        trackingSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+        // Sorted, non-empty, disjoint and not touching, and exactly the
+        // written entries.
+        const std::vector<MaterialRange>& ranges = table.GetDirtyRanges();
+        std::vector<bool> dirty(table.GetCount(), false);
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            rangesValid = rangesValid && ranges[i].Begin < ranges[i].End && ranges[i].End <= table.GetCount() &&
+                (i == 0 || ranges[i - 1].End < ranges[i].Begin);
+            for (uint32_t j = ranges[i].Begin; j < ranges[i].End && j < table.GetCount(); ++j)
+            {
+                dirty[j] = true;
+            }
+        }
+        rangesValid = rangesValid && dirty == written;
+
+        // D3D11MaterialTable::Update: grow geometrically and upload
+        // everything, then copy each dirty range.
+        if (table.GetCount() > gpuCapacity)
+        {
+            gpuCapacity = std::max(table.GetCount(), gpuCapacity * 2);
+            gpuCopy.assign(gpuCapacity, MaterialProperties());
+            table.MarkAllDirty();
+        }
+        for (const MaterialRange& range : table.GetDirtyRanges())
+        {
+            std::copy(table.GetData() + range.Begin, table.GetData() + range.End, gpuCopy.begin() + range.Begin);
+            uploadedBytes += (range.End - range.Begin) * sizeof(MaterialProperties);
+            ++rangeCount;
+        }
+        table.ClearDirty();
+        written.assign(table.GetCount(), false);
+        fullUploadBytes += table.GetCount() * sizeof(MaterialProperties);
+
+        for (uint32_t i = 0; i < table.GetCount(); ++i)
+        {
+            copyMatches = copyMatches && sameMaterial(gpuCopy[i], table.Get(i));
+        }
+    }
+    failureCount += !Check("Material table", rangesValid, "dirty ranges");
+    failureCount += !Check("Material table", copyMatches, "uploaded copy");
+    failureCount += !Check("Material table", !table.IsDirty(), "clean after upload");
+
+    {// Writing every entry in any order merges into one range.
+        MaterialTable full;
+        for (int i = 0; i < materialCount; ++i)
+        {
+            full.Add(makeMaterial(0, static_cast<uint32_t>(i)));
+        }
+        full.ClearDirty();
+        std::vector<uint32_t> order(materialCount);
+        for (int i = 0; i < materialCount; ++i)
+        {
+            order[i] = static_cast<uint32_t>(i);
+        }
+        std::shuffle(order.begin(), order.end(), random);
+        for (uint32_t i : order)
+        {
+            full.Set(i, makeMaterial(1, i));
+        }
+        failureCount += !Check("Material table", full.GetDirtyRanges().size() == 1 && full.GetDirtyRanges()[0].Begin == 0 &&
+            full.GetDirtyRanges()[0].End == static_cast<uint32_t>(materialCount), "shuffled writes merge into one range");
+    }
+
+    snprintf(message, sizeof(message), "Material table: %u materials, %d frames, %.1f ranges/frame\n",
+        table.GetCount(), frameCount, static_cast<double>(rangeCount) / frameCount);
+    std::cout << message;
+    snprintf(message, sizeof(message), "  uploaded %.2f MB against %.2f MB for full uploads (%.1f%%), %.3f us/frame dirty tracking\n",
+        uploadedBytes / (1024.0 * 1024.0), fullUploadBytes / (1024.0 * 1024.0), 100.0 * uploadedBytes / fullUploadBytes,
+        trackingSeconds * 1e6 / frameCount);
+    std::cout << message;
+
+    return failureCount == 0 ? 0 : -1;
+}
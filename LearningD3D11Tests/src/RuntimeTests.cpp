@@ -0,0 +1,697 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "FrameScheduler.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "ParallelFor.h"
+#include "ProfileCapture.h"
+#include "Profiler.h"
+#include "TaskGraph.h"
+#include "TestModes.h"
+#include "UploadRing.h"
+
+/**
+* Run the frame scheduler against a simulated clock: steady frames, frames
+* slower than the fixed step, a one second hitch and a 60 Hz cap with
+* oversleeping sleeps. Checks that simulated and dropped time add up to the
+* elapsed time, that the catch-up limit holds, that the interpolation stays
+* in [0, 1) and that capped frames stay on 16.7 ms, and reports the frame
+* time percentiles. A short capped run on the real clock is reported but not
+* checked. No window or D3D device is created.
+*/
+int RunFrameSchedulerBenchmark()
+{
+    const int64_t millisecond = 1000000;
+    const int frameCount = 600;
+    bool passed = true;
+    char message[256];
+
+    auto report = [&](const char* name, const FrameScheduler& scheduler)
+    {
+        const Histogram& frameTimes = scheduler.GetFrameTimes();
+        const FrameSchedulerStats stats = scheduler.GetStats();
+        snprintf(message, sizeof(message), "Frame scheduler, %s: %llu frames, %llu steps, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms, dropped %.3f s, waited %.3f s\n",
+            name, static_cast<unsigned long long>(stats.FrameCount), static_cast<unsigned long long>(stats.StepCount),
+            frameTimes.GetPercentile(0.5), frameTimes.GetPercentile(0.95), frameTimes.GetPercentile(0.99), frameTimes.GetMax(),
+            stats.DroppedTime, stats.WaitTime);
+        std::cout << message;
+    };
+
+    // workTime(frame) is the simulated time each frame takes before EndFrame.
+    auto runSimulated = [&](const char* name, const FrameSchedulerSettings& settings, int64_t oversleep,
+        const std::function<int64_t(int)>& workTime, double expectedFrameTime)
+    {
+        SimulatedFrameClock clock(oversleep);
+        FrameScheduler scheduler(clock, settings);
+        bool valid = true;
+        uint32_t maxSteps = 0;
+        for (int frame = 0; frame <= frameCount; ++frame)
+        {
+            maxSteps = std::max(maxSteps, scheduler.BeginFrame());
+            const float interpolation = scheduler.GetInterpolation();
+            valid = valid && interpolation >= 0.0f && interpolation < 1.0f;
+            if (frame < frameCount)
+            {
+                clock.Advance(workTime(frame));
+                scheduler.EndFrame();
+            }
+        }
+        report(name, scheduler);
+
+        // Whatever was not simulated or dropped is the interpolation, less
+        // than one step (give or take rounding).
+        const FrameSchedulerStats stats = scheduler.GetStats();
+        const double elapsed = clock.Now() * 1e-9;
+        const double unsimulated = elapsed - stats.SimulatedTime - stats.DroppedTime;
+        valid = valid && unsimulated > -1e-6 && unsimulated < settings.FixedStep + 1e-6
+            && maxSteps <= settings.MaxStepsPerFrame;
+        if (expectedFrameTime > 0.0)
+        {
+            // Percentiles are bucket upper edges, 0.1 ms apart.
+            const Histogram& frameTimes = scheduler.GetFrameTimes();
+            valid = valid && std::abs(frameTimes.GetPercentile(0.5) - expectedFrameTime) <= 0.2
+                && std::abs(frameTimes.GetPercentile(0.95) - expectedFrameTime) <= 0.2
+                && std::abs(frameTimes.GetPercentile(0.99) - expectedFrameTime) <= 0.2;
+        }
+        if (!valid)
+        {
+            snprintf(message, sizeof(message), "Frame scheduler, %s: FAILED\n", name);
+            std::cout << message;
+        }
+        passed = passed && valid;
+        return stats;
+    };
+
+    FrameSchedulerSettings uncapped;
+    runSimulated("10 ms frames", uncapped, 0, [&](int) { return 10 * millisecond; }, 10.0);
+    runSimulated("50 ms frames", uncapped, 0, [&](int) { return 50 * millisecond; }, 50.0);
+    const FrameSchedulerStats hitch = runSimulated("1 s hitch", uncapped, 0,
+        [&](int frame) { return (frame == 300 ? 1000 : 10) * millisecond; }, 0.0);
+    passed = passed && hitch.DroppedTime > 0.8;
+
+    // 3 to 12 ms of work, and every sleep wakes up 1.5 ms late.
+    FrameSchedulerSettings capped;
+    capped.FrameCap = 1.0 / 60.0;
+    runSimulated("60 Hz cap", capped, 3 * millisecond / 2,
+        [&](int frame) { return (3 + (frame * 7) % 10) * millisecond; }, 1000.0 / 60.0);
+
+    {// Real clock, 60 Hz cap, no work.
+        SteadyFrameClock clock;
+        FrameScheduler scheduler(clock, capped);
+        for (int frame = 0; frame <= 120; ++frame)
+        {
+            scheduler.BeginFrame();
+            scheduler.EndFrame();
+        }
+        report("60 Hz cap, real clock", scheduler);
+    }
+
+    return passed ? 0 : -1;
+}
+
+/**
+* Time profiler zones: disabled, enabled, nested and from several threads at
+* once, against an empty loop, draining the rings between batches so nothing
+* is dropped. Then record a few frames of nested zones across ParallelFor
+* workers, write them as a Chrome trace and a binary capture, and check the
+* capture reads back unchanged. Fails if any event is lost.
+* No window or D3D device is created.
+*/
+int RunProfilerBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const int batchCount = 32;
+    const int batchSize = 32768;
+    const uint64_t zoneCount = uint64_t(batchCount) * batchSize;
+    volatile uint64_t sink = 0;
+    std::vector<ProfileEvent> events;
+    uint64_t collectedCount = 0;
+    uint64_t droppedCount = 0;
+    char message[256];
+
+    Profiler::SetThreadName("Main");
+
+    // Nanoseconds per iteration of body, run batchSize times per batch with
+    // the rings drained (untimed) after every batch.
+    auto timeBatches = [&](const std::function<void()>& body)
+    {
+        double seconds = 0.0;
+        for (int batch = 0; batch < batchCount; ++batch)
+        {
+            const auto startTime = Clock::now();
+            for (int i = 0; i < batchSize; ++i)
+            {
+                body();
+            }
+            seconds += std::chrono::duration<double>(Clock::now() - startTime).count();
+
+            events.clear();
+            droppedCount += Profiler::Collect(events);
+            collectedCount += events.size();
+        }
+        return seconds * 1e9 / zoneCount;
+    };
+
+    Profiler::SetEnabled(false);
+    const double baseline = timeBatches([&]() { sink = sink + 1; });
+    const double disabled = timeBatches([&]() { PROFILE_SCOPE("Disabled zone"); sink = sink + 1; });
+    const bool disabledRecorded = collectedCount != 0;
+    // A zone reads the clock twice; this is most of its cost.
+    const double clockRead = timeBatches([&]() { sink = sink + ProfilerNow(); });
+
+    Profiler::SetEnabled(true);
+    const double enabled = timeBatches([&]() { PROFILE_SCOPE("Zone"); sink = sink + 1; });
+    const double nested = timeBatches([&]()
+    {
+        PROFILE_SCOPE("Outer zone");
+        PROFILE_SCOPE("Inner zone");
+        sink = sink + 1;
+    });
+    const uint64_t expectedCount = zoneCount * 3;
+
+    // Every thread records into its own ring, so threads do not contend.
+    // Threads that do not overlap share a ring, so all of them together
+    // must fit in one.
+    const unsigned int threadCount = 4;
+    const int threadZoneCount = Profiler::RingCapacity / 8;
+    events.clear();
+    const auto threadsStartTime = Clock::now();
+    ParallelFor(threadCount, 1, [&](size_t, size_t)
+    {
+        for (int i = 0; i < threadZoneCount; ++i)
+        {
+            PROFILE_SCOPE("Thread zone");
+            sink = sink + 1;
+        }
+    }, threadCount);
+    const double threadsSeconds = std::chrono::duration<double>(Clock::now() - threadsStartTime).count();
+    droppedCount += Profiler::Collect(events);
+    uint64_t threadZonesCollected = 0;
+    for (const ProfileEvent& event : events)
+    {
+        threadZonesCollected += std::strcmp(event.Name, "Thread zone") == 0 ? 1 : 0;
+    }
+
+    snprintf(message, sizeof(message), "Profiler: empty loop %.2f ns, clock read %.2f ns, disabled zone %.2f ns, enabled zone %.2f ns, nested pair %.2f ns, %u threads %.2f ns/zone\n",
+        baseline, clockRead - baseline, disabled - baseline, enabled - baseline, nested - baseline, threadCount,
+        threadsSeconds * 1e9 / (uint64_t(threadCount) * threadZoneCount));
+    std::cout << message;
+
+    bool passed = !disabledRecorded && collectedCount == expectedCount && droppedCount == 0
+        && threadZonesCollected == uint64_t(threadCount) * threadZoneCount;
+
+    {// Record some frames and round trip them through both formats.
+        ProfileRecorder recorder;
+        const int frameCount = 100;
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            {
+                PROFILE_SCOPE("Frame");
+                {
+                    PROFILE_SCOPE("Update");
+                    ParallelFor(64, 4, [&](size_t begin, size_t end)
+                    {
+                        PROFILE_SCOPE("Update block");
+                        for (size_t i = begin; i < end; ++i)
+                        {
+                            sink = sink + i;
+                        }
+                    });
+                }
+                {
+                    PROFILE_SCOPE("Render");
+                    PROFILE_SCOPE("Draws \"quoted\"");
+                    sink = sink + 1;
+                }
+            }
+            recorder.Collect();
+        }
+        Profiler::SetEnabled(false);
+
+        const ProfileCapture& capture = recorder.GetCapture();
+        ProfileCapture loaded;
+        const bool written = WriteChromeTrace("ProfilerBenchmark.json", capture)
+            && WriteProfileCapture("ProfilerBenchmark.ldpc", capture);
+        const bool read = written && ReadProfileCapture("ProfilerBenchmark.ldpc", loaded);
+        const bool equal = read && loaded.TrackNames == capture.TrackNames && loaded.Names == capture.Names
+            && loaded.DroppedEventCount == capture.DroppedEventCount && loaded.Events.size() == capture.Events.size()
+            && std::memcmp(loaded.Events.data(), capture.Events.data(), capture.Events.size() * sizeof(ProfileCaptureEvent)) == 0;
+        bool sorted = true;
+        for (size_t i = 1; i < capture.Events.size(); ++i)
+        {
+            sorted = sorted && capture.Events[i - 1].Start <= capture.Events[i].Start;
+        }
+
+        auto fileSize = [](const char* fileName)
+        {
+            FILE* file = OpenFile(fileName, "rb");
+            if (!file)
+            {
+                return uint64_t(0);
+            }
+            fseek(file, 0, SEEK_END);
+            const uint64_t size = static_cast<uint64_t>(ftell(file));
+            fclose(file);
+            return size;
+        };
+        const uint64_t jsonSize = fileSize("ProfilerBenchmark.json");
+        const uint64_t binarySize = fileSize("ProfilerBenchmark.ldpc");
+        snprintf(message, sizeof(message), "Profiler capture: %d frames, %zu events on %zu tracks, Chrome trace %llu bytes, binary %llu bytes, round trip %s\n",
+            frameCount, capture.Events.size(), capture.TrackNames.size(),
+            static_cast<unsigned long long>(jsonSize), static_cast<unsigned long long>(binarySize), equal ? "ok" : "FAILED");
+        std::cout << message;
+
+        RemoveFile("ProfilerBenchmark.ldpc");
+        passed = passed && equal && sorted && capture.DroppedEventCount == 0
+            && capture.Events.size() >= size_t(frameCount) * 4;
+    }
+
+    if (!passed)
+    {
+        snprintf(message, sizeof(message), "Profiler: FAILED (%llu of %llu zones collected, %llu dropped)\n",
+            static_cast<unsigned long long>(collectedCount), static_cast<unsigned long long>(expectedCount),
+            static_cast<unsigned long long>(droppedCount));
+        std::cout << message;
+    }
+    return passed ? 0 : -1;
+}
+
+/**
+* Time the job system on fine-grained work at 1 to N threads: a flat batch of
+* tiny independent jobs, and a recursive split where every job forks half of
+* its range and waits for it. Then stress it: outside threads queue and wait
+* for jobs that queue and wait for jobs of their own, and every job must run
+* exactly once. Last, run random task graphs and check that no task starts
+* before an earlier task it conflicts with has finished.
+* No window or D3D device is created.
+*/
+int RunJobSystemBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const uint32_t jobCount = 1 << 16;
+    const uint32_t forkLeafSize = 16;
+    const int repeatCount = 10;
+    char message[256];
+    bool passed = true;
+
+    // A few hundred nanoseconds of work per item.
+    auto work = [](uint32_t item)
+    {
+        uint32_t x = item * 2654435761u + 1;
+        for (int i = 0; i < 64; ++i)
+        {
+            x = x * 1664525u + 1013904223u;
+        }
+        return x;
+    };
+    uint64_t expectedSum = 0;
+    for (uint32_t i = 0; i < jobCount; ++i)
+    {
+        expectedSum += work(i);
+    }
+    std::vector<uint32_t> results(jobCount);
+    auto resultSum = [&]()
+    {
+        uint64_t sum = 0;
+        for (uint32_t result : results)
+        {
+            sum += result;
+        }
+        return sum;
+    };
+
+    snprintf(message, sizeof(message), "Job system: %u flat jobs, fork tree of %u items in leaves of %u\n", jobCount, jobCount, forkLeafSize);
+    std::cout << message;
+    snprintf(message, sizeof(message), "  %-8s %10s %8s %10s %8s %10s\n", "threads", "flat ms", "speedup", "fork ms", "speedup", "steals");
+    std::cout << message;
+
+    const unsigned int maxThreadCount = GetDefaultThreadCount();
+    double baseFlatSeconds = 0.0;
+    double baseForkSeconds = 0.0;
+    for (unsigned int threadCount = 1; ; threadCount = std::min(threadCount * 2, maxThreadCount))
+    {
+        JobSystem jobs(threadCount);
+
+        std::function<void(uint32_t, uint32_t)> fork = [&](uint32_t begin, uint32_t end)
+        {
+            if (end - begin <= forkLeafSize)
+            {
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    results[i] = work(i);
+                }
+                return;
+            }
+            const uint32_t middle = begin + (end - begin) / 2;
+            JobCounter counter;
+            jobs.Run([&fork, begin, middle]() { fork(begin, middle); }, &counter);
+            fork(middle, end);
+            jobs.Wait(counter);
+        };
+
+        double flatSeconds = 0.0;
+        double forkSeconds = 0.0;
+        for (int repeat = 0; repeat < repeatCount; ++repeat)
+        {
+            std::fill(results.begin(), results.end(), 0);
+            auto start = Clock::now();
+            JobCounter counter;
+            for (uint32_t i = 0; i < jobCount; ++i)
+            {
+                jobs.Run([&results, &work, i]() { results[i] = work(i); }, &counter);
+            }
+            jobs.Wait(counter);
+            const double flat = std::chrono::duration<double>(Clock::now() - start).count();
+            flatSeconds = (repeat == 0) ? flat : std::min(flatSeconds, flat);
+            passed = passed && resultSum() == expectedSum;
+
+            std::fill(results.begin(), results.end(), 0);
+            start = Clock::now();
+            fork(0, jobCount);
+            const double forked = std::chrono::duration<double>(Clock::now() - start).count();
+            forkSeconds = (repeat == 0) ? forked : std::min(forkSeconds, forked);
+            passed = passed && resultSum() == expectedSum;
+        }
+
+        if (threadCount == 1)
+        {
+            baseFlatSeconds = flatSeconds;
+            baseForkSeconds = forkSeconds;
+        }
+        snprintf(message, sizeof(message), "  %-8u %10.3f %7.2fx %10.3f %7.2fx %10llu\n", threadCount,
+            flatSeconds * 1000.0, baseFlatSeconds / flatSeconds, forkSeconds * 1000.0, baseForkSeconds / forkSeconds,
+            static_cast<unsigned long long>(jobs.GetStealCount()));
+        std::cout << message;
+
+        if (threadCount == maxThreadCount)
+        {
+            break;
+        }
+    }
+
+    {// Outside threads each queue batches of jobs that fork and wait for children.
+        const unsigned int threadCount = std::max(maxThreadCount, 4u);
+        const int outsideThreadCount = 4;
+        const int roundCount = 200;
+        const int batchSize = 32;
+        const int childCount = 4;
+        const size_t stressJobCount = size_t(outsideThreadCount) * roundCount * batchSize * (1 + childCount);
+        std::unique_ptr<std::atomic<uint32_t>[]> runCounts(new std::atomic<uint32_t>[stressJobCount]);
+        for (size_t i = 0; i < stressJobCount; ++i)
+        {
+            runCounts[i].store(0, std::memory_order_relaxed);
+        }
+
+        JobSystem jobs(threadCount);
+        const auto start = Clock::now();
+        std::vector<std::thread> outsideThreads;
+        for (int thread = 0; thread < outsideThreadCount; ++thread)
+        {
+            outsideThreads.emplace_back([&, thread]()
+            {
+                for (int round = 0; round < roundCount; ++round)
+                {
+                    JobCounter counter;
+                    for (int job = 0; job < batchSize; ++job)
+                    {
+                        const size_t id = ((size_t(thread) * roundCount + round) * batchSize + job) * (1 + childCount);
+                        jobs.Run([&jobs, &runCounts, id, childCount]()
+                        {
+                            runCounts[id].fetch_add(1, std::memory_order_relaxed);
+                            JobCounter children;
+                            for (int child = 1; child <= childCount; ++child)
+                            {
+                                jobs.Run([&runCounts, id, child]()
+                                {
+                                    runCounts[id + child].fetch_add(1, std::memory_order_relaxed);
+                                }, &children);
+                            }
+                            jobs.Wait(children);
+                        }, &counter);
+                    }
+                    jobs.Wait(counter);
+                }
+            });
+        }
+        for (std::thread& thread : outsideThreads)
+        {
+            thread.join();
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        size_t wrongCount = 0;
+        for (size_t i = 0; i < stressJobCount; ++i)
+        {
+            wrongCount += runCounts[i].load(std::memory_order_relaxed) != 1 ? 1 : 0;
+        }
+        passed = passed && wrongCount == 0;
+
+        snprintf(message, sizeof(message), "Job system stress: %d outside threads, %u workers, %zu jobs in %.3f ms, %zu not run exactly once\n",
+            outsideThreadCount, threadCount, stressJobCount, seconds * 1000.0, wrongCount);
+        std::cout << message;
+    }
+
+    {// Random graphs, each run a few times.
+        const int graphCount = 50;
+        const int runCount = 4;
+        const uint32_t taskCount = 64;
+        const uint32_t resourceCount = 8;
+        JobSystem jobs(std::max(maxThreadCount, 4u));
+        std::mt19937 random(20);
+
+        std::atomic<uint32_t> timeline(0);
+        std::vector<uint32_t> startTimes(taskCount);
+        std::vector<uint32_t> finishTimes(taskCount);
+        std::vector<uint32_t> runCounts(taskCount);
+        size_t orderErrors = 0;
+        size_t edgeCount = 0;
+        for (int graphIndex = 0; graphIndex < graphCount; ++graphIndex)
+        {
+            TaskGraph graph;
+            for (uint32_t resource = 0; resource < resourceCount; ++resource)
+            {
+                graph.AddResource("Resource");
+            }
+
+            // Each task reads or writes up to two resources.
+            std::vector<std::vector<TaskGraph::ResourceId>> reads(taskCount);
+            std::vector<std::vector<TaskGraph::ResourceId>> writes(taskCount);
+            for (uint32_t task = 0; task < taskCount; ++task)
+            {
+                for (uint32_t resource = 0; resource < resourceCount; ++resource)
+                {
+                    const uint32_t roll = random() % 16;
+                    if (roll == 0)
+                    {
+                        writes[task].push_back(resource);
+                    }
+                    else if (roll == 1)
+                    {
+                        reads[task].push_back(resource);
+                    }
+                }
+                graph.AddTask("Task", [&, task]()
+                {
+                    startTimes[task] = timeline++;
+                    volatile uint32_t sink = work(task);
+                    (void)sink;
+                    ++runCounts[task];
+                    finishTimes[task] = timeline++;
+                }, reads[task], writes[task]);
+            }
+
+            for (int run = 0; run < runCount; ++run)
+            {
+                std::fill(runCounts.begin(), runCounts.end(), 0);
+                graph.Run(jobs);
+
+                // Compare against the conflicts themselves rather than the
+                // edges the graph derived from them.
+                for (uint32_t later = 0; later < taskCount; ++later)
+                {
+                    orderErrors += runCounts[later] != 1 ? 1 : 0;
+                    for (uint32_t earlier = 0; earlier < later; ++earlier)
+                    {
+                        auto touches = [](const std::vector<TaskGraph::ResourceId>& resources, TaskGraph::ResourceId resource)
+                        {
+                            return std::find(resources.begin(), resources.end(), resource) != resources.end();
+                        };
+                        bool conflict = false;
+                        for (TaskGraph::ResourceId resource : writes[earlier])
+                        {
+                            conflict = conflict || touches(reads[later], resource) || touches(writes[later], resource);
+                        }
+                        for (TaskGraph::ResourceId resource : reads[earlier])
+                        {
+                            conflict = conflict || touches(writes[later], resource);
+                        }
+                        if (conflict && finishTimes[earlier] > startTimes[later])
+                        {
+                            ++orderErrors;
+                        }
+                    }
+                }
+            }
+
+            for (uint32_t task = 0; task < taskCount; ++task)
+            {
+                edgeCount += graph.GetPredecessors(task).size();
+            }
+        }
+        passed = passed && orderErrors == 0;
+
+        snprintf(message, sizeof(message), "Task graphs: %d graphs of %u tasks, %.1f edges per graph, %d runs each, %zu ordering errors\n",
+            graphCount, taskCount, static_cast<double>(edgeCount) / graphCount, runCount, orderErrors);
+        std::cout << message;
+    }
+
+    if (!passed)
+    {
+        snprintf(message, sizeof(message), "Job system: FAILED\n");
+        std::cout << message;
+    }
+    return passed ? 0 : -1;
+}
+
+/**
+* Drive the upload ring as D3D11ConstantBufferRing does, with random sizes,
+* empty frames and up to three frames in flight, and check every allocation
+* against the live ones: aligned, inside the ring and not overlapping. Check
+* that an emptied ring can hand out its whole capacity wherever its head was
+* left, and time allocation of 256 byte constant buffers.
+* No window or D3D device is created.
+*/
+int RunUploadRingBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const size_t capacity = 64 * 1024;
+    const size_t alignment = 256;
+    char message[256];
+    int failureCount = 0;
+
+    {// Once the ring is empty, its whole capacity is free again wherever the
+        // head was left, even with empty frames still in flight.
+        bool fullAllocations = true;
+        for (size_t headBlocks = 0; headBlocks < capacity / alignment; ++headBlocks)
+        {
+            UploadRing ring(capacity, alignment);
+            if (headBlocks > 0)
+            {
+                ring.Allocate(headBlocks * alignment);
+            }
+            ring.EndFrame(1);
+            ring.RetireFrames(1);
+            ring.EndFrame(2);
+
+            fullAllocations = fullAllocations && ring.Allocate(capacity) == 0 && ring.GetUsedSize() == capacity;
+            ring.EndFrame(3);
+            ring.RetireFrames(2);
+            fullAllocations = fullAllocations && ring.GetUsedSize() == capacity && ring.Allocate(1) == UploadRing::InvalidOffset;
+            ring.RetireFrames(3);
+            fullAllocations = fullAllocations && ring.GetUsedSize() == 0 && ring.Allocate(capacity) == 0;
+        }
+        failureCount += !Check("Upload ring", fullAllocations, "whole capacity after emptying");
+    }
+
+    {// Random traffic against a model of the live allocations.
+        struct Allocation
+        {
+            uint64_t FrameNumber;
+            size_t Offset;
+            size_t Size;
+        };
+        std::vector<Allocation> live;
+        UploadRing ring(capacity, alignment);
+        std::mt19937 random(17);
+        // At most 40 KB a frame, so waiting for older frames always frees enough.
+        std::uniform_int_distribution<size_t> size(1, 1024);
+        std::uniform_int_distribution<int> allocationsPerFrame(0, 40);
+
+        bool valid = true;
+        uint64_t allocationCount = 0;
+        uint64_t waitCount = 0;
+        for (uint64_t frameNumber = 1; frameNumber <= 20000 && valid; ++frameNumber)
+        {
+            const int count = allocationsPerFrame(random);
+            for (int i = 0; i < count && valid; ++i)
+            {
+                const size_t allocationSize = size(random);
+                size_t offset = ring.Allocate(allocationSize);
+                while (offset == UploadRing::InvalidOffset && ring.GetFramesInFlight() > 0)
+                {
+                    // Wait for the oldest frame, as the D3D11 ring does.
+                    const uint64_t oldest = ring.GetOldestFrameInFlight();
+                    ring.RetireFrames(oldest);
+                    live.erase(std::remove_if(live.begin(), live.end(), [&](const Allocation& a) { return a.FrameNumber <= oldest; }), live.end());
+                    offset = ring.Allocate(allocationSize);
+                    ++waitCount;
+                }
+
+                valid = offset != UploadRing::InvalidOffset && offset % alignment == 0 && offset + allocationSize <= capacity;
+                for (const Allocation& a : live)
+                {
+                    valid = valid && (offset + allocationSize <= a.Offset || a.Offset + a.Size <= offset);
+                }
+                const Allocation allocation = { frameNumber, offset, allocationSize };
+                live.push_back(allocation);
+                ++allocationCount;
+            }
+
+            ring.EndFrame(frameNumber);
+            if (frameNumber > 3)
+            {
+                ring.RetireFrames(frameNumber - 3);
+                live.erase(std::remove_if(live.begin(), live.end(), [&](const Allocation& a) { return a.FrameNumber <= frameNumber - 3; }), live.end());
+            }
+            valid = valid && ring.GetUsedSize() <= capacity;
+        }
+        ring.RetireFrames(~uint64_t(0));
+        failureCount += !Check("Upload ring", valid, "allocations are aligned, inside the ring and disjoint");
+        failureCount += !Check("Upload ring", ring.GetUsedSize() == 0 && ring.GetFramesInFlight() == 0, "empty after retiring every frame");
+
+        snprintf(message, sizeof(message), "Upload ring: %llu random allocations in a %zu KB ring, %llu waits for a frame\n",
+            static_cast<unsigned long long>(allocationCount), capacity / 1024, static_cast<unsigned long long>(waitCount));
+        std::cout << message;
+    }
+
+    {// Timing: per-draw constant buffers, 100 draws a frame, three frames in flight.
+        const int frameCount = 100000;
+        const int drawsPerFrame = 100;
+        UploadRing ring(capacity, alignment);
+        size_t checksum = 0;
+        const auto start = Clock::now();
+        for (int frame = 1; frame <= frameCount; ++frame)
+        {
+            for (int draw = 0; draw < drawsPerFrame; ++draw)
+            {
+                size_t offset = ring.Allocate(256);
+                while (offset == UploadRing::InvalidOffset && ring.GetFramesInFlight() > 0)
+                {
+                    ring.RetireFrames(ring.GetOldestFrameInFlight());
+                    offset = ring.Allocate(256);
+                }
+                checksum += offset;
+            }
+            ring.EndFrame(frame);
+            if (frame > 3)
+            {
+                ring.RetireFrames(frame - 3);
+            }
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        const double allocationCount = static_cast<double>(frameCount) * drawsPerFrame;
+
+        snprintf(message, sizeof(message), "Upload ring: %.0f allocations of 256 bytes in %.3f ms, %.2f ns/allocation (checksum %zu)\n",
+            allocationCount, seconds * 1000.0, seconds * 1e9 / allocationCount, checksum);
+        std::cout << message;
+    }
+
+    return failureCount == 0 ? 0 : -1;
+}
@@ -0,0 +1,1024 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <DirectXColors.h>
+#include "ClusteredLighting.h"
+#include "DemoScene.h"
+#include "ParallelFor.h"
+#include "RecordingRenderContext.h"
+#include "RenderQueue.h"
+#include "SoftwareRenderer.h"
+#include "TestModes.h"
+
+using namespace DirectX;
+
+namespace
+{
+    // Step the scene and pose it for rendering from camera, as the app's
+    // Update and Render do for a frame without input.
+    void StepFrame(const Camera& camera, float deltaTime)
+    {
+        StepScene(deltaTime, 0.0f);
+        g_Scene.Interpolate(1.0f);
+        // Need to share the eye position in order to calculate specular.
+        g_LightProperties.EyePosition = camera.GetForwardDirectionFloat();
+    }
+
+    // Render the scene with the CPU backend. Mirrors the app's Render().
+    void RenderSoftware(SoftwareRenderer& renderer, const Camera& camera, const PlaneInstanceData* planeInstanceData, PlaneInstanceData* cubeFieldInstanceData)
+    {
+        const XMMATRIX viewProjection = camera.GetViewProjectionMatrix();
+        PerFrameConstantBufferData perFrameTransformData;
+        perFrameTransformData.ViewProjectionMatrix = viewProjection;
+
+        renderer.Clear(Colors::CornflowerBlue, 1.0f);
+        renderer.SetLightProperties(g_LightProperties);
+        renderer.SetPixelShader(SoftwareRenderer::PS_Simple);
+
+        { // Instanced render walls.
+            renderer.SetMaterial(g_MaterialTable.Get(1));
+            renderer.DrawIndexedInstanced(g_PlaneVerts, g_PlaneIndex, g_NumPlaneIndices, planeInstanceData, g_NumPlaneInstances, perFrameTransformData);
+        }
+
+        { // Instanced render cube field.
+            WriteCubeFieldInstances(cubeFieldInstanceData);
+            for (const CubeFieldDraw& draw : g_CubeFieldDraws)
+            {
+                renderer.SetMaterial(g_MaterialTable.Get(draw.MaterialIndex));
+                renderer.DrawIndexedInstanced(g_CubeMesh.Vertices.data(), g_CubeMesh.Indices16.data(), static_cast<unsigned int>(g_CubeMesh.GetIndexCount()), cubeFieldInstanceData + draw.StartInstance, draw.InstanceCount, perFrameTransformData);
+            }
+        }
+
+        { // Render Cubes
+            { // Spinning Cube
+                renderer.SetMaterial(g_MaterialTable.Get(g_Scene.GetMaterialIndex(g_SpinningCube)));
+                renderer.DrawIndexed(g_CubeMesh.Vertices.data(), g_CubeMesh.Indices16.data(), static_cast<unsigned int>(g_CubeMesh.GetIndexCount()), GetPerObjectTransformData(g_SpinningCube, viewProjection));
+            }
+
+            { // Light gizmo
+                SelectLightLod(camera, static_cast<float>(g_ScreenHeight));
+                const LodLevel& level = g_LightLodChain.Levels[g_LightLodLevel];
+                renderer.SetPixelShader(SoftwareRenderer::PS_Unlit);
+                renderer.DrawIndexed(g_LightMesh.Vertices.data() + level.BaseVertex, g_LightMesh.Indices16.data() + level.StartIndex, level.IndexCount, GetPerObjectTransformData(g_LightCube, viewProjection));
+            }
+        }
+
+        renderer.Flush();
+    }
+
+    // A random scale * rotation * translation of the given class, or for
+    // TC_General an axis scale applied after a rotation, which shears.
+    XMMATRIX CreateRandomTransform(std::mt19937& random, TransformClass transformClass)
+    {
+        std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+        std::uniform_real_distribution<float> scale(0.25f, 4.0f);
+        std::uniform_real_distribution<float> offset(-50.0f, 50.0f);
+
+        XMFLOAT3 scales(1.0f, 1.0f, 1.0f);
+        if (transformClass == TC_UniformScale)
+        {
+            scales.x = scale(random);
+            scales.y = scales.x;
+            scales.z = scales.x;
+        }
+        else if (transformClass != TC_Rigid)
+        {
+            scales.x = scale(random);
+            scales.y = scale(random);
+            scales.z = scale(random);
+        }
+        XMFLOAT3 angles;
+        angles.x = angle(random);
+        angles.y = angle(random);
+        angles.z = angle(random);
+        XMFLOAT3 translation;
+        translation.x = offset(random);
+        translation.y = offset(random);
+        translation.z = offset(random);
+
+        const XMMATRIX transform = ComposeTransform(XMLoadFloat3(&scales),
+            XMQuaternionRotationRollPitchYaw(angles.x, angles.y, angles.z), XMLoadFloat3(&translation));
+        if (transformClass != TC_General)
+        {
+            return transform;
+        }
+        return transform * CreateRandomTransform(random, TC_AxisScale);
+    }
+
+    // Largest error of any row of inverseTranspose against the transpose of
+    // the inverse of worldMatrix computed in double precision, relative to
+    // the size of the terms that row is made of: the last column is a dot
+    // product with the translation, which may cancel to almost nothing.
+    double InverseTransposeError(const XMFLOAT4X4A& worldMatrix, const XMFLOAT4X4A& inverseTranspose)
+    {
+        double a[3][3];
+        for (int row = 0; row < 3; ++row)
+        {
+            for (int column = 0; column < 3; ++column)
+            {
+                a[row][column] = worldMatrix.m[row][column];
+            }
+        }
+        // The inverse transpose of the 3x3 is its cofactor matrix over its
+        // determinant.
+        double cofactors[3][3];
+        for (int row = 0; row < 3; ++row)
+        {
+            for (int column = 0; column < 3; ++column)
+            {
+                const int r0 = (row + 1) % 3, r1 = (row + 2) % 3;
+                const int c0 = (column + 1) % 3, c1 = (column + 2) % 3;
+                cofactors[row][column] = a[r0][c0] * a[r1][c1] - a[r0][c1] * a[r1][c0];
+            }
+        }
+        const double determinant = a[0][0] * cofactors[0][0] + a[0][1] * cofactors[0][1] + a[0][2] * cofactors[0][2];
+
+        double error = 0.0;
+        for (int row = 0; row < 4; ++row)
+        {
+            double expected[4] = { 0.0, 0.0, 0.0, 1.0 };
+            if (row < 3)
+            {
+                expected[3] = 0.0;
+                for (int column = 0; column < 3; ++column)
+                {
+                    expected[column] = cofactors[row][column] / determinant;
+                    expected[3] -= expected[column] * worldMatrix.m[3][column];
+                }
+            }
+            // The last column's terms are as large as the largest of the
+            // others times the largest translation.
+            double size = 0.0, translationSize = 1.0, difference = 0.0;
+            for (int column = 0; column < 4; ++column)
+            {
+                size = std::max(size, std::fabs(expected[column]));
+                translationSize = std::max(translationSize, std::fabs(static_cast<double>(worldMatrix.m[3][column])));
+                difference = std::max(difference, std::fabs(expected[column] - inverseTranspose.m[row][column]));
+            }
+            size = (row < 3) ? size * translationSize : size;
+            error = std::max(error, difference / size);
+        }
+        return error;
+    }
+}
+
+/**
+* Render frames headless with the CPU backend, report the frame rate and
+* write the last frame to an image. The last frame is rendered again on 1 to
+* N threads, which must give the same pixels, and compared at a quarter of
+* its size against goldenFileName. No window or D3D device is created.
+* Returns -1 if a check failed.
+*/
+int RunSoftware(const std::string& outputFileName, const std::string& goldenFileName, int frameCount)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    char message[256];
+    int failureCount = 0;
+
+    CreateCube(2.0f);
+    CreateLightMesh(1.0f);
+    CreateMaterials();
+    CreateLights();
+
+    std::vector<PlaneInstanceData> planeInstanceData(g_NumPlaneInstances);
+    CreatePlaneInstances(planeInstanceData.data());
+
+    CreateSceneEntities();
+    std::vector<PlaneInstanceData> cubeFieldInstanceData(g_NumCubeFieldInstances);
+
+    Camera camera;
+    CameraProjection projection;
+    projection.AspectRatio = static_cast<float>(g_ScreenWidth) / g_ScreenHeight;
+    camera.SetProjection(projection);
+
+    SoftwareRenderer renderer(g_ScreenWidth, g_ScreenHeight);
+
+    const float deltaTime = 1.0f / 60.0f;
+    double updateSeconds = 0.0;
+    const auto startTime = Clock::now();
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        const auto updateStartTime = Clock::now();
+        StepFrame(camera, deltaTime);
+        updateSeconds += std::chrono::duration<double>(Clock::now() - updateStartTime).count();
+
+        RenderSoftware(renderer, camera, planeInstanceData.data(), cubeFieldInstanceData.data());
+    }
+    const auto endTime = Clock::now();
+
+    const size_t entityCount = g_Scene.GetEntityCount();
+    const size_t pixelCount = static_cast<size_t>(g_ScreenWidth) * g_ScreenHeight;
+
+    {// The last frame again on 1 to N threads, and on more threads than
+        // cores. Tiles are shaded independently, so the pixels must not change.
+        const unsigned int maxThreadCount = std::max(GetDefaultThreadCount(), 4u);
+        snprintf(message, sizeof(message), "Software renderer thread sweep, 1 to %u threads:\n  %-8s %10s\n", maxThreadCount, "threads", "ms/frame");
+        std::cout << message;
+        for (unsigned int threadCount = 1; threadCount <= maxThreadCount; ++threadCount)
+        {
+            SoftwareRenderer threadRenderer(g_ScreenWidth, g_ScreenHeight, threadCount);
+            const auto renderStartTime = Clock::now();
+            RenderSoftware(threadRenderer, camera, planeInstanceData.data(), cubeFieldInstanceData.data());
+            const double renderSeconds = std::chrono::duration<double>(Clock::now() - renderStartTime).count();
+
+            char what[64];
+            snprintf(what, sizeof(what), "pixels on %u threads", threadCount);
+            failureCount += !Check("Software renderer", std::equal(threadRenderer.GetColorBuffer(), threadRenderer.GetColorBuffer() + pixelCount, renderer.GetColorBuffer()), what);
+            snprintf(message, sizeof(message), "  %-8u %10.3f\n", threadCount, renderSeconds * 1000.0);
+            std::cout << message;
+        }
+    }
+
+    g_CubeMesh = Mesh();
+    g_LightMesh = Mesh();
+
+    {// Compare against the golden image. Averaging 4x4 blocks first keeps
+        // edge pixels that round differently between compilers or SIMD paths
+        // from failing the test; a block differs if any channel is off by
+        // more than the tolerance.
+        const unsigned int blockSize = 4;
+        const int channelTolerance = 8;
+        const double maxDifferentFraction = 0.01;
+
+        const unsigned int width = g_ScreenWidth / blockSize;
+        const unsigned int height = g_ScreenHeight / blockSize;
+        std::vector<uint32_t> frame(width * height);
+        const uint32_t* colors = renderer.GetColorBuffer();
+        for (unsigned int y = 0; y < height; ++y)
+        {
+            for (unsigned int x = 0; x < width; ++x)
+            {
+                uint32_t sums[4] = { 0, 0, 0, 0 };
+                for (unsigned int by = 0; by < blockSize; ++by)
+                {
+                    for (unsigned int bx = 0; bx < blockSize; ++bx)
+                    {
+                        const uint32_t c = colors[(y * blockSize + by) * g_ScreenWidth + x * blockSize + bx];
+                        for (int channel = 0; channel < 4; ++channel)
+                        {
+                            sums[channel] += (c >> (channel * 8)) & 0xFF;
+                        }
+                    }
+                }
+                uint32_t average = 0;
+                for (int channel = 0; channel < 4; ++channel)
+                {
+                    average |= ((sums[channel] + blockSize * blockSize / 2) / (blockSize * blockSize)) << (channel * 8);
+                }
+                frame[y * width + x] = average;
+            }
+        }
+
+        // Written next to the full frame, to replace the golden image with
+        // when a change to the renderer or the scene is meant to alter it.
+        const std::string blockFileName = outputFileName.substr(0, outputFileName.rfind('.')) + "Blocks.tga";
+        failureCount += !Check("Software renderer", SoftwareRenderer::SaveTGA(blockFileName, frame.data(), width, height), "writing the block averaged frame");
+
+        std::vector<uint32_t> golden;
+        unsigned int goldenWidth = 0;
+        unsigned int goldenHeight = 0;
+        if (!SoftwareRenderer::LoadTGA(goldenFileName, golden, goldenWidth, goldenHeight) || goldenWidth != width || goldenHeight != height)
+        {
+            char what[256];
+            snprintf(what, sizeof(what), "reading a %ux%u golden image from %s", width, height, goldenFileName.c_str());
+            failureCount += !Check("Software renderer", false, what);
+        }
+        else
+        {
+            size_t differentCount = 0;
+            int maxDifference = 0;
+            for (size_t i = 0; i < frame.size(); ++i)
+            {
+                int difference = 0;
+                for (int channel = 0; channel < 4; ++channel)
+                {
+                    const int a = (frame[i] >> (channel * 8)) & 0xFF;
+                    const int b = (golden[i] >> (channel * 8)) & 0xFF;
+                    difference = std::max(difference, std::abs(a - b));
+                }
+                differentCount += difference > channelTolerance ? 1 : 0;
+                maxDifference = std::max(maxDifference, difference);
+            }
+
+            const double differentFraction = static_cast<double>(differentCount) / frame.size();
+            snprintf(message, sizeof(message), "Golden image: %zu of %zu blocks differ by more than %d (%.3f%%), largest difference %d\n",
+                differentCount, frame.size(), channelTolerance, differentFraction * 100.0, maxDifference);
+            std::cout << message;
+            failureCount += !Check("Software renderer", differentFraction <= maxDifferentFraction, "golden image comparison");
+        }
+    }
+
+    const double seconds = std::chrono::duration<double>(endTime - startTime).count();
+    snprintf(message, sizeof(message), "Software renderer: %d frames at %dx%d in %.3f s (%.2f frames/sec, %u threads)\n",
+        frameCount, g_ScreenWidth, g_ScreenHeight, seconds, frameCount / seconds, GetDefaultThreadCount());
+    std::cout << message;
+
+    snprintf(message, sizeof(message), "Scene update: %zu entities, %.3f ms/frame (%.1f ns/entity)\n",
+        entityCount, updateSeconds * 1000.0 / frameCount, updateSeconds * 1e9 / (static_cast<double>(frameCount) * entityCount));
+    std::cout << message;
+
+    failureCount += !Check("Software renderer", renderer.SaveTGA(outputFileName), "writing the frame");
+
+    return failureCount == 0 ? 0 : -1;
+}
+
+/**
+* Build a queue of drawCount individual cube draws with mixed shaders and
+* materials, execute it against a recording context in submission order and
+* in sorted order, and report the state changes each order needs.
+* No window or D3D device is created.
+*/
+int RunRenderQueueStats(int drawCount)
+{
+    CreateCube(2.0f);
+    CreateMaterials();
+    CreateLights();
+    CreateSceneEntities();
+
+    Camera camera;
+    CameraProjection projection;
+    projection.AspectRatio = static_cast<float>(g_ScreenWidth) / g_ScreenHeight;
+    camera.SetProjection(projection);
+    StepFrame(camera, 1.0f / 60.0f);
+    const XMMATRIX viewProjection = camera.GetViewProjectionMatrix();
+
+    drawCount = std::min(drawCount, g_NumCubeFieldInstances);
+
+    const float farPlane = 100.0f;
+    const XMVECTOR eyePosition = camera.GetPositionVector();
+
+    RenderQueue queue;
+    queue.Reserve(drawCount);
+    std::vector<PerObjectTransformData> objectConstants;
+
+    // Scene order interleaves materials; every fourth draw is unlit and every
+    // eighth goes through the instanced pipeline.
+    for (int i = 0; i < drawCount; ++i)
+    {
+        const Entity entity = g_CubeField[(i * 7919) % g_CubeField.size()];
+        const bool instanced = (i % 8) == 0;
+
+        DrawPacket packet;
+        packet.VertexShader = instanced ? VS_Instanced : VS_Simple;
+        packet.PixelShader = (i % 4) == 1 ? PX_Unlit : PX_Simple;
+        packet.InputLayout = instanced ? IL_Instanced : IL_Simple;
+        packet.VertexBuffer = VB_Cube;
+        packet.InstanceBuffer = instanced ? static_cast<uint8_t>(VB_CubeFieldInstances) : NoResource;
+        packet.IndexBuffer = IB_Cube;
+        packet.Material = static_cast<uint16_t>(g_Scene.GetMaterialIndex(entity));
+        packet.IndexCount = static_cast<uint32_t>(g_CubeMesh.GetIndexCount());
+        packet.StartIndex = 0;
+        packet.BaseVertex = 0;
+        packet.InstanceCount = 1;
+        packet.StartInstance = instanced ? static_cast<uint32_t>(i) : 0;
+        packet.ObjectConstants = NoObjectConstants;
+        if (!instanced)
+        {
+            packet.ObjectConstants = static_cast<uint32_t>(objectConstants.size());
+            objectConstants.push_back(GetPerObjectTransformData(entity, viewProjection));
+        }
+
+        const float depth = XMVectorGetX(XMVector3Length(XMVectorSubtract(g_Scene.GetWorldMatrix(entity).r[3], eyePosition)));
+        packet.SortKey = MakeSortKey(RP_Opaque, packet.VertexShader, packet.PixelShader, packet.InputLayout, packet.Material,
+            QuantizeDepth(RP_Opaque, depth, farPlane));
+        queue.Submit(packet);
+    }
+
+    RecordingRenderContext unsortedContext;
+    RenderStateCache unsortedCache;
+    queue.Execute(unsortedContext, unsortedCache);
+
+    const auto sortStartTime = std::chrono::high_resolution_clock::now();
+    queue.Sort();
+    const double sortSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - sortStartTime).count();
+
+    RecordingRenderContext sortedContext;
+    RenderStateCache sortedCache;
+    queue.Execute(sortedContext, sortedCache);
+
+    g_CubeMesh = Mesh();
+
+    const char* commandNames[RecordingRenderContext::NumCommandTypes] =
+    {
+        "SetInputLayout", "SetVertexShader", "SetPixelShader", "SetVertexBuffers",
+        "SetIndexBuffer", "SetObjectConstants", "SetMaterial", "DrawIndexedInstanced",
+    };
+
+    char message[256];
+    snprintf(message, sizeof(message), "Render queue: %d draws, sorted in %.3f ms\n", drawCount, sortSeconds * 1000.0);
+    std::cout << message;
+
+    snprintf(message, sizeof(message), "  %-22s %10s %10s\n", "", "unsorted", "sorted");
+    std::cout << message;
+
+    for (int type = 0; type < RecordingRenderContext::NumCommandTypes; ++type)
+    {
+        const RecordingRenderContext::CommandType commandType = static_cast<RecordingRenderContext::CommandType>(type);
+        snprintf(message, sizeof(message), "  %-22s %10zu %10zu\n", commandNames[type],
+            unsortedContext.GetCommandCount(commandType), sortedContext.GetCommandCount(commandType));
+        std::cout << message;
+    }
+
+    snprintf(message, sizeof(message), "  %-22s %10u %10u\n", "state changes", unsortedCache.GetStateChangeCount(), sortedCache.GetStateChangeCount());
+    std::cout << message;
+
+    snprintf(message, sizeof(message), "  %-22s %10u %10u\n", "redundant binds skipped", unsortedCache.GetSkippedStateChangeCount(), sortedCache.GetSkippedStateChangeCount());
+    std::cout << message;
+
+    return 0;
+}
+
+/**
+* Fit the shadow maps to cameras all over the room and cull the scene's
+* casters for every map, headless. Checks the split schemes, that every
+* cascade covers its slice of the frustum and every spot map its cone, that
+* cascades keep their size as the camera turns and move by whole texels as
+* it moves, and that culling with the scene tree keeps exactly the casters
+* brute force does. Fitting and both ways of culling are timed. No window or
+* D3D device is created.
+*/
+int RunShadowBenchmark()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const int cameraCount = 200;
+    const int checkedCameraCount = 20;
+    const int fitCount = 10000;
+    char message[256];
+    int failureCount = 0;
+    auto print = [&]()
+    {
+        std::cout << message;
+    };
+    auto secondsSince = [](Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    CreateLights();
+    AssignShadowMaps();
+    CreateSceneEntities();
+    BuildSceneTree();
+
+    Camera camera;
+    CameraProjection projection;
+    camera.SetProjection(projection);
+
+    {// Uniform and logarithmic splits are the ends of the practical scheme.
+        float splits[MaxShadowCascades + 1];
+        ComputeCascadeSplits(0.1f, 40.0f, 4, 0.0f, splits);
+        failureCount += !Check("Shadows", std::fabs(splits[2] - 20.05f) < 1e-3f, "uniform splits");
+        ComputeCascadeSplits(0.1f, 40.0f, 4, 1.0f, splits);
+        failureCount += !Check("Shadows", std::fabs(splits[2] - 2.0f) < 1e-3f, "logarithmic splits");
+        ComputeCascadeSplits(0.1f, 40.0f, 4, g_ShadowSettings.SplitLambda, splits);
+        bool increasing = splits[0] == 0.1f && splits[4] == 40.0f;
+        for (int i = 0; i < 4; ++i)
+        {
+            increasing = increasing && splits[i] < splits[i + 1];
+        }
+        failureCount += !Check("Shadows", increasing, "practical splits increase from near to far");
+        snprintf(message, sizeof(message), "Shadows: %u cascades at %.2f %.2f %.2f %.2f %.2f m, %u spot light maps, %u x %u\n",
+            g_ShadowCascadeCount, splits[0], splits[1], splits[2], splits[3], splits[4],
+            g_ShadowViewCount - g_ShadowCascadeCount, g_ShadowSettings.Resolution, g_ShadowSettings.Resolution);
+        print();
+    }
+
+    std::mt19937 random(25);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_real_distribution<float> horizontal(-9.0f, 9.0f);
+    std::uniform_real_distribution<float> vertical(1.0f, 19.0f);
+    auto randomOrientation = [&]()
+    {
+        return XMQuaternionRotationRollPitchYaw(2.4f * unit(random) - 1.2f, XM_2PI * unit(random), 0.0f);
+    };
+    auto setCamera = [&](FXMVECTOR position, FXMVECTOR orientation)
+    {
+        camera.SetPosition(position);
+        camera.SetOrientation(orientation);
+    };
+
+    {// Every cascade holds its slice of the frustum, and the spot map its cone.
+        bool covered = true;
+        for (int c = 0; c < cameraCount; ++c)
+        {
+            setCamera(XMVectorSet(horizontal(random), vertical(random), horizontal(random), 1.0f), randomOrientation());
+            FitShadowMaps(camera);
+            const XMFLOAT3* corners = camera.GetFrustumCorners();
+            for (uint32_t i = 0; i < g_ShadowCascadeCount; ++i)
+            {
+                const ShadowView& cascade = g_ShadowViews[i];
+                const float depths[2] = { cascade.NearDepth, cascade.FarDepth };
+                for (float depth : depths)
+                {
+                    const float t = (depth - projection.NearZ) / (projection.FarZ - projection.NearZ);
+                    for (int corner = 0; corner < 4; ++corner)
+                    {
+                        const XMVECTOR point = XMVectorLerp(XMLoadFloat3(&corners[corner]), XMLoadFloat3(&corners[corner + 4]), t);
+                        const XMVECTOR clip = XMVector3TransformCoord(point, cascade.ViewProjection);
+                        covered = covered && std::fabs(XMVectorGetX(clip)) <= 1.0001f && std::fabs(XMVectorGetY(clip)) <= 1.0001f;
+                    }
+                }
+            }
+        }
+        failureCount += !Check("Shadows", covered, "cascades cover their frustum slices");
+
+        bool coneCovered = true;
+        for (const Light& light : g_Lights)
+        {
+            if (light.ShadowIndex < 0 || light.LightType != SpotLight)
+            {
+                continue;
+            }
+            const ShadowView& view = g_ShadowViews[light.ShadowIndex];
+            const float range = std::min(ComputeLightRange(light, DefaultLightCutoff), g_ShadowSettings.MaxDistance);
+            const XMVECTOR position = XMLoadFloat4(&light.Position);
+            const XMVECTOR direction = XMVector3Normalize(XMLoadFloat4(&light.Direction));
+            const XMVECTOR perpendicular = XMVector3Normalize(XMVector3Cross(direction, XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f)));
+            for (int i = 0; i < 10000; ++i)
+            {
+                const XMVECTOR axis = XMVector3Rotate(perpendicular, XMQuaternionRotationNormal(direction, XM_2PI * unit(random)));
+                const XMVECTOR ray = XMVector3Rotate(direction, XMQuaternionRotationNormal(axis, 0.99f * light.SpotAngle * unit(random)));
+                const XMVECTOR point = XMVectorMultiplyAdd(ray, XMVectorReplicate(0.1f + (0.99f * range - 0.1f) * unit(random)), position);
+                XMFLOAT3 clip;
+                XMStoreFloat3(&clip, XMVector3TransformCoord(point, view.ViewProjection));
+                coneCovered = coneCovered && std::fabs(clip.x) <= 1.0f && std::fabs(clip.y) <= 1.0f && clip.z >= 0.0f && clip.z <= 1.0f;
+            }
+        }
+        failureCount += !Check("Shadows", coneCovered, "spot light maps cover their cones");
+    }
+
+    {// Turning keeps every cascade's size; moving shifts it by whole texels.
+        const XMVECTOR position = XMVectorSet(1.0f, 8.0f, -3.0f, 1.0f);
+        setCamera(position, randomOrientation());
+        FitShadowMaps(camera);
+        float texelSizes[MaxShadowCascades];
+        for (uint32_t i = 0; i < g_ShadowCascadeCount; ++i)
+        {
+            texelSizes[i] = g_ShadowViews[i].TexelSize;
+        }
+        bool sameSize = true;
+        for (int c = 0; c < 50; ++c)
+        {
+            setCamera(position, randomOrientation());
+            FitShadowMaps(camera);
+            for (uint32_t i = 0; i < g_ShadowCascadeCount; ++i)
+            {
+                sameSize = sameSize && g_ShadowViews[i].TexelSize == texelSizes[i];
+            }
+        }
+        failureCount += !Check("Shadows", sameSize, "cascade sizes do not change as the camera turns");
+
+        // Where a static point falls within its texel, for every cascade.
+        const XMVECTOR point = XMVectorSet(0.3f, 5.1f, -2.7f, 1.0f);
+        const XMVECTOR orientation = randomOrientation();
+        const float resolution = static_cast<float>(g_ShadowSettings.Resolution);
+        auto getTexelOffsets = [&](XMFLOAT2* offsets)
+        {
+            for (uint32_t i = 0; i < g_ShadowCascadeCount; ++i)
+            {
+                XMFLOAT2 texel;
+                XMStoreFloat2(&texel, XMVectorScale(XMVector3TransformCoord(point, g_ShadowViews[i].ViewProjection), 0.5f * resolution));
+                offsets[i] = XMFLOAT2(texel.x - std::floor(texel.x), texel.y - std::floor(texel.y));
+            }
+        };
+        auto wrappedDistance = [](float a, float b)
+        {
+            const float distance = std::fabs(a - b);
+            return std::min(distance, 1.0f - distance);
+        };
+
+        XMFLOAT2 firstOffsets[MaxShadowCascades];
+        setCamera(position, orientation);
+        FitShadowMaps(camera);
+        getTexelOffsets(firstOffsets);
+        bool snapped = true;
+        float maxDrift = 0.0f;
+        for (int step = 1; step <= 50; ++step)
+        {
+            setCamera(XMVectorAdd(position, XMVectorScale(XMVectorSet(1.0f, 0.3f, 0.2f, 0.0f), 0.0137f * step)), orientation);
+            FitShadowMaps(camera);
+            XMFLOAT2 offsets[MaxShadowCascades];
+            getTexelOffsets(offsets);
+            for (uint32_t i = 0; i < g_ShadowCascadeCount; ++i)
+            {
+                const float drift = std::max(wrappedDistance(offsets[i].x, firstOffsets[i].x), wrappedDistance(offsets[i].y, firstOffsets[i].y));
+                maxDrift = std::max(maxDrift, drift);
+                snapped = snapped && drift < 0.01f;
+            }
+        }
+        failureCount += !Check("Shadows", snapped, "cascades move by whole texels as the camera moves");
+        snprintf(message, sizeof(message), "  texels   %.1f %.1f %.1f %.1f mm, largest sub-texel drift while moving %.4f texels\n",
+            texelSizes[0] * 1000.0f, texelSizes[1] * 1000.0f, texelSizes[2] * 1000.0f, texelSizes[3] * 1000.0f, maxDrift);
+        print();
+    }
+
+    {// Time fitting every map.
+        setCamera(XMVectorSet(0.0f, 10.0f, -9.0f, 1.0f), XMQuaternionIdentity());
+        auto start = Clock::now();
+        for (int i = 0; i < fitCount; ++i)
+        {
+            FitShadowMaps(camera);
+        }
+        const double seconds = secondsSince(start);
+        snprintf(message, sizeof(message), "  fit      %10.2f us for %u maps\n", seconds * 1e6 / fitCount, g_ShadowViewCount);
+        print();
+    }
+
+    {// Cull with the scene tree and by brute force over every entity.
+        const XMFLOAT4X4A* worldMatrices = g_Scene.GetWorldMatrices();
+        std::vector<ShadowInstanceData> instances(g_ShadowCasterCapacity);
+        // Writes the casters' instances as well, as WriteShadowCasters does.
+        auto bruteForce = [&](const ShadowView& view, float minTexels, std::vector<uint32_t>* casters)
+        {
+            uint32_t count = 0;
+            for (size_t i = 0; i < g_Scene.GetEntityCount(); ++i)
+            {
+                const Entity entity = g_Scene.GetEntity(i);
+                XMFLOAT3 center, extents;
+                GetEntityBox(worldMatrices[i], center, extents);
+                if (entity != g_LightCube && IsShadowCasterVisible(view, center, extents, minTexels))
+                {
+                    const XMMATRIX columns = XMMatrixTranspose(XMLoadFloat4x4A(&worldMatrices[i]));
+                    XMStoreFloat4(&instances[count].WorldColumns[0], columns.r[0]);
+                    XMStoreFloat4(&instances[count].WorldColumns[1], columns.r[1]);
+                    XMStoreFloat4(&instances[count].WorldColumns[2], columns.r[2]);
+                    ++count;
+                    if (casters)
+                    {
+                        casters->push_back(entity);
+                    }
+                }
+            }
+            return count;
+        };
+
+        const float minCasterTexels = g_ShadowSettings.MinCasterTexels;
+        double treeSeconds[MaxShadowViews] = {}, bruteSeconds[MaxShadowViews] = {}, allSeconds[MaxShadowViews] = {};
+        uint64_t casterCounts[MaxShadowViews] = {}, allCasterCounts[MaxShadowViews] = {};
+        bool agrees = true;
+        for (int c = 0; c < cameraCount; ++c)
+        {
+            setCamera(XMVectorSet(horizontal(random), vertical(random), horizontal(random), 1.0f), randomOrientation());
+            FitShadowMaps(camera);
+            for (uint32_t view = 0; view < g_ShadowViewCount; ++view)
+            {
+                auto start = Clock::now();
+                const uint32_t count = WriteShadowCasters(view, instances.data());
+                treeSeconds[view] += secondsSince(start);
+                casterCounts[view] += count;
+
+                start = Clock::now();
+                const uint32_t bruteCount = bruteForce(g_ShadowViews[view], minCasterTexels, nullptr);
+                bruteSeconds[view] += secondsSince(start);
+                agrees = agrees && count == bruteCount;
+
+                // Without leaving out casters smaller than a texel.
+                g_ShadowSettings.MinCasterTexels = 0.0f;
+                start = Clock::now();
+                allCasterCounts[view] += WriteShadowCasters(view, instances.data());
+                allSeconds[view] += secondsSince(start);
+                g_ShadowSettings.MinCasterTexels = minCasterTexels;
+
+                if (c < checkedCameraCount)
+                {
+                    // The same entities, not only as many.
+                    std::vector<uint32_t> expected, found;
+                    bruteForce(g_ShadowViews[view], minCasterTexels, &expected);
+                    for (uint32_t entity : g_ShadowQueryResults[view])
+                    {
+                        XMFLOAT3 center, extents;
+                        GetEntityBox(worldMatrices[g_Scene.GetIndex(entity)], center, extents);
+                        if (entity != g_LightCube && IsShadowCasterVisible(g_ShadowViews[view], center, extents, minCasterTexels))
+                        {
+                            found.push_back(entity);
+                        }
+                    }
+                    std::sort(expected.begin(), expected.end());
+                    std::sort(found.begin(), found.end());
+                    agrees = agrees && found == expected;
+                }
+            }
+        }
+        failureCount += !Check("Shadows", agrees, "casters culled with the scene tree match brute force");
+
+        snprintf(message, sizeof(message), "  culling  %u entities, %d cameras, averages per map:\n", static_cast<uint32_t>(g_Scene.GetEntityCount()), cameraCount);
+        print();
+        for (uint32_t view = 0; view < g_ShadowViewCount; ++view)
+        {
+            snprintf(message, sizeof(message), "    %s %u %8.0f casters %7.3f ms tree, %7.3f ms brute force; %8.0f casters %7.3f ms without small caster culling\n",
+                view < g_ShadowCascadeCount ? "cascade" : "spot   ", view < g_ShadowCascadeCount ? view : view - g_ShadowCascadeCount,
+                static_cast<double>(casterCounts[view]) / cameraCount, treeSeconds[view] * 1000.0 / cameraCount,
+                bruteSeconds[view] * 1000.0 / cameraCount, static_cast<double>(allCasterCounts[view]) / cameraCount,
+                allSeconds[view] * 1000.0 / cameraCount);
+            print();
+        }
+    }
+
+    return failureCount == 0 ? 0 : -1;
+}
+
+/**
+* Time Scene's fixed-step update for entityCount independently moving and
+* spinning cubes like the cube field: SaveState, Integrate and an
+* Interpolate halfway between the steps, per frame. Checks that the
+* entities moved by their linear velocity and that the matrices are at the
+* interpolated positions. No window or D3D device is created. Returns -1 if
+* a check failed.
+*/
+int RunSceneUpdateBenchmark(int entityCount)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const int frameCount = 60;
+    const float deltaTime = 1.0f / 60.0f;
+    char message[256];
+    int failureCount = 0;
+
+    std::mt19937 random(4);
+    std::uniform_real_distribution<float> offset(-9.0f, 9.0f);
+    std::uniform_real_distribution<float> speed(-0.5f, 0.5f);
+    std::uniform_real_distribution<float> angularSpeed(-3.0f, 3.0f);
+
+    Scene scene;
+    scene.Reserve(entityCount);
+    std::vector<XMFLOAT3> startPositions(entityCount);
+    for (int i = 0; i < entityCount; ++i)
+    {
+        XMFLOAT3 position, linearVelocity, angularVelocity;
+        position.x = offset(random);
+        position.y = offset(random);
+        position.z = offset(random);
+        linearVelocity.x = speed(random);
+        linearVelocity.y = speed(random);
+        linearVelocity.z = speed(random);
+        angularVelocity.x = angularSpeed(random);
+        angularVelocity.y = angularSpeed(random);
+        angularVelocity.z = angularSpeed(random);
+
+        const Entity entity = scene.CreateEntity();
+        scene.SetPosition(entity, position);
+        scene.SetScale(entity, XMFLOAT3(0.025f, 0.025f, 0.025f));
+        scene.SetLinearVelocity(entity, linearVelocity);
+        scene.SetAngularVelocity(entity, angularVelocity);
+        startPositions[i] = position;
+    }
+
+    double integrateSeconds = 0.0, interpolateSeconds = 0.0;
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        const auto startTime = Clock::now();
+        scene.SaveState();
+        scene.Integrate(deltaTime);
+        const auto integratedTime = Clock::now();
+        scene.Interpolate(0.5f);
+        const auto endTime = Clock::now();
+        integrateSeconds += std::chrono::duration<double>(integratedTime - startTime).count();
+        interpolateSeconds += std::chrono::duration<double>(endTime - integratedTime).count();
+    }
+
+    bool moved = true, interpolated = true;
+    const XMFLOAT4X4A* worldMatrices = scene.GetWorldMatrices();
+    for (int i = 0; i < entityCount; ++i)
+    {
+        const Entity entity = static_cast<Entity>(i);
+        const size_t index = scene.GetIndex(entity);
+        const XMVECTOR linearVelocity = XMLoadFloat3(&scene.GetLinearVelocity(entity));
+        const XMVECTOR expected = XMLoadFloat3(&startPositions[i]) + linearVelocity * (frameCount * deltaTime);
+        const XMVECTOR position = XMLoadFloat3(&scene.GetPosition(entity));
+        moved = moved && XMVector3NearEqual(position, expected, XMVectorReplicate(1e-4f));
+        const XMVECTOR halfway = position - linearVelocity * (0.5f * deltaTime);
+        interpolated = interpolated && XMVector3NearEqual(XMLoadFloat4x4A(&worldMatrices[index]).r[3], halfway, XMVectorReplicate(1e-4f));
+    }
+    failureCount += !Check("Scene update", moved, "entities moved by their linear velocity");
+    failureCount += !Check("Scene update", interpolated, "world matrices are at the interpolated positions");
+
+    const double frameSeconds = (integrateSeconds + interpolateSeconds) / frameCount;
+    snprintf(message, sizeof(message), "Scene update: %d entities, %.3f ms/frame, %.1f ns/entity (integrate %.1f, interpolate %.1f), %.1f M entities/s (%u threads)\n",
+        entityCount, frameSeconds * 1000.0, frameSeconds * 1e9 / entityCount, integrateSeconds * 1e9 / frameCount / entityCount,
+        interpolateSeconds * 1e9 / frameCount / entityCount, entityCount / frameSeconds * 1e-6, GetDefaultThreadCount());
+    std::cout << message;
+
+    return failureCount == 0 ? 0 : -1;
+}
+
+/**
+* Check the closed-form inverse transpose world matrices of every transform
+* class, of their products as classified by CombineTransformClass and of a
+* Scene hierarchy against a double precision inverse, alongside
+* XMMatrixInverse. Then time matrixCount matrices through the batched path,
+* one at a time and through XMMatrixInverse. No window or D3D device is
+* created. Returns -1 if a check failed.
+*/
+int RunTransformBenchmark(int matrixCount)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    // A few float roundings, for scales of 0.25 to 4 in up to two products.
+    const double tolerance = 1e-5;
+    char message[256];
+    char what[128];
+    int failureCount = 0;
+
+    const char* classNames[] = { "rigid", "uniform scale", "axis scale", "general" };
+    std::mt19937 random(5);
+
+    {// Single transforms of each class, and every product of two.
+        const int transformCount = 10000;
+        std::cout << "Transforms: largest row error against a double precision inverse\n";
+        for (int first = TC_Rigid; first <= TC_General; ++first)
+        {
+            for (int second = -1; second <= TC_AxisScale; ++second)
+            {
+                if (first == TC_General && second >= 0)
+                {
+                    continue;
+                }
+                // A single transform when second is -1.
+                const TransformClass transformClass = (second < 0) ? static_cast<TransformClass>(first)
+                    : CombineTransformClass(static_cast<TransformClass>(first), static_cast<TransformClass>(second));
+                double closedFormError = 0.0, inverseError = 0.0;
+                for (int i = 0; i < transformCount; ++i)
+                {
+                    XMMATRIX worldMatrix = CreateRandomTransform(random, static_cast<TransformClass>(first));
+                    if (second >= 0)
+                    {
+                        worldMatrix = worldMatrix * CreateRandomTransform(random, static_cast<TransformClass>(second));
+                    }
+                    XMFLOAT4X4A world, closedForm, inverse;
+                    XMStoreFloat4x4A(&world, worldMatrix);
+                    XMStoreFloat4x4A(&closedForm, ComputeInverseTransposeWorldMatrix(worldMatrix, transformClass));
+                    XMStoreFloat4x4A(&inverse, XMMatrixTranspose(XMMatrixInverse(nullptr, worldMatrix)));
+                    closedFormError = std::max(closedFormError, InverseTransposeError(world, closedForm));
+                    inverseError = std::max(inverseError, InverseTransposeError(world, inverse));
+                }
+
+                char name[64];
+                if (second < 0)
+                {
+                    snprintf(name, sizeof(name), "%s", classNames[first]);
+                }
+                else
+                {
+                    snprintf(name, sizeof(name), "%s * %s", classNames[first], classNames[second]);
+                }
+                snprintf(message, sizeof(message), "  %-28s as %-13s %.2e, XMMatrixInverse %.2e\n", name,
+                    classNames[transformClass], closedFormError, inverseError);
+                std::cout << message;
+                snprintf(what, sizeof(what), "%s inverse transpose within %.0e", name, tolerance);
+                failureCount += !Check("Transforms", closedFormError <= tolerance, what);
+            }
+        }
+    }
+
+    {// An axis scale after a rotation shears, which the closed form cannot
+     // invert; this is why CombineTransformClass makes such products general.
+        double error = 0.0;
+        for (int i = 0; i < 100; ++i)
+        {
+            const XMMATRIX worldMatrix = CreateRandomTransform(random, TC_Rigid) * CreateRandomTransform(random, TC_AxisScale);
+            XMFLOAT4X4A world, closedForm;
+            XMStoreFloat4x4A(&world, worldMatrix);
+            XMStoreFloat4x4A(&closedForm, ComputeInverseTransposeWorldMatrix(worldMatrix, TC_AxisScale));
+            error = std::max(error, InverseTransposeError(world, closedForm));
+        }
+        failureCount += !Check("Transforms", error > 1e-2, "sheared products are not orthogonal");
+    }
+
+    // Mixed classes in random order, so groups of four mix them too.
+    std::vector<XMFLOAT4X4A> worldMatrices(matrixCount);
+    std::vector<TransformClass> transformClasses(matrixCount);
+    std::vector<XMFLOAT4X4A> batched(matrixCount);
+    std::uniform_int_distribution<int> classDistribution(TC_Rigid, TC_General);
+    for (int i = 0; i < matrixCount; ++i)
+    {
+        transformClasses[i] = static_cast<TransformClass>(classDistribution(random));
+        XMStoreFloat4x4A(&worldMatrices[i], CreateRandomTransform(random, transformClasses[i]));
+    }
+
+    {// The batch matches one matrix at a time, for every count of leftovers.
+        bool agrees = true;
+        for (int count = 1; count <= 12 && count <= matrixCount; ++count)
+        {
+            ComputeInverseTransposeWorldMatrices(worldMatrices.data(), transformClasses.data(), count, batched.data());
+            for (int i = 0; i < count; ++i)
+            {
+                XMFLOAT4X4A single;
+                XMStoreFloat4x4A(&single, ComputeInverseTransposeWorldMatrix(XMLoadFloat4x4A(&worldMatrices[i]), transformClasses[i]));
+                for (int element = 0; element < 16; ++element)
+                {
+                    const float expected = (&single._11)[element];
+                    agrees = agrees && std::fabs((&batched[i]._11)[element] - expected) <= 1e-5f * std::max(1.0f, std::fabs(expected));
+                }
+            }
+        }
+        failureCount += !Check("Transforms", agrees, "batched inverse transposes match single ones");
+
+        ComputeInverseTransposeWorldMatrices(worldMatrices.data(), transformClasses.data(), matrixCount, batched.data());
+        double error = 0.0;
+        for (int i = 0; i < matrixCount; ++i)
+        {
+            error = std::max(error, InverseTransposeError(worldMatrices[i], batched[i]));
+        }
+        snprintf(message, sizeof(message), "  %-28s    %-13s %.2e\n", "batch of mixed classes", "", error);
+        std::cout << message;
+        failureCount += !Check("Transforms", error <= tolerance, "batched inverse transposes within tolerance");
+    }
+
+    {// A hierarchy composes local * parent and classifies it with
+     // CombineTransformClass; destroying a parent detaches its children.
+        Scene scene;
+        const Entity root = scene.CreateEntity();
+        scene.SetScale(root, XMFLOAT3(2.0f, 2.0f, 2.0f));
+        scene.SetRotation(root, XMQuaternionRotationRollPitchYaw(0.3f, 0.5f, 0.7f));
+        scene.SetPosition(root, XMFLOAT3(1.0f, 2.0f, 3.0f));
+        const Entity child = scene.CreateEntity();
+        scene.SetScale(child, XMFLOAT3(0.5f, 1.0f, 3.0f));
+        scene.SetRotation(child, XMQuaternionRotationRollPitchYaw(-0.4f, 0.1f, 1.1f));
+        scene.SetPosition(child, XMFLOAT3(0.0f, 4.0f, 0.0f));
+        const Entity grandchild = scene.CreateEntity();
+        scene.SetScale(grandchild, XMFLOAT3(1.5f, 0.5f, 0.5f));
+        scene.SetRotation(grandchild, XMQuaternionRotationRollPitchYaw(0.9f, -0.2f, 0.4f));
+        scene.SetPosition(grandchild, XMFLOAT3(-2.0f, 0.0f, 1.0f));
+        // Created after its parent, so it must be moved ahead of it.
+        scene.SetParent(grandchild, child);
+        scene.SetParent(child, root);
+        scene.Update(0.0f);
+
+        const XMMATRIX rootLocal = scene.GetWorldMatrix(root);
+        const XMMATRIX childLocal = ComposeTransform(XMVectorSet(0.5f, 1.0f, 3.0f, 0.0f),
+            XMQuaternionRotationRollPitchYaw(-0.4f, 0.1f, 1.1f), XMVectorSet(0.0f, 4.0f, 0.0f, 0.0f));
+        const XMMATRIX grandchildLocal = ComposeTransform(XMVectorSet(1.5f, 0.5f, 0.5f, 0.0f),
+            XMQuaternionRotationRollPitchYaw(0.9f, -0.2f, 0.4f), XMVectorSet(-2.0f, 0.0f, 1.0f, 0.0f));
+        const XMMATRIX expected[3] = { rootLocal, childLocal * rootLocal, grandchildLocal * childLocal * rootLocal };
+        const Entity entities[3] = { root, child, grandchild };
+        bool composed = true;
+        double error = 0.0;
+        for (int i = 0; i < 3; ++i)
+        {
+            XMFLOAT4X4A world, expectedWorld, inverseTranspose;
+            XMStoreFloat4x4A(&world, scene.GetWorldMatrix(entities[i]));
+            XMStoreFloat4x4A(&expectedWorld, expected[i]);
+            XMStoreFloat4x4A(&inverseTranspose, scene.GetInverseTransposeWorldMatrix(entities[i]));
+            for (int element = 0; element < 16; ++element)
+            {
+                composed = composed && std::fabs((&world._11)[element] - (&expectedWorld._11)[element]) <= 1e-4f;
+            }
+            error = std::max(error, InverseTransposeError(world, inverseTranspose));
+        }
+        failureCount += !Check("Transforms", composed, "hierarchy world matrices are local * parent");
+        // The grandchild's axis scale under a rotated parent is sheared, so
+        // only a general inverse gets it right.
+        failureCount += !Check("Transforms", error <= tolerance, "hierarchy inverse transposes within tolerance");
+
+        scene.DestroyEntity(child);
+        scene.Update(0.0f);
+        XMFLOAT4X4A world, expectedWorld;
+        XMStoreFloat4x4A(&world, scene.GetWorldMatrix(grandchild));
+        XMStoreFloat4x4A(&expectedWorld, grandchildLocal);
+        bool detached = scene.GetParent(grandchild) == InvalidEntity;
+        for (int element = 0; element < 16; ++element)
+        {
+            detached = detached && std::fabs((&world._11)[element] - (&expectedWorld._11)[element]) <= 1e-5f;
+        }
+        failureCount += !Check("Transforms", detached, "destroying a parent detaches its children");
+    }
+
+    {// Time the non-general classes, which all three handle.
+        for (int i = 0; i < matrixCount; ++i)
+        {
+            if (transformClasses[i] == TC_General)
+            {
+                transformClasses[i] = TC_AxisScale;
+                XMStoreFloat4x4A(&worldMatrices[i], CreateRandomTransform(random, TC_AxisScale));
+            }
+        }
+        const int repeatCount = 20;
+        double seconds[3];
+        for (int method = 0; method < 3; ++method)
+        {
+            const auto startTime = Clock::now();
+            for (int repeat = 0; repeat < repeatCount; ++repeat)
+            {
+                if (method == 0)
+                {
+                    ComputeInverseTransposeWorldMatrices(worldMatrices.data(), transformClasses.data(), matrixCount, batched.data());
+                    continue;
+                }
+                for (int i = 0; i < matrixCount; ++i)
+                {
+                    const XMMATRIX worldMatrix = XMLoadFloat4x4A(&worldMatrices[i]);
+                    XMStoreFloat4x4A(&batched[i], (method == 1) ? ComputeInverseTransposeWorldMatrix(worldMatrix, transformClasses[i])
+                        : XMMatrixTranspose(XMMatrixInverse(nullptr, worldMatrix)));
+                }
+            }
+            seconds[method] = std::chrono::duration<double>(Clock::now() - startTime).count() / repeatCount;
+        }
+        snprintf(message, sizeof(message), "  %d matrices: %.2f ns each batched, %.2f ns one at a time, %.2f ns through XMMatrixInverse\n",
+            matrixCount, seconds[0] * 1e9 / matrixCount, seconds[1] * 1e9 / matrixCount, seconds[2] * 1e9 / matrixCount);
+        std::cout << message;
+    }
+
+    return failureCount == 0 ? 0 : -1;
+}
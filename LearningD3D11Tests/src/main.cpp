@@ -0,0 +1,160 @@
+#include <cstdio>
+#include <cstring>
+#include <DirectXMath.h>
+#include "JobSystem.h"
+#include "TestModes.h"
+
+using namespace DirectX;
+
+namespace
+{
+    struct TestMode
+    {
+        const char* Flag;
+        const char* Description;
+        int (*Run)();
+    };
+
+    const TestMode g_TestModes[] =
+    {
+        { "-software", "render headless with the CPU backend and check the frame",
+            []() { return RunSoftware("SoftwareFrame.tga", "data/SoftwareFrameGolden.tga", 100); } },
+        { "-renderqueue", "report render queue state change counts",
+            []() { return RunRenderQueueStats(10000); } },
+        { "-vertexformats", "check and time vertex packing",
+            []() { return RunVertexFormatBenchmark(); } },
+        { "-meshes", "time procedural mesh generation and optimization",
+            []() { return RunMeshBenchmark(); } },
+        { "-meshfile", "cook a multi-GB mesh file and time loading it",
+            []() { return RunMeshFileBenchmark(); } },
+        { "-texturestreaming", "stream procedural textures under a budget",
+            []() { return RunTextureStreamingBenchmark(400, 2000); } },
+        { "-texturecooker", "time block compression and check its quality",
+            []() { return RunTextureCookerBenchmark(1024, 3); } },
+        { "-shaderarchive", "time shader archive mapping and lookups",
+            []() { return RunShaderArchiveBenchmark(10000); } },
+        { "-framescheduler", "check frame pacing against a simulated clock",
+            []() { return RunFrameSchedulerBenchmark(); } },
+        { "-profiler", "time profiler zones and check the trace exports",
+            []() { return RunProfilerBenchmark(); } },
+        { "-clusteredlights", "check light assignment to the cluster grid and time it",
+            []()
+            {
+                const int clusteredLightingFrameCount = 100;
+                const int smallResult = RunClusteredLightingBenchmark(1000, clusteredLightingFrameCount);
+                const int largeResult = RunClusteredLightingBenchmark(10000, clusteredLightingFrameCount);
+                return (smallResult != 0) ? smallResult : largeResult;
+            } },
+        { "-commandlists", "time recording command lists on 1 to N threads",
+            []() { return RunCommandListBenchmark(50000); } },
+        { "-camera", "check the camera's frustum and depth math and time it",
+            []() { return RunCameraBenchmark(); } },
+        { "-culling", "time frustum culling of 10k, 100k and 1M instances and check it",
+            []()
+            {
+                const int instanceCounts[3] = { 10000, 100000, 1000000 };
+                int result = 0;
+                for (int instanceCount : instanceCounts)
+                {
+                    result = (RunCullingBenchmark(instanceCount) != 0) ? -1 : result;
+                }
+                return result;
+            } },
+        { "-jobs", "time the job system and check it and the task graph under contention",
+            []() { return RunJobSystemBenchmark(); } },
+        { "-uploadring", "check the upload ring under random traffic and time allocation",
+            []() { return RunUploadRingBenchmark(); } },
+        { "-lod", "time level of detail selection for 1M instances and check it",
+            []() { return RunLodBenchmark(1000000); } },
+        { "-occlusion", "check the software occlusion buffer and time it",
+            []() { return RunOcclusionBenchmark(1000000); } },
+        { "-bvh", "time building, updating and querying the scene AABB tree",
+            []() { return RunBvhBenchmark(); } },
+        { "-lighting", "check the SIMD lighting kernel against the scalar one and time both",
+            []() { return RunLightingBenchmark(1000003); } },
+        { "-materials", "check material table dirty ranges and uploads and time them",
+            []() { return RunMaterialTableBenchmark(4096); } },
+        { "-shadows", "check shadow map fitting and caster culling and time them",
+            []() { return RunShadowBenchmark(); } },
+        { "-sceneupdate", "time the scene update of 10k, 100k and 1M moving entities and check it",
+            []()
+            {
+                const int entityCounts[3] = { 10000, 100000, 1000000 };
+                int result = 0;
+                for (int entityCount : entityCounts)
+                {
+                    result = (RunSceneUpdateBenchmark(entityCount) != 0) ? -1 : result;
+                }
+                return result;
+            } },
+        { "-transforms", "check closed-form inverse transposes against a full inverse and time them",
+            []() { return RunTransformBenchmark(100000); } },
+    };
+
+    const TestMode* FindTestMode(const char* flag)
+    {
+        for (const TestMode& mode : g_TestModes)
+        {
+            if (std::strcmp(mode.Flag, flag) == 0)
+            {
+                return &mode;
+            }
+        }
+        return nullptr;
+    }
+
+    void PrintUsage(const char* program)
+    {
+        std::printf("Usage: %s <mode>...\nRuns each mode in turn; fails if any of them fails.\n", program);
+        for (const TestMode& mode : g_TestModes)
+        {
+            std::printf("  %-18s %s\n", mode.Flag, mode.Description);
+        }
+    }
+}
+
+bool Check(const char* mode, bool condition, const char* what)
+{
+    if (!condition)
+    {
+        std::printf("%s: FAILED %s\n", mode, what);
+    }
+    return condition;
+}
+
+int main(int argc, char* argv[])
+{
+    if (!XMVerifyCPUSupport())
+    {
+        std::printf("Failed to verify DirectX Math library support.\n");
+        return -1;
+    }
+
+    if (argc < 2)
+    {
+        PrintUsage(argv[0]);
+        return -1;
+    }
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!FindTestMode(argv[i]))
+        {
+            std::printf("Unknown mode %s\n", argv[i]);
+            PrintUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    // The main thread is job thread 0, as in the app.
+    JobSystem::GetDefault();
+
+    int result = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (FindTestMode(argv[i])->Run() != 0)
+        {
+            result = -1;
+        }
+    }
+    return result;
+}